@@ -34,6 +34,9 @@ constant(PLUMBER_VERSION "\"${PLUMBER_VERSION_SHORT}.${SRC_VERSION} ${BUILD_TIME
 ##Logging
 constant(LOG_DEFAULT_CONFIG_FILE \"log.cfg\")
 constant(CONFIG_PATH \"${CMAKE_INSTALL_PREFIX}/etc/plumber\")
+constant(LOG_ASYNC_RING_SIZE 65536)
+constant(LOG_ASYNC_FLUSH_INTERVAL 100)
+constant(LOG_ASYNC_WRITER_STACK_SIZE 0x40000)
 
 ##OpenSSL
 constant(MODULE_TLS_ENABLED 1)
@@ -44,6 +47,10 @@ if("${MODULE_TLS_ENABLED}" EQUAL "1")
 		set(MODULE_TLS_ENABLED 0)
 	endif(NOT "${OpenSSL_FOUND}" STREQUAL "TRUE")
 endif("${MODULE_TLS_ENABLED}" EQUAL "1")
+constant(MODULE_TLS_SESSION_CACHE_SIZE 20480)
+constant(MODULE_TLS_TICKET_KEY_RING_SIZE 3)
+constant(MODULE_TLS_HANDSHAKE_THREADS 0)
+constant(MODULE_TLS_HANDSHAKE_QUEUE_SIZE 1024)
 
 ##LibPlumber Configurations
 constant(DO_NOT_COMPILE_ITC_MODULE_TEST 0)
@@ -61,6 +68,14 @@ constant(RUNTIME_SERVLET_DEFAULT_SEARCH_PATH \"${CMAKE_INSTALL_PREFIX}/lib/plumb
 constant(RUNTIME_SERVLET_NS1_PREFIX \"/tmp/plumber-servlet.\")
 
 constant(MODULE_TCP_MAX_ASYNC_BUF_SIZE 4096)
+constant(MODULE_TCP_ASYNC_MAX_IOV 64)
+constant(MODULE_HTTP2_MAX_CONCURRENT_STREAMS 100)
+constant(MODULE_HTTP2_INITIAL_WINDOW_SIZE 1048576)
+constant(MODULE_HTTP2_MAX_FRAME_SIZE 16384)
+constant(MODULE_HTTP2_HEADER_TABLE_SIZE 4096)
+constant(MODULE_HTTP2_MAX_REQUEST_SIZE 16777216)
+constant(MODULE_HTTP2_READER_INTERVAL 5)
+constant(MODULE_MEM_INLINE_BUF_SIZE 256)
 
 constant(SCHED_SERVICE_BUFFER_NODE_LIST_INIT_SIZE 32)
 constant(SCHED_SERVICE_BUFFER_OUT_GOING_LIST_INIT_SIZE 8)
@@ -71,8 +86,11 @@ constant(SCHED_LOOP_EVENT_QUEUE_SIZE 4096)
 constant(SCHED_LOOP_MAX_PENDING_TASKS 0x100000)
 constant(SCHED_CNODE_BOUNDARY_INIT_SIZE 8)
 constant(SCHED_PROF_INIT_THREAD_CAPACITY 1)
+constant(SCHED_PROF_FLUSH_INTERVAL 10000)
 constant(SCHED_RSCOPE_ENTRY_TABLE_INIT_SIZE  4096)
 constant(SCHED_RSCOPE_ENTRY_TABLE_SIZE_LIMIT 0x100000)
+constant(SCHED_RSCOPE_ARENA_LARGE_SIZE 1024)
+constant(SCHED_ASYNC_IDLE_TIMEOUT 30)
 constant(SCHED_TYPE_ENV_HASH_SIZE 97)
 constant(SCHED_TYPE_MAX 65536)
 constant(SCHED_DAEMON_MAX_ID_LEN 128)
@@ -83,7 +101,7 @@ constant(SCHED_DAEMON_LOCK_SUFFIX \".lock\")
 
 constant(ITC_MODULE_EVENT_QUEUE_SIZE 128)
 constant(ITC_MODULE_CALLBACK_READ_BUF_SIZE 4096)
-constant(ITC_EQUEUE_VEC_INIT_SIZE 4)
+constant(ITC_EQUEUE_MAX_NUM_QUEUES 4096)
 constant(ITC_MODTAB_MAX_PATH 4096)
 
 constant(LANG_LEX_SEARCH_LIST_INIT_SIZE 4)
@@ -109,6 +127,11 @@ constant(LIB_PSTD_FCACHE_DEFAULT_TTL 300)
 constant(LIB_PSTD_FCACHE_DEFAULT_HASH_SIZE 32771)
 constant(LIB_PSTD_FCACHE_DEFAULT_MAX_FILE_SIZE 1u<<20)
 constant(LIB_PSTD_FCACHE_DEFAULT_MAX_CACHE_SIZE 32u<<20)
+constant(LIB_PSTD_FCACHE_DEFAULT_SHARED 1)
+constant(LIB_PSTD_FCACHE_DEFAULT_NUM_WAYS 4)
+constant(LIB_PSTD_FCACHE_DEFAULT_NUM_STRIPES 8)
+constant(LIB_PSTD_FCACHE_DEFAULT_MMAP_THRESHOLD 64u<<10)
+constant(LIB_PSTD_FCACHE_DEFAULT_WATCH_INTERVAL 10)
 
 ##LibProto Configurations
 constant(LIB_PROTO_REF_NAME_INIT_SIZE 32)
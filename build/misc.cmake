@@ -10,7 +10,7 @@ add_custom_target(docs
 
 add_custom_target(distclean
 	COMMAND ${CMAKE_MAKE_PROGRAM} clean
-	COMMAND rm -rf CMakeFiles CMakeCache.txt Testing doc/doxygen cmake_install.cmake CTestTestfile.cmake Makefile tags bin config.h cmake_uninstall.cmake install_manifest.txt servlet.mk CMakeDoxygenDefaults.cmake CMakeDoxygenfile.in cscope.* servlet-test-driver.py
+	COMMAND rm -rf CMakeFiles CMakeCache.txt Testing doc/doxygen cmake_install.cmake CTestTestfile.cmake Makefile tags bin config.h cmake_uninstall.cmake install_manifest.txt servlet.mk CMakeDoxygenDefaults.cmake CMakeDoxygenfile.in cscope.* servlet-test-driver.py servlet-bench.sh
 	COMMAND rm -rf tools/*/package_config.h lib/*/package_config.h install-prototype.sh Doxyfile
 	COMMAND [ `readlink -f ${CMAKE_CURRENT_BINARY_DIR}` = `readlink -f ${CMAKE_CURRENT_SOURCE_DIR}` ] || rm -rf lib tools
 	COMMAND rm -rf ${CMAKE_CURRENT_SOURCE_DIR}/vimrc
@@ -23,6 +23,8 @@ foreach(servlet_cmake ${servlet_cmakes})
 			list(APPEND LOCAL_INCLUDE "${CMAKE_CURRENT_SOURCE_DIR}/${LIB_DIR}/pservlet/include")
 			list(APPEND LOCAL_INCLUDE "${CMAKE_CURRENT_SOURCE_DIR}/${SERVLET_DIR}/${servlet_dir}/${servlet}/include")
 			list(APPEND LOCAL_LIBS pservlet)
+			string(REPLACE ";" " " LOCAL_CFLAGS "${LOCAL_CFLAGS}")
+			string(REPLACE ";" " " LOCAL_CXXFLAGS "${LOCAL_CXXFLAGS}")
 			foreach(source_file ${SOURCE})
 				if(${source_file} MATCHES ".*\\.c$")
 					set_source_files_properties(${source_file} PROPERTIES COMPILE_FLAGS "${CFLAGS} ${LOCAL_CFLAGS}")
@@ -49,6 +51,25 @@ foreach(servlet_cmake ${servlet_cmakes})
 						     python ${CMAKE_CURRENT_BINARY_DIR}/servlet-test-driver.py ${servlet_test_name} ${servlet_test_case})
 				endforeach(case_dir in ${servlet_tests})
 			endif(NOT "${servlet_tests}" STREQUAL "")
+			if(NOT "${build_testenv}" STREQUAL "no")
+				file(GLOB servlet_unit_tests RELATIVE "${SOURCE_PATH}/test" "${SOURCE_PATH}/test/*.c")
+				foreach(test ${servlet_unit_tests})
+					get_filename_component(test_name ${test} NAME_WE)
+					set(test_name "servlet_${servlet_config_name}_${test_name}")
+					set(outdir ${CMAKE_RUNTIME_OUTPUT_DIRECTORY}/${TEST_DIR}/servlet/${NAMESPACE}/${servlet})
+					set(source ${SOURCE_PATH}/test/${test})
+					file(MAKE_DIRECTORY ${outdir})
+					set_source_files_properties(${source} PROPERTIES COMPILE_FLAGS "${CFLAGS} ${LOCAL_CFLAGS}")
+					add_executable(${test_name} ${source})
+					set_target_properties(${test_name} PROPERTIES RUNTIME_OUTPUT_DIRECTORY ${outdir})
+					target_compile_definitions(${test_name} PRIVATE TESTDIR=\"${outdir}\" TESTING_CODE=1 TEST_NAME=\"${test_name}\")
+					target_include_directories(${test_name} PUBLIC ${LOCAL_INCLUDE} "${CMAKE_CURRENT_SOURCE_DIR}/${TOOL_DIR}/testenv/include")
+					target_link_libraries(${test_name} testenv plumber dl ${LOCAL_LIBS} ${GLOBAL_LIBS} ${EXEC_LIBS})
+					add_binary_test(${test_name} ${outdir}/${test_name} 30)
+					# The servlets link third-party libraries, which hold their global allocations until the process exits
+					set_tests_properties(${test_name} PROPERTIES ENVIRONMENT "NO_LEAK_CHECK=1")
+				endforeach(test)
+			endif(NOT "${build_testenv}" STREQUAL "no")
 		else(NOT "${build_${servlet_config_name}}" STREQUAL "no")
 			set(package_status "${package_status} -Dbuild_${servlet_config_name}=no")
 			set(build_${servlet_config_name} "no")
@@ -87,3 +108,5 @@ endif("${SYSNAME}" STREQUAL "Linux")
 
 configure_file("${CMAKE_CURRENT_SOURCE_DIR}/test/servlet-test-driver.py.in"
 	           "${CMAKE_CURRENT_BINARY_DIR}/servlet-test-driver.py")
+configure_file("${CMAKE_CURRENT_SOURCE_DIR}/test/servlet-bench.sh.in"
+	           "${CMAKE_CURRENT_BINARY_DIR}/servlet-bench.sh" @ONLY)
@@ -197,6 +197,19 @@ uint32_t itc_equeue_take(itc_equeue_token_t token, itc_equeue_event_mask_t type_
  */
 int itc_equeue_empty(itc_equeue_token_t token);
 
+/**
+ * @brief check if the equeue contains at least one event which is allowed by the event mask
+ * @note this won't block the thread execution, this function must called with the scheduler token. <br/>
+ *       Unlike itc_equeue_take, this function won't treat "no event" as an error, so it can be used
+ *       to probe the queue before taking events from it
+ * @param token the thread token
+ * @param type_mask Indicates which type of event we are looking for
+ * @return &gt;0: there's at least one event matches the mask <br/>
+ *         =0: no event matches the mask <br/>
+ *         ERROR_CODE: error cases
+ **/
+int itc_equeue_ready(itc_equeue_token_t token, itc_equeue_event_mask_t type_mask);
+
 /**
  * @brief Block execution until the equeue is not empty
  * @note Unlike the normal version, this function allows caller pass in a
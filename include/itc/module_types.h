@@ -79,6 +79,16 @@ typedef struct {
 } itc_module_data_source_event_t;
 
 
+/**
+ * @brief The file region exposed by a data source, which the module can transfer with zero-copy system calls
+ * @note The file descriptor is owned by the data source, and it's valid until the data source gets closed
+ **/
+typedef struct {
+	int          fd;            /*!< The file descriptor of a regular file */
+	uint64_t     offset;        /*!< The offset of the region */
+	size_t       size;          /*!< The number of bytes in the region */
+} itc_module_data_source_region_t;
+
 /**
  * @brief represent a data source that provides data for the write_callback module call
  * @details this struct is used to describe an abstracted data source that provides a byte stream which can be
@@ -101,6 +111,17 @@ typedef struct {
 	 * @return the result, or error code
 	 **/
 	int    (*eos)(const void* __restrict handle);
+	/**
+	 * @brief take all the remaining bytes of the data source as a file region
+	 * @details This callback is optional. After the region has been returned, the data source reaches
+	 *          the end-of-stream, and the module should transfer the region on behalf of the data source. <br/>
+	 *          The module which doesn't support zero-copy, or can not write the plain bytes to the file
+	 *          descriptor directly (for example TLS), should just use the read callback instead.
+	 * @param handle the data handle
+	 * @param region_buf the buffer used to return the region
+	 * @return 1 if the region is returned, 0 if the data source is not able to expose a file region, or error code
+	 **/
+	int    (*region)(void* __restrict handle, itc_module_data_source_region_t* region_buf);
 	/**
 	 * @brief represent how we dispose/close the data source
 	 * @param handle the handle to close
@@ -494,6 +515,17 @@ typedef struct {
 	 **/
 	uint32_t (*get_opcode)(void* __restrict context, const char* name);
 
+	/**
+	 * @brief get the address of the C function that implements the service module function
+	 * @details This allows the servlet calls the service module function directly without going through the invoke callback.
+	 *          The function takes the same arguments as the invoke callback gets from the va_list, and it doesn't take the module
+	 *          context. Thus only the function that doesn't depend on the module instance context should be exposed.
+	 * @param context the module instance context
+	 * @param opcode the operation code for the function
+	 * @return the function address, NULL if this function can only be called through invoke
+	 **/
+	runtime_api_module_func_t (*get_func)(void* __restrict context, uint32_t opcode);
+
 	/**
 	 * @brief the module call that will be called when the plumber service is going to exit
 	 * @note  Althogh the cleanup callback also gets called at this time, but the semantics of the cleanup call is to dispose all the resources
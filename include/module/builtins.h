@@ -16,6 +16,7 @@
 #include <module/legacy_file/module.h>
 #include <module/pssm/module.h>
 #include <module/tls/module.h>
+#include <module/http2/module.h>
 #include <module/simulate/module.h>
 #include <module/legacy_file/module.h>
 #include <module/text_file/module.h>
@@ -32,6 +33,7 @@
 	{"test_pipe",&module_test_module_def},\
 	{"legacy_file_pipe", &module_legacy_file_module_def},\
 	_TLS_MODULE_DEF \
+	{"http2_pipe", &module_http2_module_def},\
 	{"pssm",      &module_pssm_module_def},\
 	{"simulate",  &module_simulate_module_def},\
 	{"legacy_file",  &module_legacy_file_module_def}, \
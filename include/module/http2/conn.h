@@ -0,0 +1,170 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+/**
+ * @brief The HTTP/2 connection state machine
+ * @details This is the transportation independent part of the HTTP/2 module. It consumes the bytes
+ *          received from the peer, parses the frames, decodes the header blocks and maintains the flow
+ *          control windows and the stream states. <br/>
+ *          Each stream that has received the complete request is translated to a HTTP/1.1 request message,
+ *          so that the existing HTTP servlets can serve the stream without knowing anything about HTTP/2.
+ *          In the other direction, the HTTP/1.1 response written to the stream is translated to the HEADERS
+ *          and DATA frames. <br/>
+ *          All the frames that need to be sent are queued in the connection, and the caller is responsible
+ *          for flushing them to the transportation layer. <br/>
+ *          The connection object is not thread safe, the caller should serialize the calls for the same
+ *          connection, except the stream read functions, which only touch the request owned by the stream.
+ * @file module/http2/conn.h
+ **/
+#ifndef __PLUMBER_MODULE_HTTP2_CONN_H__
+#define __PLUMBER_MODULE_HTTP2_CONN_H__
+
+/**
+ * @brief the HTTP/2 connection
+ **/
+typedef struct _module_http2_conn_t module_http2_conn_t;
+
+/**
+ * @brief a HTTP/2 stream
+ **/
+typedef struct _module_http2_stream_t module_http2_stream_t;
+
+/**
+ * @brief the connection configuration, which is advertised with our SETTINGS frame
+ **/
+typedef struct {
+	uint32_t max_concurrent_streams;   /*!< the maximum number of the concurrent streams the peer can open */
+	uint32_t initial_window_size;      /*!< the initial receiving window of each stream */
+	uint32_t max_frame_size;           /*!< the largest frame payload we accept */
+	uint32_t header_table_size;        /*!< the size of the HPACK dynamic table used by the peer encoder */
+	uint32_t max_request_size;         /*!< the maximum size of a request, including the header list and the body */
+} module_http2_conn_conf_t;
+
+/**
+ * @brief the callback function used to flush the queued frames
+ * @param data the bytes to write
+ * @param size the number of bytes to write
+ * @param ctx the additional context
+ * @return the number of bytes that has been written, or error code
+ **/
+typedef size_t (*module_http2_conn_write_func_t)(const void* data, size_t size, void* ctx);
+
+/**
+ * @brief create a new HTTP/2 connection
+ * @details the server connection preface (our SETTINGS frame) is queued once the connection is created
+ * @param conf the connection configuration
+ * @return the newly created connection, NULL on error case
+ **/
+module_http2_conn_t* module_http2_conn_new(const module_http2_conn_conf_t* conf);
+
+/**
+ * @brief dispose a connection and all the streams
+ * @param conn the connection to dispose
+ * @return status code
+ **/
+int module_http2_conn_free(module_http2_conn_t* conn);
+
+/**
+ * @brief process the bytes received from the peer
+ * @details the protocol errors are not reported as error code, instead, the connection queues a GOAWAY
+ *          frame and stops processing any further input. Use module_http2_conn_closing to check this
+ * @param conn the connection
+ * @param data the bytes received
+ * @param size the number of bytes
+ * @return status code
+ **/
+int module_http2_conn_feed(module_http2_conn_t* conn, const void* data, size_t size);
+
+/**
+ * @brief pop a stream that has received the complete request
+ * @details after the stream is returned, the ownership is shared between the connection and the caller,
+ *          and the stream won't be disposed until module_http2_stream_done is called
+ * @param conn the connection
+ * @return the stream, NULL if there's no more stream ready
+ **/
+module_http2_stream_t* module_http2_conn_next_request(module_http2_conn_t* conn);
+
+/**
+ * @brief check if the connection has a stream which has received the complete request
+ * @details this doesn't pop the stream, use module_http2_conn_next_request to get it
+ * @param conn the connection
+ * @return the check result or error code
+ **/
+int module_http2_conn_has_request(const module_http2_conn_t* conn);
+
+/**
+ * @brief write all the queued frames with the given write function
+ * @param conn the connection
+ * @param func the write function
+ * @param ctx the additional context passed to the write function
+ * @return the number of bytes that are still queued, or error code
+ **/
+size_t module_http2_conn_flush(module_http2_conn_t* conn, module_http2_conn_write_func_t func, void* ctx);
+
+/**
+ * @brief check if the connection is going away
+ * @details this is true when either side has sent a GOAWAY frame, the caller should close the connection
+ *          once there's no stream which is being served
+ * @param conn the connection
+ * @return the check result or error code
+ **/
+int module_http2_conn_closing(const module_http2_conn_t* conn);
+
+/**
+ * @brief get the id of the stream
+ * @param stream the stream
+ * @return the stream id or error code
+ **/
+uint32_t module_http2_stream_id(const module_http2_stream_t* stream);
+
+/**
+ * @brief read the HTTP/1.1 request translated from the stream
+ * @param stream the stream
+ * @param buf the buffer
+ * @param size the size of the buffer
+ * @return the number of bytes read or error code
+ **/
+size_t module_http2_stream_read(module_http2_stream_t* stream, void* buf, size_t size);
+
+/**
+ * @brief put back the bytes after the offset of the last read
+ * @param stream the stream
+ * @param offset the offset in the last read buffer
+ * @return status code
+ **/
+int module_http2_stream_eom(module_http2_stream_t* stream, size_t offset);
+
+/**
+ * @brief check if the translated request has been entirely consumed
+ * @param stream the stream
+ * @return the check result or error code
+ **/
+int module_http2_stream_eof(const module_http2_stream_t* stream);
+
+/**
+ * @brief write the HTTP/1.1 response of the stream
+ * @details the response is translated to a HEADERS frame and DATA frames. The DATA frames exceed the
+ *          flow control window are kept in the stream and sent once the peer opens the window. <br/>
+ *          The bytes kept this way are limited to a small multiple of the peer window, both for the stream and
+ *          for the connection. Once the limit is reached, the body bytes are not consumed, and the caller should
+ *          write the rest after the peer opens the window.
+ * @param conn the connection
+ * @param stream the stream
+ * @param data the response bytes
+ * @param size the number of bytes
+ * @return the number of bytes consumed, which may be less than size, or error code
+ **/
+size_t module_http2_stream_write(module_http2_conn_t* conn, module_http2_stream_t* stream, const void* data, size_t size);
+
+/**
+ * @brief finish the stream
+ * @details if the response is complete, the stream is ended with END_STREAM flag, otherwise the stream
+ *          is reset. After this call, the stream object is owned by the connection only.
+ * @param conn the connection
+ * @param stream the stream
+ * @param error if the stream has been served with error
+ * @return status code
+ **/
+int module_http2_stream_done(module_http2_conn_t* conn, module_http2_stream_t* stream, int error);
+
+#endif /* __PLUMBER_MODULE_HTTP2_CONN_H__ */
@@ -0,0 +1,79 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+/**
+ * @brief The HPACK header compression used by the HTTP/2 module
+ * @details The decoder implements the full RFC 7541, including the static table, the dynamic table and
+ *          the Huffman code. The encoder never touches the dynamic table, it emits either an indexed field
+ *          for a static table entry, or a literal field without indexing. Thus the encoder is stateless and
+ *          the responses of different streams can be encoded concurrently.
+ * @file module/http2/hpack.h
+ **/
+#ifndef __PLUMBER_MODULE_HTTP2_HPACK_H__
+#define __PLUMBER_MODULE_HTTP2_HPACK_H__
+
+/**
+ * @brief the HPACK decoder, which maintains the dynamic table of a connection
+ **/
+typedef struct _module_http2_hpack_decoder_t module_http2_hpack_decoder_t;
+
+/**
+ * @brief the callback function that receives a decoded header field
+ * @param name the field name
+ * @param name_len the length of the field name
+ * @param value the field value
+ * @param value_len the length of the field value
+ * @param data the additional data
+ * @note the name and value are not NUL-terminated, and they are only valid during the callback
+ * @return status code, the error code aborts the decoding
+ **/
+typedef int (*module_http2_hpack_field_func_t)(const char* name, size_t name_len, const char* value, size_t value_len, void* data);
+
+/**
+ * @brief the upper bound of the bytes that the encoder needs for a single header field
+ * @param name_len the length of the field name
+ * @param value_len the length of the field value
+ **/
+#define MODULE_HTTP2_HPACK_ENCODE_SIZE(name_len, value_len) ((name_len) + (value_len) + 12)
+
+/**
+ * @brief create a new HPACK decoder
+ * @param max_table_size the maximum size of the dynamic table, which is the SETTINGS_HEADER_TABLE_SIZE we advertise
+ * @return the newly created decoder, NULL on error case
+ **/
+module_http2_hpack_decoder_t* module_http2_hpack_decoder_new(uint32_t max_table_size);
+
+/**
+ * @brief dispose the HPACK decoder
+ * @param decoder the decoder to dispose
+ * @return status code
+ **/
+int module_http2_hpack_decoder_free(module_http2_hpack_decoder_t* decoder);
+
+/**
+ * @brief decode a complete header block
+ * @details the header block should be decoded even if the stream is going to be rejected, otherwise the
+ *          dynamic table runs out of sync with the peer
+ * @param decoder the decoder
+ * @param block the header block
+ * @param size the size of the header block
+ * @param func the callback function that receives the decoded fields
+ * @param data the additional data passed to the callback function
+ * @return status code, the error code should be treated as a COMPRESSION_ERROR of the connection
+ **/
+int module_http2_hpack_decode(module_http2_hpack_decoder_t* decoder, const uint8_t* block, size_t size,
+                              module_http2_hpack_field_func_t func, void* data);
+
+/**
+ * @brief encode a single header field
+ * @param name the field name, which should be lower case already
+ * @param name_len the length of the field name
+ * @param value the field value
+ * @param value_len the length of the field value
+ * @param buf the output buffer
+ * @param size the size of the output buffer, MODULE_HTTP2_HPACK_ENCODE_SIZE is always large enough
+ * @return the number of bytes written to the buffer, or error code
+ **/
+size_t module_http2_hpack_encode(const char* name, size_t name_len, const char* value, size_t value_len, uint8_t* buf, size_t size);
+
+#endif /* __PLUMBER_MODULE_HTTP2_HPACK_H__ */
@@ -0,0 +1,14 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+
+/**
+ * @brief the module header that declare this module
+ * @file http2/module.h
+ **/
+#ifndef __MODULE_HTTP2_MODULE_H__
+#define __MODULE_HTTP2_MODULE_H__
+
+extern itc_module_t module_http2_module_def;
+
+#endif /* __MODULE_HTTP2_MODULE_H__ */
@@ -35,7 +35,8 @@ enum {
 	MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_CLOSE,  /*!< Close a RLS stream */
 	MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_EOF,    /*!< Check if the stream has reached the end */
 	MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_READ,   /*!< Read the stream */
-	MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_READY_EVENT  /*!< Query the ready event */
+	MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_READY_EVENT, /*!< Query the ready event */
+	MODULE_PSSM_MODULE_OPCODE_SCOPE_ARENA_ALLOC         /*!< Allocate memory from the arena of current request scope */
 };
 
 #endif /* __PLUMBER_MODULE_PSSM_MODULE_H__ */
@@ -0,0 +1,40 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+/**
+ * @brief the API header for TCP module
+ **/
+
+#ifndef __MODULE_TCP_API_H__
+#define __MODULE_TCP_API_H__
+
+/**
+ * @brief the module prefix used by TCP module
+ **/
+#define MODULE_TCP_API_MODULE_PREFIX "pipe.tcp"
+
+/**
+ * @brief the macro for the redelivery request. Once the connection is released, the next
+ *        accept returns it again, even though there's no new bytes from the peer.
+ *        This is used when the caller has already read the bytes but haven't served them yet
+ **/
+#define MODULE_TCP_CNTL_REDELIVER_RAW 0x0
+
+#	ifdef __PSERVLET__
+/**
+ * @brief define the getter function
+ **/
+PIPE_DEFINE_MOD_OPCODE_GETTER(MODULE_TCP_API_MODULE_PREFIX, MODULE_TCP_CNTL_REDELIVER_RAW);
+
+/**
+ * @brief the opcode used by the servlet
+ **/
+#		define MODULE_TCP_CNTL_REDELIVER PIPE_MOD_OPCODE(MODULE_TCP_CNTL_REDELIVER_RAW)
+
+#	else /* __PSERVLET__ */
+
+#		define MODULE_TCP_CNTL_REDELIVER MODULE_TCP_CNTL_REDELIVER_RAW
+
+#	endif /* __PSERVLET__ */
+
+#endif /* __MODULE_TCP_API_H__ */
@@ -30,6 +30,20 @@
  **/
 typedef struct _module_tcp_async_loop_t module_tcp_async_loop_t;
 
+/**
+ * @brief the previous declaration of the scatter-gather IO vector
+ **/
+struct iovec;
+
+/**
+ * @brief the statistics of an async loop
+ **/
+typedef struct {
+	uint64_t num_syscalls;   /*!< the number of write system calls (write, writev and sendfile) issued by the loop */
+	uint64_t num_bytes;      /*!< the number of bytes has been written by the loop */
+	uint64_t num_finished;   /*!< the number of async write operations (responses) the loop has completed */
+} module_tcp_async_stat_t;
+
 /**
  * @brief the data source callback
  * @param conn_id the id of connection object invokes this function
@@ -40,6 +54,45 @@ typedef struct _module_tcp_async_loop_t module_tcp_async_loop_t;
  **/
 typedef size_t (*module_tcp_async_write_data_func_t)(uint32_t conn_id, void* buffer, size_t size, module_tcp_async_loop_t* caller);
 
+/**
+ * @brief the scatter-gather data source callback
+ * @details Instead of copying the data to the IO buffer, this callback exposes the pending bytes in the data handle
+ *          as IO vectors, so that the async loop is able to write them with a single writev call. <br/>
+ *          The callback is called only when all the bytes returned by the data source callback has been written.
+ *          The memory referred by the IO vectors should be valid until the bytes are consumed.
+ * @param conn_id the id of connection object invokes this function
+ * @param iov the IO vector buffer
+ * @param iovcnt the size of the IO vector buffer
+ * @param caller the caller async object
+ * @return the number of IO vectors has been returned, 0 if the next bytes should be read with the data source callback,
+ *         or error code
+ **/
+typedef uint32_t (*module_tcp_async_write_iov_func_t)(uint32_t conn_id, struct iovec* iov, uint32_t iovcnt, module_tcp_async_loop_t* caller);
+
+/**
+ * @brief the callback that is used to tell the data handle how many bytes exposed by the scatter-gather data source
+ *        callback has been written
+ * @param conn_id the id of connection object invokes this function
+ * @param nbytes the number of bytes has been written
+ * @param caller the caller async object
+ * @return status code
+ **/
+typedef int (*module_tcp_async_write_consume_func_t)(uint32_t conn_id, size_t nbytes, module_tcp_async_loop_t* caller);
+
+/**
+ * @brief the zero-copy data source callback
+ * @details This is called only when all the bytes previously returned by the data source callback has been written,
+ *          and it gives the data handle a chance to hand off a file region, which the async loop transfers with the
+ *          zero-copy system call. Once the region is returned, the bytes in the region are considered consumed by the
+ *          data handle, and the async loop won't ask for any data until the region is completely written. <br/>
+ *          The file descriptor in the region should be valid until the next call of the data source callback.
+ * @param conn_id the id of connection object invokes this function
+ * @param region_buf the buffer used to return the file region
+ * @param caller the caller async object
+ * @return 1 if a region is returned, 0 if the next bytes should be read with the data source callback, or error code
+ **/
+typedef int (*module_tcp_async_write_region_func_t)(uint32_t conn_id, itc_module_data_source_region_t* region_buf, module_tcp_async_loop_t* caller);
+
 /**
  * @brief the callback function to dispose an asnyc write handle
  * @param conn_id the id of connection object invokes this function
@@ -95,6 +148,10 @@ int module_tcp_async_loop_free(module_tcp_async_loop_t* loop);
  * @param fd the underlying socket fd
  * @param buf_size the async write buffer size
  * @param get_data the callback function that feeds data
+ * @param get_region the callback function that hands off a file region for zero-copy write, NULL if zero-copy is not supported
+ * @param get_iov the callback function that exposes the pending bytes as IO vectors, NULL if scatter-gather IO is not supported
+ * @param consume the callback function that consumes the bytes exposed by get_iov, must be given if get_iov is not NULL
+ * @param empty the callback function that checks if the data handle has pending bytes
  * @param cleanup  the callback function that do cleanup
  * @param onerror  the error handler
  * @param handle   the caller-defined handle for this async
@@ -103,6 +160,9 @@ int module_tcp_async_loop_free(module_tcp_async_loop_t* loop);
 int module_tcp_async_write_register(module_tcp_async_loop_t* loop,
                                     uint32_t conn_id, int fd, size_t buf_size,
                                     module_tcp_async_write_data_func_t get_data,
+                                    module_tcp_async_write_region_func_t get_region,
+                                    module_tcp_async_write_iov_func_t get_iov,
+                                    module_tcp_async_write_consume_func_t consume,
                                     module_tcp_async_write_empty_func_t empty,
                                     module_tcp_async_write_cleanup_func_t cleanup,
                                     module_tcp_async_write_error_func_t onerror,
@@ -168,4 +228,13 @@ int module_tcp_async_set_data_event(module_tcp_async_loop_t* loop, uint32_t conn
  **/
 int module_tcp_async_clear_data_event(module_tcp_async_loop_t* loop, uint32_t conn_id);
 
+/**
+ * @brief get the statistics of the async loop
+ * @note the counters are updated by the loop thread without any lock, so the result is only a snapshot
+ * @param loop the async loop
+ * @param buf the buffer used to return the result
+ * @return status code
+ **/
+int module_tcp_async_get_stat(const module_tcp_async_loop_t* loop, module_tcp_async_stat_t* buf);
+
 #endif /*__MODULE_TCP_ASYNC__*/
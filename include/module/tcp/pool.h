@@ -36,6 +36,21 @@
  **/
 #define MODULE_TCP_POOL_RELEASE_MODE_WAIT_FOR_DATA 3
 
+/**
+ * @brief all the forked pools share the listening socket of the master pool
+ **/
+#define MODULE_TCP_POOL_REUSEPORT_NONE 0
+/**
+ * @brief each forked pool binds its own SO_REUSEPORT socket and the kernel balances the connections by hashing
+ **/
+#define MODULE_TCP_POOL_REUSEPORT_HASH 1
+/**
+ * @brief same as MODULE_TCP_POOL_REUSEPORT_HASH, but the connection is steered to the socket selected by the CPU
+ *        that handles the incoming packet
+ * @note this is only supported on Linux, and it only makes sense when the number of CPUs is a multiple of the
+ *       number of event loops
+ **/
+#define MODULE_TCP_POOL_REUSEPORT_CPU  2
 /**
  * @brief the TCP connection pool object
  **/
@@ -50,6 +65,7 @@ typedef struct {
 	time_t      min_timeout;/*!< the minimum time out vlaue */
 	int         tcp_backlog;/*!< the backlog value for the tcp connection */
 	int         reuseaddr;  /*!< indicates if we want to reuse the binding address */
+	int         reuseport;  /*!< how the forked pools listen to the port, see MODULE_TCP_POOL_REUSEPORT_* */
 	int         ipv6;       /*!< indicates we want to bind to a ipv6 address */
 	uint32_t    size;       /*!< the maximum number of connections the pool can hold*/
 	const char* bind_addr;  /*!< the bind address */
@@ -77,7 +93,9 @@ module_tcp_pool_t* module_tcp_pool_new(void);
  * @brief Fork an existing TCP pool.
  * @details This will create another connection pool listening to the same TCP port.
  *          This is used when the event loop becomes a bottelneck, thus we want to
- *          use multiple event loop for the same socket FD
+ *          use multiple event loop for the same socket FD. <br/>
+ *          If the reuseport mode is enabled in the master's configuration, the forked pool
+ *          binds its own listening socket with SO_REUSEPORT instead of sharing the master's
  * @return the newly created connection pool object, or NULL on error
  **/
 module_tcp_pool_t* module_tcp_pool_fork(module_tcp_pool_t* pool);
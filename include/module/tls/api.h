@@ -25,6 +25,12 @@
  **/
 #define MODULE_TLS_CNTL_ALPNPROTO_RAW 0x1
 
+/**
+ * @brief The macro for the redelivery request, which is forwarded to the transportation layer
+ * @note see MODULE_TCP_CNTL_REDELIVER_RAW for details
+ **/
+#define MODULE_TLS_CNTL_REDELIVER_RAW 0x2
+
 #	ifdef __PSERVLET__
 /**
  * @brief define the getter function
@@ -36,6 +42,11 @@ PIPE_DEFINE_MOD_OPCODE_GETTER(MODULE_TLS_API_MODULE_PREFIX, MODULE_TLS_CNTL_ENCR
  **/
 PIPE_DEFINE_MOD_OPCODE_GETTER(MODULE_TLS_API_MODULE_PREFIX, MODULE_TLS_CNTL_ALPNPROTO_RAW);
 
+/**
+ * @brief The redelivery request
+ **/
+PIPE_DEFINE_MOD_OPCODE_GETTER(MODULE_TLS_API_MODULE_PREFIX, MODULE_TLS_CNTL_REDELIVER_RAW);
+
 /**
  * @brief the opcode used by the servlet
  **/
@@ -46,12 +57,19 @@ PIPE_DEFINE_MOD_OPCODE_GETTER(MODULE_TLS_API_MODULE_PREFIX, MODULE_TLS_CNTL_ALPN
  **/
 #		define MODULE_TLS_CNTL_ALPNPROTO  PIPE_MOD_OPCODE(MODULE_TLS_CNTL_ALPNPROTO_RAW)
 
+/**
+ * @brief The opcode used to request the redelivery of the connection
+ **/
+#		define MODULE_TLS_CNTL_REDELIVER  PIPE_MOD_OPCODE(MODULE_TLS_CNTL_REDELIVER_RAW)
+
 #	else /* __PSERVLET__ */
 
 #		define MODULE_TLS_CNTL_ENCRYPTION MODULE_TLS_CNTL_ENCRYPTION_RAW
 
 #		define MODULE_TLS_CNTL_ALPNPROTO  MODULE_TLS_CNTL_ALPNPROTO_RAW
 
+#		define MODULE_TLS_CNTL_REDELIVER  MODULE_TLS_CNTL_REDELIVER_RAW
+
 #	endif /* __PSERVLET__ */
 
 #endif /* __MODULE_TLS_API_H__ */
@@ -0,0 +1,63 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+/**
+ * @brief The TLS handshake thread pool
+ * @details The handshake involves the expensive public key operations, which starves the data transfer
+ *          on the established connections if it runs on the thread that serves the connection. This
+ *          is the bounded thread pool that runs the handshake steps, so that only the connection that has
+ *          finished the handshake is returned to the normal data path.
+ * @file   module/tls/handshake.h
+ **/
+#include <constants.h>
+
+#if !defined(__PLUMBER_MODULE_TLS_HANDSHAKE_H__) && MODULE_TLS_ENABLED
+#define __PLUMBER_MODULE_TLS_HANDSHAKE_H__
+
+/**
+ * @brief the handshake thread pool
+ **/
+typedef struct _module_tls_handshake_pool_t module_tls_handshake_pool_t;
+
+/**
+ * @brief the callback function that processes a handshake job
+ * @param job the job to process
+ * @param data the additional data passed to the pool
+ * @note the callback function takes the ownership of the job
+ * @return nothing
+ **/
+typedef void (*module_tls_handshake_func_t)(void* job, void* data);
+
+/**
+ * @brief create a new handshake thread pool
+ * @param nthreads the number of handshake threads
+ * @param queue_size the maximum number of jobs waiting for the handshake threads
+ * @param step the callback function that performs the handshake step
+ * @param cancel the callback function that disposes a job which has not been processed when the pool is disposed
+ * @param data the additional data passed to the callback functions
+ * @return the newly created pool or NULL on error case
+ **/
+module_tls_handshake_pool_t* module_tls_handshake_pool_new(uint32_t nthreads, uint32_t queue_size,
+                                                           module_tls_handshake_func_t step,
+                                                           module_tls_handshake_func_t cancel,
+                                                           void* data);
+
+/**
+ * @brief post a new job to the handshake thread pool
+ * @param pool the handshake thread pool
+ * @param job the job to post
+ * @note the ownership of the job is transferred to the pool only when the function returns 1
+ * @return 1 if the job has been posted, 0 if the queue is full, or error code
+ **/
+int module_tls_handshake_pool_post(module_tls_handshake_pool_t* pool, void* job);
+
+/**
+ * @brief dispose the handshake thread pool
+ * @details this function stops and joins all the handshake threads, and the jobs that have not been processed
+ *          are disposed with the cancel callback
+ * @param pool the handshake thread pool
+ * @return status code
+ **/
+int module_tls_handshake_pool_free(module_tls_handshake_pool_t* pool);
+
+#endif /* __PLUMBER_MODULE_TLS_HANDSHAKE_H__ */
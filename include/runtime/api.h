@@ -387,6 +387,18 @@ typedef struct {
 	int32_t   timeout; /*!< The time limit for the RLS token not gets ready */
 } runtime_api_scope_ready_event_t;
 
+/**
+ * @brief The file region that backs the remaining bytes of a scope stream
+ * @details When the byte stream is actually a range of a regular file, the stream can expose the file region
+ *          instead of copying the bytes to the caller's buffer. This allows the module writes the content
+ *          to the socket with the zero-copy system calls, for example sendfile
+ **/
+typedef struct {
+	int       fd;     /*!< The file descriptor of the regular file, it's owned by the stream and valid until the stream gets closed */
+	uint64_t  offset; /*!< The offset of the first byte in the region */
+	size_t    size;   /*!< The number of bytes in the region */
+} runtime_api_scope_file_region_t;
+
 /**
  * @brief Represent an entity in the scope. It's actually a group of callback function for the opeartion
  *        that is supported by the scope entity and a memory address which represent the entity data
@@ -455,6 +467,18 @@ typedef struct {
 	 **/
 	int (*event_func)(void* __restrict handle, runtime_api_scope_ready_event_t* event_buf);
 
+	/**
+	 * @brief Take the remaining bytes of the stream as a file region
+	 * @details This is the optional callback. Once the function returns a region, all the bytes in the region
+	 *          are treated as consumed by the stream, which means the stream reaches the end-of-stream, and
+	 *          the caller is responsible for transferring the bytes in the region.
+	 * @param handle The stream handle
+	 * @param region_buf The buffer used to return the file region
+	 * @return 1 if the region has been returned, 0 if the stream is not backed by a file region at this point
+	 *         and error code for all the error cases
+	 **/
+	int (*region_func)(void* __restrict handle, runtime_api_scope_file_region_t* region_buf);
+
 	/**
 	 * @brief close a used stream handle
 	 * @param handle the handle to close
@@ -504,7 +528,10 @@ typedef struct {
 	 * @param count the number of bytes is available at this time
 	 * @return the number of bytes handled by this call, if the return value is larger than 0 and the requested size
 	 *         limit not reach, then the remaning data from the token stream will keep sent to the handler, until
-	 *         it returns an error code or 0
+	 *         it returns an error code or 0. <br/>
+	 *         If the data request stops before the limit because the token stream is waiting for more data, the handler
+	 *         is called with count 0 before the DRA takes the remaining portion, so the caller should flush the buffered
+	 *         bytes at this point, otherwise the buffered bytes will be written after the remaining portion of the stream
 	 **/
 	size_t (*data_handler)(void* __restrict context, const void* __restrict data, size_t count);
 } runtime_api_scope_token_data_request_t;
@@ -518,6 +545,13 @@ typedef struct {
  **/
 typedef int (*runtime_api_pipe_type_callback_t)(runtime_api_pipe_t pipe, const char* type_name, void* data);
 
+/**
+ * @brief The generic function pointer type for a service module function that can be called directly
+ * @details The actual signature of the function is defined by the service module, and the caller should
+ *          cast it to the typed function pointer before calling it
+ **/
+typedef void (*runtime_api_module_func_t)(void);
+
 /**
  * @brief The return value for the servlet's init function, which indicates the property of the servlet
  **/
@@ -715,6 +749,19 @@ typedef struct {
 	 * @return status code
 	 **/
 	int (*async_cntl)(runtime_api_async_handle_t* async_handle, uint32_t opcode, va_list ap);
+
+	/**
+	 * @brief bind a service module function reference to the C function that implements it
+	 * @details Calling a service module function with cntl needs to go through the ITC layer and the module's invoke callback
+	 *          with a va_list, which is too expensive for the functions like memory allocation. If the service module
+	 *          exposes the function address, the servlet can call the function directly once the reference is bound. <br/>
+	 *          The signature of the function is defined by the service module, and it takes the same arguments as the
+	 *          invoke call in the same order.
+	 * @param func the service module function reference returned by get_module_func
+	 * @param result the buffer used to return the function address, NULL if the function doesn't support direct call
+	 * @return status code
+	 **/
+	int (*bind_module_func)(runtime_api_pipe_t func, runtime_api_module_func_t* result);
 } runtime_api_address_table_t;
 
 /**
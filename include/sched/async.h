@@ -6,26 +6,19 @@
  * @details The async task is the task that do not actually
  *          occupies the worker thread. Instead, it runs with the
  *          async task thread pool, and when the task is done the
- *          async task thread will emit a task event which will be able to
- *          wake the pending task up in the scheduler task. <br/>
+ *          async task thread will deliver the completion to the scheduler loop
+ *          which owns the task directly, which wakes the pending task up in the scheduler. <br/>
  *          This mechamism is useful, if we need to performe some slow operation in
- *          a servlet. Because this types of task won't block the worker thread
- * @note    The task event may not be sucessfully dispatched, so we need something to make sure it doesn't
- *          block the dispatcher when this happend first time.
- *          If an async task's downstream blocks the schceduler thread, and during the async task running,
- *          a lot of requests have been sent to the scheduler, and those tasks will create another async task
- *          as an result, there will be a lot of async task compeletion event raised after times.
- *          The worst case is, the event has filled up the scheduler event queue and global event queue.
- *          As the result of this worst case, no scheduler thread is able to move on.
+ *          a servlet. Because this types of task won't block the worker thread. <br/>
+ *          The async task thread pool is elastic, it starts with scheduler.async.min_threads threads,
+ *          and grows up to scheduler.async.max_threads threads when the async task queue is deeper
+ *          than the number of idle threads. The threads exit after being idle for scheduler.async.idle_timeout
+ *          seconds, until the pool shrinks to its minimal size.
+ * @note    The completion doesn't go through the event queue and the dispatcher, and it's embedded in the
+ *          task handle, so the delivery never fails. However a long running async task still holds the
+ *          request which is waiting for it, thus it can still make the entire server freeze.
  *
- *          The desigin decision of this is, we currently just ignore this situation, because, it's really rare
- *          that we could have too many task that block all the queue. In addition, because the service graph has
- *          finite nodes, and the size of scheduler queue is finite. Which means the async task can be blocked in
- *          the event queue can not be larger than a constant. This means at least we can avoid this by adjusting
- *          the event queue size.
- *
- *          TODO: But ideally we could have some mechanism to address this even tough the event queue isn't large engouh
- *          to avoid this. It seems the best candicate of the mechanism is allow each task has a time limit, and if the
+ *          TODO: Ideally we could have some mechanism to address this. It seems the best candicate of the mechanism is allow each task has a time limit, and if the
  *          task timed out it will be killed. However, this introduces an serious issue about the how to clean the killed
  *          task. Since we share the address space, we don't have a chance to dispose all the allocated memory. However,
  *          we can provide a way for the servlet author to address this.
@@ -35,7 +28,7 @@
  *          python and other GC language, it could have a lot of work to do. But at least when a native servlet is killed
  *          it has the chance to do the correct thing.
  *
- *          After we have the timeout mechanism, we not only solve the async dispatching problem, but also the long running
+ *          After we have the timeout mechanism, the long running
  *          task won't make the entire server freeze anymore.
  **/
 #ifndef __SCHED_ASYNC_H__
@@ -10,6 +10,19 @@
  **/
 typedef struct _sched_loop_t sched_loop_t;
 
+/**
+ * @brief The async task completion which is delivered to the scheduler loop that owns the task
+ * @note The async task processor embeds this in the async task handle, so delivering the completion
+ *       doesn't need any memory allocation and never fails because the queue is full. The scheduler
+ *       loop copies the task and the handle out before it runs the cleanup task, thus the completion
+ *       is valid until the handle gets disposed
+ **/
+typedef struct _sched_loop_async_completion_t {
+	struct _sched_loop_async_completion_t* next;   /*!< The next completion in the list, used by the scheduler loop only */
+	struct _sched_task_t*                   task;   /*!< The scheduler task which is waiting for the async task */
+	runtime_api_async_handle_t*            handle; /*!< The async task handle */
+} sched_loop_async_completion_t;
+
 /**
  * @brief start scheduler loop
  * @param service the service to run
@@ -67,4 +80,16 @@ int sched_loop_deploy_service_object(sched_service_t* service);
  * @return If the deployment is completed, or error code
  **/
 int sched_loop_deploy_completed(void);
+
+/**
+ * @brief Deliver an async task completion to the scheduler loop directly
+ * @details Instead of going through the event queue and the dispatcher, the completion is pushed to
+ *          the lock-free completion list of the scheduler loop, and the worker thread gets waken up
+ *          if it's sleeping
+ * @param loop The scheduler loop that owns the task
+ * @param completion The completion to deliver
+ * @note This function can be called from any thread
+ * @return status code
+ **/
+int sched_loop_async_completed(sched_loop_t* loop, sched_loop_async_completion_t* completion);
 #endif /* __PLUMBER_SCHED_LOOP_H__ */
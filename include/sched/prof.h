@@ -4,21 +4,78 @@
 /**
  * @brief The plumber built-in profiler utilies
  * @note the profiler utilities will be controlled by the
- *       variable scheduler.prof.enabled = 0 / 1
+ *       variable profiler.enabled = 0 / 1, and the human readable
+ *       summary of all the live profilers can be read from profiler.dump
  * @file sched/prof.h
  **/
 #ifndef __PLUMBER_SCHED_PROF_H__
 #define __PLUMBER_SCHED_PROF_H__
+/**
+ * @brief the number of bits used for the linear sub-buckets in each power-of-two range of the histogram
+ **/
+#define SCHED_PROF_HIST_SUB_BITS 2
+
+/**
+ * @brief the largest power of two we can distinguish in the histogram, the time longer than this goes to the last bucket
+ **/
+#define SCHED_PROF_HIST_MAX_BITS 40
+
+/**
+ * @brief the number of buckets in the log-linear latency histogram
+ **/
+#define SCHED_PROF_HIST_NBUCKETS ((SCHED_PROF_HIST_MAX_BITS - SCHED_PROF_HIST_SUB_BITS + 1) << SCHED_PROF_HIST_SUB_BITS)
+
 /**
  * @brief the data structure used in the profiler file
+ * @details Each record is the cumulative data of a node or a pipe on a thread since the profiler
+ *          is created, so the latest record for each &lt;thread, node, pipe&gt; tuple is the only one matters. <br/>
+ *          The CPU time is the time consumed by the thread itself, the wall time includes the time the
+ *          thread is blocked or preempted.<br/>
+ *          For the node record, the time is the time used by the servlet execution, for the pipe record,
+ *          the time is the time used by the scheduler to initialize the pipe
  **/
 typedef struct {
-	uint32_t                thread;  /*!< the thread id */
-	sched_service_node_id_t node;    /*!< the node id */
-	uint64_t                time;    /*!< the time used by this node */
-	uint64_t                count;   /*!< the number of execution of this node */
+	uint32_t                thread;                              /*!< the thread id */
+	sched_service_node_id_t node;                                /*!< the node id */
+	uint32_t                pipe;                                /*!< the index in the outgoing list of the node, or error code for the node record */
+	uint64_t                count;                               /*!< the number of execution of this node */
+	uint64_t                cpu_time;                            /*!< the thread CPU time used by this node in ns */
+	uint64_t                wall_time;                           /*!< the wall clock time used by this node in ns */
+	uint64_t                cpu_hist[SCHED_PROF_HIST_NBUCKETS];  /*!< the histogram of the CPU time */
+	uint64_t                wall_hist[SCHED_PROF_HIST_NBUCKETS]; /*!< the histogram of the wall clock time */
 } sched_prof_record_t;
 
+/**
+ * @brief get the histogram bucket for the given time
+ * @param ns the time in nanoseconds
+ * @return the bucket index
+ **/
+static inline uint32_t sched_prof_hist_bucket(uint64_t ns)
+{
+	if(ns < (1ull << SCHED_PROF_HIST_SUB_BITS)) return (uint32_t)ns;
+	if(ns >= (1ull << SCHED_PROF_HIST_MAX_BITS)) return SCHED_PROF_HIST_NBUCKETS - 1;
+
+	uint32_t exp = 63u - (uint32_t)__builtin_clzll(ns);
+	uint32_t sub = (uint32_t)(ns >> (exp - SCHED_PROF_HIST_SUB_BITS)) & ((1u << SCHED_PROF_HIST_SUB_BITS) - 1);
+
+	return ((exp - SCHED_PROF_HIST_SUB_BITS + 1) << SCHED_PROF_HIST_SUB_BITS) + sub;
+}
+
+/**
+ * @brief get the lower bound of the time range a histogram bucket represents
+ * @param bucket the bucket index
+ * @return the lower bound in nanoseconds
+ **/
+static inline uint64_t sched_prof_hist_lower_bound(uint32_t bucket)
+{
+	if(bucket < (1u << SCHED_PROF_HIST_SUB_BITS)) return bucket;
+
+	uint32_t exp = (bucket >> SCHED_PROF_HIST_SUB_BITS) + SCHED_PROF_HIST_SUB_BITS - 1;
+	uint64_t sub = bucket & ((1u << SCHED_PROF_HIST_SUB_BITS) - 1);
+
+	return (1ull << exp) | (sub << (exp - SCHED_PROF_HIST_SUB_BITS));
+}
+
 /**
  * @brief the profiler object
  **/
@@ -63,17 +120,37 @@ int sched_prof_free(sched_prof_t* prof);
 int sched_prof_start_timer(sched_prof_t* prof, sched_service_node_id_t node);
 
 /**
- * @brief stop the timer for the node
+ * @brief start the timer for the initialization of an outgoing pipe of the node
+ * @param prof the profiler
+ * @param node current node
+ * @param pipe the index of the pipe in the outgoing list of the node
+ * @return status code
+ **/
+int sched_prof_start_pipe_timer(sched_prof_t* prof, sched_service_node_id_t node, uint32_t pipe);
+
+/**
+ * @brief stop the timer for the node or the pipe
+ * @note the data will be flushed automatically every SCHED_PROF_FLUSH_INTERVAL node executions on each thread
  * @param prof the profiler
  * @return status code
  **/
 int sched_prof_stop_timer(sched_prof_t* prof);
 
 /**
- * @brief flush the profiling data and reset the accumulator for current thread
+ * @brief flush the profiling data of current thread to the profiler output
+ * @note the data is cumulative, so the accumulator won't be reset after flush
  * @param prof the profiler
  * @return status code
  **/
 int sched_prof_flush(sched_prof_t* prof);
 
+/**
+ * @brief dump the human readable summary of the profiling data to the given file descriptor
+ * @details the data is aggregated from all the threads, each line represents either a node or a pipe
+ * @param prof the profiler
+ * @param fd the target file descriptor
+ * @return status code
+ **/
+int sched_prof_dump_fd(sched_prof_t* prof, int fd);
+
 #endif /* __PLUMBER_SCHED_PROF_H__ */
@@ -68,6 +68,18 @@ sched_rscope_t* sched_rscope_new(void);
  **/
 int sched_rscope_free(sched_rscope_t* scope);
 
+/**
+ * @brief allocate memory from the bump pointer arena of the request scope
+ * @details the memory can not be disposed individually, all the memory allocated from the arena is released
+ *          at once when the scope is disposed. If any RLS entity in this scope is opened as a byte stream,
+ *          the arena is kept until the stream gets closed, thus the RLS entity can use the arena memory safely.
+ * @param scope the request scope
+ * @param size the number of bytes to allocate
+ * @note this function should only be called from the thread which owns the scope
+ * @return the allocated memory, which is aligned to 16 bytes, NULL on error case
+ **/
+void* sched_rscope_arena_alloc(sched_rscope_t* scope, size_t size);
+
 /**
  * @brief add a new pointer to the request scope
  * @param scope the request scope
@@ -137,4 +149,13 @@ size_t sched_rscope_stream_read(sched_rscope_stream_t* stream, void* buffer, siz
  * @return The number of events has been returned, or error code
  **/
 int sched_rscope_stream_get_event(sched_rscope_stream_t* stream, runtime_api_scope_ready_event_t* buf);
+
+/**
+ * @brief Take the remaining bytes of the stream as a file region
+ * @param stream The stream object
+ * @param buf The buffer used to return the region
+ * @return 1 if the region has been returned, 0 if the stream can not be represented as a file region
+ *         or error code
+ **/
+int sched_rscope_stream_get_region(sched_rscope_stream_t* stream, runtime_api_scope_file_region_t* buf);
 #endif /* __SCHED_RSCOPE_H__ */
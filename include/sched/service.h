@@ -39,6 +39,20 @@ typedef struct {
 	runtime_api_pipe_id_t destination_pipe_desc; /*!< the pipe descriptor for the output end*/
 } sched_service_pipe_descriptor_t;
 
+/**
+ * @brief the precompiled execution plan of an outgoing pipe
+ * @details Everything the scheduler needs to initialize an outgoing pipe is static once the
+ *          service type checker has done, so we compute them when the service is built and the
+ *          scheduler only needs to read the plan of the node linearly at each step
+ **/
+typedef struct {
+	sched_service_pipe_descriptor_t desc;           /*!< the pipe descriptor */
+	itc_module_pipe_param_t         param;          /*!< the pipe param used to allocate the pipe, args is always NULL */
+	uint32_t                        shadow:1;       /*!< if this pipe is a shadow of another output pipe of the same node */
+	runtime_api_pipe_id_t           shadow_target;  /*!< the target pipe id of the shadow, only valid when this is a shadow */
+	runtime_api_pipe_flags_t        shadow_flags;   /*!< the flags used to fork the shadow pipe, only valid when this is a shadow */
+} sched_service_pipe_plan_t;
+
 /**
  * @brief convert a service to a pipe descriptor, which means treat the entire service as a pipe
  *        which is a input node, input pipe end; a output node, a output pipe end
@@ -148,6 +162,16 @@ const sched_service_pipe_descriptor_t* sched_service_get_incoming_pipes(const sc
  **/
 const sched_service_pipe_descriptor_t* sched_service_get_outgoing_pipes(const sched_service_t* service, sched_service_node_id_t nid, uint32_t* nresult);
 
+/**
+ * @brief get the precompiled execution plan of all outgoing pipes
+ * @note the plan is in the same order as the list returned by sched_service_get_outgoing_pipes
+ * @param service the target service
+ * @param nid the node id
+ * @param nresult the buffer that used to return how many pipe is returned
+ * @return the pointer to the head of the plan, NULL if error happens
+ **/
+const sched_service_pipe_plan_t* sched_service_get_outgoing_plan(const sched_service_t* service, sched_service_node_id_t nid, uint32_t* nresult);
+
 /**
  * @brief set the input pipe of this service buffer
  * @param buffer the target service buffer
@@ -221,6 +245,15 @@ const sched_cnode_info_t* sched_service_get_cnode_info(const sched_service_t* se
  **/
 int sched_service_profiler_timer_start(const sched_service_t* service, sched_service_node_id_t node);
 
+/**
+ * @brief start the profiler timer for the initialization of an outgoing pipe
+ * @param service the target service
+ * @param node the node that owns the pipe
+ * @param pipe the index of the pipe in the outgoing list of the node
+ * @return status code
+ **/
+int sched_service_profiler_pipe_timer_start(const sched_service_t* service, sched_service_node_id_t node, uint32_t pipe);
+
 /**
  * @brief stop the profiler timer
  * @param service the target service
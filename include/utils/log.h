@@ -18,11 +18,18 @@
  * 			 Config file log.conf is used for redirect log to a file. For each log level, we
  * 			 can define an output file, so that we can seperately record log in different  level in
  * 			 different files.
+ *
+ * 			 By default, the log messages are formatted by the calling thread and pushed to a
+ * 			 per-thread ring buffer without any lock, and a writer thread writes them to the log
+ * 			 files. When the buffer is full, the message is dropped and counted. The size of the
+ * 			 buffer can be changed with the "async <size>" line in the config file, and
+ * 			 "async off" makes the messages written synchronously.
  */
 #ifndef __LOG_H__
 #define __LOG_H__
 
 #include <stdarg.h>
+#include <stdint.h>
 
 /** @brief initlaization
  *  @return nothing
@@ -65,6 +72,18 @@ void log_write(int level, const char* file, const char* function, int line, cons
  **/
 void log_write_va(int level, const char* file, const char* function, int line, const char* fmt, va_list ap);
 
+/**
+ * @brief wait until all the log messages written before this call are written to the log files
+ * @return status code
+ **/
+int log_flush(void);
+
+/**
+ * @brief get the number of log messages which have been dropped because the log buffer is full
+ * @return the number of dropped messages
+ **/
+uint64_t log_get_dropped_count(void);
+
 #define __LOG_WRITE__ log_write
 #include <utils/log_macro.h>
 
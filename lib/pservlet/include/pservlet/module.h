@@ -17,6 +17,17 @@
 pipe_t module_require_function(const char* mod_name, const char* func)
     __attribute__((visibility ("hidden")));
 
+/**
+ * @brief bind a service module function reference to the C function that implements it, so that
+ *        the function can be called directly rather than through pipe_cntl
+ * @param func the service module function reference returned by module_require_function
+ * @note the returned function should be casted to the typed function pointer defined by the service module,
+ *       which takes the same arguments as the PIPE_CNTL_INVOKE call
+ * @return the function address, NULL if the function doesn't support direct call or on error case
+ **/
+module_func_t module_bind_function(pipe_t func)
+    __attribute__((visibility ("hidden")));
+
 /**
  * @brief open a module and return the module code
  * @param path the path to the module
@@ -8,6 +8,16 @@ pipe_t module_require_function(const char* mod_name, const char* func)
 	return RUNTIME_ADDRESS_TABLE_SYM->get_module_func(mod_name, func);
 }
 
+module_func_t module_bind_function(pipe_t func)
+{
+	module_func_t ret;
+
+	if(ERROR_CODE(int) == RUNTIME_ADDRESS_TABLE_SYM->bind_module_func(func, &ret))
+		return NULL;
+
+	return ret;
+}
+
 uint8_t module_open(const char* path)
 {
 	return RUNTIME_ADDRESS_TABLE_SYM->mod_open(path);
@@ -342,6 +342,10 @@ static inline size_t _data_req_handle(void* __restrict ctx, const void* __restri
 {
 	pstd_bio_t* bio = (pstd_bio_t*)ctx;
 
+	/* The token stream is waiting, so the rest of the token will be written by the DRA, flush what we have first */
+	if(size == 0)
+		return ERROR_CODE(int) == pstd_bio_flush(bio) ? ERROR_CODE(size_t) : 0;
+
 	memcpy(bio->buf + bio->buf_data_end, data, size);
 	bio->buf_data_end += size;
 
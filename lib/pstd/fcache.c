@@ -8,10 +8,12 @@
 #include <errno.h>
 #include <time.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 
 #include <error.h>
+#include <barrier.h>
 
 #include <pservlet.h>
 
@@ -23,50 +25,83 @@
 
 #include <utils/hash/murmurhash3.h>
 
+#ifdef __LINUX__
+#	include <sys/inotify.h>
+#endif
+
 
 /**
  * @brief the data structure  for a cache entry
  **/
 typedef struct {
 	uint32_t  valid:1;     /*!< if this this a valid cache */
+	uint32_t  fd_backed:1; /*!< if the data is read from the file descriptor rather than loaded to the heap */
+	int       stale;       /*!< if the file watcher has seen a change on the file, modified atomically */
 	time_t    timestamp;   /*!< the timestamp when we load the entry */
 	uint32_t  idx;         /*!< this is just the index of the slot in the slot array, because we should avoid access the thread local multiple times */
 	uint32_t  refcnt;      /*!< how many references do we currently have */
+	uint64_t  tick;        /*!< the stripe tick when the entry is accessed last time, used to pick the victim in the set */
 	size_t    size;        /*!< the number of bytes that has been loaded to cache */
 	uint64_t  hash[2];     /*!< the 128 bit hash code for the filename */
 	uint32_t  lru_prev;    /*!< the previous element in the LRU linked list */
 	uint32_t  lru_next;    /*!< the next element in the LRU linked list */
+	int       fd;          /*!< the file descriptor that backs the data, -1 if the data is on the heap */
+	int       wd;          /*!< the watch descriptor of the file, -1 if the file is not watched */
 #ifdef PSTD_FILE_CACHE_STRICT_KEY_COMP
 	char*     filename;    /*!< the filename of the entry */
 #endif
 	struct stat stat; /*!< the cached stat */
-	int8_t*   data;   /*!< the data pages for this cache */
+	int8_t*   data;   /*!< the data pages for this cache, NULL if the entry is backed by the file descriptor */
 } _cache_entry_t;
 
 /**
- * @brief the first element, which means the latest accessed entry
+ * @brief a lock stripe of the cache
+ * @details Each stripe owns a group of cache sets, and has its own lock, LRU list and size limit. So
+ *          the workers accessing different stripes never contend with each other
  **/
-static __thread uint32_t _lru_first;
+typedef struct {
+	pthread_mutex_t mutex;       /*!< the stripe mutex, only used by the shared cache */
+	uint32_t        lru_first;   /*!< the first element, which means the latest accessed entry */
+	uint32_t        lru_last;    /*!< the last element, which means the element we don't access for the longest time */
+	size_t          data_size;   /*!< the total data size of this stripe */
+	uint64_t        tick;        /*!< the access counter of this stripe */
+} _stripe_t;
 
 /**
- * @brief the last element, which means the element we don't access for the longest time
+ * @brief the file cache
+ * @details The cache is either shared by all the worker threads, or owned by a single thread.
+ *          The entries are organized as a set-associative table, each set has nways slots. <br/>
+ *          For the shared cache, the changes on the cached files are tracked by inotify, so that
+ *          we do not need to stat the file periodically
  **/
-static __thread uint32_t _lru_last;
+typedef struct {
+	uint32_t         shared:1;      /*!< if this cache is shared by all the threads */
+	uint32_t         nsets;         /*!< the number of sets */
+	uint32_t         nways;         /*!< the number of slots in each set */
+	uint32_t         nstripes;      /*!< the number of lock stripes */
+	uint32_t         hash_seed;     /*!< the hash seed we should use */
+	size_t           stripe_limit;  /*!< the size limit of each stripe */
+	int              watch_fd;      /*!< the inotify FD, -1 if the file watcher is not available */
+	pthread_mutex_t  watch_mutex;   /*!< the mutex that makes sure only one thread drains the watch events */
+	uint64_t         watch_ts;      /*!< the timestamp in milliseconds that we drained the watch events last time */
+	_stripe_t*       stripes;       /*!< the stripe array */
+	_cache_entry_t*  entries;       /*!< the cache entries, the set i occupies entries [i * nways, (i + 1) * nways) */
+} _cache_t;
 
 /**
- * @brief the thread cache table we used for each thread
+ * @brief the thread cache table we used for each thread, only used when the cache isn't shared
  **/
-static __thread _cache_entry_t* _cache_table = NULL;
+static __thread _cache_t* _local_cache = NULL;
 
 /**
- * @brief the hash seed we should use
+ * @brief the cache shared by all the threads
  **/
-static __thread uint32_t _hash_seed;
+static _cache_t* _shared_cache = NULL;
 
 /**
- * @brief the total data size for current thread's cache
+ * @brief the mutex used to initialize the shared cache
  **/
-static __thread size_t _data_size = 0;
+static pthread_mutex_t _shared_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /**
  * @brief The actual data structure for a reference to the file cache entry
@@ -86,15 +121,7 @@ struct _pstd_fcache_file_t {
 };
 
 /**
- * @brief get the size of the thread local cache
- * @note  this is currently just return the macro, but later we should make it read the configuration
- * @todo this should be configurable. Currently, we just use the
- *       simple replacement policy: If there's a conflict, then we
- *       replace it. <br/>
- *       Also, the cache is thread local, so that we can avoid the
- *       locks and mutex. But it's still not clear what actually comes out
- *       by this. <br/>
- *       Also, it seems we don't have a way to configure pstd, which is annoying
+ * @brief get the size of the cache
  * return the size in number of elements
  **/
 static inline uint32_t _cache_hash_size(void)
@@ -107,7 +134,7 @@ static inline uint32_t _cache_hash_size(void)
 
 /**
  * @brief get the max time to live for each cache entry
- * @note  this should be configurable, make this read from a config file
+ * @note  this is only used when the file watcher isn't available
  * @return the TTL in seconds
  **/
 static inline uint32_t _cache_ttl(void)
@@ -121,7 +148,6 @@ static inline uint32_t _cache_ttl(void)
 /**
  * @brief get the file cache size limit, which means if the file is larger than the size,
  *        we do not cache it
- * @note  this should be configurable
  * @return the size limit in number of bytes
  **/
 static inline uint32_t _max_file_size(void)
@@ -133,9 +159,8 @@ static inline uint32_t _max_file_size(void)
 }
 
 /**
- * @brief get the max size of the cache for a single thread
- * @note  this should be configurable
- * @return the max size of the thread cache
+ * @brief get the max size of the cache, for the thread local cache, this is the limit of a single thread
+ * @return the max size of the cache
  **/
 static inline size_t _max_cache_size(void)
 {
@@ -145,88 +170,369 @@ static inline size_t _max_cache_size(void)
 	return  max_cache_size;
 }
 
+/**
+ * @brief get the size threshold, the file larger than which will be served from the file descriptor rather than loaded to the heap
+ * @return the threshold in bytes
+ **/
+static inline size_t _mmap_threshold(void)
+{
+	static uint32_t mmap_threshold = ERROR_CODE(uint32_t);
+	if(mmap_threshold == ERROR_CODE(uint32_t))
+		mmap_threshold = (uint32_t)pstd_libconf_read_numeric("pstd.fcache.mmap_threshold", PSTD_FCACHE_DEFAULT_MMAP_THRESHOLD);
+	return mmap_threshold;
+}
+
+/**
+ * @brief get the minimal interval between two times we drain the file watcher events
+ * @return the interval in milliseconds
+ **/
+static inline uint64_t _watch_interval(void)
+{
+	static uint32_t watch_interval = ERROR_CODE(uint32_t);
+	if(watch_interval == ERROR_CODE(uint32_t))
+		watch_interval = (uint32_t)pstd_libconf_read_numeric("pstd.fcache.watch_interval", PSTD_FCACHE_DEFAULT_WATCH_INTERVAL);
+	return watch_interval;
+}
+
+/**
+ * @brief dispose the data of the cache entry
+ * @param entry the cache entry
+ * @return nothing
+ **/
+static inline void _entry_data_free(_cache_entry_t* entry)
+{
+	if(entry->fd_backed)
+	{
+		if(entry->fd >= 0) close(entry->fd);
+	}
+	else if(entry->data != NULL)
+		free(entry->data);
+
+	entry->data = NULL;
+	entry->fd = -1;
+	entry->fd_backed = 0;
+}
+
 /**
  * @brief the callback function that is used to cleanup all the cache entry and the cache table itself
- * @param cache_table the cache_table to dispose
+ * @param cache_mem the cache to dispose
  * @return nothing
  **/
-static void _clean_cache(void* cache_table)
+static void _clean_cache(void* cache_mem)
 {
-	if(NULL == cache_table) return;
-	_cache_entry_t* table = (_cache_entry_t*)cache_table;
+	if(NULL == cache_mem) return;
+	_cache_t* cache = (_cache_t*)cache_mem;
 
 	uint32_t i;
 
-	for(i = 0; i < _cache_hash_size(); i ++)
+	if(NULL != cache->entries)
 	{
-		_cache_entry_t* entry = table + i;
-		if(0 == entry->valid) continue;
+		for(i = 0; i < cache->nsets * cache->nways; i ++)
+		{
+			_cache_entry_t* entry = cache->entries + i;
+			if(0 == entry->valid) continue;
 
-		if(entry->data != NULL) free(entry->data);
+			_entry_data_free(entry);
 
 #ifdef PSTD_FILE_CACHE_STRICT_KEY_COMP
-		if(NULL != entry->filename)
-			free(entry->filename);
+			if(NULL != entry->filename)
+				free(entry->filename);
 #endif
+		}
+		free(cache->entries);
+	}
+
+	if(NULL != cache->stripes)
+	{
+		if(cache->shared)
+			for(i = 0; i < cache->nstripes; i ++)
+				pthread_mutex_destroy(&cache->stripes[i].mutex);
+		free(cache->stripes);
 	}
 
-	free(table);
+	if(cache->shared)
+		pthread_mutex_destroy(&cache->watch_mutex);
+
+	if(cache->watch_fd >= 0) close(cache->watch_fd);
+
+	free(cache);
 }
 
 /**
- * @brief ensure the thread local cache is initialized
- * @return status code
+ * @brief create a new cache
+ * @param shared if the cache is shared by all the threads
+ * @return the newly created cache or NULL on error
  **/
-static inline int _ensure_thread_init(void)
+static inline _cache_t* _cache_new(int shared)
 {
-	if(_cache_table == NULL)
-	{
-		LOG_DEBUG("The thread local cache is not initialized yet, now doing the initialization");
-		if(NULL == (_cache_table = (_cache_entry_t*)malloc(sizeof(_cache_table[0]) * _cache_hash_size())))
-			ERROR_RETURN_LOG_ERRNO(int, "Can not allocate memory for the thread local cache");
+	uint32_t i;
+	_cache_t* ret = (_cache_t*)calloc(1, sizeof(_cache_t));
+	if(NULL == ret)
+		ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the file cache");
+
+	ret->watch_fd = -1;
+
+	ret->nways = (uint32_t)pstd_libconf_read_numeric("pstd.fcache.num_ways", PSTD_FCACHE_DEFAULT_NUM_WAYS);
+	if(ret->nways == 0 || ret->nways > _cache_hash_size()) ret->nways = 1;
+	ret->nsets = _cache_hash_size() / ret->nways;
+
+	/* The thread local cache doesn't need any lock, so it only has one stripe */
+	ret->nstripes = shared ? (uint32_t)pstd_libconf_read_numeric("pstd.fcache.num_stripes", PSTD_FCACHE_DEFAULT_NUM_STRIPES) : 1;
+	if(ret->nstripes == 0 || ret->nstripes > ret->nsets) ret->nstripes = 1;
+	ret->stripe_limit = _max_cache_size() / ret->nstripes;
+
+	if(NULL == (ret->stripes = (_stripe_t*)calloc(ret->nstripes, sizeof(_stripe_t))))
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the cache stripes");
 
-		uint32_t i;
-		for(i = 0; i < _cache_hash_size(); i ++)
-			_cache_table[i].valid = 0, _cache_table[i].idx = i;
+	for(i = 0; i < ret->nstripes; i ++)
+		ret->stripes[i].lru_first = ret->stripes[i].lru_last = ERROR_CODE(uint32_t);
 
-		if(ERROR_CODE(int) == pstd_onexit(_clean_cache, _cache_table))
+	if(NULL == (ret->entries = (_cache_entry_t*)malloc(sizeof(ret->entries[0]) * ret->nsets * ret->nways)))
+		ERROR_LOG_ERRNO_GOTO(ERR, "Can not allocate memory for the cache table");
+
+	for(i = 0; i < ret->nsets * ret->nways; i ++)
+		ret->entries[i].valid = 0, ret->entries[i].idx = i;
+
+	if(shared)
+	{
+		for(i = 0; i < ret->nstripes; i ++)
+			if((errno = pthread_mutex_init(&ret->stripes[i].mutex, NULL)) != 0)
+			{
+				for(;i > 0; i --)
+					pthread_mutex_destroy(&ret->stripes[i - 1].mutex);
+				ERROR_LOG_ERRNO_GOTO(ERR, "Cannot initialize the stripe mutex");
+			}
+
+		if((errno = pthread_mutex_init(&ret->watch_mutex, NULL)) != 0)
 		{
-			free(_cache_table);
-			ERROR_RETURN_LOG(int, "Cannot register the cleanup function for the cache table");
+			for(i = 0; i < ret->nstripes; i ++)
+				pthread_mutex_destroy(&ret->stripes[i].mutex);
+			ERROR_LOG_ERRNO_GOTO(ERR, "Cannot initialize the watcher mutex");
 		}
 
-		/* Genereate a random seed, so that the external client won't know how to make collision in our hash table */
-		struct timespec ts;
-		if(clock_gettime(CLOCK_REALTIME, &ts) < 0)
+		ret->shared = 1;
+
+#ifdef __LINUX__
+		if((ret->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+			LOG_WARNING_ERRNO("Cannot create the file watcher, fallback to the TTL based invalidation");
+#endif
+	}
+
+	/* Genereate a random seed, so that the external client won't know how to make collision in our hash table */
+	struct timespec ts;
+	if(clock_gettime(CLOCK_REALTIME, &ts) < 0)
+	{
+		LOG_WARNING("Cannot get the high resolution timestamp, use low resolution one instead");
+		ts.tv_nsec = (long)time(NULL);
+	}
+	srand((unsigned)ts.tv_nsec);
+	/* We need to do this, because the RAND_MAX is not guarenteed fill all the 32 bits up */
+	uint64_t upper_bound = 1;
+	while(upper_bound <= 0xffffffffu)
+	{
+		ret->hash_seed = (uint32_t)rand() + ret->hash_seed * RAND_MAX;
+		upper_bound *= RAND_MAX;
+	}
+
+	LOG_DEBUG("The hash seed is %u", ret->hash_seed);
+
+	return ret;
+ERR:
+	if(NULL != ret->stripes) free(ret->stripes);
+	if(NULL != ret->entries) free(ret->entries);
+	free(ret);
+	return NULL;
+}
+
+/**
+ * @brief get the cache we should use in current thread, initialize the cache if it's not initialized
+ * @return the cache or NULL on error
+ **/
+static inline _cache_t* _get_cache(void)
+{
+	static int shared = -1;
+	if(shared == -1)
+		shared = pstd_libconf_read_numeric("pstd.fcache.shared", PSTD_FCACHE_DEFAULT_SHARED) != 0;
+
+	if(!shared)
+	{
+		if(_local_cache == NULL)
 		{
-			LOG_WARNING("Cannot get the high resolution timestamp, use low resolution one instead");
-			ts.tv_nsec = (long)time(NULL);
+			LOG_DEBUG("The thread local cache is not initialized yet, now doing the initialization");
+			if(NULL == (_local_cache = _cache_new(0)))
+				ERROR_PTR_RETURN_LOG("Cannot create the thread local cache");
+
+			if(ERROR_CODE(int) == pstd_onexit(_clean_cache, _local_cache))
+			{
+				_clean_cache(_local_cache);
+				_local_cache = NULL;
+				ERROR_PTR_RETURN_LOG("Cannot register the cleanup function for the cache table");
+			}
+
+			LOG_DEBUG("The thread local cache is sucessfully initailized");
 		}
-		srand((unsigned)ts.tv_nsec);
-		/* We need to do this, because the RAND_MAX is not guarenteed fill all the 32 bits up */
-		uint64_t upper_bound = 1;
-		while(upper_bound <= 0xffffffffu)
+
+		return _local_cache;
+	}
+
+	_cache_t* ret = _shared_cache;
+	BARRIER();
+
+	if(NULL != ret) return ret;
+
+	if((errno = pthread_mutex_lock(&_shared_cache_mutex)) != 0)
+		ERROR_PTR_RETURN_LOG_ERRNO("Cannot acquire the shared cache mutex");
+
+	if(NULL == (ret = _shared_cache))
+	{
+		LOG_DEBUG("The shared cache is not initialized yet, now doing the initialization");
+		if(NULL == (ret = _cache_new(1)))
+			ERROR_LOG_GOTO(UNLOCK, "Cannot create the shared cache");
+
+		if(ERROR_CODE(int) == pstd_onexit(_clean_cache, ret))
 		{
-			_hash_seed = (uint32_t)rand() + _hash_seed * RAND_MAX;
-			upper_bound *= RAND_MAX;
+			_clean_cache(ret);
+			ret = NULL;
+			ERROR_LOG_GOTO(UNLOCK, "Cannot register the cleanup function for the cache table");
 		}
 
-		LOG_DEBUG("The hash seed is %u", _hash_seed);
+		BARRIER();
+		_shared_cache = ret;
+		LOG_DEBUG("The shared cache is sucessfully initailized");
+	}
+
+UNLOCK:
+	if((errno = pthread_mutex_unlock(&_shared_cache_mutex)) != 0)
+		ERROR_PTR_RETURN_LOG_ERRNO("Cannot release the shared cache mutex");
 
-		_lru_first = _lru_last = ERROR_CODE(uint32_t);
+	return ret;
+}
 
-		LOG_DEBUG("The thread local cache is sucessfully initailized");
-	}
+/**
+ * @brief acquire the lock of the stripe
+ * @param cache the cache
+ * @param stripe the stripe to lock
+ * @return status code
+ **/
+static inline int _stripe_lock(const _cache_t* cache, _stripe_t* stripe)
+{
+	if(cache->shared && (errno = pthread_mutex_lock(&stripe->mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the cache stripe mutex");
+	return 0;
+}
 
+/**
+ * @brief release the lock of the stripe
+ * @param cache the cache
+ * @param stripe the stripe to unlock
+ * @return status code
+ **/
+static inline int _stripe_unlock(const _cache_t* cache, _stripe_t* stripe)
+{
+	if(cache->shared && (errno = pthread_mutex_unlock(&stripe->mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot release the cache stripe mutex");
 	return 0;
 }
 
+#ifdef __LINUX__
+/**
+ * @brief mark all the entries watched by the given watch descriptor stale
+ * @note this function doesn't hold any stripe lock, since the stale flag is only set atomically.
+ *       The worst case is we mark an entry which is replaced concurrently, which only causes an unnecessary reload
+ * @param cache the cache
+ * @param wd the watch descriptor
+ * @return nothing
+ **/
+static inline void _watch_mark_stale(_cache_t* cache, int wd)
+{
+	uint32_t i;
+	for(i = 0; i < cache->nsets * cache->nways; i ++)
+		if(cache->entries[i].valid && cache->entries[i].wd == wd)
+			__sync_fetch_and_or(&cache->entries[i].stale, 1);
+}
+#endif
+
+/**
+ * @brief drain the pending file watcher events and mark the changed entries stale
+ * @details To avoid an additional system call for each cache access, we only drain the events when
+ *          the watch interval has passed since the last time
+ * @param cache the cache
+ * @return nothing
+ **/
+static inline void _watch_drain(_cache_t* cache)
+{
+#ifdef __LINUX__
+	if(cache->watch_fd < 0) return;
+
+	struct timespec ts;
+	if(clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) < 0) return;
+
+	uint64_t now = (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+	if(now < cache->watch_ts + _watch_interval()) return;
+
+	/* If another thread is draining the events, we don't need to do it again */
+	if(pthread_mutex_trylock(&cache->watch_mutex) != 0) return;
+
+	cache->watch_ts = now;
+
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+
+	while((len = read(cache->watch_fd, buf, sizeof(buf))) > 0)
+	{
+		const char* ptr;
+		for(ptr = buf; ptr < buf + len; )
+		{
+			const struct inotify_event* event = (const struct inotify_event*)(const void*)ptr;
+			LOG_DEBUG("File watcher event 0x%x on watch descriptor %d", event->mask, event->wd);
+			_watch_mark_stale(cache, event->wd);
+			ptr += sizeof(struct inotify_event) + event->len;
+		}
+	}
+
+	if(len < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+		LOG_WARNING_ERRNO("Cannot read the file watcher events");
+
+	if((errno = pthread_mutex_unlock(&cache->watch_mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot release the watcher mutex");
+#else
+	(void)cache;
+#endif
+}
+
+/**
+ * @brief stop watching the file of the entry
+ * @details Because the watch descriptor is shared by all the entries referring the same inode, we
+ *          only remove the watch when there's no other entry using it. Even if we remove the watch
+ *          by mistake, the IN_IGNORED event marks the remaining entries stale
+ * @param cache the cache
+ * @param entry the entry
+ * @return nothing
+ **/
+static inline void _watch_remove(_cache_t* cache, _cache_entry_t* entry)
+{
+#ifdef __LINUX__
+	if(entry->wd < 0 || cache->watch_fd < 0) return;
+
+	uint32_t i;
+	for(i = 0; i < cache->nsets * cache->nways; i ++)
+		if(i != entry->idx && cache->entries[i].valid && cache->entries[i].wd == entry->wd)
+			break;
+
+	if(i == cache->nsets * cache->nways && inotify_rm_watch(cache->watch_fd, entry->wd) < 0)
+		LOG_DEBUG_ERRNO("Cannot remove the file watch");
+#else
+	(void)cache;
+#endif
+	entry->wd = -1;
+}
+
 /**
  * @brief check if the cache entry is the one we are looking for
  * @param entry the cache entry
  * @param expected_hash the hash code we are expecting
  * @param filename the actual file name we are looking for
- * @return the check result, 1 means found, 0 means not found, -1 means expired
+ * @return the check result, 1 means found, 0 means not found, -1 means expired, -2 means the file has been changed
  **/
 static inline int _entry_matches(const _cache_entry_t* entry, const uint64_t* expected_hash, const char* filename)
 {
@@ -242,6 +548,11 @@ static inline int _entry_matches(const _cache_entry_t* entry, const uint64_t* ex
 		if(strcmp(filename, entry->filename) != 0)
 			return 0;
 #endif
+		if(entry->stale) return -2;
+
+		/* If the file is watched, we don't need the TTL at all */
+		if(entry->wd >= 0) return 1;
+
 		time_t ts = time(NULL);
 		return ((uint32_t)(ts - entry->timestamp) > _cache_ttl()) ? -1 : 1;
 	}
@@ -251,63 +562,73 @@ static inline int _entry_matches(const _cache_entry_t* entry, const uint64_t* ex
 
 /**
  * @brief add a new entry to the LRU list
+ * @param cache the cache
+ * @param stripe the stripe owns the entry
  * @param idx the slot index to add
  * @note this function assume the entry is not prevoiusly in the LRU list, which
  *       means it should be invalid prevously
  * @return nothing
  **/
-static inline void _lru_add(uint32_t idx)
+static inline void _lru_add(_cache_t* cache, _stripe_t* stripe, uint32_t idx)
 {
-	_cache_entry_t* begin = _cache_table;
+	_cache_entry_t* begin = cache->entries;
 	begin[idx].lru_prev = ERROR_CODE(uint32_t);
-	begin[idx].lru_next = _lru_first;
+	begin[idx].lru_next = stripe->lru_first;
+	begin[idx].tick = ++ stripe->tick;
 
-	if(_lru_first != ERROR_CODE(uint32_t))
-		begin[_lru_first].lru_prev = idx;
+	if(stripe->lru_first != ERROR_CODE(uint32_t))
+		begin[stripe->lru_first].lru_prev = idx;
 	else
-		_lru_last = idx;
+		stripe->lru_last = idx;
 
-	_lru_first = idx;
+	stripe->lru_first = idx;
 }
 
 /**
  * @brief remove an existing entry from the LRU list
+ * @param cache the cache
+ * @param stripe the stripe owns the entry
  * @param idx the slot index to remove
  * @return nothing
  **/
-static inline void _lru_remove(uint32_t idx)
+static inline void _lru_remove(_cache_t* cache, _stripe_t* stripe, uint32_t idx)
 {
-	_cache_entry_t* begin = _cache_table;
+	_cache_entry_t* begin = cache->entries;
 
 	if(begin[idx].lru_prev != ERROR_CODE(uint32_t))
 		begin[begin[idx].lru_prev].lru_next = begin[idx].lru_next;
 	else
-		_lru_first = begin[idx].lru_next;
+		stripe->lru_first = begin[idx].lru_next;
 
 	if(begin[idx].lru_next != ERROR_CODE(uint32_t))
 		begin[begin[idx].lru_next].lru_prev = begin[idx].lru_prev;
 	else
-		_lru_last = begin[idx].lru_prev;
+		stripe->lru_last = begin[idx].lru_prev;
 
 }
 
 /**
  * @brief touch the lru entry, which means move the given entry to the first in LRU list
+ * @param cache the cache
+ * @param stripe the stripe owns the entry
  * @param idx the entry to touch
  * @return nothing
  **/
-static inline void _lru_touch(uint32_t idx)
+static inline void _lru_touch(_cache_t* cache, _stripe_t* stripe, uint32_t idx)
 {
-	_lru_remove(idx);
-	_lru_add(idx);
+	_lru_remove(cache, stripe, idx);
+	_lru_add(cache, stripe, idx);
 }
 
 /**
  * @brief create a cached file reference, which means we are refering something in the cache
+ * @note this function should be called with the stripe lock held
+ * @param cache the cache
+ * @param stripe the stripe owns the entry
  * @param entry the entry we want to create the reference for
  * @return the file object has been created
  **/
-static inline pstd_fcache_file_t* _create_cached_file(_cache_entry_t* entry)
+static inline pstd_fcache_file_t* _create_cached_file(_cache_t* cache, _stripe_t* stripe, _cache_entry_t* entry)
 {
 	pstd_fcache_file_t* ret = (pstd_fcache_file_t*)pstd_mempool_alloc(sizeof(*ret));
 	if(NULL == ret)
@@ -324,7 +645,7 @@ static inline pstd_fcache_file_t* _create_cached_file(_cache_entry_t* entry)
 	} while(!__sync_bool_compare_and_swap(&entry->refcnt, new_val - 1, new_val));
 
 	ret->size = entry->size;
-	_lru_touch(entry->idx);
+	_lru_touch(cache, stripe, entry->idx);
 
 	LOG_DEBUG("Load file from cache");
 
@@ -367,19 +688,23 @@ static inline pstd_fcache_file_t* _create_uncached_file(FILE* fp, const struct s
 
 /**
  * @brief invalidate the cache
+ * @note this function should be called with the stripe lock held
+ * @param cache the cache
+ * @param stripe the stripe owns the entry
  * @param entry the cache entry to invalidate
  * @return status code
  **/
-static inline int _invalidate_cache(_cache_entry_t* entry)
+static inline int _invalidate_cache(_cache_t* cache, _stripe_t* stripe, _cache_entry_t* entry)
 {
 	if(!entry->valid) return 0;
 
 	int rc = 0;
 
-	_data_size -= entry->size;
+	stripe->data_size -= entry->size;
 
-	if(entry->data != NULL)
-		free(entry->data);
+	_watch_remove(cache, entry);
+
+	_entry_data_free(entry);
 
 #ifdef PSTD_FILE_CACHE_STRICT_KEY_COMP
 	if(entry->filename != NULL)
@@ -388,24 +713,89 @@ static inline int _invalidate_cache(_cache_entry_t* entry)
 
 	entry->valid = 0;
 
-	_lru_remove(entry->idx);
+	_lru_remove(cache, stripe, entry->idx);
 	return rc;
 }
 
 /**
- * @brief get the slot id from the hash code
+ * @brief get the set id from the hash code
+ * @param cache the cache
  * @param hash the 128 bit hash code
- * @return the slot id
+ * @return the set id
  **/
-static inline uint32_t _hash_slot(const uint64_t* hash)
+static inline uint32_t _hash_set(const _cache_t* cache, const uint64_t* hash)
 {
-	/* Compute the slot id the entry should be in, we are actually doing a 128 bit modular */
-	uint32_t slot = (uint32_t)((1ull<<32) % _cache_hash_size());
-	slot = (uint32_t)(((uint64_t)slot * (uint64_t)slot) % _cache_hash_size());
-	slot = (uint32_t)((slot * hash[1] + hash[0]) % _cache_hash_size());
+	/* Compute the set id the entry should be in, we are actually doing a 128 bit modular */
+	uint32_t slot = (uint32_t)((1ull<<32) % cache->nsets);
+	slot = (uint32_t)(((uint64_t)slot * (uint64_t)slot) % cache->nsets);
+	slot = (uint32_t)((slot * hash[1] + hash[0]) % cache->nsets);
 	return slot;
 }
 
+/**
+ * @brief the lookup result in the cache
+ **/
+typedef struct {
+	_cache_t*       cache;     /*!< the cache */
+	_stripe_t*      stripe;    /*!< the stripe owns the set */
+	_cache_entry_t* entry;     /*!< the entry matches the file name, NULL if not found */
+	_cache_entry_t* victim;    /*!< the slot we should use if we want to load the file, NULL if all the slots are in use */
+	int             match_rc;  /*!< the result of _entry_matches for the entry */
+	uint64_t        hash[2];   /*!< the hash code of the filename */
+} _lookup_t;
+
+/**
+ * @brief find the file in the cache and acquire the stripe lock
+ * @details The victim is the first invalid slot in the set, otherwise the least recently used slot
+ *          that nobody is using
+ * @param filename the filename to lookup
+ * @param result the buffer for the lookup result
+ * @note if this function returns successfully, the caller should release the stripe lock
+ * @return status code
+ **/
+static inline int _lookup(const char* filename, _lookup_t* result)
+{
+	if(NULL == (result->cache = _get_cache()))
+		ERROR_RETURN_LOG(int, "Cannot initialize the file cache");
+
+	_watch_drain(result->cache);
+
+	murmurhash3_128(filename, strlen(filename), result->cache->hash_seed, result->hash);
+
+	uint32_t set = _hash_set(result->cache, result->hash);
+	result->stripe = result->cache->stripes + set % result->cache->nstripes;
+
+	if(ERROR_CODE(int) == _stripe_lock(result->cache, result->stripe))
+		return ERROR_CODE(int);
+
+	result->entry = result->victim = NULL;
+	result->match_rc = 0;
+
+	uint32_t i;
+	_cache_entry_t* begin = result->cache->entries + set * result->cache->nways;
+
+	for(i = 0; i < result->cache->nways; i ++)
+	{
+		_cache_entry_t* entry = begin + i;
+
+		if(0 != (result->match_rc = _entry_matches(entry, result->hash, filename)))
+		{
+			result->entry = entry;
+			break;
+		}
+
+		if(!entry->valid)
+		{
+			if(NULL == result->victim || result->victim->valid)
+				result->victim = entry;
+		}
+		else if(entry->refcnt == 0 && (NULL == result->victim || (result->victim->valid && result->victim->tick > entry->tick)))
+			result->victim = entry;
+	}
+
+	return 0;
+}
+
 /**
  * @brief check if the filename is loaded in cache, and if buf param is provided, load the stat info if possible
  * @param filename the filename to check
@@ -420,46 +810,48 @@ static inline int _is_in_cache(const char* filename, struct stat* buf)
 	if(NULL == filename)
 		ERROR_RETURN_LOG(int, "Invalid arguments");
 
-	if(ERROR_CODE(int) == _ensure_thread_init())
-		ERROR_RETURN_LOG(int, "Cannot initialize the file cache for current thread");
+	_lookup_t lookup;
+	if(ERROR_CODE(int) == _lookup(filename, &lookup))
+		ERROR_RETURN_LOG(int, "Cannot lookup the file cache");
 
-	size_t f_len = strlen(filename);
-	uint64_t hash[2];
-	murmurhash3_128(filename, f_len, _hash_seed, hash);
-
-	uint32_t slot = _hash_slot(hash);
-
-	_cache_entry_t* entry = _cache_table + slot;
+	int rc = 0;
+	_cache_entry_t* entry = lookup.entry;
 
-	int match_rc = _entry_matches(entry, hash, filename);
-	if(1 == match_rc)
+	if(1 == lookup.match_rc)
 	{
-		_lru_touch(entry->idx);
+		_lru_touch(lookup.cache, lookup.stripe, entry->idx);
 		if(NULL != buf) *buf = entry->stat;
-		return 2;
+		rc = 2;
 	}
-
-	if(match_rc == -1)
+	else if(lookup.match_rc == -1)
 	{
 		/* Get the file metadata */
 		if(stat(filename, &entry->stat) < 0)
-			ERROR_RETURN_LOG_ERRNO(int, "Canot get the stat info of the file %s", filename);
+			ERROR_LOG_ERRNO_GOTO(ERR, "Canot get the stat info of the file %s", filename);
 
 		if(entry->stat.st_mtime >= entry->timestamp)
 		{
 			LOG_DEBUG("Cache entry %u is expired and the file on the disk has been touched since last read", entry->idx);
 			if(NULL != buf) *buf = entry->stat;
-			return 1;
+			rc = 1;
+		}
+		else
+		{
+			LOG_DEBUG("Cache entry %u haven't been changed since last loaded, pushing the invalidate time to the furture", entry->idx);
+			entry->timestamp = time(NULL);
+			_lru_touch(lookup.cache, lookup.stripe, entry->idx);
+			if(NULL != buf) *buf = entry->stat;
+			rc = 2;
 		}
-
-		LOG_DEBUG("Cache entry %u haven't been changed since last loaded, pushing the invalidate time to the furture", entry->idx);
-		entry->timestamp = time(NULL);
-		_lru_touch(entry->idx);
-		if(NULL != buf) *buf = entry->stat;
-		return 2;
 	}
 
-	return 0;
+	goto RET;
+ERR:
+	rc = ERROR_CODE(int);
+RET:
+	if(ERROR_CODE(int) == _stripe_unlock(lookup.cache, lookup.stripe))
+		rc = ERROR_CODE(int);
+	return rc;
 }
 
 int pstd_fcache_is_in_cache(const char* filename)
@@ -491,28 +883,90 @@ int pstd_fcache_stat(const char* filename, struct stat* buf)
 	return 0;
 }
 
+/**
+ * @brief load the file content to the cache entry
+ * @details The file larger than the threshold is not copied to the heap. The entry keeps the file descriptor instead,
+ *          so that the reads are served by pread(2) and the file region can be handed off for zero-copy write.
+ *          We don't map the file, because touching the pages beyond the end of a file truncated under the mapping
+ *          raises SIGBUS, while pread and sendfile simply return a short count.
+ * @note The size is taken from the opened file, since the file may have been changed after the stat call
+ * @param entry the entry to load
+ * @param fp the file pointer
+ * @return status code
+ **/
+static inline int _entry_load(_cache_entry_t* entry, FILE* fp)
+{
+	entry->fd = -1;
+	entry->fd_backed = 0;
+	entry->data = NULL;
+
+	int fd = fileno(fp);
+	if(fd < 0 || fstat(fd, &entry->stat) < 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot get the stat info of the opened file");
+
+	entry->size = (size_t)entry->stat.st_size;
+
+	if(entry->size > 0 && entry->size >= _mmap_threshold())
+	{
+		if((entry->fd = dup(fd)) < 0)
+			ERROR_RETURN_LOG_ERRNO(int, "Cannot duplicate the file descriptor");
+
+		entry->fd_backed = 1;
+
+		return 0;
+	}
+
+	if(NULL == (entry->data = (int8_t*)malloc(entry->size)))
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the data buffer");
+
+	size_t off = 0;
+
+	while(!feof(fp) && off < entry->size)
+	{
+		size_t rc;
+		if(0 == (rc = fread(entry->data + off, 1, entry->size - off, fp)))
+		{
+			if(ferror(fp))
+				ERROR_LOG_ERRNO_GOTO(READ_ERR, "Cannot read the file to page");
+			break;
+		}
+
+		off += rc;
+	}
+
+	/* The file may be truncated while we are reading it */
+	entry->size = off;
+
+	return 0;
+READ_ERR:
+	free(entry->data);
+	entry->data = NULL;
+	return ERROR_CODE(int);
+}
+
 pstd_fcache_file_t* pstd_fcache_open(const char* filename)
 {
 	if(NULL == filename)
 		ERROR_PTR_RETURN_LOG("Invalid arguments");
 
-	if(ERROR_CODE(int) == _ensure_thread_init())
-		ERROR_PTR_RETURN_LOG("Cannot initialize the file cache for current thread");
-
-	size_t f_len = strlen(filename);
+	pstd_fcache_file_t* ret = NULL;
+	FILE* fp = NULL;
 
-	uint64_t hash[2];
-	murmurhash3_128(filename, f_len, _hash_seed, hash);
-	uint32_t slot = _hash_slot(hash);
+	_lookup_t lookup;
+	if(ERROR_CODE(int) == _lookup(filename, &lookup))
+		ERROR_PTR_RETURN_LOG("Cannot lookup the file cache");
 
-	_cache_entry_t* entry = _cache_table + slot;
+	_cache_t* cache = lookup.cache;
+	_stripe_t* stripe = lookup.stripe;
+	_cache_entry_t* entry = lookup.entry;
+	int match_rc = lookup.match_rc;
 
 	/* First we need to check if the file is alread in the cache, if yes, make a reference from the cache */
-	int match_rc;
-	if(1 == (match_rc = _entry_matches(entry, hash, filename)))
+	if(1 == match_rc)
 	{
 		LOG_DEBUG("File %s is in cache, return the cached file", filename);
-		return _create_cached_file(entry);
+		ret = _create_cached_file(cache, stripe, entry);
+		goto RET;
 	}
 
 	time_t timestamp = time(NULL);
@@ -520,7 +974,7 @@ pstd_fcache_file_t* pstd_fcache_open(const char* filename)
 	/* Get the file metadata */
 	struct stat st;
 	if(stat(filename, &st) < 0)
-		ERROR_PTR_RETURN_LOG("Canot get the stat info of the file %s", filename);
+		ERROR_LOG_GOTO(RET, "Canot get the stat info of the file %s", filename);
 
 	/* Since we have 1 sec resolution, it may cause problem, so we want to make sure the time is strictly piror than the cache ts */
 	if(match_rc == -1 && st.st_mtime < entry->timestamp)
@@ -529,28 +983,24 @@ pstd_fcache_file_t* pstd_fcache_open(const char* filename)
 		entry->timestamp = time(NULL);
 		entry->stat = st;
 		LOG_DEBUG("File %s is in cache, return the cached file", filename);
-		return _create_cached_file(entry);
+		ret = _create_cached_file(cache, stripe, entry);
+		goto RET;
 	}
 
 	/* Then we need to know the info about the file anyway, because we must read from disk */
-	FILE* fp = fopen(filename, "rb");
-	if(NULL == fp)
-		ERROR_PTR_RETURN_LOG_ERRNO("Cannot open file %s", filename);
-
-
-	/* This is safe, because the only place that can increase the value of the refcnt is the working thread rather than the
-	 * IO thread. And this function will only be used in the working thread. Which means it's impossible for one entry that
-	 * have a refcnt 0, and other increase the refcnt.
-	 * The worst case here is the reference is dead already but the IO thread decref after this line is executed, which means
-	 * we introduced an unncessecary uncached IO at this point. But it should be fine, because
-	 *  1. Thread race condition is rare, because we only have IO thread and working thread involved
-	 *  2. The hash conflict is rare
-	 **/
-	if((entry->valid && entry->refcnt > 0))
-	{
-		LOG_DEBUG("Unfortunately, the file %s has a conflict in the cache table, and"
-		          "the other file is currently in use, so we unable to add it to cache",
-		          filename);
+	if(NULL == (fp = fopen(filename, "rb")))
+		ERROR_LOG_ERRNO_GOTO(RET, "Cannot open file %s", filename);
+
+	/* If the file is previously cached, we must reuse the same slot, otherwise we have two entries for the same file */
+	if(NULL == entry) entry = lookup.victim;
+
+	/* Because the refcnt only increases with the stripe lock held, an entry with 0 refcnt can not be referenced by anyone
+	 * else at this point. The worst case here is the reference is dead already but the IO thread decref after this line
+	 * is executed, which means we introduced an unncessecary uncached IO at this point. */
+	if(NULL == entry || (entry->valid && entry->refcnt > 0))
+	{
+		LOG_DEBUG("Unfortunately, all the slots for file %s are currently in use, "
+		          "so we unable to add it to cache", filename);
 		goto OPEN_UNCACHED;
 	}
 
@@ -563,90 +1013,96 @@ pstd_fcache_file_t* pstd_fcache_open(const char* filename)
 
 	/* Now lets load this file to cache */
 	if(entry->valid && match_rc == 0)
-		LOG_DEBUG("We have see a cache conflict, so we will replace the old cache entry with the new one");
+		LOG_DEBUG("The set is full, so we will replace the least recently used entry %u", entry->idx);
 
-	if(ERROR_CODE(int) == _invalidate_cache(entry))
+	if(ERROR_CODE(int) == _invalidate_cache(cache, stripe, entry))
 		ERROR_LOG_GOTO(ERR, "Cannot invalidate the prevoius cache slot");
 
 	/* Then we need to enforce the cache size limit */
 	uint32_t cur;
-	for(cur = _lru_last; cur != ERROR_CODE(uint32_t) && _data_size + (size_t)st.st_size > _max_cache_size();)
+	for(cur = stripe->lru_last; cur != ERROR_CODE(uint32_t) && stripe->data_size + (size_t)st.st_size > cache->stripe_limit;)
 	{
-		_cache_entry_t* victim = _cache_table + cur;
-		cur = _cache_table[cur].lru_prev;
+		_cache_entry_t* victim = cache->entries + cur;
+		cur = victim->lru_prev;
 
 		/* As we previously mentioned, the worst case here should be the victim is accidentally survived.
 		 * But this do not break the correctness, and this case is rare */
 		if(victim->refcnt == 0)
 		{
 			LOG_DEBUG("Cache size limit reached, find victim %u to kill", victim->idx);
-			if(ERROR_CODE(int) == _invalidate_cache(victim))
+			if(ERROR_CODE(int) == _invalidate_cache(cache, stripe, victim))
 				ERROR_LOG_GOTO(ERR, "Cannot invalidate the victim %u", victim->idx);
 		}
 		else
 			LOG_DEBUG("The victim %u survived because someone is using it", victim->idx);
 	}
 
-	if(_data_size + (size_t)st.st_size > _max_cache_size())
+	if(stripe->data_size + (size_t)st.st_size > cache->stripe_limit)
 	{
 		LOG_DEBUG("After killing all victims, we still don't have enough space for the new file, now giving up");
 		goto OPEN_UNCACHED;
 	}
 
-	/* This is safe, because only worker thread can do both this and incref. Plus at this time no IO loop will be able to see this */
+	/* This is safe, because we are holding the stripe lock and nobody is referencing the entry */
 	entry->refcnt = 0;
-	entry->hash[0] = hash[0];
-	entry->hash[1] = hash[1];
+	entry->stale = 0;
+	entry->hash[0] = lookup.hash[0];
+	entry->hash[1] = lookup.hash[1];
 	entry->timestamp = timestamp;
 	entry->stat = st;
 	entry->size = (size_t)st.st_size;
+	entry->wd = -1;
 #ifdef PSTD_FILE_CACHE_STRICT_KEY_COMP
+	size_t f_len = strlen(filename);
 	if(NULL == (entry->filename = (char*)malloc(f_len + 1)))
 		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the filename");
-	memcpy(entry->filename, filename f_len + 1);
+	memcpy(entry->filename, filename, f_len + 1);
 #endif
 
-	if(NULL == (entry->data = (int8_t*)malloc(entry->size)))
-		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the data buffer");
-
-	size_t off = 0;
+#ifdef __LINUX__
+	/* We must start watching the file before we read it, otherwise we may miss the changes during the load */
+	if(cache->watch_fd >= 0 &&
+	   (entry->wd = inotify_add_watch(cache->watch_fd, filename, IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF)) < 0)
+		LOG_DEBUG_ERRNO("Cannot watch the file %s, fallback to the TTL based invalidation", filename);
+#endif
 
-	while(!feof(fp) && off < entry->size)
+	if(ERROR_CODE(int) == _entry_load(entry, fp))
 	{
-		size_t rc;
-		if(0 == (rc = fread(entry->data + off, 1, entry->size - off, fp)))
-			ERROR_LOG_ERRNO_GOTO(READ_ERR, "Cannot read the file to page");
-
-		off += rc;
-		continue;
-
-READ_ERR:
-		free(entry->data);
-		goto ERR;
+#ifdef PSTD_FILE_CACHE_STRICT_KEY_COMP
+		free(entry->filename);
+#endif
+		_watch_remove(cache, entry);
+		ERROR_LOG_GOTO(ERR, "Cannot load the file %s to cache", filename);
 	}
 
 	fclose(fp);
+	fp = NULL;
 
 	entry->valid = 1;
 
-	LOG_DEBUG("Cache slot %u has been occupied by file %s", slot, filename);
-
-	_lru_add(entry->idx);
-	_data_size += entry->size;
+	LOG_DEBUG("Cache slot %u has been occupied by file %s", entry->idx, filename);
 
+	_lru_add(cache, stripe, entry->idx);
+	stripe->data_size += entry->size;
 
 	LOG_DEBUG("File  %s is in cache, return the cached file", filename);
-	return _create_cached_file(entry);
+	ret = _create_cached_file(cache, stripe, entry);
+	goto RET;
 
 OPEN_UNCACHED:
-	{
-		pstd_fcache_file_t* ret = _create_uncached_file(fp, &st);
-		if(ret != NULL) return ret;
-		else LOG_ERROR("Cannot open uncached file reference");
-	}
+	if(NULL != (ret = _create_uncached_file(fp, &st)))
+		fp = NULL;
+	else
+		LOG_ERROR("Cannot open uncached file reference");
 ERR:
 	if(NULL != fp) fclose(fp);
-	return NULL;
+RET:
+	if(ERROR_CODE(int) == _stripe_unlock(cache, stripe) && NULL != ret)
+	{
+		pstd_fcache_close(ret);
+		ret = NULL;
+	}
+	return ret;
 }
 
 int pstd_fcache_close(pstd_fcache_file_t* file)
@@ -713,11 +1169,44 @@ int pstd_fcache_seek(pstd_fcache_file_t* file, size_t offset)
 	{
 		if(-1 == fseek(file->file, (off_t)offset, SEEK_SET))
 			ERROR_RETURN_LOG_ERRNO(int, "Cannot seek the file");
+		file->offset = offset;
 	}
 
 	return 0;
 }
 
+int pstd_fcache_take_region(pstd_fcache_file_t* file, int* fd_buf, size_t* offset_buf, size_t* size_buf)
+{
+	if(NULL == file || NULL == fd_buf || NULL == offset_buf || NULL == size_buf)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if(file->cached)
+	{
+		/* The large entry keeps the file descriptor, which is valid as long as the reference is alive */
+		if(!file->cache->fd_backed) return 0;
+
+		*fd_buf = file->cache->fd;
+		*offset_buf = file->offset;
+		*size_buf = file->offset < file->size ? file->size - file->offset : 0;
+		file->offset = file->size;
+
+		return 1;
+	}
+
+	int fd = fileno(file->file);
+	if(fd < 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot get the file descriptor of the file");
+
+	*fd_buf = fd;
+	*offset_buf = file->offset;
+	*size_buf = file->offset < file->size ? file->size - file->offset : 0;
+
+	/* All the bytes has been handed off, so the reference should reach the end of file */
+	file->offset = file->size;
+
+	return 1;
+}
+
 size_t pstd_fcache_read(pstd_fcache_file_t* file, void* buf, size_t bufsize)
 {
 	if(NULL == file || NULL == buf)
@@ -730,6 +1219,20 @@ size_t pstd_fcache_read(pstd_fcache_file_t* file, void* buf, size_t bufsize)
 		if(ret + file->offset > file->cache->size)
 			ret = file->cache->size - file->offset;
 
+		/* If the file is changed, the file watcher marks the entry stale, and a truncation is just a short read here */
+		if(ret > 0 && file->cache->fd_backed)
+		{
+			ssize_t rc = pread(file->cache->fd, buf, ret, (off_t)file->offset);
+			if(rc < 0)
+				ERROR_RETURN_LOG_ERRNO(size_t, "Cannot read from the cached file");
+
+			if(rc == 0)
+				ERROR_RETURN_LOG(size_t, "The file has been truncated since it's loaded to the cache");
+
+			file->offset += (size_t)rc;
+			return (size_t)rc;
+		}
+
 		memcpy(buf, file->cache->data + file->offset, ret);
 		file->offset += ret;
 		return ret;
@@ -75,4 +75,17 @@ int pstd_fcache_stat(const char* filename, struct stat* buf);
  **/
 int pstd_fcache_seek(pstd_fcache_file_t* file, size_t offset);
 
+/**
+ * @brief Take the remaining bytes of the file as a region of the underlying file descriptor
+ * @details This is only possible when the file is not served from the cache, since the cached file lives in memory.
+ *          Once the region is returned, the file reference reaches the end of file, and the file descriptor is
+ *          valid until the file reference gets closed
+ * @param file The reference to the file
+ * @param fd_buf The buffer used to return the file descriptor
+ * @param offset_buf The buffer used to return the offset of the region
+ * @param size_buf The buffer used to return the size of the region
+ * @return 1 if the region has been returned, 0 if the file is in the cache, error code on error cases
+ **/
+int pstd_fcache_take_region(pstd_fcache_file_t* file, int* fd_buf, size_t* offset_buf, size_t* size_buf);
+
 #endif /*__PSTD_FCACHE_H__ */
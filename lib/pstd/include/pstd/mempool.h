@@ -35,4 +35,16 @@ void* pstd_mempool_page_alloc(void);
  **/
 int pstd_mempool_page_dealloc(void* page);
 
+/**
+ * @brief allocate memory from the arena of the request which is currently being executed
+ * @details the memory can not be disposed individually, all the memory allocated from the arena is
+ *          released at once when the request completes. Thus it's fast, but it should only be used for the
+ *          memory that doesn't outlive the request, for example, the RLS objects. Like the other PSSM
+ *          functions on the hot path, the allocator is called directly once it has been bound.
+ * @param size the number of bytes to allocate
+ * @note this should be called from the servlet exec callback only
+ * @return the allocated memory, NULL on error or when there's no request being executed
+ **/
+void* pstd_mempool_scope_alloc(size_t size);
+
 #endif /* __PSTD_MEMPOOL_H__ */
@@ -77,7 +77,10 @@ size_t pstd_blob_model_data_size(const pstd_blob_model_t* model);
 /**
  * @brief Create a new in-memomry blob
  * @param model The model we want to query
- * @param memory If it's not NULL, use the memory address instead of allocate one
+ * @param memory If it's not NULL, use the memory address instead of allocate one. Otherwise the blob
+ *        is allocated from the arena of current request scope, which is released when the request completes
+ * @note The blob allocated from the request scope arena should not be used after the request is done,
+ *       and it can only be created from the servlet exec callback
  * @return the newly created memory blob
  **/
 pstd_blob_t* pstd_blob_new(const pstd_blob_model_t* model, void* memory);
@@ -30,6 +30,15 @@ typedef struct _pstd_ostream_t pstd_ostream_t;
  **/
 pstd_ostream_t* pstd_ostream_new(void);
 
+/**
+ * @brief Create a new PSTD output stream object which lives in the arena of current request scope
+ * @details The stream object and its data blocks are allocated from the request scope arena, and they are released
+ *          at once when the request completes. This should be used when the stream is going to be committed.
+ * @note This function can only be called from the servlet exec callback
+ * @return The newly created PSTD stream object
+ **/
+pstd_ostream_t* pstd_ostream_new_scoped(void);
+
 /**
  * @brief Dispose a used output stream object
  * @param stream The used output stream object to dispose
@@ -82,6 +82,17 @@ extern "C" {
 	**/
 	pstd_string_t* pstd_string_new(size_t initcap);
 
+	/**
+	 * @brief create a new pstd string buffer which lives in the arena of current request scope
+	 * @details the string object and all its buffers are allocated from the request scope arena, and they are
+	 *          released at once when the request completes. So it should be used for the string that is going to
+	 *          be committed as an RLS object, and it must not be kept after the request is done.
+	 * @param initcap the initial capacity of the string buffer
+	 * @note this function can only be called from the servlet exec callback
+	 * @return the newly created pstd string buffer, NULL on error case
+	 **/
+	pstd_string_t* pstd_string_new_scoped(size_t initcap);
+
 	/**
 	* @brief dispose a used string buffer
 	* @param str the used string buffer
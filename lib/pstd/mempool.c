@@ -5,19 +5,14 @@
 #include <pservlet.h>
 #include <pstd/mempool.h>
 
+#include "pssm.h"
+
 void* pstd_mempool_alloc(uint32_t size)
 {
-	static pipe_t allocator = ERROR_CODE(pipe_t);
-
-	if(allocator == ERROR_CODE(pipe_t))
-	{
-		allocator = module_require_function("plumber.std", "pool_allocate");
-		if(ERROR_CODE(pipe_t) == allocator)
-			ERROR_PTR_RETURN_LOG("Cannot get the service module method reference for plumber.std.pool_allocate, PSSM is not installed?");
-	}
+	_ENSURE_PIPE(pool_allocate, NULL);
 
 	void* ret;
-	int rc = pipe_cntl(allocator, PIPE_CNTL_INVOKE, size, &ret);
+	int rc = _INVOKE(pool_allocate, int (*)(uint32_t, void**), size, &ret);
 	if(ERROR_CODE(int) == rc)
 		ERROR_PTR_RETURN_LOG("Cannot allocate memory from memory pool");
 
@@ -28,28 +23,17 @@ int pstd_mempool_free(void* mem)
 {
 	if(NULL == mem) ERROR_RETURN_LOG(int, "Invalid arguments");
 
-	static pipe_t deallocator = ERROR_CODE(pipe_t);
-
-	if(deallocator == ERROR_CODE(pipe_t))
-	{
-		deallocator = module_require_function("plumber.std", "pool_deallocate");
+	_ENSURE_PIPE(pool_deallocate, ERROR_CODE(int));
 
-		if(ERROR_CODE(pipe_t) == deallocator)
-			ERROR_RETURN_LOG(int, "Cannot get the service module method reference for plumber.std.pool_deallocate, PSSM is not installed?");
-	}
-
-	return pipe_cntl(deallocator, PIPE_CNTL_INVOKE, mem);
+	return _INVOKE(pool_deallocate, int (*)(void*), mem);
 }
 
 void* pstd_mempool_page_alloc()
 {
-	static pipe_t pipe = ERROR_CODE(pipe_t);
-
-	if(ERROR_CODE(pipe_t) == pipe && ERROR_CODE(pipe_t) == (pipe = module_require_function("plumber.std", "page_allocate")))
-		ERROR_PTR_RETURN_LOG("Cannot get the service module method refernece for plumber.std.page_allocate, PSSM may not be loaded");
+	_ENSURE_PIPE(page_allocate, NULL);
 
 	void* ret;
-	if(ERROR_CODE(int) == pipe_cntl(pipe, PIPE_CNTL_INVOKE, &ret) || NULL == ret)
+	if(ERROR_CODE(int) == _INVOKE(page_allocate, int (*)(void**), &ret) || NULL == ret)
 		ERROR_PTR_RETURN_LOG("Cannot allocate memory from the page memory pool");
 
 	return ret;
@@ -57,10 +41,18 @@ void* pstd_mempool_page_alloc()
 
 int pstd_mempool_page_dealloc(void* page)
 {
-	static pipe_t pipe = ERROR_CODE(pipe_t);
+	_ENSURE_PIPE(page_deallocate, ERROR_CODE(int));
 
-	if(ERROR_CODE(pipe_t) == pipe && ERROR_CODE(pipe_t) == (pipe = module_require_function("plumber.std", "page_deallocate")))
-		ERROR_RETURN_LOG(int, "Cannot get the service module method reference for plumber.std.page_deallocate, PSSM may not be loaded");
+	return _INVOKE(page_deallocate, int (*)(void*), page);
+}
 
-	return pipe_cntl(pipe, PIPE_CNTL_INVOKE, page);
+void* pstd_mempool_scope_alloc(size_t size)
+{
+	_ENSURE_PIPE(scope_arena_alloc, NULL);
+
+	void* ret;
+	if(ERROR_CODE(int) == _INVOKE(scope_arena_alloc, int (*)(size_t, void**), size, &ret))
+		ERROR_PTR_RETURN_LOG("Cannot allocate memory from the request scope arena");
+
+	return ret;
 }
@@ -0,0 +1,52 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+/**
+ * @brief The private helpers used to call the plumber.std service module functions
+ * @note This header is only used by the pstd implementation and it's not installed
+ * @file pstd/pssm.h
+ **/
+#ifndef __PSTD_PSSM_H__
+#define __PSTD_PSSM_H__
+
+/**
+ * @brief get the service module function reference and bind it to the function address if possible
+ * @param current the current function reference
+ * @param func the name of the function
+ * @param func_buf the buffer used to return the bound function address
+ * @return the function reference or error code
+ **/
+static inline pipe_t _ensure_pipe(pipe_t current, const char* func, module_func_t* func_buf)
+{
+	pipe_t ret = current;
+	if(ERROR_CODE(pipe_t) == ret)
+	{
+		if(ERROR_CODE(pipe_t) == (ret = module_require_function("plumber.std", func)))
+			ERROR_RETURN_LOG(pipe_t, "Cannot get the service module method reference for plumber.std.%s, PSSM is not installed?", func);
+
+		*func_buf = module_bind_function(ret);
+	}
+
+	return ret;
+}
+
+/**
+ * @brief make sure the service module function has been resolved, otherwise return from the caller
+ * @param name the name of the function, which is also the name of the function reference variable
+ * @param retval the value the caller returns on error
+ **/
+#define _ENSURE_PIPE(name, retval) \
+    static pipe_t name = ERROR_CODE(pipe_t);\
+    static module_func_t name##_func = NULL;\
+    if(ERROR_CODE(pipe_t) == (name = _ensure_pipe(name, #name, &name##_func))) \
+        return retval;
+
+/**
+ * @brief call the service module function, the function is called directly if it has been bound
+ * @param name the name of the function
+ * @param type the typed function pointer type
+ **/
+#define _INVOKE(name, type, args...) \
+    (NULL != name##_func ? ((type)name##_func)(args) : pipe_cntl(name, PIPE_CNTL_INVOKE, args))
+
+#endif /* __PSTD_PSSM_H__ */
@@ -10,22 +10,7 @@
 #include <pstd/mempool.h>
 #include <pstd/scope.h>
 
-static inline pipe_t _ensure_pipe(pipe_t current, const char* func)
-{
-	pipe_t ret = current;
-	if(ERROR_CODE(pipe_t) == ret)
-	{
-		if(ERROR_CODE(pipe_t) == (ret = module_require_function("plumber.std", func)))
-			ERROR_RETURN_LOG(pipe_t, "Cannot find servlet module function plumber.std.%s make sure you have installed pssm module", func);
-	}
-
-	return ret;
-}
-
-#define _ENSURE_PIPE(name, retval) \
-    static pipe_t name = ERROR_CODE(pipe_t);\
-    if(ERROR_CODE(pipe_t) == (name = _ensure_pipe(name, #name))) \
-        return retval;
+#include "pssm.h"
 
 scope_token_t pstd_scope_add(const scope_entity_t* entity)
 {
@@ -33,7 +18,7 @@ scope_token_t pstd_scope_add(const scope_entity_t* entity)
 
 	scope_token_t ret;
 
-	if(ERROR_CODE(int) == pipe_cntl(scope_add, PIPE_CNTL_INVOKE, entity, &ret))
+	if(ERROR_CODE(int) == _INVOKE(scope_add, int (*)(const scope_entity_t*, scope_token_t*), entity, &ret))
 		ERROR_RETURN_LOG(scope_token_t, "Cannot finish the pipe_cntl call");
 
 	return ret;
@@ -45,7 +30,7 @@ scope_token_t pstd_scope_copy(scope_token_t token, void** resbuf)
 
 	scope_token_t ret;
 
-	if(ERROR_CODE(int) == pipe_cntl(scope_copy, PIPE_CNTL_INVOKE, token, &ret, resbuf))
+	if(ERROR_CODE(int) == _INVOKE(scope_copy, int (*)(scope_token_t, scope_token_t*, void**), token, &ret, resbuf))
 		ERROR_RETURN_LOG(scope_token_t, "Cannot finish the pipe_cntl call");
 
 	return ret;
@@ -57,7 +42,7 @@ const void* pstd_scope_get(scope_token_t token)
 
 	const void* ret;
 
-	if(ERROR_CODE(int) == pipe_cntl(scope_get, PIPE_CNTL_INVOKE, token, &ret))
+	if(ERROR_CODE(int) == _INVOKE(scope_get, int (*)(scope_token_t, const void**), token, &ret))
 		ERROR_PTR_RETURN_LOG("Cannot finish the pipe_cntl call");
 
 	return ret;
@@ -69,7 +54,7 @@ pstd_scope_stream_t* pstd_scope_stream_open(scope_token_t token)
 
 	void* ret = NULL;
 
-	if(ERROR_CODE(int) == pipe_cntl(scope_stream_open, PIPE_CNTL_INVOKE, token, &ret))
+	if(ERROR_CODE(int) == _INVOKE(scope_stream_open, int (*)(scope_token_t, void**), token, &ret))
 		ERROR_PTR_RETURN_LOG("Cannot finish the pipe_cntl call");
 
 	return (pstd_scope_stream_t*)ret;
@@ -81,7 +66,7 @@ size_t pstd_scope_stream_read(pstd_scope_stream_t* stream, void* buf, size_t siz
 
 	size_t ret = 0;
 
-	if(ERROR_CODE(int) == pipe_cntl(scope_stream_read, PIPE_CNTL_INVOKE, stream, buf, size, &ret))
+	if(ERROR_CODE(int) == _INVOKE(scope_stream_read, int (*)(pstd_scope_stream_t*, void*, size_t, size_t*), stream, buf, size, &ret))
 		ERROR_RETURN_LOG(size_t, "Cannot finish the pipe_cntl call");
 
 	return ret;
@@ -93,7 +78,7 @@ int pstd_scope_stream_eof(const pstd_scope_stream_t* stream)
 
 	int ret = 0;
 
-	if(ERROR_CODE(int) == pipe_cntl(scope_stream_eof, PIPE_CNTL_INVOKE, stream, &ret))
+	if(ERROR_CODE(int) == _INVOKE(scope_stream_eof, int (*)(const pstd_scope_stream_t*, int*), stream, &ret))
 		ERROR_RETURN_LOG(int, "Cannot finish the pipe_cntl call");
 
 	return ret;
@@ -103,7 +88,7 @@ int pstd_scope_stream_close(pstd_scope_stream_t* stream)
 {
 	_ENSURE_PIPE(scope_stream_close, ERROR_CODE(int));
 
-	return pipe_cntl(scope_stream_close, PIPE_CNTL_INVOKE, stream);
+	return _INVOKE(scope_stream_close, int (*)(pstd_scope_stream_t*), stream);
 }
 
 int pstd_scope_stream_ready_event(pstd_scope_stream_t* stream, scope_ready_event_t* buf)
@@ -112,7 +97,7 @@ int pstd_scope_stream_ready_event(pstd_scope_stream_t* stream, scope_ready_event
 
 	int ret = 0;
 
-	if(ERROR_CODE(int) == pipe_cntl(scope_stream_ready_event, PIPE_CNTL_INVOKE, stream, buf, &ret))
+	if(ERROR_CODE(int) == _INVOKE(scope_stream_ready_event, int (*)(pstd_scope_stream_t*, scope_ready_event_t*, int*), stream, buf, &ret))
 		ERROR_RETURN_LOG(int, "Cannot finish the pipe_cntl call");
 
 	return ret;
@@ -233,6 +218,7 @@ scope_token_t pstd_scope_gc_add(const scope_entity_t* entity, pstd_scope_gc_obj_
 		.read_func = entity->read_func,
 		.eos_func  = entity->eos_func,
 		.event_func = entity->event_func,
+		.region_func = entity->region_func,
 		.close_func = entity->close_func
 	};
 
@@ -9,31 +9,15 @@
 #include <pservlet.h>
 
 #include <pstd/thread.h>
+
+#include "pssm.h"
+
 #define _THREAD_LOCAL_MAGIC ((uintptr_t)0x544c4d6167696321ull)
 struct _pstd_thread_local_t {
 	uintptr_t	magic;     /*!< the magic number used to identify this is a thread local object */
 	void*       object;    /*!< the reference to the actual object */
 };
 
-static inline pipe_t _ensure_pipe(pipe_t current, const char* func)
-{
-	pipe_t ret = current;
-	if(current == ERROR_CODE(pipe_t))
-	{
-		ret = module_require_function("plumber.std", func);
-
-		if(ERROR_CODE(pipe_t) == ret)
-			ERROR_RETURN_LOG(pipe_t, "Cannot get the service module function plumber.std.%s, make sure PSSM is installed", func);
-	}
-
-	return ret;
-}
-
-#define _ENSURE_PIPE(name, retval) \
-    static pipe_t name = ERROR_CODE(pipe_t);\
-    if(ERROR_CODE(pipe_t) == (name = _ensure_pipe(name, #name))) \
-        return retval;
-
 pstd_thread_local_t* pstd_thread_local_new(pstd_thread_local_allocator_t alloc, pstd_thread_local_dealloctor_t dealloc, const void* data)
 {
 	_ENSURE_PIPE(thread_local_new, NULL);
@@ -61,7 +45,7 @@ void* pstd_thread_local_get(pstd_thread_local_t* local)
 
 	void* ret;
 
-	if(ERROR_CODE(int) == pipe_cntl(thread_local_get, PIPE_CNTL_INVOKE, local->object, &ret))
+	if(ERROR_CODE(int) == _INVOKE(thread_local_get, int (*)(void*, void**), local->object, &ret))
 		ERROR_PTR_RETURN_LOG("Call to plumber.std.thread_local_get has failed");
 
 	return ret;
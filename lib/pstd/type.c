@@ -435,20 +435,23 @@ static inline int _ensure_pipe_typeinfo(pstd_type_model_t* ctx, pipe_t pipe)
 
 	if(ctx->pipe_cap <= pid + 1u)
 	{
-		_typeinfo_t* newbuf = (_typeinfo_t*)realloc(ctx->type_info, sizeof(ctx->type_info[0]) * ctx->pipe_cap * 2);
+		uint32_t new_cap = ctx->pipe_cap;
+		while(new_cap <= pid + 1u) new_cap <<= 1u;
+
+		_typeinfo_t* newbuf = (_typeinfo_t*)realloc(ctx->type_info, sizeof(ctx->type_info[0]) * new_cap);
 		if(NULL == newbuf)
 			ERROR_RETURN_LOG_ERRNO(int, "Cannot resize the type info array");
 
-		memset(newbuf + sizeof(ctx->type_info[0]) * ctx->pipe_cap, 0,  sizeof(ctx->type_info[0]) * ctx->pipe_cap);
+		memset(newbuf + ctx->pipe_cap, 0,  sizeof(ctx->type_info[0]) * (new_cap - ctx->pipe_cap));
 
 		uint32_t i;
-		for(i = ctx->pipe_cap; i < ctx->pipe_cap * 2; i ++)
+		for(i = ctx->pipe_cap; i < new_cap; i ++)
 		{
-			ctx->type_info[i].accessor_list = ERROR_CODE(uint32_t);
-			ctx->type_info[pid].copy_from = ERROR_CODE(pipe_t);
+			newbuf[i].accessor_list = ERROR_CODE(uint32_t);
+			newbuf[i].copy_from = ERROR_CODE(pipe_t);
 		}
 
-		ctx->pipe_cap <<= 1u;
+		ctx->pipe_cap = new_cap;
 		ctx->type_info = newbuf;
 	}
 
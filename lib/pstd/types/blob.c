@@ -13,6 +13,7 @@
 #include <proto.h>
 #include <pstd/type.h>
 #include <pstd/scope.h>
+#include <pstd/mempool.h>
 #include <pstd/types/blob.h>
 
 /**
@@ -325,9 +326,17 @@ size_t pstd_blob_model_data_size(const pstd_blob_model_t* model)
 
 pstd_blob_t* pstd_blob_new(const pstd_blob_model_t* model, void* memory)
 {
-	if(NULL == model || NULL == memory)
+	if(NULL == model)
 		ERROR_PTR_RETURN_LOG("Invalid arguments");
 
+	if(NULL == memory)
+	{
+		size_t size = pstd_blob_model_full_size(model);
+		if(NULL == (memory = pstd_mempool_scope_alloc(size)))
+			ERROR_PTR_RETURN_LOG("Cannot allocate memory for the blob from the request scope arena");
+		memset(memory, 0, size);
+	}
+
 	pstd_blob_t* ret = (pstd_blob_t*)memory;
 
 	return ret;
@@ -358,6 +358,50 @@ static inline size_t _read(void* __restrict stream_mem, void* __restrict buf, si
 #endif
 }
 
+/**
+ * @brief the callback that takes the remaining bytes of the stream as a file region, called by RLS infrastructure
+ * @details this allows the module write the file to the socket with zero-copy system calls
+ * @param stream_mem the stream handle
+ * @param region_buf the buffer used to return the region
+ * @return 1 if the region is returned, 0 if the file should be read with the read callback, or error code
+ **/
+static inline int _region(void* __restrict stream_mem, runtime_api_scope_file_region_t* region_buf)
+{
+	_stream_t* s = (_stream_t*)stream_mem;
+	int fd;
+	size_t offset, size;
+
+#ifdef PSTD_FILE_NO_CACHE
+	struct stat st;
+	long pos;
+
+	/* The stdio buffer doesn't matter, since ftell gives us the logic position of the stream */
+	if((pos = ftell(s->file)) < 0 || (fd = fileno(s->file)) < 0 || fstat(fd, &st) < 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot get the file region of the RLS file stream");
+
+	offset = (size_t)pos;
+	size = (size_t)st.st_size > offset ? (size_t)st.st_size - offset : 0;
+#else
+	int rc = pstd_fcache_take_region(s->file, &fd, &offset, &size);
+
+	if(rc != 1) return rc;
+#endif
+
+	if(s->remaining != (size_t)-1 && size > s->remaining)
+		size = s->remaining;
+
+	/* All the bytes are handed off, so the stream should reach the end */
+	s->remaining = 0;
+
+	region_buf->fd = fd;
+	region_buf->offset = offset;
+	region_buf->size = size;
+
+	LOG_DEBUG("%zu bytes has been taken from RLS file stream as a file region", size);
+
+	return 1;
+}
+
 scope_token_t pstd_file_commit(pstd_file_t* file)
 {
 	if(NULL == file || file->committed)
@@ -370,7 +414,8 @@ scope_token_t pstd_file_commit(pstd_file_t* file)
 		.open_func = _open,
 		.close_func = _close,
 		.eos_func = _eos,
-		.read_func = _read
+		.read_func = _read,
+		.region_func = _region
 	};
 
 	scope_token_t ret = pstd_scope_add(&ent);
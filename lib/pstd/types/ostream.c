@@ -29,6 +29,7 @@ typedef enum {
 typedef struct {
 	uint32_t   size;          /*!< The actual amount of data we have in the page */
 	uint32_t   read;          /*!< The read pointer */
+	uint32_t   capacity;      /*!< The size of the data section */
 	uintpad_t  __padding__[0];
 	char       data[0];       /*!< The actual data section */
 } _page_data_t;
@@ -73,20 +74,63 @@ STATIC_ASSERTION_LAST(_block_t, stream);
 struct _pstd_ostream_t {
 	uint32_t    commited:1;    /*!< If this object has been committed */
 	uint32_t    opened:1;      /*!< If this object has been opened previously */
+	uint32_t    scoped:1;      /*!< If all the memory of this object is allocated from the request scope arena */
 	_block_t*   list_begin;    /*!< The block list begin */
 	_block_t*   list_end;      /*!< The block list end */
 };
 
 static size_t pagesize = 0;
 
+/**
+ * @brief The minimal size of a data block allocated from the request scope arena
+ * @note The arena serves the small allocations from its pages, so we don't use an entire page here
+ **/
+#define _SCOPED_BLOCK_SIZE 512u
+
 static inline size_t _page_block_bytes_availiable(const _block_t* page_block)
 {
-	return pagesize - page_block->page->size - sizeof(_block_t) - sizeof(_page_data_t);
+	return page_block->page->capacity - page_block->page->size;
+}
+
+/**
+ * @brief Allocate the memory for the block header
+ * @param stream The stream that owns the block
+ * @param size The size of the block
+ * @return The allocated memory, NULL on error
+ **/
+static inline void* _block_alloc(const pstd_ostream_t* stream, size_t size)
+{
+	return stream->scoped ? pstd_mempool_scope_alloc(size) : pstd_mempool_alloc((uint32_t)size);
 }
 
-static inline _block_t* _page_block_new(void)
+/**
+ * @brief Dispose the memory for the block header
+ * @param stream The stream that owns the block
+ * @param block The block header to dispose
+ * @return status code
+ **/
+static inline int _block_dealloc(const pstd_ostream_t* stream, void* block)
+{
+	/* The arena memory is released with the request scope */
+	return stream->scoped ? 0 : pstd_mempool_free(block);
+}
+
+static inline _block_t* _page_block_new(const pstd_ostream_t* stream, size_t hint)
 {
-	_block_t* ret = pstd_mempool_page_alloc();
+	_block_t* ret;
+	size_t capacity;
+
+	if(stream->scoped)
+	{
+		capacity = _SCOPED_BLOCK_SIZE - sizeof(_block_t) - sizeof(_page_data_t);
+		if(capacity < hint) capacity = hint;
+		ret = pstd_mempool_scope_alloc(sizeof(_block_t) + sizeof(_page_data_t) + capacity);
+	}
+	else
+	{
+		capacity = pagesize - sizeof(_block_t) - sizeof(_page_data_t);
+		ret = pstd_mempool_page_alloc();
+	}
 
 	if(NULL == ret) ERROR_PTR_RETURN_LOG("Cannot allocate a new data page");
 
@@ -94,18 +138,21 @@ static inline _block_t* _page_block_new(void)
 	ret->next = NULL;
 	ret->page->size = 0;
 	ret->page->read = 0;
+	ret->page->capacity = (uint32_t)capacity;
 
 	return ret;
 }
 
-static inline int _page_block_free(_block_t* page_block)
+static inline int _page_block_free(const pstd_ostream_t* stream, _block_t* page_block)
 {
+	if(stream->scoped) return 0;
+
 	return pstd_mempool_page_dealloc(page_block);
 }
 
-static inline _block_t* _memory_block_new(void* mem, size_t size, int (*free_func)(void*))
+static inline _block_t* _memory_block_new(const pstd_ostream_t* stream, void* mem, size_t size, int (*free_func)(void*))
 {
-	_block_t* ret = pstd_mempool_alloc(sizeof(_block_t) + sizeof(_memory_buf_t));
+	_block_t* ret = _block_alloc(stream, sizeof(_block_t) + sizeof(_memory_buf_t));
 
 	if(NULL == ret) ERROR_PTR_RETURN_LOG("Cannot allocate a new memory data page");
 
@@ -119,22 +166,22 @@ static inline _block_t* _memory_block_new(void* mem, size_t size, int (*free_fun
 	return ret;
 }
 
-static inline int _memory_block_free(_block_t* memory_block)
+static inline int _memory_block_free(const pstd_ostream_t* stream, _block_t* memory_block)
 {
 	int ret = 0;
 
 	if(NULL != memory_block->memory->free_func && ERROR_CODE(int) == memory_block->memory->free_func(memory_block->memory->data))
 		ret = ERROR_CODE(int);
 
-	if(ERROR_CODE(int) == pstd_mempool_free(memory_block))
+	if(ERROR_CODE(int) == _block_dealloc(stream, memory_block))
 		ret = ERROR_CODE(int);
 
 	return ret;
 }
 
-static inline _block_t* _stream_block_new(scope_token_t token)
+static inline _block_t* _stream_block_new(const pstd_ostream_t* ostream, scope_token_t token)
 {
-	_block_t* ret = pstd_mempool_alloc(sizeof(_block_t) + sizeof(_rls_stream_t));
+	_block_t* ret = _block_alloc(ostream, sizeof(_block_t) + sizeof(_rls_stream_t));
 	if(NULL == ret)
 		ERROR_PTR_RETURN_LOG("Cannot allocate a new stream block object");
 
@@ -149,32 +196,32 @@ static inline _block_t* _stream_block_new(scope_token_t token)
 
 	return ret;
 ERR:
-	pstd_mempool_free(ret);
+	_block_dealloc(ostream, ret);
 	return NULL;
 }
 
-static inline int _stream_block_free(_block_t* stream_block)
+static inline int _stream_block_free(const pstd_ostream_t* ostream, _block_t* stream_block)
 {
 	int ret = 0;
 	if(ERROR_CODE(int) == pstd_scope_stream_close(stream_block->stream->stream))
 		ret = ERROR_CODE(int);
 
-	if(ERROR_CODE(int) == pstd_mempool_free(stream_block))
+	if(ERROR_CODE(int) == _block_dealloc(ostream, stream_block))
 		ret = ERROR_CODE(int);
 
 	return ret;
 }
 
-static inline int _block_free(_block_t* block)
+static inline int _block_free(const pstd_ostream_t* stream, _block_t* block)
 {
 	switch(block->type)
 	{
 		case _BLOCK_TYPE_PAGE:
-			return _page_block_free(block);
+			return _page_block_free(stream, block);
 		case _BLOCK_TYPE_MEMORY:
-			return _memory_block_free(block);
+			return _memory_block_free(stream, block);
 		case _BLOCK_TYPE_STREAM:
-			return _stream_block_free(block);
+			return _stream_block_free(stream, block);
 	}
 
 	return ERROR_CODE(int);
@@ -193,30 +240,49 @@ static inline int _ostream_free(pstd_ostream_t* ostream, int app_space)
 		_block_t* this = ptr;
 		ptr = ptr->next;
 
-		if(ERROR_CODE(int) == _block_free(this))
+		if(ERROR_CODE(int) == _block_free(ostream, this))
 			rc = ERROR_CODE(int);
 	}
 
+	if(ERROR_CODE(int) == _block_dealloc(ostream, ostream))
+		rc = ERROR_CODE(int);
+
 	return rc;
 }
 
-pstd_ostream_t* pstd_ostream_new(void)
+/**
+ * @brief Create a new output stream object
+ * @param scoped If we want to allocate the memory from the request scope arena
+ * @return The newly created stream object
+ **/
+static inline pstd_ostream_t* _ostream_new(int scoped)
 {
 	if(pagesize == 0)
 		pagesize = (size_t)getpagesize();
 
-	pstd_ostream_t* ret = (pstd_ostream_t*)pstd_mempool_alloc(sizeof(*ret));
+	pstd_ostream_t* ret = (pstd_ostream_t*)(scoped ? pstd_mempool_scope_alloc(sizeof(*ret)) : pstd_mempool_alloc(sizeof(*ret)));
 
 	if(NULL == ret)
 		ERROR_PTR_RETURN_LOG("Cannot allocate memory for the ostream RLS object");
 
 	ret->commited = 0;
 	ret->opened = 0;
+	ret->scoped = (scoped != 0);
 	ret->list_begin = ret->list_end = NULL;
 
 	return ret;
 }
 
+pstd_ostream_t* pstd_ostream_new(void)
+{
+	return _ostream_new(0);
+}
+
+pstd_ostream_t* pstd_ostream_new_scoped(void)
+{
+	return _ostream_new(1);
+}
+
 int pstd_ostream_free(pstd_ostream_t* ostream)
 {
 	return _ostream_free(ostream, 1);
@@ -232,9 +298,9 @@ int pstd_ostream_write(pstd_ostream_t* stream, const void* buf, size_t sz)
 	{
 		if(stream->list_end == NULL ||
 		   stream->list_end->type != _BLOCK_TYPE_PAGE ||
-		   _page_block_bytes_availiable(stream->list_end))
+		   _page_block_bytes_availiable(stream->list_end) == 0)
 		{
-			_block_t* new_block = _page_block_new();
+			_block_t* new_block = _page_block_new(stream, sz);
 			if(NULL == new_block)
 				ERROR_RETURN_LOG(int, "Cannot allocate new block page");
 
@@ -276,7 +342,7 @@ int pstd_ostream_write_owner_pointer(pstd_ostream_t* stream, void* buf, int (*fr
 		return 0;
 	}
 
-	_block_t* new_block = _memory_block_new(buf, sz, free_func);
+	_block_t* new_block = _memory_block_new(stream, buf, sz, free_func);
 	if(new_block == NULL)
 		ERROR_RETURN_LOG(int, "Cannot allocate next memory block");
 
@@ -294,7 +360,7 @@ int pstd_ostream_write_scope_token(pstd_ostream_t* stream, scope_token_t token)
 	if(NULL == stream || 0 == token || ERROR_CODE(scope_token_t) == token || stream->opened)
 		ERROR_RETURN_LOG(int, "Invalid arguments");
 
-	_block_t* new_block = _stream_block_new(token);
+	_block_t* new_block = _stream_block_new(stream, token);
 
 	if(NULL == new_block)
 		ERROR_RETURN_LOG(int, "Cannot allocate next stream block");
@@ -449,7 +515,7 @@ static size_t _read(void* __restrict stream_mem, void* __restrict buf, size_t co
 			_block_t* this = stream->list_begin;
 			if(NULL == (stream->list_begin = stream->list_begin->next))
 				stream->list_end = NULL;
-			if(ERROR_CODE(int) == _block_free(this))
+			if(ERROR_CODE(int) == _block_free(stream, this))
 				ERROR_RETURN_LOG(size_t, "Cannot dispose the exhuated data block");
 		}
 		else if(bytes_read == 0) break;  /* In this case the inner RLS is stall, thus we need to stop at this point */
@@ -22,6 +22,7 @@ struct _pstd_string_t {
 	size_t capacity;          /*!< the capacity of the string buffer */
 	size_t length;            /*!< the length of the string */
 	uint32_t commited:1;      /*!< if this string has been commited */
+	uint32_t scoped:1;        /*!< if this string and its buffer are allocated from the request scope arena */
 	uintpad_t __padding__;
 	union {
 		char     _def_buf[128];   /*!< the default initial buffer */
@@ -88,15 +89,23 @@ pstd_string_t* pstd_string_new_immutable(const char* data, size_t sz)
 	return ret;
 }
 
-pstd_string_t* pstd_string_new(size_t initcap)
+/**
+ * @brief create a new string object
+ * @param initcap the initial capacity
+ * @param scoped if we want to allocate the memory from the request scope arena
+ * @return the newly created string object, NULL on error
+ **/
+static inline pstd_string_t* _string_new(size_t initcap, int scoped)
 {
 	/* Of course, even if the initcap larger than 128, the default buffer is a waste of memory
 	 * But most of the string is smaller than 128 bytes, and this also makes the object fixed size
 	 * which is good for memory allocation performance */
-	pstd_string_t* ret = pstd_mempool_alloc(sizeof(*ret));
+	pstd_string_t* ret = scoped ? pstd_mempool_scope_alloc(sizeof(*ret)) : pstd_mempool_alloc(sizeof(*ret));
 	if(NULL == ret)
 		ERROR_PTR_RETURN_LOG("Cannot allocate string object");
 
+	ret->scoped = (scoped != 0);
+
 	if(initcap <= sizeof(ret->_def_buf))
 	{
 		LOG_DEBUG("The required buffer size is smaller than 128 bytes, use the pooled memory");
@@ -107,7 +116,7 @@ pstd_string_t* pstd_string_new(size_t initcap)
 	{
 		LOG_DEBUG("The required buffer size is larger than 128 bytes, no pooled memory avaliable");
 		ret->capacity = initcap;
-		if(NULL == (ret->buffer = malloc(ret->capacity)))
+		if(NULL == (ret->buffer = scoped ? pstd_mempool_scope_alloc(ret->capacity) : malloc(ret->capacity)))
 			ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate buffer for the string object");
 	}
 	ret->length = 0;
@@ -115,9 +124,19 @@ pstd_string_t* pstd_string_new(size_t initcap)
 	ret->buffer_offset = 0;
 	return ret;
 ERR:
-	if(NULL != ret) pstd_mempool_free(ret);
+	if(NULL != ret && !scoped) pstd_mempool_free(ret);
 	return NULL;
 }
+
+pstd_string_t* pstd_string_new(size_t initcap)
+{
+	return _string_new(initcap, 0);
+}
+
+pstd_string_t* pstd_string_new_scoped(size_t initcap)
+{
+	return _string_new(initcap, 1);
+}
 /**
  * @brief the implementation for disposing a string buffer
  * @param str the str to dispose
@@ -134,6 +153,9 @@ static inline int _free_impl(pstd_string_t* str, int user_space_call)
 	if(user_space_call && str->commited)
 		ERROR_RETURN_LOG(int, "Cannot dispose a committed string from user-space");
 
+	/* The memory will be released with the request scope */
+	if(str->scoped) return 0;
+
 	if(NULL != str->buffer)
 	{
 		if(str->buffer != str->_def_buf)
@@ -208,7 +230,7 @@ static inline void* _copy(const void* mem)
 	const pstd_string_t* ptr = (const pstd_string_t*)mem;
 
 	LOG_DEBUG("RLS string duplicated");
-	pstd_string_t* ret = pstd_string_new(ptr->buffer != NULL ? ptr->length + 1 : 0);
+	pstd_string_t* ret = _string_new(ptr->buffer != NULL ? ptr->length + 1 : 0, ptr->scoped);
 
 	if(NULL == ret)
 		ERROR_PTR_RETURN_LOG("Cannot create new string object for the duplication");
@@ -344,7 +366,14 @@ static inline int _ensure_capacity(pstd_string_t* str, size_t required_size)
 	if(newcap == str->capacity) return 0;
 
 	char* newbuf = NULL;
-	if(str->_def_buf == str->buffer)
+	if(str->scoped)
+	{
+		/* The previous buffer is released with the arena */
+		if(NULL == (newbuf = (char*)pstd_mempool_scope_alloc(newcap)))
+			ERROR_RETURN_LOG(int, "Cannot allocate arena memory for the larger buffer: size %zu", newcap);
+		memcpy(newbuf, str->buffer, str->length);
+	}
+	else if(str->_def_buf == str->buffer)
 	{
 		if(NULL == (newbuf = (char*)malloc(newcap)))
 			ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate heap memory for the larger buffer: size %zu", newcap);
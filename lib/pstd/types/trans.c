@@ -236,7 +236,6 @@ static size_t _read(void* __restrict trans_mem, void* __restrict buf, size_t cou
 		/* The the stream processor refuse to accept any bytes we just return */
 		if(bytes_accepted == 0)
 			return ret;
-		trans->origin_buf_used = 0;
 		trans->origin_buf_used += bytes_accepted;
 
 FETCH:
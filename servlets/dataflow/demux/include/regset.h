@@ -0,0 +1,48 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+/**
+ * @brief The combined matcher for a list of regular expressions
+ * @details All the patterns are compiled into a single NFA, and the NFA is converted to a DFA
+ *          whose states remember the first pattern that accepts. Thus the index of the first matching
+ *          pattern is found within a single pass of the input string, no matter how many patterns
+ *          we have. The patterns are POSIX basic regular expressions which should match the entire
+ *          string, as if they are wrapped with <code>^</code> and <code>$</code>.
+ *          The patterns using a construct that can not be expressed with a DFA, for example the back
+ *          reference, are matched with regexec one by one. The same happens to all the patterns if the
+ *          DFA grows too large.
+ * @file dataflow/demux/include/regset.h
+ **/
+#ifndef __REGSET_H__
+#define __REGSET_H__
+
+/**
+ * @brief The regular expression set
+ **/
+typedef struct _regset_t regset_t;
+
+/**
+ * @brief Compile a list of patterns to a regular expression set
+ * @param patterns The pattern list
+ * @param count The number of patterns
+ * @return The newly created set, NULL on error (including any invalid pattern)
+ **/
+regset_t* regset_new(char const* const* patterns, uint32_t count);
+
+/**
+ * @brief Dispose a regular expression set
+ * @param set The set to dispose
+ * @return status code
+ **/
+int regset_free(regset_t* set);
+
+/**
+ * @brief Find the first pattern which matches the entire string
+ * @param set The regular expression set
+ * @param str The string to match
+ * @return The index of the first matching pattern, or the number of patterns if nothing matches.
+ *         error code on error cases
+ **/
+uint32_t regset_match(const regset_t* set, const char* str);
+
+#endif /* __REGSET_H__ */
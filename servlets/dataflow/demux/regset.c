@@ -0,0 +1,1111 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <errno.h>
+#include <regex.h>
+
+#include <pservlet.h>
+
+#include <regset.h>
+
+/**
+ * @brief The node id which means nothing
+ **/
+#define _NIL ERROR_CODE(uint32_t)
+
+/**
+ * @brief The repeat count which means infinity
+ **/
+#define _INF ERROR_CODE(uint32_t)
+
+/**
+ * @brief The maximum repeat count we expand in the NFA, the pattern uses larger intervals falls back to regexec
+ **/
+#define _MAX_REPEAT 255u
+
+/**
+ * @brief The maximum number of the NFA nodes
+ **/
+#define _MAX_NFA_NODES (1u << 20)
+
+/**
+ * @brief The maximum number of entries in the DFA transition table, all the patterns fall back to regexec
+ *        when the DFA is larger than this
+ **/
+#define _MAX_DFA_TABLE (1u << 22)
+
+/**
+ * @brief A set of bytes
+ **/
+typedef struct {
+	uint8_t bits[32];     /*!< The bitmap */
+} _charset_t;
+
+/**
+ * @brief The type of the syntax tree node
+ **/
+typedef enum {
+	_AST_SET,             /*!< Matches a byte in the char set */
+	_AST_EMPTY,           /*!< Matches the empty string */
+	_AST_CAT,             /*!< The concatenation */
+	_AST_ALT,             /*!< The alternation */
+	_AST_REPEAT           /*!< The repetition */
+} _ast_type_t;
+
+/**
+ * @brief The syntax tree node
+ **/
+typedef struct {
+	_ast_type_t type;     /*!< The type of the node */
+	uint32_t    left;     /*!< The char set for a set node, the first child for other nodes */
+	uint32_t    right;    /*!< The second child */
+	uint32_t    min;      /*!< The minimum repeat count */
+	uint32_t    max;      /*!< The maximum repeat count, _INF for infinity */
+} _ast_t;
+
+/**
+ * @brief The type of the NFA node
+ **/
+typedef enum {
+	_NFA_CHAR,            /*!< Consumes a byte in the char set and goes to out[0] */
+	_NFA_EPS,             /*!< Goes to out[0] without consuming anything */
+	_NFA_SPLIT,           /*!< Goes to both out[0] and out[1] without consuming anything */
+	_NFA_MATCH            /*!< The pattern has been matched */
+} _nfa_type_t;
+
+/**
+ * @brief The NFA node
+ **/
+typedef struct {
+	_nfa_type_t type;     /*!< The type of the node */
+	uint32_t    arg;      /*!< The char set for a char node, the pattern index for a match node */
+	uint32_t    out[2];   /*!< The successors */
+} _nfa_node_t;
+
+/**
+ * @brief The state used while we compile the patterns
+ **/
+typedef struct {
+	const char*  ptr;          /*!< The current location in the pattern */
+	uint32_t     unsupported;  /*!< If the pattern uses something we can not compile */
+	_ast_t*      ast;          /*!< The syntax tree nodes of the current pattern */
+	uint32_t     nast;         /*!< The number of syntax tree nodes */
+	uint32_t     ast_cap;      /*!< The capacity of the syntax tree node array */
+	_charset_t*  sets;         /*!< The char sets */
+	uint32_t     nsets;        /*!< The number of char sets */
+	uint32_t     set_cap;      /*!< The capacity of the char set array */
+	_nfa_node_t* nodes;        /*!< The NFA nodes */
+	uint32_t     nnodes;       /*!< The number of NFA nodes */
+	uint32_t     node_cap;     /*!< The capacity of the NFA node array */
+	uint32_t*    starts;       /*!< The start node of each compiled pattern */
+	uint32_t     nstarts;      /*!< The number of compiled patterns */
+} _builder_t;
+
+/**
+ * @brief The actual data structure of the regular expression set
+ **/
+struct _regset_t {
+	uint32_t    count;         /*!< The number of patterns */
+	regex_t*    regex;         /*!< The compiled POSIX regular expressions */
+	uint32_t*   fallback;      /*!< The index of the patterns that are not in the DFA, in ascending order */
+	uint32_t    nfallback;     /*!< The number of patterns that are not in the DFA */
+	uint32_t    nclass;        /*!< The number of byte classes */
+	uint8_t     cls[256];      /*!< The byte class of each byte */
+	uint32_t    start;         /*!< The start state, the state id is premultiplied by nclass */
+	uint32_t*   trans;         /*!< The transition table, NULL if we don't have the DFA */
+	uint32_t*   accept;        /*!< The first pattern accepted by each state, count if nothing accepts */
+};
+
+/**
+ * @brief Make sure the array has room for one more element
+ * @param arr The array
+ * @param cap The capacity
+ * @param size The number of elements
+ * @param elem_size The size of element
+ * @return status code
+ **/
+static inline int _ensure(void** arr, uint32_t* cap, uint32_t size, size_t elem_size)
+{
+	if(size < *cap) return 0;
+
+	uint32_t new_cap = *cap == 0 ? 32 : *cap * 2;
+	void* new_arr = realloc(*arr, elem_size * new_cap);
+	if(NULL == new_arr)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot resize the array");
+
+	*arr = new_arr;
+	*cap = new_cap;
+	return 0;
+}
+
+/**
+ * @brief Create a new syntax tree node
+ * @param b The builder
+ * @param type The type of the node
+ * @param left The left child or the char set
+ * @param right The right child
+ * @return The node id or error code
+ **/
+static inline uint32_t _ast_new(_builder_t* b, _ast_type_t type, uint32_t left, uint32_t right)
+{
+	if(ERROR_CODE(int) == _ensure((void**)&b->ast, &b->ast_cap, b->nast, sizeof(b->ast[0])))
+		ERROR_RETURN_LOG(uint32_t, "Cannot allocate the syntax tree node");
+
+	_ast_t* node = b->ast + b->nast;
+	node->type = type;
+	node->left = left;
+	node->right = right;
+	node->min = node->max = 0;
+
+	return b->nast ++;
+}
+
+/**
+ * @brief Create a new char set node with an empty char set
+ * @param b The builder
+ * @param set The buffer used to return the char set
+ * @return The node id or error code
+ **/
+static inline uint32_t _ast_new_set(_builder_t* b, _charset_t** set)
+{
+	if(ERROR_CODE(int) == _ensure((void**)&b->sets, &b->set_cap, b->nsets, sizeof(b->sets[0])))
+		ERROR_RETURN_LOG(uint32_t, "Cannot allocate the char set");
+
+	memset(b->sets + b->nsets, 0, sizeof(b->sets[0]));
+
+	uint32_t ret = _ast_new(b, _AST_SET, b->nsets, 0);
+	if(ERROR_CODE(uint32_t) == ret) return ret;
+
+	*set = b->sets + (b->nsets ++);
+	return ret;
+}
+
+/**
+ * @brief Add a byte to the char set
+ * @param set The char set
+ * @param ch The byte
+ * @return nothing
+ **/
+static inline void _set_add(_charset_t* set, uint32_t ch)
+{
+	set->bits[(ch & 0xff) >> 3] = (uint8_t)(set->bits[(ch & 0xff) >> 3] | (1u << (ch & 7)));
+}
+
+/**
+ * @brief Check if the byte is in the char set
+ * @param set The char set
+ * @param ch The byte
+ * @return The check result
+ **/
+static inline int _set_has(const _charset_t* set, uint32_t ch)
+{
+	return (set->bits[(ch & 0xff) >> 3] >> (ch & 7)) & 1;
+}
+
+/**
+ * @brief Mark the pattern can not be compiled to the DFA
+ * @param b The builder
+ * @return error code
+ **/
+static inline uint32_t _unsupported(_builder_t* b)
+{
+	b->unsupported = 1;
+	return ERROR_CODE(uint32_t);
+}
+
+/**
+ * @brief Parse a named char class, i.e. <code>[:alpha:]</code> in a bracket expression
+ * @param b The builder
+ * @param set The char set we should add the class to
+ * @note b->ptr points to the "[:" when this function gets called
+ * @return status code
+ **/
+static inline int _parse_class(_builder_t* b, _charset_t* set)
+{
+	static const struct {
+		const char* name;
+		int (*pred)(int);
+	} classes[] = {
+		{"alpha", isalpha}, {"digit", isdigit}, {"alnum", isalnum}, {"upper", isupper},
+		{"lower", islower}, {"space", isspace}, {"blank", isblank}, {"punct", ispunct},
+		{"print", isprint}, {"graph", isgraph}, {"cntrl", iscntrl}, {"xdigit", isxdigit}
+	};
+
+	const char* name = b->ptr + 2;
+	const char* end = strstr(name, ":]");
+	if(NULL == end) return ERROR_CODE(int);
+
+	uint32_t i;
+	for(i = 0; i < sizeof(classes) / sizeof(classes[0]); i ++)
+		if(strlen(classes[i].name) == (size_t)(end - name) && 0 == memcmp(classes[i].name, name, (size_t)(end - name)))
+		{
+			uint32_t ch;
+			for(ch = 1; ch < 256; ch ++)
+				if(classes[i].pred((int)ch))
+					_set_add(set, ch);
+			b->ptr = end + 2;
+			return 0;
+		}
+
+	return ERROR_CODE(int);
+}
+
+/**
+ * @brief Parse a bracket expression
+ * @param b The builder
+ * @note b->ptr points to the char right after the '['
+ * @return The syntax tree node or error code
+ **/
+static inline uint32_t _parse_bracket(_builder_t* b)
+{
+	_charset_t* set;
+	uint32_t ret = _ast_new_set(b, &set);
+	if(ERROR_CODE(uint32_t) == ret) return ret;
+
+	int negate = 0, first = 1;
+	if(b->ptr[0] == '^')
+	{
+		negate = 1;
+		b->ptr ++;
+	}
+
+	for(;;first = 0)
+	{
+		uint8_t ch = (uint8_t)b->ptr[0];
+
+		if(ch == 0) return _unsupported(b);
+
+		if(ch == ']' && !first)
+		{
+			b->ptr ++;
+			break;
+		}
+
+		if(ch == '[' && b->ptr[1] == ':')
+		{
+			if(ERROR_CODE(int) == _parse_class(b, set))
+				return _unsupported(b);
+			continue;
+		}
+
+		/* Collating symbols and equivalence classes depend on the locale */
+		if(ch == '[' && (b->ptr[1] == '.' || b->ptr[1] == '='))
+			return _unsupported(b);
+
+		b->ptr ++;
+
+		if(b->ptr[0] == '-' && b->ptr[1] != ']' && b->ptr[1] != 0)
+		{
+			uint8_t hi = (uint8_t)b->ptr[1];
+			if(hi == '[' || hi < ch) return _unsupported(b);
+			uint32_t c;
+			for(c = ch; c <= hi; c ++)
+				_set_add(set, c);
+			b->ptr += 2;
+		}
+		else _set_add(set, ch);
+	}
+
+	if(negate)
+	{
+		uint32_t i;
+		for(i = 0; i < sizeof(set->bits); i ++)
+			set->bits[i] = (uint8_t)~set->bits[i];
+	}
+
+	/* The NUL char never appears in the string */
+	set->bits[0] &= (uint8_t)~1u;
+
+	return ret;
+}
+
+/**
+ * @brief Create a syntax tree node matches a single byte
+ * @param b The builder
+ * @param ch The byte
+ * @return The node id or error code
+ **/
+static inline uint32_t _ast_new_char(_builder_t* b, uint8_t ch)
+{
+	_charset_t* set;
+	uint32_t ret = _ast_new_set(b, &set);
+	if(ERROR_CODE(uint32_t) == ret) return ret;
+	_set_add(set, ch);
+	return ret;
+}
+
+static uint32_t _parse_regex(_builder_t* b, int top_level);
+
+/**
+ * @brief Parse an atom, which is a char, a bracket expression or a group
+ * @param b The builder
+ * @param branch_begin If this atom is the first one in the branch
+ * @return The syntax tree node id or error code
+ **/
+static inline uint32_t _parse_atom(_builder_t* b, int branch_begin)
+{
+	char ch = *(b->ptr ++);
+	_charset_t* set;
+	uint32_t ret;
+
+	switch(ch)
+	{
+		case '.':
+			if(ERROR_CODE(uint32_t) == (ret = _ast_new_set(b, &set)))
+				return ret;
+			memset(set->bits, 0xff, sizeof(set->bits));
+			set->bits[0] &= (uint8_t)~1u;
+			return ret;
+		case '[':
+			return _parse_bracket(b);
+		case '^':
+		case '$':
+			/* The anchors in the middle of the pattern are rarely used, and they are left to regexec */
+			return _unsupported(b);
+		case '*':
+			/* A star at the begining of a branch is a literal */
+			if(!branch_begin) return _unsupported(b);
+			return _ast_new_char(b, '*');
+		case '\\':
+			ch = *(b->ptr ++);
+			if(ch == '(')
+			{
+				if(ERROR_CODE(uint32_t) == (ret = _parse_regex(b, 0)))
+					return ret;
+				if(b->ptr[0] != '\\' || b->ptr[1] != ')')
+					return _unsupported(b);
+				b->ptr += 2;
+				return ret;
+			}
+			/* Back references, word boundaries, GNU shorthands and the operators in a wrong place */
+			if(ch == 0 || isalnum((uint8_t)ch) || NULL != strchr("(){}|+?<>`'", ch))
+				return _unsupported(b);
+			return _ast_new_char(b, (uint8_t)ch);
+		default:
+			return _ast_new_char(b, (uint8_t)ch);
+	}
+}
+
+/**
+ * @brief Parse an interval, i.e. <code>\{m,n\}</code>
+ * @param b The builder
+ * @param min The buffer for the minimum repeat count
+ * @param max The buffer for the maximum repeat count
+ * @note b->ptr points to the char right after the "\{"
+ * @return status code
+ **/
+static inline int _parse_interval(_builder_t* b, uint32_t* min, uint32_t* max)
+{
+	char* end;
+	if(!isdigit((uint8_t)b->ptr[0])) return ERROR_CODE(int);
+	unsigned long val = strtoul(b->ptr, &end, 10);
+	if(val > _MAX_REPEAT) return ERROR_CODE(int);
+	*min = *max = (uint32_t)val;
+	b->ptr = end;
+
+	if(b->ptr[0] == ',')
+	{
+		b->ptr ++;
+		*max = _INF;
+		if(isdigit((uint8_t)b->ptr[0]))
+		{
+			val = strtoul(b->ptr, &end, 10);
+			if(val > _MAX_REPEAT || val < *min) return ERROR_CODE(int);
+			*max = (uint32_t)val;
+			b->ptr = end;
+		}
+	}
+
+	if(b->ptr[0] != '\\' || b->ptr[1] != '}') return ERROR_CODE(int);
+	b->ptr += 2;
+
+	return 0;
+}
+
+/**
+ * @brief Parse an atom followed by any number of repetition operators
+ * @param b The builder
+ * @param branch_begin If this is the first piece in the branch
+ * @return The syntax tree node id or error code
+ **/
+static inline uint32_t _parse_piece(_builder_t* b, int branch_begin)
+{
+	uint32_t ret = _parse_atom(b, branch_begin);
+	if(ERROR_CODE(uint32_t) == ret) return ret;
+
+	for(;;)
+	{
+		uint32_t min, max;
+		if(b->ptr[0] == '*')
+		{
+			min = 0, max = _INF;
+			b->ptr ++;
+		}
+		else if(b->ptr[0] == '\\' && b->ptr[1] == '+')
+		{
+			min = 1, max = _INF;
+			b->ptr += 2;
+		}
+		else if(b->ptr[0] == '\\' && b->ptr[1] == '?')
+		{
+			min = 0, max = 1;
+			b->ptr += 2;
+		}
+		else if(b->ptr[0] == '\\' && b->ptr[1] == '{')
+		{
+			b->ptr += 2;
+			if(ERROR_CODE(int) == _parse_interval(b, &min, &max))
+				return _unsupported(b);
+		}
+		else break;
+
+		if(ERROR_CODE(uint32_t) == (ret = _ast_new(b, _AST_REPEAT, ret, 0)))
+			return ret;
+		b->ast[ret].min = min;
+		b->ast[ret].max = max;
+	}
+
+	return ret;
+}
+
+/**
+ * @brief Parse a branch, which is a sequence of pieces
+ * @param b The builder
+ * @return The syntax tree node id or error code
+ **/
+static inline uint32_t _parse_branch(_builder_t* b)
+{
+	uint32_t ret = _ast_new(b, _AST_EMPTY, 0, 0);
+	int branch_begin = 1;
+
+	while(ret != ERROR_CODE(uint32_t) && b->ptr[0] != 0 && !(b->ptr[0] == '\\' && (b->ptr[1] == '|' || b->ptr[1] == ')')))
+	{
+		uint32_t piece = _parse_piece(b, branch_begin);
+		if(ERROR_CODE(uint32_t) == piece) return piece;
+
+		ret = branch_begin ? piece : _ast_new(b, _AST_CAT, ret, piece);
+		branch_begin = 0;
+	}
+
+	return ret;
+}
+
+/**
+ * @brief Parse the alternation of branches
+ * @param b The builder
+ * @param top_level If this is the top level of the pattern
+ * @return The syntax tree node id or error code
+ **/
+static uint32_t _parse_regex(_builder_t* b, int top_level)
+{
+	uint32_t ret = _parse_branch(b);
+
+	while(ret != ERROR_CODE(uint32_t) && b->ptr[0] == '\\' && b->ptr[1] == '|')
+	{
+		/* The pattern is wrapped by the anchors, so "a\|b" actually means "^a\|b$" for regexec */
+		if(top_level) return _unsupported(b);
+		b->ptr += 2;
+
+		uint32_t branch = _parse_branch(b);
+		if(ERROR_CODE(uint32_t) == branch) return branch;
+
+		ret = _ast_new(b, _AST_ALT, ret, branch);
+	}
+
+	if(top_level && ret != ERROR_CODE(uint32_t) && b->ptr[0] != 0)
+		return _unsupported(b);
+
+	return ret;
+}
+
+/**
+ * @brief Create a new NFA node
+ * @param b The builder
+ * @param type The node type
+ * @param arg The node argument
+ * @param out0 The first successor
+ * @param out1 The second successor
+ * @return The node id or error code
+ **/
+static inline uint32_t _nfa_new(_builder_t* b, _nfa_type_t type, uint32_t arg, uint32_t out0, uint32_t out1)
+{
+	if(b->nnodes >= _MAX_NFA_NODES) return _unsupported(b);
+
+	if(ERROR_CODE(int) == _ensure((void**)&b->nodes, &b->node_cap, b->nnodes, sizeof(b->nodes[0])))
+		ERROR_RETURN_LOG(uint32_t, "Cannot allocate the NFA node");
+
+	_nfa_node_t* node = b->nodes + b->nnodes;
+	node->type = type;
+	node->arg = arg;
+	node->out[0] = out0;
+	node->out[1] = out1;
+
+	return b->nnodes ++;
+}
+
+/**
+ * @brief Compile the syntax tree to an NFA fragment
+ * @details Each fragment has a single entry and ends with an epsilon node whose successor is not set yet
+ * @param b The builder
+ * @param ast The syntax tree node
+ * @param start The buffer for the entry node of the fragment
+ * @param end The buffer for the last node of the fragment
+ * @return status code
+ **/
+static int _compile(_builder_t* b, uint32_t ast, uint32_t* start, uint32_t* end)
+{
+	const _ast_t node = b->ast[ast];
+	uint32_t s0, e0, s1, e1, i;
+
+	switch(node.type)
+	{
+		case _AST_EMPTY:
+			if(ERROR_CODE(uint32_t) == (*start = *end = _nfa_new(b, _NFA_EPS, 0, _NIL, _NIL)))
+				return ERROR_CODE(int);
+			return 0;
+		case _AST_SET:
+			if(ERROR_CODE(uint32_t) == (*end = _nfa_new(b, _NFA_EPS, 0, _NIL, _NIL)))
+				return ERROR_CODE(int);
+			if(ERROR_CODE(uint32_t) == (*start = _nfa_new(b, _NFA_CHAR, node.left, *end, _NIL)))
+				return ERROR_CODE(int);
+			return 0;
+		case _AST_CAT:
+			if(ERROR_CODE(int) == _compile(b, node.left, &s0, &e0) ||
+			   ERROR_CODE(int) == _compile(b, node.right, &s1, &e1))
+				return ERROR_CODE(int);
+			b->nodes[e0].out[0] = s1;
+			*start = s0;
+			*end = e1;
+			return 0;
+		case _AST_ALT:
+			if(ERROR_CODE(int) == _compile(b, node.left, &s0, &e0) ||
+			   ERROR_CODE(int) == _compile(b, node.right, &s1, &e1))
+				return ERROR_CODE(int);
+			if(ERROR_CODE(uint32_t) == (*start = _nfa_new(b, _NFA_SPLIT, 0, s0, s1)) ||
+			   ERROR_CODE(uint32_t) == (*end = _nfa_new(b, _NFA_EPS, 0, _NIL, _NIL)))
+				return ERROR_CODE(int);
+			b->nodes[e0].out[0] = b->nodes[e1].out[0] = *end;
+			return 0;
+		case _AST_REPEAT:
+			if(ERROR_CODE(uint32_t) == (*start = *end = _nfa_new(b, _NFA_EPS, 0, _NIL, _NIL)))
+				return ERROR_CODE(int);
+			/* The mandatory copies */
+			for(i = 0; i < node.min; i ++)
+			{
+				if(ERROR_CODE(int) == _compile(b, node.left, &s0, &e0))
+					return ERROR_CODE(int);
+				b->nodes[*end].out[0] = s0;
+				*end = e0;
+			}
+			/* The optional copies, for the infinity case, the copy loops back to the split node */
+			for(i = node.min; i < node.max; i ++)
+			{
+				uint32_t split;
+				if(ERROR_CODE(int) == _compile(b, node.left, &s0, &e0) ||
+				   ERROR_CODE(uint32_t) == (split = _nfa_new(b, _NFA_SPLIT, 0, s0, _NIL)) ||
+				   ERROR_CODE(uint32_t) == (e1 = _nfa_new(b, _NFA_EPS, 0, _NIL, _NIL)))
+					return ERROR_CODE(int);
+				b->nodes[*end].out[0] = split;
+				b->nodes[split].out[1] = e1;
+				b->nodes[e0].out[0] = node.max == _INF ? split : e1;
+				*end = e1;
+				if(node.max == _INF) break;
+			}
+			return 0;
+	}
+
+	ERROR_RETURN_LOG(int, "Invalid syntax tree node");
+}
+
+/**
+ * @brief Compile a pattern and add it to the NFA
+ * @param b The builder
+ * @param pattern The pattern
+ * @param index The index of the pattern
+ * @return 1 if the pattern has been added, 0 if the pattern is not supported, error code on error
+ **/
+static inline int _add_pattern(_builder_t* b, const char* pattern, uint32_t index)
+{
+	uint32_t saved_nodes = b->nnodes;
+	uint32_t root, start, end, match;
+
+	b->ptr = pattern;
+	b->unsupported = 0;
+	b->nast = 0;
+
+	if(ERROR_CODE(uint32_t) == (root = _parse_regex(b, 1)) ||
+	   ERROR_CODE(int) == _compile(b, root, &start, &end) ||
+	   ERROR_CODE(uint32_t) == (match = _nfa_new(b, _NFA_MATCH, index, _NIL, _NIL)))
+	{
+		if(!b->unsupported) return ERROR_CODE(int);
+		b->nnodes = saved_nodes;
+		return 0;
+	}
+
+	b->nodes[end].out[0] = match;
+	b->starts[b->nstarts ++] = start;
+
+	return 1;
+}
+
+/**
+ * @brief The temporary data used by the subset construction
+ **/
+typedef struct {
+	const _builder_t* b;       /*!< The builder */
+	uint32_t*   mark;          /*!< The visit mark of each NFA node */
+	uint32_t    gen;           /*!< The current mark generation */
+	uint32_t*   stack;         /*!< The DFS stack */
+	uint32_t*   buf;           /*!< The buffer for the node set */
+	uint32_t*   pool;          /*!< The node sets of the DFA states */
+	size_t      pool_size;     /*!< The number of ids in the pool */
+	size_t      pool_cap;      /*!< The capacity of the pool */
+	size_t*     offset;        /*!< The offset of the node set in the pool for each state */
+	uint32_t*   size;          /*!< The size of the node set for each state */
+	uint32_t*   next;          /*!< The next state in the same hash slot */
+	uint32_t    nstates;       /*!< The number of DFA states */
+	uint32_t    state_cap;     /*!< The capacity of the state arrays */
+	uint32_t*   slots;         /*!< The hash slots */
+	uint32_t    nslots;        /*!< The number of hash slots, which is a power of 2 */
+} _subset_t;
+
+static int _id_cmp(const void* a, const void* b)
+{
+	uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Compute the epsilon closure of the seed nodes, only the char nodes and match nodes are kept
+ * @param s The subset construction data
+ * @param seeds The seed nodes
+ * @param nseeds The number of seeds
+ * @return The number of nodes in s->buf
+ **/
+static inline uint32_t _closure(_subset_t* s, const uint32_t* seeds, uint32_t nseeds)
+{
+	uint32_t sp = 0, ret = 0, i;
+	const _nfa_node_t* nodes = s->b->nodes;
+
+	s->gen ++;
+
+	for(i = 0; i < nseeds; i ++)
+		if(s->mark[seeds[i]] != s->gen)
+		{
+			s->mark[seeds[i]] = s->gen;
+			s->stack[sp ++] = seeds[i];
+		}
+
+	while(sp > 0)
+	{
+		uint32_t cur = s->stack[-- sp];
+		uint32_t k;
+		switch(nodes[cur].type)
+		{
+			case _NFA_CHAR:
+			case _NFA_MATCH:
+				s->buf[ret ++] = cur;
+				break;
+			case _NFA_EPS:
+			case _NFA_SPLIT:
+				for(k = 0; k < 2; k ++)
+				{
+					uint32_t next = nodes[cur].out[k];
+					if(next != _NIL && s->mark[next] != s->gen)
+					{
+						s->mark[next] = s->gen;
+						s->stack[sp ++] = next;
+					}
+				}
+		}
+	}
+
+	qsort(s->buf, ret, sizeof(s->buf[0]), _id_cmp);
+
+	return ret;
+}
+
+/**
+ * @brief Compute the hash code of a node set
+ * @param set The node set
+ * @param n The size of the set
+ * @return The hash code
+ **/
+static inline uint32_t _set_hash(const uint32_t* set, uint32_t n)
+{
+	uint32_t ret = 2166136261u, i;
+	for(i = 0; i < n; i ++)
+		ret = (ret ^ set[i]) * 16777619u;
+	return ret;
+}
+
+/**
+ * @brief Rebuild the hash slots with the given number of slots
+ * @param s The subset construction data
+ * @param nslots The number of slots
+ * @return status code
+ **/
+static inline int _rehash(_subset_t* s, uint32_t nslots)
+{
+	uint32_t* slots = (uint32_t*)malloc(sizeof(slots[0]) * nslots);
+	if(NULL == slots)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate the hash slots");
+
+	memset(slots, 0xff, sizeof(slots[0]) * nslots);
+
+	uint32_t i;
+	for(i = 0; i < s->nstates; i ++)
+	{
+		uint32_t h = _set_hash(s->pool + s->offset[i], s->size[i]) & (nslots - 1);
+		s->next[i] = slots[h];
+		slots[h] = i;
+	}
+
+	free(s->slots);
+	s->slots = slots;
+	s->nslots = nslots;
+
+	return 0;
+}
+
+/**
+ * @brief Find the DFA state for the node set in s->buf, create a new state if it's not found
+ * @param s The subset construction data
+ * @param n The size of the node set
+ * @return The state id or error code
+ **/
+static inline uint32_t _state_get(_subset_t* s, uint32_t n)
+{
+	uint32_t h = _set_hash(s->buf, n), i;
+
+	for(i = s->slots[h & (s->nslots - 1)]; i != _NIL; i = s->next[i])
+		if(s->size[i] == n && 0 == memcmp(s->pool + s->offset[i], s->buf, sizeof(s->buf[0]) * n))
+			return i;
+
+	if(s->nstates >= s->state_cap)
+	{
+		uint32_t cap = s->state_cap * 2;
+		size_t* offset = (size_t*)realloc(s->offset, sizeof(offset[0]) * cap);
+		if(NULL == offset) ERROR_RETURN_LOG_ERRNO(uint32_t, "Cannot resize the state array");
+		s->offset = offset;
+		uint32_t* size = (uint32_t*)realloc(s->size, sizeof(size[0]) * cap);
+		if(NULL == size) ERROR_RETURN_LOG_ERRNO(uint32_t, "Cannot resize the state array");
+		s->size = size;
+		uint32_t* next = (uint32_t*)realloc(s->next, sizeof(next[0]) * cap);
+		if(NULL == next) ERROR_RETURN_LOG_ERRNO(uint32_t, "Cannot resize the state array");
+		s->next = next;
+		s->state_cap = cap;
+	}
+
+	if(s->pool_size + n > s->pool_cap)
+	{
+		size_t cap = s->pool_cap * 2;
+		while(cap < s->pool_size + n) cap *= 2;
+		uint32_t* pool = (uint32_t*)realloc(s->pool, sizeof(pool[0]) * cap);
+		if(NULL == pool) ERROR_RETURN_LOG_ERRNO(uint32_t, "Cannot resize the node set pool");
+		s->pool = pool;
+		s->pool_cap = cap;
+	}
+
+	uint32_t ret = s->nstates ++;
+	memcpy(s->pool + s->pool_size, s->buf, sizeof(s->buf[0]) * n);
+	s->offset[ret] = s->pool_size;
+	s->size[ret] = n;
+	s->pool_size += n;
+
+	s->next[ret] = s->slots[h & (s->nslots - 1)];
+	s->slots[h & (s->nslots - 1)] = ret;
+
+	if(s->nstates * 2 >= s->nslots && ERROR_CODE(int) == _rehash(s, s->nslots * 2))
+		return ERROR_CODE(uint32_t);
+
+	return ret;
+}
+
+/**
+ * @brief Split the bytes into classes, so that the bytes in the same class are not distinguished by any char set
+ * @param set The regular expression set
+ * @param b The builder
+ * @return nothing
+ **/
+static inline void _compute_classes(regset_t* set, const _builder_t* b)
+{
+	uint32_t i, ch;
+	memset(set->cls, 0, sizeof(set->cls));
+	set->nclass = 1;
+
+	for(i = 0; i < b->nsets; i ++)
+	{
+		uint32_t map[512];
+		uint32_t nclass = 0;
+		memset(map, 0xff, sizeof(map));
+
+		for(ch = 0; ch < 256; ch ++)
+		{
+			uint32_t key = set->cls[ch] * 2u + (uint32_t)_set_has(b->sets + i, ch);
+			if(map[key] == _NIL) map[key] = nclass ++;
+			set->cls[ch] = (uint8_t)map[key];
+		}
+
+		set->nclass = nclass;
+	}
+}
+
+/**
+ * @brief Convert the NFA to the DFA with the subset construction
+ * @param set The regular expression set
+ * @param b The builder
+ * @return 1 if the DFA has been built, 0 if the DFA is too large, error code on error
+ **/
+static inline int _build_dfa(regset_t* set, const _builder_t* b)
+{
+	int ret = ERROR_CODE(int);
+	uint32_t rep[256], i, c, nclass;
+	uint32_t* seeds = NULL;
+	_subset_t s = {
+		.b = b,
+		.state_cap = 64,
+		.pool_cap = 1024
+	};
+
+	_compute_classes(set, b);
+	nclass = set->nclass;
+	for(c = 0; c < nclass; c ++)
+		for(rep[c] = 0; set->cls[rep[c]] != c; rep[c] ++);
+
+	if(NULL == (s.mark = (uint32_t*)calloc(b->nnodes, sizeof(s.mark[0]))) ||
+	   NULL == (s.stack = (uint32_t*)malloc(sizeof(s.stack[0]) * b->nnodes)) ||
+	   NULL == (s.buf = (uint32_t*)malloc(sizeof(s.buf[0]) * b->nnodes)) ||
+	   NULL == (seeds = (uint32_t*)malloc(sizeof(seeds[0]) * b->nnodes)) ||
+	   NULL == (s.pool = (uint32_t*)malloc(sizeof(s.pool[0]) * s.pool_cap)) ||
+	   NULL == (s.offset = (size_t*)malloc(sizeof(s.offset[0]) * s.state_cap)) ||
+	   NULL == (s.size = (uint32_t*)malloc(sizeof(s.size[0]) * s.state_cap)) ||
+	   NULL == (s.next = (uint32_t*)malloc(sizeof(s.next[0]) * s.state_cap)))
+		ERROR_LOG_ERRNO_GOTO(EXIT, "Cannot allocate memory for the subset construction");
+
+	if(ERROR_CODE(int) == _rehash(&s, 64))
+		ERROR_LOG_GOTO(EXIT, "Cannot initialize the hash slots");
+
+	/* The state 0 is the dead state, and the state 1 is the start state */
+	if(ERROR_CODE(uint32_t) == _state_get(&s, 0) ||
+	   ERROR_CODE(uint32_t) == _state_get(&s, _closure(&s, b->starts, b->nstarts)))
+		ERROR_LOG_GOTO(EXIT, "Cannot create the initial states");
+
+	uint32_t cap = 0;
+	for(i = 0; i < s.nstates; i ++)
+	{
+		if((size_t)s.nstates * nclass > _MAX_DFA_TABLE)
+		{
+			LOG_NOTICE("The DFA is too large, all the patterns are matched with regexec");
+			ret = 0;
+			goto EXIT;
+		}
+
+		if(s.nstates > cap)
+		{
+			cap = s.state_cap;
+			uint32_t* trans = (uint32_t*)realloc(set->trans, sizeof(trans[0]) * cap * nclass);
+			if(NULL == trans) ERROR_LOG_ERRNO_GOTO(EXIT, "Cannot resize the transition table");
+			set->trans = trans;
+		}
+
+		for(c = 0; c < nclass; c ++)
+		{
+			uint32_t nseeds = 0, k;
+			const uint32_t* nodes = s.pool + s.offset[i];
+			for(k = 0; k < s.size[i]; k ++)
+			{
+				const _nfa_node_t* node = b->nodes + nodes[k];
+				if(node->type == _NFA_CHAR && _set_has(b->sets + node->arg, rep[c]))
+					seeds[nseeds ++] = node->out[0];
+			}
+
+			uint32_t next = _state_get(&s, _closure(&s, seeds, nseeds));
+			if(ERROR_CODE(uint32_t) == next)
+				ERROR_LOG_GOTO(EXIT, "Cannot get the next state");
+
+			set->trans[i * nclass + c] = next * nclass;
+
+			if(s.nstates > cap)
+			{
+				cap = s.state_cap;
+				uint32_t* trans = (uint32_t*)realloc(set->trans, sizeof(trans[0]) * cap * nclass);
+				if(NULL == trans) ERROR_LOG_ERRNO_GOTO(EXIT, "Cannot resize the transition table");
+				set->trans = trans;
+			}
+		}
+	}
+
+	if(NULL == (set->accept = (uint32_t*)malloc(sizeof(set->accept[0]) * s.nstates)))
+		ERROR_LOG_ERRNO_GOTO(EXIT, "Cannot allocate the accept array");
+
+	for(i = 0; i < s.nstates; i ++)
+	{
+		uint32_t k;
+		set->accept[i] = set->count;
+		for(k = 0; k < s.size[i]; k ++)
+		{
+			const _nfa_node_t* node = b->nodes + s.pool[s.offset[i] + k];
+			if(node->type == _NFA_MATCH && node->arg < set->accept[i])
+				set->accept[i] = node->arg;
+		}
+	}
+
+	set->start = nclass;
+	LOG_DEBUG("Compiled %u patterns to a DFA with %u states and %u byte classes", b->nstarts, s.nstates, nclass);
+	ret = 1;
+EXIT:
+	if(ret != 1 && NULL != set->trans)
+	{
+		free(set->trans);
+		set->trans = NULL;
+	}
+	free(s.mark);
+	free(s.stack);
+	free(s.buf);
+	free(seeds);
+	free(s.pool);
+	free(s.offset);
+	free(s.size);
+	free(s.next);
+	free(s.slots);
+	return ret;
+}
+
+regset_t* regset_new(char const* const* patterns, uint32_t count)
+{
+	if(NULL == patterns && count > 0)
+		ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	uint32_t i, ncompiled = 0;
+	int in_dfa = 0;
+	uint8_t* supported = NULL;
+	_builder_t b = {.starts = NULL};
+
+	regset_t* ret = (regset_t*)calloc(1, sizeof(*ret));
+	if(NULL == ret)
+		ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the regular expression set");
+
+	ret->count = count;
+
+	if(count > 0 &&
+	   (NULL == (ret->regex = (regex_t*)calloc(count, sizeof(ret->regex[0]))) ||
+	    NULL == (ret->fallback = (uint32_t*)malloc(sizeof(ret->fallback[0]) * count)) ||
+	    NULL == (supported = (uint8_t*)calloc(count, 1)) ||
+	    NULL == (b.starts = (uint32_t*)malloc(sizeof(b.starts[0]) * count))))
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the pattern table");
+
+	for(i = 0; i < count; i ++, ncompiled ++)
+	{
+		/* The patterns are always validated by regcomp, and the compiled one is used when the pattern is not in the DFA */
+		char regbuf[1024];
+		int rc;
+		snprintf(regbuf, sizeof(regbuf), "^%s$", patterns[i]);
+		if(0 != (rc = regcomp(ret->regex + i, regbuf, 0)))
+		{
+#ifdef LOG_ERROR_ENABLED
+			char buffer[1024];
+			regerror(rc, ret->regex + i, buffer, sizeof(buffer));
+#endif
+			ERROR_LOG_GOTO(ERR, "Can't compile regex: %s", buffer);
+		}
+
+		if(strlen(patterns[i]) + 2 >= sizeof(regbuf)) continue;
+
+		if(ERROR_CODE(int) == (rc = _add_pattern(&b, patterns[i], i)))
+			ERROR_LOG_GOTO(ERR, "Cannot add the pattern to the NFA");
+
+		supported[i] = (uint8_t)rc;
+	}
+
+	if(b.nstarts > 0 && ERROR_CODE(int) == (in_dfa = _build_dfa(ret, &b)))
+		ERROR_LOG_GOTO(ERR, "Cannot build the DFA");
+
+	for(i = 0; i < count; i ++)
+		if(!in_dfa || !supported[i])
+			ret->fallback[ret->nfallback ++] = i;
+
+	if(ret->nfallback > 0)
+		LOG_DEBUG("%u of %u patterns are matched with regexec", ret->nfallback, count);
+
+	free(supported);
+	free(b.ast);
+	free(b.sets);
+	free(b.nodes);
+	free(b.starts);
+	return ret;
+ERR:
+	for(i = 0; i < ncompiled; i ++)
+		regfree(ret->regex + i);
+	free(ret->regex);
+	free(ret->fallback);
+	free(ret);
+	free(supported);
+	free(b.ast);
+	free(b.sets);
+	free(b.nodes);
+	free(b.starts);
+	return NULL;
+}
+
+int regset_free(regset_t* set)
+{
+	if(NULL == set)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	uint32_t i;
+	for(i = 0; i < set->count; i ++)
+		regfree(set->regex + i);
+
+	free(set->regex);
+	free(set->fallback);
+	free(set->trans);
+	free(set->accept);
+	free(set);
+
+	return 0;
+}
+
+uint32_t regset_match(const regset_t* set, const char* str)
+{
+	if(NULL == set || NULL == str)
+		ERROR_RETURN_LOG(uint32_t, "Invalid arguments");
+
+	uint32_t ret = set->count, i;
+
+	if(NULL != set->trans)
+	{
+		const uint32_t* trans = set->trans;
+		const uint8_t*  cls = set->cls;
+		const uint8_t*  ptr = (const uint8_t*)str;
+		uint32_t state = set->start;
+
+		for(; *ptr && state; ptr ++)
+			state = trans[state + cls[*ptr]];
+
+		ret = set->accept[state / set->nclass];
+	}
+
+	for(i = 0; i < set->nfallback && set->fallback[i] < ret; i ++)
+	{
+		int rc = regexec(set->regex + set->fallback[i], str, 0, NULL, 0);
+		if(rc == 0)
+			return set->fallback[i];
+
+		if(rc != REG_NOMATCH)
+		{
+#ifdef LOG_ERROR_ENABLED
+			char buffer[1024];
+			regerror(rc, set->regex + set->fallback[i], buffer, sizeof(buffer));
+#endif
+			ERROR_RETURN_LOG(uint32_t, "Regex error: %s", buffer);
+		}
+	}
+
+	return ret;
+}
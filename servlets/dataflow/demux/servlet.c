@@ -4,7 +4,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
-#include <regex.h>
 #include <time.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -16,8 +15,10 @@
 
 #include <pstd/types/string.h>
 
+#include <regset.h>
+
 /**
- * @brief The size of the hash table used for the pattern
+ * @brief The minimum size of the hash table used for the pattern
  **/
 #define HASH_SIZE 31
 
@@ -26,7 +27,8 @@
  **/
 typedef struct hashnode_t {
 	uint64_t hashcode[2];     /*!< The hash code */
-	pipe_t   pipe;
+	pipe_t   pipe;            /*!< The pipe we should activate */
+	const char* pattern;      /*!< The pattern string, which is allocated with the node */
 	struct hashnode_t* next;  /*!< The next hash node */
 } hashnode_t;
 
@@ -42,6 +44,7 @@ typedef struct {
 	const char*  field;     /*!< The field expression we want to read */
 
 	uint32_t     seed;      /*!< The hash seed */
+	uint32_t     hash_size; /*!< The number of slots in the hash table */
 	uint32_t     ncond;     /*!< The number of condition we want to match */
 	pipe_t       cond;      /*!< The pipe that inputs the condition input */
 	pipe_t       data;      /*!< The pipe that contains the data */
@@ -49,7 +52,7 @@ typedef struct {
 
 	union {
 		hashnode_t**         string;  /*!< The hash table used for string hash */
-		regex_t*             regex;   /*!< The reuglar expression pattern table */
+		regset_t*            regex;   /*!< The combined matcher for all the regular expressions */
 		void*                generic; /*!< The generic pointer */
 	} pattern_table;          /*!< The pattern table */
 
@@ -66,25 +69,29 @@ typedef struct {
  **/
 static inline hashnode_t* _hashnode_new(const char* str, pipe_t pipe, uint32_t seed)
 {
-	hashnode_t* ret = (hashnode_t*)malloc(sizeof(*ret));
-	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the hash code");
 	size_t sz = strlen(str);
+	hashnode_t* ret = (hashnode_t*)malloc(sizeof(*ret) + sz + 1);
+	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the hash code");
 	murmurhash3_128(str, sz, seed, ret->hashcode);
 
+	memcpy(ret + 1, str, sz + 1);
+	ret->pattern = (const char*)(ret + 1);
 	ret->pipe = pipe;
 	ret->next = NULL;
 	return ret;
 }
 /**
  * @brief Compute which hash slot we should look at
+ * @param ctx The servlet context
  * @param hashcode The 128 bit hash code
  * @note  This is actually computes the modular of the entire 128 bit integer
  * @return The slot id
  **/
-static inline uint32_t _hash_get_slot(const uint64_t* hashcode)
+static inline uint32_t _hash_get_slot(const context_t* ctx, const uint64_t* hashcode)
 {
-	static const uint32_t multipler = (2 * (uint32_t)((1ull << 63) % HASH_SIZE)) % HASH_SIZE;
-	return (uint32_t)(multipler * hashcode[1] + hashcode[0]) % HASH_SIZE;
+	uint64_t size = ctx->hash_size;
+	uint64_t multipler = (2 * ((1ull << 63) % size)) % size;
+	return (uint32_t)((multipler * (hashcode[1] % size) + hashcode[0] % size) % size);
 }
 
 /**
@@ -100,7 +107,16 @@ static inline int _hashnode_insert(context_t* ctx, const char* str, pipe_t pipe)
 	if(NULL == node)
 		ERROR_RETURN_LOG(int, "Cannot create new node for the hash table");
 
-	uint32_t slot = _hash_get_slot(node->hashcode);
+	uint32_t slot = _hash_get_slot(ctx, node->hashcode);
+
+	/* When a pattern is duplicated, the first one wins, which is the same as the regex mode */
+	const hashnode_t* ptr;
+	for(ptr = ctx->pattern_table.string[slot]; NULL != ptr; ptr = ptr->next)
+		if(strcmp(ptr->pattern, node->pattern) == 0)
+		{
+			free(node);
+			return 0;
+		}
 
 	node->next = ctx->pattern_table.string[slot];
 	ctx->pattern_table.string[slot] = node;
@@ -120,18 +136,52 @@ static inline const hashnode_t* _hash_find(const context_t* ctx, const char* str
 	uint64_t hashcode[2];
 	murmurhash3_128(str, len, ctx->seed, hashcode);
 
-	uint32_t slot = _hash_get_slot(hashcode);
+	uint32_t slot = _hash_get_slot(ctx, hashcode);
 	const hashnode_t* ret;
 
 	for(ret = ctx->pattern_table.string[slot];
 	    NULL != ret &&
-	    ret->hashcode[0] != hashcode[0] &&
-	    ret->hashcode[1] != hashcode[1];
+	    (ret->hashcode[0] != hashcode[0] ||
+	     ret->hashcode[1] != hashcode[1] ||
+	     strcmp(ret->pattern, str) != 0);
 	    ret = ret->next);
 
 	return ret;
 }
 
+/**
+ * @brief Dispose the pattern table
+ * @param ctx The servlet context
+ * @return status code
+ **/
+static inline int _free_pattern_table(context_t* ctx)
+{
+	int rc = 0;
+	uint32_t i;
+
+	if(ctx->pattern_table.generic == NULL) return 0;
+
+	if(ctx->mode == MODE_REGEX)
+		rc = regset_free(ctx->pattern_table.regex);
+	else if(ctx->mode == MODE_MATCH)
+	{
+		for(i = 0; i < ctx->hash_size; i ++)
+		{
+			hashnode_t *ptr, *cur;
+			for(ptr = ctx->pattern_table.string[i]; NULL != ptr;)
+			{
+				cur = ptr;
+				ptr = ptr->next;
+				free(cur);
+			}
+		}
+		free(ctx->pattern_table.string);
+	}
+
+	ctx->pattern_table.generic = NULL;
+	return rc;
+}
+
 /**
  * @brief Parse the servlet initialization options
  * @param data The option data
@@ -235,15 +285,20 @@ static int _init(uint32_t argc, char const* const* argv, void* ctxbuf)
 	}
 	ctx->seed =  (uint32_t)ts.tv_nsec;
 
+	/* Keep the load factor of the hash table below 0.5, and the odd size spreads the hash code better */
+	ctx->hash_size = ctx->ncond * 2 + 1;
+	if(ctx->hash_size < HASH_SIZE) ctx->hash_size = HASH_SIZE;
+
 
 	switch(ctx->mode)
 	{
 		case MODE_REGEX:
-			if(NULL == (ctx->pattern_table.regex = (regex_t*)calloc(ctx->ncond, sizeof(ctx->pattern_table.regex[0]))))
-				ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the regular expression array");
+			/* All the patterns are compiled into a single matcher, so the cost doesn't grow with the number of patterns */
+			if(NULL == (ctx->pattern_table.regex = regset_new(argv + opt_rc, ctx->ncond)))
+				ERROR_LOG_GOTO(ERR, "Cannot compile the regular expressions");
 			break;
 		case MODE_MATCH:
-			if(NULL == (ctx->pattern_table.string = (hashnode_t**)calloc(HASH_SIZE, sizeof(hashnode_t*))))
+			if(NULL == (ctx->pattern_table.string = (hashnode_t**)calloc(ctx->hash_size, sizeof(hashnode_t*))))
 				ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the string pattern table");
 			break;
 		case MODE_NUMERIC:
@@ -251,32 +306,12 @@ static int _init(uint32_t argc, char const* const* argv, void* ctxbuf)
 	}
 
 	uint32_t i;
-	int rc;
 	for(i = 0; i < ctx->ncond; i ++)
 	{
-		char regbuf[1024];
 		if(ERROR_CODE(pipe_t) == (ctx->output[i] = pipe_define_pattern("out%u", PIPE_MAKE_SHADOW(ctx->data) | PIPE_DISABLED, "$Tdata", i)))
 			ERROR_LOG_GOTO(ERR, "Cannot define the output pipe");
-		switch(ctx->mode)
-		{
-			case MODE_REGEX:
-				snprintf(regbuf, sizeof(regbuf), "^%s$", argv[opt_rc + i]);
-				if(0 != (rc = regcomp(ctx->pattern_table.regex + i, regbuf, 0)))
-				{
-#ifdef LOG_ERROR_ENABLED
-					char buffer[1024];
-					regerror(rc, ctx->pattern_table.regex + i, buffer, sizeof(buffer));
-#endif
-					ERROR_LOG_GOTO(ERR, "Can't compile regex: %s", buffer);
-				}
-				break;
-			case MODE_MATCH:
-				if(ERROR_CODE(int) == _hashnode_insert(ctx, argv[opt_rc + i], ctx->output[i]))
-					ERROR_LOG_GOTO(ERR, "Can't insert the pattern to hash table");
-				break;
-			case MODE_NUMERIC:
-				break;
-		}
+		if(ctx->mode == MODE_MATCH && ERROR_CODE(int) == _hashnode_insert(ctx, argv[opt_rc + i], ctx->output[i]))
+			ERROR_LOG_GOTO(ERR, "Can't insert the pattern to hash table");
 	}
 
 	if(ERROR_CODE(pipe_t) == (ctx->output[ctx->ncond] = pipe_define("default", PIPE_MAKE_SHADOW(ctx->data) | PIPE_DISABLED, "$Tdata")))
@@ -292,26 +327,7 @@ static int _init(uint32_t argc, char const* const* argv, void* ctxbuf)
 ERR:
 	if(ctx->output != NULL) free(ctx->output);
 	if(ctx->type_model != NULL) pstd_type_model_free(ctx->type_model);
-	if(ctx->pattern_table.generic != NULL)
-	{
-		if(ctx->mode == MODE_REGEX)
-			for(i = 0; i < ctx->ncond; i ++)
-				regfree(ctx->pattern_table.regex + i);
-		else if(ctx->mode == MODE_MATCH)
-		{
-			for(i =0; i < HASH_SIZE; i ++)
-			{
-				hashnode_t* ptr, *cur;
-				for(ptr = ctx->pattern_table.string[i]; NULL != ptr;)
-				{
-					cur = ptr;
-					ptr = ptr->next;
-					free(cur);
-				}
-			}
-			free(ctx->pattern_table.string);
-		}
-	}
+	_free_pattern_table(ctx);
 
 	return ERROR_CODE(int);
 }
@@ -362,26 +378,11 @@ static inline int _exec_regex(context_t* ctx, pstd_type_instance_t* inst)
 	const char* str = pstd_string_value(ps);
 	if(NULL == str) ERROR_RETURN_LOG(int, "Cannot get the string value");
 
-	pipe_t picked = ctx->output[ctx->ncond];
+	uint32_t idx = regset_match(ctx->pattern_table.regex, str);
+	if(ERROR_CODE(uint32_t) == idx)
+		ERROR_RETURN_LOG(int, "Cannot match the regular expressions");
 
-	uint32_t i;
-	for(i = 0; i < ctx->ncond; i ++)
-	{
-		int rc = regexec(ctx->pattern_table.regex + i, str, 0, NULL, 0);
-		if(rc == 0)
-		{
-			picked = ctx->output[i];
-			break;
-		}
-		else if(rc != REG_NOMATCH)
-		{
-#ifdef LOG_ERROR_ENABLED
-			char buffer[1024];
-			regerror(rc, ctx->pattern_table.regex + i, buffer, sizeof(buffer));
-#endif
-			ERROR_RETURN_LOG(int, "Regex error: %s", buffer);
-		}
-	}
+	pipe_t picked = ctx->output[idx];
 
 	return pipe_cntl(picked, PIPE_CNTL_CLR_FLAG, PIPE_DISABLED);
 }
@@ -420,37 +421,13 @@ static inline int _unload(void* ctxbuf)
 {
 	context_t* ctx = (context_t*)ctxbuf;
 	int rc = 0;
-	uint32_t i;
 
 	if(NULL != ctx->output) free(ctx->output);
 	if(NULL != ctx->type_model && ERROR_CODE(int) == pstd_type_model_free(ctx->type_model))
 		rc = ERROR_CODE(int);
 
-	if(ctx->pattern_table.generic != NULL)
-	{
-		if(ctx->mode == MODE_REGEX)
-		{
-			for(i = 0; i < ctx->ncond; i ++)
-			{
-				regfree(ctx->pattern_table.regex + i);
-			}
-			free(ctx->pattern_table.regex);
-		}
-		else if(ctx->mode == MODE_MATCH)
-		{
-			for(i = 0; i < HASH_SIZE; i ++)
-			{
-				hashnode_t *ptr, *cur;
-				for(ptr = ctx->pattern_table.string[i]; NULL != ptr;)
-				{
-					cur = ptr;
-					ptr = ptr->next;
-					free(cur);
-				}
-			}
-			free(ctx->pattern_table.string);
-		}
-	}
+	if(ERROR_CODE(int) == _free_pattern_table(ctx))
+		rc = ERROR_CODE(int);
 
 	return rc;
 }
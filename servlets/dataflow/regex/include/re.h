@@ -2,7 +2,7 @@
  * Copyright (C) 2017, Hao Hou
  **/
 /**
- * @brief The wrapper for the libpcre library
+ * @brief The wrapper for the libpcre2 library
  * @file servelt/dataflow/regex/include/re.h
  **/
 #ifndef __RE_H__
@@ -15,9 +15,10 @@ typedef struct _re_t re_t;
 /**
  * @brief Compile the regular expression
  * @param regex The regular expression
+ * @param jit_stack_max The maximum size of the per-thread JIT stack
  * @return The newly created regular expression object
  **/
-re_t* re_new(const char* regex);
+re_t* re_new(const char* regex, size_t jit_stack_max);
 
 /**
  * @brief Dispose a used regex
@@ -78,9 +78,10 @@ int kmp_pattern_free(kmp_pattern_t* kmp)
 }
 
 /**
- * todo: Optimize this. This is not optimal and much slower than grep in a lot of cases.
- *       What we need to do is use BM algorithm to get rid of the obviously unmatched string as early
- *       as possible. See misc/kmp.c for details
+ * @note The end-of-line marker is located with memchr first, and when nothing has been matched yet we jump to
+ *       the next occurrence of the first char of the pattern with memchr as well, both of them are vectorized
+ *       by the libc, so the KMP loop only runs on the candidate positions.
+ * todo: Use BM algorithm to get rid of the obviously unmatched string as early as possible. See misc/kmp.c for details
  **/
 size_t kmp_partial_match(const kmp_pattern_t* kmp, const char* text, size_t maxlen, int eol_marker, size_t* state)
 {
@@ -90,8 +91,22 @@ size_t kmp_partial_match(const kmp_pattern_t* kmp, const char* text, size_t maxl
 	size_t matched = state == NULL ? 0 : *state;
 	size_t i;
 
-	for(i = 0; i < maxlen && text[i] != eol_marker && matched < kmp->size; i ++)
+	const char* eol = (const char*)memchr(text, eol_marker, maxlen);
+	size_t limit = NULL == eol ? maxlen : (size_t)(eol - text);
+
+	for(i = 0; i < limit && matched < kmp->size; i ++)
 	{
+		if(matched == 0)
+		{
+			const char* next = (const char*)memchr(text + i, kmp->pattern[0], limit - i);
+			if(NULL == next)
+			{
+				i = limit;
+				break;
+			}
+			i = (size_t)(next - text);
+		}
+
 		for(;matched > 0 && text[i] != kmp->pattern[matched];
 		     matched = kmp->prefix[matched - 1]);
 		if(matched != 0 || (text[i] == kmp->pattern[0]))
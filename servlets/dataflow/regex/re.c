@@ -7,124 +7,190 @@
 #include <unistd.h>
 #include <string.h>
 
-#include <pcre.h>
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
 
 #include <error.h>
 
 #include <pservlet.h>
+#include <pstd.h>
 
 #include <re.h>
 
-#if PCRE_MAJOR >= 8 && PCRE_MINOR >= 32 && 0
-/* TODO: figure out if we need to use the pcre_jit_exec, but it now cause crash */
-#	define PCRE_EXEC(args...) pcre_jit_exec(args, NULL)
-#else
-#	define PCRE_EXEC pcre_exec
-#endif
+/**
+ * @brief The initial size of the JIT stack
+ **/
+#define _JIT_STACK_MIN (32 * 1024)
 
-#ifdef PCRE_CONFIG_JIT
-#	define PCRE_FREE_STUDY pcre_free_study
-#else
-#	define PCRE_FREE_STUDY pcre_free
-#endif
+/**
+ * @brief The per-thread data used for matching
+ * @note  The JIT stack can not be shared between threads, and it's the reason why the JIT code used to crash
+ **/
+typedef struct {
+	pcre2_match_data*    match_data;   /*!< The match data */
+	pcre2_match_context* match_ctx;    /*!< The match context which carries the JIT stack */
+	pcre2_jit_stack*     jit_stack;    /*!< The JIT stack */
+} _scratch_t;
 
 /**
  * @brief The actual data structure for the regex
  **/
 struct _re_t {
-	pcre*         regex;   /*!< The PCRE object */
-	pcre_extra*   extra;   /*!< The PCRE extra data */
+	pcre2_code*          regex;        /*!< The compiled pattern */
+	uint32_t             jit:1;        /*!< If the pattern has been compiled to machine code */
+	size_t               jit_stack_max;/*!< The maximum size of the JIT stack, the memory is only reserved and it's committed on demand */
+	pstd_thread_local_t* scratch;      /*!< The per-thread match data */
 };
 
-re_t* re_new(const char* regex)
+static void* _scratch_alloc(uint32_t tid, const void* data)
 {
-	if(NULL == regex) ERROR_PTR_RETURN_LOG("Invalid arguments");
-
-	re_t* ret = (re_t*)calloc(sizeof(re_t), 1);
+	(void)tid;
+	const re_t* re = (const re_t*)data;
 
+	_scratch_t* ret = (_scratch_t*)calloc(1, sizeof(*ret));
 	if(NULL == ret)
-		ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the regular expression object");
+		ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the thread local match data");
 
-	const char* pcre_err_msg = "";
-	int pcre_err_ofs = 0;
+	if(NULL == (ret->match_data = pcre2_match_data_create_from_pattern(re->regex, NULL)))
+		ERROR_LOG_GOTO(ERR, "Cannot create the match data");
 
+	if(re->jit)
+	{
+		if(NULL == (ret->match_ctx = pcre2_match_context_create(NULL)))
+			ERROR_LOG_GOTO(ERR, "Cannot create the match context");
 
-	if(NULL == (ret->regex = pcre_compile(regex, 0, &pcre_err_msg, &pcre_err_ofs, NULL)))
-		ERROR_LOG_GOTO(ERR, "Cannot compile regular expression: %s at %d", pcre_err_msg, pcre_err_ofs);
+		if(NULL == (ret->jit_stack = pcre2_jit_stack_create(re->jit_stack_max < _JIT_STACK_MIN ? re->jit_stack_max : _JIT_STACK_MIN, re->jit_stack_max, NULL)))
+			ERROR_LOG_GOTO(ERR, "Cannot create the JIT stack");
 
-	if(NULL == (ret->extra = pcre_study(ret->regex, 0, &pcre_err_msg)) && pcre_err_msg != NULL)
-		ERROR_LOG_GOTO(ERR, "Cannot optimize the regular expression: %s", pcre_err_msg);
+		pcre2_jit_stack_assign(ret->match_ctx, NULL, ret->jit_stack);
+	}
 
 	return ret;
-
 ERR:
-	if(NULL != ret->extra) PCRE_FREE_STUDY(ret->extra);
-	if(NULL != ret->regex) pcre_free(ret->regex);
-
+	if(NULL != ret->match_data) pcre2_match_data_free(ret->match_data);
+	if(NULL != ret->match_ctx) pcre2_match_context_free(ret->match_ctx);
 	free(ret);
-
 	return NULL;
 }
 
-int re_free(re_t* obj)
+static int _scratch_free(void* mem, const void* data)
 {
-	if(NULL == obj) ERROR_RETURN_LOG(int, "Invalid arguments");
-
-	if(obj->extra != NULL) PCRE_FREE_STUDY(obj->extra);
-	if(NULL != obj->regex) pcre_free(obj->regex);
+	(void)data;
+	_scratch_t* scratch = (_scratch_t*)mem;
 
-	free(obj);
+	if(NULL != scratch->jit_stack) pcre2_jit_stack_free(scratch->jit_stack);
+	if(NULL != scratch->match_ctx) pcre2_match_context_free(scratch->match_ctx);
+	if(NULL != scratch->match_data) pcre2_match_data_free(scratch->match_data);
+	free(scratch);
 
 	return 0;
 }
 
-static inline int _process_pcre_error_code(const char* msg, int code)
+re_t* re_new(const char* regex, size_t jit_stack_max)
 {
-#ifndef LOG_ERROR_ENABLED
-	(void)msg;
-#endif
-	switch(code)
+	if(NULL == regex || 0 == jit_stack_max) ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	re_t* ret = (re_t*)calloc(sizeof(re_t), 1);
+
+	if(NULL == ret)
+		ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the regular expression object");
+
+	ret->jit_stack_max = jit_stack_max;
+
+	int err_code = 0;
+	PCRE2_SIZE err_ofs = 0;
+
+	if(NULL == (ret->regex = pcre2_compile((PCRE2_SPTR)regex, PCRE2_ZERO_TERMINATED, 0, &err_code, &err_ofs, NULL)))
 	{
-		case PCRE_ERROR_NOMATCH:
-			return 0;
-		case PCRE_ERROR_NULL:
-			ERROR_RETURN_LOG(int, "%s: Invalid arguments", msg);
-		case PCRE_ERROR_BADOPTION:
-			ERROR_RETURN_LOG(int, "%s: Bad options", msg);
-		case PCRE_ERROR_BADMAGIC:
-			ERROR_RETURN_LOG(int, "%s: Invalid regex object", msg);
-		case PCRE_ERROR_NOMEMORY:
-			ERROR_RETURN_LOG(int, "%s: Out of meomry", msg);
-		default:
-			ERROR_RETURN_LOG(int, "%s: generic error", msg);
+#ifdef LOG_ERROR_ENABLED
+		PCRE2_UCHAR msg[256];
+		pcre2_get_error_message(err_code, msg, sizeof(msg));
+#endif
+		ERROR_LOG_GOTO(ERR, "Cannot compile regular expression: %s at %zu", (const char*)msg, (size_t)err_ofs);
 	}
+
+	/* The pattern is matched in both complete and partial mode, so we need the machine code for both */
+	if(0 == (err_code = pcre2_jit_compile(ret->regex, PCRE2_JIT_COMPLETE | PCRE2_JIT_PARTIAL_SOFT)))
+		ret->jit = 1;
+	else
+		LOG_NOTICE("JIT is not available for the regular expression, use the interpreter instead (error code %d)", err_code);
+
+	if(NULL == (ret->scratch = pstd_thread_local_new(_scratch_alloc, _scratch_free, ret)))
+		ERROR_LOG_GOTO(ERR, "Cannot create the thread local match data");
+
+	return ret;
+
+ERR:
+	if(NULL != ret->regex) pcre2_code_free(ret->regex);
+
+	free(ret);
+
+	return NULL;
 }
 
-int re_match_full(re_t* obj, const char* text, size_t len)
+int re_free(re_t* obj)
 {
-	if(NULL == obj || NULL == obj->regex || NULL == text)
-		ERROR_RETURN_LOG(int, "Invalid arguments");
+	int rc = 0;
+	if(NULL == obj) ERROR_RETURN_LOG(int, "Invalid arguments");
 
-	int ovec[30];
+	if(NULL != obj->scratch && ERROR_CODE(int) == pstd_thread_local_free(obj->scratch))
+		rc = ERROR_CODE(int);
 
-	int match_rc = PCRE_EXEC(obj->regex, obj->extra, text, (int)len, 0, 0, ovec, sizeof(ovec) / sizeof(ovec[0]));
+	if(NULL != obj->regex) pcre2_code_free(obj->regex);
 
-	if(match_rc >= 0) return 1;
+	free(obj);
 
-	return _process_pcre_error_code("pcre_exec", match_rc);
+	return rc;
 }
 
-int re_match_partial(re_t* obj, const char* text, size_t len)
+/**
+ * @brief Run the matcher
+ * @param obj The regex object
+ * @param text The text to match
+ * @param len The length of the text
+ * @param options The match options
+ * @return 1 for matched, 0 for unmatched, error code on error
+ **/
+static inline int _match(re_t* obj, const char* text, size_t len, uint32_t options)
 {
 	if(NULL == obj || NULL == obj->regex || NULL == text)
 		ERROR_RETURN_LOG(int, "Invalid arguments");
 
-	int ovec[30];
+	_scratch_t* scratch = (_scratch_t*)pstd_thread_local_get(obj->scratch);
+	if(NULL == scratch)
+		ERROR_RETURN_LOG(int, "Cannot get the thread local match data");
+
+	int rc;
+	if(obj->jit)
+		rc = pcre2_jit_match(obj->regex, (PCRE2_SPTR)text, len, 0, options, scratch->match_data, scratch->match_ctx);
+	else
+		rc = pcre2_match(obj->regex, (PCRE2_SPTR)text, len, 0, options, scratch->match_data, NULL);
+
+	/* The interpreter uses the heap instead of the JIT stack, so it's able to handle the deeply nested backtracking */
+	if(rc == PCRE2_ERROR_JIT_STACKLIMIT)
+	{
+		LOG_NOTICE("JIT stack limit reached, fall back to the interpreter");
+		rc = pcre2_match(obj->regex, (PCRE2_SPTR)text, len, 0, options | PCRE2_NO_JIT, scratch->match_data, NULL);
+	}
+
+	if(rc >= 0) return 1;
 
-	int match_rc = PCRE_EXEC(obj->regex, obj->extra, text, (int)len, 0, PCRE_PARTIAL_SOFT, ovec, sizeof(ovec) / sizeof(ovec[0]));
+	/* A partial match at the end of line is not a match */
+	if(rc == PCRE2_ERROR_NOMATCH || rc == PCRE2_ERROR_PARTIAL) return 0;
 
-	if(match_rc >= 0)  return 1;
+#ifdef LOG_ERROR_ENABLED
+	PCRE2_UCHAR msg[256];
+	pcre2_get_error_message(rc, msg, sizeof(msg));
+#endif
+	ERROR_RETURN_LOG(int, "pcre2_match: %s", (const char*)msg);
+}
 
-	return _process_pcre_error_code("pcre_exec", match_rc);
+int re_match_full(re_t* obj, const char* text, size_t len)
+{
+	return _match(obj, text, len, 0);
 }
 
+int re_match_partial(re_t* obj, const char* text, size_t len)
+{
+	return _match(obj, text, len, PCRE2_PARTIAL_SOFT);
+}
@@ -23,6 +23,7 @@ typedef struct {
 	uint32_t     simple_mode:1;    /*!< Instead of regex, using simple KMP algorithm for matching */
 	char         eol_marker;       /*!< The end-of-line marker, by default is \n */
 	uint32_t     line_buf_size;    /*!< The maximum size of the line buffer */
+	uint32_t     jit_stack_size;   /*!< The maximum size of the per-thread JIT stack */
 
 	union {
 		re_t*            regex;    /*!< The regular expression object */
@@ -134,6 +135,24 @@ static void* _get_line_buffer(text_buffer_t* buf, uint32_t required_size, int pr
 	return buf->data;
 }
 
+/**
+ * @brief Find the next end-of-line marker in the buffer
+ * @details This is the hot loop when the servlet reads a long line, memchr is used because it's vectorized by the libc
+ * @param ctx The servlet context
+ * @param buffer The buffer
+ * @param begin The offset where we start the search
+ * @param size The size of the buffer
+ * @return The offset of the end-of-line marker, or size if it's not found
+ **/
+static inline size_t _find_eol(const ctx_t* ctx, const char* buffer, size_t begin, size_t size)
+{
+	if(begin >= size) return size;
+
+	const char* eol = (const char*)memchr(buffer + begin, ctx->eol_marker, size - begin);
+
+	return NULL == eol ? size : (size_t)(eol - buffer);
+}
+
 /**
  * @brief Convert the escape sequence string to the actual char it stands for
  * @param text The text to convert
@@ -201,6 +220,11 @@ static int _option_callback(pstd_option_data_t data)
 				ERROR_RETURN_LOG(int, "Invalid line buffer size");
 			ctx->line_buf_size = (uint32_t)data.param_array[0].intval * 1024;
 			break;
+		case 'J':
+			if(data.param_array[0].intval <= 0 || data.param_array[0].intval >= (1ll<<22))
+				ERROR_RETURN_LOG(int, "Invalid JIT stack size");
+			ctx->jit_stack_size = (uint32_t)data.param_array[0].intval * 1024;
+			break;
 		default:
 			ERROR_RETURN_LOG(int, "Invalid command line options");
 	}
@@ -219,6 +243,7 @@ static int _init(uint32_t argc, char const* const* argv, void* ctxmem)
 	ctx->model = NULL;
 	ctx->regex = NULL;
 	ctx->line_buf_size = 4096 * 1024;
+	ctx->jit_stack_size = 8192 * 1024;
 	ctx->thread_buffer = NULL;
 
 	static pstd_option_t options[] = {
@@ -277,6 +302,14 @@ static int _init(uint32_t argc, char const* const* argv, void* ctxmem)
 			.description = "Set the maximum line buffer size in kilobytes (Default: 4096k)",
 			.handler     = _option_callback,
 			.args        = NULL
+		},
+		{
+			.long_opt    = "jit-stack-size",
+			.short_opt   = 'J',
+			.pattern     = "I",
+			.description = "Set the maximum size of the per-thread JIT stack in kilobytes (Default: 8192k)",
+			.handler     = _option_callback,
+			.args        = NULL
 		}
 
 	};
@@ -323,7 +356,7 @@ static int _init(uint32_t argc, char const* const* argv, void* ctxmem)
 	if(ctx->simple_mode && NULL == (ctx->kmp = kmp_pattern_new(argv[next_opt], strlen(argv[next_opt]))))
 		ERROR_RETURN_LOG(int, "Cannot compile KMP pattern");
 
-	if(!ctx->simple_mode && NULL == (ctx->regex = re_new(argv[next_opt])))
+	if(!ctx->simple_mode && NULL == (ctx->regex = re_new(argv[next_opt], ctx->jit_stack_size)))
 		ERROR_RETURN_LOG(int, "Cannot compile the regular expression");
 
 	if(!ctx->simple_mode && NULL == (ctx->thread_buffer = pstd_thread_local_new(_text_buffer_alloc, _text_buffer_free, ctx)))
@@ -400,6 +433,8 @@ static inline int _read_next_buffer(ctx_t* ctx, pstd_type_instance_t* ti, char*
 
 			*max_size = read_rc;
 			*result = local_buf;
+			/* The local buffer is not owned by the module, so it shouldn't be released */
+			*determined_size = 0;
 
 			if(read_rc == 0)
 			{
@@ -532,7 +567,7 @@ static int _exec(void* ctxmem)
 			else
 			{
 SKIP_LINE:
-				for(;used_size < total_size && buffer[used_size] != ctx->eol_marker; used_size ++);
+				used_size = _find_eol(ctx, buffer, used_size, total_size);
 
 				/* Finally we need to strip the EOL marker as well */
 				if(used_size < total_size)
@@ -546,7 +581,7 @@ SKIP_LINE:
 		{
 			if(line_buffer == NULL)
 			{
-				for(used_size = 0; used_size < total_size && buffer[used_size] != ctx->eol_marker; used_size ++);
+				used_size = _find_eol(ctx, buffer, 0, total_size);
 
 				if(used_size < total_size)
 				{
@@ -556,6 +591,12 @@ SKIP_LINE:
 					has_more_data = 0;
 					line_buffer = buffer;
 				}
+				else if(!ctx->raw_input)
+				{
+					/* The string is owned by the RLS, so we don't need to copy it even there's no EOL marker */
+					line_size = used_size;
+					line_buffer = buffer;
+				}
 				else
 				{
 					/* We don't have meet EOL, thus we need to copy */
@@ -568,15 +609,13 @@ SKIP_LINE:
 			}
 			else
 			{
-				for(used_size = 0; used_size < total_size && buffer[used_size] != ctx->eol_marker; used_size ++)
-				{
-					line_size ++;
+				used_size = _find_eol(ctx, buffer, 0, total_size);
 
-					if(tb->capacity < line_size && NULL == (line_buffer = thread_buffer = _get_line_buffer(tb, (uint32_t)line_size, 1, ctx)))
-						ERROR_LOG_GOTO(RET, "Cannot resize the line buffer");
+				if(tb->capacity < line_size + used_size && NULL == (line_buffer = thread_buffer = _get_line_buffer(tb, (uint32_t)(line_size + used_size), 1, ctx)))
+					ERROR_LOG_GOTO(RET, "Cannot resize the line buffer");
 
-					thread_buffer[line_size - 1] = buffer[used_size];
-				}
+				memcpy(thread_buffer + line_size, buffer, used_size);
+				line_size += used_size;
 
 				if(used_size < total_size)
 				{
@@ -0,0 +1,29 @@
+#!/usr/bin/env python
+# Generate the benchmark input for the regex filter, each event is a single long line and every other line matches the test patterns
+# Usage: gen-bench-input.py <size> [<count>], where size can be a number with suffix K or M
+import sys, random
+
+def parse_size(text):
+    text = text.upper()
+    if text.endswith("K"): return int(text[:-1]) * 1024
+    if text.endswith("M"): return int(text[:-1]) * 1024 * 1024
+    return int(text)
+
+size  = parse_size(sys.argv[1])
+count = int(sys.argv[2]) if len(sys.argv) > 2 else 2
+
+random.seed(0)
+words = ["plumber", "servlet", "pipe", "event", "request", "buffer", "applet", "apply", "line", "filter", "stream", "token"]
+
+chunks = []
+length = 0
+while length < size:
+    word = random.choice(words)
+    chunks.append(word)
+    length += len(word) + 1
+line = " ".join(chunks)
+
+for i in range(count):
+    tail = " this is an apple application" if i % 2 == 0 else " nothing interesting here"
+    sys.stdout.write(".TEXT bench_%d\n%s%s\n.END\n" % (i, line, tail))
+sys.stdout.write(".STOP\n")
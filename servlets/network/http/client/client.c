@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
 #include <pthread.h>
 
@@ -20,6 +21,7 @@
 #include <barrier.h>
 #include <arch/arch.h>
 
+#include <stream.h>
 #include <client.h>
 
 typedef struct _thread_ctx_t _thread_ctx_t;
@@ -29,6 +31,10 @@ typedef struct _thread_ctx_t _thread_ctx_t;
  **/
 typedef struct {
 	uint32_t                    in_use:1;      /*!< indicates if this request buffer is being used */
+	uint32_t                    notified:1;    /*!< indicates the completion has been notified, after that the buffers of the caller are invalid */
+	uint32_t                    paused:1;      /*!< indicates the transfer has been paused because the stream is full */
+	uint32_t                    no_pause:1;    /*!< indicates the transfer can not be paused, which is the case of file:// URL, the body goes to the bounded stream backlog instead */
+	volatile uint32_t           resume;        /*!< indicates the stream wants the paused transfer to continue */
 	union {
 		int                     priority;      /*!< The priority of this request */
 		uint32_t                next_unused;   /*!< The next element unused request buffer list */
@@ -48,6 +54,7 @@ typedef struct {
 	size_t                      header_buf_cap;  /*!< The header buffer capacity */
 	CURLcode*                   curl_rc_buf;     /*!< The curl result code buffer */
 	int*                        status_buf;      /*!< The status buffer */
+	stream_t*                   stream;          /*!< The response body stream, NULL if the body goes to the result buffer */
 } _req_t;
 
 /**
@@ -77,6 +84,7 @@ struct _thread_ctx_t {
 	volatile uint32_t  add_queue_rear;  /*!< The rear pointer of the add queue */
 	uint32_t*          add_queue;       /*!< The actual pending queue */
 	volatile uint32_t  add_queue_blk:1; /*!< Indicates the thread has been blocked by the add queue */
+	volatile uint32_t  resume_pending;  /*!< The number of resume requests from the response body streams since last check */
 
 	/******** The pending request heap ***********/
 	uint32_t* req_heap;            /*!< The pending request heap */
@@ -210,18 +218,124 @@ static inline int _write_buffer(const char* data, size_t size, size_t count, cha
 	return (int)required;
 }
 
+/**
+ * @brief Notify the caller the request has been completed
+ * @details For the request with a response body stream, this happens once the first body bytes arrives, and the rest of the
+ *          body is delivered by the stream. After this point, the result buffers of the caller must not be touched
+ * @param req The request
+ * @param result The CURL result code
+ * @return status code
+ **/
+static inline int _notify_completion(_req_t* req, CURLcode result)
+{
+	/* No matter what result code we got from CURL, we mark the task as success and
+	 * the async_cleanup task should be responsible to decide if this is a success
+	 * situation */
+	*req->curl_rc_buf = result;
+
+	/* libcurl writes a long, which is wider than the status buffer */
+	long status = 0;
+	CURLcode curl_rc = curl_easy_getinfo(req->curl_handle, CURLINFO_RESPONSE_CODE, &status);
+
+	if(CURLE_OK != curl_rc)
+		LOG_WARNING("Cannot get the status code from the curl object: %s", curl_easy_strerror(curl_rc));
+	else
+		*req->status_buf = (int)status;
+
+	if(CURLE_OK != result)
+		LOG_WARNING("Curl connection returns abnormal result: %s", curl_easy_strerror(result));
+
+	req->notified = 1;
+
+	if(ERROR_CODE(int) == async_cntl(req->async_handle, ASYNC_CNTL_NOTIFY_WAIT, 0))
+		ERROR_RETURN_LOG(int, "Cannot notify the completion state");
+
+	return 0;
+}
+
 static int _curl_write_func(const char* data, size_t size, size_t count, void* up)
 {
 	_req_t* req = (_req_t*)up;
-	return _write_buffer(data, size, count, req->result_buf, req->result_size_buf, &req->result_buf_cap);
+
+	if(NULL == req->stream)
+		return _write_buffer(data, size, count, req->result_buf, req->result_size_buf, &req->result_buf_cap);
+
+	size_t rc = stream_write(req->stream, data, size * count, !req->no_pause);
+
+	/* Either the consumer has gone or we can not buffer the data, abort the transfer */
+	if(ERROR_CODE(size_t) == rc) return 0;
+
+	if(rc == 0)
+	{
+		req->paused = 1;
+		return CURL_WRITEFUNC_PAUSE;
+	}
+
+	/* The status and the header is complete at this point, so let the downstream start to consume the body */
+	if(!req->notified && ERROR_CODE(int) == _notify_completion(req, CURLE_OK))
+		LOG_WARNING("Cannot notify the completion of the response head");
+
+	return (int)rc;
 }
 
 static int _curl_header_func(const char* data, size_t size, size_t count, void* up)
 {
 	_req_t* req = (_req_t*)up;
+
+	/* The header buffer has been handed over, so the trailer fields are dropped */
+	if(req->notified) return (int)(size * count);
+
 	return _write_buffer(data, size, count, req->header_buf, req->header_size_buf, &req->header_buf_cap);
 }
 
+/**
+ * @brief The resume callback of the response body stream, which is called from the thread reading the stream
+ * @param data The request
+ * @return status code
+ **/
+static int _stream_resume(void* data)
+{
+	_req_t* req = (_req_t*)data;
+	_thread_ctx_t* ctx = req->thread_ctx;
+
+	req->resume = 1;
+	__sync_fetch_and_add(&ctx->resume_pending, 1);
+
+	uint64_t val = 1;
+	if(write(ctx->event_fd, &val, sizeof(val)) < 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot write event FD for thread #%u", ctx->tid);
+
+	return 0;
+}
+
+/**
+ * @brief Continue the transfers paused by the response body streams that have been drained
+ * @param ctx The thread context
+ * @return status code
+ **/
+static inline int _resume_paused(_thread_ctx_t* ctx)
+{
+	if(__sync_lock_test_and_set(&ctx->resume_pending, 0) == 0) return 0;
+
+	uint32_t i;
+	for(i = 0; i < _global.queue_size; i ++)
+	{
+		_req_t* req = ctx->req_buf + i;
+		if(!req->in_use || NULL == req->curl_handle || !__sync_lock_test_and_set(&req->resume, 0) || !req->paused)
+			continue;
+
+		req->paused = 0;
+
+		/* This may call the write callback, which may pause the transfer again or abort the transfer if the stream has been
+		 * abandoned, in the later case, the transfer will be disposed once the completion message is read */
+		CURLcode rc = curl_easy_pause(req->curl_handle, CURLPAUSE_CONT);
+		if(CURLE_OK != rc)
+			LOG_DEBUG("The transfer has been stopped on resume: %s", curl_easy_strerror(rc));
+	}
+
+	return 0;
+}
+
 static int _curl_timeout_func(CURLM* handle, long timeout, void* up)
 {
 	(void)handle;
@@ -279,7 +393,14 @@ static int _curl_socket_func(CURL* handle, int fd, int action, void* up, void* s
 	return 0;
 }
 
-static inline int _dispose_req(_thread_ctx_t* ctx, uint32_t idx)
+/**
+ * @brief Dispose a request buffer
+ * @param ctx The thread context
+ * @param idx The index of the request buffer
+ * @param failed If the transfer has failed, which ends the response body stream with an error
+ * @return status code
+ **/
+static inline int _dispose_req(_thread_ctx_t* ctx, uint32_t idx, int failed)
 {
 	if(ctx->req_buf[idx].curl_handle != NULL)
 	{
@@ -291,6 +412,13 @@ static inline int _dispose_req(_thread_ctx_t* ctx, uint32_t idx)
 		ctx->req_buf[idx].curl_handle = NULL;
 	}
 
+	if(ctx->req_buf[idx].stream != NULL)
+	{
+		if(ERROR_CODE(int) == stream_producer_detach(ctx->req_buf[idx].stream, failed))
+			LOG_WARNING("Cannot detach the response body stream");
+		ctx->req_buf[idx].stream = NULL;
+	}
+
 	pthread_mutex_lock(&ctx->writer_mutex);
 	ctx->req_buf[idx].next_unused = ctx->unused;
 	ctx->unused = idx;
@@ -324,25 +452,22 @@ static inline int _event_post_process(_thread_ctx_t* ctx, int num_running_handle
 				LOG_WARNING("Cannot get the curl private data: %s", curl_easy_strerror(get_info_rc));
 			else
 			{
-				/* No matter what result code we got from CURL, we mark the task as success and
-				 * the async_cleanup task should be responsible to decide if this is a success
-				 * situation */
-				*cur_req->curl_rc_buf = msg->data.result;
-				CURLcode curl_rc = curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, cur_req->status_buf);
-
-				if(CURLE_OK != curl_rc)
-					LOG_WARNING("Cannot get the status code from the curl object: %s", curl_easy_strerror(curl_rc));
-
-				if(CURLE_OK != msg->data.result)
-					LOG_WARNING("Curl connection returns abnormal result: %s", curl_easy_strerror(msg->data.result));
-
-				if(ERROR_CODE(int) == async_cntl(cur_req->async_handle, ASYNC_CNTL_NOTIFY_WAIT, 0))
+#ifdef LOG_DEBUG_ENABLED
+				/* Once the completion is notified, the caller may have released the URL string, so we use the
+				 * copy owned by the curl handle, which is valid until the request buffer gets disposed */
+				const char* url = NULL;
+				if(CURLE_OK != curl_easy_getinfo(handle, CURLINFO_EFFECTIVE_URL, &url) || NULL == url)
+					url = "<unknown>";
+				LOG_DEBUG("Request %s has been completed by client thread #%u", url, ctx->tid);
+#endif
+				/* The streaming request may have been notified when the body started */
+				if(!cur_req->notified && ERROR_CODE(int) == _notify_completion(cur_req, msg->data.result))
 					LOG_WARNING("Cannot notify the completion state");
+				else if(cur_req->notified && CURLE_OK != msg->data.result)
+					LOG_WARNING("Curl connection returns abnormal result: %s", curl_easy_strerror(msg->data.result));
 
-				if(ERROR_CODE(int) == _dispose_req(ctx, (uint32_t)(cur_req - ctx->req_buf)))
+				if(ERROR_CODE(int) == _dispose_req(ctx, (uint32_t)(cur_req - ctx->req_buf), CURLE_OK != msg->data.result))
 					LOG_WARNING("Cannot dispose the request buffer");
-
-				LOG_DEBUG("Request %s has been completed by client thread #%u", cur_req->url, ctx->tid);
 			}
 		}
 	}
@@ -420,6 +545,19 @@ static void* _client_main(void* data)
 					LOG_WARNING("Cannot post process event");
 			}
 
+		/* Then we need to continue the transfers whose response body stream has been drained */
+		if(ctx->resume_pending > 0)
+		{
+			if(ERROR_CODE(int) == _resume_paused(ctx))
+				LOG_WARNING("Cannot resume the paused transfers");
+
+			if(CURLM_OK != curl_multi_socket_action(ctx->curlm, CURL_SOCKET_TIMEOUT, 0, &num_running_handle))
+				LOG_WARNING("Cannot notify libcurl to run");
+
+			if(ERROR_CODE(int) == _event_post_process(ctx, num_running_handle))
+				LOG_WARNING("Cannot post process event");
+		}
+
 		/* Then we need to add the pending-to-add queue to the request heap */
 		while(((ctx->add_queue_rear - ctx->add_queue_front) & (_global.queue_size - 1)) > 0)
 		{
@@ -501,7 +639,7 @@ CURL_INIT_ERR:
 			if(ERROR_CODE(int) == async_cntl(buf->async_handle, ASYNC_CNTL_NOTIFY_WAIT, ERROR_CODE(int)))
 				LOG_WARNING("Cannot notify the async failure status");
 
-			if(ERROR_CODE(int) == _dispose_req(ctx, idx))
+			if(ERROR_CODE(int) == _dispose_req(ctx, idx, 1))
 				LOG_WARNING("Cannot dispose the request");
 		}
 	}
@@ -518,12 +656,16 @@ CURL_INIT_ERR:
 				LOG_WARNING("Cannot remove the CURL easy handle from CURL multi object: %s", curl_multi_strerror(curl_rc));
 		}
 
-		if(*ctx->req_buf[i].result_buf != NULL)
-			free(*ctx->req_buf[i].result_buf);
+		/* Once the completion has been notified, the result buffer belongs to the caller */
+		if(!ctx->req_buf[i].notified)
+		{
+			if(*ctx->req_buf[i].result_buf != NULL)
+				free(*ctx->req_buf[i].result_buf);
 
-		*ctx->req_buf[i].result_buf = NULL;
+			*ctx->req_buf[i].result_buf = NULL;
+		}
 
-		if(ERROR_CODE(int) == _dispose_req(ctx, i))
+		if(ERROR_CODE(int) == _dispose_req(ctx, i, 1))
 			LOG_ERROR("Cannot dispose the currently running request");
 	}
 
@@ -837,6 +979,14 @@ static inline int _post_request(client_request_t* req, int block, _thread_ctx_t*
 	req_obj->priority = req->priority;
 	req_obj->url = req->uri;
 	req_obj->curl_handle = NULL;
+	req_obj->thread_ctx = thread;
+	req_obj->notified = 0;
+	req_obj->paused = 0;
+	/* libcurl refuses to pause a transfer that doesn't go through the network, so the stream keeps the
+	 * bytes that don't fit the ring in its backlog, and the transfer fails once the backlog limit is reached */
+	req_obj->no_pause = (strncasecmp(req->uri, "file:", 5) == 0);
+	req_obj->resume = 0;
+	req_obj->stream = NULL;
 	req_obj->result_buf = &req->result;
 	req_obj->result_size_buf = &req->result_sz;
 	req_obj->curl_rc_buf = &req->curl_rc;
@@ -864,6 +1014,13 @@ static inline int _post_request(client_request_t* req, int block, _thread_ctx_t*
 	if(before_add_cb != NULL && before_add_cb(cb_data) == ERROR_CODE(int))
 		ERROR_LOG_ERRNO_GOTO(ERR, "The before add callback function returns an error");
 
+	if(NULL != req->stream)
+	{
+		if(ERROR_CODE(int) == stream_producer_attach(req->stream, _stream_resume, req_obj))
+			ERROR_LOG_GOTO(ERR, "Cannot attach the request to the response body stream");
+		req_obj->stream = req->stream;
+	}
+
 	thread->add_queue[thread->add_queue_rear & (_global.queue_size - 1)] = idx;
 
 	BARRIER();
@@ -31,6 +31,8 @@ typedef struct {
 
 	async_handle_t*              async_handle;   /*!< The async handle */
 
+	stream_t*                    stream;     /*!< The stream that receives the response body, NULL if the body should be returned in the result buffer */
+
 	char*                        result;     /*!< The buffer to return result */
 	size_t                       result_sz; /*!< The result size buffer */
 
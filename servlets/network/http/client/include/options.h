@@ -16,6 +16,9 @@ typedef struct {
 	uint32_t                queue_size;       /*!< The size of the request queue */
 	uint32_t                save_header:1;    /*!< If we need to save the header or metadata */
 	uint32_t                follow_redir:1;   /*!< If we need follow the HTTP redirect */
+	uint32_t                stream:1;         /*!< If we need to stream the response body through the body stream RLS */
+	uint32_t                stream_buffer;    /*!< The size of the ring buffer of each response body stream */
+	uint32_t                stream_backlog;   /*!< The maximum size of the backlog of each response body stream */
 } options_t;
 
 /**
@@ -0,0 +1,88 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+/**
+ * @brief The bounded response body stream
+ * @details This is the RLS object that carries the response body while the transfer is still running.
+ *          The client thread produces the body bytes to a bounded ring buffer and the RLS reader, typically
+ *          the async write loop of the transportation layer, consumes the bytes from the ring. <br/>
+ *          When the ring is full, the producer should stop the transfer until the resume callback is called,
+ *          which happens once the reader has drained half of the ring. <br/>
+ *          The stream is owned by both the producer and the consumer, it will be disposed only when both of them
+ *          have released the stream. If the consumer releases the stream before the transfer is done, the stream
+ *          is abandoned and the producer gets an error on the next write, so that it can abort the transfer.
+ * @file network/http/client/include/stream.h
+ **/
+#ifndef __NETWORK_HTTP_CLIENT_STREAM_H__
+#define __NETWORK_HTTP_CLIENT_STREAM_H__
+
+/**
+ * @brief The response body stream
+ **/
+typedef struct _stream_t stream_t;
+
+/**
+ * @brief The callback used to notify the producer that it can write again
+ * @note This function is called with the stream lock held, so it should only post a message to the producer
+ * @param data The additional data
+ * @return status code
+ **/
+typedef int (*stream_resume_func_t)(void* data);
+
+/**
+ * @brief Create a new stream
+ * @details The newly created stream is owned by the consumer, which should either commit it to the RLS or dispose it
+ * @param buf_size The size of the ring buffer
+ * @param backlog_limit The maximum number of bytes kept in the backlog for the producer that can not wait
+ * @return The newly created stream, NULL on error
+ **/
+stream_t* stream_new(size_t buf_size, size_t backlog_limit);
+
+/**
+ * @brief Release the consumer side ownership of a stream which hasn't been committed
+ * @param stream The stream
+ * @return status code
+ **/
+int stream_free(stream_t* stream);
+
+/**
+ * @brief Commit the stream to the RLS, after this call the consumer side ownership is taken by the RLS
+ * @param stream The stream
+ * @return The RLS token or error code
+ **/
+scope_token_t stream_commit(stream_t* stream);
+
+/**
+ * @brief Attach the producer to the stream
+ * @param stream The stream
+ * @param resume The callback used to notify the producer the stream can accept more data or has been abandoned
+ * @param data The data passed to the resume callback
+ * @return status code
+ **/
+int stream_producer_attach(stream_t* stream, stream_resume_func_t resume, void* data);
+
+/**
+ * @brief Write the data to the stream
+ * @note The data is either entirely accepted or entirely rejected. <br/>
+ *       If the producer can not wait, the data that doesn't fit the ring is kept in the backlog, and it's moved to
+ *       the ring as the reader drains the ring. So the reader sees the same bounded ring. <br/>
+ *       The backlog is bounded by the limit given to stream_new, once the limit is reached, the write fails
+ *       and the producer should abort the transfer.
+ * @param stream The stream
+ * @param data The data
+ * @param size The size of the data
+ * @param can_wait If the producer is able to wait for the resume callback
+ * @return The number of bytes accepted, 0 if the ring buffer is full and the producer should wait for the resume callback,
+ *         error code if the stream has been abandoned or on error cases
+ **/
+size_t stream_write(stream_t* stream, const void* data, size_t size, int can_wait);
+
+/**
+ * @brief Finish the stream and release the producer side ownership
+ * @param stream The stream
+ * @param error If the transfer has failed, in this case the reader gets an error once the buffered bytes are consumed
+ * @return status code
+ **/
+int stream_producer_detach(stream_t* stream, int error);
+
+#endif /* __NETWORK_HTTP_CLIENT_STREAM_H__ */
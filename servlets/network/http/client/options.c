@@ -26,6 +26,19 @@ static inline int _opt_callback(pstd_option_data_t data)
 		case 'f':
 			opt->follow_redir = 1;
 			break;
+		case 's':
+			opt->stream = 1;
+			break;
+		case 'B':
+			if(data.param_array[0].intval <= 0)
+				ERROR_RETURN_LOG(int, "Invalid stream buffer size");
+			opt->stream_buffer = (uint32_t)data.param_array[0].intval;
+			break;
+		case 'b':
+			if(data.param_array[0].intval < 0)
+				ERROR_RETURN_LOG(int, "Invalid stream backlog limit");
+			opt->stream_backlog = (uint32_t)data.param_array[0].intval;
+			break;
 		default:
 			ERROR_RETURN_LOG(int, "Invalid options");
 	}
@@ -81,6 +94,30 @@ static pstd_option_t _opts[] = {
 		.description = "Indicates we need to follow the redirection",
 		.handler     = _opt_callback,
 		.args        = NULL
+	},
+	{
+		.long_opt    = "stream",
+		.short_opt   = 's',
+		.pattern     = "",
+		.description = "Stream the response body through response.body_stream instead of returning it as a string",
+		.handler     = _opt_callback,
+		.args        = NULL
+	},
+	{
+		.long_opt    = "stream-buffer",
+		.short_opt   = 'B',
+		.pattern     = "I",
+		.description = "Set the size of the buffer of each response body stream [default value: 65536]",
+		.handler     = _opt_callback,
+		.args        = NULL
+	},
+	{
+		.long_opt    = "stream-backlog",
+		.short_opt   = 'b',
+		.pattern     = "I",
+		.description = "Set the maximum bytes a response body stream buffers beyond its buffer for the transfer that can not be paused, e.g. file:// [default value: 16777216]",
+		.handler     = _opt_callback,
+		.args        = NULL
 	}
 };
 
@@ -96,6 +133,9 @@ int options_parse(uint32_t argc, char const* const* argv, options_t* buf)
 	buf->queue_size   = 1024;
 	buf->save_header  = 0;
 	buf->follow_redir = 0;
+	buf->stream       = 0;
+	buf->stream_buffer = 65536;
+	buf->stream_backlog = 16777216;
 
 	if(ERROR_CODE(int) == pstd_option_sort(_opts, sizeof(_opts) / sizeof(_opts[0])))
 		ERROR_RETURN_LOG(int, "Cannot sort the options array");
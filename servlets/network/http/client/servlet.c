@@ -12,6 +12,7 @@
 
 #include <curl/curl.h>
 
+#include <stream.h>
 #include <client.h>
 #include <options.h>
 
@@ -25,6 +26,7 @@ typedef struct {
 	pstd_type_accessor_t    data_acc;       /*!< The data accessor */
 	pstd_type_accessor_t    priority_acc;   /*!< The priorty accessor */
 	pstd_type_accessor_t    res_body_acc;   /*!< The response data accessor */
+	pstd_type_accessor_t    res_stream_acc; /*!< The response body stream accessor */
 	pstd_type_accessor_t    res_header_acc; /*!< The response header or metadata */
 	pstd_type_accessor_t    res_status_acc; /*!< The response status code */
 	pstd_type_model_t*      type_model;     /*!< The type model for this servlet */
@@ -44,6 +46,7 @@ typedef struct {
 typedef struct {
 	int              posted;    /*!< If the task is posted */
 	uint32_t         follow:1;  /*!< Follow redirect */
+	uint32_t         stream_buffer; /*!< The ring size of the response body stream, 0 if the body is not streamed */
 	const char*      data;      /*!< The data payload */
 	client_request_t request;   /*!< The request data */
 	enum {
@@ -91,6 +94,9 @@ static int _init(uint32_t argc, char const* const* argv, void* data)
 	if(ERROR_CODE(pstd_type_accessor_t) == (ctx->res_body_acc = pstd_type_model_get_accessor(ctx->type_model, ctx->response, "body.token")))
 		ERROR_RETURN_LOG(int, "Cannot get the field accessor for response.body.token");
 
+	if(ERROR_CODE(pstd_type_accessor_t) == (ctx->res_stream_acc = pstd_type_model_get_accessor(ctx->type_model, ctx->response, "body_stream.token")))
+		ERROR_RETURN_LOG(int, "Cannot get the field accessor for response.body_stream.token");
+
 	if(ERROR_CODE(pstd_type_accessor_t) == (ctx->res_header_acc = pstd_type_model_get_accessor(ctx->type_model, ctx->response, "header.token")))
 		ERROR_RETURN_LOG(int, "Cannot get the field accessor for response.header.token");
 
@@ -140,6 +146,11 @@ static int _setup_request(CURL* handle, void* data)
 	if(buf->follow && CURLE_OK != (curl_rc = curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1)))
 		ERROR_RETURN_LOG(int, "Cannot set the follow redirection option: %s", curl_easy_strerror(curl_rc));
 
+	/* Otherwise libcurl hands over up to 16K at once, and a smaller ring has to be enlarged to accept it.
+	 * The value is clamped by libcurl, so the ring may still be enlarged if it's smaller than 1K */
+	if(buf->stream_buffer > 0 && CURLE_OK != (curl_rc = curl_easy_setopt(handle, CURLOPT_BUFFERSIZE, (long)buf->stream_buffer)))
+		ERROR_RETURN_LOG(int, "Cannot set the receive buffer size: %s", curl_easy_strerror(curl_rc));
+
 	switch(buf->method)
 	{
 		case POST:
@@ -231,6 +242,14 @@ static int _async_setup(async_handle_t* handle, void* data, void* ctxbuf)
 	abuf->request.setup_data = abuf;
 	abuf->follow = (ctx->options.follow_redir != 0);
 
+	/* In stream mode, the client thread writes the body to the stream and we are notified once the body starts */
+	if(ctx->options.stream)
+	{
+		if(NULL == (abuf->request.stream = stream_new(ctx->options.stream_buffer, ctx->options.stream_backlog)))
+			ERROR_LOG_GOTO(ERR, "Cannot create the response body stream");
+		abuf->stream_buffer = ctx->options.stream_buffer;
+	}
+
 	/* We cannot set the servlet mode to the synchronized mode at this point. Since once we failed to
 	 * performe the nonblocking add, we need async_exec to run. But the wait mode will prevent the async_exec
 	 * task from running. So the state will be set only when the task is about to start  */
@@ -251,6 +270,11 @@ static int _async_setup(async_handle_t* handle, void* data, void* ctxbuf)
 	return 0;
 ERR:
 	pstd_type_instance_free(inst);
+	if(NULL != abuf->request.stream)
+	{
+		stream_free(abuf->request.stream);
+		abuf->request.stream = NULL;
+	}
 	return ERROR_CODE(int);
 }
 
@@ -308,6 +332,19 @@ static int _async_cleanup(async_handle_t* handle, void* data, void* ctxbuf)
 
 	if(ERROR_CODE(int) == rc) ERROR_LOG_GOTO(ERR, "Cannot write result body to output");
 
+	if(NULL != abuf->request.stream)
+	{
+		scope_token_t tok = stream_commit(abuf->request.stream);
+		if(ERROR_CODE(scope_token_t) == tok)
+			ERROR_LOG_GOTO(ERR, "Cannot commit the response body stream to the scope");
+
+		/* The RLS owns the stream from now on */
+		abuf->request.stream = NULL;
+
+		if(ERROR_CODE(int) == PSTD_TYPE_INST_WRITE_PRIMITIVE(inst, ctx->res_stream_acc, tok))
+			ERROR_LOG_GOTO(ERR, "Cannot write the response body stream token to the output");
+	}
+
 	rc = _write_string(inst, ctx->res_header_acc, abuf->request.header, abuf->request.header_sz);
 	abuf->request.header = NULL;
 
@@ -324,6 +361,7 @@ ERR:
 	if(NULL != inst) pstd_type_instance_free(inst);
 	if(NULL != abuf->request.result) free(abuf->request.result);
 	if(NULL != abuf->request.header) free(abuf->request.header);
+	if(NULL != abuf->request.stream) stream_free(abuf->request.stream);
 	return ERROR_CODE(int);
 }
 
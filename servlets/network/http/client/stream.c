@@ -0,0 +1,427 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <sys/eventfd.h>
+
+#include <pservlet.h>
+#include <pstd.h>
+
+#include <stream.h>
+
+/**
+ * @brief The actual data structure of the stream
+ **/
+struct _stream_t {
+	pthread_mutex_t      mutex;       /*!< The mutex that protects the ring buffer and the flags */
+	uint32_t             refcnt;      /*!< The number of owners, which is at most 2 (the producer and the consumer) */
+	uint32_t             committed:1; /*!< If the stream has been committed to the RLS */
+	uint32_t             opened:1;    /*!< If the RLS has been opened by a reader */
+	uint32_t             paused:1;    /*!< If the producer has been turned down because the ring was full */
+	uint32_t             ended:1;     /*!< If the producer has finished the transfer */
+	uint32_t             error:1;     /*!< If the transfer has failed */
+	uint32_t             abandoned:1; /*!< If the consumer doesn't want the data anymore */
+	int                  event_fd;    /*!< The event FD which gets readable when the reader can make progress */
+	stream_resume_func_t resume;      /*!< The resume callback of the producer */
+	void*                resume_data; /*!< The data for the resume callback */
+	size_t               capacity;    /*!< The capacity of the ring buffer */
+	size_t               begin;       /*!< The offset of the first unread byte in the ring */
+	size_t               size;        /*!< The number of unread bytes in the ring */
+	char*                ring;        /*!< The ring buffer, which is allocated on the first write */
+	char*                backlog;     /*!< The bytes from the producer that can not wait, which doesn't fit the ring */
+	size_t               backlog_limit;/*!< The maximum number of bytes the backlog can hold */
+	size_t               backlog_begin;/*!< The offset of the first backlog byte that hasn't been moved to the ring */
+	size_t               backlog_size; /*!< The number of bytes in the backlog buffer */
+};
+
+/**
+ * @brief Notify the reader that it can make progress
+ * @param stream The stream
+ * @return status code
+ **/
+static inline int _notify_reader(const stream_t* stream)
+{
+	uint64_t val = 1;
+	if(write(stream->event_fd, &val, sizeof(val)) < 0 && errno != EAGAIN)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot write the stream event FD");
+
+	return 0;
+}
+
+/**
+ * @brief Append the data to the end of the ring
+ * @note The caller should make sure the ring has enough space and the lock is held
+ * @param stream The stream
+ * @param data The data
+ * @param size The size of the data
+ * @return nothing
+ **/
+static inline void _ring_put(stream_t* stream, const void* data, size_t size)
+{
+	size_t end = (stream->begin + stream->size) % stream->capacity;
+	size_t first = stream->capacity - end;
+	if(first > size) first = size;
+
+	memcpy(stream->ring + end, data, first);
+	memcpy(stream->ring, (const char*)data + first, size - first);
+	stream->size += size;
+}
+
+/**
+ * @brief Drop one owner of the stream and dispose the stream when there's no owner left
+ * @param stream The stream
+ * @return status code
+ **/
+static inline int _decref(stream_t* stream)
+{
+	pthread_mutex_lock(&stream->mutex);
+	uint32_t refcnt = -- stream->refcnt;
+	pthread_mutex_unlock(&stream->mutex);
+
+	if(refcnt > 0) return 0;
+
+	int rc = 0;
+
+	if(stream->event_fd >= 0 && close(stream->event_fd) < 0)
+	{
+		LOG_ERROR_ERRNO("Cannot close the stream event FD");
+		rc = ERROR_CODE(int);
+	}
+
+	if(0 != (errno = pthread_mutex_destroy(&stream->mutex)))
+	{
+		LOG_ERROR_ERRNO("Cannot dispose the stream mutex");
+		rc = ERROR_CODE(int);
+	}
+
+	if(NULL != stream->ring) free(stream->ring);
+	if(NULL != stream->backlog) free(stream->backlog);
+	free(stream);
+
+	return rc;
+}
+
+/**
+ * @brief Release the consumer side ownership, if the transfer is still running, the stream is abandoned
+ * @param stream The stream
+ * @return status code
+ **/
+static inline int _release_consumer(stream_t* stream)
+{
+	pthread_mutex_lock(&stream->mutex);
+	stream->abandoned = 1;
+	if(!stream->ended && NULL != stream->resume && ERROR_CODE(int) == stream->resume(stream->resume_data))
+		LOG_WARNING("Cannot notify the producer that the stream has been abandoned");
+	pthread_mutex_unlock(&stream->mutex);
+
+	return _decref(stream);
+}
+
+stream_t* stream_new(size_t buf_size, size_t backlog_limit)
+{
+	if(buf_size == 0) ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	stream_t* ret = (stream_t*)calloc(1, sizeof(stream_t));
+	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the stream");
+
+	if(0 != (errno = pthread_mutex_init(&ret->mutex, NULL)))
+	{
+		free(ret);
+		ERROR_PTR_RETURN_LOG_ERRNO("Cannot initialize the stream mutex");
+	}
+
+	if(-1 == (ret->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)))
+	{
+		pthread_mutex_destroy(&ret->mutex);
+		free(ret);
+		ERROR_PTR_RETURN_LOG_ERRNO("Cannot create the event FD for the stream");
+	}
+
+	ret->refcnt = 1;
+	ret->capacity = buf_size;
+	ret->backlog_limit = backlog_limit;
+
+	return ret;
+}
+
+int stream_free(stream_t* stream)
+{
+	if(NULL == stream || stream->committed) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	return _release_consumer(stream);
+}
+
+int stream_producer_attach(stream_t* stream, stream_resume_func_t resume, void* data)
+{
+	if(NULL == stream || NULL == resume) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	pthread_mutex_lock(&stream->mutex);
+	stream->refcnt ++;
+	stream->resume = resume;
+	stream->resume_data = data;
+	pthread_mutex_unlock(&stream->mutex);
+
+	return 0;
+}
+
+size_t stream_write(stream_t* stream, const void* data, size_t size, int can_wait)
+{
+	if(NULL == stream || (NULL == data && size > 0)) ERROR_RETURN_LOG(size_t, "Invalid arguments");
+
+	if(size == 0) return 0;
+
+	pthread_mutex_lock(&stream->mutex);
+
+	if(stream->abandoned)
+	{
+		pthread_mutex_unlock(&stream->mutex);
+		LOG_DEBUG("The stream has been abandoned by the consumer");
+		return ERROR_CODE(size_t);
+	}
+
+	/* The bytes in the backlog go first */
+	if(stream->backlog_size > stream->backlog_begin)
+		goto BACKLOG;
+
+	/* The data which can not fit even an empty ring is accepted by enlarging the ring, otherwise we will never make progress */
+	if(stream->size == 0 && (NULL == stream->ring || size > stream->capacity))
+	{
+		if(size > stream->capacity) stream->capacity = size;
+		char* ring = (char*)realloc(stream->ring, stream->capacity);
+		if(NULL == ring)
+		{
+			pthread_mutex_unlock(&stream->mutex);
+			ERROR_RETURN_LOG_ERRNO(size_t, "Cannot allocate the ring buffer");
+		}
+		stream->ring = ring;
+		stream->begin = 0;
+	}
+
+	if(stream->capacity - stream->size < size)
+	{
+		if(!can_wait) goto BACKLOG;
+
+		stream->paused = 1;
+		pthread_mutex_unlock(&stream->mutex);
+		return 0;
+	}
+
+	int was_empty = (stream->size == 0);
+
+	_ring_put(stream, data, size);
+
+	pthread_mutex_unlock(&stream->mutex);
+
+	/* The reader only waits for the event when it has seen an empty ring */
+	if(was_empty && ERROR_CODE(int) == _notify_reader(stream))
+		ERROR_RETURN_LOG(size_t, "Cannot notify the reader");
+
+	return size;
+BACKLOG:
+	/* The ring is not empty at this point, so the reader doesn't need to be notified */
+	if(stream->backlog_begin > 0)
+	{
+		memmove(stream->backlog, stream->backlog + stream->backlog_begin, stream->backlog_size - stream->backlog_begin);
+		stream->backlog_size -= stream->backlog_begin;
+		stream->backlog_begin = 0;
+	}
+
+	/* The reader may never come back, so we can not hold the entire response in memory */
+	if(size > stream->backlog_limit - stream->backlog_size)
+	{
+		pthread_mutex_unlock(&stream->mutex);
+		ERROR_RETURN_LOG(size_t, "The stream backlog exceeds the limit of %zu bytes", stream->backlog_limit);
+	}
+
+	char* backlog = (char*)realloc(stream->backlog, stream->backlog_size + size);
+	if(NULL == backlog)
+	{
+		pthread_mutex_unlock(&stream->mutex);
+		ERROR_RETURN_LOG_ERRNO(size_t, "Cannot allocate the stream backlog");
+	}
+
+	memcpy(backlog + stream->backlog_size, data, size);
+	stream->backlog = backlog;
+	stream->backlog_size += size;
+
+	pthread_mutex_unlock(&stream->mutex);
+
+	return size;
+}
+
+int stream_producer_detach(stream_t* stream, int error)
+{
+	if(NULL == stream) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	pthread_mutex_lock(&stream->mutex);
+	stream->ended = 1;
+	stream->error = (error != 0);
+	stream->resume = NULL;
+	stream->resume_data = NULL;
+	pthread_mutex_unlock(&stream->mutex);
+
+	if(ERROR_CODE(int) == _notify_reader(stream))
+		LOG_WARNING("Cannot notify the reader the end of the stream");
+
+	return _decref(stream);
+}
+
+static int _rls_free(void* obj)
+{
+	return _release_consumer((stream_t*)obj);
+}
+
+static void* _rls_open(const void* obj)
+{
+	/* The object itself is not modified, but we need the lock */
+	stream_t* stream = (stream_t*)(uintptr_t)obj;
+
+	pthread_mutex_lock(&stream->mutex);
+	int opened = stream->opened;
+	stream->opened = 1;
+	pthread_mutex_unlock(&stream->mutex);
+
+	if(opened) ERROR_PTR_RETURN_LOG("The response body stream can only be opened once");
+
+	return stream;
+}
+
+static int _rls_close(void* handle)
+{
+	stream_t* stream = (stream_t*)handle;
+
+	/* If the reader stops before the end of the stream, the rest of the transfer is useless */
+	pthread_mutex_lock(&stream->mutex);
+	if(!stream->ended || stream->size > 0)
+	{
+		stream->abandoned = 1;
+		if(!stream->ended && NULL != stream->resume && ERROR_CODE(int) == stream->resume(stream->resume_data))
+			LOG_WARNING("Cannot notify the producer that the stream has been abandoned");
+	}
+	pthread_mutex_unlock(&stream->mutex);
+
+	return 0;
+}
+
+static size_t _rls_read(void* __restrict handle, void* __restrict buf, size_t count)
+{
+	stream_t* stream = (stream_t*)handle;
+	uint64_t val;
+
+	pthread_mutex_lock(&stream->mutex);
+
+	if(stream->size == 0 && !stream->ended)
+	{
+		/* Clear the event before we check the ring again, so that the data comes after this point always wakes us up */
+		pthread_mutex_unlock(&stream->mutex);
+		if(read(stream->event_fd, &val, sizeof(val)) < 0 && errno != EAGAIN)
+			ERROR_RETURN_LOG_ERRNO(size_t, "Cannot read the stream event FD");
+		pthread_mutex_lock(&stream->mutex);
+	}
+
+	size_t ret = stream->size < count ? stream->size : count;
+
+	if(ret > 0)
+	{
+		size_t first = stream->capacity - stream->begin;
+		if(first > ret) first = ret;
+		memcpy(buf, stream->ring + stream->begin, first);
+		memcpy((char*)buf + first, stream->ring, ret - first);
+		stream->begin = (stream->begin + ret) % stream->capacity;
+		stream->size -= ret;
+	}
+
+	/* Then we refill the ring with the backlog, so that the next read is still bounded by the ring */
+	if(stream->backlog_size > stream->backlog_begin)
+	{
+		size_t refill = stream->backlog_size - stream->backlog_begin;
+		if(refill > stream->capacity - stream->size) refill = stream->capacity - stream->size;
+
+		_ring_put(stream, stream->backlog + stream->backlog_begin, refill);
+
+		if((stream->backlog_begin += refill) == stream->backlog_size)
+		{
+			free(stream->backlog);
+			stream->backlog = NULL;
+			stream->backlog_begin = stream->backlog_size = 0;
+		}
+	}
+
+	/* Let the producer continue once half of the ring is available */
+	if(stream->paused && stream->capacity - stream->size >= stream->capacity / 2)
+	{
+		stream->paused = 0;
+		if(NULL != stream->resume && ERROR_CODE(int) == stream->resume(stream->resume_data))
+			LOG_WARNING("Cannot resume the producer");
+	}
+
+	int failed = (ret == 0 && stream->ended && stream->error);
+
+	pthread_mutex_unlock(&stream->mutex);
+
+	if(failed) ERROR_RETURN_LOG(size_t, "The response body transfer has failed");
+
+	return ret;
+}
+
+static int _rls_eos(const void* handle)
+{
+	stream_t* stream = (stream_t*)(uintptr_t)handle;
+
+	pthread_mutex_lock(&stream->mutex);
+	int ret = (stream->ended && !stream->error && stream->size == 0);
+	pthread_mutex_unlock(&stream->mutex);
+
+	return ret;
+}
+
+static int _rls_event(void* __restrict handle, scope_ready_event_t* event_buf)
+{
+	stream_t* stream = (stream_t*)handle;
+
+	pthread_mutex_lock(&stream->mutex);
+	int ready = (stream->size > 0 || stream->ended);
+	pthread_mutex_unlock(&stream->mutex);
+
+	if(ready) return 0;
+
+	event_buf->fd = stream->event_fd;
+	event_buf->read = 1;
+	event_buf->write = 0;
+	/* The transfer has no time limit by itself, so the data TTL of the transportation layer applies */
+	event_buf->timeout = INT32_MAX;
+
+	return 1;
+}
+
+scope_token_t stream_commit(stream_t* stream)
+{
+	if(NULL == stream || stream->committed)
+		ERROR_RETURN_LOG(scope_token_t, "Invalid arguments");
+
+	scope_entity_t ent = {
+		.data = stream,
+		.free_func = _rls_free,
+		.copy_func = NULL,
+		.open_func = _rls_open,
+		.close_func = _rls_close,
+		.eos_func = _rls_eos,
+		.read_func = _rls_read,
+		.event_func = _rls_event
+	};
+
+	scope_token_t ret = pstd_scope_add(&ent);
+
+	if(ERROR_CODE(scope_token_t) == ret)
+		ERROR_RETURN_LOG(scope_token_t, "Cannot add the stream to the scope");
+
+	stream->committed = 1;
+
+	return ret;
+}
@@ -0,0 +1,463 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+
+/**
+ * @brief The response body stream test, which runs the client thread against a local HTTP server with a
+ *        ring smaller than the body, and checks the transfer is paused, resumed and aborted as the reader goes
+ **/
+#include <testenv.h>
+#include <stdio.h>
+#include <limits.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include <pservlet.h>
+
+/* The RLS callbacks of the stream are only reachable through the scope, so we test them directly */
+#include "../stream.c"
+#include "../client.c"
+
+/**
+ * @brief The size of the ring buffer, which is also the receive buffer size of libcurl
+ **/
+#define RING_SIZE 4096
+
+/**
+ * @brief The size of the stream backlog for the file:// transfers
+ **/
+#define BACKLOG_LIMIT 65536
+
+/**
+ * @brief How many times we poll the stream before we give up, each poll waits for 100ms
+ **/
+#define MAX_POLLS 100
+
+static int _listen_fd = -1;
+static uint16_t _port;
+static pthread_t _server;
+static size_t _body_size;
+static size_t _body_sent;
+
+static pthread_mutex_t _notify_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  _notify_cond = PTHREAD_COND_INITIALIZER;
+static uint32_t _notified;
+
+static void _log_write(int level, const char* file, const char* function, int line, const char* fmt, va_list ap)
+{
+	log_write_va(level, file, function, line, fmt, ap);
+}
+
+static int _async_cntl(runtime_api_async_handle_t* handle, uint32_t opcode, va_list ap)
+{
+	(void)handle;
+	(void)ap;
+
+	if(opcode != ASYNC_CNTL_NOTIFY_WAIT) return ERROR_CODE(int);
+
+	pthread_mutex_lock(&_notify_mutex);
+	_notified ++;
+	pthread_cond_signal(&_notify_cond);
+	pthread_mutex_unlock(&_notify_mutex);
+
+	return 0;
+}
+
+static const address_table_t _address_table = {
+	.log_write  = _log_write,
+	.async_cntl = _async_cntl
+};
+
+const address_table_t* RUNTIME_ADDRESS_TABLE_SYM = &_address_table;
+
+static inline char _body_byte(size_t offset)
+{
+	return (char)(offset % 251);
+}
+
+/**
+ * @brief Serve one request with a body of _body_size bytes, stop once the client has gone
+ **/
+static void* _server_main(void* data)
+{
+	(void)data;
+	char buf[RING_SIZE];
+	size_t size = 0, i;
+	ssize_t rc;
+
+	int fd = accept(_listen_fd, NULL, NULL);
+	if(fd < 0) return NULL;
+
+	/* Make sure the server is actually throttled by the client, rather than the socket buffers */
+	int sndbuf = 65536;
+	setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+	while(size < sizeof(buf) - 1 && (rc = recv(fd, buf + size, sizeof(buf) - 1 - size, 0)) > 0)
+	{
+		buf[size += (size_t)rc] = 0;
+		if(NULL != strstr(buf, "\r\n\r\n")) break;
+	}
+
+	int len = snprintf(buf, sizeof(buf), "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n\r\n", _body_size);
+	if(send(fd, buf, (size_t)len, MSG_NOSIGNAL) != len) goto RET;
+
+	while(_body_sent < _body_size)
+	{
+		size_t chunk = _body_size - _body_sent;
+		if(chunk > sizeof(buf)) chunk = sizeof(buf);
+		for(i = 0; i < chunk; i ++)
+			buf[i] = _body_byte(_body_sent + i);
+		if((rc = send(fd, buf, chunk, MSG_NOSIGNAL)) <= 0) break;
+		_body_sent += (size_t)rc;
+	}
+RET:
+	close(fd);
+	return NULL;
+}
+
+static int _server_start(size_t body_size)
+{
+	_body_size = body_size;
+	_body_sent = 0;
+
+	return pthread_create(&_server, NULL, _server_main, NULL) == 0 ? 0 : ERROR_CODE(int);
+}
+
+static int _setup_request(CURL* handle, void* data)
+{
+	(void)data;
+
+	if(CURLE_OK != curl_easy_setopt(handle, CURLOPT_BUFFERSIZE, (long)RING_SIZE))
+		return ERROR_CODE(int);
+
+	return 0;
+}
+
+/**
+ * @brief Post the request and wait until the response head has been notified
+ * @param req The request buffer
+ * @param uri The URI
+ * @param stream The response body stream
+ * @return status code
+ **/
+static int _request(client_request_t* req, const char* uri, stream_t* stream)
+{
+	struct timespec deadline;
+	int rc = 0;
+
+	memset(req, 0, sizeof(*req));
+	req->uri = uri;
+	req->setup = _setup_request;
+	req->async_handle = (async_handle_t*)req;
+	req->stream = stream;
+
+	pthread_mutex_lock(&_notify_mutex);
+	uint32_t notified = _notified;
+	pthread_mutex_unlock(&_notify_mutex);
+
+	if(ERROR_CODE(int) == client_add_request(req, 1, NULL, NULL))
+		return ERROR_CODE(int);
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += MAX_POLLS / 10;
+
+	pthread_mutex_lock(&_notify_mutex);
+	while(rc == 0 && _notified == notified)
+		rc = pthread_cond_timedwait(&_notify_cond, &_notify_mutex, &deadline);
+	pthread_mutex_unlock(&_notify_mutex);
+
+	return rc == 0 ? 0 : ERROR_CODE(int);
+}
+
+/**
+ * @brief Wait until the reader of the stream can make progress
+ * @param stream The stream
+ * @return status code
+ **/
+static int _wait_stream(stream_t* stream)
+{
+	struct pollfd pfd = {
+		.fd = stream->event_fd,
+		.events = POLLIN
+	};
+
+	uint64_t val;
+
+	if(poll(&pfd, 1, 100) < 0) return ERROR_CODE(int);
+
+	/* Otherwise the event FD stays readable and we won't wait next time */
+	if(read(stream->event_fd, &val, sizeof(val)) < 0 && errno != EAGAIN)
+		return ERROR_CODE(int);
+
+	return 0;
+}
+
+/**
+ * @brief Check if the producer has finished the transfer
+ * @param stream The stream
+ * @param error The buffer for the error flag
+ * @return the check result
+ **/
+static int _stream_ended(stream_t* stream, int* error)
+{
+	pthread_mutex_lock(&stream->mutex);
+	int ret = stream->ended;
+	*error = stream->error;
+	pthread_mutex_unlock(&stream->mutex);
+
+	return ret;
+}
+
+/**
+ * @brief Wait until the producer gets paused because the ring is full
+ * @param stream The stream
+ * @return status code
+ **/
+static int _wait_paused(stream_t* stream)
+{
+	uint32_t i;
+	for(i = 0; i < MAX_POLLS; i ++)
+	{
+		pthread_mutex_lock(&stream->mutex);
+		int paused = stream->paused;
+		const _req_t* req = (const _req_t*)stream->resume_data;
+		/* The client thread sets the flag right after the stream turns down the write */
+		if(paused && NULL != req && req->paused)
+		{
+			/* The producer waits instead of buffering the data */
+			int bounded = (stream->capacity == RING_SIZE && stream->backlog_size == 0);
+			pthread_mutex_unlock(&stream->mutex);
+			return bounded ? 0 : ERROR_CODE(int);
+		}
+		pthread_mutex_unlock(&stream->mutex);
+		usleep(100000);
+	}
+
+	return ERROR_CODE(int);
+}
+
+/**
+ * @brief Read the stream until the end and verify the content
+ * @param handle The RLS handle
+ * @param expected The expected size of the body
+ * @return status code
+ **/
+static int _read_body(void* handle, size_t expected)
+{
+	char buf[1000];
+	size_t offset = 0, i;
+	uint32_t idle = 0;
+
+	while(!_rls_eos(handle))
+	{
+		size_t rc = _rls_read(handle, buf, sizeof(buf));
+		ASSERT_RETOK(size_t, rc, CLEANUP_NOP);
+
+		if(rc == 0)
+		{
+			ASSERT(idle ++ < MAX_POLLS, CLEANUP_NOP);
+			ASSERT_OK(_wait_stream((stream_t*)handle), CLEANUP_NOP);
+			continue;
+		}
+
+		idle = 0;
+		for(i = 0; i < rc; i ++)
+			ASSERT(buf[i] == _body_byte(offset + i), CLEANUP_NOP);
+		offset += rc;
+	}
+
+	ASSERT(offset == expected, CLEANUP_NOP);
+
+	return 0;
+}
+
+int pause_resume(void)
+{
+	client_request_t req;
+	char uri[64];
+	int server_started = 0, error, rc = ERROR_CODE(int);
+	stream_t* stream = NULL;
+	void* handle = NULL;
+
+	snprintf(uri, sizeof(uri), "http://127.0.0.1:%u/", _port);
+
+	ASSERT_PTR(stream = stream_new(RING_SIZE, BACKLOG_LIMIT), CLEANUP_NOP);
+	ASSERT_OK(_server_start(1024 * 1024), goto ERR);
+	server_started = 1;
+	ASSERT_OK(_request(&req, uri, stream), goto ERR);
+
+	/* The body is much larger than the ring, so the transfer should be paused until we read */
+	ASSERT_OK(_wait_paused(stream), goto ERR);
+
+	/* Every time the reader drains half of the ring, the transfer is resumed by the client thread */
+	ASSERT_PTR(handle = _rls_open(stream), goto ERR);
+	ASSERT_OK(_read_body(handle, 1024 * 1024), goto ERR);
+
+	ASSERT(_stream_ended(stream, &error), goto ERR);
+	ASSERT(!error, goto ERR);
+	ASSERT(stream->capacity == RING_SIZE, goto ERR);
+
+	rc = 0;
+ERR:
+	if(NULL != handle) _rls_close(handle);
+	if(NULL != stream) _rls_free(stream);
+	if(server_started) pthread_join(_server, NULL);
+	return rc;
+}
+
+int abandon_paused(void)
+{
+	client_request_t req;
+	char uri[64], buf[100];
+	int server_started = 0, error = 0, rc = ERROR_CODE(int);
+	uint32_t i;
+	stream_t* stream = NULL;
+	void* handle = NULL;
+
+	snprintf(uri, sizeof(uri), "http://127.0.0.1:%u/", _port);
+
+	ASSERT_PTR(stream = stream_new(RING_SIZE, BACKLOG_LIMIT), CLEANUP_NOP);
+	ASSERT_OK(_server_start(64 * 1024 * 1024), goto ERR);
+	server_started = 1;
+	ASSERT_OK(_request(&req, uri, stream), goto ERR);
+	ASSERT_OK(_wait_paused(stream), goto ERR);
+
+	/* Consume a few bytes, which isn't enough to resume the transfer, then walk away */
+	ASSERT_PTR(handle = _rls_open(stream), goto ERR);
+	ASSERT(sizeof(buf) == _rls_read(handle, buf, sizeof(buf)), goto ERR);
+	ASSERT_OK(_rls_close(handle), goto ERR);
+	handle = NULL;
+
+	/* The paused transfer should be waken up and aborted */
+	for(i = 0; i < MAX_POLLS && !_stream_ended(stream, &error); i ++)
+		ASSERT_OK(_wait_stream(stream), goto ERR);
+	ASSERT(i < MAX_POLLS, goto ERR);
+	ASSERT(error, goto ERR);
+
+	/* And the server sees the connection closed before the body is done */
+	pthread_join(_server, NULL);
+	server_started = 0;
+	ASSERT(_body_sent < _body_size, goto ERR);
+
+	rc = 0;
+ERR:
+	if(NULL != handle) _rls_close(handle);
+	if(NULL != stream) _rls_free(stream);
+	if(server_started) pthread_join(_server, NULL);
+	return rc;
+}
+
+/**
+ * @brief Write a file with the test body
+ * @param path The path to the file
+ * @param size The size of the body
+ * @return status code
+ **/
+static int _write_file(const char* path, size_t size)
+{
+	char buf[RING_SIZE];
+	size_t offset = 0, i;
+
+	FILE* fp = fopen(path, "w");
+	ASSERT_PTR(fp, CLEANUP_NOP);
+
+	while(offset < size)
+	{
+		size_t chunk = size - offset;
+		if(chunk > sizeof(buf)) chunk = sizeof(buf);
+		for(i = 0; i < chunk; i ++)
+			buf[i] = _body_byte(offset + i);
+		ASSERT(chunk == fwrite(buf, 1, chunk, fp), fclose(fp));
+		offset += chunk;
+	}
+
+	ASSERT(0 == fclose(fp), CLEANUP_NOP);
+
+	return 0;
+}
+
+int file_backlog(void)
+{
+	client_request_t req;
+	char uri[PATH_MAX + 16];
+	int error = 0, rc = ERROR_CODE(int);
+	uint32_t i;
+	stream_t* stream = NULL;
+	void* handle = NULL;
+
+	snprintf(uri, sizeof(uri), "file://%s/body.bin", TESTDIR);
+
+	/* The file:// transfer can not be paused, so the body that fits the ring and the backlog is buffered */
+	ASSERT_OK(_write_file(uri + 7, RING_SIZE + BACKLOG_LIMIT), CLEANUP_NOP);
+	ASSERT_PTR(stream = stream_new(RING_SIZE, BACKLOG_LIMIT), goto ERR);
+	ASSERT_OK(_request(&req, uri, stream), goto ERR);
+	for(i = 0; i < MAX_POLLS && !_stream_ended(stream, &error); i ++)
+		ASSERT_OK(_wait_stream(stream), goto ERR);
+	ASSERT(i < MAX_POLLS, goto ERR);
+	ASSERT(!error, goto ERR);
+	ASSERT(stream->size + stream->backlog_size == RING_SIZE + BACKLOG_LIMIT, goto ERR);
+
+	ASSERT_PTR(handle = _rls_open(stream), goto ERR);
+	ASSERT_OK(_read_body(handle, RING_SIZE + BACKLOG_LIMIT), goto ERR);
+	ASSERT_OK(_rls_close(handle), goto ERR);
+	handle = NULL;
+	int free_rc = _rls_free(stream);
+	stream = NULL;
+	ASSERT_OK(free_rc, goto ERR);
+
+	/* But the transfer fails once the backlog is full, rather than holding the entire file */
+	ASSERT_OK(_write_file(uri + 7, 1024 * 1024), CLEANUP_NOP);
+	ASSERT_PTR(stream = stream_new(RING_SIZE, BACKLOG_LIMIT), goto ERR);
+	ASSERT_OK(_request(&req, uri, stream), goto ERR);
+	for(i = 0; i < MAX_POLLS && !_stream_ended(stream, &error); i ++)
+		ASSERT_OK(_wait_stream(stream), goto ERR);
+	ASSERT(i < MAX_POLLS, goto ERR);
+	ASSERT(error, goto ERR);
+	ASSERT(stream->backlog_size <= BACKLOG_LIMIT, goto ERR);
+
+	rc = 0;
+ERR:
+	if(NULL != handle) _rls_close(handle);
+	if(NULL != stream) _rls_free(stream);
+	unlink(uri + 7);
+	return rc;
+}
+
+int setup(void)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port   = 0
+	};
+	socklen_t len = sizeof(addr);
+	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+	ASSERT((_listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) >= 0, CLEANUP_NOP);
+	ASSERT(0 == bind(_listen_fd, (struct sockaddr*)&addr, sizeof(addr)), CLEANUP_NOP);
+	ASSERT(0 == listen(_listen_fd, 4), CLEANUP_NOP);
+	ASSERT(0 == getsockname(_listen_fd, (struct sockaddr*)&addr, &len), CLEANUP_NOP);
+	_port = ntohs(addr.sin_port);
+
+	ASSERT_OK(client_init(8, 8, 1), CLEANUP_NOP);
+
+	return 0;
+}
+
+int teardown(void)
+{
+	ASSERT_OK(client_finalize(), CLEANUP_NOP);
+
+	if(_listen_fd >= 0) close(_listen_fd);
+
+	return 0;
+}
+
+TEST_LIST_BEGIN
+    TEST_CASE(pause_resume),
+    TEST_CASE(abandon_paused),
+    TEST_CASE(file_backlog)
+TEST_LIST_END;
@@ -22,7 +22,11 @@ typedef struct {
 typedef enum {
 	PARSER_METHOD_GET,   /*!< GET method */
 	PARSER_METHOD_POST,  /*!< POST method */
-	PARSER_METHOD_HEAD   /*!< HEAD method */
+	PARSER_METHOD_HEAD,  /*!< HEAD method */
+	PARSER_METHOD_PUT,   /*!< PUT method */
+	PARSER_METHOD_DELETE,/*!< DELETE method */
+	PARSER_METHOD_PATCH, /*!< PATCH method */
+	PARSER_METHOD_OPTIONS/*!< OPTIONS method */
 } parser_method_t;
 
 /**
@@ -0,0 +1,63 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+/**
+ * @brief The vectorized byte scanner used by the request parser
+ * @details The parser spends most of its time on looking for the delimiters and matching the field
+ *          names. This file provides the SSE4.2 and AVX2 version of those operations, the implementation
+ *          is selected at runtime based on the CPU features, and the scalar version is used when neither
+ *          of them is available.
+ * @file http/parser/include/scan.h
+ **/
+#ifndef __SCAN_H__
+#define __SCAN_H__
+
+/**
+ * @brief The maximum number of chars in a char set
+ **/
+#define SCAN_SET_MAX 16
+
+/**
+ * @brief A set of chars we are looking for
+ * @note The set is meant to be a static constant, for example the set of '?' and ' ' is
+ *       <code>{.size = 2, .chars = "? ", .table = {['?'] = 1, [' '] = 1}}</code>
+ **/
+typedef struct {
+	uint32_t size;                         /*!< The number of chars in the set */
+	char     chars[SCAN_SET_MAX];          /*!< The chars in the set, padded with 0 */
+	uint8_t  table[256];                   /*!< The lookup table used by the scalar scanner */
+} scan_set_t;
+
+/**
+ * @brief Select the scanner implementation based on the CPU features
+ * @note Before this function gets called, the scalar implementation is used
+ * @return status code
+ **/
+int scan_init(void);
+
+/**
+ * @brief Get the name of the selected scanner implementation
+ * @return The name
+ **/
+const char* scan_impl_name(void);
+
+/**
+ * @brief Find the first char in the buffer that belongs to the char set
+ * @param begin The begining of the buffer
+ * @param end The end of the buffer
+ * @param set The char set
+ * @return The pointer to the first char in the set, or end if there's no such char
+ **/
+const char* scan_find_any(const char* begin, const char* end, const scan_set_t* set);
+
+/**
+ * @brief Match the buffer against a lower-case literal, ignoring the case of the buffer
+ * @param data The data buffer, it should have at least size bytes
+ * @param avail The number of bytes that can be read from the data buffer
+ * @param lit The literal, it must be a 16 bytes zero padded buffer
+ * @param size The size of the literal, at most 15
+ * @return 1 if matches, 0 if not
+ **/
+int scan_match_ci(const char* data, size_t avail, const char* lit, size_t size);
+
+#endif /* __SCAN_H__ */
@@ -11,6 +11,7 @@
 #include <pstd.h>
 
 #include <parser.h>
+#include <scan.h>
 
 /**
  * @brief The HTTP parser state codes
@@ -20,6 +21,11 @@ typedef enum {
 	_STATE_METHOD_GET,      /*!< The method phrase is determined and we need to match the method */
 	_STATE_METHOD_HEAD,     /*!< The method phrase is determined and we need to match the method */
 	_STATE_METHOD_POST,     /*!< The method phrase is determined and we need to match the method */
+	_STATE_METHOD_P,        /*!< We have seen the leading P and need the second char to determine the method */
+	_STATE_METHOD_PUT,      /*!< The method phrase is determined and we need to match the method */
+	_STATE_METHOD_PATCH,    /*!< The method phrase is determined and we need to match the method */
+	_STATE_METHOD_DELETE,   /*!< The method phrase is determined and we need to match the method */
+	_STATE_METHOD_OPTIONS,  /*!< The method phrase is determined and we need to match the method */
 	_STATE_METHOD_PATH_SEP, /*!< The state for we are in the middle of method phrase and server path */
 	_STATE_URI,             /*!< We are parsing the URI */
 	_STATE_URI_SCHEME,      /*!< We are parsing the URL scheme (Based on the RFC the URL can be a full URI*/
@@ -95,7 +101,7 @@ typedef struct {
 	.fail = _STATE_##fs, \
 	.param = {\
 		.liter = {\
-			.str = lit,\
+			.str = (const char[16]){lit},\
 			.size = sizeof(lit) - 1\
 		}\
 	}\
@@ -125,7 +131,17 @@ static _state_desc_t _state_info[_STATE_COUNT] = {
 	/* We are going to match HEAD */
 	_LITERAL(METHOD_HEAD, METHOD_PATH_SEP, "EAD "),
 	/* We are going to match POST */
-	_LITERAL(METHOD_POST, METHOD_PATH_SEP, "OST "),
+	_LITERAL(METHOD_POST, METHOD_PATH_SEP, "ST "),
+	/* In this state we need to determine which method starts with P */
+	_GENERIC(METHOD_P),
+	/* We are going to match PUT */
+	_LITERAL(METHOD_PUT, METHOD_PATH_SEP, "T "),
+	/* We are going to match PATCH */
+	_LITERAL(METHOD_PATCH, METHOD_PATH_SEP, "TCH "),
+	/* We are going to match DELETE */
+	_LITERAL(METHOD_DELETE, METHOD_PATH_SEP, "ELETE "),
+	/* We are going to match OPTIONS */
+	_LITERAL(METHOD_OPTIONS, METHOD_PATH_SEP, "PTIONS "),
 	/* Strip the extra white space between method and URI */
 	_WS(METHOD_PATH_SEP, URI, 0),
 	/* In this state we need to determine if we got a full URI or relative path */
@@ -289,6 +305,18 @@ static inline const char* _copy(parser_state_t* state, const char* data, const c
 	return termpos;
 }
 
+/**
+ * @brief The chars that terminates the URI path
+ **/
+static const scan_set_t _path_term = {
+	.size  = 2,
+	.chars = "? ",
+	.table = {
+		['?'] = 1,
+		[' '] = 1
+	}
+};
+
 static inline const char* _uri_path(parser_state_t* state, const char* data, const char* end)
 {
 	_state_t* internal = (_state_t*)state->internal_state;
@@ -300,13 +328,15 @@ static inline const char* _uri_path(parser_state_t* state, const char* data, con
 		internal->code ^= _STATE_PENDING;
 	}
 
-	for(;data < end && data[0] != '?' && data[0] != ' '; data ++)
-	{
-		int ensure_rc = _ensure_buffer(state, 1, 2048);
-		if(ensure_rc == 0) return data;
-		if(ensure_rc == ERROR_CODE(int)) return NULL;
-		internal->buffer->value[internal->buffer->length++] = data[0];
-	}
+	const char* termpos = scan_find_any(data, end, &_path_term);
+
+	int ensure_rc = _ensure_buffer(state, (size_t)(termpos - data), 2048);
+	if(ensure_rc == 0) return data;
+	if(ensure_rc == ERROR_CODE(int)) return NULL;
+
+	memcpy(internal->buffer->value + internal->buffer->length, data, (size_t)(termpos - data));
+	internal->buffer->length += (size_t)(termpos - data);
+	data = termpos;
 
 	if(data < end && data[0] == '?')
 	{
@@ -408,6 +438,15 @@ static inline const char* _literal(parser_state_t* state, const char* data, cons
 
 	const char* to_match = si->param.liter.str;
 
+	/* If the entire literal is in the buffer, match it at once. When it doesn't match, we still use
+	 * the loop below to locate the failure position */
+	if(internal->sub_state == 0 && (size_t)(end - data) >= si->param.liter.size &&
+	   memcmp(data, to_match, si->param.liter.size) == 0)
+	{
+		_transite_state(state, si->next);
+		return data + si->param.liter.size;
+	}
+
 	for(;data < end && to_match[internal->sub_state] != 0; data ++, internal->sub_state ++)
 		if(to_match[internal->sub_state] != data[0])
 		{
@@ -433,6 +472,13 @@ static inline const char* _literal_ci(parser_state_t* state, const char* data, c
 
 	const char* to_match = si->param.liter.str;
 
+	if(internal->sub_state == 0 && (size_t)(end - data) >= si->param.liter.size &&
+	   scan_match_ci(data, (size_t)(end - data), to_match, si->param.liter.size))
+	{
+		_transite_state(state, si->next);
+		return data + si->param.liter.size;
+	}
+
 	for(;data < end && to_match[internal->sub_state] != 0; data ++, internal->sub_state ++)
 	{
 		char ch = data[0];
@@ -457,19 +503,57 @@ static inline const char* _init(parser_state_t* state, const char* data, const c
 
 	switch(data[0])
 	{
+		case '\r':
+		case '\n':
+			/* RFC 7230 3.5: The empty lines prior to the request line should be ignored,
+			 * some clients send an extra CRLF after the body of a pipelined request */
+			return data + 1;
 		case 'G':
 			next = _STATE_METHOD_GET;
 			state->method = PARSER_METHOD_GET;
 			break;
 		case 'P':
-			/* TODO: We also needs to handle PUT method later */
-			next = _STATE_METHOD_POST;
-			state->method = PARSER_METHOD_POST;
+			/* POST, PUT and PATCH share the same leading char */
+			next = _STATE_METHOD_P;
 			break;
 		case 'H':
 			next = _STATE_METHOD_HEAD;
 			state->method = PARSER_METHOD_HEAD;
 			break;
+		case 'D':
+			next = _STATE_METHOD_DELETE;
+			state->method = PARSER_METHOD_DELETE;
+			break;
+		case 'O':
+			next = _STATE_METHOD_OPTIONS;
+			state->method = PARSER_METHOD_OPTIONS;
+			break;
+	}
+
+	_transite_state(state, next);
+
+	return data + 1;
+}
+
+static inline const char* _method_p(parser_state_t* state, const char* data, const char* end)
+{
+	(void)end;
+	_state_code_t next = _STATE_ERROR;
+
+	switch(data[0])
+	{
+		case 'O':
+			next = _STATE_METHOD_POST;
+			state->method = PARSER_METHOD_POST;
+			break;
+		case 'U':
+			next = _STATE_METHOD_PUT;
+			state->method = PARSER_METHOD_PUT;
+			break;
+		case 'A':
+			next = _STATE_METHOD_PATCH;
+			state->method = PARSER_METHOD_PATCH;
+			break;
 	}
 
 	_transite_state(state, next);
@@ -481,7 +565,8 @@ static inline const char* _uri(parser_state_t* state, const char* data, const ch
 {
 	(void)end;
 
-	if(data[0] == '/')
+	/* The asterisk-form is only valid for OPTIONS, and it's treated as a path */
+	if(data[0] == '/' || (data[0] == '*' && state->method == PARSER_METHOD_OPTIONS))
 		_transite_state(state, _STATE_URI_PATH);
 	else if(data[0] == 'h')
 		_transite_state(state, _STATE_URI_SCHEME);
@@ -700,6 +785,9 @@ static inline size_t _parse_next_buf(parser_state_t* state, const char* data, si
 				case _STATE_INIT:
 					ret = _init(state, data, end);
 					break;
+				case _STATE_METHOD_P:
+					ret = _method_p(state, data, end);
+					break;
 				case _STATE_URI:
 					ret = _uri(state, data, end);
 					break;
@@ -794,7 +882,9 @@ size_t parser_process_next_buf(parser_state_t* state, const void* buf, size_t sz
 
 	_state_t* internal = (_state_t*)state->internal_state;
 
-	state->empty = 0;
+	/* If we only see the empty lines before the request line, there's still no request */
+	if(internal->code != _STATE_INIT)
+		state->empty = 0;
 
 	if((internal->code & _STATE_CODE_MASK) == _STATE_ERROR)
 	{
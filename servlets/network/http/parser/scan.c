@@ -0,0 +1,151 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pservlet.h>
+
+#include <scan.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#	define _SCAN_X86
+#	include <immintrin.h>
+#endif
+
+/**
+ * @brief The scalar implementation of the char set search
+ * @param begin The begining of the buffer
+ * @param end The end of the buffer
+ * @param set The char set
+ * @return The first char in the set or end
+ **/
+static const char* _find_any_scalar(const char* begin, const char* end, const scan_set_t* set)
+{
+	for(;begin < end && !set->table[(uint8_t)begin[0]]; begin ++);
+	return begin;
+}
+
+#ifdef _SCAN_X86
+/**
+ * @brief The SSE4.2 implementation, which uses the string compare instruction to match
+ *        16 bytes against the entire char set at once
+ * @param begin The begining of the buffer
+ * @param end The end of the buffer
+ * @param set The char set
+ * @return The first char in the set or end
+ **/
+__attribute__((target("sse4.2")))
+static const char* _find_any_sse42(const char* begin, const char* end, const scan_set_t* set)
+{
+	__m128i chars = _mm_loadu_si128((const __m128i*)set->chars);
+	int nchars = (int)set->size;
+
+	for(;end - begin >= 16; begin += 16)
+	{
+		__m128i data = _mm_loadu_si128((const __m128i*)begin);
+		int idx = _mm_cmpestri(chars, nchars, data, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+		if(idx < 16)
+			return begin + idx;
+	}
+
+	return _find_any_scalar(begin, end, set);
+}
+
+/**
+ * @brief The AVX2 implementation, which compares 32 bytes with each char in the set
+ * @param begin The begining of the buffer
+ * @param end The end of the buffer
+ * @param set The char set
+ * @return The first char in the set or end
+ **/
+__attribute__((target("avx2")))
+static const char* _find_any_avx2(const char* begin, const char* end, const scan_set_t* set)
+{
+	__m256i chars[SCAN_SET_MAX];
+	uint32_t i;
+
+	for(i = 0; i < set->size; i ++)
+		chars[i] = _mm256_set1_epi8(set->chars[i]);
+
+	for(;end - begin >= 32; begin += 32)
+	{
+		__m256i data = _mm256_loadu_si256((const __m256i*)begin);
+		__m256i match = _mm256_cmpeq_epi8(data, chars[0]);
+		for(i = 1; i < set->size; i ++)
+			match = _mm256_or_si256(match, _mm256_cmpeq_epi8(data, chars[i]));
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(match);
+		if(mask != 0)
+			return begin + __builtin_ctz(mask);
+	}
+
+	return _find_any_scalar(begin, end, set);
+}
+#endif /* _SCAN_X86 */
+
+/**
+ * @brief The char set search implementation we are currently using
+ **/
+static const char* (*_find_any)(const char*, const char*, const scan_set_t*) = _find_any_scalar;
+
+/**
+ * @brief The name of the implementation
+ **/
+static const char* _impl_name = "scalar";
+
+int scan_init(void)
+{
+#ifdef _SCAN_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+	{
+		_find_any = _find_any_avx2;
+		_impl_name = "avx2";
+	}
+	else if(__builtin_cpu_supports("sse4.2"))
+	{
+		_find_any = _find_any_sse42;
+		_impl_name = "sse4.2";
+	}
+#endif /* _SCAN_X86 */
+	return 0;
+}
+
+const char* scan_impl_name(void)
+{
+	return _impl_name;
+}
+
+const char* scan_find_any(const char* begin, const char* end, const scan_set_t* set)
+{
+	return _find_any(begin, end, set);
+}
+
+int scan_match_ci(const char* data, size_t avail, const char* lit, size_t size)
+{
+#ifdef _SCAN_X86
+	/* SSE2 is always available when SSE4.2 or AVX2 is, and is part of the x86_64 baseline */
+	if(avail >= 16 && _find_any != _find_any_scalar)
+	{
+		__m128i text = _mm_loadu_si128((const __m128i*)data);
+		__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(text, _mm_set1_epi8('A' - 1)),
+		                              _mm_cmplt_epi8(text, _mm_set1_epi8('Z' + 1)));
+		text = _mm_add_epi8(text, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(text, _mm_loadu_si128((const __m128i*)lit)));
+		uint32_t expected = (1u << size) - 1;
+		return (mask & expected) == expected;
+	}
+#endif /* _SCAN_X86 */
+	size_t i;
+	(void)avail;
+	for(i = 0; i < size; i ++)
+	{
+		char ch = data[i];
+		if(ch >= 'A' && ch <= 'Z')
+			ch |= 0x20;
+		if(ch != lit[i])
+			return 0;
+	}
+	return 1;
+}
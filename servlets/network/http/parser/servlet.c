@@ -16,6 +16,7 @@
 #include <routing.h>
 #include <options.h>
 #include <parser.h>
+#include <scan.h>
 
 #define _TYPE_ROOT "plumber/std_servlet/network/http/parser/v0/"
 
@@ -31,8 +32,12 @@ typedef struct {
 	pstd_type_accessor_t a_error;                /*!< THe protocol error bits */
 
 	uint32_t           METHOD_GET;      /*!< The method code for GET */
-	uint32_t           METHOD_POST;     /*!< The method code for GET */
-	uint32_t           METHOD_HEAD;     /*!< The method code for GET */
+	uint32_t           METHOD_POST;     /*!< The method code for POST */
+	uint32_t           METHOD_HEAD;     /*!< The method code for HEAD */
+	uint32_t           METHOD_PUT;      /*!< The method code for PUT */
+	uint32_t           METHOD_DELETE;   /*!< The method code for DELETE */
+	uint32_t           METHOD_PATCH;    /*!< The method code for PATCH */
+	uint32_t           METHOD_OPTIONS;  /*!< The method code for OPTIONS */
 
 	uint64_t           RANGE_SEEK_SET;  /*!< The constant used to represent the head of the file */
 	uint64_t           RANGE_SEEK_END;  /*!< THe constant used to represent the tail of the file */
@@ -71,18 +76,30 @@ static inline int _read_const_unsigned(const char* field, void* result, size_t s
 static int _init(uint32_t argc, char const* const* argv, void* ctxmem)
 {
 	uint32_t i;
-	static char const * const const_names[] = {"METHOD_GET", "METHOD_POST", "METHOD_HEAD", "SEEK_SET", "SEEK_END"};
-	static size_t const const_sizes[] = {sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t), sizeof(uint64_t), sizeof(uint64_t)};
+	static char const * const const_names[] = {
+		"METHOD_GET", "METHOD_POST", "METHOD_HEAD", "METHOD_PUT", "METHOD_DELETE", "METHOD_PATCH", "METHOD_OPTIONS",
+		"SEEK_SET", "SEEK_END"
+	};
+	static size_t const const_sizes[] = {
+		sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t),
+		sizeof(uint64_t), sizeof(uint64_t)
+	};
 
 	ctx_t* ctx = (ctx_t*)ctxmem;
 
-	void* const_bufs[] = {&ctx->METHOD_GET, &ctx->METHOD_POST, &ctx->METHOD_HEAD, &ctx->RANGE_SEEK_SET, &ctx->RANGE_SEEK_END};
+	void* const_bufs[] = {
+		&ctx->METHOD_GET, &ctx->METHOD_POST, &ctx->METHOD_HEAD, &ctx->METHOD_PUT, &ctx->METHOD_DELETE, &ctx->METHOD_PATCH, &ctx->METHOD_OPTIONS,
+		&ctx->RANGE_SEEK_SET, &ctx->RANGE_SEEK_END
+	};
 
 	memset(ctx, 0, sizeof(ctx_t));
 
 	if(ERROR_CODE(int) == options_parse(argc, argv, &ctx->options))
 		ERROR_RETURN_LOG(int, "Cannot parse the options");
 
+	if(ERROR_CODE(int) == scan_init())
+		ERROR_RETURN_LOG(int, "Cannot initialize the request scanner");
+
 	if(ERROR_CODE(pipe_t) == (ctx->p_input = pipe_define("input", PIPE_INPUT, NULL)))
 		ERROR_RETURN_LOG(int, "Cannot define the input pipe");
 
@@ -109,7 +126,7 @@ static int _init(uint32_t argc, char const* const* argv, void* ctxmem)
 
 	for(i = 0; i < sizeof(const_sizes) / sizeof(const_sizes[0]); i ++)
 		if(_read_const_unsigned(const_names[i], const_bufs[i], const_sizes[i]) == ERROR_CODE(int))
-			ERROR_LOG_GOTO(ERR, "Cannot read constant for GET method");
+			ERROR_LOG_GOTO(ERR, "Cannot read constant %s", const_names[i]);
 
 	int rc = ERROR_CODE(int);
 
@@ -228,7 +245,7 @@ static int _exec(void* ctxmem)
 		if(rc == 0)
 		{
 			buffer = _buffer;
-			if(ERROR_CODE(size_t) == (sz = pipe_read(ctx->p_input, buffer, sizeof(buffer))))
+			if(ERROR_CODE(size_t) == (sz = pipe_read(ctx->p_input, buffer, sizeof(_buffer))))
 				ERROR_LOG_GOTO(ERR, "Cannot read request data from pipe");
 		}
 
@@ -329,6 +346,18 @@ PARSER_DONE:
 		case PARSER_METHOD_HEAD:
 			method_code = ctx->METHOD_HEAD;
 			break;
+		case PARSER_METHOD_PUT:
+			method_code = ctx->METHOD_PUT;
+			break;
+		case PARSER_METHOD_DELETE:
+			method_code = ctx->METHOD_DELETE;
+			break;
+		case PARSER_METHOD_PATCH:
+			method_code = ctx->METHOD_PATCH;
+			break;
+		case PARSER_METHOD_OPTIONS:
+			method_code = ctx->METHOD_OPTIONS;
+			break;
 		default:
 			ERROR_LOG_GOTO(ERR, "Code bug: Invalid method");
 	}
@@ -352,7 +381,7 @@ PARSER_DONE:
 		if(strncmp(modpath, tcp_prefix, sizeof(tcp_prefix) - 1) == 0)
 		{
 			/* If we got a plain HTTP requeset */
-			pstd_string_t* target_obj = pstd_string_new(32);
+			pstd_string_t* target_obj = pstd_string_new_scoped(32);
 			if(NULL == target_obj)
 				ERROR_LOG_GOTO(ERR, "Cannot create target URL object");
 
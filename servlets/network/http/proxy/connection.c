@@ -4,9 +4,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <errno.h>
+#include <stdio.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/prctl.h>
+#include <netdb.h>
 #include <pthread.h>
 
 #include <utils/hash/murmurhash3.h>
@@ -14,6 +22,30 @@
 #include <pstd.h>
 #include <connection.h>
 
+/**
+ * @brief The maximum number of shards of the connection pool
+ **/
+#define _MAX_SHARDS 32
+
+/**
+ * @brief The maximum number of FDs the health check thread can monitor
+ **/
+#define _MAX_MONITORED_FD (1u << 20)
+
+/**
+ * @brief The FD state flag indicates the peer has closed the connection
+ **/
+#define _FD_STATE_HUP 1u
+
+/**
+ * @brief The FD state flag indicates the FD is being monitored by the health check thread
+ **/
+#define _FD_STATE_MONITORED 2u
+
+/**
+ * @brief The epoll data we use for the event FD that wakes up the health check thread
+ **/
+#define _EVENT_FD_DATA ((uint64_t)-1)
 
 /**
  * @brief The node in the hash table that is used to describe the peer
@@ -32,50 +64,324 @@ typedef struct _conn_t{
 	int             fd;          /*!< The FD for this socket */
 } _conn_t;
 
+/**
+ * @brief The unused connections to a peer that belongs to a shard
+ **/
+typedef struct {
+	uint32_t            count;       /*!< The numer of connections in the list */
+	_conn_t*            conn_list;   /*!< The connection list */
+} _peer_shard_t;
+
 /**
  * @brief The actual data structure used to keep tracking the data of a peer
+ * @note Once the peer node is added to the hash table, it won't be removed until the pool is finalized,
+ *       thus we can look up the peer table without holding any lock
  **/
 struct _peer_t {
-	uint32_t            count;       /*!< The numer of connections in the list */
 	uint32_t            port;        /*!< The port id */
 	char*               domain_name; /*!< The domain of the peer */
 	uint64_t            hash[2];     /*!< The 128 bit hash code */
-	_conn_t*            conn_list;   /*!< The connection list */
 	struct _peer_t*     peer_next;   /*!< The next node in the hash table */
+	uint32_t            num_addrs;   /*!< The number of resolved addresses, 0 means not resolved */
+	time_t              addr_expire; /*!< When the resolved addresses expire */
+	connection_addr_t   addrs[CONNECTION_POOL_MAX_ADDRS];  /*!< The resolved addresses */
+	struct {
+		uint64_t        hits;          /*!< How many checkouts returned a pooled connection */
+		uint64_t        misses;        /*!< How many checkouts need a new connection */
+		uint64_t        evictions;     /*!< How many idle connections are closed because the pool is full */
+		uint64_t        stale;         /*!< How many idle connections are closed by the peer */
+		uint64_t        connects;      /*!< How many new connections have been established */
+		uint64_t        connect_fails; /*!< How many times we failed to establish a connection */
+		uint64_t        connect_us;    /*!< The total amount of time spent on establishing connections in microseconds */
+	}                   stat;        /*!< The statistics of this peer, updated with atomic operations */
+	_peer_shard_t       shards[];    /*!< The unused connection list in each shard */
 };
 
 /**
- * @brief The data for the pool structure
+ * @brief A shard of the connection pool
  **/
-static struct {
-	uint32_t             num_conn;     /*!< The number of connections in the pool */
+typedef struct {
+	pthread_mutex_t      mutex;        /*!< The shard mutex */
+	uint32_t             num_conn;     /*!< The number of connections in the shard */
 	_conn_t*             lru_begin;    /*!< The least recently used list */
 	_conn_t*             lru_end;      /*!< The last item in LRU list */
+} _shard_t;
+
+/**
+ * @brief The data for the pool structure
+ **/
+static struct {
 	_peer_t**            table;        /*!< The hash table used for the peer */
 	uint32_t             init_count;   /*!< How many servlets are using the connection pool */
 	uint32_t             pool_size;    /*!< The connection pool size */
 	uint32_t             peer_limit;   /*!< How many connection for the same peer */
 	uint32_t             hash_size;    /*!< The number of slots in the hash table */
-	pthread_mutex_t      mutex;        /*!< The global connection pool mutex */
+	uint32_t             dns_ttl;      /*!< How many seconds the resolved address is valid */
+	uint32_t             stat_interval;/*!< How many seconds between two statistics dumps */
+	pthread_mutex_t      mutex;        /*!< The mutex that protects the peer table insertion and the address cache */
+	uint32_t             num_shards;   /*!< The number of shards */
+	uint32_t             next_shard;   /*!< The shard id that will be assigned to the next thread */
+	_shard_t*            shards;       /*!< The shard list */
+	int                  epoll_fd;     /*!< The epoll FD used by the health check thread */
+	int                  event_fd;     /*!< The event FD used to wake up the health check thread */
+	volatile uint32_t    killed;       /*!< Indicates the health check thread should exit */
+	pthread_t            health_thread;/*!< The health check thread */
+	uint32_t*            fd_state;     /*!< The monitor state of each FD, bit 0 is the hup flag, bit 1 is the monitored flag and the rest is the generation */
+	uint32_t             fd_state_size;/*!< The size of the FD state array, 0 if the health check thread is not running */
+	uint32_t             fd_gen;       /*!< The generation counter used to distinguish the reused FD number */
 } _pool;
 
+/**
+ * @brief The shard id (plus 1) owned by current thread, 0 if not assigned yet
+ **/
+static __thread uint32_t _thread_shard = 0;
+
 static inline uint32_t _get_hash_size(void)
 {
 	/* TODO: make this configurable */
 	return 4073;
 }
 
-int connection_pool_init(uint32_t size, uint32_t peer_pool_size)
+static inline uint32_t _get_num_shards(void)
+{
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if(ncpu < 1) return 1;
+	if(ncpu > _MAX_SHARDS) return _MAX_SHARDS;
+
+	return (uint32_t)ncpu;
+}
+
+/**
+ * @brief Get how much resource a single shard can hold
+ * @param limit The limit of the entire pool
+ * @return The limit for the shard
+ **/
+static inline uint32_t _shard_limit(uint32_t limit)
+{
+	uint32_t ret = (limit + _pool.num_shards - 1) / _pool.num_shards;
+	return ret > 0 ? ret : 1;
+}
+
+static inline void _stat_dump(void)
+{
+	uint32_t i;
+	for(i = 0; i < _pool.hash_size; i ++)
+	{
+		const _peer_t* peer;
+		for(peer = __atomic_load_n(_pool.table + i, __ATOMIC_ACQUIRE); peer != NULL; peer = peer->peer_next)
+		{
+			uint64_t hits          = __atomic_load_n(&peer->stat.hits, __ATOMIC_RELAXED);
+			uint64_t misses        = __atomic_load_n(&peer->stat.misses, __ATOMIC_RELAXED);
+			uint64_t connects      = __atomic_load_n(&peer->stat.connects, __ATOMIC_RELAXED);
+			uint64_t connect_fails = __atomic_load_n(&peer->stat.connect_fails, __ATOMIC_RELAXED);
+
+			if(hits + misses + connects + connect_fails == 0) continue;
+
+			LOG_NOTICE("Peer %s:%u: hits = %"PRIu64", misses = %"PRIu64", evictions = %"PRIu64", stale = %"PRIu64", "
+			           "connects = %"PRIu64", connect failures = %"PRIu64", average connect latency = %"PRIu64"us",
+			           peer->domain_name, peer->port, hits, misses,
+			           __atomic_load_n(&peer->stat.evictions, __ATOMIC_RELAXED),
+			           __atomic_load_n(&peer->stat.stale, __ATOMIC_RELAXED),
+			           connects, connect_fails,
+			           connects > 0 ? __atomic_load_n(&peer->stat.connect_us, __ATOMIC_RELAXED) / connects : 0);
+		}
+	}
+}
+
+/**
+ * @brief Mark the FD has been closed by the peer
+ * @param fd The FD
+ * @param gen The generation of the FD when it's added to the epoll list
+ * @return nothing
+ **/
+static inline void _fd_hup(uint32_t fd, uint32_t gen)
+{
+	if(fd >= _pool.fd_state_size) return;
+
+	uint32_t state = __atomic_load_n(_pool.fd_state + fd, __ATOMIC_ACQUIRE);
+
+	/* If the FD has been closed and the FD number is reused, the generation won't match */
+	if(!(state & _FD_STATE_MONITORED) || (state >> 2) != gen) return;
+
+	__atomic_compare_exchange_n(_pool.fd_state + fd, &state, state | _FD_STATE_HUP, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief The health check thread main function
+ * @details The thread waits for the peer closing the connection. Instead of validating the connection
+ *          when it's checked out, the health check thread marks the connection that has been closed by the
+ *          peer, so that the checkout doesn't need any system call.
+ *          The thread also dumps the peer statistics periodically.
+ * @param data Not used
+ * @return nothing
+ **/
+static void* _health_main(void* data)
 {
+	(void)data;
+#ifdef __LINUX__
+	prctl(PR_SET_NAME, "PlumbProxyHC", 0, 0, 0);
+#endif
+
+	time_t next_dump = 0;
+
+	LOG_NOTICE("Connection pool health check thread is started");
+
+	while(!_pool.killed)
+	{
+		int timeout = -1;
+
+		if(_pool.stat_interval > 0)
+		{
+			time_t now = time(NULL);
+
+			if(next_dump == 0)
+				next_dump = now + (time_t)_pool.stat_interval;
+			else if(now >= next_dump)
+			{
+				_stat_dump();
+				next_dump = now + (time_t)_pool.stat_interval;
+			}
+
+			timeout = (int)(next_dump - now) * 1000;
+		}
+
+		struct epoll_event events[128];
+
+		int rc = epoll_wait(_pool.epoll_fd, events, sizeof(events) / sizeof(events[0]), timeout);
+
+		if(rc < 0)
+		{
+			if(errno != EINTR)
+				LOG_WARNING_ERRNO("Cannot wait for the idle connection events");
+			continue;
+		}
+
+		int i;
+		for(i = 0; i < rc; i ++)
+		{
+			if(events[i].data.u64 == _EVENT_FD_DATA)
+			{
+				uint64_t val;
+				if(read(_pool.event_fd, &val, sizeof(val)) < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+					LOG_WARNING_ERRNO("Cannot read the event FD");
+				continue;
+			}
+
+			/* We only ask for the RDHUP event, any event reported means the connection is gone */
+			_fd_hup((uint32_t)events[i].data.u64, (uint32_t)(events[i].data.u64 >> 32));
+		}
+	}
+
+	LOG_NOTICE("Connection pool health check thread is terminated");
+
+	return NULL;
+}
+
+static inline int _health_start(void)
+{
+	struct rlimit lim;
+
+	_pool.epoll_fd = -1;
+	_pool.event_fd = -1;
+	_pool.fd_state = NULL;
+	_pool.fd_state_size = 0;
+	_pool.killed = 0;
+
+	if(getrlimit(RLIMIT_NOFILE, &lim) < 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot get the FD limit");
+
+	uint32_t size = (lim.rlim_cur == RLIM_INFINITY || lim.rlim_cur > _MAX_MONITORED_FD) ? _MAX_MONITORED_FD : (uint32_t)lim.rlim_cur;
+
+	if(NULL == (_pool.fd_state = (uint32_t*)calloc(size, sizeof(uint32_t))))
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the FD state array");
+
+	if((_pool.epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot create the epoll FD");
+
+	if((_pool.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot create the event FD");
+
+	struct epoll_event event = {
+		.events = EPOLLIN,
+		.data   = {
+			.u64 = _EVENT_FD_DATA
+		}
+	};
+
+	if(epoll_ctl(_pool.epoll_fd, EPOLL_CTL_ADD, _pool.event_fd, &event) < 0)
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot add the event FD to the epoll list");
+
+	if((errno = pthread_create(&_pool.health_thread, NULL, _health_main, NULL)) != 0)
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot start the health check thread");
+
+	_pool.fd_state_size = size;
+
+	return 0;
+ERR:
+	if(_pool.event_fd >= 0) close(_pool.event_fd);
+	if(_pool.epoll_fd >= 0) close(_pool.epoll_fd);
+	if(NULL != _pool.fd_state) free(_pool.fd_state);
+	_pool.event_fd = -1;
+	_pool.epoll_fd = -1;
+	_pool.fd_state = NULL;
+	return ERROR_CODE(int);
+}
+
+static inline int _health_stop(void)
+{
+	int rc = 0;
+
+	if(_pool.fd_state_size == 0) return 0;
+
+	_pool.killed = 1;
+
+	uint64_t val = 1;
+	if(write(_pool.event_fd, &val, sizeof(val)) != sizeof(val))
+	{
+		LOG_ERROR_ERRNO("Cannot notify the health check thread");
+		rc = ERROR_CODE(int);
+	}
+	else if((errno = pthread_join(_pool.health_thread, NULL)) != 0)
+	{
+		LOG_ERROR_ERRNO("Cannot join the health check thread");
+		rc = ERROR_CODE(int);
+	}
+
+	if(close(_pool.event_fd) < 0 || close(_pool.epoll_fd) < 0)
+	{
+		LOG_ERROR_ERRNO("Cannot close the health check FD");
+		rc = ERROR_CODE(int);
+	}
+
+	free(_pool.fd_state);
+	_pool.fd_state = NULL;
+	_pool.fd_state_size = 0;
+
+	return rc;
+}
+
+int connection_pool_init(uint32_t size, uint32_t peer_pool_size, uint32_t dns_ttl, uint32_t stat_interval)
+{
+	if(_pool.dns_ttl < dns_ttl)
+		_pool.dns_ttl = dns_ttl;
+
 	if(_pool.pool_size < size)
 		_pool.pool_size = size;
 
 	if(_pool.peer_limit < peer_pool_size)
 		_pool.peer_limit = peer_pool_size;
 
+	if(_pool.stat_interval < stat_interval)
+		_pool.stat_interval = stat_interval;
+
 	if(_pool.init_count == 0)
 	{
+		uint32_t i;
+
 		_pool.hash_size = _get_hash_size();
+		_pool.num_shards = _get_num_shards();
+		_pool.shards = NULL;
 
 		if(NULL == (_pool.table = (_peer_t**)calloc(sizeof(_peer_t*), _pool.hash_size)))
 			ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the hash table");
@@ -83,7 +389,26 @@ int connection_pool_init(uint32_t size, uint32_t peer_pool_size)
 		if((errno = pthread_mutex_init(&_pool.mutex, NULL)) != 0)
 			ERROR_LOG_ERRNO_GOTO(ERR, "Cannot initialize the conneciton pool mutex");
 
+		if(NULL == (_pool.shards = (_shard_t*)calloc(sizeof(_shard_t), _pool.num_shards)))
+			ERROR_LOG_ERRNO_GOTO(SHARD_ERR, "Cannot allocate memory for the shards");
+
+		for(i = 0; i < _pool.num_shards; i ++)
+			if((errno = pthread_mutex_init(&_pool.shards[i].mutex, NULL)) != 0)
+				ERROR_LOG_ERRNO_GOTO(SHARD_ERR, "Cannot initialize the shard mutex");
+
+		if(ERROR_CODE(int) == _health_start())
+			LOG_WARNING("Cannot start the health check thread, validate the idle connection on checkout instead");
+
 		goto INIT_DONE;
+SHARD_ERR:
+		if(NULL != _pool.shards)
+		{
+			uint32_t j;
+			for(j = 0; j < i; j ++)
+				pthread_mutex_destroy(&_pool.shards[j].mutex);
+			free(_pool.shards);
+		}
+		pthread_mutex_destroy(&_pool.mutex);
 ERR:
 		if(NULL != _pool.table) free(_pool.table);
 		return ERROR_CODE(int);
@@ -102,29 +427,45 @@ int connection_pool_finalize(void)
 
 	if(0 == --_pool.init_count)
 	{
-		_conn_t* ptr;
+		uint32_t i;
 
-		for(ptr = _pool.lru_begin; ptr != NULL;)
-		{
-			_conn_t* this = ptr;
-			ptr = ptr->lru_next;
+		if(ERROR_CODE(int) == _health_stop())
+			rc = ERROR_CODE(int);
 
-			if(this->fd >= 0 && close(this->fd) < 0)
+		for(i = 0; i < _pool.num_shards; i ++)
+		{
+			_conn_t* ptr;
+			for(ptr = _pool.shards[i].lru_begin; ptr != NULL;)
 			{
-				LOG_ERROR_ERRNO("Cannot close the FD %d", this->fd);
-				rc = ERROR_CODE(int);
+				_conn_t* this = ptr;
+				ptr = ptr->lru_next;
+
+				if(this->fd >= 0 && close(this->fd) < 0)
+				{
+					LOG_ERROR_ERRNO("Cannot close the FD %d", this->fd);
+					rc = ERROR_CODE(int);
+				}
+
+				if(ERROR_CODE(int) == pstd_mempool_free(this))
+				{
+					LOG_ERROR("Cannot dispose the peer object");
+					rc = ERROR_CODE(int);
+				}
 			}
 
-			if(ERROR_CODE(int) == pstd_mempool_free(this))
+			if((errno = pthread_mutex_destroy(&_pool.shards[i].mutex)) != 0)
 			{
-				LOG_ERROR("Cannot dispose the peer object");
+				LOG_ERROR_ERRNO("Cannot destroy the shard mutex");
 				rc = ERROR_CODE(int);
 			}
 		}
 
+		free(_pool.shards);
+
 		if(NULL != _pool.table)
 		{
-			uint32_t i;
+			_stat_dump();
+
 			for(i = 0; i < _pool.hash_size; i ++)
 			{
 				_peer_t* p_ptr;
@@ -152,26 +493,36 @@ int connection_pool_finalize(void)
 	return rc;
 }
 
-static inline void _lru_remove(_conn_t* conn)
+uint32_t connection_pool_shard(void)
+{
+	if(_thread_shard == 0)
+		_thread_shard = __sync_fetch_and_add(&_pool.next_shard, 1) % _pool.num_shards + 1;
+
+	return (_thread_shard - 1) % _pool.num_shards;
+}
+
+static inline void _lru_remove(_shard_t* shard, _conn_t* conn)
 {
 	if(conn->lru_prev == NULL)
-		_pool.lru_begin = conn->lru_next;
+		shard->lru_begin = conn->lru_next;
 	else
 		conn->lru_prev->lru_next = conn->lru_next;
 
 	if(conn->lru_next == NULL)
-		_pool.lru_end = conn->lru_prev;
+		shard->lru_end = conn->lru_prev;
 	else
 		conn->lru_next->lru_prev = conn->lru_prev;
 }
 
-static inline void _lru_add(_conn_t* conn)
+static inline void _lru_add(_shard_t* shard, _conn_t* conn)
 {
-	conn->lru_next = _pool.lru_begin;
+	conn->lru_next = shard->lru_begin;
 	conn->lru_prev = NULL;
-	_pool.lru_begin = conn;
-	if(_pool.lru_end == NULL)
-		_pool.lru_end = conn;
+	if(shard->lru_begin != NULL)
+		shard->lru_begin->lru_prev = conn;
+	shard->lru_begin = conn;
+	if(shard->lru_end == NULL)
+		shard->lru_end = conn;
 }
 
 static inline void _hash(uint32_t port, const char* domain_name, size_t domain_len, uint64_t* out)
@@ -204,22 +555,57 @@ static inline int _peer_match(const _peer_t* peer, uint32_t port, const char* do
 	return 1;
 }
 
-static inline void _release_connection(_conn_t* conn)
+/**
+ * @brief Check if the idle connection is still usable
+ * @param fd The socket FD
+ * @return The check result
+ **/
+static inline int _conn_alive(int fd)
 {
-	_lru_remove(conn);
+	if((uint32_t)fd < _pool.fd_state_size)
+	{
+		uint32_t state = __atomic_load_n(_pool.fd_state + fd, __ATOMIC_ACQUIRE);
+		if(state & _FD_STATE_MONITORED)
+			return !(state & _FD_STATE_HUP);
+	}
+
+	/* The FD is not monitored by the health check thread, so we need to peek the socket */
+	char c;
+	ssize_t sz = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+
+	if((sz < 0 && errno != EWOULDBLOCK && errno != EAGAIN) || sz == 0)
+	{
+		if(sz < 0)
+			LOG_DEBUG_ERRNO("The socket fd returns an unexpected FD, closing it and establish a new one");
+		else
+			LOG_DEBUG("The socket is in half-closed state, get rid of that one");
+		return 0;
+	}
+
+	return 1;
+}
+
+static inline void _release_connection(uint32_t shard_id, _conn_t* conn)
+{
+	_shard_t* shard = _pool.shards + shard_id;
+
+	_lru_remove(shard, conn);
 
 	_peer_t* peer = conn->peer;
+	_peer_shard_t* ps = peer->shards + shard_id;
 
 	if(conn->conn_prev == NULL)
-		peer->conn_list = conn->conn_next;
+		ps->conn_list = conn->conn_next;
 	else
 		conn->conn_prev->conn_next = conn->conn_next;
 
 	if(conn->conn_next != NULL)
 		conn->conn_next->conn_prev = conn->conn_prev;
 
-	peer->count --;
-	_pool.num_conn --;
+	ps->count --;
+	shard->num_conn --;
+
+	__atomic_fetch_add(&peer->stat.evictions, 1, __ATOMIC_RELAXED);
 
 	if(close(conn->fd) < 0)
 		LOG_WARNING_ERRNO("Cannot close the FD %d", conn->fd);
@@ -228,22 +614,29 @@ static inline void _release_connection(_conn_t* conn)
 		LOG_WARNING_ERRNO("Cannot dispose the connection object");
 }
 
-static inline int _conn_add(uint32_t port, const char* domain_name, size_t domain_len, int fd)
+/**
+ * @brief Find the peer node in the hash table
+ * @note If the peer doesn't exist and create is set, a new peer node will be added to the hash table, in this case
+ *       the caller should hold the pool mutex. Looking up the table doesn't require any lock.
+ * @return The peer node or NULL if it's not found (or cannot be created)
+ **/
+static inline _peer_t* _peer_get(uint32_t port, const char* domain_name, size_t domain_len, int create)
 {
 	uint64_t hash[2];
 	_hash(port, domain_name, domain_len, hash);
 	uint32_t slot = _hash_slot(hash, _pool.hash_size);
 
 	_peer_t* peer;
-	_conn_t* conn;
 
-	for(peer = _pool.table[slot]; NULL != peer && !_peer_match(peer, port, domain_name, domain_len, hash) ; peer = peer->peer_next);
+	for(peer = __atomic_load_n(_pool.table + slot, __ATOMIC_ACQUIRE); NULL != peer && !_peer_match(peer, port, domain_name, domain_len, hash) ; peer = peer->peer_next);
 
-	if(peer == NULL)
+	if(peer == NULL && create)
 	{
-		if(NULL == (peer = pstd_mempool_alloc(sizeof(_peer_t))))
-			ERROR_RETURN_LOG(int, "Cannot allocate memory for the peer node");
-		peer->count = 0;
+		size_t size = sizeof(_peer_t) + sizeof(_peer_shard_t) * _pool.num_shards;
+		if(NULL == (peer = pstd_mempool_alloc((uint32_t)size)))
+			ERROR_PTR_RETURN_LOG("Cannot allocate memory for the peer node");
+
+		memset(peer, 0, size);
 
 		peer->port = port;
 		if(NULL == (peer->domain_name = malloc(domain_len + 1)))
@@ -254,24 +647,60 @@ static inline int _conn_add(uint32_t port, const char* domain_name, size_t domai
 		peer->hash[0] = hash[0];
 		peer->hash[1] = hash[1];
 
-		peer->conn_list = NULL;
-
 		peer->peer_next = _pool.table[slot];
-		_pool.table[slot] = peer;
-		goto ADD_CONN;
+
+		/* Publish the peer node only after it has been fully initialized, because the reader doesn't hold the lock */
+		__atomic_store_n(_pool.table + slot, peer, __ATOMIC_RELEASE);
+		return peer;
 ALLOC_ERR:
 		pstd_mempool_free(peer);
-		return ERROR_CODE(int);
+		return NULL;
 	}
-ADD_CONN:
+
+	return peer;
+}
+
+/**
+ * @brief Get the peer node, create a new one if it doesn't exist
+ * @return The peer node or NULL on error
+ **/
+static inline _peer_t* _peer_acquire(uint32_t port, const char* domain_name, size_t domain_len)
+{
+	_peer_t* ret = _peer_get(port, domain_name, domain_len, 0);
+
+	if(NULL != ret) return ret;
+
+	if((errno = pthread_mutex_lock(&_pool.mutex)) != 0)
+		ERROR_PTR_RETURN_LOG_ERRNO("Cannot lock the connection pool mutex");
+
+	ret = _peer_get(port, domain_name, domain_len, 1);
+
+	if((errno = pthread_mutex_unlock(&_pool.mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot release the connection pool mutex");
+
+	return ret;
+}
+
+/**
+ * @brief Add the connection to the shard
+ * @note This function assumes the caller has already got the shard mutex
+ * @return status code
+ **/
+static inline int _conn_add(uint32_t shard_id, _peer_t* peer, int fd)
+{
+	_shard_t* shard = _pool.shards + shard_id;
+	_peer_shard_t* ps = peer->shards + shard_id;
+	_conn_t* conn;
 
 	/* Step 1: We need to kickout some connections from the peer list if needed */
-	while(peer->count >= _pool.peer_limit)
-		_release_connection(peer->conn_list);
+	uint32_t peer_limit = _shard_limit(_pool.peer_limit);
+	while(ps->count >= peer_limit)
+		_release_connection(shard_id, ps->conn_list);
 
 	/* Step 2: We need to kickout the LRU list */
-	while(_pool.pool_size <= _pool.num_conn)
-		_release_connection(_pool.lru_end);
+	uint32_t pool_size = _shard_limit(_pool.pool_size);
+	while(pool_size <= shard->num_conn)
+		_release_connection(shard_id, shard->lru_end);
 
 	if(NULL == (conn = pstd_mempool_alloc(sizeof(_conn_t))))
 		ERROR_RETURN_LOG(int, "Cannot allocate memory for the new connection");
@@ -279,63 +708,101 @@ ADD_CONN:
 	conn->fd = fd;
 	conn->peer = peer;
 
-	conn->conn_next = peer->conn_list;
+	conn->conn_next = ps->conn_list;
 	conn->conn_prev = NULL;
-	peer->conn_list = conn;
+	if(ps->conn_list != NULL)
+		ps->conn_list->conn_prev = conn;
+	ps->conn_list = conn;
 
-	_lru_add(conn);
+	_lru_add(shard, conn);
 
-	peer->count ++;
-	_pool.num_conn ++;
+	ps->count ++;
+	shard->num_conn ++;
 
 	return 0;
 }
 
-static inline int _conn_get(const char* domain_name, size_t domain_len, uint32_t port)
+/**
+ * @brief Take an usable connection to the peer from the shard
+ * @note This function assumes the caller has already got the shard mutex
+ * @return The FD or -1 if there's no connection can be used
+ **/
+static inline int _conn_get(uint32_t shard_id, _peer_t* peer)
 {
-	uint64_t hash[2];
-	_hash(port, domain_name, domain_len, hash);
-	uint32_t slot = _hash_slot(hash, _pool.hash_size);
+	_shard_t* shard = _pool.shards + shard_id;
+	_peer_shard_t* ps = peer->shards + shard_id;
 
-	_peer_t* peer;
+	while(ps->conn_list != NULL)
+	{
+		_conn_t* this = ps->conn_list;
 
-	for(peer = _pool.table[slot]; NULL != peer && !_peer_match(peer, port, domain_name, domain_len, hash) ; peer = peer->peer_next);
+		ps->conn_list = this->conn_next;
 
-	if(NULL == peer || peer->conn_list == NULL)
-		return -1;
+		if(ps->conn_list != NULL)
+			ps->conn_list->conn_prev = NULL;
 
-	_conn_t* this = peer->conn_list;
+		shard->num_conn --;
+		ps->count --;
 
-	peer->conn_list = this->conn_next;
+		int ret = this->fd;
 
-	if(peer->conn_list != NULL)
-		peer->conn_list->conn_prev = NULL;
+		_lru_remove(shard, this);
 
-	_pool.num_conn --;
-	peer->count --;
+		if(ERROR_CODE(int) == pstd_mempool_free(this))
+			LOG_WARNING("Cannot dispose the connection");
 
-	int ret = this->fd;
+		if(_conn_alive(ret))
+			return ret;
 
-	_lru_remove(this);
+		__atomic_fetch_add(&peer->stat.stale, 1, __ATOMIC_RELAXED);
 
-	if(ERROR_CODE(int) == pstd_mempool_free(this))
-		LOG_WARNING("Cannot dispose the connection");
+		if(close(ret) < 0)
+			LOG_WARNING_ERRNO("Cannot close the FD %d", ret);
+	}
 
-	return ret;
+	return -1;
 }
 
-int connection_pool_checkout(const char* hostname, size_t hostname_len, uint16_t port, int* fd)
+int connection_pool_checkout(const char* hostname, size_t hostname_len, uint16_t port, uint32_t shard, int* fd)
 {
 	if(NULL == hostname || hostname_len == 0 || NULL == fd)
 		ERROR_RETURN_LOG(int, "Invalid arguments");
 
-	if((errno = pthread_mutex_lock(&_pool.mutex)) != 0)
-		ERROR_RETURN_LOG_ERRNO(int, "Cannot lock the connection pool mutex");
+	_peer_t* peer = _peer_acquire(port, hostname, hostname_len);
 
-	*fd = _conn_get(hostname, hostname_len, port);
+	if(NULL == peer)
+		ERROR_RETURN_LOG(int, "Cannot get the peer node");
 
-	if((errno = pthread_mutex_unlock(&_pool.mutex)) != 0)
-		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot unlock the connection pool mutex");
+	shard %= _pool.num_shards;
+
+	if((errno = pthread_mutex_lock(&_pool.shards[shard].mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot lock the shard mutex");
+
+	*fd = _conn_get(shard, peer);
+
+	if((errno = pthread_mutex_unlock(&_pool.shards[shard].mutex)) != 0)
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot unlock the shard mutex");
+
+	/* If our own shard doesn't have any connection, try to steal one from other shards. But we never wait for
+	 * the shard that is being used by others, since establishing a new connection is better than blocking the worker */
+	uint32_t i;
+	for(i = 1; *fd < 0 && i < _pool.num_shards; i ++)
+	{
+		uint32_t victim = (shard + i) % _pool.num_shards;
+
+		if(NULL == __atomic_load_n(&peer->shards[victim].conn_list, __ATOMIC_RELAXED))
+			continue;
+
+		if(pthread_mutex_trylock(&_pool.shards[victim].mutex) != 0)
+			continue;
+
+		*fd = _conn_get(victim, peer);
+
+		if((errno = pthread_mutex_unlock(&_pool.shards[victim].mutex)) != 0)
+			ERROR_LOG_ERRNO_GOTO(ERR, "Cannot unlock the shard mutex");
+	}
+
+	__atomic_fetch_add(*fd >= 0 ? &peer->stat.hits : &peer->stat.misses, 1, __ATOMIC_RELAXED);
 
 	return (*fd >= 0);
 ERR:
@@ -343,23 +810,218 @@ ERR:
 	return ERROR_CODE(int);
 }
 
-int connection_pool_checkin(const char* hostname, size_t hostname_len, uint16_t port, int fd)
+int connection_pool_checkin(const char* hostname, size_t hostname_len, uint16_t port, uint32_t shard, int fd)
 {
 	int rc = 0;
 	if(NULL == hostname || hostname_len == 0 || fd <= 0)
 		ERROR_RETURN_LOG(int, "Invalid arguments");
 
-	if((errno = pthread_mutex_lock(&_pool.mutex)) != 0)
-		ERROR_RETURN_LOG_ERRNO(int, "Cannot lock the connection pool mutex");
+	_peer_t* peer = _peer_acquire(port, hostname, hostname_len);
+
+	if(NULL == peer)
+		ERROR_LOG_GOTO(ERR, "Cannot get the peer node");
+
+	if(!_conn_alive(fd))
+	{
+		LOG_DEBUG("The connection has been closed by the peer, do not put it back to the pool");
+		__atomic_fetch_add(&peer->stat.stale, 1, __ATOMIC_RELAXED);
+		if(close(fd) < 0)
+			LOG_WARNING_ERRNO("Cannot close the fd");
+		return 0;
+	}
+
+	shard %= _pool.num_shards;
 
-	if(ERROR_CODE(int) == _conn_add(port, hostname, hostname_len, fd))
+	if((errno = pthread_mutex_lock(&_pool.shards[shard].mutex)) != 0)
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot lock the shard mutex");
+
+	if(ERROR_CODE(int) == _conn_add(shard, peer, fd))
 		rc = ERROR_CODE(int);
 
-	if((errno = pthread_mutex_unlock(&_pool.mutex)) != 0)
-		LOG_WARNING_ERRNO("Cannot relaese the pool mutex");
+	if((errno = pthread_mutex_unlock(&_pool.shards[shard].mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot relaese the shard mutex");
 
 	if(ERROR_CODE(int) == rc && fd >= 0 && close(fd) < 0)
 		LOG_WARNING_ERRNO("Cannot close the fd");
 
 	return rc;
+ERR:
+	if(close(fd) < 0)
+		LOG_WARNING_ERRNO("Cannot close the fd");
+	return ERROR_CODE(int);
+}
+
+int connection_pool_report_connect(const char* hostname, size_t hostname_len, uint16_t port, int fd, uint64_t latency_us)
+{
+	if(NULL == hostname || hostname_len == 0)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	_peer_t* peer = _peer_acquire(port, hostname, hostname_len);
+
+	if(NULL == peer)
+		ERROR_RETURN_LOG(int, "Cannot get the peer node");
+
+	if(fd < 0)
+	{
+		__atomic_fetch_add(&peer->stat.connect_fails, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+
+	__atomic_fetch_add(&peer->stat.connects, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&peer->stat.connect_us, latency_us, __ATOMIC_RELAXED);
+
+	if((uint32_t)fd >= _pool.fd_state_size)
+		return 0;
+
+	/* Start monitoring the connection, we only want to know if the peer has closed the connection,
+	 * so the edge triggered RDHUP event is enough, which means the health check thread won't be waken up
+	 * by the response data */
+	uint32_t gen = __sync_add_and_fetch(&_pool.fd_gen, 1) & 0x3fffffffu;
+
+	__atomic_store_n(_pool.fd_state + fd, (gen << 2) | _FD_STATE_MONITORED, __ATOMIC_RELEASE);
+
+	struct epoll_event event = {
+		.events = EPOLLRDHUP | EPOLLET,
+		.data   = {
+			.u64 = ((uint64_t)gen << 32) | (uint32_t)fd
+		}
+	};
+
+	if(epoll_ctl(_pool.epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0 && (errno != EEXIST || epoll_ctl(_pool.epoll_fd, EPOLL_CTL_MOD, fd, &event) < 0))
+	{
+		LOG_WARNING_ERRNO("Cannot add the connection to the health check list");
+		__atomic_store_n(_pool.fd_state + fd, 0, __ATOMIC_RELEASE);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Copy the cached addresses of the peer if they are still valid
+ * @note This function assumes the caller has already got the pool mutex
+ * @return The number of addresses copied, 0 if there's no valid address
+ **/
+static inline uint32_t _addr_get(const char* hostname, size_t hostname_len, uint16_t port, connection_addr_t* buf, uint32_t bufsize)
+{
+	_peer_t* peer = _peer_get(port, hostname, hostname_len, 0);
+
+	if(NULL == peer || peer->num_addrs == 0 || peer->addr_expire <= time(NULL))
+		return 0;
+
+	uint32_t ret = peer->num_addrs;
+	if(ret > bufsize) ret = bufsize;
+
+	memcpy(buf, peer->addrs, sizeof(connection_addr_t) * ret);
+
+	return ret;
+}
+
+int connection_pool_resolve(const char* hostname, size_t hostname_len, uint16_t port, connection_addr_t* buf, uint32_t bufsize)
+{
+	if(NULL == hostname || hostname_len == 0 || hostname_len > 255 || NULL == buf || bufsize == 0)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	uint32_t ret = 0;
+
+	if(_pool.dns_ttl > 0)
+	{
+		if((errno = pthread_mutex_lock(&_pool.mutex)) != 0)
+			ERROR_RETURN_LOG_ERRNO(int, "Cannot lock the connection pool mutex");
+
+		ret = _addr_get(hostname, hostname_len, port, buf, bufsize);
+
+		if((errno = pthread_mutex_unlock(&_pool.mutex)) != 0)
+			ERROR_RETURN_LOG_ERRNO(int, "Cannot unlock the connection pool mutex");
+
+		if(ret > 0)
+		{
+			LOG_DEBUG("Peer address has been found in the address cache");
+			return (int)ret;
+		}
+	}
+
+	char domain_buf[256];
+	char port_buf[16];
+
+	memcpy(domain_buf, hostname, hostname_len);
+	domain_buf[hostname_len] = 0;
+	snprintf(port_buf, sizeof(port_buf), "%u", port);
+
+	struct addrinfo hints = {
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM,
+		.ai_flags = 0,
+		.ai_protocol = 0
+	}, *result, *ptr;
+
+	int rc = getaddrinfo(domain_buf, port_buf, &hints, &result);
+
+	if(rc != 0)
+		ERROR_RETURN_LOG(int, "Cannot resolve the domain name: %s", gai_strerror(rc));
+
+	connection_addr_t addrs[CONNECTION_POOL_MAX_ADDRS];
+	uint32_t num_addrs = 0;
+
+	for(ptr = result; ptr != NULL && num_addrs < CONNECTION_POOL_MAX_ADDRS; ptr = ptr->ai_next)
+	{
+		if(ptr->ai_addrlen > sizeof(addrs[0].addr))
+			continue;
+
+		addrs[num_addrs].family = ptr->ai_family;
+		addrs[num_addrs].socktype = ptr->ai_socktype;
+		addrs[num_addrs].protocol = ptr->ai_protocol;
+		addrs[num_addrs].addrlen = ptr->ai_addrlen;
+		memcpy(&addrs[num_addrs].addr, ptr->ai_addr, ptr->ai_addrlen);
+		num_addrs ++;
+	}
+
+	freeaddrinfo(result);
+
+	if(num_addrs == 0)
+		ERROR_RETURN_LOG(int, "The domain name %s doesn't have any usable address", domain_buf);
+
+	if(_pool.dns_ttl > 0)
+	{
+		if((errno = pthread_mutex_lock(&_pool.mutex)) != 0)
+			ERROR_RETURN_LOG_ERRNO(int, "Cannot lock the connection pool mutex");
+
+		_peer_t* peer = _peer_get(port, hostname, hostname_len, 1);
+
+		if(NULL != peer)
+		{
+			memcpy(peer->addrs, addrs, sizeof(connection_addr_t) * num_addrs);
+			peer->num_addrs = num_addrs;
+			peer->addr_expire = time(NULL) + (time_t)_pool.dns_ttl;
+		}
+		else LOG_WARNING("Cannot put the resolved address to the address cache");
+
+		if((errno = pthread_mutex_unlock(&_pool.mutex)) != 0)
+			ERROR_RETURN_LOG_ERRNO(int, "Cannot unlock the connection pool mutex");
+	}
+
+	ret = num_addrs < bufsize ? num_addrs : bufsize;
+	memcpy(buf, addrs, sizeof(connection_addr_t) * ret);
+
+	return (int)ret;
+}
+
+int connection_pool_resolve_invalidate(const char* hostname, size_t hostname_len, uint16_t port)
+{
+	if(NULL == hostname || hostname_len == 0)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if(_pool.dns_ttl == 0) return 0;
+
+	if((errno = pthread_mutex_lock(&_pool.mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot lock the connection pool mutex");
+
+	_peer_t* peer = _peer_get(port, hostname, hostname_len, 0);
+
+	if(NULL != peer)
+		peer->num_addrs = 0;
+
+	if((errno = pthread_mutex_unlock(&_pool.mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot unlock the connection pool mutex");
+
+	return 0;
 }
@@ -8,14 +8,36 @@
 #ifndef __CONNECTION_H__
 #define __CONNECTION_H__
 
+#include <sys/socket.h>
+
+/**
+ * @brief The maximum number of addresses we keep for a single peer
+ **/
+#define CONNECTION_POOL_MAX_ADDRS 4
+
+/**
+ * @brief A resolved address of the peer
+ **/
+typedef struct {
+	int                     family;    /*!< The address family */
+	int                     socktype;  /*!< The socket type */
+	int                     protocol;  /*!< The protocol */
+	socklen_t               addrlen;   /*!< The length of the address */
+	struct sockaddr_storage addr;      /*!< The actual address */
+} connection_addr_t;
+
 /**
  * @brief The connection pool initializaiont function (Called from each servlet)
- * @note The pool is a singleton shared between all the workers and servlets
+ * @note The pool is a singleton shared between all the workers and servlets. Internally the idle connections
+ *       are split into shards, each worker thread owns one of the shards, so that the workers don't contend
+ *       on a single lock.
  * @param size How many connections the pool can hold
  * @param peer_pool_size How many connections can be hold to the same peer
+ * @param dns_ttl How many seconds a resolved peer address can be used, 0 means do not cache the address
+ * @param stat_interval How many seconds between two peer statistics dumps, 0 means only dump when the pool is finalized
  * @return status code
  **/
-int connection_pool_init(uint32_t size, uint32_t peer_pool_size);
+int connection_pool_init(uint32_t size, uint32_t peer_pool_size, uint32_t dns_ttl, uint32_t stat_interval);
 
 /**
  * @brief The connection pool finalization (Called from each servlet)
@@ -23,22 +45,75 @@ int connection_pool_init(uint32_t size, uint32_t peer_pool_size);
  **/
 int connection_pool_finalize(void);
 
+/**
+ * @brief Get the shard owned by the current thread
+ * @note The connection should be checked in to the shard it has been checked out from. Since the connection
+ *       is usually released by the IO thread rather than the worker thread, the caller should remember the
+ *       shard id returned by this function and pass it to connection_pool_checkin
+ * @return The shard id
+ **/
+uint32_t connection_pool_shard(void);
+
 /**
  * @brief Acquire a connection from the connection pool
+ * @details The connection is taken from the given shard first, if the shard doesn't have any connection to the peer,
+ *          we try to steal one from other shards which are not currently locked by others.
+ *          The idle connections are monitored by the health check thread, so the connection that has been closed
+ *          by the peer won't be returned
  * @param hostname The destination host name
+ * @param hostname_len The length of the host name
  * @param port The destination port
+ * @param shard The shard id
  * @param fd The buffer used to return fd
  * @return Number of connections has been checked out, or error code
  **/
-int connection_pool_checkout(const char* hostname, size_t hostname_len, uint16_t port, int* fd);
+int connection_pool_checkout(const char* hostname, size_t hostname_len, uint16_t port, uint32_t shard, int* fd);
 
 /**
  * @brief Release the connection and return it to the connection pool
  * @param hostname The peer hostname
+ * @param hostname_len The length of the host name
  * @param port The port
+ * @param shard The shard id
  * @param fd The socket FD to release
  * @return status code
  **/
-int connection_pool_checkin(const char* hostname, size_t hostname_len, uint16_t port, int fd);
+int connection_pool_checkin(const char* hostname, size_t hostname_len, uint16_t port, uint32_t shard, int fd);
+
+/**
+ * @brief Report the result of an attempt to establish a new connection to the peer
+ * @note This function also starts monitoring the newly established connection, so that the connection which is closed
+ *       by the peer while it's idle can be found without touching the socket
+ * @param hostname The peer hostname
+ * @param hostname_len The length of the host name
+ * @param port The port
+ * @param fd The socket FD that has been connected, or a negative number if the connection cannot be established
+ * @param latency_us How many microseconds the connect takes
+ * @return status code
+ **/
+int connection_pool_report_connect(const char* hostname, size_t hostname_len, uint16_t port, int fd, uint64_t latency_us);
+
+/**
+ * @brief Resolve the address of the peer
+ * @details The resolved addresses are cached in the peer table and will be used until the TTL expires,
+ *          so that we won't call the resolver for each request
+ * @param hostname The peer hostname
+ * @param hostname_len The length of the hostname
+ * @param port The port
+ * @param buf The buffer used to return the addresses
+ * @param bufsize The maximum number of addresses can be returned
+ * @return The number of addresses has been returned, or error code
+ **/
+int connection_pool_resolve(const char* hostname, size_t hostname_len, uint16_t port, connection_addr_t* buf, uint32_t bufsize);
+
+/**
+ * @brief Drop the cached addresses of the peer
+ * @note This is used when we cannot connect to any of the cached addresses, since the peer may have moved
+ * @param hostname The peer hostname
+ * @param hostname_len The length of the hostname
+ * @param port The port
+ * @return status code
+ **/
+int connection_pool_resolve_invalidate(const char* hostname, size_t hostname_len, uint16_t port);
 
 #endif
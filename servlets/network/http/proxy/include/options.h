@@ -11,6 +11,8 @@ typedef struct {
 	uint32_t  conn_pool_size;   /*!< The minimal required connection pool size */
 	uint32_t  conn_per_peer;    /*!< The maximum number of connection of the same peer */
 	uint32_t  conn_timeout;     /*!< The connection timeout */
+	uint32_t  dns_ttl;          /*!< How many seconds a resolved peer address can be reused */
+	uint32_t  stat_interval;    /*!< How many seconds between two connection pool statistics dumps */
 } options_t;
 
 /**
@@ -16,7 +16,9 @@ typedef enum {
 	REQUEST_METHOD_POST,   /*!< The HTTP POST method */
 	REQUEST_METHOD_HEAD,   /*!< The HTTP HEAD method */
 	REQUEST_METHOD_PUT,    /*!< The HTTP PUT method */
-	REQUEST_METHOD_DELETE  /*!< The HTTP DELETE method */
+	REQUEST_METHOD_DELETE, /*!< The HTTP DELETE method */
+	REQUEST_METHOD_PATCH,  /*!< The HTTP PATCH method */
+	REQUEST_METHOD_OPTIONS /*!< The HTTP OPTIONS method */
 } request_method_t;
 
 /**
@@ -17,6 +17,12 @@ static int _opt_handle(pstd_option_data_t data)
 			goto OPT_CHK;
 		case 'T':
 			opt->conn_timeout = (uint32_t)data.param_array[0].intval;
+			goto OPT_CHK;
+		case 'D':
+			opt->dns_ttl = (uint32_t)data.param_array[0].intval;
+			goto OPT_CHK;
+		case 'S':
+			opt->stat_interval = (uint32_t)data.param_array[0].intval;
 OPT_CHK:
 			if(data.param_array[0].intval < 0)
 				ERROR_RETURN_LOG(int, "Invalid parameter");
@@ -60,6 +66,22 @@ static pstd_option_t _options[] = {
 		.pattern     = "I",
 		.handler     = _opt_handle,
 		.args        = NULL
+	},
+	{
+		.long_opt    = "dns-ttl",
+		.short_opt   = 'D',
+		.description = "The number of seconds a resolved peer address can be reused, 0 disables the address cache",
+		.pattern     = "I",
+		.handler     = _opt_handle,
+		.args        = NULL
+	},
+	{
+		.long_opt    = "stat-interval",
+		.short_opt   = 'S',
+		.description = "The number of seconds between two connection pool statistics dumps, 0 means only dump on exit",
+		.pattern     = "I",
+		.handler     = _opt_handle,
+		.args        = NULL
 	}
 };
 
@@ -71,6 +93,8 @@ int options_parse(uint32_t argc, char const* const* argv, options_t* buf)
 	buf->conn_pool_size = 1024;
 	buf->conn_per_peer = 32;
 	buf->conn_timeout = 30;
+	buf->dns_ttl = 60;
+	buf->stat_interval = 0;
 
 	if(ERROR_CODE(int) == pstd_option_sort(_options, sizeof(_options) / sizeof(_options[0])))
 		ERROR_RETURN_LOG(int, "Cannot sort the options");
@@ -11,7 +11,8 @@
 #include <inttypes.h>
 #include <sys/types.h>
 #include <sys/socket.h>
-#include <netdb.h>
+#include <poll.h>
+#include <time.h>
 
 #include <pstd.h>
 
@@ -29,7 +30,9 @@ const char* _method_verb[] = {
 	[REQUEST_METHOD_PUT]  = "PUT ",
 	[REQUEST_METHOD_POST] = "POST ",
 	[REQUEST_METHOD_HEAD] = "HEAD ",
-	[REQUEST_METHOD_DELETE] = "DELETE "
+	[REQUEST_METHOD_DELETE] = "DELETE ",
+	[REQUEST_METHOD_PATCH] = "PATCH ",
+	[REQUEST_METHOD_OPTIONS] = "OPTIONS "
 };
 
 /**
@@ -40,7 +43,9 @@ const size_t _method_verb_size[] = {
 	[REQUEST_METHOD_PUT]  = 4,
 	[REQUEST_METHOD_POST] = 5,
 	[REQUEST_METHOD_HEAD] = 5,
-	[REQUEST_METHOD_DELETE] = 7
+	[REQUEST_METHOD_DELETE] = 7,
+	[REQUEST_METHOD_PATCH] = 6,
+	[REQUEST_METHOD_OPTIONS] = 8
 };
 
 /**
@@ -62,6 +67,7 @@ struct _request_t {
 	uint32_t          req_page_offset;  /*!< The offset of the last page we used */
 	uint32_t          req_page_capcity; /*!< The capacity of the page list */
 	uint32_t          timeout;          /*!< The timeout for this request */
+	char              host_buf[272];    /*!< The copy of the host string, because the stream may outlive the string RLS */
 	/* TODO: add cookie, etc */
 };
 
@@ -71,10 +77,19 @@ struct _request_t {
 typedef struct {
 	const request_t*   req;                  /*!< The request data for this stream */
 	int                sock;                 /*!< The socket we are using */
+	int                failed_sock;          /*!< The last socket failed to connect, see _connect_check for details */
 	uint32_t           cur_request_page;     /*!< The current request page */
 	uint32_t           cur_request_page_ofs; /*!< The current request page offset */
 	uint32_t           error:1;              /*!< Indicates if we are encounter some socket error */
+	uint32_t           connecting:1;         /*!< Indicates the socket is waiting for the connection gets established */
+	uint32_t           unavailable:1;        /*!< Indicates none of the peer addresses is reachable and we are sending the 503 response */
+	uint32_t           unavailable_ofs;      /*!< How many bytes of the 503 response has been sent */
+	uint32_t           num_addrs;            /*!< The number of resolved addresses of the peer */
+	uint32_t           cur_addr;             /*!< The address we are currently connecting to */
+	uint32_t           shard;                /*!< The connection pool shard this stream uses */
+	uint64_t           connect_start;        /*!< When we started to establish the connection, in microseconds */
 	http_response_t    response;             /*!< The response state object */
+	connection_addr_t  addrs[CONNECTION_POOL_MAX_ADDRS];  /*!< The resolved addresses of the peer */
 } _stream_t;
 
 static inline int _free_request_pages(request_t* req)
@@ -271,6 +286,13 @@ request_t* request_new(const request_param_t* param, uint32_t timeout)
 	else
 		ret->host_len = ret->domain_len;
 
+	/* The connection may be established after the request scope has been disposed, so make a copy */
+	size_t host_size = ret->domain_len + (ret->port_str == NULL ? 0u : ret->port_str_len + 1u);
+	memcpy(ret->host_buf, ret->domain, host_size);
+	ret->host_buf[host_size] = 0;
+	if(NULL != ret->port_str) ret->port_str = ret->host_buf + (ret->port_str - ret->domain);
+	ret->host = ret->domain = ret->host_buf;
+
 	ret->req_page_capcity = 4;
 	ret->req_page_count = 0;
 	ret->req_page_offset = _PAGESIZE;
@@ -324,93 +346,174 @@ static int _rls_free(void* obj)
 	return _request_free(req);
 }
 
-static inline int _connect(_stream_t* stream)
+static inline uint64_t _now_us(void)
+{
+	struct timespec ts;
+	if(clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		return 0;
+	return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000ull;
+}
+
+/**
+ * @brief Report the connect result to the connection pool
+ * @param stream The stream
+ * @param fd The connected socket, or -1 if the connection cannot be established
+ * @return nothing
+ **/
+static inline void _connect_report(const _stream_t* stream, int fd)
 {
 	const request_t* req = stream->req;
+	uint64_t latency = _now_us() - stream->connect_start;
 
-	int conn_rc = connection_pool_checkout(req->domain, req->domain_len, req->port, &stream->sock);
+	if(ERROR_CODE(int) == connection_pool_report_connect(req->domain, req->domain_len, req->port, fd, latency))
+		LOG_WARNING("Cannot report the connect result to the connection pool");
+}
 
-	if(ERROR_CODE(int) == conn_rc)
-		ERROR_RETURN_LOG(int, "Cannot checkout the socket to the server from connection pool");
+/**
+ * @brief Start connecting to the next resolved address of the peer in nonblocking mode
+ * @note If the connection cannot be established immediately, the stream will be marked as connecting and
+ *       the connection will be completed when the socket gets ready for write
+ * @param stream The stream
+ * @return status code
+ **/
+static inline int _connect_next(_stream_t* stream)
+{
+	const request_t* req = stream->req;
 
-	if(conn_rc == 1)
+	for(; stream->cur_addr < stream->num_addrs; stream->cur_addr ++)
 	{
-		char c;
-		LOG_DEBUG("The connection pool returns a socket, try to validate the socket is in good state");
-		ssize_t sz = recv(stream->sock, &c, 1, MSG_PEEK);
+		const connection_addr_t* addr = stream->addrs + stream->cur_addr;
 
-		if((sz < 0 && errno != EWOULDBLOCK && errno != EAGAIN) || sz == 0)
+		if((stream->sock = socket(addr->family, addr->socktype, addr->protocol)) < 0)
 		{
-			if(sz < 0)
-				LOG_DEBUG_ERRNO("The socket fd returns an unexpected FD, closing it and establish a new one");
-			else
-				LOG_DEBUG("The socket is in half-closed state, get rid of that one");
-			if(close(stream->sock) < 0)
-				LOG_WARNING_ERRNO("Cannot close the FD");
-			conn_rc = 0;
+			LOG_TRACE_ERRNO("Cannot create socket for the address of %.*s", (int)req->domain_len, req->domain);
+			continue;
 		}
-	}
-
-	if(conn_rc == 0)
-	{
-		LOG_DEBUG("The connection pool doesn't have any connection can be used, try to open another one");
 
-		char domain_buf[256];
-		char port_buf[16];
+		int flags = fcntl(stream->sock, F_GETFL, 0);
+		if(flags == -1)
+			ERROR_LOG_ERRNO_GOTO(CONN_FAIL, "Cannot get the flags for the socket FD");
 
-		memcpy(domain_buf, req->domain, req->domain_len);
-		domain_buf[req->domain_len] = 0;
+		if(fcntl(stream->sock, F_SETFL, flags | O_NONBLOCK) < 0)
+			ERROR_LOG_ERRNO_GOTO(CONN_FAIL, "Cannot set the socket FD to nonblocking mode");
 
+		if(connect(stream->sock, (const struct sockaddr*)&addr->addr, addr->addrlen) >= 0)
+		{
+			LOG_TRACE("The connection has been successfully established to %.*s", (int)req->domain_len, req->domain);
+			stream->connecting = 0;
+			_connect_report(stream, stream->sock);
+			return 0;
+		}
 
-		if(req->port_str == NULL)
-			memcpy(port_buf, "80", 3);
-		else
+		if(errno == EINPROGRESS)
 		{
-			memcpy(port_buf, req->port_str, req->port_str_len);
-			port_buf[req->port_str_len] = 0;
+			LOG_TRACE("The connection to %.*s is in progress", (int)req->domain_len, req->domain);
+			stream->connecting = 1;
+			return 0;
 		}
 
-		struct addrinfo hints = {
-			.ai_family = AF_UNSPEC,
-			.ai_socktype = SOCK_STREAM,
-			.ai_flags = 0,
-			.ai_protocol = 0
-		}, *result, *ptr;
+		LOG_TRACE_ERRNO("Cannot connect to the address of %.*s", (int)req->domain_len, req->domain);
+CONN_FAIL:
+		if(close(stream->sock) < 0)
+			LOG_WARNING("Cannot close the socket fd %d", stream->sock);
+		stream->sock = -1;
+	}
 
-		int rc = getaddrinfo(domain_buf, port_buf, &hints, &result);
+	stream->connecting = 0;
+	_connect_report(stream, -1);
 
-		if(rc != 0)
-			ERROR_RETURN_LOG(int, "Cannot resolve the domain name: %s", gai_strerror(rc));
+	/* The peer may have moved, so we don't want to use the cached addresses anymore */
+	if(ERROR_CODE(int) == connection_pool_resolve_invalidate(req->domain, req->domain_len, req->port))
+		LOG_WARNING("Cannot invalidate the cached peer address");
 
-		for(ptr = result; ptr != NULL; ptr = ptr->ai_next)
-		{
-			if((stream->sock =socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol)) < 0)
-				LOG_TRACE_ERRNO("Cannot connect to the address %s", req->domain);
+	ERROR_RETURN_LOG(int, "Cannot connect to the server %.*s", (int)req->domain_len, req->domain);
+}
 
-			if(connect(stream->sock, ptr->ai_addr, ptr->ai_addrlen) >= 0)
-			{
-				LOG_TRACE("The connection has been successfully established to %s", req->domain);
-				int flags = fcntl(stream->sock, F_GETFL, 0);
-				if(flags == -1)
-					ERROR_LOG_ERRNO_GOTO(CONN_FAIL, "Cannot get the flags for the socket FD");
+/**
+ * @brief Check if the nonblocking connection has been established
+ * @param stream The stream
+ * @return 1 if the connection is established, 0 if we are still waiting, error code on error
+ **/
+static inline int _connect_check(_stream_t* stream)
+{
+	struct pollfd pfd = {
+		.fd = stream->sock,
+		.events = POLLOUT
+	};
 
-				if(fcntl(stream->sock, F_SETFL, flags | O_NONBLOCK) < 0)
-					ERROR_LOG_ERRNO_GOTO(CONN_FAIL, "Cannot set the socket FD to nonblocking mode");
+	int rc = poll(&pfd, 1, 0);
+	if(rc < 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot poll the connecting socket");
 
-				conn_rc = 1;
-				break;
-			}
-CONN_FAIL:
-			if(stream->sock >= 0 && close(stream->sock) < 0)
-				LOG_WARNING("Cannot close the socket fd %d", stream->sock);
+	if(rc == 0) return 0;
 
-		}
+	int err = 0;
+	socklen_t len = sizeof(err);
+	if(getsockopt(stream->sock, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot get the socket error");
+
+	if(err == 0)
+	{
+		LOG_TRACE("The connection has been successfully established to %.*s", (int)stream->req->domain_len, stream->req->domain);
+		stream->connecting = 0;
+		_connect_report(stream, stream->sock);
+		return 1;
+	}
 
-		if(NULL != result)
-			freeaddrinfo(result);
+	errno = err;
+	LOG_TRACE_ERRNO("Cannot connect to the address of %.*s, try the next one", (int)stream->req->domain_len, stream->req->domain);
 
-		if(conn_rc == 0)
-			ERROR_RETURN_LOG_ERRNO(int, "Cannot connect to the server");
+	/* The async loop may still have the failed socket registered as the data event FD, so we keep it open
+	 * until the next attempt has been made, otherwise the FD number can be reused by the next socket
+	 * while the async loop thinks it has been registered already */
+	if(stream->failed_sock >= 0 && close(stream->failed_sock) < 0)
+		LOG_WARNING_ERRNO("Cannot close the socket fd %d", stream->failed_sock);
+
+	stream->failed_sock = stream->sock;
+	stream->sock = -1;
+	stream->cur_addr ++;
+
+	if(ERROR_CODE(int) == _connect_next(stream))
+		return ERROR_CODE(int);
+
+	return !stream->connecting;
+}
+
+/**
+ * @brief The response we send back when the nonblocking connect has failed
+ * @note Unlike the connect failure during the stream open, at this point the render servlet has already
+ *       started forwarding the stream, so we have to produce the 503 response by ourselves
+ **/
+static const char _unavailable_response[] = "HTTP/1.1 503 Service Unavailable\r\n"
+                                            "Content-Type: text/plain\r\n"
+                                            "Content-Length: 19\r\n"
+                                            "\r\n"
+                                            "Service Unavailable";
+
+static inline int _connect(_stream_t* stream)
+{
+	const request_t* req = stream->req;
+
+	/* The connection pool only returns the connection that hasn't been closed by the peer */
+	int conn_rc = connection_pool_checkout(req->domain, req->domain_len, req->port, stream->shard, &stream->sock);
+
+	if(ERROR_CODE(int) == conn_rc)
+		ERROR_RETURN_LOG(int, "Cannot checkout the socket to the server from connection pool");
+
+	if(conn_rc == 0)
+	{
+		LOG_DEBUG("The connection pool doesn't have any connection can be used, try to open another one");
+
+		int rc = connection_pool_resolve(req->domain, req->domain_len, req->port, stream->addrs, CONNECTION_POOL_MAX_ADDRS);
+		if(ERROR_CODE(int) == rc)
+			ERROR_RETURN_LOG(int, "Cannot resolve the peer address");
+
+		stream->num_addrs = (uint32_t)rc;
+		stream->cur_addr = 0;
+		stream->connect_start = _now_us();
+
+		if(ERROR_CODE(int) == _connect_next(stream))
+			ERROR_RETURN_LOG(int, "Cannot connect to the server");
 	}
 
 	return 0;
@@ -424,11 +527,11 @@ static int _rls_close(void* obj)
 	if(stream->sock >= 0)
 	{
 
-		/* First of all, we need to shut down all the socket that is wrong */
-		if(stream->error) needs_close = 1;
+		/* First of all, we need to shut down all the socket that is wrong or not connected yet */
+		if(stream->error || stream->connecting) needs_close = 1;
 
 		/* Then we need to dealing with the socket that still have undergoing data transferring */
-		if(!http_response_complete(&stream->response))
+		if(!stream->connecting && !http_response_complete(&stream->response))
 		{
 
 			LOG_DEBUG("The stream has to be closed because client has shutted down");
@@ -462,14 +565,19 @@ static int _rls_close(void* obj)
 			LOG_ERROR_ERRNO("Cannot close the error socket");
 		}
 
-		if(!needs_close && ERROR_CODE(int) == connection_pool_checkin(stream->req->domain, stream->req->domain_len, stream->req->port, stream->sock))
+		if(!needs_close && ERROR_CODE(int) == connection_pool_checkin(stream->req->domain, stream->req->domain_len, stream->req->port, stream->shard, stream->sock))
 		{
 			rc = ERROR_CODE(int);
 			LOG_ERROR("Cannot checkin the connection to the connection pool");
-			close(stream->sock);
 		}
 	}
 
+	if(stream->failed_sock >= 0 && close(stream->failed_sock) < 0)
+	{
+		rc = ERROR_CODE(int);
+		LOG_ERROR_ERRNO("Cannot close the failed socket");
+	}
+
 	if(ERROR_CODE(int) == pstd_mempool_free(stream))
 	{
 		rc = ERROR_CODE(int);
@@ -488,7 +596,13 @@ static void* _rls_open(const void* obj)
 		ERROR_PTR_RETURN_LOG("Cannot allocate memory for the new stream");
 
 	stream->sock = -1;
+	stream->failed_sock = -1;
+	stream->connecting = 0;
+	stream->unavailable = 0;
+	stream->unavailable_ofs = 0;
+	stream->num_addrs = 0;
 	stream->req = req;
+	stream->shard = connection_pool_shard();
 	stream->cur_request_page = 0;
 	stream->cur_request_page_ofs = 0;
 	memset(&stream->response, 0, sizeof(stream->response));
@@ -501,11 +615,8 @@ static void* _rls_open(const void* obj)
 	return stream;
 ERR:
 
-	if(stream->sock >= 0 && connection_pool_checkin(req->domain, req->domain_len, req->port, stream->sock) == ERROR_CODE(int))
-	{
+	if(stream->sock >= 0 && connection_pool_checkin(req->domain, req->domain_len, req->port, stream->shard, stream->sock) == ERROR_CODE(int))
 		LOG_ERROR("Cannot checkin the connected FD");
-		close(stream->sock);
-	}
 
 	pstd_mempool_free(stream);
 	return NULL;
@@ -523,6 +634,30 @@ static size_t _rls_read(void* __restrict obj, void* __restrict buf, size_t count
 	_stream_t* stream = (_stream_t*)obj;
 	const request_t* req = stream->req;
 
+	if(stream->connecting)
+	{
+		int rc = _connect_check(stream);
+		if(ERROR_CODE(int) == rc)
+		{
+			LOG_DEBUG("None of the peer addresses is reachable, sending 503 response");
+			stream->unavailable = 1;
+		}
+
+		/* Wait for the socket gets ready for write */
+		else if(rc == 0) return 0;
+	}
+
+	if(stream->unavailable)
+	{
+		size_t bytes_to_copy = sizeof(_unavailable_response) - 1 - stream->unavailable_ofs;
+		if(bytes_to_copy > count) bytes_to_copy = count;
+
+		memcpy(buf, _unavailable_response + stream->unavailable_ofs, bytes_to_copy);
+		stream->unavailable_ofs += (uint32_t)bytes_to_copy;
+
+		return bytes_to_copy;
+	}
+
 	while(!_end_of_request(stream))
 	{
 		size_t bytes_to_write = count;
@@ -583,6 +718,9 @@ static inline int _rls_eos(const void* obj)
 {
 	const _stream_t* stream = (const _stream_t*)obj;
 
+	if(stream->unavailable)
+		return stream->unavailable_ofs >= sizeof(_unavailable_response) - 1;
+
 	return stream->error || http_response_complete(&stream->response);
 }
 
@@ -590,13 +728,17 @@ static int _rls_event(void* obj, scope_ready_event_t* buf)
 {
 	_stream_t* stream = (_stream_t*)obj;
 
+	/* The 503 response is in memory, so it's always ready */
+	if(stream->unavailable) return 0;
+
 	buf->fd = stream->sock;
 	buf->timeout = (int32_t)stream->req->timeout;
 
 	buf->read = 0;
 	buf->write = 0;
 
-	if(_end_of_request(stream))
+	/* The nonblocking connect completes once the socket gets ready for write */
+	if(!stream->connecting && _end_of_request(stream))
 		buf->read = 1;
 	else
 		buf->write = 1;
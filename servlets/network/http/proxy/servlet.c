@@ -37,6 +37,8 @@ typedef struct {
 		uint32_t POST;
 		uint32_t HEAD;
 		uint32_t DELETE;
+		uint32_t PATCH;
+		uint32_t OPTIONS;
 	}         method;
 } _ctx_t;
 
@@ -53,7 +55,7 @@ static int _init(uint32_t argc, char const* const* argv, void* ctxmem)
 	if(ERROR_CODE(pipe_t) == (ctx->p_response = pipe_define("response", PIPE_OUTPUT, "plumber/std_servlet/network/http/proxy/v0/Response")))
 		ERROR_RETURN_LOG(int, "Cannot define the response pipe");
 
-	if(ERROR_CODE(int) == connection_pool_init(ctx->options.conn_pool_size, ctx->options.conn_per_peer))
+	if(ERROR_CODE(int) == connection_pool_init(ctx->options.conn_pool_size, ctx->options.conn_per_peer, ctx->options.dns_ttl, ctx->options.stat_interval))
 		ERROR_RETURN_LOG(int, "Cannot initialize the connection pool for this servlet instance");
 
 	PSTD_TYPE_MODEL(type_list)
@@ -71,6 +73,8 @@ static int _init(uint32_t argc, char const* const* argv, void* ctxmem)
 		PSTD_TYPE_MODEL_CONST(ctx->p_request, METHOD_POST,        ctx->method.POST),
 		PSTD_TYPE_MODEL_CONST(ctx->p_request, METHOD_HEAD,        ctx->method.HEAD),
 		PSTD_TYPE_MODEL_CONST(ctx->p_request, METHOD_DELETE,      ctx->method.DELETE),
+		PSTD_TYPE_MODEL_CONST(ctx->p_request, METHOD_PATCH,       ctx->method.PATCH),
+		PSTD_TYPE_MODEL_CONST(ctx->p_request, METHOD_OPTIONS,     ctx->method.OPTIONS),
 		PSTD_TYPE_MODEL_FIELD(ctx->p_response, token,             ctx->a_response)
 	};
 
@@ -118,6 +122,10 @@ static inline int _construct_request_param(const _ctx_t* ctx, pstd_type_instance
 		buf->method = REQUEST_METHOD_HEAD;
 	else if(method_code == ctx->method.DELETE)
 		buf->method = REQUEST_METHOD_DELETE;
+	else if(method_code == ctx->method.PATCH)
+		buf->method = REQUEST_METHOD_PATCH;
+	else if(method_code == ctx->method.OPTIONS)
+		buf->method = REQUEST_METHOD_OPTIONS;
 	else
 		return 0;
 
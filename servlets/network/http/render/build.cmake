@@ -9,4 +9,9 @@ if("${PC_ZLIB_FOUND}" STREQUAL "1")
 	list(APPEND LOCAL_CFLAGS "-DHAS_ZLIB")
 endif("${PC_ZLIB_FOUND}" STREQUAL "1")
 
-#TODO: Add brotli support
+pkg_check_modules(PC_BROTLI libbrotlienc)
+if("${PC_BROTLI_FOUND}" STREQUAL "1")
+	list(APPEND LOCAL_INCLUDE "${PC_BROTLI_INCLUDE_DIRS}")
+	list(APPEND LOCAL_LIBS "${PC_BROTLI_LIBRARIES}")
+	list(APPEND LOCAL_CFLAGS "-DHAS_BROTLI")
+endif("${PC_BROTLI_FOUND}" STREQUAL "1")
@@ -83,7 +83,7 @@ static size_t _feed(pstd_trans_inst_t* __restrict stream_proc, const void* __res
 		uint32_t cur_offset = proc->chunck_size % _page_size;
 
 		uint32_t bytes_to_copy = _page_size - cur_offset;
-		if(bytes_to_copy > size) bytes_to_copy = (uint32_t)size;
+		if(bytes_to_copy > bytes_to_write) bytes_to_copy = bytes_to_write;
 
 		memcpy(proc->pages[cur_block] + cur_offset, in, bytes_to_copy);
 
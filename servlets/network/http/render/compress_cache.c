@@ -0,0 +1,558 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <utils/hash/murmurhash3.h>
+
+#include <pservlet.h>
+#include <pstd.h>
+
+#include <zlib_token.h>
+#include <brotli_token.h>
+#include <compress_cache.h>
+
+/**
+ * @brief A compressed body in the cache
+ * @note The entry is reference counted, because the RLS token which carries the compressed bytes
+ *       may outlive the entry in the cache. The async write loop may still be sending the bytes when
+ *       the entry gets evicted by other worker thread. All the fields are protected by the cache mutex.
+ **/
+typedef struct _entry_t {
+	uint64_t                  hash[2];     /*!< The 128 bit hash code of the uncompressed body */
+	size_t                    body_size;   /*!< The size of the uncompressed body */
+	compress_cache_encoding_t encoding;    /*!< The encoding algorithm */
+	int                       level;       /*!< The compression level */
+	uint32_t                  refcnt;      /*!< The number of RLS objects that is referring this entry */
+	uint32_t                  evicted:1;   /*!< If this entry is no longer in the cache */
+	struct _entry_t*          hash_next;   /*!< The next entry in the hash slot */
+	struct _entry_t*          lru_prev;    /*!< The previous entry in the LRU list */
+	struct _entry_t*          lru_next;    /*!< The next entry in the LRU list */
+	size_t                    size;        /*!< The size of the compressed data */
+	void*                     data;        /*!< The compressed data */
+} _entry_t;
+
+/**
+ * @brief The byte stream interface of a cached entry
+ **/
+typedef struct {
+	const _entry_t*           entry;       /*!< The entry we are reading */
+	size_t                    offset;      /*!< The current read offset */
+} _stream_t;
+
+/**
+ * @brief The statistics of the compressed response cache
+ **/
+typedef struct {
+	uint64_t    hits;         /*!< The number of requests served from the cache */
+	uint64_t    misses;       /*!< The number of requests that needs to run the compressor */
+	uint64_t    evictions;    /*!< The number of entries evicted because of the size limit */
+	uint64_t    bypasses;     /*!< The number of bodies we can not cache, because the body stream is not ready */
+	uint32_t    num_entries;  /*!< The number of entries currently in the cache */
+	size_t      size;         /*!< The total size of the compressed bytes currently in the cache */
+} _stat_t;
+
+/**
+ * @brief The global compressed response cache
+ **/
+static struct {
+	_entry_t**            table;        /*!< The hash table */
+	_entry_t*             lru_begin;    /*!< The most recently used entry */
+	_entry_t*             lru_end;      /*!< The least recently used entry */
+	uint32_t              init_count;   /*!< How many servlets are using the cache */
+	uint32_t              hash_size;    /*!< The number of slots in the hash table */
+	uint32_t              hash_seed;    /*!< The seed for the content hash */
+	size_t                limit;        /*!< The maximum number of compressed bytes in the cache */
+	_stat_t               stat;         /*!< The cache statistics */
+} _cache;
+
+/**
+ * @brief The global cache mutex
+ * @note The mutex is never destroyed, because the RLS objects referring the cache entries may be released
+ *       by the async write loop after the cache has been finalized
+ **/
+static pthread_mutex_t _cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint32_t _get_hash_size(void)
+{
+	return 4073;
+}
+
+int compress_cache_init(size_t limit)
+{
+	if(_cache.limit < limit)
+		_cache.limit = limit;
+
+	if(_cache.init_count == 0)
+	{
+		_cache.hash_size = _get_hash_size();
+
+		if(NULL == (_cache.table = (_entry_t**)calloc(sizeof(_entry_t*), _cache.hash_size)))
+			ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the hash table");
+
+		/* Make the slot of a body unpredictable, so that the client can not flood a single slot */
+		_cache.hash_seed = (uint32_t)time(NULL) * 0x9e3779b1u + (uint32_t)getpid();
+
+		memset(&_cache.stat, 0, sizeof(_cache.stat));
+	}
+
+	_cache.init_count ++;
+
+	return 0;
+}
+
+/**
+ * @brief Dispose an entry which is not referenced by anyone
+ * @param entry The entry to dispose
+ * @return nothing
+ **/
+static inline void _entry_free(_entry_t* entry)
+{
+	free(entry->data);
+	free(entry);
+}
+
+int compress_cache_finalize(void)
+{
+	int rc = 0;
+	if(_cache.init_count == 0) return 0;
+
+	if(0 == --_cache.init_count)
+	{
+		LOG_INFO("Compressed response cache: %"PRIu64" hits, %"PRIu64" misses, %"PRIu64" evictions, %"PRIu64" bypasses",
+		         _cache.stat.hits, _cache.stat.misses, _cache.stat.evictions, _cache.stat.bypasses);
+
+		if((errno = pthread_mutex_lock(&_cache_mutex)) != 0)
+			ERROR_RETURN_LOG_ERRNO(int, "Cannot lock the compressed response cache mutex");
+
+		/* The referenced entries are disposed by the last _release call */
+		_entry_t* ptr;
+		for(ptr = _cache.lru_begin; ptr != NULL;)
+		{
+			_entry_t* this = ptr;
+			ptr = ptr->lru_next;
+
+			if(this->refcnt > 0)
+			{
+				LOG_WARNING("The cache entry is still referenced by %u RLS objects", this->refcnt);
+				this->evicted = 1;
+				continue;
+			}
+
+			_entry_free(this);
+		}
+
+		free(_cache.table);
+		_cache.table = NULL;
+		_cache.lru_begin = _cache.lru_end = NULL;
+		_cache.limit = 0;
+		_cache.stat.size = 0;
+		_cache.stat.num_entries = 0;
+
+		if((errno = pthread_mutex_unlock(&_cache_mutex)) != 0)
+		{
+			LOG_ERROR_ERRNO("Cannot release the compressed response cache mutex");
+			rc = ERROR_CODE(int);
+		}
+	}
+	return rc;
+}
+
+static inline void _lru_remove(_entry_t* entry)
+{
+	if(entry->lru_prev == NULL)
+		_cache.lru_begin = entry->lru_next;
+	else
+		entry->lru_prev->lru_next = entry->lru_next;
+
+	if(entry->lru_next == NULL)
+		_cache.lru_end = entry->lru_prev;
+	else
+		entry->lru_next->lru_prev = entry->lru_prev;
+}
+
+static inline void _lru_add(_entry_t* entry)
+{
+	entry->lru_next = _cache.lru_begin;
+	entry->lru_prev = NULL;
+	if(_cache.lru_begin != NULL)
+		_cache.lru_begin->lru_prev = entry;
+	_cache.lru_begin = entry;
+	if(_cache.lru_end == NULL)
+		_cache.lru_end = entry;
+}
+
+static inline uint32_t _hash_slot(const uint64_t* hash, compress_cache_encoding_t encoding, int level)
+{
+	return (uint32_t)((hash[0] ^ (hash[1] * 31) ^ ((uint64_t)encoding << 4) ^ (uint64_t)level) % _cache.hash_size);
+}
+
+static inline int _entry_match(const _entry_t* entry, const uint64_t* hash, size_t body_size, compress_cache_encoding_t encoding, int level)
+{
+	return entry->hash[0] == hash[0] && entry->hash[1] == hash[1] &&
+	       entry->body_size == body_size && entry->encoding == encoding && entry->level == level;
+}
+
+/**
+ * @brief Take the entry out of the cache, the entry will be disposed once nobody is referring it
+ * @param entry The entry to evict
+ * @return nothing
+ **/
+static inline void _evict(_entry_t* entry)
+{
+	uint32_t slot = _hash_slot(entry->hash, entry->encoding, entry->level);
+	_entry_t** pptr;
+	for(pptr = _cache.table + slot; *pptr != NULL && *pptr != entry; pptr = &(*pptr)->hash_next);
+	if(*pptr != NULL) *pptr = entry->hash_next;
+
+	_lru_remove(entry);
+
+	_cache.stat.size -= entry->size;
+	_cache.stat.num_entries --;
+	entry->evicted = 1;
+
+	if(entry->refcnt == 0)
+		_entry_free(entry);
+}
+
+/**
+ * @brief Find the entry in the cache and acquire a reference to it
+ * @note This function assumes the caller has already got the cache mutex
+ * @return The entry or NULL if it's not found
+ **/
+static inline _entry_t* _find(const uint64_t* hash, size_t body_size, compress_cache_encoding_t encoding, int level)
+{
+	_entry_t* ret;
+	uint32_t slot = _hash_slot(hash, encoding, level);
+
+	for(ret = _cache.table[slot]; NULL != ret && !_entry_match(ret, hash, body_size, encoding, level); ret = ret->hash_next);
+
+	if(NULL != ret)
+	{
+		ret->refcnt ++;
+		_lru_remove(ret);
+		_lru_add(ret);
+	}
+
+	return ret;
+}
+
+/**
+ * @brief Put the newly compressed entry into the cache
+ * @note This function assumes the caller has already got the cache mutex.
+ *       If the entry is larger than the cache, it won't be in the cache but still be able to
+ *       serve the current request
+ * @param entry The entry to add
+ * @return nothing
+ **/
+static inline void _insert(_entry_t* entry)
+{
+	if(entry->size > _cache.limit)
+	{
+		entry->evicted = 1;
+		return;
+	}
+
+	while(_cache.lru_end != NULL && _cache.stat.size + entry->size > _cache.limit)
+	{
+		_evict(_cache.lru_end);
+		_cache.stat.evictions ++;
+	}
+
+	uint32_t slot = _hash_slot(entry->hash, entry->encoding, entry->level);
+	entry->hash_next = _cache.table[slot];
+	_cache.table[slot] = entry;
+	_lru_add(entry);
+
+	_cache.stat.size += entry->size;
+	_cache.stat.num_entries ++;
+}
+
+/**
+ * @brief Release a reference to the entry
+ * @param entry The entry to release
+ * @return status code
+ **/
+static inline int _release(_entry_t* entry)
+{
+	if((errno = pthread_mutex_lock(&_cache_mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot lock the compressed response cache mutex");
+
+	if(0 == --entry->refcnt && entry->evicted)
+		_entry_free(entry);
+
+	if((errno = pthread_mutex_unlock(&_cache_mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot release the compressed response cache mutex");
+
+	return 0;
+}
+
+static int _free(void* mem)
+{
+	return _release((_entry_t*)mem);
+}
+
+static void* _copy(const void* mem)
+{
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wcast-qual"
+	/* The entry is immutable, so the copy is just another reference to the same entry */
+	_entry_t* entry = (_entry_t*)mem;
+#pragma GCC diagnostic pop
+
+	if((errno = pthread_mutex_lock(&_cache_mutex)) != 0)
+		ERROR_PTR_RETURN_LOG_ERRNO("Cannot lock the compressed response cache mutex");
+
+	entry->refcnt ++;
+
+	if((errno = pthread_mutex_unlock(&_cache_mutex)) != 0)
+		ERROR_PTR_RETURN_LOG_ERRNO("Cannot release the compressed response cache mutex");
+
+	return entry;
+}
+
+static void* _open(const void* mem)
+{
+	_stream_t* ret = (_stream_t*)pstd_mempool_alloc(sizeof(_stream_t));
+	if(NULL == ret)
+		ERROR_PTR_RETURN_LOG("Cannot allocate memory for the stream");
+
+	ret->entry = (const _entry_t*)mem;
+	ret->offset = 0;
+
+	return ret;
+}
+
+static int _close(void* stream_mem)
+{
+	return pstd_mempool_free(stream_mem);
+}
+
+static int _eos(const void* stream_mem)
+{
+	const _stream_t* stream = (const _stream_t*)stream_mem;
+
+	return stream->offset >= stream->entry->size;
+}
+
+static size_t _read(void* __restrict stream_mem, void* __restrict buf, size_t count)
+{
+	_stream_t* stream = (_stream_t*)stream_mem;
+
+	size_t bytes_can_read = stream->entry->size - stream->offset;
+	if(bytes_can_read > count)
+		bytes_can_read = count;
+
+	memcpy(buf, ((const char*)stream->entry->data) + stream->offset, bytes_can_read);
+
+	stream->offset += bytes_can_read;
+
+	return bytes_can_read;
+}
+
+/**
+ * @brief Read the entire uncompressed body to the memory
+ * @param body_token The body token
+ * @param body_size The expected size of the body
+ * @return The body buffer, NULL if the body is not ready for reading (or doesn't have the expected size)
+ *         or error code
+ **/
+static inline void* _read_body(scope_token_t body_token, size_t body_size)
+{
+	pstd_scope_stream_t* stream = NULL;
+	char* ret = NULL;
+	size_t bytes_read = 0;
+
+	if(NULL == (ret = (char*)malloc(body_size + 1)))
+		ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the body buffer");
+
+	if(NULL == (stream = pstd_scope_stream_open(body_token)))
+		ERROR_LOG_GOTO(ERR, "Cannot open the body token as a byte stream");
+
+	for(;;)
+	{
+		int eos_rc = pstd_scope_stream_eof(stream);
+		if(ERROR_CODE(int) == eos_rc)
+			ERROR_LOG_GOTO(ERR, "Cannot check if the body stream reaches the end");
+
+		if(eos_rc) break;
+
+		/* One more byte in the buffer, so that we are able to detect the size mismatch */
+		size_t rc = pstd_scope_stream_read(stream, ret + bytes_read, body_size + 1 - bytes_read);
+		if(ERROR_CODE(size_t) == rc)
+			ERROR_LOG_GOTO(ERR, "Cannot read the body stream");
+
+		bytes_read += rc;
+
+		/* The stream is waiting for the data source, or the size isn't what we expected */
+		if(rc == 0 || bytes_read > body_size)
+			goto BYPASS;
+	}
+
+	if(bytes_read != body_size)
+		goto BYPASS;
+
+	if(ERROR_CODE(int) == pstd_scope_stream_close(stream))
+		ERROR_LOG_GOTO(ERR, "Cannot close the body stream");
+
+	return ret;
+BYPASS:
+	LOG_DEBUG("The body stream can not be read at once, bypass the compressed response cache");
+	if(ERROR_CODE(int) == pstd_scope_stream_close(stream))
+		LOG_WARNING("Cannot close the body stream");
+	free(ret);
+	return NULL;
+ERR:
+	if(NULL != stream) pstd_scope_stream_close(stream);
+	free(ret);
+	return (void*)ERROR_CODE(uintptr_t);
+}
+
+/**
+ * @brief Compress the body buffer
+ * @return The compressed data or NULL on error
+ **/
+static inline void* _compress(const void* body, size_t body_size, compress_cache_encoding_t encoding, int level, size_t* result_size)
+{
+	switch(encoding)
+	{
+#ifdef HAS_ZLIB
+		case COMPRESS_CACHE_ENCODING_GZIP:
+			return zlib_token_compress(body, body_size, ZLIB_TOKEN_FORMAT_GZIP, level, result_size);
+		case COMPRESS_CACHE_ENCODING_DEFLATE:
+			return zlib_token_compress(body, body_size, ZLIB_TOKEN_FORMAT_DEFLATE, level, result_size);
+#endif
+#ifdef HAS_BROTLI
+		case COMPRESS_CACHE_ENCODING_BR:
+			return brotli_token_compress(body, body_size, level, result_size);
+#endif
+		default:
+			(void)body;
+			(void)body_size;
+			(void)level;
+			(void)result_size;
+			ERROR_PTR_RETURN_LOG("Unsupported encoding algorithm");
+	}
+}
+
+scope_token_t compress_cache_encode(scope_token_t body_token, size_t body_size, compress_cache_encoding_t encoding, int level, size_t* result_size)
+{
+	if(ERROR_CODE(scope_token_t) == body_token || 0 == body_token || NULL == result_size)
+		ERROR_RETURN_LOG(scope_token_t, "Invalid arguments");
+
+	_entry_t* entry = NULL;
+	uint64_t hash[2];
+	int locked = 0;
+	void* body = _read_body(body_token, body_size);
+
+	if((void*)ERROR_CODE(uintptr_t) == body)
+		ERROR_RETURN_LOG(scope_token_t, "Cannot read the body");
+
+	if((errno = pthread_mutex_lock(&_cache_mutex)) != 0)
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot lock the compressed response cache mutex");
+
+	if(NULL == body)
+	{
+		_cache.stat.bypasses ++;
+		if((errno = pthread_mutex_unlock(&_cache_mutex)) != 0)
+			ERROR_RETURN_LOG_ERRNO(scope_token_t, "Cannot release the compressed response cache mutex");
+		return 0;
+	}
+
+	locked = 1;
+
+	murmurhash3_128(body, body_size, _cache.hash_seed, hash);
+
+	if(NULL != (entry = _find(hash, body_size, encoding, level)))
+	{
+		_cache.stat.hits ++;
+		LOG_DEBUG("Compressed response cache hit");
+		free(body);
+		body = NULL;
+	}
+	else
+	{
+		_cache.stat.misses ++;
+
+		locked = 0;
+		if((errno = pthread_mutex_unlock(&_cache_mutex)) != 0)
+			ERROR_LOG_ERRNO_GOTO(ERR, "Cannot release the compressed response cache mutex");
+
+		/* We don't want to block other threads while compressing */
+		if(NULL == (entry = (_entry_t*)malloc(sizeof(_entry_t))))
+			ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the cache entry");
+
+		memset(entry, 0, sizeof(_entry_t));
+
+		if(NULL == (entry->data = _compress(body, body_size, encoding, level, &entry->size)))
+			ERROR_LOG_GOTO(ERR, "Cannot compress the body");
+
+		free(body);
+		body = NULL;
+
+		entry->hash[0] = hash[0];
+		entry->hash[1] = hash[1];
+		entry->body_size = body_size;
+		entry->encoding = encoding;
+		entry->level = level;
+
+		if((errno = pthread_mutex_lock(&_cache_mutex)) != 0)
+			ERROR_LOG_ERRNO_GOTO(ERR, "Cannot lock the compressed response cache mutex");
+
+		locked = 1;
+
+		/* Other thread may have compressed the same body at the same time */
+		_entry_t* existing = _find(hash, body_size, encoding, level);
+		if(NULL != existing)
+		{
+			_entry_free(entry);
+			entry = existing;
+		}
+		else
+		{
+			entry->refcnt = 1;
+			_insert(entry);
+		}
+	}
+
+	locked = 0;
+	if((errno = pthread_mutex_unlock(&_cache_mutex)) != 0)
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot release the compressed response cache mutex");
+
+	scope_entity_t ent = {
+		.data = entry,
+		.copy_func = _copy,
+		.free_func = _free,
+		.open_func = _open,
+		.close_func = _close,
+		.read_func = _read,
+		.eos_func = _eos
+	};
+
+	*result_size = entry->size;
+
+	scope_token_t ret = pstd_scope_add(&ent);
+	if(ERROR_CODE(scope_token_t) == ret)
+	{
+		_release(entry);
+		ERROR_RETURN_LOG(scope_token_t, "Cannot add the compressed body to the RLS");
+	}
+
+	return ret;
+ERR:
+	if(locked) pthread_mutex_unlock(&_cache_mutex);
+	if(NULL != entry && entry->refcnt == 0)
+	{
+		if(NULL != entry->data) free(entry->data);
+		free(entry);
+	}
+	if(NULL != body) free(body);
+	return ERROR_CODE(scope_token_t);
+}
@@ -0,0 +1,33 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+/**
+ * @brief The brotli RLS token wrapper
+ * @file network/http/render/include/brotli_token.h
+ **/
+#ifndef __BROTLI_TOKEN_H__
+#define __BROTLI_TOKEN_H__
+
+#ifdef HAS_BROTLI
+
+/**
+ * @brief Encode an original token to a brotli compressed data
+ * @param data_token The data token to encode
+ * @param level The compression level
+ * @return The result token
+ **/
+scope_token_t brotli_token_encode(scope_token_t data_token, int level);
+
+/**
+ * @brief Compress a memory buffer with brotli in one shot
+ * @param data The data to compress
+ * @param size The size of the data
+ * @param level The compression level
+ * @param result_size The buffer used to return the size of the compressed data
+ * @return The newly allocated buffer which carries the compressed data, NULL on error
+ * @note The caller should dispose the buffer with free
+ **/
+void* brotli_token_compress(const void* data, size_t size, int level, size_t* result_size);
+#endif
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+/**
+ * @brief The compressed response cache
+ * @details Compressing the same static content for every request is the most expensive
+ *          part of rendering a compressed response. This cache keeps the compressed bytes
+ *          keyed by the content hash of the body, the encoding and the compression level,
+ *          so that the following requests for the same body can be served without running
+ *          the compressor again. The cache is shared by all the render servlet instances
+ *          and all the worker threads.
+ * @file network/http/render/include/compress_cache.h
+ **/
+#ifndef __COMPRESS_CACHE_H__
+#define __COMPRESS_CACHE_H__
+
+/**
+ * @brief The encoding algorithm of a cached entry
+ **/
+typedef enum {
+	COMPRESS_CACHE_ENCODING_GZIP,     /*!< The gzip encoding */
+	COMPRESS_CACHE_ENCODING_DEFLATE,  /*!< The deflate encoding */
+	COMPRESS_CACHE_ENCODING_BR        /*!< The brotli encoding */
+} compress_cache_encoding_t;
+
+/**
+ * @brief Initialize the compressed response cache
+ * @note The cache is shared by the servlet instances, so the size limit will be the largest limit
+ *       among all the servlet instances
+ * @param limit The maximum number of compressed bytes the cache can hold
+ * @return status code
+ **/
+int compress_cache_init(size_t limit);
+
+/**
+ * @brief Finalize the compressed response cache
+ * @note The cache is actually disposed when the last servlet instance using it is finalized
+ * @return status code
+ **/
+int compress_cache_finalize(void);
+
+/**
+ * @brief Get the compressed version of the body from the cache, or compress the body and put the result
+ *        into the cache if there's no such entry
+ * @param body_token The RLS token for the uncompressed body
+ * @param body_size The size of the uncompressed body
+ * @param encoding The encoding algorithm
+ * @param level The compression level
+ * @param result_size The buffer used to return the size of the compressed body
+ * @return The RLS token carries the compressed body, 0 if the body can not be served from the cache
+ *         (in this case the caller should fallback to the streaming compressor), or error code
+ **/
+scope_token_t compress_cache_encode(scope_token_t body_token, size_t body_size, compress_cache_encoding_t encoding, int level, size_t* result_size);
+
+#endif /* __COMPRESS_CACHE_H__ */
@@ -28,6 +28,10 @@ typedef struct {
 	uint8_t       compress_level:4;   /*!< The compression level */
 	uint8_t       max_chunk_size;     /*!< The max chunk size in number of pages for a chunked encoding */
 
+	/* Compressed Response Cache */
+	size_t        cache_size;         /*!< The maximum number of compressed bytes in the cache, 0 means the cache is disabled */
+	size_t        cache_max_body;     /*!< The largest uncompressed body that can be put into the cache */
+
 	/* Reverse Proxy */
 	uint8_t       reverse_proxy:1;    /*!< If this servlet should accept reverse proxy */
 
@@ -23,6 +23,18 @@ typedef enum {
  * @return The result token
  **/
 scope_token_t zlib_token_encode(scope_token_t data_token, zlib_token_format_t format, int level);
+
+/**
+ * @brief Compress a memory buffer with zlib in one shot
+ * @param data The data to compress
+ * @param size The size of the data
+ * @param format The format we use, either gzip or deflate
+ * @param level The compression level
+ * @param result_size The buffer used to return the size of the compressed data
+ * @return The newly allocated buffer which carries the compressed data, NULL on error
+ * @note The caller should dispose the buffer with free
+ **/
+void* zlib_token_compress(const void* data, size_t size, zlib_token_format_t format, int level, size_t* result_size);
 #endif
 
 #endif
@@ -33,7 +33,7 @@ static int _opt_callback_no_val(pstd_option_data_t data)
 #endif
 
 #ifdef HAS_BROTLI
-		case 'b':
+		case 'B':
 			opt->br_enabled = 1;
 			opt->chunked_enabled = 1;
 			break;
@@ -65,9 +65,19 @@ static int _opt_callback_numeric(pstd_option_data_t data)
 		case 'L':
 			opt->compress_level = ((uint8_t)val & 0xfu);
 			break;
-		case 'S':
+		case 'C':
 			opt->max_chunk_size = ((uint8_t)val & 0xffu);
 			break;
+		case 0:
+			if(val < 0)
+				ERROR_RETURN_LOG(int, "Invalid cache size");
+			if(strcmp("cache-size", data.current_option->long_opt) == 0)
+				opt->cache_size = (size_t)val;
+			else if(strcmp("cache-max-body", data.current_option->long_opt) == 0)
+				opt->cache_max_body = (size_t)val;
+			else
+				ERROR_RETURN_LOG(int, "Invalid option");
+			break;
 		default:
 			ERROR_RETURN_LOG(int, "Invalid option");
 	}
@@ -166,9 +176,9 @@ static pstd_option_t _options[] = {
 #ifdef HAS_BROTLI
 	{
 		.long_opt    = "br",
-		.short_opt   = 'b',
+		.short_opt   = 'B',
 		.pattern     = "",
-		.description = "Use BR compression",
+		.description = "Enable brotli compression",
 		.handler     = _opt_callback_no_val,
 		.args        = NULL
 	},
@@ -197,6 +207,20 @@ static pstd_option_t _options[] = {
 		.handler     = _opt_callback_numeric,
 		.args        = NULL
 	},
+	{
+		.long_opt    = "cache-size",
+		.pattern     = "I",
+		.description = "The size limit of the compressed response cache in bytes, 0 disables the cache",
+		.handler     = _opt_callback_numeric,
+		.args        = NULL
+	},
+	{
+		.long_opt    = "cache-max-body",
+		.pattern     = "I",
+		.description = "The largest uncompressed body in bytes that can be put into the compressed response cache",
+		.handler     = _opt_callback_numeric,
+		.args        = NULL
+	},
 	{
 		.long_opt    = "server-name",
 		.short_opt   = 's',
@@ -284,6 +308,8 @@ int options_parse(uint32_t argc, char const* const* argv, options_t* buf)
 
 	buf->compress_level = 5;
 	buf->max_chunk_size = 8;
+	buf->cache_size = 32u << 20;
+	buf->cache_max_body = 1u << 20;
 
 	if(ERROR_CODE(int) == pstd_option_sort(_options, sizeof(_options) / sizeof(_options[0])))
 		ERROR_RETURN_LOG(int, "Cannot sort the options array");
@@ -15,7 +15,9 @@
 
 #include <options.h>
 #include <zlib_token.h>
+#include <brotli_token.h>
 #include <chunked.h>
+#include <compress_cache.h>
 
 enum {
 	_ENCODING_GZIP    = 1,
@@ -58,6 +60,8 @@ typedef struct {
 	uint32_t             BODY_RANGED;        /*!< Indicates if we got a ranged body */
 
 	uint32_t             PROTOCOL_ERROR_BAD_REQ;  /*!< Indicate we have got a bad request */
+
+	uint32_t             cache_enabled:1;    /*!< If this servlet uses the compressed response cache */
 } ctx_t;
 
 static int _init(uint32_t argc, char const* const* argv, void* ctxmem)
@@ -109,6 +113,14 @@ static int _init(uint32_t argc, char const* const* argv, void* ctxmem)
 			ERROR_RETURN_LOG(int, "Cannot get the accessor for proxy.token");
 	}
 
+	ctx->cache_enabled = 0;
+	if(ctx->opts.cache_size > 0 && (ctx->opts.gzip_enabled || ctx->opts.deflate_enabled || ctx->opts.br_enabled))
+	{
+		if(ERROR_CODE(int) == compress_cache_init(ctx->opts.cache_size))
+			ERROR_RETURN_LOG(int, "Cannot initialize the compressed response cache");
+		ctx->cache_enabled = 1;
+	}
+
 	return 0;
 }
 
@@ -124,6 +136,9 @@ static int _unload(void* ctxmem)
 	if(ERROR_CODE(int) == pstd_type_model_free(ctx->type_model))
 		rc = ERROR_CODE(int);
 
+	if(ctx->cache_enabled && ERROR_CODE(int) == compress_cache_finalize())
+		rc = ERROR_CODE(int);
+
 	return rc;
 }
 
@@ -440,13 +455,60 @@ static inline int _write_connection_field(pstd_bio_t* out, pipe_t res, int needs
 	return 0;
 }
 
+/**
+ * @brief Try to serve the compressed body from the compressed response cache
+ * @param ctx The servlet context
+ * @param inst The type instance
+ * @param body_flags The body flags
+ * @param algorithm The encoding algorithm
+ * @param body_token The buffer for the body token, if the body is served from the cache, the token will be replaced by the compressed body
+ * @param body_size The buffer used to return the size of the compressed body
+ * @return 1 if the body is served from the cache, 0 if the caller should use the streaming compressor, error code on error
+ **/
+static inline int _compress_cached(const ctx_t* ctx, pstd_type_instance_t* inst, uint32_t body_flags, uint32_t algorithm, scope_token_t* body_token, uint64_t* body_size)
+{
+	compress_cache_encoding_t encoding;
+
+	/* We don't want every range of the body occupies a cache entry */
+	if(!ctx->cache_enabled || (body_flags & (ctx->BODY_SIZE_UNKNOWN | ctx->BODY_RANGED)))
+		return 0;
+
+	if((algorithm & _ENCODING_GZIP))
+		encoding = COMPRESS_CACHE_ENCODING_GZIP;
+	else if((algorithm & _ENCODING_DEFLATE))
+		encoding = COMPRESS_CACHE_ENCODING_DEFLATE;
+	else if((algorithm & _ENCODING_BR))
+		encoding = COMPRESS_CACHE_ENCODING_BR;
+	else
+		return 0;
+
+	uint64_t size = PSTD_TYPE_INST_READ_PRIMITIVE(uint64_t, inst, ctx->a_body_size);
+	if(ERROR_CODE(uint64_t) == size)
+		ERROR_RETURN_LOG(int, "Cannot determine the size of the body");
+
+	if(size > ctx->opts.cache_max_body)
+		return 0;
+
+	size_t result_size;
+	scope_token_t result = compress_cache_encode(*body_token, (size_t)size, encoding, ctx->opts.compress_level, &result_size);
+	if(ERROR_CODE(scope_token_t) == result)
+		ERROR_RETURN_LOG(int, "Cannot compress the body with the compressed response cache");
+
+	if(result == 0) return 0;
+
+	*body_token = result;
+	*body_size = result_size;
+
+	return 1;
+}
+
 static int _exec(void* ctxmem)
 {
 	uint16_t status_code;
 	uint32_t body_flags, algorithm, protocol_error;
 	uint64_t body_size = ERROR_CODE(uint64_t);
 	scope_token_t body_token;
-	int eof_rc;
+	int eof_rc, cached = 0;
 
 	pstd_bio_t* out = NULL;
 	ctx_t* ctx = (ctx_t*)ctxmem;
@@ -565,7 +627,16 @@ static int _exec(void* ctxmem)
 	if(ERROR_CODE(scope_token_t) == (body_token = PSTD_TYPE_INST_READ_PRIMITIVE(scope_token_t, type_inst, ctx->a_body_token)))
 		ERROR_LOG_GOTO(ERR, "Cannot get the request body RLS token");
 
-	if(body_token != 0)
+	if(body_token != 0 && (algorithm & _ENCODING_COMPRESSED))
+	{
+		if(ERROR_CODE(int) == (cached = _compress_cached(ctx, type_inst, body_flags, algorithm, &body_token, &body_size)))
+			ERROR_LOG_GOTO(ERR, "Cannot serve the body from the compressed response cache");
+
+		/* We know the size of the compressed body, so the chunked encoding is not needed */
+		if(cached) algorithm &= ~(uint32_t)_ENCODING_CHUNKED;
+	}
+
+	if(body_token != 0 && !cached)
 	{
 #if defined(HAS_ZLIB) || defined(HAS_BROTLI)
 		if(0);
@@ -589,7 +660,10 @@ static int _exec(void* ctxmem)
 #ifdef HAS_BROTLI
 		else if((algorithm & _ENCODING_BR))
 		{
-			/* TODO: Brotli support */
+			if(ERROR_CODE(scope_token_t) == (body_token = brotli_token_encode(body_token, ctx->opts.compress_level)))
+				ERROR_LOG_GOTO(ERR, "Cannot encode the body with Brotli encoder");
+			else
+				body_flags |= ctx->BODY_SIZE_UNKNOWN;
 		}
 #endif
 
@@ -605,7 +679,9 @@ static int _exec(void* ctxmem)
 		}
 	}
 
-	if(!(body_flags & ctx->BODY_SIZE_UNKNOWN))
+	if(cached)
+		LOG_DEBUG("The compressed body is served from the compressed response cache");
+	else if(!(body_flags & ctx->BODY_SIZE_UNKNOWN))
 	{
 		if(ERROR_CODE(uint64_t) == (body_size = PSTD_TYPE_INST_READ_PRIMITIVE(uint64_t, type_inst, ctx->a_body_size)))
 			ERROR_LOG_GOTO(ERR, "Cannot determine the size of the body");
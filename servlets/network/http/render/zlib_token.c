@@ -181,4 +181,45 @@ ERR:
 	pstd_mempool_free(zs);
 	return ERROR_CODE(scope_token_t);
 }
+
+void* zlib_token_compress(const void* data, size_t size, zlib_token_format_t format, int level, size_t* result_size)
+{
+	if((NULL == data && size > 0) || NULL == result_size || level < 0 || level > 9 || size > UINT32_MAX)
+		ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	z_stream zs = {
+		.zalloc = Z_NULL,
+		.zfree  = Z_NULL,
+		.opaque = Z_NULL
+	};
+
+	int window_bits = format == ZLIB_TOKEN_FORMAT_GZIP ? 31 : 15;
+
+	if(Z_OK != deflateInit2(&zs, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY))
+		ERROR_PTR_RETURN_LOG("Cannot initialize the zlib stream");
+
+	/* The gzip header and trailer is not counted by deflateBound */
+	size_t bound = deflateBound(&zs, (uLong)size) + 32;
+	uint8_t* ret = (uint8_t*)malloc(bound);
+	if(NULL == ret)
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the compressed data");
+
+	zs.next_in = (uint8_t*)(uintptr_t)data;
+	zs.avail_in = (uint32_t)size;
+	zs.next_out = ret;
+	zs.avail_out = (uint32_t)bound;
+
+	if(Z_STREAM_END != deflate(&zs, Z_FINISH))
+		ERROR_LOG_GOTO(ERR, "Zlib returns an error: %s", zs.msg == NULL ? "unknown" : zs.msg);
+
+	*result_size = (size_t)zs.total_out;
+
+	deflateEnd(&zs);
+
+	return ret;
+ERR:
+	if(NULL != ret) free(ret);
+	deflateEnd(&zs);
+	return NULL;
+}
 #endif
@@ -45,6 +45,32 @@ extern "C" {
 		json_model_op_type_t type; /*!< Only used for primitive: The type of this data field */
 	} json_model_op_t;
 
+	/**
+	 * @brief The type of a node in the JSON model tree
+	 **/
+	typedef enum {
+		JSON_MODEL_NODE_VALUE,      /*!< A primitive value, which is written by a single write operation */
+		JSON_MODEL_NODE_OBJECT,     /*!< A JSON object, the children are the fields */
+		JSON_MODEL_NODE_ARRAY       /*!< A JSON array, the N-th child is the N-th element */
+	} json_model_node_type_t;
+
+	/**
+	 * @brief A node in the JSON model tree
+	 * @details The operation array describes the type as a sequence that visits the type fields in order, which
+	 *          is what we need when we walk a parsed document. The model tree describes the same thing in the
+	 *          shape of a JSON document, so that a streaming decoder can find the write operation for a value
+	 *          directly from the key path it has seen.
+	 **/
+	typedef struct {
+		json_model_node_type_t type;     /*!< The type of the node */
+		uint32_t               op;       /*!< Only used for value node: The index of the write operation */
+		const char*            name;     /*!< The field name of this node, NULL if this node is an array element or the root */
+		size_t                 name_len; /*!< The length of the field name */
+		uint32_t               nchild;   /*!< The number of children */
+		uint32_t               cap;      /*!< The capacity of the children array */
+		uint32_t*              child;    /*!< The node index of the children */
+	} json_model_node_t;
+
 	/**
 	 * @brief The output spec for each output ports
 	 **/
@@ -55,6 +81,9 @@ extern "C" {
 		uint32_t            nops;       /*!< The number of operations we need to be done for this type */
 		json_model_op_t*    ops;        /*!< The operations we need to dump the JSON data to the plumber type */
 		pstd_type_model_t*  tm;         /*!< The type model object */
+		uint32_t            nnodes;     /*!< The number of nodes in the model tree */
+		uint32_t            node_cap;   /*!< The capacity of the node array */
+		json_model_node_t*  nodes;      /*!< The model tree, the first node is the root */
 	} json_model_t;
 
 	/**
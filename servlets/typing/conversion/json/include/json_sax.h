@@ -0,0 +1,52 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+/**
+ * @file servlets/typing/conversion/json/include/json_sax.h
+ * @brief The streaming JSON decoder which writes the JSON data to the typed pipes
+ * @details Instead of building the document tree and walking it with the JSON model operations, this decoder
+ *          takes the SAX events from the JSON reader and locates the target field from the JSON model tree
+ *          as the tokens stream in. The values are kept in a per-thread scratch area, the strings are copied
+ *          to a per-thread arena, and they are written to the type instance only after the entire document
+ *          has been parsed successfully, so an invalid document leaves the typed pipes untouched.
+ **/
+
+#ifndef __JSON_SAX_H__
+#define __JSON_SAX_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * @brief Initialize the streaming decoder
+	 * @note The decoder is shared by the servlet instances, and it's actually initialized when the
+	 *       first servlet instance calls this function
+	 * @return status code
+	 **/
+	int json_sax_init(void);
+
+	/**
+	 * @brief Finalize the streaming decoder
+	 * @note The decoder is actually finalized when the last servlet instance calls this function
+	 * @return status code
+	 **/
+	int json_sax_finalize(void);
+
+	/**
+	 * @brief Decode the JSON document and write the data to the typed pipes
+	 * @param models The JSON models for the typed pipes
+	 * @param count The number of JSON models
+	 * @param data The JSON document
+	 * @param size The size of the JSON document
+	 * @param inst The type instance we should write to
+	 * @note If the document is not a valid JSON, nothing will be written and the function still succeeds
+	 * @return status code
+	 **/
+	int json_sax_decode(const json_model_t* models, uint32_t count, const char* data, size_t size, pstd_type_instance_t* inst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __JSON_SAX_H__ */
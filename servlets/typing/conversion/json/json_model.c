@@ -196,6 +196,106 @@ ERR:
 	return ERROR_CODE(int);
 }
 
+/**
+ * @brief Append a new node to the model tree
+ * @param jm The JSON model
+ * @param name The field name of the node, NULL if this is not an object field
+ * @return The index of the new node or error code
+ **/
+static inline uint32_t _new_node(json_model_t* jm, const char* name)
+{
+	if(jm->node_cap < jm->nnodes + 1)
+	{
+		uint32_t new_cap = jm->node_cap == 0 ? 32 : jm->node_cap * 2;
+		json_model_node_t* new_arr = (json_model_node_t*)realloc(jm->nodes, sizeof(json_model_node_t) * new_cap);
+		if(NULL == new_arr) ERROR_RETURN_LOG_ERRNO(uint32_t, "Cannot resize the node array");
+		jm->nodes = new_arr;
+		jm->node_cap = new_cap;
+	}
+
+	json_model_node_t* node = jm->nodes + jm->nnodes;
+	memset(node, 0, sizeof(*node));
+	node->type = JSON_MODEL_NODE_OBJECT;
+	node->name = name;
+	node->name_len = name == NULL ? 0 : strlen(name);
+
+	return jm->nnodes ++;
+}
+
+/**
+ * @brief Append a child to the node
+ * @param jm The JSON model
+ * @param parent The parent node index
+ * @param child The child node index
+ * @return status code
+ **/
+static inline int _add_child(json_model_t* jm, uint32_t parent, uint32_t child)
+{
+	json_model_node_t* node = jm->nodes + parent;
+	if(node->cap < node->nchild + 1)
+	{
+		uint32_t new_cap = node->cap == 0 ? 4 : node->cap * 2;
+		uint32_t* new_arr = (uint32_t*)realloc(node->child, sizeof(uint32_t) * new_cap);
+		if(NULL == new_arr) ERROR_RETURN_LOG_ERRNO(int, "Cannot resize the child array");
+		node->child = new_arr;
+		node->cap = new_cap;
+	}
+
+	node->child[node->nchild ++] = child;
+	return 0;
+}
+
+/**
+ * @brief Build the model tree from the operation array
+ * @param jm The JSON model
+ * @return status code
+ **/
+static int _build_tree(json_model_t* jm)
+{
+	uint32_t stack[1024];
+	uint32_t sp = 0, pc;
+
+	if(ERROR_CODE(uint32_t) == (stack[sp++] = _new_node(jm, NULL)))
+		ERROR_RETURN_LOG(int, "Cannot create the root node");
+
+	for(pc = 0; pc < jm->nops; pc ++)
+	{
+		const json_model_op_t* op = jm->ops + pc;
+		if(sp == 0) ERROR_RETURN_LOG(int, "Invalid stack operation");
+		uint32_t cur = stack[sp - 1];
+		switch(op->opcode)
+		{
+			case JSON_MODEL_OPCODE_OPEN:
+			case JSON_MODEL_OPCODE_OPEN_SUBS:
+			{
+				if(sp >= sizeof(stack) / sizeof(stack[0])) ERROR_RETURN_LOG(int, "Operation stack overflow");
+				uint32_t child = _new_node(jm, op->opcode == JSON_MODEL_OPCODE_OPEN ? op->field : NULL);
+				if(ERROR_CODE(uint32_t) == child)
+					ERROR_RETURN_LOG(int, "Cannot create the child node");
+				if(op->opcode == JSON_MODEL_OPCODE_OPEN_SUBS)
+				{
+					jm->nodes[cur].type = JSON_MODEL_NODE_ARRAY;
+					if(op->index != jm->nodes[cur].nchild)
+						ERROR_RETURN_LOG(int, "Unexpected subscript %u", op->index);
+				}
+				if(ERROR_CODE(int) == _add_child(jm, cur, child))
+					ERROR_RETURN_LOG(int, "Cannot append the child node");
+				stack[sp ++] = child;
+				break;
+			}
+			case JSON_MODEL_OPCODE_CLOSE:
+				sp --;
+				break;
+			case JSON_MODEL_OPCODE_WRITE:
+				jm->nodes[cur].type = JSON_MODEL_NODE_VALUE;
+				jm->nodes[cur].op = pc;
+				break;
+		}
+	}
+
+	return 0;
+}
+
 static int _assert_build_type_model(pipe_t pipe, const char* type_name, void* data)
 {
 	json_model_t* model = (json_model_t*)data;
@@ -227,7 +327,7 @@ static int _assert_build_type_model(pipe_t pipe, const char* type_name, void* da
 		if(ERROR_CODE(pstd_type_accessor_t) == (model->ops[0].acc = pstd_type_model_get_accessor(model->tm, pipe, is_str ? "token" : "value")))
 			ERROR_RETURN_LOG(int, "Cannot get the accessor for primitive type %s", type_name);
 		model->nops = 1;
-		return 0;
+		return _build_tree(model);
 	}
 
 	_traverse_data_t td = {
@@ -243,6 +343,9 @@ static int _assert_build_type_model(pipe_t pipe, const char* type_name, void* da
 		ERROR_RETURN_LOG(int, "Cannot traverse the type %s", type_name);
 	}
 
+	if(ERROR_CODE(int) == _build_tree(model))
+		ERROR_RETURN_LOG(int, "Cannot build the model tree for type %s", type_name);
+
 	return 0;
 
 }
@@ -286,5 +389,13 @@ int json_model_free(json_model_t* model)
 		free(model->ops);
 	}
 
+	if(model->nodes != NULL)
+	{
+		for(j = 0; j < model->nnodes; j ++)
+			if(NULL != model->nodes[j].child)
+				free(model->nodes[j].child);
+		free(model->nodes);
+	}
+
 	return 0;
 }
@@ -0,0 +1,538 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <new>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wstrict-overflow"
+
+#include <rapidjson/memorystream.h>
+#include <rapidjson/reader.h>
+
+#include <pstd.h>
+#include <pstd/types/string.h>
+#include <pservlet.h>
+#include <proto.h>
+
+#include <json_model.h>
+#include <json_sax.h>
+
+/**
+ * @brief The kind of value we have seen for a model node
+ **/
+typedef enum {
+	_KIND_NONE,       /*!< The value has a type that can not be written to the field, the default value will be written */
+	_KIND_INT,        /*!< The value is an integer which fits int64 */
+	_KIND_BIG,        /*!< The value is an integer which only fits uint64 */
+	_KIND_DOUBLE,     /*!< The value is a float point number */
+	_KIND_STRING      /*!< The value is a string, which is in the arena */
+} _kind_t;
+
+/**
+ * @brief The per-request state of a model node
+ **/
+typedef struct {
+	uint8_t  seen;    /*!< If we have seen this node in the document, only the first occurrence of a field counts */
+	uint8_t  kind;    /*!< The kind of the value, only used by the value node */
+	union {
+		int64_t  i;   /*!< The integer value */
+		double   d;   /*!< The float point value */
+		struct {
+			uint32_t off;  /*!< The offset of the string in the arena */
+			uint32_t len;  /*!< The length of the string */
+		}        s;   /*!< The string value */
+	};
+} _slot_t;
+
+/**
+ * @brief The per-thread scratch area used by the decoder
+ **/
+typedef struct {
+	rapidjson::Reader reader;     /*!< The JSON reader, we keep it so that its internal stack can be reused */
+	uint32_t          slot_cap;   /*!< The capacity of the slot array */
+	_slot_t*          slots;      /*!< The slot array */
+	size_t            arena_cap;  /*!< The capacity of the string arena */
+	size_t            arena_size; /*!< The used bytes in the string arena */
+	char*             arena;      /*!< The string arena */
+} _scratch_t;
+
+/**
+ * @brief The type of a frame in the decoder stack
+ **/
+typedef enum {
+	_FRAME_TOP,       /*!< The top level object, the keys are the pipe names */
+	_FRAME_OBJECT,    /*!< An object mapped to a model node */
+	_FRAME_ARRAY      /*!< An array mapped to a model node */
+} _frame_type_t;
+
+/**
+ * @brief A frame in the decoder stack
+ **/
+typedef struct {
+	_frame_type_t       type;   /*!< The frame type */
+	const json_model_t* model;  /*!< The model this frame belongs to */
+	uint32_t            base;   /*!< The first slot of the model */
+	uint32_t            node;   /*!< The model node */
+	uint32_t            next;   /*!< Only used by the array frame: the index of the next element */
+} _frame_t;
+
+/**
+ * @brief A model node a JSON value maps to
+ **/
+typedef struct {
+	const json_model_t* model;  /*!< The model */
+	uint32_t            base;   /*!< The first slot of the model */
+	uint32_t            node;   /*!< The node index */
+} _target_t;
+
+/**
+ * @brief The number of servlet instances using the decoder
+ **/
+static uint32_t _init_count;
+
+/**
+ * @brief The thread local scratch areas
+ **/
+static pstd_thread_local_t* _scratch;
+
+static void* _scratch_alloc(uint32_t tid, const void* data)
+{
+	(void)tid;
+	(void)data;
+	_scratch_t* ret = new (std::nothrow) _scratch_t();
+	if(NULL == ret) ERROR_PTR_RETURN_LOG("Cannot allocate memory for the decoder scratch area");
+	return ret;
+}
+
+static int _scratch_dealloc(void* mem, const void* data)
+{
+	(void)data;
+	_scratch_t* scratch = (_scratch_t*)mem;
+	if(NULL != scratch->slots) free(scratch->slots);
+	if(NULL != scratch->arena) free(scratch->arena);
+	delete scratch;
+	return 0;
+}
+
+/**
+ * @brief The SAX handler which maps the JSON tokens to the model nodes
+ **/
+class _handler_t : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, _handler_t> {
+	const json_model_t* _models;      /*!< The models */
+	uint32_t            _count;       /*!< The number of models */
+	_scratch_t*         _s;           /*!< The scratch area */
+	uint32_t            _skip;        /*!< The depth of the subtree we are currently ignoring, 0 if we are not ignoring */
+	int                 _pending;     /*!< If the last key maps to a model node */
+	_target_t           _key;         /*!< The node the last key maps to */
+	uint32_t            _sp;          /*!< The stack pointer */
+	_frame_t            _stack[1024]; /*!< The frame stack */
+
+	/**
+	 * @brief Find the model node for the value we are about to see and mark it seen
+	 * @param target The buffer used to return the target
+	 * @return If the value should be taken
+	 **/
+	inline bool _take(_target_t* target)
+	{
+		const _frame_t* frame = _stack + _sp - 1;
+		if(frame->type == _FRAME_ARRAY)
+		{
+			const json_model_node_t* node = frame->model->nodes + frame->node;
+			uint32_t idx = _stack[_sp - 1].next ++;
+			if(idx >= node->nchild) return false;
+			target->model = frame->model;
+			target->base  = frame->base;
+			target->node  = node->child[idx];
+		}
+		else
+		{
+			if(!_pending) return false;
+			_pending = 0;
+			*target = _key;
+		}
+
+		_slot_t* slot = _s->slots + target->base + target->node;
+		if(slot->seen) return false;
+		slot->seen = 1;
+		slot->kind = _KIND_NONE;
+		return true;
+	}
+
+	/**
+	 * @brief Handle a primitive value
+	 * @param kind The kind of the value
+	 * @return The slot for the value, NULL if the value should be ignored
+	 **/
+	inline _slot_t* _primitive(_kind_t kind)
+	{
+		_target_t target;
+		if(_skip > 0 || _sp == 0 || !_take(&target)) return NULL;
+		if(target.model->nodes[target.node].type != JSON_MODEL_NODE_VALUE) return NULL;
+		_slot_t* slot = _s->slots + target.base + target.node;
+		slot->kind = (uint8_t)kind;
+		return slot;
+	}
+
+	/**
+	 * @brief Handle the begining of an object or array
+	 * @param type The node type the value can map to
+	 * @return If we should continue
+	 **/
+	inline bool _start(json_model_node_type_t type)
+	{
+		if(_skip > 0)
+		{
+			_skip ++;
+			return true;
+		}
+
+		if(_sp == 0)
+		{
+			if(type == JSON_MODEL_NODE_OBJECT)
+			{
+				_stack[_sp].type = _FRAME_TOP;
+				_stack[_sp].model = NULL;
+				_sp ++;
+			}
+			else _skip = 1;
+			return true;
+		}
+
+		_target_t target;
+		if(!_take(&target) || target.model->nodes[target.node].type != type)
+		{
+			_skip = 1;
+			return true;
+		}
+
+		if(_sp >= sizeof(_stack) / sizeof(_stack[0]))
+		{
+			LOG_ERROR("Decoder stack overflow");
+			return false;
+		}
+
+		_frame_t* frame = _stack + (_sp ++);
+		frame->type  = type == JSON_MODEL_NODE_OBJECT ? _FRAME_OBJECT : _FRAME_ARRAY;
+		frame->model = target.model;
+		frame->base  = target.base;
+		frame->node  = target.node;
+		frame->next  = 0;
+		return true;
+	}
+
+	/**
+	 * @brief Handle the end of an object or array
+	 * @return If we should continue
+	 **/
+	inline bool _end(void)
+	{
+		if(_skip > 0) _skip --;
+		else if(_sp > 0) _sp --;
+		return true;
+	}
+public:
+	_handler_t(const json_model_t* models, uint32_t count, _scratch_t* scratch) :
+		_models(models), _count(count), _s(scratch), _skip(0), _pending(0), _sp(0) {}
+
+	bool Null()
+	{
+		_primitive(_KIND_NONE);
+		return true;
+	}
+
+	bool Bool(bool b)
+	{
+		(void)b;
+		_primitive(_KIND_NONE);
+		return true;
+	}
+
+	bool Int(int i)
+	{
+		return Int64(i);
+	}
+
+	bool Uint(unsigned u)
+	{
+		return Int64(u);
+	}
+
+	bool Int64(int64_t i)
+	{
+		_slot_t* slot = _primitive(_KIND_INT);
+		if(NULL != slot) slot->i = i;
+		return true;
+	}
+
+	bool Uint64(uint64_t u)
+	{
+		if(u <= INT64_MAX) return Int64((int64_t)u);
+		_primitive(_KIND_BIG);
+		return true;
+	}
+
+	bool Double(double d)
+	{
+		_slot_t* slot = _primitive(_KIND_DOUBLE);
+		if(NULL != slot) slot->d = d;
+		return true;
+	}
+
+	bool String(const char* str, rapidjson::SizeType len, bool copy)
+	{
+		(void)copy;
+		_slot_t* slot = _primitive(_KIND_STRING);
+		if(NULL == slot) return true;
+
+		if(_s->arena_cap < _s->arena_size + len + 1)
+		{
+			size_t new_cap = _s->arena_cap == 0 ? 4096 : _s->arena_cap;
+			for(;new_cap < _s->arena_size + len + 1; new_cap *= 2);
+			if(new_cap > UINT32_MAX)
+			{
+				LOG_ERROR("The string arena is too large");
+				return false;
+			}
+			char* new_arena = (char*)realloc(_s->arena, new_cap);
+			if(NULL == new_arena)
+			{
+				LOG_ERROR_ERRNO("Cannot resize the string arena");
+				return false;
+			}
+			_s->arena = new_arena;
+			_s->arena_cap = new_cap;
+		}
+
+		memcpy(_s->arena + _s->arena_size, str, len);
+		_s->arena[_s->arena_size + len] = 0;
+		slot->s.off = (uint32_t)_s->arena_size;
+		slot->s.len = len;
+		_s->arena_size += len + 1;
+		return true;
+	}
+
+	bool StartObject()
+	{
+		return _start(JSON_MODEL_NODE_OBJECT);
+	}
+
+	bool Key(const char* str, rapidjson::SizeType len, bool copy)
+	{
+		(void)copy;
+		if(_skip > 0) return true;
+		_pending = 0;
+		const _frame_t* frame = _stack + _sp - 1;
+		if(frame->type == _FRAME_TOP)
+		{
+			uint32_t i, base = 0;
+			for(i = 0; i < _count; base += _models[i].nnodes, i ++)
+				if(_models[i].nnodes > 0 && strlen(_models[i].name) == len && memcmp(_models[i].name, str, len) == 0)
+				{
+					_key.model = _models + i;
+					_key.base  = base;
+					_key.node  = 0;
+					_pending = 1;
+					break;
+				}
+		}
+		else
+		{
+			const json_model_node_t* node = frame->model->nodes + frame->node;
+			uint32_t i;
+			for(i = 0; i < node->nchild; i ++)
+			{
+				const json_model_node_t* child = frame->model->nodes + node->child[i];
+				if(child->name_len == len && memcmp(child->name, str, len) == 0)
+				{
+					_key.model = frame->model;
+					_key.base  = frame->base;
+					_key.node  = node->child[i];
+					_pending = 1;
+					break;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool EndObject(rapidjson::SizeType count)
+	{
+		(void)count;
+		return _end();
+	}
+
+	bool StartArray()
+	{
+		return _start(JSON_MODEL_NODE_ARRAY);
+	}
+
+	bool EndArray(rapidjson::SizeType count)
+	{
+		(void)count;
+		return _end();
+	}
+};
+
+/**
+ * @brief Write a decoded value to the type instance
+ * @param op The write operation
+ * @param slot The slot holding the value
+ * @param arena The string arena
+ * @param inst The type instance
+ * @return status code
+ **/
+static inline int _write_value(const json_model_op_t* op, const _slot_t* slot, const char* arena, pstd_type_instance_t* inst)
+{
+	switch(op->type)
+	{
+		case JSON_MODEL_TYPE_SIGNED:
+		case JSON_MODEL_TYPE_UNSIGNED:
+		{
+			int64_t value = 0;
+
+			if(slot->kind != _KIND_INT)
+				LOG_NOTICE("Missing integer field, using default 0");
+			else
+				value = slot->i;
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#	error("This doesn't work with big endian archtechture")
+#endif
+			/* In this case we must expand the sign bit */
+			if(op->type == JSON_MODEL_TYPE_SIGNED && value < 0)
+				value |= ~((1ll << (8 * op->size - 1)) - 1);
+
+			if(ERROR_CODE(int) == pstd_type_instance_write(inst, op->acc, &value, op->size))
+				ERROR_RETURN_LOG(int, "Cannot write field");
+			break;
+		}
+		case JSON_MODEL_TYPE_FLOAT:
+		{
+			double d_value = 0;
+			if(slot->kind == _KIND_DOUBLE)
+				d_value = slot->d;
+			else if(slot->kind == _KIND_INT)
+				d_value = (double)slot->i;
+			else
+				LOG_NOTICE("Missing double field, using default 0");
+			float  f_value = (float)d_value;
+			void* data_to_write = op->size == sizeof(double) ? (void*)&d_value : (void*)&f_value;
+			if(ERROR_CODE(int) == pstd_type_instance_write(inst, op->acc, data_to_write, op->size))
+				ERROR_RETURN_LOG(int, "Cannot write field");
+			break;
+		}
+		case JSON_MODEL_TYPE_STRING:
+		{
+			const char* str = "(null)";
+			if(slot->kind != _KIND_STRING)
+				LOG_NOTICE("Missing string field, using default (null)");
+			else
+				str = arena + slot->s.off;
+			/* The string is NUL terminated in the arena, and we stop at the first NUL as the DOM decoder does */
+			size_t len = strlen(str);
+			pstd_string_t* pstd_str = pstd_string_new_scoped(len + 1);
+			if(NULL == pstd_str) ERROR_RETURN_LOG(int, "Cannot allocate new pstd string object");
+			if(ERROR_CODE(size_t) == pstd_string_write(pstd_str, str, len))
+			{
+				pstd_string_free(pstd_str);
+				ERROR_RETURN_LOG(int, "Cannot write string to the pstd string object");
+			}
+
+			scope_token_t token = pstd_string_commit(pstd_str);
+			if(ERROR_CODE(scope_token_t) == token)
+			{
+				pstd_string_free(pstd_str);
+				ERROR_RETURN_LOG(int, "Cannot commit the string to the RLS");
+			}
+			/* From this point, we lose the ownership of the RLS object */
+			if(ERROR_CODE(int) == pstd_type_instance_write(inst, op->acc, &token, sizeof(scope_token_t)))
+				ERROR_RETURN_LOG(int, "Cannot write the RLS token to the output pipe");
+			break;
+		}
+	}
+
+	return 0;
+}
+
+int json_sax_init(void)
+{
+	if(_init_count == 0 && NULL == (_scratch = pstd_thread_local_new(_scratch_alloc, _scratch_dealloc, NULL)))
+		ERROR_RETURN_LOG(int, "Cannot initialize the thread local scratch area");
+
+	_init_count ++;
+	return 0;
+}
+
+int json_sax_finalize(void)
+{
+	if(_init_count == 0)
+		ERROR_RETURN_LOG(int, "The decoder is not initialized");
+
+	if(0 == --_init_count && ERROR_CODE(int) == pstd_thread_local_free(_scratch))
+		ERROR_RETURN_LOG(int, "Cannot dispose the thread local scratch area");
+
+	if(_init_count == 0) _scratch = NULL;
+
+	return 0;
+}
+
+int json_sax_decode(const json_model_t* models, uint32_t count, const char* data, size_t size, pstd_type_instance_t* inst)
+{
+	if(NULL == models || NULL == data || NULL == inst)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	_scratch_t* scratch = (_scratch_t*)pstd_thread_local_get(_scratch);
+	if(NULL == scratch)
+		ERROR_RETURN_LOG(int, "Cannot get the scratch area from the thread local");
+
+	uint32_t i, j, nslots = 0;
+	for(i = 0; i < count; i ++)
+		nslots += models[i].nnodes;
+
+	if(scratch->slot_cap < nslots)
+	{
+		_slot_t* new_slots = (_slot_t*)realloc(scratch->slots, sizeof(_slot_t) * nslots);
+		if(NULL == new_slots)
+			ERROR_RETURN_LOG_ERRNO(int, "Cannot resize the slot array");
+		scratch->slots = new_slots;
+		scratch->slot_cap = nslots;
+	}
+
+	memset(scratch->slots, 0, sizeof(_slot_t) * nslots);
+	scratch->arena_size = 0;
+
+	_handler_t handler(models, count, scratch);
+	rapidjson::MemoryStream ims(data, size);
+
+	if(scratch->reader.Parse<rapidjson::kParseDefaultFlags>(ims, handler).IsError())
+	{
+		LOG_DEBUG("Got Invalid JSON, exiting");
+		return 0;
+	}
+
+	const _slot_t* slot = scratch->slots;
+	for(i = 0; i < count; slot += models[i].nnodes, i ++)
+	{
+		const json_model_t* jmodel = models + i;
+		for(j = 0; j < jmodel->nnodes; j ++)
+		{
+			const json_model_node_t* node = jmodel->nodes + j;
+			if(node->type != JSON_MODEL_NODE_VALUE) continue;
+			if(!slot[j].seen)
+			{
+				LOG_DEBUG("Missing field %s", node->name == NULL ? "(element)" : node->name);
+				continue;
+			}
+			if(ERROR_CODE(int) == _write_value(jmodel->ops + node->op, slot + j, scratch->arena, inst))
+				ERROR_RETURN_LOG(int, "Cannot write the value to the type instance");
+		}
+	}
+
+	return 0;
+}
+
+#pragma GCC diagnostic pop
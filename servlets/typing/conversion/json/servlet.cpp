@@ -25,6 +25,7 @@
 
 
 #include <json_model.h>
+#include <json_sax.h>
 
 /**
  * @brief The thread local used by each worker thread
@@ -49,6 +50,8 @@ static pstd_thread_local_t* _tl_bufs;
 typedef struct {
 	uint32_t      from_json:1;      /*!< Indicates if we want json to typed pipes */
 	uint32_t      raw:1;            /*!< Indicates if this servlet takes raw input */
+	uint32_t      dom:1;            /*!< Indicates if we want to build the document tree instead of using the streaming decoder */
+	uint32_t      sax:1;            /*!< Indicates if the streaming decoder has been initialized by this servlet */
 	pipe_t        json;             /*!< The pipe we input JSON string */
 	uint32_t      count;            /*!< The numer of typed ports */
 	json_model_t* typed;            /*!< The typed pipes */
@@ -98,13 +101,17 @@ static int _init(uint32_t argc, char const* const* argv, void* ctxbuf)
 	context_t* ctx = (context_t*)ctxbuf;
 
 	ctx->raw = 0;
+	ctx->dom = 0;
+	ctx->sax = 0;
 	ctx->from_json = 1u;
 
 	uint32_t i;
-	for(i = 0; i < 2u && argc > 1u; i ++)
+	for(i = 0; i < 3u && argc > 1u; i ++)
 	{
 		if(strcmp(argv[1], "--raw") == 0)
 			argc --, argv ++, ctx->raw = 1u;
+		else if(strcmp(argv[1], "--dom") == 0)
+			argc --, argv ++, ctx->dom = 1u;
 		else if(strcmp(argv[1], "--from-json") == 0)
 			argc --, argv ++;
 		else if(strcmp(argv[1], "--to-json") == 0)
@@ -116,7 +123,7 @@ static int _init(uint32_t argc, char const* const* argv, void* ctxbuf)
 	ctx->model = NULL;
 
 	if(argc < 2)
-		ERROR_RETURN_LOG(int, "Usage: %s [--from-json|--to-json] [--raw] <name>:<type> [<name>:<type> ...]", servlet_name);
+		ERROR_RETURN_LOG(int, "Usage: %s [--from-json|--to-json] [--raw] [--dom] <name>:<type> [<name>:<type> ...]", servlet_name);
 
 	ctx->count = argc - 1;
 	if(NULL == (ctx->typed = (json_model_t*)calloc(ctx->count, sizeof(ctx->typed[0]))))
@@ -167,6 +174,13 @@ EXIT_PROTO_NORMALLY:
 			ERROR_RETURN_LOG_ERRNO(int, "Cannot get the token accessor for the input json");
 	}
 
+	if(ctx->from_json && !ctx->dom)
+	{
+		if(ERROR_CODE(int) == json_sax_init())
+			ERROR_RETURN_LOG(int, "Cannot initialize the streaming JSON decoder");
+		ctx->sax = 1u;
+	}
+
 	_init_count ++;
 
 	return 0;
@@ -189,6 +203,9 @@ static int _cleanup(void* ctxbuf)
 	if(NULL != ctx->model && ERROR_CODE(int) == pstd_type_model_free(ctx->model))
 		rc = ERROR_CODE(int);
 
+	if(ctx->sax && ERROR_CODE(int) == json_sax_finalize())
+		rc = ERROR_CODE(int);
+
 	if(0 == --_init_count && NULL != _tl_bufs && ERROR_CODE(int) == pstd_thread_local_free(_tl_bufs))
 		rc = ERROR_CODE(int);
 
@@ -394,8 +411,6 @@ ERR:
 
 static inline int _exec_from_json(context_t* ctx, pstd_type_instance_t* inst)
 {
-	rapidjson::Document document;
-
 	const char* data = NULL;
 	size_t data_len = 0;
 
@@ -422,7 +437,7 @@ static inline int _exec_from_json(context_t* ctx, pstd_type_instance_t* inst)
 
 			if(rc) break;
 
-			size_t bytes_read = pipe_read(ctx->json, tl_buf->buf, tl_buf->size - len);
+			size_t bytes_read = pipe_read(ctx->json, tl_buf->buf + len, tl_buf->size - len);
 			if(ERROR_CODE(size_t) == bytes_read)
 				ERROR_RETURN_LOG(int, "Cannot read data from buffer");
 
@@ -455,6 +470,10 @@ static inline int _exec_from_json(context_t* ctx, pstd_type_instance_t* inst)
 
 	if(NULL == data) ERROR_RETURN_LOG(int, "Cannot read data from input pipe");
 
+	if(!ctx->dom)
+		return json_sax_decode(ctx->typed, ctx->count, data, data_len, inst);
+
+	rapidjson::Document document;
 	rapidjson::MemoryStream ims(data, data_len);
 
 	/* Then we can parse the JSON string */
@@ -482,7 +501,7 @@ static inline int _exec_from_json(context_t* ctx, pstd_type_instance_t* inst)
 			switch(op->opcode)
 			{
 				case JSON_MODEL_OPCODE_OPEN:
-					if(sp >= sizeof(stack)) ERROR_RETURN_LOG(int, "Operation stack overflow");
+					if(sp >= sizeof(stack) / sizeof(stack[0])) ERROR_RETURN_LOG(int, "Operation stack overflow");
 					if(cur_obj != NULL)
 					{
 						stack[sp] = NULL;
@@ -495,9 +514,10 @@ static inline int _exec_from_json(context_t* ctx, pstd_type_instance_t* inst)
 					sp ++;
 					break;
 				case JSON_MODEL_OPCODE_OPEN_SUBS:
-					if(sp >= sizeof(stack)) ERROR_RETURN_LOG(int, "Operation stack overflow");
+					if(sp >= sizeof(stack) / sizeof(stack[0])) ERROR_RETURN_LOG(int, "Operation stack overflow");
 					if(cur_obj != NULL)
 					{
+						stack[sp] = NULL;
 						if(!cur_obj->IsArray() || op->index >= cur_obj->Size())
 							LOG_NOTICE("Missing subscript %u", op->index);
 						else
@@ -559,7 +579,7 @@ static inline int _exec_from_json(context_t* ctx, pstd_type_instance_t* inst)
 								str = cur_obj->GetString();
 							if(NULL == str) ERROR_RETURN_LOG(int, "Cannot get the string value");
 							size_t len = strlen(str);
-							pstd_string_t* pstd_str = pstd_string_new(len + 1);
+							pstd_string_t* pstd_str = pstd_string_new_scoped(len + 1);
 							if(NULL == pstd_str) ERROR_RETURN_LOG(int, "Cannot allocate new pstd string object");
 							if(ERROR_CODE(size_t) == pstd_string_write(pstd_str, str, len))
 							{
@@ -0,0 +1,38 @@
+#!/usr/bin/env python
+# Generate the benchmark input for the JSON decoder, the document is a Record with a large unmapped payload
+# Usage: gen-bench-input.py <size> [<count>], where size can be a number with suffix K or M
+import sys, json
+
+def parse_size(text):
+    text = text.upper()
+    if text.endswith("K"): return int(text[:-1]) * 1024
+    if text.endswith("M"): return int(text[:-1]) * 1024 * 1024
+    return int(text)
+
+size  = parse_size(sys.argv[1])
+count = int(sys.argv[2]) if len(sys.argv) > 2 else 1
+
+record = {
+    "id": 42,
+    "port": 8080,
+    "delta": -3,
+    "score": 0.5,
+    "pos": {"x": 1.5, "y": -2},
+    "path": [{"x": 1, "y": 2}, {"x": 3, "y": 4}],
+    "matrix": [[1, 2], [3, 4]],
+    "name": "benchmark"
+}
+
+payload = []
+doc = {"record": record, "payload": payload}
+item_id = 0
+while len(json.dumps(doc)) < size:
+    batch = [{"id": item_id + i, "title": "item %d" % (item_id + i), "tags": ["a", "b", "c"], "weight": (item_id + i) * 0.25, "active": True}
+             for i in range(max(1, (size - len(json.dumps(doc))) // 100))]
+    item_id += len(batch)
+    payload.extend(batch)
+
+data = json.dumps(doc)
+for i in range(count):
+    sys.stdout.write(".TEXT bench_%d\n%s\n.END\n" % (i, data))
+sys.stdout.write(".STOP\n")
@@ -8,14 +8,15 @@
 #include <pthread.h>
 #include <errno.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/time.h>
 
 #include <error.h>
 #include <fallthrough.h>
 #include <barrier.h>
 #include <arch/arch.h>
+#include <os/os.h>
 
-#include <utils/vector.h>
 #include <utils/static_assertion.h>
 #include <utils/log.h>
 
@@ -26,6 +27,14 @@
  **/
 #define _SCHED_TOKEN (~(itc_equeue_token_t)(1))
 
+/**
+ * @brief The number of 64 bit words in the ready bitmap for each event type
+ **/
+#define _READY_WORDS ((ITC_EQUEUE_MAX_NUM_QUEUES + 63) / 64)
+
+/* Because we use a single 64 bit word as the summary of the ready bitmap, so we can not have more than 4096 queues */
+STATIC_ASSERTION_LE(_READY_WORDS, 64);
+
 /** @brief the mutex used to lock the operation that change the equeue structure */
 static pthread_mutex_t _global_mutex;
 
@@ -37,11 +46,15 @@ static int _sched_token_called;
 
 /**
  * @brief the queue for the single thread
+ * @note  Each queue is a single-producer-single-consumer ring buffer, the module thread owns the token
+ *        is the only producer and the thread holding the scheduler token is the only consumer. So
+ *        the producer only modifies the rear pointer and the consumer only modifies the front pointer,
+ *        and no lock is needed for both put and take.
  **/
 typedef struct {
 	itc_equeue_event_type_t type;        /*!< The event type in this queue (See the notes, although the event mask can
 	                                      *   describe multiple types, but we only allow 1 type set here) */
-	pthread_mutex_t   mutex;             /*!< the local mutex */
+	pthread_mutex_t   mutex;             /*!< the local mutex, only used when the queue is full */
 	pthread_cond_t    put_cond;          /*!< the cond variable for equeue_put */
 	uint32_t          size;              /*!< the size of the queue */
 	uint32_t          front;             /*!< the next avaliable location to write, only module thread with that token can access this */
@@ -53,27 +66,206 @@ typedef struct {
 STATIC_ASSERTION_LAST(_queue_t, events);
 STATIC_ASSERTION_SIZE(_queue_t, events, 0);
 
-static vector_t* _queues;
+/**
+ * @brief The ready bitmap for one type of event
+ * @details The N-th bit in the bitmap is set if the N-th queue may have events in it. And the N-th bit of
+ *          the summary word is set if the N-th word of the bitmap may have bit set. <br/>
+ *          The producer only sets the bits after the event is published, and only the consumer clears the bits.
+ *          Whenever the consumer clears a bit, it rechecks the queue (or the bitmap word), and sets the bit back
+ *          if it's not actually empty. Thus a non-empty queue always has the bit set, and finding a non-empty
+ *          queue only needs two bit scans instead of going over the entire queue list.
+ **/
+typedef struct {
+	uint64_t          summary;               /*!< The summary word of the bitmap */
+	uint32_t          cursor;                /*!< The queue we should start with for the next search, only used by consumer */
+	uint64_t          words[_READY_WORDS];   /*!< The actual bitmap */
+} _ready_map_t;
+
+/**
+ * @brief The queue list, since we have a fixed upper bound of the number of queues, so that
+ *        the consumer can access the list without holding the global mutex
+ **/
+static _queue_t* _queues[ITC_EQUEUE_MAX_NUM_QUEUES];
+
+/**
+ * @brief The ready bitmap for each event type
+ **/
+static _ready_map_t _ready[ITC_EQUEUE_EVENT_TYPE_COUNT];
+
+/**
+ * @brief The event type the consumer should look at first, used to make sure one event type won't starve another
+ **/
+static uint32_t _next_type;
+
+/**
+ * @brief The poll object used to block the scheduler thread when there's no event
+ **/
+static os_event_poll_t* _poll;
+
+/**
+ * @brief The user event FD which can wake up the blocked scheduler thread
+ **/
+static int _wakeup_fd = -1;
+
+/**
+ * @biref Indicates if the scheduler is waiting, and what type of event it's waiting for
+ **/
+static volatile uint32_t _sched_waiting;
+
+/**
+ * @brief Set the bit in the ready bitmap
+ * @param map The ready bitmap
+ * @param idx The queue index
+ * @note The caller should make sure all the memory write before this call has been done before
+ *       it's called, which the full barrier in this function guarantees.
+ *       If the bit is already set, we only read the bitmap, so that the cache line won't bounce
+ *       between the producers when the consumer is busy
+ * @return nothing
+ **/
+static inline void _ready_set(_ready_map_t* map, uint32_t idx)
+{
+	uint64_t bit = 1ull << (idx % 64), wbit = 1ull << (idx / 64);
+
+	__sync_synchronize();
+	if(!(map->words[idx / 64] & bit))
+		__sync_fetch_and_or(map->words + idx / 64, bit);
+
+	__sync_synchronize();
+	if(!(map->summary & wbit))
+		__sync_fetch_and_or(&map->summary, wbit);
+}
+
+/**
+ * @brief Clear the bit of a queue which seems to be empty, this should be called from the consumer only
+ * @param map The ready bitmap
+ * @param idx The queue index
+ * @param queue The queue object
+ * @return nothing
+ **/
+static inline void _ready_clear(_ready_map_t* map, uint32_t idx, const _queue_t* queue)
+{
+	uint64_t bit = 1ull << (idx % 64);
+
+	__sync_fetch_and_and(map->words + idx / 64, ~bit);
+
+	/* The producer may have put a event between we read the queue and clear the bit, so we need to recheck */
+	if(queue->front != ((const volatile _queue_t*)queue)->rear)
+		_ready_set(map, idx);
+}
 
 /**
- * @brief The mutex used for the disptacher to take an item from the queue
+ * @brief Clear the summary bit of a bitmap word which seems to be empty, this should be called from the consumer only
+ * @param map The ready bitmap
+ * @param word The word index
+ * @return nothing
  **/
-static pthread_mutex_t _take_mutex;
+static inline void _ready_clear_summary(_ready_map_t* map, uint32_t word)
+{
+	uint64_t wbit = 1ull << word;
+
+	__sync_fetch_and_and(&map->summary, ~wbit);
+
+	if(((volatile uint64_t*)map->words)[word] != 0)
+		__sync_fetch_and_or(&map->summary, wbit);
+}
 
 /**
- * @brief The cond variable used to block the dispatcher when there's no event
+ * @brief Find a non-empty queue from the given bitmap word
+ * @param map The ready bitmap
+ * @param word The word index
+ * @param mask Which bits in this word we are looking at
+ * @return The queue index, or error code if there's no such queue
  **/
-static pthread_cond_t  _take_cond;
+static inline uint32_t _ready_find_in_word(_ready_map_t* map, uint32_t word, uint64_t mask)
+{
+	uint64_t bits;
+	while(0 != (bits = ((volatile uint64_t*)map->words)[word] & mask))
+	{
+		uint32_t bit = (uint32_t)__builtin_ctzll(bits);
+		uint32_t idx = word * 64 + bit;
+		const _queue_t* queue = _queues[idx];
+
+		if(queue->front != ((const volatile _queue_t*)queue)->rear)
+			return idx;
+
+		/* This is a stale bit, clean it up. And do not look at it again, even the producer sets it back */
+		_ready_clear(map, idx, queue);
+		mask &= ~(1ull << bit);
+	}
+
+	return ERROR_CODE(uint32_t);
+}
 
 /**
- * @biref Indicates if the scheduler is waiting
+ * @brief Find the next non-empty queue which has the given type, this should be called from the consumer only
+ * @details The search starts from the cursor, so that the queues are served in round-robin order
+ * @param map The ready bitmap for the type
+ * @return The queue index, or error code if all the queues are empty
  **/
-volatile uint32_t _sched_waiting;
+static inline uint32_t _ready_find(_ready_map_t* map)
+{
+	uint32_t start_word = (map->cursor / 64) % _READY_WORDS;
+	uint64_t head_mask = ~0ull << (map->cursor % 64);
+	uint32_t ret;
+
+	if(ERROR_CODE(uint32_t) != (ret = _ready_find_in_word(map, start_word, head_mask)))
+		return ret;
+
+	uint64_t summary = ((volatile _ready_map_t*)map)->summary;
+	uint64_t after = start_word < 63 ? summary & (~0ull << (start_word + 1)) : 0;
+	uint64_t before = summary & ((1ull << start_word) - 1);
+	int pass;
+
+	for(pass = 0; pass < 2; pass ++)
+	{
+		uint64_t bits = pass == 0 ? after : before;
+		for(; bits != 0; bits &= bits - 1)
+		{
+			uint32_t word = (uint32_t)__builtin_ctzll(bits);
+			if(ERROR_CODE(uint32_t) != (ret = _ready_find_in_word(map, word, ~0ull)))
+				return ret;
+			_ready_clear_summary(map, word);
+		}
+	}
+
+	if(ERROR_CODE(uint32_t) != (ret = _ready_find_in_word(map, start_word, ~head_mask)))
+		return ret;
+
+	_ready_clear_summary(map, start_word);
+
+	return ERROR_CODE(uint32_t);
+}
 
+/**
+ * @brief Check if there's any non-empty queue which is allowed by the event mask
+ * @param mask The event mask
+ * @return the result
+ **/
+static inline int _ready_any(itc_equeue_event_mask_t mask)
+{
+	uint32_t type;
+	for(type = 0; type < ITC_EQUEUE_EVENT_TYPE_COUNT; type ++)
+		if(ITC_EQUEUE_EVENT_MASK_ALLOWS(mask, type) && ERROR_CODE(uint32_t) != _ready_find(_ready + type))
+			return 1;
+	return 0;
+}
 
 /**
- * @todo using larger initial size when there's such need for that
+ * @brief Wake up the scheduler thread blocked by itc_equeue_wait
+ * @note This function only makes a write syscall, so it's safe to call it from the signal handler
+ * @return nothing
  **/
+static inline void _wakeup(void)
+{
+	int saved_errno = errno;
+	uint64_t val = 1;
+
+	if(_wakeup_fd >= 0 && write(_wakeup_fd, &val, sizeof(val)) < 0 && errno != EAGAIN)
+		LOG_WARNING_ERRNO("Cannot write the wakeup event");
+
+	errno = saved_errno;
+}
+
 int itc_equeue_init()
 {
 	int stage = 0;
@@ -83,30 +275,36 @@ int itc_equeue_init()
 	stage = 1;
 	/* stage 1 */
 	_next_token = 0;
+	_next_type = 0;
 	_sched_token_called = 0;
-	_queues = vector_new(sizeof(_queue_t*), ITC_EQUEUE_VEC_INIT_SIZE);
-	if(NULL == _queues)
-		ERROR_LOG_GOTO(ERR, "Cannot create vector for the queue list");
+	_sched_waiting = 0;
+	memset(_queues, 0, sizeof(_queues));
+	memset(_ready, 0, sizeof(_ready));
+
+	if(NULL == (_poll = os_event_poll_new()))
+		ERROR_LOG_GOTO(ERR, "Cannot create the poll object for the scheduler wait");
 
 	stage = 2;
-	if((errno = pthread_cond_init(&_take_cond, NULL)) != 0)
-		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot initialize the read condition variable");
+	os_event_desc_t desc = {
+		.type = OS_EVENT_TYPE_USER,
+		.user = {
+			.data = NULL
+		}
+	};
 
-	stage = 3;
-	if((errno = pthread_mutex_init(&_take_mutex, NULL)) != 0)
-		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot initialize the read condition mutex");
+	if(ERROR_CODE(int) == (_wakeup_fd = os_event_poll_add(_poll, &desc)))
+		ERROR_LOG_GOTO(ERR, "Cannot create the wakeup event for the scheduler wait");
 
 	LOG_DEBUG("Event Queue has been initialized");
 	return 0;
 
 ERR:
+	_wakeup_fd = -1;
 	switch(stage)
 	{
-		case 3:
-			pthread_cond_destroy(&_take_cond);
-			FALLTHROUGH();
 		case 2:
-			vector_free(_queues);
+			os_event_poll_free(_poll);
+			_poll = NULL;
 			FALLTHROUGH();
 		case 1:
 			pthread_mutex_destroy(&_global_mutex);
@@ -123,86 +321,93 @@ int itc_equeue_finalize()
 		rc = ERROR_CODE(int);
 	}
 	/* Before we actually stop, we should dispose all the tasks which is still in the queue */
-	if(_queues != NULL)
+	size_t i;
+	for(i = 0; i < _next_token; i ++)
 	{
-		size_t i;
-		for(i = 0; i < vector_length(_queues); i ++)
+		_queue_t* queue = _queues[i];
+		if(NULL != queue)
 		{
-			_queue_t* queue = *VECTOR_GET(_queue_t*, _queues, i);
-			if(NULL != queue)
+			uint64_t j;
+			for(j = queue->front; j != queue->rear; j ++)
 			{
-				uint64_t j;
-				for(j = queue->front; j != queue->rear; j ++)
+				switch(queue->events[j & (queue->size - 1)].type)
 				{
-					switch(queue->events[j & (queue->size - 1)].type)
+					case ITC_EQUEUE_EVENT_TYPE_IO:
 					{
-						case ITC_EQUEUE_EVENT_TYPE_IO:
+						itc_module_pipe_t* in = queue->events[j & (queue->size - 1)].io.in;
+						itc_module_pipe_t* out = queue->events[j & (queue->size - 1)].io.out;
+
+						if(in != NULL && itc_module_pipe_deallocate(in) == ERROR_CODE(int))
 						{
-							itc_module_pipe_t* in = queue->events[j & (queue->size - 1)].io.in;
-							itc_module_pipe_t* out = queue->events[j & (queue->size - 1)].io.out;
-
-							if(in != NULL && itc_module_pipe_deallocate(in) == ERROR_CODE(int))
-							{
-								LOG_ERROR("Cannot deallocate the input event pipe");
-								rc = ERROR_CODE(int);
-							}
-							if(out != NULL && itc_module_pipe_deallocate(out) == ERROR_CODE(int))
-							{
-								LOG_ERROR("Cannot deallocate the output event pipe");
-								rc = ERROR_CODE(int);
-							}
-							break;
+							LOG_ERROR("Cannot deallocate the input event pipe");
+							rc = ERROR_CODE(int);
 						}
-						case ITC_EQUEUE_EVENT_TYPE_TASK:
+						if(out != NULL && itc_module_pipe_deallocate(out) == ERROR_CODE(int))
 						{
-							itc_equeue_task_event_t* event = &queue->events[j & (queue->size - 1)].task;
-
-							/* We don't call the cleanup task at this point for now.
-							 * TODO: do we need a way to make it properly cleaned up */
+							LOG_ERROR("Cannot deallocate the output event pipe");
+							rc = ERROR_CODE(int);
+						}
+						break;
+					}
+					case ITC_EQUEUE_EVENT_TYPE_TASK:
+					{
+						itc_equeue_task_event_t* event = &queue->events[j & (queue->size - 1)].task;
 
-							if(event->async_handle != NULL && ERROR_CODE(int) == sched_async_handle_dispose(event->async_handle))
-							{
-								LOG_ERROR("Cannot deallocatet the task handle");
-								rc = ERROR_CODE(int);
-							}
+						/* We don't call the cleanup task at this point for now.
+						 * TODO: do we need a way to make it properly cleaned up */
 
-							break;
-						}
-						default:
+						if(event->async_handle != NULL && ERROR_CODE(int) == sched_async_handle_dispose(event->async_handle))
+						{
+							LOG_ERROR("Cannot deallocatet the task handle");
 							rc = ERROR_CODE(int);
-							LOG_ERROR("Invalid type of event");
+						}
+
+						break;
 					}
+					default:
+						rc = ERROR_CODE(int);
+						LOG_ERROR("Invalid type of event");
 				}
-				if((errno = pthread_mutex_destroy(&queue->mutex)) != 0)
-				{
-					LOG_ERROR_ERRNO("Cannot destroy the queue specified mutex");
-					rc = ERROR_CODE(int);
-				}
-				if((errno = pthread_cond_destroy(&queue->put_cond)) != 0)
-				{
-					LOG_ERROR_ERRNO("Cannot destroy the queue specified cond variable");
-					rc = ERROR_CODE(int);
-				}
-				free(queue);
 			}
+			if((errno = pthread_mutex_destroy(&queue->mutex)) != 0)
+			{
+				LOG_ERROR_ERRNO("Cannot destroy the queue specified mutex");
+				rc = ERROR_CODE(int);
+			}
+			if((errno = pthread_cond_destroy(&queue->put_cond)) != 0)
+			{
+				LOG_ERROR_ERRNO("Cannot destroy the queue specified cond variable");
+				rc = ERROR_CODE(int);
+			}
+			free(queue);
+			_queues[i] = NULL;
 		}
-		vector_free(_queues);
 	}
+	_next_token = 0;
+
 	if((errno = pthread_mutex_unlock(&_global_mutex)) != 0)
 	{
 		LOG_ERROR_ERRNO("Cannot destroy the global mutex");
 		rc = ERROR_CODE(int);
 	}
-	if((errno = pthread_mutex_destroy(&_take_mutex)) != 0)
+	/* We don't remove the wakeup event from the poll object explicitly, because the poll object may be shared
+	 * with the parent process when we are finalizing a forked process. Closing the FD is enough in this case */
+	if(_wakeup_fd >= 0)
 	{
-		LOG_ERROR_ERRNO("Cannot destroy the read mutex");
-		rc = ERROR_CODE(int);
+		int fd = _wakeup_fd;
+		_wakeup_fd = -1;
+		if(close(fd) < 0)
+		{
+			LOG_ERROR_ERRNO("Cannot close the wakeup event FD");
+			rc = ERROR_CODE(int);
+		}
 	}
-	if((errno = pthread_cond_destroy(&_take_cond)) != 0)
+	if(NULL != _poll && ERROR_CODE(int) == os_event_poll_free(_poll))
 	{
-		LOG_ERROR_ERRNO("Cannot destroy the read cond variable");
+		LOG_ERROR("Cannot dispose the poll object");
 		rc = ERROR_CODE(int);
 	}
+	_poll = NULL;
 	if((errno = pthread_mutex_destroy(&_global_mutex)) != 0)
 	{
 		LOG_ERROR_ERRNO("Cannot destroy the global mutex");
@@ -222,13 +427,15 @@ itc_equeue_token_t itc_equeue_module_token(uint32_t size, itc_equeue_event_type_
 	LOG_DEBUG("The actual queue size %u", q_size);
 
 	int stage = 0;
-	_queue_t* queue;
-	vector_t* next;
+	_queue_t* queue = NULL;
 	itc_equeue_token_t ret;
 	if((errno = pthread_mutex_lock(&_global_mutex)) != 0)
 		ERROR_RETURN_LOG_ERRNO(itc_equeue_token_t, "Cannot lock the global mutex");
 
-	ret = (_next_token ++);
+	if(_next_token >= ITC_EQUEUE_MAX_NUM_QUEUES)
+		ERROR_LOG_GOTO(ERR, "Too many event queues, the limit is %u", ITC_EQUEUE_MAX_NUM_QUEUES);
+
+	ret = _next_token;
 	queue = (_queue_t*)calloc(1, sizeof(_queue_t) + sizeof(itc_equeue_event_t) * q_size);
 	if(NULL == queue) ERROR_LOG_GOTO(ERR, "Cannot allocate memory for event queue");
 
@@ -238,25 +445,21 @@ itc_equeue_token_t itc_equeue_module_token(uint32_t size, itc_equeue_event_type_
 
 	if((errno = pthread_cond_init(&queue->put_cond, NULL)) != 0) ERROR_LOG_GOTO(ERR, "Cannot initialize the queue cond variable");
 	queue->size = q_size;
+	queue->type = type;
 
-	stage = 2;
-	next = vector_append(_queues, &queue);
-	if(NULL == next) ERROR_LOG_GOTO(ERR, "Cannot append the new queue to the queue list");
+	/* Make sure the queue is fully initialized before the consumer can see it */
+	_queues[ret] = queue;
+	__sync_synchronize();
+	_next_token ++;
 
-	_queues = next;
 	if((errno = pthread_mutex_unlock(&_global_mutex)) != 0) LOG_WARNING_ERRNO("Cannot release the global mutex");
 
 	LOG_INFO("New module token in the event queue: Token = %x", ret);
 
-	queue->type = type;
-
 	return ret;
 ERR:
 	switch(stage)
 	{
-		case 2:
-			pthread_cond_destroy(&queue->put_cond);
-			FALLTHROUGH();
 		case 1:
 			pthread_mutex_destroy(&queue->mutex);
 	}
@@ -307,7 +510,7 @@ int itc_equeue_put(itc_equeue_token_t token, itc_equeue_event_t event)
 	else if(event.type != ITC_EQUEUE_EVENT_TYPE_IO && event.type != ITC_EQUEUE_EVENT_TYPE_TASK)
 		ERROR_RETURN_LOG(int, "Invalid event type");
 
-	_queue_t* queue = *VECTOR_GET(_queue_t*, _queues, token);
+	_queue_t* queue = token < ITC_EQUEUE_MAX_NUM_QUEUES ? _queues[token] : NULL;
 	if(NULL == queue)
 		ERROR_RETURN_LOG(int, "Cannot get the queue for token %u", token);
 
@@ -316,19 +519,19 @@ int itc_equeue_put(itc_equeue_token_t token, itc_equeue_event_t event)
 
 	LOG_DEBUG("token %u: wait for the queue have space for the new event", token);
 
-	struct timespec abstime;
-	struct timeval now;
-	gettimeofday(&now,NULL);
-	abstime.tv_sec = now.tv_sec+1;
-	abstime.tv_nsec = 0;
-
-	if(queue->rear == queue->front + queue->size)
+	if(queue->rear == ((const volatile _queue_t*)queue)->front + queue->size)
 	{
+		struct timespec abstime;
+		struct timeval now;
+		gettimeofday(&now,NULL);
+		abstime.tv_sec = now.tv_sec+1;
+		abstime.tv_nsec = 0;
+
 		if((errno = pthread_mutex_lock(&queue->mutex)) != 0)
 			ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the queue mutex");
 
 		/* If the queue is currently full, we should make the event loop wait until the scheduler consume at least one event in the queue */
-		while(queue->rear == queue->front + queue->size)
+		while(queue->rear == ((const volatile _queue_t*)queue)->front + queue->size)
 		{
 			if((errno = pthread_cond_timedwait(&queue->put_cond, &queue->mutex, &abstime)) != 0 && errno != ETIMEDOUT && errno != EINTR)
 				LOG_WARNING_ERRNO("failed to wait for the cond variable get ready");
@@ -356,21 +559,17 @@ int itc_equeue_put(itc_equeue_token_t token, itc_equeue_event_t event)
 	BARRIER();
 	arch_atomic_sw_increment_u32(&queue->rear);
 
-	if(ITC_EQUEUE_EVENT_MASK_ALLOWS(_sched_waiting, queue->type))
-	{
-		_sched_waiting = 0;
-
-		LOG_DEBUG("token %u: notifiying the schduler thread to read this element", token);
+	/* Then publish the queue in the ready bitmap, this also makes sure the new rear pointer is visible before
+	 * we read the scheduler waiting flag, which pairs with the barrier in itc_equeue_wait */
+	_ready_set(_ready + queue->type, token);
 
-		/* Signal the take part */
-		if((errno = pthread_mutex_lock(&_take_mutex)) != 0)
-			LOG_WARNING_ERRNO("cannot acquire the reader mutex");
+	uint32_t waiting = _sched_waiting;
 
-		if((errno = pthread_cond_signal(&_take_cond)) != 0)
-			LOG_WARNING_ERRNO("cannot send signal to the scheduler thread");
+	if(ITC_EQUEUE_EVENT_MASK_ALLOWS(waiting, queue->type) && __sync_bool_compare_and_swap(&_sched_waiting, waiting, 0))
+	{
+		LOG_DEBUG("token %u: notifiying the schduler thread to read this element", token);
 
-		if((errno = pthread_mutex_unlock(&_take_mutex)) != 0)
-			LOG_WARNING_ERRNO("cannot release the reader mutex");
+		_wakeup();
 
 		LOG_DEBUG("token %u: event message notified", token);
 	}
@@ -381,56 +580,59 @@ int itc_equeue_put(itc_equeue_token_t token, itc_equeue_event_t event)
 uint32_t itc_equeue_take(itc_equeue_token_t token, itc_equeue_event_mask_t type_mask, itc_equeue_event_t* buffer, uint32_t buffer_size)
 {
 	uint32_t ret = 0;
-	size_t i;
+	uint32_t i, j, idx = ERROR_CODE(uint32_t);
 	_queue_t* queue = NULL;
+	_ready_map_t* map = NULL;
 
 	if(NULL == buffer) ERROR_RETURN_LOG(uint32_t, "Invalid arguments");
 
 	if(token != _SCHED_TOKEN) ERROR_RETURN_LOG(uint32_t, "Cannot call the take method from event thread");
 
-	/* Find the first queue that is not empty */
-	for(i = 0; i < vector_length(_queues); i ++)
+	/* Find the first queue that is not empty, we rotate the event type we look at first, so that
+	 * the IO events won't make the task events wait forever and vice versa */
+	for(i = 0; i < ITC_EQUEUE_EVENT_TYPE_COUNT && ERROR_CODE(uint32_t) == idx; i ++)
 	{
-		queue = *VECTOR_GET(_queue_t*, _queues, i);
-
-		if(NULL == queue)
-		{
-			LOG_WARNING("Invalid queue object at %zu, may be a code bug", i);
-			continue;
-		}
-
-		if(ITC_EQUEUE_EVENT_MASK_ALLOWS(type_mask, queue->type) && queue->front != queue->rear)
-		{
-			LOG_DEBUG("found queue %zu contains avalible events", i);
-			break;
-		}
+		j = (_next_type + i) % ITC_EQUEUE_EVENT_TYPE_COUNT;
+		if(ITC_EQUEUE_EVENT_MASK_ALLOWS(type_mask, j))
+			idx = _ready_find(map = _ready + j);
 	}
 
-	if(i == vector_length(_queues))
+	if(ERROR_CODE(uint32_t) == idx)
 		ERROR_RETURN_LOG(uint32_t, "Cannot find the event mask = %x", type_mask);
-	else LOG_DEBUG("Found events in queue #%zu, take the first one", i);
+	else LOG_DEBUG("Found events in queue #%u, take the first one", idx);
+
+	_next_type = (_next_type + 1) % ITC_EQUEUE_EVENT_TYPE_COUNT;
+	map->cursor = (idx + 1) % ITC_EQUEUE_MAX_NUM_QUEUES;
+	queue = _queues[idx];
+
+	uint32_t rear = ((const volatile _queue_t*)queue)->rear;
 
+	uint32_t was_full = (rear - queue->front == queue->size);
 
-	for(ret = 0; ret < buffer_size && (queue->rear - queue->front - ret) != 0; ret ++)
+	/* Make sure we read the rear pointer before the event data */
+	__sync_synchronize();
+
+	for(ret = 0; ret < buffer_size && (rear - queue->front - ret) != 0; ret ++)
 		buffer[ret] = queue->events[(queue->front + ret) & (queue->size - 1)];
 
 	BARRIER();
 
 	queue->front += ret;
 
-	BARRIER();
+	if(queue->front == rear)
+		_ready_clear(map, idx, queue);
 
-	if((queue->rear - queue->front + ret) == queue->size)
+	if(was_full)
 	{
-		LOG_DEBUG("scheduler thread: notifying the more free space in the queue to token %zu", i);
+		LOG_DEBUG("scheduler thread: notifying the more free space in the queue to token %u", idx);
 		if((errno = pthread_mutex_lock(&queue->mutex)) != 0)
-			LOG_WARNING_ERRNO("cannot acquire the queue mutex for token %zu", i);
+			LOG_WARNING_ERRNO("cannot acquire the queue mutex for token %u", idx);
 
 		if((errno = pthread_cond_signal(&queue->put_cond)) != 0)
-			LOG_WARNING_ERRNO("cannot notify the queue cond variable for token %zu", i);
+			LOG_WARNING_ERRNO("cannot notify the queue cond variable for token %u", idx);
 
 		if((errno = pthread_mutex_unlock(&queue->mutex)) != 0)
-			LOG_WARNING_ERRNO("cannot notify release the queue mutex for token %zu", i);
+			LOG_WARNING_ERRNO("cannot notify release the queue mutex for token %u", idx);
 	}
 
 	return ret;
@@ -439,73 +641,53 @@ uint32_t itc_equeue_take(itc_equeue_token_t token, itc_equeue_event_mask_t type_
 int itc_equeue_empty(itc_equeue_token_t token)
 {
 	if(token != _SCHED_TOKEN) ERROR_RETURN_LOG(int, "Cannot call this function from the event thread");
-	size_t i;
-	for(i = 0; i < vector_length(_queues); i ++)
-	{
-		_queue_t* queue = *VECTOR_GET(_queue_t*, _queues, i);
-		if(NULL == queue) ERROR_RETURN_LOG(int, "Cannot get the token local queue %zu", i);
-		if(queue->rear != queue->front)
-			return 0;
-	}
-	return 1;
 
+	return !_ready_any((1u << ITC_EQUEUE_EVENT_TYPE_COUNT) - 1);
 }
 
-int itc_equeue_wait(itc_equeue_token_t token, const int* killed, itc_equeue_wait_interrupt_t* interrupt)
+int itc_equeue_ready(itc_equeue_token_t token, itc_equeue_event_mask_t type_mask)
 {
 	if(token != _SCHED_TOKEN) ERROR_RETURN_LOG(int, "Cannot call this function from the event thread");
 
-	LOG_DEBUG("The thread is going to be blocked until the queue have at least one event");
+	return _ready_any(type_mask);
+}
 
-	struct timespec abstime;
-	struct timeval now;
-	gettimeofday(&now,NULL);
-	abstime.tv_sec = now.tv_sec+1;
-	abstime.tv_nsec = 0;
+int itc_equeue_wait(itc_equeue_token_t token, const int* killed, itc_equeue_wait_interrupt_t* interrupt)
+{
+	if(token != _SCHED_TOKEN) ERROR_RETURN_LOG(int, "Cannot call this function from the event thread");
 
-	int locked = 0;
+	LOG_DEBUG("The thread is going to be blocked until the queue have at least one event");
 
 	itc_equeue_event_mask_t mask = (1u << ITC_EQUEUE_EVENT_TYPE_COUNT) - 1;
 
-	while(killed == NULL || *killed == 0)
+	while(killed == NULL || *(volatile const int*)killed == 0)
 	{
-		size_t i;
-
 		if(interrupt != NULL && ITC_EQUEUE_EVENT_MASK_NONE == (mask = interrupt->func(interrupt->data)))
 			ERROR_RETURN_LOG(int, "The equeue wait interrupt callback returns an error");
 
-		for(i = 0; i < vector_length(_queues); i ++)
-		{
-			_queue_t* queue = *VECTOR_GET(_queue_t*, _queues, i);
-			if(NULL == queue)
-				LOG_WARNING("Cannot get the queue for token %zu", i);
-			else if(ITC_EQUEUE_EVENT_MASK_ALLOWS(mask, queue->type) && queue->rear != queue->front)
-				break;
-		}
+		if(_ready_any(mask)) break;
 
-		if(i != vector_length(_queues)) break;
+		/* Publish what we are waiting for, then check the queue again. The full barrier pairs with the one
+		 * in itc_equeue_put, so either we can see the new event or the producer can see the waiting flag */
+		_sched_waiting = mask;
+		__sync_synchronize();
 
-		if(!locked)
+		if(_ready_any(mask) || (killed != NULL && *(volatile const int*)killed))
 		{
-			if((errno = pthread_mutex_lock(&_take_mutex)) != 0)
-				ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the reader mutex");
-
-			locked = 1;
-
-			continue;
+			_sched_waiting = 0;
+			break;
 		}
 
-		_sched_waiting = mask;
+		int rc = os_event_poll_wait(_poll, 1, -1);
 
-		if((errno = pthread_cond_timedwait(&_take_cond, &_take_mutex, &abstime)) != 0 && errno != EINTR && errno != ETIMEDOUT)
-			ERROR_RETURN_LOG_ERRNO(int, "Cannot wait for the reader condition variable");
+		_sched_waiting = 0;
 
-		gettimeofday(&now,NULL);
-		abstime.tv_sec = now.tv_sec + 1;
-	}
+		if(ERROR_CODE(int) == rc)
+			ERROR_RETURN_LOG(int, "Cannot wait for the wakeup event");
 
-	if(locked && (errno = pthread_mutex_unlock(&_take_mutex)) != 0)
-		LOG_WARNING_ERRNO("cannot release the reader mutex");
+		if(rc > 0 && ERROR_CODE(int) == os_event_user_event_consume(_poll, _wakeup_fd))
+			LOG_WARNING("Cannot consume the wakeup event");
+	}
 
 	if(killed != NULL && *killed)
 	{
@@ -518,14 +700,9 @@ int itc_equeue_wait(itc_equeue_token_t token, const int* killed, itc_equeue_wait
 
 int itc_equeue_wait_interrupt()
 {
-	if((errno = pthread_mutex_lock(&_take_mutex)) != 0)
-		LOG_WARNING_ERRNO("cannot acquire the reader mutex");
-
-	if((errno = pthread_cond_signal(&_take_cond)) != 0)
-		LOG_WARNING_ERRNO("cannot send signal to the scheduler thread");
+	_sched_waiting = 0;
 
-	if((errno = pthread_mutex_unlock(&_take_mutex)) != 0)
-		LOG_WARNING_ERRNO("cannot release the reader mutex");
+	_wakeup();
 
 	return 0;
 }
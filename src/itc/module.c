@@ -654,6 +654,27 @@ static inline int _rls_stream_eos(const void* handle)
 	return sched_rscope_stream_eos((const sched_rscope_stream_t*)handle);
 }
 
+/**
+ * @brief take the remaining bytes of the RLS stream as a file region
+ * @param handle the RLS stream
+ * @param region_buf the buffer used to return the region
+ * @return 1 if the region is returned, 0 if not supported, or error code
+ **/
+static inline int _rls_stream_region(void* __restrict handle, itc_module_data_source_region_t* region_buf)
+{
+	runtime_api_scope_file_region_t region;
+	int rc = sched_rscope_stream_get_region((sched_rscope_stream_t*)handle, &region);
+
+	if(rc == 1)
+	{
+		region_buf->fd = region.fd;
+		region_buf->offset = region.offset;
+		region_buf->size = region.size;
+	}
+
+	return rc;
+}
+
 /**
  * @brief close a used RLS stream
  * @param handle the RLS stream
@@ -676,6 +697,7 @@ int itc_module_pipe_write_scope_token(runtime_api_scope_token_t token, const run
 		.data_handle = stream,
 		.read = _rls_stream_read,
 		.eos  = _rls_stream_eos,
+		.region = _rls_stream_region,
 		.close = _rls_stream_close
 	};
 
@@ -733,6 +755,11 @@ int itc_module_pipe_write_data_source(itc_module_data_source_t data_source, cons
 			if(bytes_read == 0)
 			{
 				LOG_DEBUG("RLS token stream has to be in the wait state, terminating data request");
+
+				/* The caller may have bytes buffered in front of the token, which must go before the DRA */
+				if(ERROR_CODE(size_t) == data_req->data_handler(data_req->context, NULL, 0))
+					ERROR_RETURN_LOG(int, "Cannot terminate the data request");
+
 				goto DR_END;
 			}
 
@@ -0,0 +1,1689 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include <error.h>
+
+#include <utils/log.h>
+
+#include <module/http2/hpack.h>
+#include <module/http2/conn.h>
+
+/**
+ * @brief the frame types
+ **/
+enum {
+	_FRAME_DATA          = 0x0,   /*!< the DATA frame */
+	_FRAME_HEADERS       = 0x1,   /*!< the HEADERS frame */
+	_FRAME_PRIORITY      = 0x2,   /*!< the PRIORITY frame */
+	_FRAME_RST_STREAM    = 0x3,   /*!< the RST_STREAM frame */
+	_FRAME_SETTINGS      = 0x4,   /*!< the SETTINGS frame */
+	_FRAME_PUSH_PROMISE  = 0x5,   /*!< the PUSH_PROMISE frame */
+	_FRAME_PING          = 0x6,   /*!< the PING frame */
+	_FRAME_GOAWAY        = 0x7,   /*!< the GOAWAY frame */
+	_FRAME_WINDOW_UPDATE = 0x8,   /*!< the WINDOW_UPDATE frame */
+	_FRAME_CONTINUATION  = 0x9    /*!< the CONTINUATION frame */
+};
+
+/**
+ * @brief the frame flags
+ **/
+enum {
+	_FLAG_END_STREAM  = 0x1,      /*!< the last frame of the stream */
+	_FLAG_ACK         = 0x1,      /*!< the acknowledgement of SETTINGS and PING */
+	_FLAG_END_HEADERS = 0x4,      /*!< the last frame of the header block */
+	_FLAG_PADDED      = 0x8,      /*!< the frame is padded */
+	_FLAG_PRIORITY    = 0x20      /*!< the HEADERS frame carries the priority fields */
+};
+
+/**
+ * @brief the error codes
+ **/
+enum {
+	_ERR_NO_ERROR            = 0x0,  /*!< graceful shutdown */
+	_ERR_PROTOCOL_ERROR      = 0x1,  /*!< protocol error detected */
+	_ERR_INTERNAL_ERROR      = 0x2,  /*!< implementation fault */
+	_ERR_FLOW_CONTROL_ERROR  = 0x3,  /*!< flow control limits exceeded */
+	_ERR_STREAM_CLOSED       = 0x5,  /*!< frame received for closed stream */
+	_ERR_FRAME_SIZE_ERROR    = 0x6,  /*!< frame size incorrect */
+	_ERR_REFUSED_STREAM      = 0x7,  /*!< stream not processed */
+	_ERR_COMPRESSION_ERROR   = 0x9,  /*!< compression state not updated */
+	_ERR_ENHANCE_YOUR_CALM   = 0xb   /*!< processing capacity exceeded */
+};
+
+/**
+ * @brief the setting identifiers
+ **/
+enum {
+	_SETTINGS_HEADER_TABLE_SIZE      = 0x1,  /*!< the size of the HPACK dynamic table */
+	_SETTINGS_ENABLE_PUSH            = 0x2,  /*!< if the server push is allowed */
+	_SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,  /*!< the maximum number of concurrent streams */
+	_SETTINGS_INITIAL_WINDOW_SIZE    = 0x4,  /*!< the initial flow control window of a stream */
+	_SETTINGS_MAX_FRAME_SIZE         = 0x5,  /*!< the largest frame payload */
+	_SETTINGS_MAX_HEADER_LIST_SIZE   = 0x6   /*!< the largest header list */
+};
+
+/**
+ * @brief the size of the frame header
+ **/
+#define _FRAME_HEADER_SIZE 9
+
+/**
+ * @brief the default settings defined by the RFC
+ **/
+#define _DEFAULT_WINDOW_SIZE 65535
+#define _DEFAULT_FRAME_SIZE  16384
+#define _MAX_WINDOW_SIZE     0x7fffffffll
+#define _MAX_FRAME_SIZE      0xffffff
+
+/**
+ * @brief the response bytes blocked by the flow control are limited to the multiple of the peer window,
+ *        so that a peer which never opens the window can not make us buffer the entire response
+ **/
+#define _STREAM_PENDING_FACTOR 2
+#define _CONN_PENDING_FACTOR   8
+
+/**
+ * @brief the client connection preface
+ **/
+static const char _preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+/**
+ * @brief the size of the client connection preface
+ **/
+#define _PREFACE_SIZE (sizeof(_preface) - 1)
+
+/**
+ * @brief a byte buffer, the valid bytes are in [begin, size)
+ **/
+typedef struct {
+	uint8_t* data;     /*!< the memory */
+	size_t   begin;    /*!< the first valid byte */
+	size_t   size;     /*!< the end of the valid bytes */
+	size_t   capacity; /*!< the capacity of the memory */
+} _buffer_t;
+
+/**
+ * @brief the state of a stream
+ **/
+typedef enum {
+	_STREAM_OPEN,      /*!< the stream is receiving the request */
+	_STREAM_READY,     /*!< the request is complete and the stream is waiting to be served */
+	_STREAM_SERVING,   /*!< the stream is being served */
+	_STREAM_DONE       /*!< the stream has been served, but the response is blocked by the flow control */
+} _stream_state_t;
+
+/**
+ * @brief the state of the HTTP/1.1 response parser
+ **/
+typedef enum {
+	_RESP_HEAD,        /*!< parsing the status line and the header fields */
+	_RESP_BODY,        /*!< the raw body */
+	_RESP_CHUNK_SIZE,  /*!< parsing the size of a chunk */
+	_RESP_CHUNK_EXT,   /*!< skipping the chunk extension */
+	_RESP_CHUNK_DATA,  /*!< the data of a chunk */
+	_RESP_CHUNK_END,   /*!< the CRLF after the chunk data */
+	_RESP_TRAILER,     /*!< the trailer fields after the last chunk */
+	_RESP_DONE         /*!< the chunked body has ended */
+} _resp_state_t;
+
+/**
+ * @brief a stream
+ **/
+struct _module_http2_stream_t {
+	uint32_t                 id;               /*!< the stream id */
+	_stream_state_t          state;            /*!< the stream state */
+	module_http2_stream_t*   next;             /*!< the next stream in the stream list */
+	module_http2_stream_t*   ready_next;       /*!< the next stream in the ready queue */
+	uint32_t                 remote_closed:1;  /*!< the peer has ended the stream */
+	uint32_t                 local_closed:1;   /*!< we have ended the stream */
+	uint32_t                 reset:1;          /*!< the stream has been reset */
+	uint32_t                 malformed:1;      /*!< the request is malformed */
+	uint32_t                 headers_done:1;   /*!< the request header fields are complete */
+	uint32_t                 head_started:1;   /*!< the request line has been written */
+	uint32_t                 regular_seen:1;   /*!< we have seen a regular header field */
+	uint32_t                 has_length:1;     /*!< the request has the content-length field */
+	uint32_t                 end_pending:1;    /*!< the END_STREAM flag should be sent after the pending data */
+	int64_t                  send_window;      /*!< the sending flow control window */
+	int64_t                  recv_window;      /*!< the receiving flow control window */
+	uint32_t                 recv_consumed;    /*!< the bytes received since the last stream WINDOW_UPDATE */
+	size_t                   request_size;     /*!< the size of the request received so far */
+	char*                    method;           /*!< the :method pseudo header */
+	char*                    path;             /*!< the :path pseudo header */
+	char*                    authority;        /*!< the :authority pseudo header */
+	uint32_t                 scheme_seen:1;    /*!< we have seen the :scheme pseudo header */
+	_buffer_t                request;          /*!< the translated request */
+	_buffer_t                body;             /*!< the request body */
+	_buffer_t                cookie;           /*!< the cookie fields, which should be concatenated */
+	size_t                   last_read;        /*!< where the last read begins */
+	_resp_state_t            resp_state;       /*!< the state of the response parser */
+	_buffer_t                resp_head;        /*!< the response head which hasn't been parsed */
+	_buffer_t                header_block;     /*!< the encoded response header block waiting to be sent */
+	uint64_t                 chunk_remaining;  /*!< the remaining bytes of current chunk */
+	uint32_t                 trailer_line;     /*!< the length of the current trailer line */
+	_buffer_t                pending;          /*!< the DATA payload blocked by the flow control */
+};
+
+/**
+ * @brief a connection
+ **/
+struct _module_http2_conn_t {
+	module_http2_conn_conf_t      conf;               /*!< the connection configuration */
+	module_http2_hpack_decoder_t* decoder;            /*!< the HPACK decoder */
+	_buffer_t                     in;                 /*!< the bytes received but not processed */
+	_buffer_t                     out;                /*!< the frames queued */
+	uint32_t                      preface_received:1; /*!< the client preface has been received */
+	uint32_t                      settings_received:1;/*!< the first SETTINGS frame has been received */
+	uint32_t                      goaway_sent:1;      /*!< we have sent the GOAWAY frame */
+	uint32_t                      goaway_received:1;  /*!< the peer has sent the GOAWAY frame */
+	uint32_t                      peer_frame_size;    /*!< the largest frame payload the peer accepts */
+	uint32_t                      peer_window_size;   /*!< the initial stream window of the peer */
+	int64_t                       send_window;        /*!< the connection sending window */
+	int64_t                       recv_window;        /*!< the connection receiving window */
+	uint32_t                      recv_consumed;      /*!< the bytes received since the last connection WINDOW_UPDATE */
+	uint32_t                      last_stream_id;     /*!< the largest stream id opened by the peer */
+	uint32_t                      cont_stream_id;     /*!< the stream expecting CONTINUATION frames, 0 if none */
+	uint32_t                      block_flags;        /*!< the flags of the HEADERS frame which begins current header block */
+	module_http2_stream_t*        block_stream;       /*!< the stream which owns current header block, NULL if the stream is refused */
+	_buffer_t                     header_block;       /*!< the header block fragments received so far */
+	module_http2_stream_t*        streams;            /*!< the stream list */
+	uint32_t                      nstreams;           /*!< the number of streams in the list */
+	module_http2_stream_t*        ready_head;         /*!< the head of the ready queue */
+	module_http2_stream_t*        ready_tail;         /*!< the tail of the ready queue */
+	size_t                        pending_size;       /*!< the DATA payload blocked by the flow control in all the streams */
+};
+
+/**
+ * @brief reserve memory at the end of the buffer
+ * @param buf the buffer
+ * @param size the number of bytes to reserve
+ * @return the pointer to the reserved memory, NULL on error
+ **/
+static inline uint8_t* _buffer_reserve(_buffer_t* buf, size_t size)
+{
+	if(buf->begin > 0 && buf->size + size > buf->capacity)
+	{
+		memmove(buf->data, buf->data + buf->begin, buf->size - buf->begin);
+		buf->size -= buf->begin;
+		buf->begin = 0;
+	}
+
+	if(buf->size + size > buf->capacity)
+	{
+		size_t new_cap = buf->capacity == 0 ? 256 : buf->capacity;
+		while(new_cap < buf->size + size) new_cap *= 2;
+		uint8_t* new_data = (uint8_t*)realloc(buf->data, new_cap);
+		if(NULL == new_data) ERROR_PTR_RETURN_LOG_ERRNO("Cannot resize the buffer");
+		buf->data = new_data;
+		buf->capacity = new_cap;
+	}
+
+	return buf->data + buf->size;
+}
+
+/**
+ * @brief append bytes to the buffer
+ * @param buf the buffer
+ * @param data the data to append
+ * @param size the number of bytes
+ * @return status code
+ **/
+static inline int _buffer_append(_buffer_t* buf, const void* data, size_t size)
+{
+	if(size == 0) return 0;
+
+	uint8_t* ptr = _buffer_reserve(buf, size);
+	if(NULL == ptr) ERROR_RETURN_LOG(int, "Cannot reserve memory in the buffer");
+
+	memcpy(ptr, data, size);
+	buf->size += size;
+	return 0;
+}
+
+/**
+ * @brief the number of valid bytes in the buffer
+ * @param buf the buffer
+ * @return the number of bytes
+ **/
+static inline size_t _buffer_size(const _buffer_t* buf)
+{
+	return buf->size - buf->begin;
+}
+
+/**
+ * @brief consume bytes from the beginning of the buffer
+ * @param buf the buffer
+ * @param size the number of bytes
+ * @return nothing
+ **/
+static inline void _buffer_consume(_buffer_t* buf, size_t size)
+{
+	buf->begin += size;
+	if(buf->begin >= buf->size) buf->begin = buf->size = 0;
+}
+
+/**
+ * @brief release the memory of the buffer
+ * @param buf the buffer
+ * @return nothing
+ **/
+static inline void _buffer_free(_buffer_t* buf)
+{
+	if(NULL != buf->data) free(buf->data);
+	buf->data = NULL;
+	buf->begin = buf->size = buf->capacity = 0;
+}
+
+/**
+ * @brief queue a frame
+ * @param conn the connection
+ * @param type the frame type
+ * @param flags the frame flags
+ * @param stream_id the stream id
+ * @param payload the payload
+ * @param size the payload size
+ * @return status code
+ **/
+static inline int _emit(module_http2_conn_t* conn, uint8_t type, uint8_t flags, uint32_t stream_id, const void* payload, size_t size)
+{
+	uint8_t* ptr = _buffer_reserve(&conn->out, _FRAME_HEADER_SIZE + size);
+	if(NULL == ptr) ERROR_RETURN_LOG(int, "Cannot reserve the output buffer");
+
+	ptr[0] = (uint8_t)(size >> 16);
+	ptr[1] = (uint8_t)(size >> 8);
+	ptr[2] = (uint8_t)size;
+	ptr[3] = type;
+	ptr[4] = flags;
+	ptr[5] = (uint8_t)((stream_id >> 24) & 0x7f);
+	ptr[6] = (uint8_t)(stream_id >> 16);
+	ptr[7] = (uint8_t)(stream_id >> 8);
+	ptr[8] = (uint8_t)stream_id;
+
+	if(size > 0) memcpy(ptr + _FRAME_HEADER_SIZE, payload, size);
+
+	conn->out.size += _FRAME_HEADER_SIZE + size;
+
+	return 0;
+}
+
+/**
+ * @brief read a 32 bits big endian integer
+ * @param ptr the pointer to the integer
+ * @return the integer
+ **/
+static inline uint32_t _get_u32(const uint8_t* ptr)
+{
+	return ((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) | ((uint32_t)ptr[2] << 8) | (uint32_t)ptr[3];
+}
+
+/**
+ * @brief write a 32 bits big endian integer
+ * @param ptr the pointer to the buffer
+ * @param value the integer
+ * @return nothing
+ **/
+static inline void _put_u32(uint8_t* ptr, uint32_t value)
+{
+	ptr[0] = (uint8_t)(value >> 24);
+	ptr[1] = (uint8_t)(value >> 16);
+	ptr[2] = (uint8_t)(value >> 8);
+	ptr[3] = (uint8_t)value;
+}
+
+/**
+ * @brief queue a WINDOW_UPDATE frame
+ * @param conn the connection
+ * @param stream_id the stream id, 0 for the connection window
+ * @param increment the window increment
+ * @return status code
+ **/
+static inline int _emit_window_update(module_http2_conn_t* conn, uint32_t stream_id, uint32_t increment)
+{
+	uint8_t payload[4];
+	_put_u32(payload, increment);
+	return _emit(conn, _FRAME_WINDOW_UPDATE, 0, stream_id, payload, sizeof(payload));
+}
+
+/**
+ * @brief queue a RST_STREAM frame
+ * @param conn the connection
+ * @param stream_id the stream id
+ * @param code the error code
+ * @return status code
+ **/
+static inline int _emit_rst_stream(module_http2_conn_t* conn, uint32_t stream_id, uint32_t code)
+{
+	uint8_t payload[4];
+	_put_u32(payload, code);
+	return _emit(conn, _FRAME_RST_STREAM, 0, stream_id, payload, sizeof(payload));
+}
+
+/**
+ * @brief raise a connection error, which sends the GOAWAY frame and stops processing the input
+ * @param conn the connection
+ * @param code the error code
+ * @return status code
+ **/
+static inline int _conn_error(module_http2_conn_t* conn, uint32_t code)
+{
+	if(conn->goaway_sent) return 0;
+
+	LOG_DEBUG("HTTP/2 connection error %u", code);
+
+	uint8_t payload[8];
+	_put_u32(payload, conn->last_stream_id);
+	_put_u32(payload + 4, code);
+
+	conn->goaway_sent = 1;
+
+	return _emit(conn, _FRAME_GOAWAY, 0, 0, payload, sizeof(payload));
+}
+
+/**
+ * @brief find the stream in the stream list
+ * @param conn the connection
+ * @param id the stream id
+ * @return the stream or NULL if the stream is closed or idle
+ **/
+static inline module_http2_stream_t* _find_stream(const module_http2_conn_t* conn, uint32_t id)
+{
+	module_http2_stream_t* ret;
+	for(ret = conn->streams; NULL != ret && ret->id != id; ret = ret->next);
+	return ret;
+}
+
+/**
+ * @brief discard the DATA payload blocked by the flow control
+ * @param conn the connection
+ * @param stream the stream
+ * @return nothing
+ **/
+static inline void _stream_drop_pending(module_http2_conn_t* conn, module_http2_stream_t* stream)
+{
+	conn->pending_size -= _buffer_size(&stream->pending);
+	_buffer_free(&stream->pending);
+}
+
+/**
+ * @brief remove the stream from the stream list and dispose it
+ * @param conn the connection
+ * @param stream the stream
+ * @return nothing
+ **/
+static inline void _stream_free(module_http2_conn_t* conn, module_http2_stream_t* stream)
+{
+	module_http2_stream_t** ptr;
+	for(ptr = &conn->streams; NULL != *ptr && *ptr != stream; ptr = &(*ptr)->next);
+	if(NULL != *ptr)
+	{
+		*ptr = stream->next;
+		conn->nstreams --;
+	}
+
+	if(NULL != stream->method) free(stream->method);
+	if(NULL != stream->path) free(stream->path);
+	if(NULL != stream->authority) free(stream->authority);
+	_buffer_free(&stream->request);
+	_buffer_free(&stream->body);
+	_buffer_free(&stream->cookie);
+	_buffer_free(&stream->resp_head);
+	_buffer_free(&stream->header_block);
+	_stream_drop_pending(conn, stream);
+	free(stream);
+}
+
+/**
+ * @brief raise a stream error, which resets the stream
+ * @details the stream which is being served is kept until the caller is done with it
+ * @param conn the connection
+ * @param stream_id the stream id
+ * @param code the error code
+ * @return status code
+ **/
+static inline int _stream_error(module_http2_conn_t* conn, uint32_t stream_id, uint32_t code)
+{
+	LOG_DEBUG("HTTP/2 stream %u error %u", stream_id, code);
+
+	module_http2_stream_t* stream = _find_stream(conn, stream_id);
+
+	if(NULL != stream)
+	{
+		if(stream->local_closed && stream->remote_closed) return 0;
+
+		stream->reset = 1;
+		stream->local_closed = stream->remote_closed = 1;
+		_stream_drop_pending(conn, stream);
+
+		/* The stream in the ready queue is disposed when it's popped */
+		if(stream->state == _STREAM_OPEN || stream->state == _STREAM_DONE)
+			_stream_free(conn, stream);
+	}
+
+	return _emit_rst_stream(conn, stream_id, code);
+}
+
+module_http2_conn_t* module_http2_conn_new(const module_http2_conn_conf_t* conf)
+{
+	if(NULL == conf || conf->max_frame_size < _DEFAULT_FRAME_SIZE || conf->max_frame_size > _MAX_FRAME_SIZE ||
+	   conf->initial_window_size > _MAX_WINDOW_SIZE || conf->max_concurrent_streams == 0)
+		ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	module_http2_conn_t* ret = (module_http2_conn_t*)calloc(1, sizeof(*ret));
+	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the HTTP/2 connection");
+
+	ret->conf = *conf;
+	ret->peer_frame_size = _DEFAULT_FRAME_SIZE;
+	ret->peer_window_size = _DEFAULT_WINDOW_SIZE;
+	ret->send_window = _DEFAULT_WINDOW_SIZE;
+	ret->recv_window = _DEFAULT_WINDOW_SIZE;
+
+	if(NULL == (ret->decoder = module_http2_hpack_decoder_new(conf->header_table_size)))
+		ERROR_LOG_GOTO(ERR, "Cannot create the HPACK decoder");
+
+	/* The server connection preface */
+	uint8_t settings[24];
+	uint32_t settings_size = 0;
+#define _SETTING(id, value) do {\
+	settings[settings_size] = 0;\
+	settings[settings_size + 1] = (id);\
+	_put_u32(settings + settings_size + 2, (value));\
+	settings_size += 6;\
+} while(0)
+	_SETTING(_SETTINGS_HEADER_TABLE_SIZE, conf->header_table_size);
+	_SETTING(_SETTINGS_MAX_CONCURRENT_STREAMS, conf->max_concurrent_streams);
+	_SETTING(_SETTINGS_INITIAL_WINDOW_SIZE, conf->initial_window_size);
+	_SETTING(_SETTINGS_MAX_FRAME_SIZE, conf->max_frame_size);
+#undef _SETTING
+
+	if(ERROR_CODE(int) == _emit(ret, _FRAME_SETTINGS, 0, 0, settings, settings_size))
+		ERROR_LOG_GOTO(ERR, "Cannot queue the SETTINGS frame");
+
+	/* The connection window can only be enlarged by the WINDOW_UPDATE frame */
+	if(conf->initial_window_size > _DEFAULT_WINDOW_SIZE)
+	{
+		if(ERROR_CODE(int) == _emit_window_update(ret, 0, conf->initial_window_size - _DEFAULT_WINDOW_SIZE))
+			ERROR_LOG_GOTO(ERR, "Cannot queue the WINDOW_UPDATE frame");
+		ret->recv_window = conf->initial_window_size;
+	}
+
+	return ret;
+ERR:
+	if(NULL != ret->decoder) module_http2_hpack_decoder_free(ret->decoder);
+	_buffer_free(&ret->out);
+	free(ret);
+	return NULL;
+}
+
+int module_http2_conn_free(module_http2_conn_t* conn)
+{
+	if(NULL == conn) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	int rc = 0;
+
+	while(NULL != conn->streams)
+		_stream_free(conn, conn->streams);
+
+	if(ERROR_CODE(int) == module_http2_hpack_decoder_free(conn->decoder))
+		rc = ERROR_CODE(int);
+
+	_buffer_free(&conn->in);
+	_buffer_free(&conn->out);
+	_buffer_free(&conn->header_block);
+	free(conn);
+
+	return rc;
+}
+
+/**
+ * @brief check if the character is allowed in a header field name
+ * @param ch the character
+ * @return the check result
+ **/
+static inline int _valid_name_char(char ch)
+{
+	if(ch >= 'a' && ch <= 'z') return 1;
+	if(ch >= '0' && ch <= '9') return 1;
+	return NULL != strchr("!#$%&'*+-.^_`|~", ch) && ch != 0;
+}
+
+/**
+ * @brief compare the field name
+ * @param name the field name
+ * @param name_len the length of the field name
+ * @param expected the expected name
+ * @return if the name matches
+ **/
+static inline int _name_is(const char* name, size_t name_len, const char* expected)
+{
+	return strncmp(name, expected, name_len) == 0 && expected[name_len] == 0;
+}
+
+/**
+ * @brief write the request line and the Host field of the translated request
+ * @param stream the stream
+ * @return status code
+ **/
+static inline int _begin_request_head(module_http2_stream_t* stream)
+{
+	if(stream->head_started) return 0;
+
+	stream->head_started = 1;
+
+	if(NULL == stream->method || NULL == stream->path || !stream->scheme_seen)
+	{
+		LOG_DEBUG("The request of stream %u lacks mandatory pseudo header fields", stream->id);
+		stream->malformed = 1;
+		return 0;
+	}
+
+	if(ERROR_CODE(int) == _buffer_append(&stream->request, stream->method, strlen(stream->method)) ||
+	   ERROR_CODE(int) == _buffer_append(&stream->request, " ", 1) ||
+	   ERROR_CODE(int) == _buffer_append(&stream->request, stream->path, strlen(stream->path)) ||
+	   ERROR_CODE(int) == _buffer_append(&stream->request, " HTTP/1.1\r\n", 11))
+		ERROR_RETURN_LOG(int, "Cannot write the request line");
+
+	if(NULL != stream->authority &&
+	   (ERROR_CODE(int) == _buffer_append(&stream->request, "Host: ", 6) ||
+	    ERROR_CODE(int) == _buffer_append(&stream->request, stream->authority, strlen(stream->authority)) ||
+	    ERROR_CODE(int) == _buffer_append(&stream->request, "\r\n", 2)))
+		ERROR_RETURN_LOG(int, "Cannot write the Host field");
+
+	return 0;
+}
+
+/**
+ * @brief the HPACK callback which translates the request header field
+ * @param name the field name
+ * @param name_len the length of the name
+ * @param value the field value
+ * @param value_len the length of the value
+ * @param data the stream, NULL if the header block is going to be discarded
+ * @return status code
+ **/
+static int _on_request_field(const char* name, size_t name_len, const char* value, size_t value_len, void* data)
+{
+	module_http2_stream_t* stream = (module_http2_stream_t*)data;
+
+	/* The header block of a refused stream or the trailer fields, we just need to keep the HPACK state */
+	if(NULL == stream || stream->headers_done || stream->malformed) return 0;
+
+	stream->request_size += name_len + value_len + 32;
+
+	size_t i;
+	/* The value must not break the translated HTTP/1.1 message */
+	for(i = 0; i < value_len; i ++)
+		if(value[i] == 0 || value[i] == '\r' || value[i] == '\n')
+			goto MALFORMED;
+
+	if(name_len == 0) goto MALFORMED;
+
+	if(name[0] == ':')
+	{
+		char** target = NULL;
+		if(stream->regular_seen) goto MALFORMED;
+
+		if(_name_is(name, name_len, ":method")) target = &stream->method;
+		else if(_name_is(name, name_len, ":path")) target = &stream->path;
+		else if(_name_is(name, name_len, ":authority")) target = &stream->authority;
+		else if(_name_is(name, name_len, ":scheme"))
+		{
+			if(stream->scheme_seen) goto MALFORMED;
+			stream->scheme_seen = 1;
+			return 0;
+		}
+		else goto MALFORMED;
+
+		if(NULL != *target || value_len == 0) goto MALFORMED;
+
+		for(i = 0; i < value_len; i ++)
+			if(value[i] == ' ' || value[i] == '\t')
+				goto MALFORMED;
+
+		if(NULL == (*target = (char*)malloc(value_len + 1)))
+			ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the pseudo header field");
+		memcpy(*target, value, value_len);
+		(*target)[value_len] = 0;
+
+		return 0;
+	}
+
+	for(i = 0; i < name_len; i ++)
+		if(!_valid_name_char(name[i]))
+			goto MALFORMED;
+
+	stream->regular_seen = 1;
+
+	if(ERROR_CODE(int) == _begin_request_head(stream))
+		ERROR_RETURN_LOG(int, "Cannot begin the request head");
+
+	/* The connection specific fields are meaningless in HTTP/2, and we compute the content length by ourselves */
+	if(_name_is(name, name_len, "connection") || _name_is(name, name_len, "keep-alive") ||
+	   _name_is(name, name_len, "proxy-connection") || _name_is(name, name_len, "transfer-encoding") ||
+	   _name_is(name, name_len, "upgrade") || _name_is(name, name_len, "te"))
+		return 0;
+
+	if(_name_is(name, name_len, "content-length"))
+	{
+		stream->has_length = 1;
+		return 0;
+	}
+
+	if(_name_is(name, name_len, "host") && NULL != stream->authority)
+		return 0;
+
+	if(_name_is(name, name_len, "cookie"))
+	{
+		if(_buffer_size(&stream->cookie) > 0 && ERROR_CODE(int) == _buffer_append(&stream->cookie, "; ", 2))
+			ERROR_RETURN_LOG(int, "Cannot append the cookie separator");
+		if(ERROR_CODE(int) == _buffer_append(&stream->cookie, value, value_len))
+			ERROR_RETURN_LOG(int, "Cannot append the cookie");
+		return 0;
+	}
+
+	if(ERROR_CODE(int) == _buffer_append(&stream->request, name, name_len) ||
+	   ERROR_CODE(int) == _buffer_append(&stream->request, ": ", 2) ||
+	   ERROR_CODE(int) == _buffer_append(&stream->request, value, value_len) ||
+	   ERROR_CODE(int) == _buffer_append(&stream->request, "\r\n", 2))
+		ERROR_RETURN_LOG(int, "Cannot write the header field");
+
+	return 0;
+MALFORMED:
+	LOG_DEBUG("Malformed header field in stream %u", stream->id);
+	stream->malformed = 1;
+	return 0;
+}
+
+/**
+ * @brief finish the translated request and put the stream into the ready queue
+ * @param conn the connection
+ * @param stream the stream
+ * @return status code
+ **/
+static inline int _request_complete(module_http2_conn_t* conn, module_http2_stream_t* stream)
+{
+	char buf[64];
+
+	stream->remote_closed = 1;
+
+	if(ERROR_CODE(int) == _begin_request_head(stream))
+		ERROR_RETURN_LOG(int, "Cannot begin the request head");
+
+	if(stream->malformed)
+		return _stream_error(conn, stream->id, _ERR_PROTOCOL_ERROR);
+
+	if(_buffer_size(&stream->cookie) > 0 &&
+	   (ERROR_CODE(int) == _buffer_append(&stream->request, "Cookie: ", 8) ||
+	    ERROR_CODE(int) == _buffer_append(&stream->request, stream->cookie.data + stream->cookie.begin, _buffer_size(&stream->cookie)) ||
+	    ERROR_CODE(int) == _buffer_append(&stream->request, "\r\n", 2)))
+		ERROR_RETURN_LOG(int, "Cannot write the cookie field");
+
+	size_t body_size = _buffer_size(&stream->body);
+	if(body_size > 0 || stream->has_length)
+	{
+		int len = snprintf(buf, sizeof(buf), "Content-Length: %zu\r\n", body_size);
+		if(ERROR_CODE(int) == _buffer_append(&stream->request, buf, (size_t)len))
+			ERROR_RETURN_LOG(int, "Cannot write the content length field");
+	}
+
+	if(ERROR_CODE(int) == _buffer_append(&stream->request, "\r\n", 2) ||
+	   ERROR_CODE(int) == _buffer_append(&stream->request, stream->body.data + stream->body.begin, body_size))
+		ERROR_RETURN_LOG(int, "Cannot write the request body");
+
+	_buffer_free(&stream->body);
+	_buffer_free(&stream->cookie);
+
+	stream->state = _STREAM_READY;
+	stream->ready_next = NULL;
+	if(NULL == conn->ready_tail) conn->ready_head = stream;
+	else conn->ready_tail->ready_next = stream;
+	conn->ready_tail = stream;
+
+	return 0;
+}
+
+/**
+ * @brief process a complete header block
+ * @param conn the connection
+ * @return status code
+ **/
+static inline int _header_block_complete(module_http2_conn_t* conn)
+{
+	module_http2_stream_t* stream = conn->block_stream;
+	uint32_t stream_id = conn->cont_stream_id;
+
+	conn->cont_stream_id = 0;
+	conn->block_stream = NULL;
+
+	int rc = module_http2_hpack_decode(conn->decoder, conn->header_block.data + conn->header_block.begin,
+	                                   _buffer_size(&conn->header_block), _on_request_field, stream);
+	_buffer_free(&conn->header_block);
+
+	if(ERROR_CODE(int) == rc)
+		return _conn_error(conn, _ERR_COMPRESSION_ERROR);
+
+	/* The stream has been refused */
+	if(NULL == stream)
+		return _emit_rst_stream(conn, stream_id, _ERR_REFUSED_STREAM);
+
+	if(stream->request_size > conn->conf.max_request_size)
+		return _stream_error(conn, stream->id, _ERR_ENHANCE_YOUR_CALM);
+
+	if(!stream->headers_done)
+	{
+		if(ERROR_CODE(int) == _begin_request_head(stream))
+			ERROR_RETURN_LOG(int, "Cannot begin the request head");
+
+		if(stream->malformed)
+			return _stream_error(conn, stream->id, _ERR_PROTOCOL_ERROR);
+
+		stream->headers_done = 1;
+	}
+	else if(!(conn->block_flags & _FLAG_END_STREAM))
+	{
+		/* Trailer fields must end the stream */
+		return _stream_error(conn, stream->id, _ERR_PROTOCOL_ERROR);
+	}
+
+	if(conn->block_flags & _FLAG_END_STREAM)
+		return _request_complete(conn, stream);
+
+	return 0;
+}
+
+/**
+ * @brief strip the padding of the frame payload
+ * @param flags the frame flags
+ * @param payload the payload, which will be updated
+ * @param size the payload size, which will be updated
+ * @return 0 if the padding is valid, 1 if the padding is invalid
+ **/
+static inline int _strip_padding(uint8_t flags, const uint8_t** payload, uint32_t* size)
+{
+	if(!(flags & _FLAG_PADDED)) return 0;
+
+	if(*size < 1) return 1;
+
+	uint32_t pad = (*payload)[0];
+	if(pad >= *size) return 1;
+
+	(*payload) ++;
+	*size -= pad + 1;
+
+	return 0;
+}
+
+/**
+ * @brief send the pending DATA frames of the stream as the flow control window allows
+ * @param conn the connection
+ * @param stream the stream
+ * @return status code
+ **/
+static inline int _stream_flush(module_http2_conn_t* conn, module_http2_stream_t* stream)
+{
+	if(stream->local_closed) return 0;
+
+	while(_buffer_size(&stream->pending) > 0 && conn->send_window > 0 && stream->send_window > 0)
+	{
+		size_t size = _buffer_size(&stream->pending);
+		uint8_t flags = 0;
+
+		if((int64_t)size > conn->send_window) size = (size_t)conn->send_window;
+		if((int64_t)size > stream->send_window) size = (size_t)stream->send_window;
+		if(size > conn->peer_frame_size) size = conn->peer_frame_size;
+
+		if(size == _buffer_size(&stream->pending) && stream->end_pending)
+			flags = _FLAG_END_STREAM;
+
+		if(ERROR_CODE(int) == _emit(conn, _FRAME_DATA, flags, stream->id, stream->pending.data + stream->pending.begin, size))
+			ERROR_RETURN_LOG(int, "Cannot queue the DATA frame");
+
+		_buffer_consume(&stream->pending, size);
+		conn->pending_size -= size;
+		conn->send_window -= (int64_t)size;
+		stream->send_window -= (int64_t)size;
+
+		if(flags & _FLAG_END_STREAM) stream->local_closed = 1;
+	}
+
+	/* The empty DATA frame doesn't consume the window */
+	if(!stream->local_closed && stream->end_pending && _buffer_size(&stream->pending) == 0)
+	{
+		if(ERROR_CODE(int) == _emit(conn, _FRAME_DATA, _FLAG_END_STREAM, stream->id, NULL, 0))
+			ERROR_RETURN_LOG(int, "Cannot queue the DATA frame");
+		stream->local_closed = 1;
+	}
+
+	if(stream->local_closed)
+	{
+		_stream_drop_pending(conn, stream);
+		if(stream->state == _STREAM_DONE)
+			_stream_free(conn, stream);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief send the pending DATA frames of all the streams
+ * @param conn the connection
+ * @return status code
+ **/
+static inline int _flush_all_streams(module_http2_conn_t* conn)
+{
+	module_http2_stream_t* stream, *next;
+	for(stream = conn->streams; NULL != stream && conn->send_window > 0; stream = next)
+	{
+		next = stream->next;
+		if(ERROR_CODE(int) == _stream_flush(conn, stream))
+			ERROR_RETURN_LOG(int, "Cannot flush the stream %u", stream->id);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief process the SETTINGS frame
+ * @param conn the connection
+ * @param flags the frame flags
+ * @param payload the payload
+ * @param size the payload size
+ * @return status code
+ **/
+static inline int _process_settings(module_http2_conn_t* conn, uint8_t flags, const uint8_t* payload, uint32_t size)
+{
+	if(flags & _FLAG_ACK)
+		return size == 0 ? 0 : _conn_error(conn, _ERR_FRAME_SIZE_ERROR);
+
+	if(size % 6 != 0) return _conn_error(conn, _ERR_FRAME_SIZE_ERROR);
+
+	uint32_t i;
+	for(i = 0; i < size; i += 6)
+	{
+		uint32_t id = ((uint32_t)payload[i] << 8) | payload[i + 1];
+		uint32_t value = _get_u32(payload + i + 2);
+
+		switch(id)
+		{
+			case _SETTINGS_ENABLE_PUSH:
+				if(value > 1) return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+				break;
+			case _SETTINGS_INITIAL_WINDOW_SIZE:
+			{
+				if(value > _MAX_WINDOW_SIZE) return _conn_error(conn, _ERR_FLOW_CONTROL_ERROR);
+
+				int64_t delta = (int64_t)value - (int64_t)conn->peer_window_size;
+				module_http2_stream_t* stream;
+				for(stream = conn->streams; NULL != stream; stream = stream->next)
+				{
+					stream->send_window += delta;
+					if(stream->send_window > _MAX_WINDOW_SIZE)
+						return _conn_error(conn, _ERR_FLOW_CONTROL_ERROR);
+				}
+				conn->peer_window_size = value;
+				break;
+			}
+			case _SETTINGS_MAX_FRAME_SIZE:
+				if(value < _DEFAULT_FRAME_SIZE || value > _MAX_FRAME_SIZE)
+					return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+				conn->peer_frame_size = value;
+				break;
+			default:
+				/* The encoder doesn't use the dynamic table, and we never push or initiate a stream,
+				 * so the rest of the settings doesn't affect us */
+				break;
+		}
+	}
+
+	if(ERROR_CODE(int) == _emit(conn, _FRAME_SETTINGS, _FLAG_ACK, 0, NULL, 0))
+		ERROR_RETURN_LOG(int, "Cannot queue the SETTINGS ACK frame");
+
+	return _flush_all_streams(conn);
+}
+
+/**
+ * @brief process the HEADERS frame
+ * @param conn the connection
+ * @param flags the frame flags
+ * @param stream_id the stream id
+ * @param payload the payload
+ * @param size the payload size
+ * @return status code
+ **/
+static inline int _process_headers(module_http2_conn_t* conn, uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t size)
+{
+	if(stream_id == 0 || (stream_id & 1) == 0) return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+
+	if(_strip_padding(flags, &payload, &size)) return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+
+	if(flags & _FLAG_PRIORITY)
+	{
+		if(size < 5) return _conn_error(conn, _ERR_FRAME_SIZE_ERROR);
+		if((_get_u32(payload) & 0x7fffffffu) == stream_id) return _stream_error(conn, stream_id, _ERR_PROTOCOL_ERROR);
+		payload += 5;
+		size -= 5;
+	}
+
+	module_http2_stream_t* stream = _find_stream(conn, stream_id);
+
+	if(NULL == stream)
+	{
+		if(stream_id <= conn->last_stream_id) return _conn_error(conn, _ERR_STREAM_CLOSED);
+
+		conn->last_stream_id = stream_id;
+
+		/* We still need to decode the header block of a refused stream, so just leave the stream NULL */
+		if(conn->nstreams < conn->conf.max_concurrent_streams && !conn->goaway_received)
+		{
+			if(NULL == (stream = (module_http2_stream_t*)calloc(1, sizeof(*stream))))
+				ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the stream");
+
+			stream->id = stream_id;
+			stream->state = _STREAM_OPEN;
+			stream->send_window = conn->peer_window_size;
+			stream->recv_window = conn->conf.initial_window_size;
+			stream->resp_state = _RESP_HEAD;
+			stream->next = conn->streams;
+			conn->streams = stream;
+			conn->nstreams ++;
+		}
+	}
+	else if(stream->remote_closed)
+		return _conn_error(conn, _ERR_STREAM_CLOSED);
+
+	conn->block_flags = flags;
+	conn->block_stream = stream;
+	conn->cont_stream_id = stream_id;
+
+	if(ERROR_CODE(int) == _buffer_append(&conn->header_block, payload, size))
+		ERROR_RETURN_LOG(int, "Cannot append the header block fragment");
+
+	if(flags & _FLAG_END_HEADERS)
+		return _header_block_complete(conn);
+
+	return 0;
+}
+
+/**
+ * @brief process the DATA frame
+ * @param conn the connection
+ * @param flags the frame flags
+ * @param stream_id the stream id
+ * @param payload the payload
+ * @param size the payload size
+ * @return status code
+ **/
+static inline int _process_data(module_http2_conn_t* conn, uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t size)
+{
+	if(stream_id == 0) return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+
+	/* The entire frame, including the padding, is subject to the flow control */
+	conn->recv_window -= size;
+	if(conn->recv_window < 0) return _conn_error(conn, _ERR_FLOW_CONTROL_ERROR);
+
+	/* The body is buffered, so we can return the connection window right away */
+	conn->recv_consumed += size;
+	if(conn->recv_consumed >= conn->conf.initial_window_size / 2)
+	{
+		if(ERROR_CODE(int) == _emit_window_update(conn, 0, conn->recv_consumed))
+			ERROR_RETURN_LOG(int, "Cannot queue the WINDOW_UPDATE frame");
+		conn->recv_window += conn->recv_consumed;
+		conn->recv_consumed = 0;
+	}
+
+	if(_strip_padding(flags, &payload, &size)) return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+
+	module_http2_stream_t* stream = _find_stream(conn, stream_id);
+
+	if(NULL == stream)
+	{
+		if(stream_id > conn->last_stream_id) return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+		return _emit_rst_stream(conn, stream_id, _ERR_STREAM_CLOSED);
+	}
+
+	if(stream->remote_closed || !stream->headers_done)
+		return _stream_error(conn, stream_id, _ERR_STREAM_CLOSED);
+
+	stream->recv_window -= size;
+	if(stream->recv_window < 0) return _stream_error(conn, stream_id, _ERR_FLOW_CONTROL_ERROR);
+
+	stream->request_size += size;
+	if(stream->request_size > conn->conf.max_request_size)
+		return _stream_error(conn, stream_id, _ERR_ENHANCE_YOUR_CALM);
+
+	if(ERROR_CODE(int) == _buffer_append(&stream->body, payload, size))
+		ERROR_RETURN_LOG(int, "Cannot append the request body");
+
+	if(flags & _FLAG_END_STREAM)
+		return _request_complete(conn, stream);
+
+	stream->recv_consumed += size;
+	if(stream->recv_consumed >= conn->conf.initial_window_size / 2)
+	{
+		if(ERROR_CODE(int) == _emit_window_update(conn, stream_id, stream->recv_consumed))
+			ERROR_RETURN_LOG(int, "Cannot queue the WINDOW_UPDATE frame");
+		stream->recv_window += stream->recv_consumed;
+		stream->recv_consumed = 0;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief process the WINDOW_UPDATE frame
+ * @param conn the connection
+ * @param stream_id the stream id
+ * @param payload the payload
+ * @param size the payload size
+ * @return status code
+ **/
+static inline int _process_window_update(module_http2_conn_t* conn, uint32_t stream_id, const uint8_t* payload, uint32_t size)
+{
+	if(size != 4) return _conn_error(conn, _ERR_FRAME_SIZE_ERROR);
+
+	uint32_t increment = _get_u32(payload) & 0x7fffffffu;
+
+	if(stream_id == 0)
+	{
+		if(increment == 0) return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+		conn->send_window += increment;
+		if(conn->send_window > _MAX_WINDOW_SIZE) return _conn_error(conn, _ERR_FLOW_CONTROL_ERROR);
+		return _flush_all_streams(conn);
+	}
+
+	module_http2_stream_t* stream = _find_stream(conn, stream_id);
+
+	if(NULL == stream)
+	{
+		if(stream_id > conn->last_stream_id) return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+		return 0;
+	}
+
+	if(increment == 0) return _stream_error(conn, stream_id, _ERR_PROTOCOL_ERROR);
+
+	stream->send_window += increment;
+	if(stream->send_window > _MAX_WINDOW_SIZE) return _stream_error(conn, stream_id, _ERR_FLOW_CONTROL_ERROR);
+
+	return _stream_flush(conn, stream);
+}
+
+/**
+ * @brief process a single frame
+ * @param conn the connection
+ * @param type the frame type
+ * @param flags the frame flags
+ * @param stream_id the stream id
+ * @param payload the payload
+ * @param size the payload size
+ * @return status code
+ **/
+static inline int _process_frame(module_http2_conn_t* conn, uint8_t type, uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t size)
+{
+	if(!conn->settings_received)
+	{
+		if(type != _FRAME_SETTINGS || (flags & _FLAG_ACK)) return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+		conn->settings_received = 1;
+	}
+
+	/* Nothing but the CONTINUATION frame of the same stream can interleave the header block */
+	if(conn->cont_stream_id != 0 && (type != _FRAME_CONTINUATION || stream_id != conn->cont_stream_id))
+		return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+
+	switch(type)
+	{
+		case _FRAME_DATA:
+			return _process_data(conn, flags, stream_id, payload, size);
+		case _FRAME_HEADERS:
+			return _process_headers(conn, flags, stream_id, payload, size);
+		case _FRAME_CONTINUATION:
+			if(conn->cont_stream_id == 0) return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+			if(_buffer_size(&conn->header_block) + size > conn->conf.max_request_size)
+				return _conn_error(conn, _ERR_ENHANCE_YOUR_CALM);
+			if(ERROR_CODE(int) == _buffer_append(&conn->header_block, payload, size))
+				ERROR_RETURN_LOG(int, "Cannot append the header block fragment");
+			if(flags & _FLAG_END_HEADERS)
+				return _header_block_complete(conn);
+			return 0;
+		case _FRAME_PRIORITY:
+			if(stream_id == 0) return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+			if(size != 5) return _stream_error(conn, stream_id, _ERR_FRAME_SIZE_ERROR);
+			/* We serve the streams as soon as possible, thus the priority is ignored */
+			return 0;
+		case _FRAME_RST_STREAM:
+		{
+			if(stream_id == 0 || stream_id > conn->last_stream_id) return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+			if(size != 4) return _conn_error(conn, _ERR_FRAME_SIZE_ERROR);
+			module_http2_stream_t* stream = _find_stream(conn, stream_id);
+			if(NULL != stream)
+			{
+				stream->reset = 1;
+				stream->local_closed = stream->remote_closed = 1;
+				_stream_drop_pending(conn, stream);
+				if(stream->state == _STREAM_OPEN || stream->state == _STREAM_DONE)
+					_stream_free(conn, stream);
+			}
+			return 0;
+		}
+		case _FRAME_SETTINGS:
+			if(stream_id != 0) return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+			return _process_settings(conn, flags, payload, size);
+		case _FRAME_PUSH_PROMISE:
+			return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+		case _FRAME_PING:
+			if(stream_id != 0) return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+			if(size != 8) return _conn_error(conn, _ERR_FRAME_SIZE_ERROR);
+			if(flags & _FLAG_ACK) return 0;
+			return _emit(conn, _FRAME_PING, _FLAG_ACK, 0, payload, size);
+		case _FRAME_GOAWAY:
+			if(stream_id != 0) return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+			if(size < 8) return _conn_error(conn, _ERR_FRAME_SIZE_ERROR);
+			LOG_DEBUG("The peer is going away with error code %u", _get_u32(payload + 4));
+			conn->goaway_received = 1;
+			return 0;
+		case _FRAME_WINDOW_UPDATE:
+			return _process_window_update(conn, stream_id, payload, size);
+		default:
+			/* Unknown frame types must be ignored */
+			return 0;
+	}
+}
+
+int module_http2_conn_feed(module_http2_conn_t* conn, const void* data, size_t size)
+{
+	if(NULL == conn || (NULL == data && size > 0)) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if(conn->goaway_sent) return 0;
+
+	if(ERROR_CODE(int) == _buffer_append(&conn->in, data, size))
+		ERROR_RETURN_LOG(int, "Cannot append the received bytes");
+
+	if(!conn->preface_received)
+	{
+		size_t avail = _buffer_size(&conn->in);
+		size_t cmp_size = avail < _PREFACE_SIZE ? avail : _PREFACE_SIZE;
+
+		if(memcmp(conn->in.data + conn->in.begin, _preface, cmp_size) != 0)
+		{
+			_buffer_free(&conn->in);
+			return _conn_error(conn, _ERR_PROTOCOL_ERROR);
+		}
+
+		if(avail < _PREFACE_SIZE) return 0;
+
+		_buffer_consume(&conn->in, _PREFACE_SIZE);
+		conn->preface_received = 1;
+	}
+
+	while(!conn->goaway_sent && _buffer_size(&conn->in) >= _FRAME_HEADER_SIZE)
+	{
+		const uint8_t* header = conn->in.data + conn->in.begin;
+		uint32_t length = ((uint32_t)header[0] << 16) | ((uint32_t)header[1] << 8) | header[2];
+
+		if(length > conn->conf.max_frame_size)
+		{
+			_conn_error(conn, _ERR_FRAME_SIZE_ERROR);
+			break;
+		}
+
+		if(_buffer_size(&conn->in) < _FRAME_HEADER_SIZE + length) break;
+
+		if(ERROR_CODE(int) == _process_frame(conn, header[3], header[4], _get_u32(header + 5) & 0x7fffffffu,
+		                                     header + _FRAME_HEADER_SIZE, length))
+			ERROR_RETURN_LOG(int, "Cannot process the frame");
+
+		_buffer_consume(&conn->in, _FRAME_HEADER_SIZE + length);
+	}
+
+	if(conn->goaway_sent) _buffer_free(&conn->in);
+
+	return 0;
+}
+
+module_http2_stream_t* module_http2_conn_next_request(module_http2_conn_t* conn)
+{
+	if(NULL == conn) ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	while(NULL != conn->ready_head)
+	{
+		module_http2_stream_t* ret = conn->ready_head;
+		conn->ready_head = ret->ready_next;
+		if(NULL == conn->ready_head) conn->ready_tail = NULL;
+
+		if(ret->reset)
+		{
+			_stream_free(conn, ret);
+			continue;
+		}
+
+		ret->state = _STREAM_SERVING;
+		return ret;
+	}
+
+	return NULL;
+}
+
+size_t module_http2_conn_flush(module_http2_conn_t* conn, module_http2_conn_write_func_t func, void* ctx)
+{
+	if(NULL == conn || NULL == func) ERROR_RETURN_LOG(size_t, "Invalid arguments");
+
+	while(_buffer_size(&conn->out) > 0)
+	{
+		size_t rc = func(conn->out.data + conn->out.begin, _buffer_size(&conn->out), ctx);
+		if(ERROR_CODE(size_t) == rc) ERROR_RETURN_LOG(size_t, "Cannot write the queued frames");
+		if(rc == 0) break;
+		_buffer_consume(&conn->out, rc);
+	}
+
+	return _buffer_size(&conn->out);
+}
+
+int module_http2_conn_has_request(const module_http2_conn_t* conn)
+{
+	if(NULL == conn) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	return NULL != conn->ready_head;
+}
+
+int module_http2_conn_closing(const module_http2_conn_t* conn)
+{
+	if(NULL == conn) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	return conn->goaway_sent || conn->goaway_received;
+}
+
+uint32_t module_http2_stream_id(const module_http2_stream_t* stream)
+{
+	if(NULL == stream) ERROR_RETURN_LOG(uint32_t, "Invalid arguments");
+
+	return stream->id;
+}
+
+size_t module_http2_stream_read(module_http2_stream_t* stream, void* buf, size_t size)
+{
+	if(NULL == stream || NULL == buf) ERROR_RETURN_LOG(size_t, "Invalid arguments");
+
+	size_t avail = _buffer_size(&stream->request);
+	if(size > avail) size = avail;
+
+	stream->last_read = stream->request.begin;
+	memcpy(buf, stream->request.data + stream->request.begin, size);
+	stream->request.begin += size;
+
+	return size;
+}
+
+int module_http2_stream_eom(module_http2_stream_t* stream, size_t offset)
+{
+	if(NULL == stream) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if(stream->last_read + offset > stream->request.begin) ERROR_RETURN_LOG(int, "Invalid offset");
+
+	stream->request.begin = stream->last_read + offset;
+
+	return 0;
+}
+
+int module_http2_stream_eof(const module_http2_stream_t* stream)
+{
+	if(NULL == stream) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	return _buffer_size(&stream->request) == 0;
+}
+
+/**
+ * @brief queue the response header block as HEADERS and CONTINUATION frames
+ * @param conn the connection
+ * @param stream the stream
+ * @param end_stream if this is the end of the stream
+ * @return status code
+ **/
+static inline int _send_header_block(module_http2_conn_t* conn, module_http2_stream_t* stream, int end_stream)
+{
+	const uint8_t* block = stream->header_block.data + stream->header_block.begin;
+	size_t remaining = _buffer_size(&stream->header_block);
+	uint8_t type = _FRAME_HEADERS;
+	uint8_t flags = end_stream ? _FLAG_END_STREAM : 0;
+
+	do {
+		size_t size = remaining > conn->peer_frame_size ? conn->peer_frame_size : remaining;
+		if(size == remaining) flags |= _FLAG_END_HEADERS;
+
+		if(ERROR_CODE(int) == _emit(conn, type, flags, stream->id, block, size))
+			ERROR_RETURN_LOG(int, "Cannot queue the header block");
+
+		block += size;
+		remaining -= size;
+		type = _FRAME_CONTINUATION;
+		flags = 0;
+	} while(remaining > 0);
+
+	_buffer_free(&stream->header_block);
+
+	if(end_stream) stream->local_closed = 1;
+
+	return 0;
+}
+
+/**
+ * @brief get the number of body bytes the stream can take before the write is blocked
+ * @param conn the connection
+ * @param stream the stream
+ * @return the number of bytes
+ **/
+static inline size_t _stream_pending_room(const module_http2_conn_t* conn, const module_http2_stream_t* stream)
+{
+	/* The frame size is the lower bound, thus a stream is able to make progress even if the peer advertises a zero window */
+	size_t window = conn->peer_window_size > conn->peer_frame_size ? conn->peer_window_size : conn->peer_frame_size;
+	size_t stream_room = _STREAM_PENDING_FACTOR * window;
+	size_t conn_room = _CONN_PENDING_FACTOR * window;
+
+	stream_room = stream_room > _buffer_size(&stream->pending) ? stream_room - _buffer_size(&stream->pending) : 0;
+	conn_room = conn_room > conn->pending_size ? conn_room - conn->pending_size : 0;
+
+	return stream_room < conn_room ? stream_room : conn_room;
+}
+
+/**
+ * @brief send the response body
+ * @details the bytes beyond the pending limit are not taken, the caller should retry once the peer opens the window
+ * @param conn the connection
+ * @param stream the stream
+ * @param data the body bytes
+ * @param size the number of bytes
+ * @return the number of bytes taken or error code
+ **/
+static inline size_t _send_body(module_http2_conn_t* conn, module_http2_stream_t* stream, const char* data, size_t size)
+{
+	size_t room = _stream_pending_room(conn, stream);
+	if(size > room) size = room;
+
+	if(size == 0) return 0;
+
+	if(_buffer_size(&stream->header_block) > 0 && ERROR_CODE(int) == _send_header_block(conn, stream, 0))
+		ERROR_RETURN_LOG(size_t, "Cannot send the response header block");
+
+	if(ERROR_CODE(int) == _buffer_append(&stream->pending, data, size))
+		ERROR_RETURN_LOG(size_t, "Cannot append the response body");
+
+	conn->pending_size += size;
+
+	if(ERROR_CODE(int) == _stream_flush(conn, stream))
+		ERROR_RETURN_LOG(size_t, "Cannot flush the stream");
+
+	return size;
+}
+
+/**
+ * @brief encode a response header field to the header block
+ * @param stream the stream
+ * @param name the field name, which should be lower case
+ * @param name_len the length of the name
+ * @param value the field value
+ * @param value_len the length of the value
+ * @return status code
+ **/
+static inline int _encode_field(module_http2_stream_t* stream, const char* name, size_t name_len, const char* value, size_t value_len)
+{
+	size_t size = MODULE_HTTP2_HPACK_ENCODE_SIZE(name_len, value_len);
+	uint8_t* ptr = _buffer_reserve(&stream->header_block, size);
+	if(NULL == ptr) ERROR_RETURN_LOG(int, "Cannot reserve the header block buffer");
+
+	size_t rc = module_http2_hpack_encode(name, name_len, value, value_len, ptr, size);
+	if(ERROR_CODE(size_t) == rc) ERROR_RETURN_LOG(int, "Cannot encode the header field");
+
+	stream->header_block.size += rc;
+	return 0;
+}
+
+/**
+ * @brief parse the HTTP/1.1 response head and encode it as a header block
+ * @param stream the stream
+ * @param head the response head, without the terminating empty line
+ * @param size the size of the head
+ * @param chunked the buffer used to return if the body uses the chunked encoding
+ * @return the status code of the response or error code
+ **/
+static inline int _encode_response_head(module_http2_stream_t* stream, const char* head, size_t size, int* chunked)
+{
+	const char* end = head + size;
+	const char* ptr = head;
+	char name[128];
+
+	/* The status line: HTTP/1.x <status> <reason> */
+	if(size < 12 || memcmp(head, "HTTP/1.", 7) != 0 || head[8] != ' ')
+		ERROR_RETURN_LOG(int, "Invalid response status line");
+
+	int status = 0, i;
+	for(i = 9; i < 12; i ++)
+	{
+		if(head[i] < '0' || head[i] > '9') ERROR_RETURN_LOG(int, "Invalid response status code");
+		status = status * 10 + head[i] - '0';
+	}
+
+	if(ERROR_CODE(int) == _encode_field(stream, ":status", 7, head + 9, 3))
+		ERROR_RETURN_LOG(int, "Cannot encode the status");
+
+	*chunked = 0;
+
+	for(; ptr < end && *ptr != '\n'; ptr ++);
+
+	while(ptr < end)
+	{
+		const char* line = ++ptr;
+		for(; ptr < end && *ptr != '\n'; ptr ++);
+		const char* line_end = ptr;
+		if(line_end > line && line_end[-1] == '\r') line_end --;
+
+		const char* colon;
+		for(colon = line; colon < line_end && *colon != ':'; colon ++);
+		if(colon == line_end || colon == line) continue;
+
+		size_t name_len = (size_t)(colon - line);
+		if(name_len >= sizeof(name)) ERROR_RETURN_LOG(int, "The response field name is too long");
+
+		size_t j;
+		for(j = 0; j < name_len; j ++)
+			name[j] = (line[j] >= 'A' && line[j] <= 'Z') ? (char)(line[j] | 0x20) : line[j];
+		name[name_len] = 0;
+
+		const char* value = colon + 1;
+		const char* value_end = line_end;
+		for(; value < value_end && (*value == ' ' || *value == '\t'); value ++);
+		for(; value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t'); value_end --);
+		size_t value_len = (size_t)(value_end - value);
+
+		if(strcmp(name, "transfer-encoding") == 0)
+		{
+			for(j = 0; j + 7 <= value_len; j ++)
+				if(strncasecmp(value + j, "chunked", 7) == 0)
+					*chunked = 1;
+			continue;
+		}
+
+		if(strcmp(name, "connection") == 0 || strcmp(name, "keep-alive") == 0 ||
+		   strcmp(name, "proxy-connection") == 0 || strcmp(name, "upgrade") == 0)
+			continue;
+
+		if(ERROR_CODE(int) == _encode_field(stream, name, name_len, value, value_len))
+			ERROR_RETURN_LOG(int, "Cannot encode the response field");
+	}
+
+	return status;
+}
+
+/**
+ * @brief feed the response body bytes to the body parser
+ * @param conn the connection
+ * @param stream the stream
+ * @param data the bytes
+ * @param size the number of bytes
+ * @return the number of bytes consumed or error code
+ **/
+static inline size_t _response_body(module_http2_conn_t* conn, module_http2_stream_t* stream, const char* data, size_t size)
+{
+	const char* begin = data;
+	const char* end = data + size;
+
+	if(stream->resp_state == _RESP_BODY)
+		return _send_body(conn, stream, data, size);
+
+	while(data < end && stream->resp_state != _RESP_DONE)
+	{
+		char ch = *data;
+		switch(stream->resp_state)
+		{
+			case _RESP_CHUNK_SIZE:
+			case _RESP_CHUNK_EXT:
+				data ++;
+				if(ch == '\n')
+				{
+					if(stream->chunk_remaining == 0)
+					{
+						stream->resp_state = _RESP_TRAILER;
+						stream->trailer_line = 0;
+					}
+					else stream->resp_state = _RESP_CHUNK_DATA;
+				}
+				else if(stream->resp_state == _RESP_CHUNK_SIZE)
+				{
+					uint32_t digit;
+					if(ch >= '0' && ch <= '9') digit = (uint32_t)(ch - '0');
+					else if(ch >= 'a' && ch <= 'f') digit = (uint32_t)(ch - 'a' + 10);
+					else if(ch >= 'A' && ch <= 'F') digit = (uint32_t)(ch - 'A' + 10);
+					else
+					{
+						if(ch == ';') stream->resp_state = _RESP_CHUNK_EXT;
+						break;
+					}
+					if(stream->chunk_remaining >> 59) ERROR_RETURN_LOG(size_t, "The chunk size is too large");
+					stream->chunk_remaining = (stream->chunk_remaining << 4) | digit;
+				}
+				break;
+			case _RESP_CHUNK_DATA:
+			{
+				size_t bytes = (size_t)(end - data);
+				if(bytes > stream->chunk_remaining) bytes = (size_t)stream->chunk_remaining;
+				size_t taken = _send_body(conn, stream, data, bytes);
+				if(ERROR_CODE(size_t) == taken)
+					ERROR_RETURN_LOG(size_t, "Cannot send the chunk data");
+				data += taken;
+				stream->chunk_remaining -= taken;
+				if(stream->chunk_remaining == 0) stream->resp_state = _RESP_CHUNK_END;
+				/* The stream is blocked by the flow control, the rest should be written later */
+				if(taken < bytes) return (size_t)(data - begin);
+				break;
+			}
+			case _RESP_CHUNK_END:
+				data ++;
+				if(ch == '\n') stream->resp_state = _RESP_CHUNK_SIZE;
+				break;
+			case _RESP_TRAILER:
+				data ++;
+				if(ch == '\n')
+				{
+					if(stream->trailer_line == 0) stream->resp_state = _RESP_DONE;
+					stream->trailer_line = 0;
+				}
+				else if(ch != '\r') stream->trailer_line ++;
+				break;
+			default:
+				ERROR_RETURN_LOG(size_t, "Invalid response parser state");
+		}
+	}
+
+	return size;
+}
+
+size_t module_http2_stream_write(module_http2_conn_t* conn, module_http2_stream_t* stream, const void* data, size_t size)
+{
+	if(NULL == conn || NULL == stream || (NULL == data && size > 0)) ERROR_RETURN_LOG(size_t, "Invalid arguments");
+
+	/* The peer doesn't want the response anymore */
+	if(stream->reset || stream->local_closed) return size;
+
+	const char* bytes = (const char*)data;
+	size_t remaining = size;
+
+	while(remaining > 0 && stream->resp_state == _RESP_HEAD)
+	{
+		size_t scan_begin = _buffer_size(&stream->resp_head);
+		scan_begin = scan_begin > 3 ? scan_begin - 3 : 0;
+
+		if(_buffer_size(&stream->resp_head) + remaining > conn->conf.max_request_size)
+			ERROR_RETURN_LOG(size_t, "The response head is too large");
+
+		if(ERROR_CODE(int) == _buffer_append(&stream->resp_head, bytes, remaining))
+			ERROR_RETURN_LOG(size_t, "Cannot append the response head");
+
+		const char* head = (const char*)stream->resp_head.data + stream->resp_head.begin;
+		size_t head_size = _buffer_size(&stream->resp_head);
+		size_t i;
+		for(i = scan_begin; i + 3 < head_size && memcmp(head + i, "\r\n\r\n", 4) != 0; i ++);
+
+		if(i + 3 >= head_size) return size;
+
+		int chunked;
+		int status = _encode_response_head(stream, head, i, &chunked);
+		if(ERROR_CODE(int) == status) ERROR_RETURN_LOG(size_t, "Cannot translate the response head");
+
+		/* The bytes after the head belong to the body, or the final response after an interim response */
+		size_t used = head_size - remaining;
+		used = i + 4 > used ? i + 4 - used : 0;
+		bytes += used;
+		remaining -= used;
+		_buffer_free(&stream->resp_head);
+
+		if(status >= 100 && status < 200)
+		{
+			if(ERROR_CODE(int) == _send_header_block(conn, stream, 0))
+				ERROR_RETURN_LOG(size_t, "Cannot send the interim response");
+			continue;
+		}
+
+		stream->resp_state = chunked ? _RESP_CHUNK_SIZE : _RESP_BODY;
+	}
+
+	if(remaining > 0 && stream->resp_state != _RESP_HEAD)
+	{
+		size_t rc = _response_body(conn, stream, bytes, remaining);
+		if(ERROR_CODE(size_t) == rc) ERROR_RETURN_LOG(size_t, "Cannot translate the response body");
+		remaining -= rc;
+	}
+
+	return size - remaining;
+}
+
+int module_http2_stream_done(module_http2_conn_t* conn, module_http2_stream_t* stream, int error)
+{
+	if(NULL == conn || NULL == stream || stream->state != _STREAM_SERVING) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	stream->state = _STREAM_DONE;
+
+	if(stream->reset || stream->local_closed)
+	{
+		_stream_free(conn, stream);
+		return 0;
+	}
+
+	/* We can not end the stream gracefully if the response is incomplete */
+	if(error || stream->resp_state == _RESP_HEAD)
+		return _stream_error(conn, stream->id, _ERR_INTERNAL_ERROR);
+
+	if(_buffer_size(&stream->header_block) > 0)
+	{
+		if(ERROR_CODE(int) == _send_header_block(conn, stream, 1))
+			ERROR_RETURN_LOG(int, "Cannot send the response header block");
+		_stream_free(conn, stream);
+		return 0;
+	}
+
+	stream->end_pending = 1;
+
+	return _stream_flush(conn, stream);
+}
@@ -0,0 +1,578 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <error.h>
+
+#include <utils/log.h>
+
+#include <module/http2/hpack.h>
+
+/**
+ * @brief the static table entry
+ **/
+typedef struct {
+	const char* name;   /*!< the field name */
+	const char* value;  /*!< the field value */
+} _static_entry_t;
+
+/**
+ * @brief the static table defined by RFC 7541 Appendix A, the index of the first entry is 1
+ **/
+static const _static_entry_t _static_table[] = {
+	{":authority", ""},
+	{":method", "GET"},
+	{":method", "POST"},
+	{":path", "/"},
+	{":path", "/index.html"},
+	{":scheme", "http"},
+	{":scheme", "https"},
+	{":status", "200"},
+	{":status", "204"},
+	{":status", "206"},
+	{":status", "304"},
+	{":status", "400"},
+	{":status", "404"},
+	{":status", "500"},
+	{"accept-charset", ""},
+	{"accept-encoding", "gzip, deflate"},
+	{"accept-language", ""},
+	{"accept-ranges", ""},
+	{"accept", ""},
+	{"access-control-allow-origin", ""},
+	{"age", ""},
+	{"allow", ""},
+	{"authorization", ""},
+	{"cache-control", ""},
+	{"content-disposition", ""},
+	{"content-encoding", ""},
+	{"content-language", ""},
+	{"content-length", ""},
+	{"content-location", ""},
+	{"content-range", ""},
+	{"content-type", ""},
+	{"cookie", ""},
+	{"date", ""},
+	{"etag", ""},
+	{"expect", ""},
+	{"expires", ""},
+	{"from", ""},
+	{"host", ""},
+	{"if-match", ""},
+	{"if-modified-since", ""},
+	{"if-none-match", ""},
+	{"if-range", ""},
+	{"if-unmodified-since", ""},
+	{"last-modified", ""},
+	{"link", ""},
+	{"location", ""},
+	{"max-forwards", ""},
+	{"proxy-authenticate", ""},
+	{"proxy-authorization", ""},
+	{"range", ""},
+	{"referer", ""},
+	{"refresh", ""},
+	{"retry-after", ""},
+	{"server", ""},
+	{"set-cookie", ""},
+	{"strict-transport-security", ""},
+	{"transfer-encoding", ""},
+	{"user-agent", ""},
+	{"vary", ""},
+	{"via", ""},
+	{"www-authenticate", ""},
+};
+
+/**
+ * @brief the number of entries in the static table
+ **/
+#define _STATIC_TABLE_SIZE (sizeof(_static_table) / sizeof(_static_table[0]))
+
+/**
+ * @brief the Huffman code defined by RFC 7541 Appendix B
+ * @details the code is canonical, thus we only need the number of codes for each code length and the
+ *          symbols sorted by the code. _huffman_count[n] is the number of the codes which have n bits,
+ *          and the symbol 256 is the EOS symbol
+ **/
+static const uint16_t _huffman_count[31] = {
+	0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3, 0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4
+};
+static const uint16_t _huffman_symbol[257] = {
+	 48,  49,  50,  97,  99, 101, 105, 111, 115, 116,  32,  37,  45,  46,  47,  51,
+	 52,  53,  54,  55,  56,  57,  61,  65,  95,  98, 100, 102, 103, 104, 108, 109,
+	110, 112, 114, 117,  58,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,
+	 77,  78,  79,  80,  81,  82,  83,  84,  85,  86,  87,  89, 106, 107, 113, 118,
+	119, 120, 121, 122,  38,  42,  44,  59,  88,  90,  33,  34,  40,  41,  63,  39,
+	 43, 124,  35,  62,   0,  36,  64,  91,  93, 126,  94, 125,  60,  96, 123,  92,
+	195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177,
+	179, 209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156, 160,
+	163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+	233,   1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155, 157,
+	158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231, 239,   9, 142,
+	144, 145, 148, 159, 171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+	200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243, 255, 203, 204, 211,
+	212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254,
+	  2,   3,   4,   5,   6,   7,   8,  11,  12,  14,  15,  16,  17,  18,  19,  20,
+	 21,  23,  24,  25,  26,  27,  28,  29,  30,  31, 127, 220, 249,  10,  13,  22,
+	256
+};
+
+/**
+ * @brief the overhead of a dynamic table entry defined by the RFC
+ **/
+#define _ENTRY_OVERHEAD 32
+
+/**
+ * @brief a dynamic table entry
+ **/
+typedef struct {
+	uint32_t name_len;    /*!< the length of the name */
+	uint32_t value_len;   /*!< the length of the value */
+	char     data[0];     /*!< the name followed by the value */
+} _entry_t;
+
+/**
+ * @brief the decoder
+ **/
+struct _module_http2_hpack_decoder_t {
+	uint32_t   max_size;    /*!< the size limit we advertised with SETTINGS_HEADER_TABLE_SIZE */
+	uint32_t   limit;       /*!< the current size limit, which is changed by the dynamic table size update */
+	uint32_t   size;        /*!< the current size of the dynamic table */
+	uint32_t   capacity;    /*!< the capacity of the entry ring */
+	uint32_t   begin;       /*!< the index of the newest entry in the ring */
+	uint32_t   count;       /*!< the number of entries in the dynamic table */
+	_entry_t** entries;     /*!< the entry ring */
+	char*      name_buf;    /*!< the buffer used to decode the literal name */
+	size_t     name_cap;    /*!< the capacity of the name buffer */
+	char*      value_buf;   /*!< the buffer used to decode the literal value */
+	size_t     value_cap;   /*!< the capacity of the value buffer */
+};
+
+module_http2_hpack_decoder_t* module_http2_hpack_decoder_new(uint32_t max_table_size)
+{
+	module_http2_hpack_decoder_t* ret = (module_http2_hpack_decoder_t*)calloc(1, sizeof(*ret));
+
+	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the HPACK decoder");
+
+	ret->max_size = ret->limit = max_table_size;
+
+	return ret;
+}
+
+int module_http2_hpack_decoder_free(module_http2_hpack_decoder_t* decoder)
+{
+	if(NULL == decoder) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	uint32_t i;
+	for(i = 0; i < decoder->count; i ++)
+		free(decoder->entries[(decoder->begin + i) % decoder->capacity]);
+
+	if(NULL != decoder->entries) free(decoder->entries);
+	if(NULL != decoder->name_buf) free(decoder->name_buf);
+	if(NULL != decoder->value_buf) free(decoder->value_buf);
+	free(decoder);
+
+	return 0;
+}
+
+/**
+ * @brief evict the oldest entries until the table size is no larger than the given limit
+ * @param decoder the decoder
+ * @param limit the size limit
+ * @return nothing
+ **/
+static inline void _evict(module_http2_hpack_decoder_t* decoder, uint32_t limit)
+{
+	while(decoder->count > 0 && decoder->size > limit)
+	{
+		uint32_t idx = (decoder->begin + decoder->count - 1) % decoder->capacity;
+		_entry_t* entry = decoder->entries[idx];
+		decoder->size -= entry->name_len + entry->value_len + _ENTRY_OVERHEAD;
+		decoder->count --;
+		free(entry);
+	}
+}
+
+/**
+ * @brief insert a new entry to the dynamic table
+ * @param decoder the decoder
+ * @param name the field name, which should not point to an entry of the dynamic table
+ * @param name_len the length of the name
+ * @param value the field value
+ * @param value_len the length of the value
+ * @return status code
+ **/
+static inline int _insert(module_http2_hpack_decoder_t* decoder, const char* name, size_t name_len, const char* value, size_t value_len)
+{
+	size_t entry_size = name_len + value_len + _ENTRY_OVERHEAD;
+
+	/* An entry larger than the table is not an error, it just empties the table */
+	if(entry_size > decoder->limit)
+	{
+		_evict(decoder, 0);
+		return 0;
+	}
+
+	_evict(decoder, decoder->limit - (uint32_t)entry_size);
+
+	_entry_t* entry = (_entry_t*)malloc(sizeof(_entry_t) + name_len + value_len);
+	if(NULL == entry) ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the dynamic table entry");
+
+	entry->name_len = (uint32_t)name_len;
+	entry->value_len = (uint32_t)value_len;
+	memcpy(entry->data, name, name_len);
+	memcpy(entry->data + name_len, value, value_len);
+
+	if(decoder->count == decoder->capacity)
+	{
+		uint32_t new_cap = decoder->capacity == 0 ? 32 : decoder->capacity * 2;
+		_entry_t** new_entries = (_entry_t**)malloc(sizeof(_entry_t*) * new_cap);
+		if(NULL == new_entries)
+		{
+			free(entry);
+			ERROR_RETURN_LOG_ERRNO(int, "Cannot resize the dynamic table");
+		}
+
+		uint32_t i;
+		for(i = 0; i < decoder->count; i ++)
+			new_entries[i] = decoder->entries[(decoder->begin + i) % decoder->capacity];
+
+		if(NULL != decoder->entries) free(decoder->entries);
+		decoder->entries = new_entries;
+		decoder->capacity = new_cap;
+		decoder->begin = 0;
+	}
+
+	decoder->begin = (decoder->begin + decoder->capacity - 1) % decoder->capacity;
+	decoder->entries[decoder->begin] = entry;
+	decoder->count ++;
+	decoder->size += (uint32_t)entry_size;
+
+	return 0;
+}
+
+/**
+ * @brief look up the table with the HPACK index
+ * @param decoder the decoder
+ * @param index the HPACK index, 1 to 61 is the static table, and 62 is the newest dynamic table entry
+ * @param name the buffer used to return the name
+ * @param name_len the buffer used to return the length of the name
+ * @param value the buffer used to return the value
+ * @param value_len the buffer used to return the length of the value
+ * @return status code
+ **/
+static inline int _lookup(const module_http2_hpack_decoder_t* decoder, uint32_t index,
+                          const char** name, size_t* name_len, const char** value, size_t* value_len)
+{
+	if(index == 0) ERROR_RETURN_LOG(int, "Invalid HPACK index 0");
+
+	if(index <= _STATIC_TABLE_SIZE)
+	{
+		*name = _static_table[index - 1].name;
+		*name_len = strlen(*name);
+		*value = _static_table[index - 1].value;
+		*value_len = strlen(*value);
+		return 0;
+	}
+
+	index -= (uint32_t)_STATIC_TABLE_SIZE + 1;
+	if(index >= decoder->count) ERROR_RETURN_LOG(int, "HPACK index out of the dynamic table");
+
+	const _entry_t* entry = decoder->entries[(decoder->begin + index) % decoder->capacity];
+	*name = entry->data;
+	*name_len = entry->name_len;
+	*value = entry->data + entry->name_len;
+	*value_len = entry->value_len;
+
+	return 0;
+}
+
+/**
+ * @brief decode a prefixed integer
+ * @param begin the pointer to the current position, which will be advanced
+ * @param end the end of the buffer
+ * @param prefix the number of bits of the prefix
+ * @param result the buffer used to return the result
+ * @return status code
+ **/
+static inline int _decode_int(const uint8_t** begin, const uint8_t* end, uint32_t prefix, uint32_t* result)
+{
+	const uint8_t* ptr = *begin;
+	if(ptr >= end) ERROR_RETURN_LOG(int, "Truncated HPACK integer");
+
+	uint32_t mask = (1u << prefix) - 1;
+	uint64_t value = *(ptr++) & mask;
+
+	if(value == mask)
+	{
+		uint32_t shift = 0;
+		for(;;)
+		{
+			if(ptr >= end) ERROR_RETURN_LOG(int, "Truncated HPACK integer");
+			uint8_t byte = *(ptr++);
+			value += ((uint64_t)(byte & 0x7f)) << shift;
+			shift += 7;
+			if(value > UINT32_MAX) ERROR_RETURN_LOG(int, "HPACK integer overflow");
+			if(!(byte & 0x80)) break;
+			if(shift > 28) ERROR_RETURN_LOG(int, "HPACK integer overflow");
+		}
+	}
+
+	*begin = ptr;
+	*result = (uint32_t)value;
+	return 0;
+}
+
+/**
+ * @brief decode a Huffman encoded string
+ * @param data the encoded data
+ * @param size the size of the encoded data
+ * @param out the output buffer, which should be at least size * 8 / 5 bytes
+ * @return the length of the decoded string or error code
+ **/
+static inline size_t _huffman_decode(const uint8_t* data, size_t size, char* out)
+{
+	size_t ret = 0, i;
+	uint32_t code = 0, first = 0, index = 0, len = 0, padding = 1;
+
+	for(i = 0; i < size; i ++)
+	{
+		int bit;
+		for(bit = 7; bit >= 0; bit --)
+		{
+			uint32_t b = (data[i] >> bit) & 1;
+			code |= b;
+			padding &= b;
+			len ++;
+
+			uint32_t count = _huffman_count[len];
+			if(code - first < count)
+			{
+				uint32_t sym = _huffman_symbol[index + code - first];
+				if(sym == 256) ERROR_RETURN_LOG(size_t, "The Huffman encoded string contains the EOS symbol");
+				out[ret ++] = (char)sym;
+				code = first = index = len = 0;
+				padding = 1;
+				continue;
+			}
+
+			if(len >= 30) ERROR_RETURN_LOG(size_t, "Invalid Huffman code");
+
+			index += count;
+			first = (first + count) << 1;
+			code <<= 1;
+		}
+	}
+
+	/* The padding should be the most significant bits of the EOS symbol and strictly shorter than 8 bits */
+	if(len > 7 || !padding) ERROR_RETURN_LOG(size_t, "Invalid Huffman padding");
+
+	return ret;
+}
+
+/**
+ * @brief decode a string literal
+ * @param begin the pointer to the current position, which will be advanced
+ * @param end the end of the buffer
+ * @param buf the output buffer, which may be resized
+ * @param cap the capacity of the output buffer
+ * @param result_len the buffer used to return the length of the string
+ * @return status code
+ **/
+static inline int _decode_string(const uint8_t** begin, const uint8_t* end, char** buf, size_t* cap, size_t* result_len)
+{
+	if(*begin >= end) ERROR_RETURN_LOG(int, "Truncated HPACK string");
+
+	int huffman = (**begin & 0x80) != 0;
+	uint32_t len;
+
+	if(ERROR_CODE(int) == _decode_int(begin, end, 7, &len))
+		ERROR_RETURN_LOG(int, "Cannot decode the string length");
+
+	if((size_t)(end - *begin) < len) ERROR_RETURN_LOG(int, "Truncated HPACK string");
+
+	/* The shortest Huffman code is 5 bits */
+	size_t need = huffman ? (size_t)len * 8 / 5 + 1 : (size_t)len + 1;
+
+	if(need > *cap)
+	{
+		char* new_buf = (char*)realloc(*buf, need);
+		if(NULL == new_buf) ERROR_RETURN_LOG_ERRNO(int, "Cannot resize the string buffer");
+		*buf = new_buf;
+		*cap = need;
+	}
+
+	if(huffman)
+	{
+		size_t rc = _huffman_decode(*begin, len, *buf);
+		if(ERROR_CODE(size_t) == rc) ERROR_RETURN_LOG(int, "Cannot decode the Huffman string");
+		*result_len = rc;
+	}
+	else
+	{
+		memcpy(*buf, *begin, len);
+		*result_len = len;
+	}
+
+	*begin += len;
+	return 0;
+}
+
+int module_http2_hpack_decode(module_http2_hpack_decoder_t* decoder, const uint8_t* block, size_t size,
+                              module_http2_hpack_field_func_t func, void* data)
+{
+	if(NULL == decoder || (NULL == block && size > 0) || NULL == func)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	const uint8_t* ptr = block;
+	const uint8_t* end = block + size;
+	int field_seen = 0;
+
+	while(ptr < end)
+	{
+		const char *name, *value;
+		size_t name_len, value_len;
+		uint32_t index;
+		uint8_t byte = *ptr;
+
+		if(byte & 0x80)
+		{
+			/* Indexed header field */
+			if(ERROR_CODE(int) == _decode_int(&ptr, end, 7, &index))
+				ERROR_RETURN_LOG(int, "Cannot decode the field index");
+			if(ERROR_CODE(int) == _lookup(decoder, index, &name, &name_len, &value, &value_len))
+				ERROR_RETURN_LOG(int, "Cannot find the indexed field");
+		}
+		else if((byte & 0xe0) == 0x20)
+		{
+			/* Dynamic table size update, which is only allowed at the beginning of the block */
+			if(field_seen) ERROR_RETURN_LOG(int, "Unexpected dynamic table size update");
+			if(ERROR_CODE(int) == _decode_int(&ptr, end, 5, &index))
+				ERROR_RETURN_LOG(int, "Cannot decode the table size");
+			if(index > decoder->max_size)
+				ERROR_RETURN_LOG(int, "The table size %u exceeds the limit %u", index, decoder->max_size);
+			decoder->limit = index;
+			_evict(decoder, index);
+			continue;
+		}
+		else
+		{
+			/* Literal header field, with incremental indexing (01), without indexing (0000) or never indexed (0001) */
+			int indexing = (byte & 0xc0) == 0x40;
+
+			if(ERROR_CODE(int) == _decode_int(&ptr, end, indexing ? 6 : 4, &index))
+				ERROR_RETURN_LOG(int, "Cannot decode the name index");
+
+			if(index > 0)
+			{
+				const char* dummy;
+				size_t dummy_len;
+				if(ERROR_CODE(int) == _lookup(decoder, index, &name, &name_len, &dummy, &dummy_len))
+					ERROR_RETURN_LOG(int, "Cannot find the indexed name");
+
+				/* The insertion may evict the entry which owns the name, so we need our own copy */
+				if(indexing && index > _STATIC_TABLE_SIZE)
+				{
+					if(name_len + 1 > decoder->name_cap)
+					{
+						char* new_buf = (char*)realloc(decoder->name_buf, name_len + 1);
+						if(NULL == new_buf) ERROR_RETURN_LOG_ERRNO(int, "Cannot resize the name buffer");
+						decoder->name_buf = new_buf;
+						decoder->name_cap = name_len + 1;
+					}
+					memcpy(decoder->name_buf, name, name_len);
+					name = decoder->name_buf;
+				}
+			}
+			else
+			{
+				if(ERROR_CODE(int) == _decode_string(&ptr, end, &decoder->name_buf, &decoder->name_cap, &name_len))
+					ERROR_RETURN_LOG(int, "Cannot decode the field name");
+				name = decoder->name_buf;
+			}
+
+			if(ERROR_CODE(int) == _decode_string(&ptr, end, &decoder->value_buf, &decoder->value_cap, &value_len))
+				ERROR_RETURN_LOG(int, "Cannot decode the field value");
+			value = decoder->value_buf;
+
+			if(indexing && ERROR_CODE(int) == _insert(decoder, name, name_len, value, value_len))
+				ERROR_RETURN_LOG(int, "Cannot insert the field to the dynamic table");
+		}
+
+		field_seen = 1;
+
+		if(ERROR_CODE(int) == func(name, name_len, value, value_len, data))
+			ERROR_RETURN_LOG(int, "The field callback returns an error");
+	}
+
+	return 0;
+}
+
+/**
+ * @brief encode a prefixed integer
+ * @param buf the output buffer
+ * @param prefix the number of bits of the prefix
+ * @param flags the bits above the prefix in the first byte
+ * @param value the value to encode
+ * @return the number of bytes written, which is at most 6
+ **/
+static inline size_t _encode_int(uint8_t* buf, uint32_t prefix, uint8_t flags, uint32_t value)
+{
+	uint32_t mask = (1u << prefix) - 1;
+
+	if(value < mask)
+	{
+		buf[0] = (uint8_t)(flags | value);
+		return 1;
+	}
+
+	size_t ret = 1;
+	buf[0] = (uint8_t)(flags | mask);
+	value -= mask;
+
+	for(; value >= 0x80; value >>= 7)
+		buf[ret ++] = (uint8_t)((value & 0x7f) | 0x80);
+	buf[ret ++] = (uint8_t)value;
+
+	return ret;
+}
+
+size_t module_http2_hpack_encode(const char* name, size_t name_len, const char* value, size_t value_len, uint8_t* buf, size_t size)
+{
+	if(NULL == name || NULL == value || NULL == buf || name_len > UINT32_MAX || value_len > UINT32_MAX)
+		ERROR_RETURN_LOG(size_t, "Invalid arguments");
+
+	if(size < MODULE_HTTP2_HPACK_ENCODE_SIZE(name_len, value_len))
+		ERROR_RETURN_LOG(size_t, "The output buffer is too small");
+
+	uint32_t i, name_idx = 0;
+	for(i = 0; i < _STATIC_TABLE_SIZE; i ++)
+	{
+		const _static_entry_t* entry = _static_table + i;
+		if(strncmp(entry->name, name, name_len) != 0 || entry->name[name_len] != 0) continue;
+
+		if(name_idx == 0) name_idx = i + 1;
+
+		if(strncmp(entry->value, value, value_len) == 0 && entry->value[value_len] == 0)
+			return _encode_int(buf, 7, 0x80, i + 1);
+	}
+
+	size_t ret = _encode_int(buf, 4, 0, name_idx);
+
+	if(name_idx == 0)
+	{
+		ret += _encode_int(buf + ret, 7, 0, (uint32_t)name_len);
+		memcpy(buf + ret, name, name_len);
+		ret += name_len;
+	}
+
+	ret += _encode_int(buf + ret, 7, 0, (uint32_t)value_len);
+	memcpy(buf + ret, value, value_len);
+	ret += value_len;
+
+	return ret;
+}
@@ -0,0 +1,1448 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <constants.h>
+#include <error.h>
+#include <utils/log.h>
+#include <utils/thread.h>
+
+#include <itc/module_types.h>
+#include <itc/module.h>
+#include <itc/modtab.h>
+
+#include <module/http2/module.h>
+#include <module/http2/hpack.h>
+#include <module/http2/conn.h>
+#include <module/tcp/module.h>
+#include <module/tcp/api.h>
+
+#if MODULE_TLS_ENABLED
+#	include <module/tls/module.h>
+#	include <module/tls/api.h>
+#endif
+
+/**
+ * @brief the size of the buffer we use to read from the transportation layer
+ **/
+#define _READ_BUF_SIZE 4096
+
+/**
+ * @brief the maximum number of connections the reader thread hands back to the event thread in one round
+ **/
+#define _HANDBACK_BATCH 32
+
+/**
+ * @brief the type describes the direction of the handle
+ **/
+typedef enum {
+	_HANDLE_TYPE_IN,   /*!< a input handle */
+	_HANDLE_TYPE_OUT   /*!< a output handle */
+} _handle_type_t;
+
+/**
+ * @brief the protocol spoken on the connection
+ **/
+typedef enum {
+	_CONN_MODE_UNKNOWN,      /*!< we haven't received enough bytes to determine the protocol */
+	_CONN_MODE_H2,           /*!< the connection speaks HTTP/2 */
+	_CONN_MODE_PASSTHROUGH   /*!< the connection speaks something else, the bytes are passed to the servlet as-is */
+} _conn_mode_t;
+
+/**
+ * @brief the previous definition for the module context
+ **/
+typedef struct _module_context_t _module_context_t;
+
+/**
+ * @brief the connection state, which is pushed to the transportation layer between the events
+ **/
+typedef struct _conn_t {
+	_module_context_t*              module_context;    /*!< the module context */
+	pthread_mutex_t                 mutex;             /*!< the mutex serializes the access to the HTTP/2 connection */
+	pthread_cond_t                  cond;              /*!< notified when the connection may be able to take more response bytes */
+	_conn_mode_t                    mode;              /*!< the protocol spoken on the connection */
+	module_http2_conn_t*            h2;                /*!< the HTTP/2 connection, only valid in HTTP/2 mode */
+	itc_module_pipe_t*              t_in;              /*!< the transportation layer input pipe, only valid when the connection is being served */
+	itc_module_pipe_t*              t_out;             /*!< the transportation layer output pipe, only valid when the connection is being served */
+	uint32_t                        inflight;          /*!< the number of streams which is being served */
+	uint32_t                        error:1;           /*!< the connection has encountered an error and should be closed */
+	uint32_t                        pushed:1;          /*!< the state has been pushed, thus it's owned by the transportation layer */
+	uint32_t                        eof:1;             /*!< the peer has closed the connection */
+	uint32_t                        disposed:1;        /*!< the transportation layer has disposed the state while the streams are being served */
+	uint32_t                        held:1;            /*!< the connection is in the held list */
+	struct _conn_t*                 held_prev;         /*!< the previous connection in the held list */
+	struct _conn_t*                 held_next;         /*!< the next connection in the held list */
+	char*                           pending;           /*!< the bytes read while we are detecting the protocol */
+	uint32_t                        pending_size;      /*!< the size of the pending bytes */
+	uint32_t                        pending_start;     /*!< where the unread pending bytes begin */
+	void*                           user_state;        /*!< the user-space state, only used in passthrough mode */
+	itc_module_state_dispose_func_t dispose_user_state;/*!< the function used to dispose the user-space state */
+} _conn_t;
+
+/**
+ * @brief a HTTP/2 stream which has been returned as a pipe pair
+ **/
+typedef struct _stream_t {
+	_conn_t*                        conn;              /*!< the connection */
+	module_http2_stream_t*          stream;            /*!< the HTTP/2 stream */
+	uint32_t                        error:1;           /*!< if the stream has been served with error */
+	void*                           user_state;        /*!< the user-space state pushed to the stream */
+	itc_module_state_dispose_func_t dispose_user_state;/*!< the function used to dispose the user-space state */
+	struct _stream_t*               next;              /*!< the next stream in the ready queue */
+} _stream_t;
+
+/**
+ * @brief the pipe handle
+ **/
+typedef struct {
+	_handle_type_t                  type;              /*!< the handle type */
+	_conn_t*                        conn;              /*!< the connection */
+	_stream_t*                      stream;            /*!< the stream, NULL in passthrough mode */
+	itc_module_pipe_t*              t_pipe;            /*!< the transportation layer pipe, only used in passthrough mode */
+	uint32_t                        last_read_pending:1;/*!< if the last read is served from the pending bytes */
+	uint32_t                        last_read_start;   /*!< where the last read begins in the pending bytes */
+} _handle_t;
+
+/**
+ * @brief the module context
+ **/
+struct _module_context_t {
+	itc_module_type_t               transport_mod;     /*!< the transportation layer module type */
+	uint32_t                        alpn;              /*!< if the transportation layer is able to report the ALPN protocol */
+	uint32_t                        redeliver;         /*!< if the transportation layer is able to redeliver a connection */
+	uint32_t                        redeliver_opcode;  /*!< the opcode used to request the redelivery */
+	uint32_t                        killed;            /*!< if the event loop has been killed */
+	module_http2_conn_conf_t        conf;              /*!< the HTTP/2 connection configuration */
+	_stream_t*                      ready_head;        /*!< the streams which are ready but haven't been returned, only accessed by the event thread */
+	_stream_t*                      ready_tail;        /*!< the tail of the ready queue */
+	thread_t*                       reader;            /*!< the thread which reads the connections whose streams are being served */
+	pthread_mutex_t                 held_mutex;        /*!< the mutex protects the held list, it should be acquired after the connection mutex */
+	pthread_cond_t                  held_cond;         /*!< notified when the held list becomes non-empty or the reader thread is killed */
+	_conn_t*                        held_head;         /*!< the connections whose streams are being served, the transportation layer pipes are kept by us */
+	uint32_t                        reader_killed;     /*!< if the reader thread should exit */
+	uint64_t                        stat_connections;  /*!< the number of HTTP/2 connections */
+	uint64_t                        stat_streams;      /*!< the number of HTTP/2 streams served */
+	uint64_t                        stat_passthrough;  /*!< the number of connections passed through to the servlet */
+};
+
+/**
+ * @brief the client connection preface
+ **/
+static const char _preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+/**
+ * @brief the main function of the reader thread
+ * @param data the module context
+ * @return nothing
+ **/
+static void* _reader_main(void* data);
+
+/**
+ * @brief invoke the pipe cntl of the transportation layer
+ * @param pipe the pipe
+ * @param opcode the opcode
+ * @return status code
+ **/
+static inline int _invoke_pipe_cntl(itc_module_pipe_t* pipe, uint32_t opcode, ...)
+{
+	va_list ap;
+	va_start(ap, opcode);
+	int rc = itc_module_pipe_cntl(pipe, opcode, ap);
+	va_end(ap);
+	return rc;
+}
+
+/**
+ * @brief initialize the module
+ * @param ctx the module context
+ * @param argc the number of arguments
+ * @param argv the argument list
+ * @return status code
+ **/
+static int _init(void* __restrict ctx, uint32_t argc, char const* __restrict const* __restrict argv)
+{
+	if(NULL == ctx) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	_module_context_t* context = (_module_context_t*)ctx;
+
+	if(argc != 1) ERROR_RETURN_LOG(int, "Invalid module init args, should be http2_pipe <trans-module-path>");
+
+	if(ERROR_CODE(itc_module_type_t) == (context->transport_mod = itc_modtab_get_module_type_from_path(argv[0])))
+		ERROR_RETURN_LOG(int, "Cannot get the transportation layer module instance %s", argv[0]);
+
+	/* The transportation layer should be driven by us, thus it must not accept event by itself */
+	itc_module_flags_t mf = itc_module_get_flags(context->transport_mod);
+	if(ERROR_CODE(itc_module_flags_t) == mf) ERROR_RETURN_LOG(int, "Cannot get the module flags of the module instance %s", argv[0]);
+	if(0 != (mf & ITC_MODULE_FLAGS_EVENT_LOOP)) ERROR_RETURN_LOG(int, "Cannot use an event-accepting module as transprotation module, use the --slave mode instead");
+
+	const itc_modtab_instance_t* inst = itc_modtab_get_from_module_type(context->transport_mod);
+	if(NULL == inst) ERROR_RETURN_LOG(int, "Cannot get the transportation layer module instance");
+
+	context->alpn = 0;
+	context->redeliver = 0;
+	if(inst->module == &module_tcp_module_def)
+	{
+		context->redeliver = 1;
+		context->redeliver_opcode = (uint32_t)RUNTIME_API_PIPE_CNTL_MOD_OPCODE(context->transport_mod, MODULE_TCP_CNTL_REDELIVER_RAW);
+	}
+#if MODULE_TLS_ENABLED
+	if(inst->module == &module_tls_module_def)
+	{
+		context->alpn = 1;
+		context->redeliver = 1;
+		context->redeliver_opcode = (uint32_t)RUNTIME_API_PIPE_CNTL_MOD_OPCODE(context->transport_mod, MODULE_TLS_CNTL_REDELIVER_RAW);
+	}
+#endif
+	if(!context->redeliver)
+		LOG_WARNING("The transportation layer can not redeliver a connection, the requests arrived while other streams "
+		            "are being served on the same connection may not be served");
+
+	context->conf.max_concurrent_streams = MODULE_HTTP2_MAX_CONCURRENT_STREAMS;
+	context->conf.initial_window_size = MODULE_HTTP2_INITIAL_WINDOW_SIZE;
+	context->conf.max_frame_size = MODULE_HTTP2_MAX_FRAME_SIZE;
+	context->conf.header_table_size = MODULE_HTTP2_HEADER_TABLE_SIZE;
+	context->conf.max_request_size = MODULE_HTTP2_MAX_REQUEST_SIZE;
+
+	context->ready_head = context->ready_tail = NULL;
+	context->stat_connections = context->stat_streams = context->stat_passthrough = 0;
+	context->killed = 0;
+
+	context->held_head = NULL;
+	context->reader_killed = 0;
+
+	if((errno = pthread_mutex_init(&context->held_mutex, NULL)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot initialize the held list mutex");
+
+	if((errno = pthread_cond_init(&context->held_cond, NULL)) != 0)
+	{
+		pthread_mutex_destroy(&context->held_mutex);
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot initialize the held list condition variable");
+	}
+
+	if(NULL == (context->reader = thread_new(_reader_main, context, THREAD_TYPE_IO)))
+	{
+		pthread_cond_destroy(&context->held_cond);
+		pthread_mutex_destroy(&context->held_mutex);
+		ERROR_RETURN_LOG(int, "Cannot start the reader thread");
+	}
+
+	return 0;
+}
+
+/**
+ * @brief dispose the user-space state pushed to the connection
+ * @param conn the connection
+ * @return status code
+ **/
+static inline int _conn_user_state_dispose(_conn_t* conn)
+{
+	if(NULL == conn->user_state || NULL == conn->dispose_user_state) return 0;
+
+	int rc = conn->dispose_user_state(conn->user_state);
+	conn->user_state = NULL;
+	conn->dispose_user_state = NULL;
+
+	return rc;
+}
+
+/**
+ * @brief dispose the connection state
+ * @param state the connection state
+ * @return status code
+ **/
+static int _conn_free(void* state)
+{
+	_conn_t* conn = (_conn_t*)state;
+	int rc = 0;
+
+	if(NULL != conn->h2 && ERROR_CODE(int) == module_http2_conn_free(conn->h2))
+		rc = ERROR_CODE(int);
+
+	if(ERROR_CODE(int) == _conn_user_state_dispose(conn))
+		rc = ERROR_CODE(int);
+
+	if(NULL != conn->pending) free(conn->pending);
+
+	if((errno = pthread_mutex_destroy(&conn->mutex)) != 0)
+	{
+		LOG_WARNING_ERRNO("Cannot dispose the connection mutex");
+		rc = ERROR_CODE(int);
+	}
+
+	if((errno = pthread_cond_destroy(&conn->cond)) != 0)
+	{
+		LOG_WARNING_ERRNO("Cannot dispose the connection condition variable");
+		rc = ERROR_CODE(int);
+	}
+
+	free(conn);
+
+	return rc;
+}
+
+/**
+ * @brief the dispose callback used by the transportation layer
+ * @details the transportation layer may dispose the state while the streams are still being served, in this case
+ *          the connection is only marked as disposed, and the last stream disposes it
+ * @param state the connection state
+ * @return status code
+ **/
+static int _conn_dispose(void* state)
+{
+	_conn_t* conn = (_conn_t*)state;
+
+	pthread_mutex_lock(&conn->mutex);
+
+	if(conn->inflight > 0)
+	{
+		conn->disposed = 1;
+		conn->error = 1;
+		pthread_cond_broadcast(&conn->cond);
+		pthread_mutex_unlock(&conn->mutex);
+		return 0;
+	}
+
+	pthread_mutex_unlock(&conn->mutex);
+
+	return _conn_free(conn);
+}
+
+/**
+ * @brief cleanup the module
+ * @param ctx the module context
+ * @return status code
+ **/
+static int _cleanup(void* __restrict ctx)
+{
+	_module_context_t* context = (_module_context_t*)ctx;
+	int rc = 0;
+
+	pthread_mutex_lock(&context->held_mutex);
+	context->reader_killed = 1;
+	pthread_cond_signal(&context->held_cond);
+	pthread_mutex_unlock(&context->held_mutex);
+
+	if(ERROR_CODE(int) == thread_free(context->reader, NULL))
+	{
+		LOG_ERROR("Cannot join the reader thread");
+		rc = ERROR_CODE(int);
+	}
+
+	if((errno = pthread_cond_destroy(&context->held_cond)) != 0)
+	{
+		LOG_WARNING_ERRNO("Cannot dispose the held list condition variable");
+		rc = ERROR_CODE(int);
+	}
+
+	if((errno = pthread_mutex_destroy(&context->held_mutex)) != 0)
+	{
+		LOG_WARNING_ERRNO("Cannot dispose the held list mutex");
+		rc = ERROR_CODE(int);
+	}
+
+	/* The streams haven't been returned when the event loop gets killed */
+	while(NULL != context->ready_head)
+	{
+		_stream_t* stream = context->ready_head;
+		context->ready_head = stream->next;
+		free(stream);
+	}
+
+	return rc;
+}
+
+/**
+ * @brief create a new connection state
+ * @param context the module context
+ * @return the newly created connection state, NULL on error
+ **/
+static inline _conn_t* _conn_new(_module_context_t* context)
+{
+	_conn_t* ret = (_conn_t*)calloc(1, sizeof(*ret));
+	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the connection state");
+
+	if((errno = pthread_mutex_init(&ret->mutex, NULL)) != 0)
+	{
+		free(ret);
+		ERROR_PTR_RETURN_LOG_ERRNO("Cannot initialize the connection mutex");
+	}
+
+	if((errno = pthread_cond_init(&ret->cond, NULL)) != 0)
+	{
+		pthread_mutex_destroy(&ret->mutex);
+		free(ret);
+		ERROR_PTR_RETURN_LOG_ERRNO("Cannot initialize the connection condition variable");
+	}
+
+	ret->module_context = context;
+	ret->mode = _CONN_MODE_UNKNOWN;
+
+	return ret;
+}
+
+/**
+ * @brief the write function used to flush the HTTP/2 frames to the transportation layer
+ * @param data the data to write
+ * @param size the number of bytes
+ * @param ctx the transportation layer output pipe
+ * @return the number of bytes written or error code
+ **/
+static size_t _transport_write(const void* data, size_t size, void* ctx)
+{
+	size_t ret = 0;
+	while(ret < size)
+	{
+		size_t rc = itc_module_pipe_write((const char*)data + ret, size - ret, (itc_module_pipe_t*)ctx);
+		if(ERROR_CODE(size_t) == rc || 0 == rc)
+			ERROR_RETURN_LOG(size_t, "Cannot write to the transportation layer, disconnected?");
+		ret += rc;
+	}
+
+	return ret;
+}
+
+/**
+ * @brief flush the queued frames of the connection
+ * @note the caller should hold the connection mutex
+ * @param conn the connection
+ * @return status code
+ **/
+static inline int _conn_flush(_conn_t* conn)
+{
+	if(conn->error) return 0;
+
+	if(ERROR_CODE(size_t) == module_http2_conn_flush(conn->h2, _transport_write, conn->t_out))
+	{
+		conn->error = 1;
+		ERROR_RETURN_LOG(int, "Cannot flush the HTTP/2 frames");
+	}
+
+	return 0;
+}
+
+/**
+ * @brief detach the transportation layer pipes from the connection, the state is pushed to the transportation layer
+ *        if the connection is kept for the next event
+ * @note the caller should hold the connection mutex, and the pipes should be released by _transport_release
+ *       without the mutex, because the transportation layer may dispose the state when the pipes are deallocated
+ * @param conn the connection
+ * @param close if we need to close the connection
+ * @param t_in the buffer used to return the input pipe
+ * @param t_out the buffer used to return the output pipe
+ * @return if the connection should be closed
+ **/
+static inline int _conn_detach(_conn_t* conn, int close, itc_module_pipe_t** t_in, itc_module_pipe_t** t_out)
+{
+	*t_in = conn->t_in;
+	*t_out = conn->t_out;
+
+	conn->t_in = conn->t_out = NULL;
+
+	if(close || conn->error) return 1;
+
+	if(ERROR_CODE(int) == _invoke_pipe_cntl(*t_in, RUNTIME_API_PIPE_CNTL_OPCODE_PUSH_STATE, conn, _conn_dispose))
+	{
+		LOG_ERROR("Cannot push the connection state to the transportation layer");
+		return 1;
+	}
+
+	conn->pushed = 1;
+
+	return 0;
+}
+
+/**
+ * @brief give the detached transportation layer pipes back, the connection is either kept for the next event or closed
+ * @param t_in the input pipe
+ * @param t_out the output pipe
+ * @param close if we need to close the connection
+ * @return status code
+ **/
+static inline int _transport_release(itc_module_pipe_t* t_in, itc_module_pipe_t* t_out, int close)
+{
+	int rc = 0;
+
+	if(close)
+	{
+		if(ERROR_CODE(int) == _invoke_pipe_cntl(t_in, RUNTIME_API_PIPE_CNTL_OPCODE_CLR_FLAG, RUNTIME_API_PIPE_PERSIST) ||
+		   ERROR_CODE(int) == _invoke_pipe_cntl(t_out, RUNTIME_API_PIPE_CNTL_OPCODE_CLR_FLAG, RUNTIME_API_PIPE_PERSIST))
+		{
+			LOG_ERROR("Cannot clear the persist flag of the transportation layer pipe");
+			rc = ERROR_CODE(int);
+		}
+	}
+
+	if(ERROR_CODE(int) == itc_module_pipe_deallocate(t_in)) rc = ERROR_CODE(int);
+	if(ERROR_CODE(int) == itc_module_pipe_deallocate(t_out)) rc = ERROR_CODE(int);
+
+	return rc;
+}
+
+/**
+ * @brief give the transportation layer pipes back, the connection is either kept for the next event or closed
+ * @note this is only used when there's no stream being served, so nobody else is able to touch the connection
+ * @param conn the connection
+ * @param close if we need to close the connection
+ * @return status code
+ **/
+static inline int _conn_release(_conn_t* conn, int close)
+{
+	itc_module_pipe_t* t_in;
+	itc_module_pipe_t* t_out;
+
+	close = _conn_detach(conn, close, &t_in, &t_out);
+
+	/* The pushed state is disposed by the transportation layer once the connection is closed */
+	int dispose = close && !conn->pushed;
+
+	int rc = _transport_release(t_in, t_out, close);
+
+	if(dispose && ERROR_CODE(int) == _conn_free(conn))
+	{
+		LOG_ERROR("Cannot dispose the connection state");
+		rc = ERROR_CODE(int);
+	}
+
+	return rc;
+}
+
+/**
+ * @brief put the connection to the held list, so that the reader thread keeps reading it
+ * @note the caller should hold the connection mutex
+ * @param context the module context
+ * @param conn the connection
+ * @return nothing
+ **/
+static inline void _held_add(_module_context_t* context, _conn_t* conn)
+{
+	pthread_mutex_lock(&context->held_mutex);
+
+	conn->held_prev = NULL;
+	conn->held_next = context->held_head;
+	if(NULL != context->held_head) context->held_head->held_prev = conn;
+	context->held_head = conn;
+	conn->held = 1;
+
+	pthread_cond_signal(&context->held_cond);
+
+	pthread_mutex_unlock(&context->held_mutex);
+}
+
+/**
+ * @brief unlink the connection from the held list
+ * @note the caller should hold both the connection mutex and the held list mutex
+ * @param context the module context
+ * @param conn the connection
+ * @return nothing
+ **/
+static inline void _held_unlink(_module_context_t* context, _conn_t* conn)
+{
+	if(NULL != conn->held_prev) conn->held_prev->held_next = conn->held_next;
+	else context->held_head = conn->held_next;
+	if(NULL != conn->held_next) conn->held_next->held_prev = conn->held_prev;
+
+	conn->held_prev = conn->held_next = NULL;
+	conn->held = 0;
+}
+
+/**
+ * @brief remove the connection from the held list
+ * @note the caller should hold the connection mutex
+ * @param context the module context
+ * @param conn the connection
+ * @return nothing
+ **/
+static inline void _held_remove(_module_context_t* context, _conn_t* conn)
+{
+	if(!conn->held) return;
+
+	pthread_mutex_lock(&context->held_mutex);
+	_held_unlink(context, conn);
+	pthread_mutex_unlock(&context->held_mutex);
+}
+
+/**
+ * @brief ask the transportation layer to return the connection from the next accept once it's released,
+ *        so that the requests which have been received are collected by the event thread
+ * @note the caller should hold the connection mutex
+ * @param context the module context
+ * @param conn the connection
+ * @return 1 if the redelivery has been requested, 0 if there's no request or the transportation layer can not redeliver
+ **/
+static inline int _conn_redeliver(_module_context_t* context, _conn_t* conn)
+{
+	if(!context->redeliver || conn->error || module_http2_conn_has_request(conn->h2) <= 0) return 0;
+
+	if(ERROR_CODE(int) == _invoke_pipe_cntl(conn->t_in, context->redeliver_opcode))
+	{
+		LOG_WARNING("The transportation layer refused to redeliver the connection, disable the redelivery");
+		context->redeliver = 0;
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * @brief read everything available from the transportation layer and feed it to the HTTP/2 connection
+ * @param conn the connection
+ * @return the number of bytes read or error code
+ **/
+static inline size_t _conn_receive(_conn_t* conn)
+{
+	char buf[_READ_BUF_SIZE];
+	size_t ret = 0;
+
+	for(;;)
+	{
+		size_t rc = itc_module_pipe_read(buf, sizeof(buf), conn->t_in);
+		if(ERROR_CODE(size_t) == rc) ERROR_RETURN_LOG(size_t, "Cannot read from the transportation layer");
+		if(rc == 0) break;
+
+		if(ERROR_CODE(int) == module_http2_conn_feed(conn->h2, buf, rc))
+			ERROR_RETURN_LOG(size_t, "Cannot process the HTTP/2 frames");
+
+		ret += rc;
+	}
+
+	return ret;
+}
+
+/**
+ * @brief read the frames arrived while the streams are being served
+ * @note the caller should hold the connection mutex and the transportation layer pipes should be attached
+ * @param conn the connection
+ * @return if the state of the connection has been changed
+ **/
+static inline int _conn_pump(_conn_t* conn)
+{
+	if(conn->error || conn->eof) return 0;
+
+	if(conn->module_context->killed)
+	{
+		LOG_DEBUG("The event loop has been killed, stop serving the connection");
+		conn->error = 1;
+	}
+	else
+	{
+		size_t rc = _conn_receive(conn);
+		if(ERROR_CODE(size_t) == rc) conn->error = 1;
+		else if(rc > 0) _conn_flush(conn);
+		else if(itc_module_pipe_eof(conn->t_in) > 0) conn->eof = 1;
+		else return 0;
+	}
+
+	/* Either the window has been updated or the connection is gone, the blocked writers should check again */
+	pthread_cond_broadcast(&conn->cond);
+
+	return 1;
+}
+
+/**
+ * @brief read the bytes to determine the protocol of the connection
+ * @param context the module context
+ * @param conn the connection
+ * @return status code
+ **/
+static inline int _conn_detect(_module_context_t* context, _conn_t* conn)
+{
+	char buf[_READ_BUF_SIZE];
+
+	size_t rc = itc_module_pipe_read(buf, sizeof(buf), conn->t_in);
+	if(ERROR_CODE(size_t) == rc) ERROR_RETURN_LOG(int, "Cannot read from the transportation layer");
+
+	if(rc > 0)
+	{
+		char* new_pending = (char*)realloc(conn->pending, conn->pending_size + rc);
+		if(NULL == new_pending) ERROR_RETURN_LOG_ERRNO(int, "Cannot resize the pending buffer");
+		memcpy(new_pending + conn->pending_size, buf, rc);
+		conn->pending = new_pending;
+		conn->pending_size += (uint32_t)rc;
+	}
+
+	char proto[32] = {0};
+#if MODULE_TLS_ENABLED
+	if(context->alpn && ERROR_CODE(int) == _invoke_pipe_cntl(conn->t_in, (uint32_t)RUNTIME_API_PIPE_CNTL_MOD_OPCODE(context->transport_mod, MODULE_TLS_CNTL_ALPNPROTO_RAW), proto, sizeof(proto)))
+		ERROR_RETURN_LOG(int, "Cannot get the ALPN protocol from the transportation layer");
+#else
+	(void)context;
+#endif
+
+	if(strcmp(proto, "h2") == 0)
+		conn->mode = _CONN_MODE_H2;
+	else if(conn->pending_size > 0)
+	{
+		/* The cleartext connection starts with the client preface, A.K.A. the prior knowledge */
+		size_t cmp_size = conn->pending_size < sizeof(_preface) - 1 ? conn->pending_size : sizeof(_preface) - 1;
+		if(memcmp(conn->pending, _preface, cmp_size) != 0)
+			conn->mode = _CONN_MODE_PASSTHROUGH;
+		else if(cmp_size == sizeof(_preface) - 1)
+			conn->mode = _CONN_MODE_H2;
+	}
+
+	if(conn->mode == _CONN_MODE_H2)
+	{
+		if(NULL == (conn->h2 = module_http2_conn_new(&context->conf)))
+			ERROR_RETURN_LOG(int, "Cannot create the HTTP/2 connection");
+
+		if(conn->pending_size > 0 && ERROR_CODE(int) == module_http2_conn_feed(conn->h2, conn->pending, conn->pending_size))
+			ERROR_RETURN_LOG(int, "Cannot process the HTTP/2 frames");
+
+		free(conn->pending);
+		conn->pending = NULL;
+		conn->pending_size = 0;
+
+		__sync_fetch_and_add(&context->stat_connections, 1);
+	}
+	else if(conn->mode == _CONN_MODE_PASSTHROUGH)
+		__sync_fetch_and_add(&context->stat_passthrough, 1);
+
+	return 0;
+}
+
+/**
+ * @brief move all the ready streams of the connection to the ready queue
+ * @note the caller should hold the connection mutex
+ * @param context the module context
+ * @param conn the connection
+ * @return the number of streams moved or error code
+ **/
+static inline int _conn_collect_streams(_module_context_t* context, _conn_t* conn)
+{
+	int ret = 0;
+	module_http2_stream_t* h2_stream;
+
+	while(NULL != (h2_stream = module_http2_conn_next_request(conn->h2)))
+	{
+		_stream_t* stream = (_stream_t*)calloc(1, sizeof(*stream));
+		if(NULL == stream)
+		{
+			LOG_ERROR_ERRNO("Cannot allocate memory for the stream");
+			module_http2_stream_done(conn->h2, h2_stream, 1);
+			continue;
+		}
+
+		stream->conn = conn;
+		stream->stream = h2_stream;
+		if(NULL == context->ready_tail) context->ready_head = stream;
+		else context->ready_tail->next = stream;
+		context->ready_tail = stream;
+
+		conn->inflight ++;
+		ret ++;
+	}
+
+	return ret;
+}
+
+/**
+ * @brief process an event from the transportation layer
+ * @param context the module context
+ * @param conn the connection
+ * @return 1 if the connection should be returned as a passthrough pipe, 0 if the connection has been handled, or error code
+ **/
+static inline int _conn_process(_module_context_t* context, _conn_t* conn)
+{
+	if(conn->mode == _CONN_MODE_UNKNOWN && ERROR_CODE(int) == _conn_detect(context, conn))
+		ERROR_RETURN_LOG(int, "Cannot detect the protocol of the connection");
+
+	if(conn->mode == _CONN_MODE_PASSTHROUGH) return 1;
+
+	if(conn->mode == _CONN_MODE_UNKNOWN)
+		return _conn_release(conn, itc_module_pipe_eof(conn->t_in) > 0) == ERROR_CODE(int) ? ERROR_CODE(int) : 0;
+
+	pthread_mutex_lock(&conn->mutex);
+
+	if(ERROR_CODE(size_t) == _conn_receive(conn))
+		conn->error = 1;
+	else if(itc_module_pipe_eof(conn->t_in) > 0)
+		conn->eof = 1;
+
+	if(!conn->error)
+	{
+		_conn_collect_streams(context, conn);
+		_conn_flush(conn);
+	}
+
+	/* The writers blocked while the connection was detached are able to flush now */
+	pthread_cond_broadcast(&conn->cond);
+
+	/* The reader thread keeps reading the connection while the streams are being served,
+	 * and the connection is released once the last stream has been served */
+	if(conn->inflight > 0 && !conn->error)
+	{
+		_held_add(context, conn);
+		pthread_mutex_unlock(&conn->mutex);
+		return 0;
+	}
+
+	itc_module_pipe_t* t_in;
+	itc_module_pipe_t* t_out;
+
+	int closing = _conn_detach(conn, conn->error || conn->eof || module_http2_conn_closing(conn->h2), &t_in, &t_out);
+
+	/* If there are streams being served, the last of them disposes the connection */
+	int dispose = closing && !conn->pushed && conn->inflight == 0;
+
+	pthread_mutex_unlock(&conn->mutex);
+
+	if(ERROR_CODE(int) == _transport_release(t_in, t_out, closing))
+		LOG_ERROR("Cannot release the transportation layer");
+
+	if(dispose && ERROR_CODE(int) == _conn_free(conn))
+		ERROR_RETURN_LOG(int, "Cannot dispose the connection state");
+
+	return 0;
+}
+
+/**
+ * @brief the main function of the reader thread
+ * @details the reader thread keeps reading the connections whose streams are being served, so that the
+ *          WINDOW_UPDATE and RST_STREAM frames are processed while the streams are being served. Once a connection
+ *          has received a new request, it's handed back to the event thread with the redelivery request
+ * @param data the module context
+ * @return nothing
+ **/
+static void* _reader_main(void* data)
+{
+	_module_context_t* context = (_module_context_t*)data;
+	struct {
+		itc_module_pipe_t* t_in;     /*!< the input pipe */
+		itc_module_pipe_t* t_out;    /*!< the output pipe */
+		int                close;    /*!< if the connection should be closed */
+	} handback[_HANDBACK_BATCH];
+
+	pthread_mutex_lock(&context->held_mutex);
+
+	while(!context->reader_killed)
+	{
+		if(NULL == context->held_head)
+		{
+			pthread_cond_wait(&context->held_cond, &context->held_mutex);
+			continue;
+		}
+
+		uint32_t nhandback = 0, i;
+		_conn_t *conn, *next;
+		for(conn = context->held_head; NULL != conn; conn = next)
+		{
+			next = conn->held_next;
+
+			/* The connection mutex should be acquired first, so we skip the connection which is busy */
+			if(pthread_mutex_trylock(&conn->mutex) != 0) continue;
+
+			_conn_pump(conn);
+
+			if(nhandback < _HANDBACK_BATCH && _conn_redeliver(context, conn))
+			{
+				_held_unlink(context, conn);
+				if((handback[nhandback].close = _conn_detach(conn, 0, &handback[nhandback].t_in, &handback[nhandback].t_out)))
+				{
+					/* We are not able to keep the connection, thus the streams which are being served are going to fail */
+					conn->error = 1;
+					pthread_cond_broadcast(&conn->cond);
+				}
+				nhandback ++;
+			}
+
+			pthread_mutex_unlock(&conn->mutex);
+		}
+
+		pthread_mutex_unlock(&context->held_mutex);
+
+		/* Once the pipes are released, the connection is returned by the next accept of the event thread */
+		for(i = 0; i < nhandback; i ++)
+			if(ERROR_CODE(int) == _transport_release(handback[i].t_in, handback[i].t_out, handback[i].close))
+				LOG_ERROR("Cannot hand back the connection to the transportation layer");
+
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += (long)(MODULE_HTTP2_READER_INTERVAL % 1000) * 1000000l;
+		deadline.tv_sec += MODULE_HTTP2_READER_INTERVAL / 1000 + deadline.tv_nsec / 1000000000l;
+		deadline.tv_nsec %= 1000000000l;
+
+		pthread_mutex_lock(&context->held_mutex);
+
+		if(!context->reader_killed)
+			pthread_cond_timedwait(&context->held_cond, &context->held_mutex, &deadline);
+	}
+
+	pthread_mutex_unlock(&context->held_mutex);
+
+	return NULL;
+}
+
+/**
+ * @brief accept the next request
+ * @details the streams of a HTTP/2 connection are returned one by one, each of them as a separate pipe pair.
+ *          The connection which doesn't speak HTTP/2 is returned as-is
+ * @param ctx the module context
+ * @param args the accept arguments
+ * @param inbuf the input handle buffer
+ * @param outbuf the output handle buffer
+ * @return status code
+ **/
+static int _accept(void* __restrict ctx, const void* __restrict args, void* __restrict inbuf, void* __restrict outbuf)
+{
+	_module_context_t* context = (_module_context_t*)ctx;
+	_handle_t* in = (_handle_t*)inbuf;
+	_handle_t* out = (_handle_t*)outbuf;
+
+	memset(in, 0, sizeof(*in));
+	memset(out, 0, sizeof(*out));
+	in->type = _HANDLE_TYPE_IN;
+	out->type = _HANDLE_TYPE_OUT;
+
+	itc_module_pipe_param_t trans_param = {
+		.input_flags = itc_module_get_handle_flags(inbuf) | RUNTIME_API_PIPE_PERSIST,
+		.output_flags = itc_module_get_handle_flags(outbuf) | RUNTIME_API_PIPE_PERSIST | RUNTIME_API_PIPE_ASYNC,
+		.args = args
+	};
+
+	while(NULL == context->ready_head)
+	{
+		itc_module_pipe_t* t_in = NULL;
+		itc_module_pipe_t* t_out = NULL;
+		_conn_t* conn = NULL;
+
+		if(ERROR_CODE(int) == itc_module_pipe_accept(context->transport_mod, trans_param, &t_in, &t_out) || NULL == t_in || NULL == t_out)
+			ERROR_LOG_GOTO(L_ERR, "Cannot accept connection from transportation layer");
+
+		if(ERROR_CODE(int) == _invoke_pipe_cntl(t_in, RUNTIME_API_PIPE_CNTL_OPCODE_POP_STATE, &conn))
+			ERROR_LOG_GOTO(L_ERR, "Cannot pop the previous state from the pipe");
+
+		if(NULL == conn && NULL == (conn = _conn_new(context)))
+			ERROR_LOG_GOTO(L_ERR, "Cannot create the connection state");
+
+		/* The streams of the previous events may be still being served */
+		pthread_mutex_lock(&conn->mutex);
+		conn->t_in = t_in;
+		conn->t_out = t_out;
+		pthread_mutex_unlock(&conn->mutex);
+
+		int rc = _conn_process(context, conn);
+		if(ERROR_CODE(int) == rc)
+		{
+			LOG_ERROR("Cannot process the connection, closing");
+			conn->error = 1;
+			if(ERROR_CODE(int) == _conn_release(conn, 1))
+				LOG_ERROR("Cannot release the transportation layer");
+			continue;
+		}
+
+		if(rc == 1)
+		{
+			conn->t_in = conn->t_out = NULL;
+			in->conn = out->conn = conn;
+			in->t_pipe = t_in;
+			out->t_pipe = t_out;
+			return 0;
+		}
+
+		continue;
+L_ERR:
+		if(NULL != t_in) itc_module_pipe_deallocate(t_in);
+		if(NULL != t_out) itc_module_pipe_deallocate(t_out);
+		return ERROR_CODE(int);
+	}
+
+	_stream_t* stream = context->ready_head;
+	context->ready_head = stream->next;
+	if(NULL == context->ready_head) context->ready_tail = NULL;
+	stream->next = NULL;
+
+	in->conn = out->conn = stream->conn;
+	in->stream = out->stream = stream;
+
+	__sync_fetch_and_add(&context->stat_streams, 1);
+
+	return 0;
+}
+
+/**
+ * @brief finish a stream, the transportation layer is released once the last stream being served is done
+ * @param stream the stream
+ * @return status code
+ **/
+static inline int _stream_finish(_stream_t* stream)
+{
+	int rc = 0;
+	_conn_t* conn = stream->conn;
+	_module_context_t* context = conn->module_context;
+
+	if(NULL != stream->user_state && NULL != stream->dispose_user_state && ERROR_CODE(int) == stream->dispose_user_state(stream->user_state))
+	{
+		LOG_WARNING("Cannot dispose the user-space state of the stream");
+		rc = ERROR_CODE(int);
+	}
+
+	pthread_mutex_lock(&conn->mutex);
+
+	if(ERROR_CODE(int) == module_http2_stream_done(conn->h2, stream->stream, stream->error))
+	{
+		LOG_ERROR("Cannot finish the HTTP/2 stream");
+		conn->error = 1;
+		rc = ERROR_CODE(int);
+	}
+
+	if(NULL != conn->t_out && ERROR_CODE(int) == _conn_flush(conn))
+		rc = ERROR_CODE(int);
+
+	/* The bytes pending in this stream doesn't count towards the connection limit anymore */
+	pthread_cond_broadcast(&conn->cond);
+
+	itc_module_pipe_t* t_in = NULL;
+	itc_module_pipe_t* t_out = NULL;
+	int closing = 0, dispose = 0;
+
+	if(-- conn->inflight == 0)
+	{
+		if(NULL != conn->t_in)
+		{
+			_held_remove(context, conn);
+
+			closing = conn->error || conn->eof || module_http2_conn_closing(conn->h2);
+
+			/* The requests received after the last visit of the reader thread */
+			if(!closing && module_http2_conn_has_request(conn->h2) > 0 && !_conn_redeliver(context, conn))
+			{
+				LOG_ERROR("Cannot get the connection redelivered, the received requests are dropped");
+				closing = 1;
+			}
+
+			closing = _conn_detach(conn, closing, &t_in, &t_out);
+			dispose = closing && !conn->pushed;
+		}
+		/* Otherwise the connection has been handed back, and the event thread owns it, unless it's gone */
+		else dispose = conn->disposed || !conn->pushed;
+	}
+
+	pthread_mutex_unlock(&conn->mutex);
+
+	free(stream);
+
+	if(NULL != t_in && ERROR_CODE(int) == _transport_release(t_in, t_out, closing))
+	{
+		LOG_ERROR("Cannot release the transportation layer");
+		rc = ERROR_CODE(int);
+	}
+
+	if(dispose && ERROR_CODE(int) == _conn_free(conn))
+	{
+		LOG_ERROR("Cannot dispose the connection state");
+		rc = ERROR_CODE(int);
+	}
+
+	return rc;
+}
+
+/**
+ * @brief deallocate a pipe handle
+ * @param ctx the module context
+ * @param pipe the pipe handle
+ * @param error if this pipe encoutered an unrecoverable error
+ * @param purge if this is the last handle of the pipe pair
+ * @return status code
+ **/
+static int _dealloc(void* __restrict ctx, void* __restrict pipe, int error, int purge)
+{
+	if(NULL == ctx || NULL == pipe) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	_handle_t* handle = (_handle_t*)pipe;
+
+	if(NULL != handle->stream)
+	{
+		if(error) handle->stream->error = 1;
+		return purge ? _stream_finish(handle->stream) : 0;
+	}
+
+	/* The passthrough connection follows the persist flag of the handle, just like the TLS module does */
+	if(purge)
+	{
+		runtime_api_pipe_flags_t flags = itc_module_get_handle_flags(pipe);
+		if((flags & RUNTIME_API_PIPE_PERSIST) && !error)
+		{
+			if(ERROR_CODE(int) == _invoke_pipe_cntl(handle->t_pipe, RUNTIME_API_PIPE_CNTL_OPCODE_PUSH_STATE, handle->conn, _conn_dispose))
+				ERROR_RETURN_LOG(int, "Cannot push the connection state to the transportation layer pipe");
+			handle->conn->pushed = 1;
+		}
+		else
+		{
+			if(ERROR_CODE(int) == _invoke_pipe_cntl(handle->t_pipe, RUNTIME_API_PIPE_CNTL_OPCODE_CLR_FLAG, RUNTIME_API_PIPE_PERSIST))
+				ERROR_RETURN_LOG(int, "Cannot clear the persist flag of the transportation layer pipe");
+			if(!handle->conn->pushed && ERROR_CODE(int) == _conn_free(handle->conn))
+				ERROR_RETURN_LOG(int, "Cannot dispose the connection state");
+		}
+	}
+
+	return itc_module_pipe_deallocate(handle->t_pipe);
+}
+
+/**
+ * @brief read from the pipe
+ * @param ctx the module context
+ * @param buffer the data buffer
+ * @param bytes_to_read the number of bytes to read to buffer
+ * @param in the pipe handle
+ * @return the size has been actually read to the buffer, or error code
+ **/
+static size_t _read(void* __restrict ctx, void* __restrict buffer, size_t bytes_to_read, void* __restrict in)
+{
+	(void)ctx;
+	_handle_t* handle = (_handle_t*)in;
+	if(handle->type != _HANDLE_TYPE_IN) ERROR_RETURN_LOG(size_t, "Wrong pipe type: Cannot read from an output HTTP/2 pipe");
+
+	if(NULL != handle->stream)
+		return module_http2_stream_read(handle->stream->stream, buffer, bytes_to_read);
+
+	_conn_t* conn = handle->conn;
+
+	/* The pending buffer is kept until the next read, so that the EOM call is able to put the bytes back */
+	if(NULL != conn->pending && conn->pending_start == conn->pending_size)
+	{
+		free(conn->pending);
+		conn->pending = NULL;
+		conn->pending_size = conn->pending_start = 0;
+	}
+
+	if(NULL != conn->pending)
+	{
+		size_t nbytes = conn->pending_size - conn->pending_start;
+		if(nbytes > bytes_to_read) nbytes = bytes_to_read;
+
+		memcpy(buffer, conn->pending + conn->pending_start, nbytes);
+
+		handle->last_read_pending = 1;
+		handle->last_read_start = conn->pending_start;
+		conn->pending_start += (uint32_t)nbytes;
+
+		return nbytes;
+	}
+
+	handle->last_read_pending = 0;
+
+	return itc_module_pipe_read(buffer, bytes_to_read, handle->t_pipe);
+}
+
+/**
+ * @brief write to the pipe
+ * @param ctx the module context
+ * @param data the data buffer
+ * @param nbytes the number of bytes to write
+ * @param out the pipe handle
+ * @return the number of bytes has been written or error code
+ **/
+static size_t _write(void* __restrict ctx, const void* __restrict data, size_t nbytes, void* __restrict out)
+{
+	(void)ctx;
+	_handle_t* handle = (_handle_t*)out;
+	if(handle->type != _HANDLE_TYPE_OUT) ERROR_RETURN_LOG(size_t, "Wrong pipe type: Cannot write to an input HTTP/2 pipe");
+
+	if(NULL == handle->stream)
+		return itc_module_pipe_write(data, nbytes, handle->t_pipe);
+
+	_conn_t* conn = handle->conn;
+
+	pthread_mutex_lock(&conn->mutex);
+
+	size_t rc;
+	for(;;)
+	{
+		if(ERROR_CODE(size_t) == (rc = module_http2_stream_write(conn->h2, handle->stream->stream, data, nbytes)))
+		{
+			LOG_ERROR("Cannot write the response to the HTTP/2 stream");
+			break;
+		}
+
+		/* While the connection is handed back to the event thread, the frames are flushed once it's redelivered */
+		if(NULL != conn->t_out && ERROR_CODE(int) == _conn_flush(conn))
+		{
+			rc = ERROR_CODE(size_t);
+			break;
+		}
+
+		if(rc > 0 || nbytes == 0) break;
+
+		if(conn->error || conn->eof)
+		{
+			LOG_ERROR("The connection is gone while the response is blocked by the flow control");
+			rc = ERROR_CODE(size_t);
+			break;
+		}
+
+		/* Wait for the WINDOW_UPDATE frame, so that the upstream is blocked as well.
+		 * If the frame has arrived already, there's no need to wait for the reader thread */
+		if(NULL == conn->t_in || !_conn_pump(conn))
+			pthread_cond_wait(&conn->cond, &conn->mutex);
+	}
+
+	pthread_mutex_unlock(&conn->mutex);
+
+	return rc;
+}
+
+/**
+ * @brief the end of message call
+ * @param ctx the module context
+ * @param pipe the pipe handle
+ * @param buffer the buffer that has the data recently read
+ * @param offset the offset of the EOM token
+ * @return status code
+ **/
+static int _eom(void* __restrict ctx, void* __restrict pipe, const char* buffer, size_t offset)
+{
+	(void)ctx;
+	_handle_t* handle = (_handle_t*)pipe;
+
+	if(NULL != handle->stream)
+		return module_http2_stream_eom(handle->stream->stream, offset);
+
+	if(handle->last_read_pending)
+	{
+		_conn_t* conn = handle->conn;
+
+		LOG_DEBUG("Returning some bytes to the pending buffer");
+
+		if(NULL == conn->pending || handle->last_read_start + offset > conn->pending_start)
+			ERROR_RETURN_LOG(int, "Invalid offset");
+
+		conn->pending_start = handle->last_read_start + (uint32_t)offset;
+
+		return 0;
+	}
+
+	return _invoke_pipe_cntl(handle->t_pipe, RUNTIME_API_PIPE_CNTL_OPCODE_EOM, buffer, offset);
+}
+
+/**
+ * @brief check if the pipe has unread data
+ * @param ctx the module context
+ * @param pipe the pipe to check
+ * @return the checking result or status code
+ **/
+static int _has_unread(void* __restrict ctx, void* __restrict pipe)
+{
+	(void)ctx;
+	_handle_t* handle = (_handle_t*)pipe;
+
+	if(handle->type != _HANDLE_TYPE_IN) ERROR_RETURN_LOG(int, "Wrong pipe type: _HANDLE_TYPE_IN expected");
+
+	if(NULL != handle->stream)
+	{
+		int rc = module_http2_stream_eof(handle->stream->stream);
+		if(ERROR_CODE(int) == rc) ERROR_RETURN_LOG(int, "Cannot check if the stream has been consumed");
+		return !rc;
+	}
+
+	if(NULL != handle->conn->pending && handle->conn->pending_start < handle->conn->pending_size) return 1;
+
+	int rc = itc_module_pipe_eof(handle->t_pipe);
+	if(ERROR_CODE(int) == rc) ERROR_RETURN_LOG(int, "Cannot check if the transportation layer has been consumed");
+
+	return !rc;
+}
+
+/**
+ * @brief push a user-space state to the pipe handle
+ * @param ctx the module context
+ * @param pipe the pipe handle
+ * @param state the state to push
+ * @param func the dispose function
+ * @return status code
+ **/
+static int _push_state(void* __restrict ctx, void* __restrict pipe, void* __restrict state, itc_module_state_dispose_func_t func)
+{
+	(void)ctx;
+	_handle_t* handle = (_handle_t*)pipe;
+
+	if(NULL != handle->stream)
+	{
+		/* The stream never outlives the request, so the state is disposed once the stream is done */
+		_stream_t* stream = handle->stream;
+		if(NULL != stream->user_state && stream->user_state != state && NULL != stream->dispose_user_state &&
+		   ERROR_CODE(int) == stream->dispose_user_state(stream->user_state))
+			ERROR_RETURN_LOG(int, "Cannot dispose the previous user-space state");
+		stream->user_state = state;
+		stream->dispose_user_state = func;
+		return 0;
+	}
+
+	if(handle->conn->user_state != state && ERROR_CODE(int) == _conn_user_state_dispose(handle->conn))
+		ERROR_RETURN_LOG(int, "Cannot dispose the previous user-space state");
+
+	handle->conn->user_state = state;
+	handle->conn->dispose_user_state = func;
+
+	return 0;
+}
+
+/**
+ * @brief pop the previous pushed state from the pipe handle
+ * @param ctx the module context
+ * @param pipe the pipe handle
+ * @return the previously pushed state
+ **/
+static void* _pop_state(void* __restrict ctx, void* __restrict pipe)
+{
+	(void)ctx;
+	_handle_t* handle = (_handle_t*)pipe;
+
+	if(NULL != handle->stream) return handle->stream->user_state;
+
+	return handle->conn->user_state;
+}
+
+/**
+ * @brief the callback function used to cleanup when the thread gets killed
+ * @param ctx the module context
+ * @return nothing
+ **/
+static void _event_thread_killed(void* __restrict ctx)
+{
+	_module_context_t* context = (_module_context_t*)ctx;
+
+	/* The reader thread fails the held connections, so that the blocked writers are waken up */
+	context->killed = 1;
+
+	itc_module_loop_killed(context->transport_mod);
+}
+
+/**
+ * @brief get the path of the module instance
+ * @param ctx the module context
+ * @param buf the buffer used to return the path
+ * @param sz the size of the buffer
+ * @return the result path or NULL on error
+ **/
+static const char* _get_path(void* __restrict ctx, char* buf, size_t sz)
+{
+	_module_context_t* context = (_module_context_t*)ctx;
+
+	if(NULL == itc_module_get_path(context->transport_mod, buf, sz))
+		ERROR_PTR_RETURN_LOG("Cannot get the path to transportation layer module");
+
+	return buf;
+}
+
+/**
+ * @brief get the flags of the module instance
+ * @param ctx the moudle context
+ * @return the flags
+ **/
+static itc_module_flags_t _get_flags(void* __restrict ctx)
+{
+	(void)ctx;
+	return ITC_MODULE_FLAGS_EVENT_LOOP;
+}
+
+/**
+ * @brief get the module property
+ * @param ctx the module context
+ * @param sym the property symbol
+ * @return the property value
+ **/
+static itc_module_property_value_t _get_prop(void* __restrict ctx, const char* sym)
+{
+#define _IS(v) (strcmp(sym, (v)) == 0)
+#define _SYMBOL(cond) else if(cond)
+	itc_module_property_value_t ret = {
+		.type = ITC_MODULE_PROPERTY_TYPE_INT
+	};
+	_module_context_t* context = (_module_context_t*)ctx;
+
+	if(0);
+	_SYMBOL(_IS("max_concurrent_streams")) ret.num = context->conf.max_concurrent_streams;
+	_SYMBOL(_IS("initial_window_size")) ret.num = context->conf.initial_window_size;
+	_SYMBOL(_IS("max_frame_size")) ret.num = context->conf.max_frame_size;
+	_SYMBOL(_IS("header_table_size")) ret.num = context->conf.header_table_size;
+	_SYMBOL(_IS("max_request_size")) ret.num = context->conf.max_request_size;
+	_SYMBOL(_IS("stat_connections")) ret.num = (int64_t)context->stat_connections;
+	_SYMBOL(_IS("stat_streams")) ret.num = (int64_t)context->stat_streams;
+	_SYMBOL(_IS("stat_passthrough")) ret.num = (int64_t)context->stat_passthrough;
+	else ret.type = ITC_MODULE_PROPERTY_TYPE_NONE;
+
+	return ret;
+#undef _IS
+#undef _SYMBOL
+}
+
+/**
+ * @brief set the module property
+ * @param ctx the module context
+ * @param sym the property symbol
+ * @param value the property value
+ * @return 1 if the property has been set, 0 if the property is unknown, or error code
+ **/
+static int _set_prop(void* __restrict ctx, const char* sym, itc_module_property_value_t value)
+{
+#define _IS(v) (strcmp(sym, (v)) == 0)
+#define _SYMBOL(cond) else if(cond)
+	_module_context_t* context = (_module_context_t*)ctx;
+
+	if(value.type != ITC_MODULE_PROPERTY_TYPE_INT) return 0;
+
+	if(0);
+	_SYMBOL(_IS("max_concurrent_streams"))
+	{
+		if(value.num <= 0 || value.num > 0x7fffffff) ERROR_RETURN_LOG(int, "Invalid max concurrent streams %"PRId64, value.num);
+		context->conf.max_concurrent_streams = (uint32_t)value.num;
+	}
+	_SYMBOL(_IS("initial_window_size"))
+	{
+		if(value.num <= 0 || value.num > 0x7fffffff) ERROR_RETURN_LOG(int, "Invalid initial window size %"PRId64, value.num);
+		context->conf.initial_window_size = (uint32_t)value.num;
+	}
+	_SYMBOL(_IS("max_frame_size"))
+	{
+		if(value.num < 16384 || value.num > 0xffffff) ERROR_RETURN_LOG(int, "Invalid max frame size %"PRId64, value.num);
+		context->conf.max_frame_size = (uint32_t)value.num;
+	}
+	_SYMBOL(_IS("header_table_size"))
+	{
+		if(value.num < 0 || value.num > 0x7fffffff) ERROR_RETURN_LOG(int, "Invalid header table size %"PRId64, value.num);
+		context->conf.header_table_size = (uint32_t)value.num;
+	}
+	_SYMBOL(_IS("max_request_size"))
+	{
+		if(value.num <= 0 || value.num > 0xffffffffll) ERROR_RETURN_LOG(int, "Invalid max request size %"PRId64, value.num);
+		context->conf.max_request_size = (uint32_t)value.num;
+	}
+	else return 0;
+
+	return 1;
+#undef _IS
+#undef _SYMBOL
+}
+
+/**
+ * @brief the module definition
+ **/
+itc_module_t module_http2_module_def = {
+	.mod_prefix = "pipe.http2",
+	.handle_size = sizeof(_handle_t),
+	.context_size = sizeof(_module_context_t),
+	.module_init = _init,
+	.module_cleanup = _cleanup,
+	.accept = _accept,
+	.deallocate = _dealloc,
+	.read = _read,
+	.write = _write,
+	.eom = _eom,
+	.has_unread_data = _has_unread,
+	.push_state = _push_state,
+	.pop_state = _pop_state,
+	.event_thread_killed = _event_thread_killed,
+	.get_path = _get_path,
+	.get_flags = _get_flags,
+	.get_property = _get_prop,
+	.set_property = _set_prop
+};
@@ -30,10 +30,14 @@ typedef enum {
 
 /**
  * @brief the struct used to represents a data page
+ * @note  The first page of a pipe is a small inline chunk allocated from the object pool, since most of
+ *        the pipes only carries a few bytes. Only when the inline chunk is full, we use the full page
+ *        for the remaining data
  **/
 typedef struct _buffer_page_t {
 	struct _buffer_page_t* next;  /*!< the next page in the mem buffer */
 	uint32_t size;                /*!< the actual data size in this page */
+	uint32_t capacity;            /*!< how many bytes this page can hold */
 	uintpad_t __padding__[0];
 	char   data[0];               /*!< the data section */
 } _buffer_page_t;
@@ -50,6 +54,15 @@ typedef struct {
 	_buffer_page_t* buffer;         /*!< the actual buffer page list */
 } module_handle_t;
 
+/**
+ * @brief the module context
+ **/
+typedef struct {
+	mempool_objpool_t* inline_pool;   /*!< the memory pool for the inline chunks */
+	uint64_t           num_pipes;     /*!< how many pipes has been allocated */
+	uint64_t           num_spilled;   /*!< how many pipes has used up the inline chunk and spilled to the pages */
+} _module_context_t;
+
 /**
  * @brief the size of the page
  **/
@@ -66,16 +79,33 @@ static _buffer_page_t* __buffer_page_new(void)
 	if(NULL == ret) ERROR_PTR_RETURN_LOG("Cannot allocate memory for the new page");
 	ret->next = NULL;
 	ret->size = 0;
+	ret->capacity = _pagedata_limit;
+	return ret;
+}
+
+static _buffer_page_t* __buffer_inline_new(_module_context_t* ctx)
+{
+	_buffer_page_t* ret = (_buffer_page_t*)mempool_objpool_alloc(ctx->inline_pool);
+	if(NULL == ret) ERROR_PTR_RETURN_LOG("Cannot allocate memory for the inline chunk");
+	ret->next = NULL;
+	ret->size = 0;
+	ret->capacity = MODULE_MEM_INLINE_BUF_SIZE;
 	return ret;
 }
-static inline int __buffer_free(_buffer_page_t* page)
+
+static inline int __buffer_free(_module_context_t* ctx, _buffer_page_t* page)
 {
 	int rc = 0;
 	for(;NULL != page;)
 	{
 		_buffer_page_t* tmp = page;
 		page = page->next;
-		if(ERROR_CODE(int) == mempool_page_dealloc(tmp))
+		if(tmp->capacity == _pagedata_limit)
+		{
+			if(ERROR_CODE(int) == mempool_page_dealloc(tmp))
+				rc = ERROR_CODE(int);
+		}
+		else if(ERROR_CODE(int) == mempool_objpool_dealloc(ctx->inline_pool, tmp))
 			rc = ERROR_CODE(int);
 	}
 	return rc;
@@ -83,54 +113,70 @@ static inline int __buffer_free(_buffer_page_t* page)
 
 static int _module_init(void* __restrict ctx, uint32_t argc, char const* __restrict const* __restrict argv)
 {
-	(void) ctx;
 	(void) argc;
 	(void) argv;
+	_module_context_t* context = (_module_context_t*)ctx;
 
 	int rc = getpagesize();
 	if(rc < 0) ERROR_RETURN_LOG_ERRNO(int, "Cannot get the page size");
 	else LOG_DEBUG("The page size is %d", rc);
 	_pagesize = (uint32_t)rc;
 	_pagedata_limit = _pagesize - (uint32_t)sizeof(_buffer_page_t);
+
+	if(MODULE_MEM_INLINE_BUF_SIZE >= _pagedata_limit)
+		ERROR_RETURN_LOG(int, "The inline buffer size must be smaller than a page");
+
+	if(NULL == (context->inline_pool = mempool_objpool_new((uint32_t)(sizeof(_buffer_page_t) + MODULE_MEM_INLINE_BUF_SIZE))))
+		ERROR_RETURN_LOG(int, "Cannot create the memory pool for the inline chunks");
+
+	context->num_pipes = 0;
+	context->num_spilled = 0;
+
 	return 0;
 }
 
 static int _module_cleanup(void* __restrict ctx)
 {
-	(void) ctx;
+	_module_context_t* context = (_module_context_t*)ctx;
+
+	if(NULL != context->inline_pool && ERROR_CODE(int) == mempool_objpool_free(context->inline_pool))
+		ERROR_RETURN_LOG(int, "Cannot dispose the memory pool for the inline chunks");
+
 	return 0;
 }
 
 static int _allocate(void* __restrict ctx, uint32_t hint, void* __restrict out, void* __restrict in, const void* __restrict args)
 {
-	(void)ctx;
 	(void)args;
 	(void)hint;
 
+	_module_context_t* context = (_module_context_t*)ctx;
 	module_handle_t* input = (module_handle_t*)in;
 	module_handle_t* output = (module_handle_t*)out;
 
 	input->type = _INPUT;
 	output->type = _OUTPUT;
 
-	if(NULL == (input->current_page = output->current_page = output->buffer = input->buffer = __buffer_page_new()))
+	if(NULL == (input->current_page = output->current_page = output->buffer = input->buffer = __buffer_inline_new(context)))
 		ERROR_RETURN_LOG(int, "Cannot allocate buffer for the mempipie");
 
 	input->page_offset = output->page_offset = 0;
+
+	__sync_fetch_and_add(&context->num_pipes, 1);
+
 	LOG_DEBUG("pipe has been created!");
 	return 0;
 }
 
 static int _deallocate(void* __restrict ctx, void* __restrict pipe, int error, int purge)
 {
-	(void) ctx;
 	(void) error;
 	module_handle_t* handle = (module_handle_t*)pipe;
 
 	if(purge)
 	{
 		LOG_DEBUG("pipe has been disposed");
-		return __buffer_free(handle->buffer);
+		return __buffer_free((_module_context_t*)ctx, handle->buffer);
 	}
 
 	LOG_DEBUG("one side of the pipe dead");
@@ -221,8 +267,7 @@ static size_t _read(void* __restrict ctx, void* __restrict buffer, size_t nbytes
 
 static size_t _write(void* __restrict ctx, const void* __restrict buffer, size_t nbytes, void* __restrict pipe)
 {
-	(void) ctx;
-
+	_module_context_t* context = (_module_context_t*)ctx;
 	module_handle_t* handle = (module_handle_t*)pipe;
 
 	if(handle->type != _OUTPUT)
@@ -233,7 +278,7 @@ static size_t _write(void* __restrict ctx, const void* __restrict buffer, size_t
 
 	for(;nbytes > 0;)
 	{
-		uint32_t size = _pagedata_limit - handle->page_offset;
+		uint32_t size = handle->current_page->capacity - handle->page_offset;
 		if(nbytes < size) size = (uint32_t)nbytes;
 		memcpy(handle->current_page->data + handle->page_offset, b, size);
 
@@ -242,12 +287,14 @@ static size_t _write(void* __restrict ctx, const void* __restrict buffer, size_t
 		b += size;
 		nbytes -= size;
 		ret += size;
-		if(handle->current_page->size == _pagedata_limit)
+		if(handle->current_page->size == handle->current_page->capacity)
 		{
 			if(NULL != handle->current_page->next)
 				ERROR_RETURN_LOG(size_t, "Unexpected current page in a write pipe, code bug!");
 			if(NULL == (handle->current_page->next = __buffer_page_new()))
 				ERROR_RETURN_LOG(size_t, "Cannot create new page for the mempipe");
+			if(handle->current_page == handle->buffer)
+				__sync_fetch_and_add(&context->num_spilled, 1);
 			handle->page_offset = 0;
 			handle->current_page = handle->current_page->next;
 		}
@@ -289,6 +336,27 @@ static int _has_unread_data(void* __restrict ctx, void* __restrict data)
 	return handle->current_page != NULL;
 }
 
+static itc_module_property_value_t _get_prop(void* __restrict ctx, const char* sym)
+{
+	const _module_context_t* context = (const _module_context_t*)ctx;
+	itc_module_property_value_t ret = {
+		.type = ITC_MODULE_PROPERTY_TYPE_INT
+	};
+
+	if(strcmp(sym, "num_pipes") == 0)
+		ret.num = (int64_t)context->num_pipes;
+	else if(strcmp(sym, "num_inline_pipes") == 0)
+		ret.num = (int64_t)(context->num_pipes - context->num_spilled);
+	else if(strcmp(sym, "num_spilled_pipes") == 0)
+		ret.num = (int64_t)context->num_spilled;
+	else if(strcmp(sym, "inline_size") == 0)
+		ret.num = MODULE_MEM_INLINE_BUF_SIZE;
+	else
+		ret.type = ITC_MODULE_PROPERTY_TYPE_NONE;
+
+	return ret;
+}
+
 static const char* _get_path(void* __restrict ctx, char* buf, size_t sz)
 {
 	(void) ctx;
@@ -300,7 +368,7 @@ static const char* _get_path(void* __restrict ctx, char* buf, size_t sz)
 itc_module_t module_mem_module_def = {
 	.handle_size = sizeof(module_handle_t),
 	.mod_prefix = "pipe.mem",
-	.context_size = 0,
+	.context_size = sizeof(_module_context_t),
 	.module_init = _module_init,
 	.module_cleanup = _module_cleanup,
 	.allocate = _allocate,
@@ -310,6 +378,7 @@ itc_module_t module_mem_module_def = {
 	.fork = _fork,
 	.has_unread_data = _has_unread_data,
 	.get_path = _get_path,
+	.get_property = _get_prop,
 	.get_internal_buf = _get_internal_buf,
 	.release_internal_buf = _release_internal_buf
 };
@@ -563,6 +563,90 @@ static inline int _rscope_stream_ready_event(sched_rscope_stream_t* stream, runt
 	return sched_rscope_stream_get_event(stream, buf);
 }
 
+/**
+ * @brief allocate memory from the arena of the request scope that is currently being executed
+ * @param size the number of bytes to allocate
+ * @param ret the buffer used to return the allocated memory
+ * @return status code
+ **/
+static int _scope_arena_alloc(size_t size, void** ret)
+{
+	if(NULL == ret)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	sched_rscope_t* current = sched_step_current_scope();
+	if(NULL == current)
+		ERROR_RETURN_LOG(int, "Cannot get the current scope");
+
+	if(NULL == (*ret = sched_rscope_arena_alloc(current, size)))
+		return ERROR_CODE(int);
+
+	return 0;
+}
+
+/**
+ * @brief the function that implements scope_stream_open
+ * @param token the RLS token to open
+ * @param ret the buffer used to return the stream
+ * @return status code
+ **/
+static int _scope_stream_open(uint32_t token, void** ret)
+{
+	if(NULL == ret)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+	if(NULL == (*ret = _rscope_stream_open(token)))
+		return ERROR_CODE(int);
+	return 0;
+}
+
+/**
+ * @brief the function that implements scope_stream_read
+ * @param stream the stream to read
+ * @param buf the buffer
+ * @param bufsize the size of the buffer
+ * @param ret the buffer used to return the number of bytes has been read
+ * @return status code
+ **/
+static int _scope_stream_read(sched_rscope_stream_t* stream, void* buf, size_t bufsize, size_t* ret)
+{
+	if(NULL == ret)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+	if(ERROR_CODE(size_t) == (*ret = _rscope_stream_read(stream, buf, bufsize)))
+		return ERROR_CODE(int);
+	return 0;
+}
+
+/**
+ * @brief the function that implements scope_stream_eof
+ * @param stream the stream to check
+ * @param ret the buffer used to return the check result
+ * @return status code
+ **/
+static int _scope_stream_eof(const sched_rscope_stream_t* stream, int* ret)
+{
+	if(NULL == ret)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+	if(ERROR_CODE(int) == (*ret = _rscope_stream_eof(stream)))
+		return ERROR_CODE(int);
+	return 0;
+}
+
+/**
+ * @brief the function that implements scope_stream_ready_event
+ * @param stream the stream to query
+ * @param buf the buffer used to return the event
+ * @param ret the buffer used to return the number of events
+ * @return status code
+ **/
+static int _scope_stream_ready_event(sched_rscope_stream_t* stream, runtime_api_scope_ready_event_t* buf, int* ret)
+{
+	if(NULL == ret)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+	if(ERROR_CODE(int) == (*ret = _rscope_stream_ready_event(stream, buf)))
+		return ERROR_CODE(int);
+	return 0;
+}
+
 static int _invoke(void* __restrict ctx, uint32_t opcode, va_list args)
 {
 	(void)ctx;
@@ -646,11 +730,7 @@ static int _invoke(void* __restrict ctx, uint32_t opcode, va_list args)
 		{
 			uint32_t token = va_arg(args, uint32_t);
 			void** ret = va_arg(args, void**);
-			if(NULL == ret)
-				ERROR_RETURN_LOG(int, "Invalid arguments");
-			if(NULL == (*ret = _rscope_stream_open(token)))
-				return ERROR_CODE(int);
-			return 0;
+			return _scope_stream_open(token, ret);
 		}
 		case MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_CLOSE:
 		{
@@ -663,32 +743,26 @@ static int _invoke(void* __restrict ctx, uint32_t opcode, va_list args)
 			void* buf = va_arg(args, void*);
 			size_t bufsize = va_arg(args, size_t);
 			size_t* ret = va_arg(args, size_t*);
-			if(NULL == ret)
-				ERROR_RETURN_LOG(int, "Invalid arguments");
-			if(ERROR_CODE(size_t) == (*ret = _rscope_stream_read(stream, buf, bufsize)))
-				return ERROR_CODE(int);
-			return 0;
+			return _scope_stream_read(stream, buf, bufsize, ret);
 		}
 		case MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_EOF:
 		{
 			const sched_rscope_stream_t* stream = va_arg(args, const sched_rscope_stream_t*);
 			int* ret = va_arg(args, int*);
-			if(NULL == ret)
-				ERROR_RETURN_LOG(int, "Invalid arguments");
-			if(ERROR_CODE(int) == (*ret = _rscope_stream_eof(stream)))
-				return ERROR_CODE(int);
-			return 0;
+			return _scope_stream_eof(stream, ret);
 		}
 		case MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_READY_EVENT:
 		{
 			sched_rscope_stream_t* stream = va_arg(args, sched_rscope_stream_t*);
 			runtime_api_scope_ready_event_t* buf = va_arg(args, runtime_api_scope_ready_event_t*);
 			int* ret = va_arg(args, int*);
-			if(NULL == ret)
-				ERROR_RETURN_LOG(int, "Invalid arguments");
-			if(ERROR_CODE(int) == (*ret = _rscope_stream_ready_event(stream, buf)))
-				return ERROR_CODE(int);
-			return 0;
+			return _scope_stream_ready_event(stream, buf, ret);
+		}
+		case MODULE_PSSM_MODULE_OPCODE_SCOPE_ARENA_ALLOC:
+		{
+			size_t nbytes = va_arg(args, size_t);
+			void** ret = va_arg(args, void**);
+			return _scope_arena_alloc(nbytes, ret);
 		}
 		default:
 			ERROR_RETURN_LOG(int, "Invalid opcode 0x%x", opcode);
@@ -716,10 +790,52 @@ static uint32_t _get_opcode(void* __restrict ctx, const char* name)
 	if(strcmp(name, "scope_stream_eof") == 0) return MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_EOF;
 	if(strcmp(name, "scope_stream_read") == 0) return MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_READ;
 	if(strcmp(name, "scope_stream_ready_event") == 0) return MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_READY_EVENT;
+	if(strcmp(name, "scope_arena_alloc") == 0) return MODULE_PSSM_MODULE_OPCODE_SCOPE_ARENA_ALLOC;
 
 	ERROR_RETURN_LOG(uint32_t, "Invalid method name %s", name);
 }
 
+static runtime_api_module_func_t _get_func(void* __restrict ctx, uint32_t opcode)
+{
+	(void)ctx;
+	if(_initialized == 0) ERROR_PTR_RETURN_LOG("Bug: The module haven't been initialized");
+
+	/* Only the functions on the hot path are exposed, the remaining ones are still called through invoke */
+	switch(opcode)
+	{
+		case MODULE_PSSM_MODULE_OPCODE_POOL_ALLOCATE:
+			return (runtime_api_module_func_t)_pool_alloc;
+		case MODULE_PSSM_MODULE_OPCODE_POOL_DEALLOCATE:
+			return (runtime_api_module_func_t)_pool_dealloc;
+		case MODULE_PSSM_MODULE_OPCODE_THREAD_LOCAL_GET:
+			return (runtime_api_module_func_t)_thread_local_get;
+		case MODULE_PSSM_MODULE_OPCODE_REQUEST_SCOPE_ADD:
+			return (runtime_api_module_func_t)_rscope_add;
+		case MODULE_PSSM_MODULE_OPCODE_REQUEST_SCOPE_COPY:
+			return (runtime_api_module_func_t)_rscope_copy;
+		case MODULE_PSSM_MODULE_OPCODE_REQUEST_SCOPE_GET:
+			return (runtime_api_module_func_t)_rscope_get;
+		case MODULE_PSSM_MODULE_OPCODE_PAGE_ALLOCATE:
+			return (runtime_api_module_func_t)_page_allocate;
+		case MODULE_PSSM_MODULE_OPCODE_PAGE_DEALLOCATE:
+			return (runtime_api_module_func_t)_page_deallocate;
+		case MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_OPEN:
+			return (runtime_api_module_func_t)_scope_stream_open;
+		case MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_CLOSE:
+			return (runtime_api_module_func_t)_rscope_stream_close;
+		case MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_EOF:
+			return (runtime_api_module_func_t)_scope_stream_eof;
+		case MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_READ:
+			return (runtime_api_module_func_t)_scope_stream_read;
+		case MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_READY_EVENT:
+			return (runtime_api_module_func_t)_scope_stream_ready_event;
+		case MODULE_PSSM_MODULE_OPCODE_SCOPE_ARENA_ALLOC:
+			return (runtime_api_module_func_t)_scope_arena_alloc;
+		default:
+			return NULL;
+	}
+}
+
 static const char _libconf_prefix[] = "libconf.";
 
 static itc_module_property_value_t _get_prop(void* __restrict ctx, const char* sym)
@@ -821,6 +937,7 @@ itc_module_t module_pssm_module_def = {
 	.get_path       = _get_path,
 	.invoke         = _invoke,
 	.get_opcode     = _get_opcode,
+	.get_func       = _get_func,
 	.on_exit        = _onexit,
 	.get_property   = _get_prop,
 	.set_property   = _set_prop
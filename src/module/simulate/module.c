@@ -13,6 +13,7 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <time.h>
+#include <pthread.h>
 
 #include <error.h>
 #include <utils/log.h>
@@ -20,6 +21,19 @@
 #include <module/simulate/module.h>
 #include <module/simulate/api.h>
 
+/**
+ * @brief The output produced by a single dispatch of the event
+ * @note  A persistent event with unread bytes is dispatched again with the remaining bytes, just like
+ *        a pipelined request on a kept-alive connection. Each of the dispatches has its own output
+ **/
+typedef struct _output_t {
+	uint32_t              seq;    /*!< The sequence number of the dispatch within the event */
+	size_t                outcap; /*!< The capacity of the output buffer */
+	size_t                outsize;/*!< The size of the output */
+	char*                 outbuf; /*!< The output buffer */
+	struct _output_t*     next;   /*!< The output of the next dispatch */
+} _output_t;
+
 /**
  * @brief represent a simulated event, which is defined by the event file
  **/
@@ -27,12 +41,24 @@ typedef struct _event_t {
 	char*                 label;  /*!< The label for this event t */
 	size_t                size;   /*!< The size of this event */
 	char*                 data;   /*!< The data for this event */
-	size_t                outcap; /*!< The capacity of the output buffer */
-	size_t                outsize;/*!< The size of the output */
-	char*                 outbuf; /*!< The output buffer */
+	_output_t*            output; /*!< The outputs of the first round dispatches */
+	_output_t*            output_tail; /*!< The last output in the output list */
 	struct _event_t*      next;   /*!< The next event in the event list */
 } _event_t;
 
+/**
+ * @brief A single dispatch of an event, which is shared by the input and output handle of the accepted pipe pair
+ **/
+typedef struct _dispatch_t {
+	_event_t*             event;  /*!< The event we are dispatching */
+	size_t                begin;  /*!< The offset where this dispatch begins */
+	size_t                end;    /*!< The offset where the input side stops reading */
+	uint32_t              round;  /*!< Which replay round this dispatch belongs to */
+	uint32_t              seq;    /*!< The sequence number of the dispatch within the event */
+	_output_t*            output; /*!< The output buffer, NULL if the output should be discarded */
+	struct _dispatch_t*   next;   /*!< The next dispatch in the ready queue */
+} _dispatch_t;
+
 /**
  * @brief The module context
  **/
@@ -45,7 +71,17 @@ typedef struct {
 	uint32_t       events_per_sec;   /*!< The rate of how many events will be poped up per seconds */
 	uint32_t       remaining;        /*!< How many events is currently not closed */
 	uint32_t       terminate:1;      /*!< Indicates this event is actuall terminate the platform */
+	uint32_t       killed:1;         /*!< Indicates the event loop has been killed */
+	uint32_t       repeat;           /*!< How many rounds we want to replay the event list */
+	uint32_t       round;            /*!< The current replay round */
+	uint32_t       inflight;         /*!< The number of dispatches that is not deallocated yet */
+	uint64_t       dispatched;       /*!< The number of dispatches we have made */
+	uint64_t       first_event_ts;   /*!< The timestamp of the first dispatch */
 	uint64_t       last_event_ts;    /*!< The timestamp of the last event */
+	_dispatch_t*   ready_head;       /*!< The persistent dispatches that have unread bytes */
+	_dispatch_t*   ready_tail;       /*!< The tail of the ready queue */
+	pthread_mutex_t mutex;           /*!< The mutex used to protect the ready queue and inflight counter */
+	pthread_cond_t  cond;            /*!< The condition variable for the ready queue */
 } _module_context_t;
 
 /**
@@ -53,10 +89,20 @@ typedef struct {
  **/
 typedef struct {
 	uint32_t             output:1;/*!< If this is the output */
+	uint32_t             forked:1;/*!< If this is a forked handle */
 	_event_t*            event;   /*!< The event we are handling */
+	_dispatch_t*         dispatch;/*!< The dispatch this handle belongs to */
 	size_t               offset;  /*!< The offset for where we are */
+	size_t               last_read; /*!< The size of the last read, used by the EOM call */
 } _handle_t;
 
+static inline uint64_t _now_ns(void)
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return ((uint64_t)time.tv_sec * 1000000000ull) + (uint64_t)time.tv_nsec;
+}
+
 static inline int _start_with(const char* str, const char* pref)
 {
 	for(;*str != 0 && *pref != 0 && *str == *pref;str ++, pref++);
@@ -276,18 +322,29 @@ static int _init(void* __restrict ctxbuf, uint32_t argc, char const* __restrict
 	const char input_prefix[] = "input=";
 	const char output_prefix[] = "output=";
 	const char id_prefix[] = "label=";
+	const char repeat_prefix[] = "repeat=";
 
 	const char* input_name = NULL;
 	const char* output_name = NULL;
 	const char* id = NULL;
 
+	ctx->repeat = 1;
+
 	uint32_t i;
 	for(i = 0; i < argc; i ++)
 	{
 		if(_start_with(argv[i], input_prefix)) input_name = argv[i] + sizeof(input_prefix) - 1;
 		else if(_start_with(argv[i], output_prefix)) output_name = argv[i] + sizeof(output_prefix) - 1;
 		else if(_start_with(argv[i], id_prefix)) id = argv[i] + sizeof(id_prefix) - 1;
-		else ERROR_RETURN_LOG(int, "Invalid module initialization arguments, expected: simulate input=inputfile output=outputfile label=labelname");
+		else if(_start_with(argv[i], repeat_prefix))
+		{
+			char* endptr = NULL;
+			unsigned long repeat = strtoul(argv[i] + sizeof(repeat_prefix) - 1, &endptr, 10);
+			if(NULL == endptr || *endptr != 0 || repeat == 0 || repeat > UINT32_MAX)
+				ERROR_RETURN_LOG(int, "Invalid repeat count %s", argv[i] + sizeof(repeat_prefix) - 1);
+			ctx->repeat = (uint32_t)repeat;
+		}
+		else ERROR_RETURN_LOG(int, "Invalid module initialization arguments, expected: simulate input=inputfile output=outputfile label=labelname [repeat=N]");
 	}
 
 	if(input_name == NULL || input_name[0] == 0)
@@ -312,9 +369,21 @@ static int _init(void* __restrict ctxbuf, uint32_t argc, char const* __restrict
 
 	fclose(fp);
 
+	/* Each replay round dispatches the entire event list again */
+	ctx->remaining *= ctx->repeat;
+
 	if(NULL == (ctx->outfile = strdup(output_name)))
 		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot open the output file %s", output_name);
 
+	if((errno = pthread_mutex_init(&ctx->mutex, NULL)) != 0)
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot initialize the ready queue mutex");
+
+	if((errno = pthread_cond_init(&ctx->cond, NULL)) != 0)
+	{
+		pthread_mutex_destroy(&ctx->mutex);
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot initialize the ready queue condition variable");
+	}
+
 	LOG_DEBUG("Event Simulation Module has been initialized, input = %s, output = %s", input_name, output_name);
 
 	ctx->next_event = ctx->event_list_head;
@@ -326,6 +395,28 @@ ERR:
 	return ERROR_CODE(int);
 }
 
+static inline int _write_output(FILE* fout, const char* label, const _output_t* output)
+{
+	if(output->seq == 0)
+		fprintf(fout, ".OUTPUT %s\n", label);
+	else
+		fprintf(fout, ".OUTPUT %s.%u\n", label, output->seq);
+
+	size_t bytes_to_write = output->outsize;
+	const char* data_buf = output->outbuf;
+	for(;bytes_to_write > 0;)
+	{
+		size_t rc = fwrite(data_buf, 1, bytes_to_write, fout);
+		if(rc == 0 && ferror(fout))
+			ERROR_RETURN_LOG_ERRNO(int, "Cannot write to the output file");
+		data_buf += rc;
+		bytes_to_write -= rc;
+	}
+	fprintf(fout, "\n.END\n");
+
+	return 0;
+}
+
 static inline int _cleanup(void* __restrict ctxbuf)
 {
 	int ret = 0;
@@ -342,33 +433,33 @@ static inline int _cleanup(void* __restrict ctxbuf)
 	{
 		_event_t* event = ctx->event_list_head;
 		ctx->event_list_head = ctx->event_list_head->next;
-		if(event->label != NULL && event->outbuf != NULL)
+		for(;event->output != NULL;)
 		{
-			size_t bytes_to_write = event->outsize;
-			const char* data_buf = event->outbuf;
-			fprintf(fout, ".OUTPUT %s\n", event->label);
-			for(;bytes_to_write > 0;)
+			_output_t* output = event->output;
+			event->output = output->next;
+			if(event->label != NULL && output->outbuf != NULL && NULL != fout)
 			{
-				size_t rc = fwrite(data_buf, 1, bytes_to_write, fout);
-				if(rc == 0 && ferror(fout))
-				{
-					LOG_ERROR_ERRNO("Cannot write to the output file");
+				if(ERROR_CODE(int) == _write_output(fout, event->label, output))
 					ret = ERROR_CODE(int);
-					break;
-				}
-				data_buf += rc;
-				bytes_to_write -= rc;
+				LOG_DEBUG("Dumped simulated event output %s", event->label);
 			}
-			fprintf(fout, "\n.END\n");
-			free(event->outbuf);
-			LOG_DEBUG("Dumped simulated event output %s", event->label);
+			else if(event->label != NULL) LOG_DEBUG("Skip untouched simulated event %s", event->label);
+			if(output->outbuf != NULL) free(output->outbuf);
+			free(output);
 		}
-		else if(event->label != NULL) LOG_DEBUG("Skip untouched simulated event %s", event->label);
 		if(event->data != NULL) free(event->data);
 		if(event->label != NULL) free(event->label);
 		free(event);
 	}
+	for(;ctx->ready_head != NULL;)
+	{
+		_dispatch_t* dispatch = ctx->ready_head;
+		ctx->ready_head = dispatch->next;
+		free(dispatch);
+	}
 	if(NULL != fout) fclose(fout);
+	pthread_mutex_destroy(&ctx->mutex);
+	pthread_cond_destroy(&ctx->cond);
 	return ret;
 }
 
@@ -384,54 +475,184 @@ static int _accept(void* __restrict ctxbuf, const void* __restrict args, void* _
 	(void)args;
 	_module_context_t* ctx = (_module_context_t*)ctxbuf;
 	if(NULL == ctx) ERROR_RETURN_LOG(int, "Invalid arguments");
-	if(NULL == ctx->next_event)
+
+	_dispatch_t* dispatch = NULL;
+
+	if((errno = pthread_mutex_lock(&ctx->mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the ready queue mutex");
+
+	for(;;)
+	{
+		/* The persistent event which has unread bytes goes first, just like a pipelined request */
+		if(NULL != (dispatch = ctx->ready_head))
+		{
+			if(NULL == (ctx->ready_head = dispatch->next))
+				ctx->ready_tail = NULL;
+			break;
+		}
+
+		if(ctx->next_event == NULL && ctx->round + 1 < ctx->repeat)
+		{
+			ctx->round ++;
+			ctx->next_event = ctx->event_list_head;
+		}
+
+		if(ctx->next_event != NULL || ctx->inflight == 0 || ctx->killed) break;
+
+		/* The event in flight may come back with the unread bytes, so we need to wait for it */
+		struct timespec abstime;
+		clock_gettime(CLOCK_REALTIME, &abstime);
+		if(abstime.tv_nsec >= 990000000)
+		{
+			abstime.tv_sec ++;
+			abstime.tv_nsec -= 990000000;
+		}
+		else abstime.tv_nsec += 10000000;
+
+		if((errno = pthread_cond_timedwait(&ctx->cond, &ctx->mutex, &abstime)) != 0 && errno != ETIMEDOUT)
+		{
+			LOG_ERROR_ERRNO("Cannot wait for the ready queue");
+			break;
+		}
+	}
+
+	if(NULL != dispatch || NULL != ctx->next_event)
+		ctx->inflight ++;
+
+	if((errno = pthread_mutex_unlock(&ctx->mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot release the ready queue mutex");
+
+	if(NULL == dispatch && NULL == ctx->next_event)
 	{
 		LOG_NOTICE("Event exhausted, terminating the event loop");
+		if(ctx->dispatched > 0)
+		{
+			double elapsed = (double)(_now_ns() - ctx->first_event_ts) / 1e9;
+			LOG_NOTICE("%"PRIu64" events has been dispatched in %.3lf seconds (%.0lf events/sec)",
+			           ctx->dispatched, elapsed, elapsed > 0 ? (double)ctx->dispatched / elapsed : 0.0);
+		}
 		return ERROR_CODE(int);
 	}
 
-	/* If we have finite events per second rate, we need to wait */
-	if(ctx->events_per_sec != 0)
+	if(NULL == dispatch)
 	{
-		struct timespec time;
-		clock_gettime(CLOCK_REALTIME, &time);
+		/* If we have finite events per second rate, we need to wait */
+		if(ctx->events_per_sec != 0)
+		{
+			struct timespec time;
+			clock_gettime(CLOCK_REALTIME, &time);
+
+			uint64_t ts = ((uint64_t)time.tv_sec * 1000000000ull) + (uint64_t)time.tv_nsec;
+			uint64_t interval = 1000000000ull / ctx->events_per_sec;
+			uint64_t time_to_sleep = (ctx->last_event_ts + interval <= ts) ? 0 : ctx->last_event_ts + interval - ts;
+
+			if(time_to_sleep > 0)
+				usleep((unsigned)time_to_sleep / 1000);
+
+			if(ctx->last_event_ts == 0) ctx->last_event_ts = ts;
+			else ctx->last_event_ts += interval;
+		}
 
-		uint64_t ts = ((uint64_t)time.tv_sec * 1000000000ull) + (uint64_t)time.tv_nsec;
-		uint64_t interval = 1000000000ull / ctx->events_per_sec;
-		uint64_t time_to_sleep = (ctx->last_event_ts + interval <= ts) ? 0 : ctx->last_event_ts + interval - ts;
+		if(NULL == (dispatch = (_dispatch_t*)calloc(1, sizeof(*dispatch))))
+			ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the dispatch");
 
-		if(time_to_sleep > 0)
-			usleep((unsigned)time_to_sleep / 1000);
+		dispatch->event = ctx->next_event;
+		dispatch->round = ctx->round;
 
-		if(ctx->last_event_ts == 0) ctx->last_event_ts = ts;
-		else ctx->last_event_ts += interval;
+		LOG_INFO("Event %s has been poped up to the application", ctx->next_event->label);
+
+		ctx->next_event = ctx->next_event->next;
 	}
+	else LOG_INFO("Event %s has been dispatched again for the unread data", dispatch->event->label);
+
+	/* We only keep the output of the first round */
+	if(dispatch->round == 0)
+	{
+		_output_t* output = (_output_t*)calloc(1, sizeof(*output));
+		if(NULL == output)
+			ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the event output");
+		output->seq = dispatch->seq;
+		if(NULL == dispatch->event->output_tail)
+			dispatch->event->output = output;
+		else
+			dispatch->event->output_tail->next = output;
+		dispatch->event->output_tail = output;
+		dispatch->output = output;
+	}
+
+	if(ctx->first_event_ts == 0) ctx->first_event_ts = _now_ns();
+	ctx->dispatched ++;
 
 	_handle_t* in = (_handle_t*)inbuf;
 	_handle_t* out = (_handle_t*)outbuf;
 
+	memset(in, 0, sizeof(*in));
+	memset(out, 0, sizeof(*out));
+
 	in->output = 0;
 	out->output = 1;
 
-	in->event = out->event = ctx->next_event;
-	in->offset = out->offset = 0;
-
-	LOG_INFO("Event %s has been poped up to the application", ctx->next_event->label);
-
-	ctx->next_event = ctx->next_event->next;
+	in->event = out->event = dispatch->event;
+	in->dispatch = out->dispatch = dispatch;
+	in->offset = out->offset = dispatch->end = dispatch->begin;
 
 	return 0;
+ERR:
+	if(NULL != dispatch) free(dispatch);
+	(void)__sync_fetch_and_sub(&ctx->inflight, 1);
+	return ERROR_CODE(int);
 }
 
 static int _dealloc(void* __restrict ctxbuf, void* __restrict pipe, int error, int purge)
 {
-	(void)error;
-	(void)pipe;
-
 	_module_context_t* ctx = (_module_context_t*)ctxbuf;
+	_handle_t* handle = (_handle_t*)pipe;
+	_dispatch_t* dispatch = handle->dispatch;
+
+	/* Remember where the input side stops, so that we know if there's any unread data */
+	if(!handle->output && !handle->forked)
+		dispatch->end = handle->offset;
 
 	if(purge)
 	{
+		runtime_api_pipe_flags_t flags = itc_module_get_handle_flags(pipe);
+
+		/* The persistent event with the unread bytes will be dispatched again, which simulates the
+		 * pipelined requests on a kept-alive connection */
+		int requeue = ((flags & RUNTIME_API_PIPE_PERSIST) && !error &&
+		               dispatch->end > dispatch->begin && dispatch->end < dispatch->event->size);
+
+		if(requeue)
+		{
+			dispatch->begin = dispatch->end;
+			dispatch->seq ++;
+			dispatch->output = NULL;
+			dispatch->next = NULL;
+			(void)__sync_fetch_and_add(&ctx->remaining, 1);
+		}
+
+		if((errno = pthread_mutex_lock(&ctx->mutex)) != 0)
+			ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the ready queue mutex");
+
+		if(requeue)
+		{
+			if(NULL == ctx->ready_tail)
+				ctx->ready_head = dispatch;
+			else
+				ctx->ready_tail->next = dispatch;
+			ctx->ready_tail = dispatch;
+		}
+
+		ctx->inflight --;
+
+		if((errno = pthread_cond_signal(&ctx->cond)) != 0)
+			LOG_WARNING_ERRNO("Cannot notify the event loop");
+
+		if((errno = pthread_mutex_unlock(&ctx->mutex)) != 0)
+			ERROR_RETURN_LOG_ERRNO(int, "Cannot release the ready queue mutex");
+
+		if(!requeue) free(dispatch);
+
 		uint32_t value;
 		do{
 			value = ctx->remaining;
@@ -461,6 +682,7 @@ static size_t _read(void* __restrict ctxbuf, void* __restrict buffer, size_t nby
 	memcpy(buffer, handle->event->data + handle->offset, bytes_to_read);
 
 	handle->offset += bytes_to_read;
+	handle->last_read = bytes_to_read;
 
 	return bytes_to_read;
 }
@@ -491,17 +713,38 @@ static int _get_internal_buf(void* __restrict ctx, void const** __restrict resul
 	*max_size = *min_size = bytes_to_read;
 
 	handle->offset += bytes_to_read;
+	handle->last_read = 0;
 
 	return 1;
 }
 
-static int _release_internal_buf(void* __restrict context, void const* __restrict buffer, size_t actual_size, void* __restrict handle)
+static int _release_internal_buf(void* __restrict context, void const* __restrict buffer, size_t actual_size, void* __restrict pipe)
+{
+	(void)context;
+	_handle_t* handle = (_handle_t*)pipe;
+	const char* begin = (const char*)buffer;
+
+	if(begin < handle->event->data || begin + actual_size > handle->event->data + handle->offset)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	/* The bytes after the actual size are not consumed, so they should be read again */
+	handle->offset = (size_t)(begin - handle->event->data) + actual_size;
+
+	return 0;
+}
+
+static int _eom(void* __restrict context, void* __restrict pipe, const char* buffer, size_t offset)
 {
-	/* Since in any case we are returning determined-length memory regions, so just do nothing here */
 	(void)context;
 	(void)buffer;
-	(void)actual_size;
-	(void)handle;
+	_handle_t* handle = (_handle_t*)pipe;
+
+	if(handle->output || offset > handle->last_read)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	handle->offset -= handle->last_read - offset;
+	handle->last_read = 0;
+
 	return 0;
 }
 
@@ -511,25 +754,30 @@ static size_t _write(void* __restrict ctx, const void* __restrict buffer, size_t
 	_handle_t* handle = (_handle_t*)pipe;
 	if(handle->output == 0) ERROR_RETURN_LOG(size_t, "Invalid pipe type: output side expected");
 
-	if(handle->event->outbuf == NULL)
+	_output_t* output = handle->dispatch->output;
+
+	/* The replayed events do not keep any output */
+	if(NULL == output) return nbytes;
+
+	if(output->outbuf == NULL)
 	{
-		if(NULL == (handle->event->outbuf = (char*)malloc(handle->event->outcap = (nbytes < 128 ? nbytes * 2 : 256))))
+		if(NULL == (output->outbuf = (char*)malloc(output->outcap = (nbytes < 128 ? nbytes * 2 : 256))))
 			ERROR_RETURN_LOG_ERRNO(size_t, "Cannot allocate the buffer for the output");
-		handle->event->outsize = 0;
+		output->outsize = 0;
 	}
 
-	size_t bufsize = handle->event->outcap;
-	for(;bufsize < handle->event->outsize + nbytes; bufsize *= 2);
-	if(bufsize != handle->event->outcap)
+	size_t bufsize = output->outcap;
+	for(;bufsize < output->outsize + nbytes; bufsize *= 2);
+	if(bufsize != output->outcap)
 	{
-		char* new_buf = (char*)realloc(handle->event->outbuf, bufsize);
+		char* new_buf = (char*)realloc(output->outbuf, bufsize);
 		if(NULL == new_buf) ERROR_RETURN_LOG_ERRNO(size_t, "Cannot allocate memory for the bytes to write");
-		handle->event->outbuf = new_buf;
-		handle->event->outcap = bufsize;
+		output->outbuf = new_buf;
+		output->outcap = bufsize;
 	}
 
-	memcpy(handle->event->outbuf + handle->event->outsize, buffer, nbytes);
-	handle->event->outsize += nbytes;
+	memcpy(output->outbuf + output->outsize, buffer, nbytes);
+	output->outsize += nbytes;
 
 	return nbytes;
 }
@@ -542,8 +790,11 @@ static int _fork(void* __restrict ctx, void* __restrict dest, void* __restrict s
 	_handle_t* sh = (_handle_t*)src;
 
 	dh->output = 0;
+	dh->forked = 1;
 	dh->event = sh->event;
-	dh->offset = 0;
+	dh->dispatch = sh->dispatch;
+	dh->offset = sh->dispatch->begin;
+	dh->last_read = 0;
 
 	return 0;
 }
@@ -563,7 +814,9 @@ static itc_module_flags_t _get_flags(void* __restrict ctx)
 	_module_context_t* context = (_module_context_t*)ctx;
 	itc_module_flags_t flags = ITC_MODULE_FLAGS_EVENT_LOOP;
 
-	if(context->next_event == NULL) flags |= ITC_MODULE_FLAGS_EVENT_EXHUASTED;
+	if(context->next_event == NULL && context->round + 1 >= context->repeat &&
+	   context->ready_head == NULL && context->inflight == 0)
+		flags |= ITC_MODULE_FLAGS_EVENT_EXHUASTED;
 
 	return flags;
 }
@@ -587,6 +840,12 @@ static int  _cntl(void* __restrict context, void* __restrict pipe, uint32_t opco
 	}
 }
 
+static void _event_loop_killed(void* __restrict ctx)
+{
+	_module_context_t* context = (_module_context_t*)ctx;
+	context->killed = 1;
+}
+
 static int _set_prop(void* __restrict ctx, const char* sym, itc_module_property_value_t value)
 {
 	_module_context_t* context = (_module_context_t*)ctx;
@@ -648,6 +907,8 @@ itc_module_t module_simulate_module_def = {
 	.set_property    = _set_prop,
 	.get_property    = _get_prop,
 	.cntl            = _cntl,
+	.eom             = _eom,
+	.event_thread_killed = _event_loop_killed,
 	.get_internal_buf = _get_internal_buf,
 	.release_internal_buf = _release_internal_buf
 };
@@ -22,6 +22,12 @@
 #include <utils/mempool/page.h>
 #include <os/os.h>
 
+#include <sys/uio.h>
+
+#ifdef __LINUX__
+#	include <sys/sendfile.h>
+#endif
+
 #include <itc/module_types.h>
 #include <module/tcp/async.h>
 
@@ -111,6 +117,10 @@ typedef struct {
 	itc_module_data_source_event_t             data_event;    /*!< The data source event description */
 	int                                        data_end;      /*!< indicates if there's no more data ready events */
 	module_tcp_async_write_data_func_t         get_data;      /*!< the data source callback */
+	module_tcp_async_write_region_func_t       get_region;    /*!< the zero-copy data source callback, NULL if not supported */
+	module_tcp_async_write_iov_func_t          get_iov;       /*!< the scatter-gather data source callback, NULL if not supported */
+	module_tcp_async_write_consume_func_t      consume;       /*!< the callback used to consume the bytes exposed by get_iov */
+	itc_module_data_source_region_t            region;        /*!< the file region that is being written with zero-copy system call */
 	module_tcp_async_write_cleanup_func_t      cleanup;       /*!< the cleanup callback */
 	module_tcp_async_write_error_func_t        onerror;       /*!< the error handler */
 	module_tcp_async_write_empty_func_t        empty;         /*!< The callback function used to check if the handle is empty (No pending bytes to write) */
@@ -193,6 +203,9 @@ struct _module_tcp_async_loop_t {
 	time_t          data_ttl;  /*!< The maximum time for a data source in the wait state */
 	/* mocked system calls */
 	ssize_t (*write)(int fd, const void* ptr, size_t sz);  /*!< the mocked write system call, only used for testing purpose */
+
+	/* statistics */
+	module_tcp_async_stat_t stat;  /*!< the statistics, only modified by the loop thread */
 };
 
 /**
@@ -414,6 +427,124 @@ static inline _async_obj_state_t _io_ops(module_tcp_async_loop_t* loop, _async_o
 {
 	if(obj->b_end == obj->b_begin) obj->b_begin = obj->b_end = 0;
 
+#ifdef __LINUX__
+	/* We can only take the zero-copy path when all the buffered bytes have been written, otherwise the order of the
+	 * data is broken. Also when the write function is mocked, we should use the normal IO path */
+	if(obj->b_end == 0 && obj->region.size == 0 && NULL != obj->get_region && NULL == loop->write)
+	{
+		int rc = obj->get_region(_async_obj_conn_id(loop, obj), &obj->region, loop);
+		if(ERROR_CODE(int) == rc)
+		{
+			LOG_ERROR("the region function returns an error code, "
+			          "set the async object %"PRIu32" state to ERROR",
+			          _async_obj_conn_id(loop, obj));
+			return _ST_RAISING;
+		}
+
+		if(rc == 0) obj->region.size = 0;
+		else LOG_DEBUG("Connection object %"PRIu32": got a file region of %zu bytes", _async_obj_conn_id(loop, obj), obj->region.size);
+	}
+
+	if(obj->region.size > 0)
+	{
+		off_t offset = (off_t)obj->region.offset;
+		ssize_t rc = sendfile(obj->fd, obj->region.fd, &offset, obj->region.size);
+		loop->stat.num_syscalls ++;
+
+		if(rc < 0)
+		{
+			if(errno == EWOULDBLOCK || errno == EAGAIN)
+			{
+				LOG_DEBUG("connection object %"PRIu32" is busy, "
+				          "update the state to WAIT_FOR_CONNECTION",
+				          _async_obj_conn_id(loop, obj));
+				obj->wait_conn = 1;
+				return _ST_WAIT;
+			}
+
+			LOG_ERROR_ERRNO("connection object %"PRIu32" has a sendfile failure, "
+			                "update the state to ERROR",
+			                _async_obj_conn_id(loop, obj));
+			return _ST_RAISING;
+		}
+
+		if(rc == 0)
+		{
+			/* The file has been truncated, and we are not able to send the promised bytes any more */
+			LOG_ERROR("connection object %"PRIu32" has an unexpected end of file region, "
+			          "update the state to ERROR",
+			          _async_obj_conn_id(loop, obj));
+			return _ST_RAISING;
+		}
+
+		LOG_DEBUG("%zd bytes has been sent to the connection object %"PRIu32" with sendfile", rc, _async_obj_conn_id(loop, obj));
+		loop->stat.num_bytes += (uint64_t)rc;
+		obj->region.offset += (uint64_t)rc;
+		obj->region.size -= (size_t)rc;
+
+		return _ST_READY;
+	}
+#endif
+
+	/* Then try to write the pending bytes without copying them to the IO buffer. But if the pending bytes fit into
+	 * the IO buffer, we still use the copy path, since it's able to merge the bytes with the following data source
+	 * in a single write call */
+	if(obj->b_end == 0 && NULL != obj->get_iov && NULL == loop->write)
+	{
+		struct iovec iov[MODULE_TCP_ASYNC_MAX_IOV];
+		uint32_t iovcnt = obj->get_iov(_async_obj_conn_id(loop, obj), iov, MODULE_TCP_ASYNC_MAX_IOV, loop);
+		size_t iovsize = 0;
+		uint32_t i;
+
+		if(ERROR_CODE(uint32_t) == iovcnt)
+		{
+			LOG_ERROR("the IO vector function returns an error code, "
+			          "set the async object %"PRIu32" state to ERROR",
+			          _async_obj_conn_id(loop, obj));
+			return _ST_RAISING;
+		}
+
+		for(i = 0; i < iovcnt && iovsize <= obj->b_size; i ++)
+			iovsize += iov[i].iov_len;
+
+		if(iovsize > obj->b_size)
+		{
+			ssize_t rc = writev(obj->fd, iov, (int)iovcnt);
+			loop->stat.num_syscalls ++;
+
+			if(rc < 0)
+			{
+				if(errno == EWOULDBLOCK || errno == EAGAIN)
+				{
+					LOG_DEBUG("connection object %"PRIu32" is busy, "
+					          "update the state to WAIT_FOR_CONNECTION",
+					          _async_obj_conn_id(loop, obj));
+					obj->wait_conn = 1;
+					return _ST_WAIT;
+				}
+
+				LOG_ERROR_ERRNO("connection object %"PRIu32" has a writev failure, "
+				                "update the state to ERROR",
+				                _async_obj_conn_id(loop, obj));
+				return _ST_RAISING;
+			}
+
+			LOG_DEBUG("%zd bytes in %"PRIu32" IO vectors has been written to the connection object %"PRIu32,
+			          rc, iovcnt, _async_obj_conn_id(loop, obj));
+			loop->stat.num_bytes += (uint64_t)rc;
+
+			if(ERROR_CODE(int) == obj->consume(_async_obj_conn_id(loop, obj), (size_t)rc, loop))
+			{
+				LOG_ERROR("the consume function returns an error code, "
+				          "set the async object %"PRIu32" state to ERROR",
+				          _async_obj_conn_id(loop, obj));
+				return _ST_RAISING;
+			}
+
+			return _ST_READY;
+		}
+	}
+
 	/* before we perform the actual data operation, we want to maximize the number of bytes passed to the system call */
 	if(obj->b_end < obj->b_size)
 	{
@@ -472,6 +603,7 @@ L_WAIT_DATA:
 	ssize_t rc = loop->write == NULL ?
 	             write(obj->fd, obj->io_buffer + obj->b_begin, obj->b_end - obj->b_begin):
 	             loop->write(obj->fd, obj->io_buffer + obj->b_begin, obj->b_end - obj->b_begin);
+	loop->stat.num_syscalls ++;
 
 	if(-1 == rc || rc == 0)
 	{
@@ -496,6 +628,7 @@ L_WAIT_DATA:
 	{
 		LOG_DEBUG("%zd bytes has been written to the connection object %"PRIu32, rc, _async_obj_conn_id(loop, obj));
 		obj->b_begin += (uint32_t)rc;
+		loop->stat.num_bytes += (uint64_t)rc;
 	}
 
 	return _ST_READY;
@@ -681,6 +814,8 @@ static inline int _process_async_objs(module_tcp_async_loop_t* loop)
 		this->index = ERROR_CODE(uint32_t);
 
 		if(!this->data_end) LOG_ERROR("a finished async object without data_end flag, code bug!");
+
+		loop->stat.num_finished ++;
 		BARRIER();
 		/* Make sure cleanup call back will be called in the last. Because cleanup callback will release
 		 * the connection object, which means it's possible to re-register the callback function back once
@@ -1121,12 +1256,16 @@ ERR:
 int module_tcp_async_write_register(module_tcp_async_loop_t* loop,
                                     uint32_t conn_id, int fd, size_t buf_size,
                                     module_tcp_async_write_data_func_t get_data,
+                                    module_tcp_async_write_region_func_t get_region,
+                                    module_tcp_async_write_iov_func_t get_iov,
+                                    module_tcp_async_write_consume_func_t consume,
                                     module_tcp_async_write_empty_func_t empty,
                                     module_tcp_async_write_cleanup_func_t cleanup,
                                     module_tcp_async_write_error_func_t on_error,
                                     void* handle)
 {
-	if(NULL == loop || conn_id >= loop->capacity || fd < 0 || get_data == NULL || cleanup == NULL || on_error == NULL || handle == NULL || empty == NULL)
+	if(NULL == loop || conn_id >= loop->capacity || fd < 0 || get_data == NULL || cleanup == NULL || on_error == NULL || handle == NULL || empty == NULL ||
+	   (get_iov != NULL && consume == NULL))
 		ERROR_RETURN_LOG(int, "Invalid arguments");
 
 	if(loop->objects[conn_id].index != ERROR_CODE(uint32_t))
@@ -1137,6 +1276,10 @@ int module_tcp_async_write_register(module_tcp_async_loop_t* loop,
 	 * connection, since for each async write operation, data_end must be the last queue message */
 	loop->objects[conn_id].fd = fd;
 	loop->objects[conn_id].get_data = get_data;
+	loop->objects[conn_id].get_region = get_region;
+	loop->objects[conn_id].get_iov = get_iov;
+	loop->objects[conn_id].consume = consume;
+	loop->objects[conn_id].region.size = 0;
 	loop->objects[conn_id].cleanup = cleanup;
 	loop->objects[conn_id].onerror = on_error;
 	loop->objects[conn_id].empty = empty;
@@ -1353,3 +1496,13 @@ int module_tcp_async_clear_data_event(module_tcp_async_loop_t* loop, uint32_t co
 
 	return 0;
 }
+
+int module_tcp_async_get_stat(const module_tcp_async_loop_t* loop, module_tcp_async_stat_t* buf)
+{
+	if(NULL == loop || NULL == buf)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	*buf = loop->stat;
+
+	return 0;
+}
@@ -13,6 +13,7 @@
 #include <inttypes.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <sys/uio.h>
 
 #include <barrier.h>
 #include <error.h>
@@ -25,8 +26,14 @@
 #include <itc/module_types.h>
 #include <itc/module.h>
 #include <itc/modtab.h>
+#include <os/os.h>
+
+#ifdef __LINUX__
+#	include <sys/sendfile.h>
+#endif
 
 #include <module/tcp/module.h>
+#include <module/tcp/api.h>
 #include <module/tcp/pool.h>
 #include <module/tcp/async.h>
 
@@ -59,6 +66,7 @@ typedef struct {
 	void*                           user_space_data;        /*!< the user space data attached to this connection pool object */
 	uint32_t                        buffer_exposed:1;       /*!< Indicates if we have a buffer exposed */
 	uint32_t                        user_state_pending:1;   /*!< indicates if we have user space data pending to push */
+	uint32_t                        redeliver:1;            /*!< indicates the connection should be ready to read once it's released */
 	itc_module_state_dispose_func_t disp;                   /*!< the dispose function for the case the connection object must be killed */
 	uintpad_t __padding__[0];
 	char                            buffer[0];              /*!< the read buffer */
@@ -83,6 +91,16 @@ typedef struct _async_buf_page_t {
 STATIC_ASSERTION_LAST(_async_buf_page_t, data);
 STATIC_ASSERTION_SIZE(_async_buf_page_t, data, 0);
 
+/**
+ * @brief the data source that wraps the remaining file region of another data source
+ * @details This is used when a part of the region has been sent synchronizely, and the remaining bytes should
+ *          be written by the async loop
+ **/
+typedef struct {
+	itc_module_data_source_t        source;   /*!< the original data source, which owns the file descriptor */
+	itc_module_data_source_region_t region;   /*!< the remaining region */
+} _region_source_t;
+
 /**
  * @brief the previous declearation for a pipe handle
  **/
@@ -150,6 +168,9 @@ static mempool_objpool_t* _async_handle_pool = NULL;
 /** @brief the memory pool used to allocate the async page object which represents a data source object */
 static mempool_objpool_t* _async_data_source_pool = NULL;
 
+/** @brief the memory pool used to allocate the data source that wraps a file region */
+static mempool_objpool_t* _region_source_pool = NULL;
+
 /** @brief the counter indicates how many instances is initialized */
 static uint32_t _instance_count = 0;
 
@@ -289,6 +310,42 @@ static inline int _async_buf_page_free(_async_buf_page_t* page)
 		return mempool_page_dealloc(page);
 }
 
+/**
+ * @brief dispose the first page of the async handle, which has been exhausted
+ * @note this function should be called with the async handle mutex held
+ * @param handle the async handle
+ * @param conn the connection id
+ * @param loop the async loop
+ * @return nothing
+ **/
+static inline void _async_handle_page_exhausted(_async_handle_t* handle, uint32_t conn, module_tcp_async_loop_t* loop)
+{
+	/* We should try to reuse the page, however, if the page is either the non-last one, or callback page,
+	 * we will not be able to reuse it */
+	if(handle->page_begin->next != NULL || _async_buf_page_is_data_source(handle->page_begin))
+	{
+		/* because this is not the last page, so we can not reuse the page */
+		_async_buf_page_t* tmp = handle->page_begin;
+
+		handle->page_off = 0;
+		handle->page_begin = handle->page_begin->next;
+		if(ERROR_CODE(int) == module_tcp_async_clear_data_event(loop, conn))
+			LOG_WARNING("Cannot clear the data event");
+		if(ERROR_CODE(int) == _async_buf_page_free(tmp))
+			LOG_WARNING("Cannot deallocate the async buffer page");
+
+		if(handle->page_end == tmp) handle->page_end = NULL;
+
+		LOG_DEBUG("data page disposed");
+	}
+	else
+	{
+		handle->page_off = 0;
+		handle->page_begin->nbytes = 0;
+		LOG_DEBUG("reused the last data page");
+	}
+}
+
 /**
  * @brief the data source callback for the async handle
  * @param conn the connection id
@@ -314,6 +371,14 @@ static inline size_t _async_handle_getdata(uint32_t conn, void* data, size_t siz
 	{
 		if(_async_buf_page_is_data_source(handle->page_begin))
 		{
+			/* If the data source is able to expose a file region, stop here and let the async loop flush the buffered
+			 * bytes, so that the data source can be handed off with _async_handle_getregion later */
+			if(ret > 0 && NULL != handle->page_begin->data_source->region)
+			{
+				LOG_DEBUG("The next page is a zero-copy capable data source, flush the buffer first");
+				break;
+			}
+
 			int eos_rc = handle->page_begin->data_source->eos(handle->page_begin->data_source->data_handle);
 
 			if(ERROR_CODE(int) == eos_rc)
@@ -395,36 +460,144 @@ static inline size_t _async_handle_getdata(uint32_t conn, void* data, size_t siz
 		continue;
 
 PAGE_EXHAUSTED:
-		/* We should try to reuse the page, however, if the page is either the non-last one, or callback page,
-		 * we will not be able to reuse it */
-		if(handle->page_begin->next != NULL || _async_buf_page_is_data_source(handle->page_begin))
+		_async_handle_page_exhausted(handle, conn, loop);
+	}
+
+	if((errno = pthread_mutex_unlock(handle->mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(size_t, "cannot acquire the async handle mutex");
+
+	return ret;
+}
+
+/**
+ * @brief the scatter-gather data source callback for the async handle
+ * @details This function exposes the buffered data pages as IO vectors, until the first data source page.
+ *          Although the pages are accessed by the async loop without holding the mutex, this is still safe,
+ *          because the worker thread only appends bytes after the nbytes of the last page and only the async
+ *          loop thread is allowed to dispose the pages.
+ * @param conn the connection id
+ * @param iov the IO vector buffer
+ * @param iovcnt the size of the IO vector buffer
+ * @param loop the async loop called this function
+ * @return the number of IO vectors or error code
+ **/
+static inline uint32_t _async_handle_getiov(uint32_t conn, struct iovec* iov, uint32_t iovcnt, module_tcp_async_loop_t* loop)
+{
+	_async_handle_t* handle = (_async_handle_t*)module_tcp_async_get_data_handle(loop, conn);
+
+	if(NULL == handle)
+		ERROR_RETURN_LOG_ERRNO(uint32_t, "cannot get the data handle for connection object %"PRIu32, conn);
+
+	uint32_t ret = 0;
+
+	if((errno = pthread_mutex_lock(handle->mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(uint32_t, "cannot acquire the async handle mutex");
+
+	_async_buf_page_t* page;
+	uint32_t off = handle->page_off;
+
+	for(page = handle->page_begin; NULL != page && ret < iovcnt && !_async_buf_page_is_data_source(page); page = page->next, off = 0)
+	{
+		if(page->nbytes <= off) continue;
+
+		iov[ret].iov_base = page->data + off;
+		iov[ret].iov_len  = page->nbytes - off;
+		ret ++;
+	}
+
+	if((errno = pthread_mutex_unlock(handle->mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(uint32_t, "cannot release the async handle mutex");
+
+	return ret;
+}
+
+/**
+ * @brief consume the bytes that has been exposed by _async_handle_getiov
+ * @param conn the connection id
+ * @param nbytes the number of bytes has been written
+ * @param loop the async loop called this function
+ * @return status code
+ **/
+static inline int _async_handle_consume(uint32_t conn, size_t nbytes, module_tcp_async_loop_t* loop)
+{
+	_async_handle_t* handle = (_async_handle_t*)module_tcp_async_get_data_handle(loop, conn);
+
+	if(NULL == handle)
+		ERROR_RETURN_LOG_ERRNO(int, "cannot get the data handle for connection object %"PRIu32, conn);
+
+	int rc = 0;
+
+	if((errno = pthread_mutex_lock(handle->mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "cannot acquire the async handle mutex");
+
+	while(nbytes > 0)
+	{
+		if(NULL == handle->page_begin || _async_buf_page_is_data_source(handle->page_begin))
 		{
-			/* because this is not the last page, so we can not reuse the page */
-			_async_buf_page_t* tmp = handle->page_begin;
+			LOG_ERROR("The async loop has consumed more bytes than the exposed IO vectors, code bug!");
+			rc = ERROR_CODE(int);
+			break;
+		}
 
-			handle->page_off = 0;
-			handle->page_begin = handle->page_begin->next;
-			if(ERROR_CODE(int) == module_tcp_async_clear_data_event(loop, conn))
-				LOG_WARNING("Cannot clear the data event");
-			if(ERROR_CODE(int) == _async_buf_page_free(tmp))
-				LOG_WARNING("Cannot deallocate the async buffer page");
+		uint32_t avail = handle->page_begin->nbytes - handle->page_off;
+		if(avail > nbytes) avail = (uint32_t)nbytes;
 
-			if(handle->page_end == tmp) handle->page_end = NULL;
+		handle->page_off += avail;
+		nbytes -= avail;
 
-			LOG_DEBUG("data page disposed");
+		if(handle->page_off >= handle->page_begin->nbytes)
+		{
+			/* The last page is only reset when it's exhausted, thus we are done */
+			int last = (handle->page_begin->next == NULL);
+			_async_handle_page_exhausted(handle, conn, loop);
+			if(last) break;
 		}
-		else
+	}
+
+	if((errno = pthread_mutex_unlock(handle->mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "cannot release the async handle mutex");
+
+	return rc;
+}
+
+/**
+ * @brief the zero-copy data source callback for the async handle
+ * @param conn the connection id
+ * @param region_buf the buffer used to return the file region
+ * @param loop the async loop called this function
+ * @return 1 if the region is returned, 0 if the data should be read with _async_handle_getdata, or error code
+ **/
+static inline int _async_handle_getregion(uint32_t conn, itc_module_data_source_region_t* region_buf, module_tcp_async_loop_t* loop)
+{
+	_async_handle_t* handle = (_async_handle_t*)module_tcp_async_get_data_handle(loop, conn);
+
+	if(NULL == handle)
+		ERROR_RETURN_LOG_ERRNO(int, "cannot get the data handle for connection object %"PRIu32, conn);
+
+	int rc = 0;
+
+	if((errno = pthread_mutex_lock(handle->mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "cannot acquire the async handle mutex");
+
+	_async_buf_page_t* page = handle->page_begin;
+
+	/* We only take the region from the first page, and we let _async_handle_getdata dispose the exhausted data source,
+	 * which also guarentees the file descriptor is valid until the region is completely written */
+	if(NULL != page && _async_buf_page_is_data_source(page) && NULL != page->data_source->region)
+	{
+		int eos_rc = page->data_source->eos(page->data_source->data_handle);
+
+		if(eos_rc == 0 && ERROR_CODE(int) == (rc = page->data_source->region(page->data_source->data_handle, region_buf)))
 		{
-			handle->page_off = 0;
-			handle->page_begin->nbytes = 0;
-			LOG_DEBUG("reused the last data page");
+			LOG_WARNING("The data source region call returns an error, fallback to the read call");
+			rc = 0;
 		}
 	}
 
 	if((errno = pthread_mutex_unlock(handle->mutex)) != 0)
-		ERROR_RETURN_LOG_ERRNO(size_t, "cannot acquire the async handle mutex");
+		ERROR_RETURN_LOG_ERRNO(int, "cannot release the async handle mutex");
 
-	return ret;
+	return rc;
 }
 
 /**
@@ -548,6 +721,12 @@ static int _cleanup(void* __restrict ctx)
 			LOG_ERROR("Cannot dispose the async data source object pool");
 			rc = ERROR_CODE(int);
 		}
+
+		if(NULL != _region_source_pool && ERROR_CODE(int) == mempool_objpool_free(_region_source_pool))
+		{
+			LOG_ERROR("Cannot dispose the region data source object pool");
+			rc = ERROR_CODE(int);
+		}
 	}
 
 	if(context->async_loop != NULL && module_tcp_async_loop_free(context->async_loop) == ERROR_CODE(int))
@@ -596,6 +775,9 @@ static inline int _module_context_init(_module_context_t* ctx, _module_context_t
 		if(NULL == (_async_data_source_pool = mempool_objpool_new(sizeof(_async_buf_page_t) + sizeof(itc_module_data_source_t))))
 			ERROR_RETURN_LOG(int, "Cannot create async data source object pool");
 
+		if(NULL == (_region_source_pool = mempool_objpool_new(sizeof(_region_source_t))))
+			ERROR_RETURN_LOG(int, "Cannot create region data source object pool");
+
 		int pagesize = getpagesize();
 		if(pagesize < 0) ERROR_RETURN_LOG_ERRNO(int, "Cannot get page size");
 
@@ -653,6 +835,7 @@ static int _init(void* __restrict ctx, uint32_t argc, char const* __restrict con
 	context->pool_conf.min_timeout  = 1;
 	context->pool_conf.tcp_backlog  = 512;
 	context->pool_conf.reuseaddr    = 0;
+	context->pool_conf.reuseport    = MODULE_TCP_POOL_REUSEPORT_NONE;
 	context->pool_conf.ipv6         = 0;
 	context->pool_conf.accept_retry_interval = 5;
 	context->pool_conf.dispose_data = _dispose_state;
@@ -758,6 +941,7 @@ static int _accept(void* __restrict ctx, const void* __restrict args, void* __re
 	in->has_more = 1;
 	stat->user_state_pending = 0;
 	stat->buffer_exposed = 0;
+	stat->redeliver = 0;
 	in->fd = out->fd = conn.fd;
 	in->idx = out->idx = conn.idx;
 	in->async_handle = out->async_handle = NULL;
@@ -955,7 +1139,8 @@ static inline int _create_async_handle(_module_context_t* context, _handle_t* ha
 		ERROR_RETURN_LOG(int, "cannot create async handle for the async object");
 
 	if(module_tcp_async_write_register(context->async_loop, handle->idx, handle->fd, context->async_buf_size,
-	                                   _async_handle_getdata, _async_handle_empty, _async_handle_dispose,
+	                                   _async_handle_getdata, _async_handle_getregion, _async_handle_getiov, _async_handle_consume,
+	                                   _async_handle_empty, _async_handle_dispose,
 	                                   _async_handle_onerror, handle->async_handle) == ERROR_CODE(int))
 	{
 		mempool_objpool_dealloc(_async_handle_pool, handle->async_handle);
@@ -1057,6 +1242,154 @@ static inline size_t _ensure_async_handle(_module_context_t* context, _handle_t*
 	else return 0;
 }
 
+#ifdef __LINUX__
+/**
+ * @brief send the bytes in the file region to the socket with the zero-copy system call
+ * @param fd the socket FD
+ * @param region the region to send, which will be updated to the remaining region
+ * @return the number of bytes has been sent, 0 if the socket is busy, or error code
+ **/
+static inline size_t _sendfile(int fd, itc_module_data_source_region_t* region)
+{
+	off_t offset = (off_t)region->offset;
+	ssize_t rc = sendfile(fd, region->fd, &offset, region->size);
+
+	if(rc < 0)
+	{
+		if(errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+		ERROR_RETURN_LOG_ERRNO(size_t, "Cannot send the file region to the socket");
+	}
+
+	if(rc == 0 && region->size > 0)
+		ERROR_RETURN_LOG(size_t, "Unexpected end of the file region");
+
+	region->offset += (uint64_t)rc;
+	region->size -= (size_t)rc;
+
+	return (size_t)rc;
+}
+
+/**
+ * @brief the read callback of the region data source, which is used only when the zero-copy is not possible
+ * @param handle the region data source
+ * @param buffer the result buffer
+ * @param count the size of the buffer
+ * @param event_buf the event buffer
+ * @return the number of bytes has been read or error code
+ **/
+static size_t _region_source_read(void* __restrict handle, void* __restrict buffer, size_t count, itc_module_data_source_event_t* event_buf)
+{
+	(void)event_buf;
+	_region_source_t* rs = (_region_source_t*)handle;
+
+	if(count > rs->region.size) count = rs->region.size;
+
+	ssize_t rc = pread(rs->region.fd, buffer, count, (off_t)rs->region.offset);
+
+	if(rc < 0)
+		ERROR_RETURN_LOG_ERRNO(size_t, "Cannot read the file region");
+
+	rs->region.offset += (uint64_t)rc;
+	rs->region.size -= (size_t)rc;
+
+	return (size_t)rc;
+}
+
+/**
+ * @brief the end-of-stream callback of the region data source
+ * @param handle the region data source
+ * @return the check result
+ **/
+static int _region_source_eos(const void* __restrict handle)
+{
+	return ((const _region_source_t*)handle)->region.size == 0;
+}
+
+/**
+ * @brief the region callback of the region data source
+ * @param handle the region data source
+ * @param region_buf the result buffer
+ * @return 1 since the region is always available
+ **/
+static int _region_source_region(void* __restrict handle, itc_module_data_source_region_t* region_buf)
+{
+	_region_source_t* rs = (_region_source_t*)handle;
+
+	*region_buf = rs->region;
+	rs->region.size = 0;
+
+	return 1;
+}
+
+/**
+ * @brief close the region data source and the data source it wraps
+ * @param handle the region data source
+ * @return status code
+ **/
+static int _region_source_close(void* __restrict handle)
+{
+	_region_source_t* rs = (_region_source_t*)handle;
+
+	int rc = rs->source.close(rs->source.data_handle);
+
+	if(ERROR_CODE(int) == mempool_objpool_dealloc(_region_source_pool, rs))
+		ERROR_RETURN_LOG(int, "Cannot deallocate the region data source");
+
+	return rc;
+}
+
+/**
+ * @brief try to write the data source with the zero-copy system call synchronizely
+ * @details If the data source is able to expose a file region, we send the region until the socket is busy, and
+ *          the remaining bytes will be wrapped as a new data source, which also support zero-copy. <br/>
+ *          This is only possible when there's no pending async write, otherwise the byte order is broken
+ * @param fd the socket FD
+ * @param data_source the data source, which will be replaced by the wrapper if there are remaining bytes
+ * @return 1 if the data source has been written completely and closed, 0 if there are remaining bytes, error code on error
+ **/
+static inline int _write_region_sync(int fd, itc_module_data_source_t* data_source)
+{
+	itc_module_data_source_region_t region;
+	int rc;
+
+	if(NULL == data_source->region || (rc = data_source->region(data_source->data_handle, &region)) == 0)
+		return 0;
+
+	if(ERROR_CODE(int) == rc)
+		ERROR_RETURN_LOG(int, "The data source region call returns an error");
+
+	size_t bytes_sent;
+	while(region.size > 0 && (bytes_sent = _sendfile(fd, &region)) > 0)
+		if(ERROR_CODE(size_t) == bytes_sent)
+			ERROR_RETURN_LOG(int, "Cannot send the file region");
+
+	if(region.size == 0)
+	{
+		LOG_DEBUG("The file region has been sent synchronizely");
+		if(ERROR_CODE(int) == data_source->close(data_source->data_handle))
+			ERROR_RETURN_LOG(int, "Cannot close the data source");
+		return 1;
+	}
+
+	_region_source_t* rs = (_region_source_t*)mempool_objpool_alloc(_region_source_pool);
+	if(NULL == rs)
+		ERROR_RETURN_LOG(int, "Cannot allocate memory for the region data source");
+
+	rs->source = *data_source;
+	rs->region = region;
+
+	data_source->data_handle = rs;
+	data_source->read = _region_source_read;
+	data_source->eos = _region_source_eos;
+	data_source->region = _region_source_region;
+	data_source->close = _region_source_close;
+
+	LOG_DEBUG("The socket is busy, %zu bytes of the file region is left to the async loop", region.size);
+
+	return 0;
+}
+#endif
+
 static int _write_callback(void* __restrict ctx, itc_module_data_source_t data_source, void* __restrict out)
 {
 	if(NULL == ctx || NULL == out)
@@ -1089,6 +1422,26 @@ static int _write_callback(void* __restrict ctx, itc_module_data_source_t data_s
 		size_t sync_data_size = 0; /* How many bytes in the sync_data buffer */
 		const int8_t* sync_data = NULL; /* The pointer for the start address of buffer that haven't been written */
 
+#ifdef __LINUX__
+		if(handle->async_handle == NULL && context->sync_write_attempt)
+		{
+			int region_rc = _write_region_sync(handle->fd, &data_source);
+			if(ERROR_CODE(int) == region_rc)
+				ERROR_RETURN_LOG(int, "Cannot write the data source with zero-copy");
+
+			if(region_rc == 1) return 0;
+
+			/* If the data source is a region, the socket is busy at this point. So we should go async directly */
+			if(data_source.region == _region_source_region && ERROR_CODE(size_t) == _ensure_async_handle(context, handle, NULL, 0, 1))
+			{
+				LOG_ERROR("Cannot create async handle for the pipe");
+				/* Because we have replaced the data source, so we have taken the ownership */
+				data_source.close(data_source.data_handle);
+				return ERROR_CODE_OT(int);
+			}
+		}
+#endif
+
 		/* Actually we want to write the bytes synchronizely until the scoket is not able to accept more */
 		for(;handle->async_handle == NULL && eos_rc != 1;)
 		{
@@ -1199,6 +1552,17 @@ ASYNC_RET:
 	else
 	{
 		LOG_DEBUG("Sync write_callback called");
+#ifdef __LINUX__
+		itc_module_data_source_region_t region;
+		int region_rc = NULL == data_source.region ? 0 : data_source.region(data_source.data_handle, &region);
+
+		if(ERROR_CODE(int) == region_rc)
+			ERROR_RETURN_LOG(int, "The data source region call returns an error");
+
+		for(;region_rc == 1 && region.size > 0;)
+			if(ERROR_CODE(size_t) == _sendfile(handle->fd, &region))
+				ERROR_RETURN_LOG(int, "Cannot send the file region");
+#endif
 		for(;;)
 		{
 			int eos_rc = data_source.eos(data_source.data_handle);
@@ -1307,6 +1671,11 @@ static int _dealloc(void* __restrict ctx, void* __restrict pipe, int error, int
 				LOG_DEBUG("there's some more bytes to read, mark the connection to ready to read state");
 				mode = MODULE_TCP_POOL_RELEASE_MODE_WAIT_FOR_READ;
 			}
+			else if(handle->state->redeliver)
+			{
+				LOG_DEBUG("The redelivery has been requested, mark the connection to ready to read state");
+				mode = MODULE_TCP_POOL_RELEASE_MODE_WAIT_FOR_READ;
+			}
 			else
 			{
 				LOG_DEBUG("There's no more data in the buffer, mark the connection as wait for data state");
@@ -1392,6 +1761,23 @@ static int _eom(void* __restrict ctx, void* __restrict pipe, const char* buffer,
 	return 0;
 }
 
+static int _cntl(void* __restrict ctx, void* __restrict pipe, uint32_t opcode, va_list va_args)
+{
+	(void)ctx;
+	(void)va_args;
+	_handle_t* handle = (_handle_t*)pipe;
+
+	switch(opcode)
+	{
+		case MODULE_TCP_CNTL_REDELIVER:
+			if(handle->dir == _DIR_OUT) ERROR_RETURN_LOG(int, "Cannot request redelivery on an output pipe");
+			handle->state->redeliver = 1;
+			return 0;
+		default:
+			ERROR_RETURN_LOG(int, "Invalid opcode");
+	}
+}
+
 static int _push_state(void* __restrict ctx, void* __restrict pipe, void* __restrict state, itc_module_state_dispose_func_t func)
 {
 	(void) ctx;
@@ -1441,6 +1827,16 @@ static itc_module_property_value_t _get_prop(void* __restrict ctx, const char* s
 	};
 	_module_context_t* context = (_module_context_t*)ctx;
 
+	/* The async loop statistics are owned by each event loop, so the forked loops are able to report them */
+	if(strcmp(sym, "async_syscalls") == 0 || strcmp(sym, "async_bytes") == 0 || strcmp(sym, "async_responses") == 0)
+	{
+		module_tcp_async_stat_t stat;
+		if(NULL == context->async_loop || ERROR_CODE(int) == module_tcp_async_get_stat(context->async_loop, &stat))
+			return ret;
+		if(strcmp(sym, "async_syscalls") == 0) return _make_num((long long)stat.num_syscalls);
+		else if(strcmp(sym, "async_bytes") == 0) return _make_num((long long)stat.num_bytes);
+		else return _make_num((long long)stat.num_finished);
+	}
 
 	/* Also, any forked event loop do not have permission to access any of the config */
 	if(context->fork_id != 0)
@@ -1454,6 +1850,7 @@ static itc_module_property_value_t _get_prop(void* __restrict ctx, const char* s
 	else if(strcmp(sym, "backlog") == 0) return _make_num(context->pool_conf.tcp_backlog);
 	else if(strcmp(sym, "ipv6") == 0) return _make_num(context->pool_conf.ipv6);
 	else if(strcmp(sym, "reuseaddr") == 0) return _make_num((long long)context->pool_conf.reuseaddr);
+	else if(strcmp(sym, "reuseport") == 0) return _make_num((long long)context->pool_conf.reuseport);
 	else if(strcmp(sym, "async_buf_size") == 0) return _make_num((long long)context->async_buf_size);
 	else if(strcmp(sym, "accept_retry_interval") == 0) return _make_num((long long)context->pool_conf.accept_retry_interval);
 	else if(strcmp(sym, "bindaddr") == 0) //*(const char**)data = context->pool_conf.bind_addr;
@@ -1495,6 +1892,12 @@ static int _set_prop(void* __restrict ctx, const char* sym, itc_module_property_
 		else if(strcmp(sym, "backlog") == 0) context->pool_conf.tcp_backlog = (int)value.num;
 		else if(strcmp(sym, "ipv6") == 0) context->pool_conf.ipv6 = (int)value.num;
 		else if(strcmp(sym, "reuseaddr") == 0) context->pool_conf.reuseaddr = (int)value.num;
+		else if(strcmp(sym, "reuseport") == 0)
+		{
+			if(value.num < MODULE_TCP_POOL_REUSEPORT_NONE || value.num > MODULE_TCP_POOL_REUSEPORT_CPU)
+				ERROR_RETURN_LOG(int, "Invalid reuseport mode %"PRId64, value.num);
+			context->pool_conf.reuseport = (int)value.num;
+		}
 		else if(strcmp(sym, "accept_retry_interval") == 0) context->pool_conf.accept_retry_interval = (uint32_t)value.num;
 		else if(strcmp(sym, "async_buf_size") == 0)
 		{
@@ -1573,6 +1976,7 @@ itc_module_t module_tcp_module_def = {
 	.write_callback = _write_callback,
 	.has_unread_data = _has_unread,
 	.eom = _eom,
+	.cntl = _cntl,
 	.push_state = _push_state,
 	.pop_state = _pop_state,
 	.event_thread_killed = _event_loop_killed,
@@ -22,6 +22,10 @@
 #include <arch/arch.h>
 #include <os/os.h>
 
+#ifdef __LINUX__
+#	include <linux/filter.h>
+#endif
+
 /**
  * @brief the message in the message queue
  **/
@@ -255,6 +259,7 @@ static inline module_tcp_pool_t* _pool_new(int master)
 
 	ret->poll_obj = NULL;
 	ret->event_fd = ERROR_CODE(int);
+	ret->socket_fd = ERROR_CODE(int);
 
 	/* Create the poll object  */
 	if(NULL == (ret->poll_obj = os_event_poll_new()))
@@ -285,6 +290,16 @@ ERR:
 	return NULL;
 }
 
+/**
+ * @brief check if the pool has its own listening socket
+ * @param pool the pool to check
+ * @return the check result
+ **/
+static inline int _owns_socket(const module_tcp_pool_t* pool)
+{
+	return pool->master == NULL || pool->conf.reuseport != MODULE_TCP_POOL_REUSEPORT_NONE;
+}
+
 module_tcp_pool_t* module_tcp_pool_new()
 {
 	return _pool_new(1);
@@ -309,7 +324,7 @@ int module_tcp_pool_free(module_tcp_pool_t* pool)
 
 	int rc = _finalize_conn_info(pool);
 
-	if(pool->socket_fd >= 0 && pool->master == NULL) close(pool->socket_fd);
+	if(pool->socket_fd >= 0 && _owns_socket(pool)) close(pool->socket_fd);
 
 	if(pool->event_fd >= 0) close(pool->event_fd);
 
@@ -342,7 +357,7 @@ int module_tcp_pool_num_forks(const module_tcp_pool_t* pool)
  **/
 static inline int _init_socket(module_tcp_pool_t* pool)
 {
-	if(pool->master == NULL)
+	if(_owns_socket(pool))
 	{
 		struct sockaddr* sockaddr;
 		socklen_t sockaddr_size;
@@ -376,12 +391,44 @@ static inline int _init_socket(module_tcp_pool_t* pool)
 		   setsockopt(pool->socket_fd, SOL_SOCKET, SO_REUSEADDR, (char*)&pool->conf.reuseaddr, sizeof(pool->conf.reuseaddr)) < 0)
 			ERROR_LOG_ERRNO_GOTO(ERR, "Cannot set the reuseaddr option");
 
+		if(pool->conf.reuseport != MODULE_TCP_POOL_REUSEPORT_NONE)
+		{
+			int one = 1;
+			if(setsockopt(pool->socket_fd, SOL_SOCKET, SO_REUSEPORT, (char*)&one, sizeof(one)) < 0)
+				ERROR_LOG_ERRNO_GOTO(ERR, "Cannot set the reuseport option");
+		}
+
 		if(_set_nonblock(pool->socket_fd) == ERROR_CODE(int))
 			ERROR_LOG_GOTO(ERR, "Cannot set the socket FD to non-blocking mode");
 
 		if(bind(pool->socket_fd, sockaddr, sockaddr_size) < 0)
 			ERROR_LOG_ERRNO_GOTO(ERR, "Cannot bind address");
 
+		/* The steering program is shared by the entire reuseport group, so only the master needs to attach it.
+		 * The master is the first socket in the group, and the forks are added in the order they get configured */
+		if(pool->master == NULL && pool->conf.reuseport == MODULE_TCP_POOL_REUSEPORT_CPU)
+		{
+#if defined(__LINUX__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+			struct sock_filter code[] = {
+				/* A = the CPU handling the packet */
+				{ BPF_LD  | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU) },
+				/* A = A % number of sockets in the group */
+				{ BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)pool->num_forks + 1 },
+				/* Use A as the index of the socket */
+				{ BPF_RET | BPF_A, 0, 0, 0 }
+			};
+			struct sock_fprog prog = {
+				.len = sizeof(code) / sizeof(code[0]),
+				.filter = code
+			};
+
+			if(setsockopt(pool->socket_fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0)
+				ERROR_LOG_ERRNO_GOTO(ERR, "Cannot attach the CPU steering program to the reuseport group");
+#else
+			ERROR_LOG_GOTO(ERR, "The CPU steering reuseport mode is not supported on this platform");
+#endif
+		}
+
 		if(listen(pool->socket_fd, pool->conf.tcp_backlog) < 0)
 			ERROR_LOG_ERRNO_GOTO(ERR, "Cannot listen TCP port %"PRIu16, pool->conf.port);
 	}
@@ -409,7 +456,7 @@ static inline int _init_socket(module_tcp_pool_t* pool)
 	LOG_DEBUG("TCP Socket has been initialized on %s:%"PRIu16, pool->conf.bind_addr, pool->conf.port);
 	return 0;
 ERR:
-	if(pool->socket_fd >= 0 && pool->master == NULL) close(pool->socket_fd);
+	if(pool->socket_fd >= 0 && _owns_socket(pool)) close(pool->socket_fd);
 	pool->socket_fd = ERROR_CODE(int);
 	return ERROR_CODE(int);
 }
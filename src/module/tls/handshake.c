@@ -0,0 +1,219 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+#include <constants.h>
+
+#if MODULE_TLS_ENABLED
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <error.h>
+
+#include <utils/log.h>
+#include <utils/thread.h>
+
+#include <module/tls/handshake.h>
+
+/**
+ * @brief the handshake thread pool
+ **/
+struct _module_tls_handshake_pool_t {
+	pthread_mutex_t             mutex;       /*!< the mutex protects the job queue */
+	pthread_cond_t              cond;        /*!< the condition variable used to wake up the idle handshake threads */
+	uint32_t                    killed;      /*!< indicates the pool is being disposed */
+	uint32_t                    nthreads;    /*!< the number of threads in the pool */
+	uint32_t                    capacity;    /*!< the capacity of the job queue */
+	uint32_t                    head;        /*!< the index of the first job in the queue */
+	uint32_t                    count;       /*!< the number of jobs in the queue */
+	module_tls_handshake_func_t step;        /*!< the callback function that performs the handshake step */
+	module_tls_handshake_func_t cancel;      /*!< the callback function that disposes an unprocessed job */
+	void*                       data;        /*!< the additional data for the callback functions */
+	void**                      queue;       /*!< the job queue */
+	thread_t**                  threads;     /*!< the handshake threads */
+};
+
+/**
+ * @brief the main function of the handshake thread
+ * @param data the handshake pool
+ * @return the handshake pool
+ **/
+static void* _handshake_thread_main(void* data)
+{
+	module_tls_handshake_pool_t* pool = (module_tls_handshake_pool_t*)data;
+
+	for(;;)
+	{
+		void* job;
+
+		if((errno = pthread_mutex_lock(&pool->mutex)) != 0)
+			ERROR_PTR_RETURN_LOG_ERRNO("Cannot acquire the handshake queue mutex");
+
+		while(!pool->killed && pool->count == 0)
+			if((errno = pthread_cond_wait(&pool->cond, &pool->mutex)) != 0)
+			{
+				LOG_ERROR_ERRNO("Cannot wait for the handshake job");
+				pthread_mutex_unlock(&pool->mutex);
+				return NULL;
+			}
+
+		if(pool->killed)
+		{
+			pthread_mutex_unlock(&pool->mutex);
+			break;
+		}
+
+		job = pool->queue[pool->head];
+		pool->head = (pool->head + 1) % pool->capacity;
+		pool->count --;
+
+		if((errno = pthread_mutex_unlock(&pool->mutex)) != 0)
+			LOG_WARNING_ERRNO("Cannot release the handshake queue mutex");
+
+		pool->step(job, pool->data);
+	}
+
+	LOG_DEBUG("Handshake thread exited");
+
+	return data;
+}
+
+module_tls_handshake_pool_t* module_tls_handshake_pool_new(uint32_t nthreads, uint32_t queue_size,
+                                                           module_tls_handshake_func_t step,
+                                                           module_tls_handshake_func_t cancel,
+                                                           void* data)
+{
+	if(nthreads == 0 || queue_size == 0 || NULL == step || NULL == cancel)
+		ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	uint32_t i;
+	int mutex_init = 0, cond_init = 0;
+	module_tls_handshake_pool_t* ret = (module_tls_handshake_pool_t*)calloc(1, sizeof(*ret));
+	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the handshake pool");
+
+	ret->capacity = queue_size;
+	ret->step = step;
+	ret->cancel = cancel;
+	ret->data = data;
+
+	if(NULL == (ret->queue = (void**)malloc(sizeof(void*) * queue_size)))
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the handshake queue");
+
+	if(NULL == (ret->threads = (thread_t**)calloc(nthreads, sizeof(thread_t*))))
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the handshake thread array");
+
+	if((errno = pthread_mutex_init(&ret->mutex, NULL)) != 0)
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot initialize the handshake queue mutex");
+	mutex_init = 1;
+
+	if((errno = pthread_cond_init(&ret->cond, NULL)) != 0)
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot initialize the handshake queue condition variable");
+	cond_init = 1;
+
+	for(i = 0; i < nthreads; i ++, ret->nthreads ++)
+		if(NULL == (ret->threads[i] = thread_new(_handshake_thread_main, ret, THREAD_TYPE_GENERIC)))
+			ERROR_LOG_GOTO(ERR, "Cannot start the handshake thread");
+
+	LOG_INFO("TLS handshake pool has been started with %u threads", nthreads);
+
+	return ret;
+ERR:
+	if(ret->nthreads > 0)
+	{
+		pthread_mutex_lock(&ret->mutex);
+		ret->killed = 1;
+		pthread_cond_broadcast(&ret->cond);
+		pthread_mutex_unlock(&ret->mutex);
+
+		for(i = 0; i < ret->nthreads; i ++)
+			thread_free(ret->threads[i], NULL);
+	}
+	if(cond_init) pthread_cond_destroy(&ret->cond);
+	if(mutex_init) pthread_mutex_destroy(&ret->mutex);
+	if(NULL != ret->threads) free(ret->threads);
+	if(NULL != ret->queue) free(ret->queue);
+	free(ret);
+	return NULL;
+}
+
+int module_tls_handshake_pool_post(module_tls_handshake_pool_t* pool, void* job)
+{
+	if(NULL == pool || NULL == job) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	int rc = 0;
+
+	if((errno = pthread_mutex_lock(&pool->mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the handshake queue mutex");
+
+	if(!pool->killed && pool->count < pool->capacity)
+	{
+		pool->queue[(pool->head + pool->count) % pool->capacity] = job;
+		pool->count ++;
+		rc = 1;
+
+		if((errno = pthread_cond_signal(&pool->cond)) != 0)
+			LOG_WARNING_ERRNO("Cannot notify the handshake thread");
+	}
+
+	if((errno = pthread_mutex_unlock(&pool->mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot release the handshake queue mutex");
+
+	return rc;
+}
+
+int module_tls_handshake_pool_free(module_tls_handshake_pool_t* pool)
+{
+	if(NULL == pool) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	int rc = 0;
+	uint32_t i;
+
+	if((errno = pthread_mutex_lock(&pool->mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the handshake queue mutex");
+
+	pool->killed = 1;
+
+	if((errno = pthread_cond_broadcast(&pool->cond)) != 0)
+	{
+		LOG_ERROR_ERRNO("Cannot notify the handshake threads");
+		rc = ERROR_CODE(int);
+	}
+
+	if((errno = pthread_mutex_unlock(&pool->mutex)) != 0)
+	{
+		LOG_ERROR_ERRNO("Cannot release the handshake queue mutex");
+		rc = ERROR_CODE(int);
+	}
+
+	for(i = 0; i < pool->nthreads; i ++)
+		if(ERROR_CODE(int) == thread_free(pool->threads[i], NULL))
+		{
+			LOG_ERROR("Cannot join the handshake thread");
+			rc = ERROR_CODE(int);
+		}
+
+	/* All the threads are gone, so we can touch the queue without the lock */
+	for(; pool->count > 0; pool->count --, pool->head = (pool->head + 1) % pool->capacity)
+		pool->cancel(pool->queue[pool->head], pool->data);
+
+	if((errno = pthread_cond_destroy(&pool->cond)) != 0)
+	{
+		LOG_ERROR_ERRNO("Cannot dispose the handshake queue condition variable");
+		rc = ERROR_CODE(int);
+	}
+
+	if((errno = pthread_mutex_destroy(&pool->mutex)) != 0)
+	{
+		LOG_ERROR_ERRNO("Cannot dispose the handshake queue mutex");
+		rc = ERROR_CODE(int);
+	}
+
+	free(pool->threads);
+	free(pool->queue);
+	free(pool);
+
+	return rc;
+}
+#endif
@@ -9,15 +9,24 @@
 #include <errno.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdarg.h>
 #include <pthread.h>
 #include <string.h>
+#include <time.h>
 
 #include <openssl/ssl.h>
 #include <openssl/bio.h>
 #include <openssl/err.h>
 #include <openssl/conf.h>
 #include <openssl/engine.h>
+#include <openssl/rand.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#	include <openssl/core_names.h>
+#	include <openssl/params.h>
+#endif
 
 #include <error.h>
 #include <utils/log.h>
@@ -28,10 +37,13 @@
 #include <itc/module.h>
 #include <itc/modtab.h>
 
+#include <module/tcp/module.h>
+#include <module/tcp/api.h>
 #include <module/tls/module.h>
 #include <module/tls/bio.h>
 #include <module/tls/api.h>
 #include <module/tls/dra.h>
+#include <module/tls/handshake.h>
 
 #if OPENSSL_VERSION_NUMBER >= 0x10002000L
 /**
@@ -112,6 +124,17 @@ typedef struct {
 	itc_module_pipe_t*          t_pipe;         /*!< the transportation layer pipe */
 } _handle_t;
 
+/**
+ * @brief the session ticket key
+ * @note the memory layout is the same as the 80 bytes ticket key file used by other TLS servers,
+ *       thus the key file can be shared between different server instances
+ **/
+typedef struct {
+	unsigned char                  name[16];      /*!< the key name, which identifies the key used by a ticket */
+	unsigned char                  hmac_key[32];  /*!< the HMAC-SHA256 key */
+	unsigned char                  aes_key[32];   /*!< the AES-256-CBC key */
+} _ticket_key_t;
+
 /**
  * @brief the module context
  **/
@@ -125,7 +148,23 @@ struct _module_context_t{
 #endif
 	itc_module_type_t              transport_mod; /*!< the transportation layer module type */
 	uint32_t                       async_write;   /*!< indicates if we want to enable the asnyc write in the transportation layer */
+	uint32_t                       redeliver;     /*!< indicates if the transportation layer is able to redeliver the connection */
+	uint32_t                       slave_mode;    /*!< the slave mode, the module doesn't accept event, so it can be used as a transportation layer */
 	mempool_objpool_t*             tls_pool;      /*!< the SSL context pool */
+	pthread_mutex_t                ticket_mutex;  /*!< the mutex protects the ticket key ring */
+	_ticket_key_t                  ticket_keys[MODULE_TLS_TICKET_KEY_RING_SIZE]; /*!< the ticket key ring, the first key issues new tickets */
+	uint32_t                       ticket_key_count;    /*!< the number of keys in the ticket key ring */
+	uint32_t                       ticket_key_rotation; /*!< the ticket key rotation interval in seconds, 0 means never rotate */
+	uint32_t                       ticket_key_from_file:1; /*!< the keys are loaded from the key file, which are never rotated */
+	time_t                         ticket_key_ts;       /*!< the time when the current ticket key has been installed */
+	uint64_t                       stat_handshakes;     /*!< the number of completed handshakes */
+	uint64_t                       stat_resumed;        /*!< the number of handshakes resumed from a cached session or a ticket */
+	uint64_t                       stat_full;           /*!< the number of full handshakes */
+	uint32_t                       handshake_threads;    /*!< the number of handshake threads, 0 means the handshake runs on the thread serving the connection */
+	uint32_t                       handshake_queue_size; /*!< the maximum number of connections waiting for the handshake threads */
+	module_tls_handshake_pool_t*   handshake_pool;       /*!< the handshake thread pool, NULL if the pool hasn't been started */
+	uint64_t                       stat_hs_offloaded;    /*!< the number of handshake steps performed by the handshake pool */
+	uint64_t                       stat_hs_overflow;     /*!< the number of handshake steps performed inline because the handshake queue is full */
 };
 
 /**
@@ -251,6 +290,199 @@ static inline int _thread_finalize(void)
 
 
 
+/**
+ * @brief generate a new random ticket key and make it the current key of the ring
+ * @details the oldest key falls off the ring, thus the tickets issued by it are not accepted anymore
+ * @param context the module context
+ * @note the caller should hold the ticket mutex
+ * @return status code
+ **/
+static inline int _ticket_key_rotate(_module_context_t* context)
+{
+	_ticket_key_t key;
+	if(RAND_bytes((unsigned char*)&key, sizeof(key)) <= 0)
+		ERROR_RETURN_LOG(int, "Cannot generate the session ticket key: %s", ERR_error_string(ERR_get_error(), NULL));
+
+	if(context->ticket_key_count < MODULE_TLS_TICKET_KEY_RING_SIZE)
+		context->ticket_key_count ++;
+
+	memmove(context->ticket_keys + 1, context->ticket_keys, sizeof(_ticket_key_t) * (context->ticket_key_count - 1));
+	context->ticket_keys[0] = key;
+	context->ticket_key_ts = time(NULL);
+
+	OPENSSL_cleanse(&key, sizeof(key));
+
+	LOG_DEBUG("Session ticket key has been rotated, %u keys are accepted", context->ticket_key_count);
+
+	return 0;
+}
+
+/**
+ * @brief get the ticket key from the key ring
+ * @param context the module context
+ * @param name the key name we are looking for, NULL if we want the key to issue a new ticket
+ * @param buf the buffer used to return the key
+ * @return 1 if the key is the current key, 2 if the key is an old key, thus the ticket should be renewed
+ *         0 if the key is not found, or error code
+ **/
+static inline int _ticket_key_get(_module_context_t* context, const unsigned char* name, _ticket_key_t* buf)
+{
+	int rc = 0;
+	uint32_t i;
+
+	if((errno = pthread_mutex_lock(&context->ticket_mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the ticket key mutex");
+
+	/* The key rotates once for each elapsed interval, thus a ticket is accepted for at most the ring size times the interval.
+	 * The keys from the key file are shared with other server instances, so we never replace them with a local random key */
+	if(context->ticket_key_rotation > 0 && context->ticket_key_count > 0 && !context->ticket_key_from_file)
+	{
+		time_t elapsed = time(NULL) - context->ticket_key_ts;
+		for(i = 0; elapsed >= context->ticket_key_rotation && i < MODULE_TLS_TICKET_KEY_RING_SIZE; i ++, elapsed -= context->ticket_key_rotation)
+			if(ERROR_CODE(int) == _ticket_key_rotate(context))
+			{
+				LOG_WARNING("Cannot rotate the session ticket key, keep using the current key");
+				break;
+			}
+	}
+
+	if(NULL == name)
+	{
+		if(context->ticket_key_count > 0)
+			*buf = context->ticket_keys[0], rc = 1;
+	}
+	else for(i = 0; i < context->ticket_key_count && rc == 0; i ++)
+		if(memcmp(context->ticket_keys[i].name, name, sizeof(context->ticket_keys[i].name)) == 0)
+			*buf = context->ticket_keys[i], rc = (i == 0) ? 1 : 2;
+
+	if((errno = pthread_mutex_unlock(&context->ticket_mutex)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot release the ticket key mutex");
+
+	return rc;
+}
+
+/**
+ * @brief the session ticket key callback, which encrypts and decrypts the tickets with the key ring
+ * @param ssl the SSL connection
+ * @param key_name the key name of the ticket
+ * @param iv the initial vector
+ * @param cctx the cipher context
+ * @param hctx the HMAC context
+ * @param enc if we are issuing a new ticket
+ * @return 1 for success, 2 for success but the ticket should be renewed, 0 if the ticket can not be used
+ *         and negative value on error
+ **/
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static int _ticket_key_cb(SSL* ssl, unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cctx, EVP_MAC_CTX* hctx, int enc)
+#else
+static int _ticket_key_cb(SSL* ssl, unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cctx, HMAC_CTX* hctx, int enc)
+#endif
+{
+	_module_context_t* context = (_module_context_t*)SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+	_ticket_key_t key;
+	int rc = _ticket_key_get(context, enc ? NULL : key_name, &key);
+
+	if(ERROR_CODE(int) == rc) return -1;
+	if(rc == 0) return 0;
+
+	if(enc)
+	{
+		memcpy(key_name, key.name, sizeof(key.name));
+		if(RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) <= 0 ||
+		   EVP_EncryptInit_ex(cctx, EVP_aes_256_cbc(), NULL, key.aes_key, iv) <= 0)
+			ERROR_LOG_GOTO(ERR, "Cannot initialize the ticket cipher: %s", ERR_error_string(ERR_get_error(), NULL));
+	}
+	else if(EVP_DecryptInit_ex(cctx, EVP_aes_256_cbc(), NULL, key.aes_key, iv) <= 0)
+		ERROR_LOG_GOTO(ERR, "Cannot initialize the ticket cipher: %s", ERR_error_string(ERR_get_error(), NULL));
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	static char digest[] = "SHA256";
+	OSSL_PARAM params[] = {
+		OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+		OSSL_PARAM_construct_end()
+	};
+	if(EVP_MAC_init(hctx, key.hmac_key, sizeof(key.hmac_key), params) <= 0)
+#else
+	if(HMAC_Init_ex(hctx, key.hmac_key, sizeof(key.hmac_key), EVP_sha256(), NULL) <= 0)
+#endif
+		ERROR_LOG_GOTO(ERR, "Cannot initialize the ticket HMAC: %s", ERR_error_string(ERR_get_error(), NULL));
+
+	OPENSSL_cleanse(&key, sizeof(key));
+	return rc;
+ERR:
+	OPENSSL_cleanse(&key, sizeof(key));
+	return -1;
+}
+
+/**
+ * @brief install the ticket key callback, after this the tickets are protected by the key ring
+ * @param context the module context
+ * @return status code
+ **/
+static inline int _ticket_key_cb_install(_module_context_t* context)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	if(SSL_CTX_set_tlsext_ticket_key_evp_cb(context->ssl_context, _ticket_key_cb) <= 0)
+#else
+	if(SSL_CTX_set_tlsext_ticket_key_cb(context->ssl_context, _ticket_key_cb) <= 0)
+#endif
+		ERROR_RETURN_LOG(int, "Cannot install the session ticket key callback: %s", ERR_error_string(ERR_get_error(), NULL));
+	return 0;
+}
+
+/**
+ * @brief load the ticket keys from the key file
+ * @details the key file is a sequence of 80 bytes keys, the first key is used to issue new tickets and
+ *          the remaining keys are only used to decrypt the tickets
+ * @param context the module context
+ * @param filename the path to the key file
+ * @return status code
+ **/
+static inline int _ticket_key_load(_module_context_t* context, const char* filename)
+{
+	_ticket_key_t keys[MODULE_TLS_TICKET_KEY_RING_SIZE];
+	size_t nkeys = 0, nbytes;
+	int locked = 0;
+	FILE* fp = fopen(filename, "rb");
+	if(NULL == fp) ERROR_RETURN_LOG_ERRNO(int, "Cannot open the ticket key file %s", filename);
+
+	nbytes = fread(keys, 1, sizeof(keys), fp);
+	if(nbytes == 0 || nbytes % sizeof(_ticket_key_t) != 0)
+		ERROR_LOG_GOTO(ERR, "Invalid ticket key file %s, the file should contain one or more 80 bytes keys", filename);
+
+	nkeys = nbytes / sizeof(_ticket_key_t);
+
+	if(fgetc(fp) != EOF)
+		LOG_WARNING("The ticket key file %s contains more than %u keys, the remaining keys are ignored", filename, MODULE_TLS_TICKET_KEY_RING_SIZE);
+
+	if((errno = pthread_mutex_lock(&context->ticket_mutex)) != 0)
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot acquire the ticket key mutex");
+	locked = 1;
+
+	memcpy(context->ticket_keys, keys, sizeof(_ticket_key_t) * nkeys);
+	context->ticket_key_count = (uint32_t)nkeys;
+	context->ticket_key_from_file = 1;
+	context->ticket_key_ts = time(NULL);
+
+	if((errno = pthread_mutex_unlock(&context->ticket_mutex)) != 0)
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot release the ticket key mutex");
+	locked = 0;
+
+	if(ERROR_CODE(int) == _ticket_key_cb_install(context))
+		ERROR_LOG_GOTO(ERR, "Cannot enable the ticket key ring");
+
+	LOG_DEBUG("%zu session ticket keys have been loaded from %s", nkeys, filename);
+
+	OPENSSL_cleanse(keys, sizeof(keys));
+	fclose(fp);
+	return 0;
+ERR:
+	if(locked) pthread_mutex_unlock(&context->ticket_mutex);
+	OPENSSL_cleanse(keys, sizeof(keys));
+	fclose(fp);
+	return ERROR_CODE(int);
+}
+
 /**
  * @brief the initialization function of the TLS module
  * @details the initialization argument should look like <br/>
@@ -273,8 +505,15 @@ static int _init(void* __restrict ctx, uint32_t argc, char const* __restrict con
 	static const char cert_prefix[] = "cert=";
 	static const char pkey_prefix[] = "key=";
 
-	uint32_t i;
-	for(i = 0; i < argc; i ++)
+	uint32_t i = 0;
+	context->slave_mode = 0;
+	if(argc > 0 && strcmp(argv[0], "--slave") == 0)
+	{
+		context->slave_mode = 1;
+		i = 1;
+	}
+
+	for(; i < argc; i ++)
 	{
 		char const* param = argv[i];
 		if(_match(param, cert_prefix))
@@ -287,7 +526,7 @@ static int _init(void* __restrict ctx, uint32_t argc, char const* __restrict con
 	LOG_DEBUG("Initialize OpenSSL with Certification %s and Private Key %s", cert_file, pkey_file);
 
 	if(argc - i != 1) ERROR_RETURN_LOG(int, "Invalid module init args, should be"
-		                                    "tls_pipe [cert=<CERT>] [key=<PKEY>] <trans-module-path>");
+		                                    "tls_pipe [--slave] [cert=<CERT>] [key=<PKEY>] <trans-module-path>");
 
 	/* Find the transportation layer module */
 	if(ERROR_CODE(itc_module_type_t) == (context->transport_mod = itc_modtab_get_module_type_from_path(argv[i])))
@@ -298,6 +537,11 @@ static int _init(void* __restrict ctx, uint32_t argc, char const* __restrict con
 	if(ERROR_CODE(itc_module_flags_t) == mf) ERROR_RETURN_LOG(int, "Cannot get the module flags of the module instance %s", argv[i]);
 	if(0 != (mf & ITC_MODULE_FLAGS_EVENT_LOOP)) ERROR_RETURN_LOG(int, "Cannot use an event-accepting module as transprotation module");
 
+	/* Only the TCP module knows how to redeliver a connection */
+	const itc_modtab_instance_t* inst = itc_modtab_get_from_module_type(context->transport_mod);
+	if(NULL == inst) ERROR_RETURN_LOG(int, "Cannot get the transportation layer module instance %s", argv[i]);
+	context->redeliver = (inst->module == &module_tcp_module_def);
+
 	/* Initialize the OpenSSL */
 	if(_module_instance_count == 0)
 	{
@@ -331,9 +575,36 @@ static int _init(void* __restrict ctx, uint32_t argc, char const* __restrict con
 
 	context->async_write = 1;
 
+	/* Setup the server side session cache, which is shared by all the connections of this module instance */
+	static const unsigned char sid_ctx[] = "plumber.tls";
+	SSL_CTX_set_app_data(context->ssl_context, context);
+	SSL_CTX_set_session_cache_mode(context->ssl_context, SSL_SESS_CACHE_SERVER);
+	SSL_CTX_sess_set_cache_size(context->ssl_context, MODULE_TLS_SESSION_CACHE_SIZE);
+	if(SSL_CTX_set_session_id_context(context->ssl_context, sid_ctx, sizeof(sid_ctx) - 1) <= 0)
+	{
+		SSL_CTX_free(context->ssl_context);
+		ERROR_RETURN_LOG(int, "Cannot set the session id context: %s", ERR_error_string(ERR_get_error(), NULL));
+	}
+
+	context->ticket_key_count = 0;
+	context->ticket_key_rotation = 0;
+	context->ticket_key_ts = 0;
+	context->stat_handshakes = context->stat_resumed = context->stat_full = 0;
+	context->handshake_threads = MODULE_TLS_HANDSHAKE_THREADS;
+	context->handshake_queue_size = MODULE_TLS_HANDSHAKE_QUEUE_SIZE;
+	context->handshake_pool = NULL;
+	context->stat_hs_offloaded = context->stat_hs_overflow = 0;
+
+	if((errno = pthread_mutex_init(&context->ticket_mutex, NULL)) != 0)
+	{
+		SSL_CTX_free(context->ssl_context);
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot initialize the ticket key mutex");
+	}
+
 	if(NULL == (context->tls_pool = mempool_objpool_new(sizeof(_tls_context_t))))
 	{
 		SSL_CTX_free(context->ssl_context);
+		pthread_mutex_destroy(&context->ticket_mutex);
 		ERROR_RETURN_LOG(int, "Cannot create memory pool for the TLS context");
 	}
 
@@ -347,6 +618,23 @@ static int _init(void* __restrict ctx, uint32_t argc, char const* __restrict con
 	return 0;
 }
 
+/**
+ * @brief stop the handshake pool before the transportation layer module is disposed
+ * @param ctx the module context
+ * @return status code
+ **/
+static int _on_exit(void* __restrict ctx)
+{
+	_module_context_t* context = (_module_context_t*)ctx;
+
+	if(NULL != context->handshake_pool && ERROR_CODE(int) == module_tls_handshake_pool_free(context->handshake_pool))
+		ERROR_RETURN_LOG(int, "Cannot dispose the handshake pool");
+
+	context->handshake_pool = NULL;
+
+	return 0;
+}
+
 /**
  * @brief cleanup the module
  * @param ctx the module context
@@ -359,6 +647,14 @@ static int _cleanup(void* __restrict ctx)
 
 	SSL_CTX_free(context->ssl_context);
 
+	OPENSSL_cleanse(context->ticket_keys, sizeof(context->ticket_keys));
+
+	if((errno = pthread_mutex_destroy(&context->ticket_mutex)) != 0)
+	{
+		rc = ERROR_CODE(int);
+		LOG_WARNING_ERRNO("Cannot dispose the ticket key mutex");
+	}
+
 #if OPENSSL_VERSION_NUMBER >= 0x10002000L
 	if(NULL !=  context->alpn_protos)
 		free(context->alpn_protos);
@@ -477,7 +773,14 @@ static inline int _user_space_state_dispose(_tls_context_t* tls)
  **/
 static inline int _tls_context_free(_tls_context_t* context)
 {
-	if(NULL != context->ssl) SSL_free(context->ssl);
+	if(NULL != context->ssl)
+	{
+		/* The session of an established connection should remain in the session cache, otherwise OpenSSL removes
+		 * it because the connection has never been shutdown, the session of a failed connection has been removed already */
+		if(context->state == _TLS_STATE_CONNECTED)
+			SSL_set_shutdown(context->ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+		SSL_free(context->ssl);
+	}
 
 	if(ERROR_CODE(int) == _user_space_state_dispose(context))
 		ERROR_RETURN_LOG(int, "Cannot dispose the user-space state");
@@ -577,86 +880,6 @@ static inline int _clear_ssl_error(void)
 	return 0;
 }
 
-/**
- * @brief accept a TLS connection
- * @param ctx the module context
- * @param args the accept arguments
- * @param inbuf the input buffer
- * @param outbuf the output buffer
- * @return status code
- **/
-static int _accept(void* __restrict ctx, const void* __restrict args, void* __restrict inbuf, void* __restrict outbuf)
-{
-	_module_context_t* context = (_module_context_t*)ctx;
-	runtime_api_pipe_flags_t in_flags  = itc_module_get_handle_flags(inbuf);
-	runtime_api_pipe_flags_t out_flags = itc_module_get_handle_flags(outbuf);
-
-	/* It should be persist before we established the connection and return the handle to user space,
-	 * Becuase we need to do connect before the actual user space program can use this */
-	itc_module_pipe_param_t trans_param = {
-		.input_flags = in_flags | RUNTIME_API_PIPE_PERSIST,
-		.output_flags = out_flags | RUNTIME_API_PIPE_PERSIST,
-		.args = args
-	};
-
-	_handle_t* in = (_handle_t*)inbuf;
-	_handle_t* out = (_handle_t*)outbuf;
-
-	if(context->async_write == 1) trans_param.output_flags |= RUNTIME_API_PIPE_ASYNC;
-
-	itc_module_pipe_t *trans_in = NULL;
-	itc_module_pipe_t *trans_out = NULL;
-	_tls_context_t* tls_state = NULL;
-	/* Indicates if the TLS state is owned by this module */
-	uint32_t state_owned = 0;
-
-	if(itc_module_pipe_accept(context->transport_mod, trans_param, &trans_in, &trans_out) == ERROR_CODE(int) ||
-	   NULL == trans_in ||
-	   NULL == trans_out)
-		ERROR_LOG_GOTO(L_ERR, "Cannot accept connection from transportation layer");
-
-	if(ERROR_CODE(int) == _invoke_pipe_cntl(trans_in, RUNTIME_API_PIPE_CNTL_OPCODE_POP_STATE, &tls_state))
-		ERROR_LOG_GOTO(L_ERR, "Cannot pop the previous state from the pipe");
-
-	if(NULL == tls_state)
-	{
-		LOG_DEBUG("The connection has no TLS state been pushed, allocate a new one");
-		if(NULL == (tls_state = _tls_context_new(context)))
-			ERROR_LOG_GOTO(L_ERR, "Cannot create new TLS context");
-		state_owned = 1;
-	}
-
-	/* We need to update the BIO transporation layer pointer */
-	tls_state->in_bio_ctx.pipe = trans_in;
-	tls_state->out_bio_ctx.pipe = trans_out;
-
-	/* Popup the pipe to user-space code */
-	tls_state->user_state_to_push = 0;
-
-	if(_TLS_STATE_DISABLED == tls_state->state)
-		tls_state->state = _TLS_STATE_CONNECTING;
-
-	in->type = _HANDLE_TYPE_IN;
-	in->tls = tls_state;
-	in->t_pipe = trans_in;
-	in->last_read_size = 0;
-	in->no_more_input = 0;
-
-	out->type = _HANDLE_TYPE_OUT;
-	out->tls = tls_state;
-	out->t_pipe = trans_out;
-
-	tls_state->input_alive = 1;
-
-	return 0;
-
-L_ERR:
-	if(NULL != trans_in)   itc_module_pipe_deallocate(trans_in);
-	if(NULL != trans_out)  itc_module_pipe_deallocate(trans_out);
-	if(NULL != tls_state && state_owned) _tls_context_free(tls_state);
-	return ERROR_CODE(int);
-}
-
 static inline void _log_ssl_error(const char* what, int reason, int rc)
 {
 #ifndef LOG_ERROR_ENABLED
@@ -695,22 +918,22 @@ static inline void _log_ssl_error(const char* what, int reason, int rc)
 }
 
 /**
- * @brief ensure that the TLS tunnel has been established
- * @param handle the handle to ensure
+ * @brief perform the handshake step for the TLS connection
+ * @param tls the TLS connection context
  * @return &gt;0 - The TLS tunnel is current avaiable <br/>
  *         =0 - The TLS tunnel is establishing but not ready yet <br/>
  *         &lt;0 - The TLS tunnel can not be established
  **/
-static inline int _ensure_connect(_handle_t* handle)
+static inline int _handshake(_tls_context_t* tls)
 {
-	if(handle->tls->state == _TLS_STATE_CONNECTING)
+	if(tls->state == _TLS_STATE_CONNECTING)
 	{
 		/* Then do the connect! */
 		_clear_ssl_error();
-		int rc = SSL_accept(handle->tls->ssl);
+		int rc = SSL_accept(tls->ssl);
 		if(rc <= 0)
 		{
-			int reason = SSL_get_error(handle->tls->ssl, rc);
+			int reason = SSL_get_error(tls->ssl, rc);
 			switch(reason)
 			{
 				case SSL_ERROR_WANT_READ:
@@ -724,7 +947,15 @@ static inline int _ensure_connect(_handle_t* handle)
 		}
 		else if(rc == 1)
 		{
-			handle->tls->state = _TLS_STATE_CONNECTED;
+			_module_context_t* context = tls->module_context;
+			tls->state = _TLS_STATE_CONNECTED;
+
+			__sync_fetch_and_add(&context->stat_handshakes, 1);
+			if(SSL_session_reused(tls->ssl))
+				__sync_fetch_and_add(&context->stat_resumed, 1);
+			else
+				__sync_fetch_and_add(&context->stat_full, 1);
+
 			LOG_TRACE("TLS Tunnel has been established!");
 			return 1;
 		}
@@ -732,6 +963,200 @@ static inline int _ensure_connect(_handle_t* handle)
 	return 1;
 }
 
+/**
+ * @brief ensure that the TLS tunnel has been established
+ * @param handle the handle to ensure
+ * @return &gt;0 - The TLS tunnel is current avaiable <br/>
+ *         =0 - The TLS tunnel is establishing but not ready yet <br/>
+ *         &lt;0 - The TLS tunnel can not be established
+ **/
+static inline int _ensure_connect(_handle_t* handle)
+{
+	return _handshake(handle->tls);
+}
+
+/**
+ * @brief release the transportation layer pipes of a connection owned by the handshake pool
+ * @details If the connection is still alive, the TLS context is pushed to the transportation layer and the
+ *          connection will be accepted again once the client data is ready, otherwise the connection is closed
+ * @param tls the TLS connection context
+ * @param alive if the connection is still alive
+ * @return nothing
+ **/
+static inline void _handshake_job_release(_tls_context_t* tls, int alive)
+{
+	itc_module_pipe_t* t_in = tls->in_bio_ctx.pipe;
+	itc_module_pipe_t* t_out = tls->out_bio_ctx.pipe;
+
+	if(alive)
+	{
+		if(!tls->user_state_to_push && ERROR_CODE(int) == _user_space_state_dispose(tls))
+			LOG_WARNING("Cannot dispose the user-space status");
+
+		if(_invoke_pipe_cntl(t_in, RUNTIME_API_PIPE_CNTL_OPCODE_PUSH_STATE, tls, _tls_context_decref) == ERROR_CODE(int))
+		{
+			LOG_ERROR("Cannot push TLS context to the transportation layer pipe");
+			alive = 0;
+		}
+		else tls->pushed = 1;
+	}
+
+	if(!alive)
+	{
+		if(_invoke_pipe_cntl(t_in, RUNTIME_API_PIPE_CNTL_OPCODE_CLR_FLAG, RUNTIME_API_PIPE_PERSIST) == ERROR_CODE(int) ||
+		   _invoke_pipe_cntl(t_out, RUNTIME_API_PIPE_CNTL_OPCODE_CLR_FLAG, RUNTIME_API_PIPE_PERSIST) == ERROR_CODE(int))
+			LOG_WARNING("Cannot clear the persist flag of the trans_pipe");
+		if(!tls->pushed && _tls_context_decref(tls) == ERROR_CODE(int))
+			LOG_WARNING("Cannot dispose the TLS context");
+	}
+
+	if(ERROR_CODE(int) == itc_module_pipe_deallocate(t_in))
+		LOG_WARNING("Cannot deallocate the transportation layer input pipe");
+	if(ERROR_CODE(int) == itc_module_pipe_deallocate(t_out))
+		LOG_WARNING("Cannot deallocate the transportation layer output pipe");
+}
+
+/**
+ * @brief run the handshake step for a connection on the handshake thread
+ * @details no matter if the handshake has finished, the connection goes back to the transportation layer after
+ *          the step, because the client data isn't ready at this point anyway. Only the connection which has
+ *          established the TLS tunnel will be returned to the normal data path by the accept function
+ * @param job the TLS connection context
+ * @param data the module context
+ * @return nothing
+ **/
+static void _handshake_job_step(void* job, void* data)
+{
+	_tls_context_t* tls = (_tls_context_t*)job;
+	_module_context_t* context = (_module_context_t*)data;
+
+	__sync_fetch_and_add(&context->stat_hs_offloaded, 1);
+
+	_handshake_job_release(tls, ERROR_CODE(int) != _handshake(tls));
+}
+
+/**
+ * @brief close the connection which is still waiting for the handshake thread when the pool is disposed
+ * @param job the TLS connection context
+ * @param data the module context
+ * @return nothing
+ **/
+static void _handshake_job_cancel(void* job, void* data)
+{
+	(void)data;
+	_handshake_job_release((_tls_context_t*)job, 0);
+}
+
+/**
+ * @brief accept a TLS connection
+ * @param ctx the module context
+ * @param args the accept arguments
+ * @param inbuf the input buffer
+ * @param outbuf the output buffer
+ * @return status code
+ **/
+static int _accept(void* __restrict ctx, const void* __restrict args, void* __restrict inbuf, void* __restrict outbuf)
+{
+	_module_context_t* context = (_module_context_t*)ctx;
+	runtime_api_pipe_flags_t in_flags  = itc_module_get_handle_flags(inbuf);
+	runtime_api_pipe_flags_t out_flags = itc_module_get_handle_flags(outbuf);
+
+	/* It should be persist before we established the connection and return the handle to user space,
+	 * Becuase we need to do connect before the actual user space program can use this */
+	itc_module_pipe_param_t trans_param = {
+		.input_flags = in_flags | RUNTIME_API_PIPE_PERSIST,
+		.output_flags = out_flags | RUNTIME_API_PIPE_PERSIST,
+		.args = args
+	};
+
+	_handle_t* in = (_handle_t*)inbuf;
+	_handle_t* out = (_handle_t*)outbuf;
+
+	if(context->async_write == 1) trans_param.output_flags |= RUNTIME_API_PIPE_ASYNC;
+
+	itc_module_pipe_t *trans_in = NULL;
+	itc_module_pipe_t *trans_out = NULL;
+	_tls_context_t* tls_state = NULL;
+	/* Indicates if the TLS state is owned by this module */
+	uint32_t state_owned = 0;
+
+	for(;;)
+	{
+		trans_in = trans_out = NULL;
+		tls_state = NULL;
+		state_owned = 0;
+
+		if(itc_module_pipe_accept(context->transport_mod, trans_param, &trans_in, &trans_out) == ERROR_CODE(int) ||
+		   NULL == trans_in ||
+		   NULL == trans_out)
+			ERROR_LOG_GOTO(L_ERR, "Cannot accept connection from transportation layer");
+
+		if(ERROR_CODE(int) == _invoke_pipe_cntl(trans_in, RUNTIME_API_PIPE_CNTL_OPCODE_POP_STATE, &tls_state))
+			ERROR_LOG_GOTO(L_ERR, "Cannot pop the previous state from the pipe");
+
+		if(NULL == tls_state)
+		{
+			LOG_DEBUG("The connection has no TLS state been pushed, allocate a new one");
+			if(NULL == (tls_state = _tls_context_new(context)))
+				ERROR_LOG_GOTO(L_ERR, "Cannot create new TLS context");
+			state_owned = 1;
+		}
+
+		/* We need to update the BIO transporation layer pointer */
+		tls_state->in_bio_ctx.pipe = trans_in;
+		tls_state->out_bio_ctx.pipe = trans_out;
+
+		/* Popup the pipe to user-space code */
+		tls_state->user_state_to_push = 0;
+
+		if(_TLS_STATE_DISABLED == tls_state->state)
+			tls_state->state = _TLS_STATE_CONNECTING;
+
+		if(context->handshake_threads == 0 || tls_state->state != _TLS_STATE_CONNECTING) break;
+
+		/* The handshake is running on the handshake pool, and the connection is returned once the tunnel is established */
+		if(NULL == context->handshake_pool &&
+		   NULL == (context->handshake_pool = module_tls_handshake_pool_new(context->handshake_threads, context->handshake_queue_size,
+		                                                                    _handshake_job_step, _handshake_job_cancel, context)))
+		{
+			LOG_WARNING("Cannot start the handshake pool, the handshake runs on the thread serving the connection");
+			context->handshake_threads = 0;
+			break;
+		}
+
+		int rc = module_tls_handshake_pool_post(context->handshake_pool, tls_state);
+		if(ERROR_CODE(int) == rc)
+			ERROR_LOG_GOTO(L_ERR, "Cannot post the connection to the handshake pool");
+
+		/* If the handshake queue is full, the handshake runs on the thread serving the connection */
+		if(rc == 0)
+		{
+			__sync_fetch_and_add(&context->stat_hs_overflow, 1);
+			break;
+		}
+	}
+
+	in->type = _HANDLE_TYPE_IN;
+	in->tls = tls_state;
+	in->t_pipe = trans_in;
+	in->last_read_size = 0;
+	in->no_more_input = 0;
+
+	out->type = _HANDLE_TYPE_OUT;
+	out->tls = tls_state;
+	out->t_pipe = trans_out;
+
+	tls_state->input_alive = 1;
+
+	return 0;
+
+L_ERR:
+	if(NULL != trans_in)   itc_module_pipe_deallocate(trans_in);
+	if(NULL != trans_out)  itc_module_pipe_deallocate(trans_out);
+	if(NULL != tls_state && state_owned) _tls_context_free(tls_state);
+	return ERROR_CODE(int);
+}
+
 /**
  * @brief check if the pipe should use TLS
  * @param handle the pipe handle to check
@@ -1093,7 +1518,8 @@ static const char* _get_path(void* __restrict ctx, char* buf, size_t sz)
  **/
 static itc_module_flags_t _get_flags(void* __restrict ctx)
 {
-	(void)ctx;
+	_module_context_t* context = (_module_context_t*)ctx;
+	if(context->slave_mode) return 0;
 	return ITC_MODULE_FLAGS_EVENT_LOOP;
 }
 
@@ -1196,7 +1622,7 @@ static inline const _alpn_protocol_t* _get_next_protocol(const _alpn_protocol_t*
 static inline int _alpn_protocol_cmp(const unsigned char* left, const unsigned char* right)
 {
 	uint8_t size = left[0];
-	return memcmp(left, right, size);
+	return memcmp(left, right, (size_t)size + 1);
 }
 
 /**
@@ -1375,6 +1801,64 @@ static itc_module_property_value_t _get_prop(void* __restrict ctx, const char* s
 		ret.type = ITC_MODULE_PROPERTY_TYPE_INT;
 		ret.num = !(options & SSL_OP_NO_TLSv1_2);
 	}
+	else if(strcmp(sym, "session_cache_size") == 0)
+	{
+		ret.type = ITC_MODULE_PROPERTY_TYPE_INT;
+		if(SSL_CTX_get_session_cache_mode(context->ssl_context) & SSL_SESS_CACHE_SERVER)
+			ret.num = SSL_CTX_sess_get_cache_size(context->ssl_context);
+		else
+			ret.num = 0;
+	}
+	else if(strcmp(sym, "session_timeout") == 0)
+	{
+		ret.type = ITC_MODULE_PROPERTY_TYPE_INT;
+		ret.num = SSL_CTX_get_timeout(context->ssl_context);
+	}
+	else if(strcmp(sym, "session_ticket") == 0)
+	{
+		ret.type = ITC_MODULE_PROPERTY_TYPE_INT;
+		ret.num = !(SSL_CTX_get_options(context->ssl_context) & SSL_OP_NO_TICKET);
+	}
+	else if(strcmp(sym, "ticket_key_rotation") == 0)
+	{
+		ret.type = ITC_MODULE_PROPERTY_TYPE_INT;
+		ret.num = context->ticket_key_rotation;
+	}
+	else if(strcmp(sym, "stat_handshakes") == 0)
+	{
+		ret.type = ITC_MODULE_PROPERTY_TYPE_INT;
+		ret.num = (int64_t)__sync_fetch_and_add(&context->stat_handshakes, 0);
+	}
+	else if(strcmp(sym, "stat_resumed_handshakes") == 0)
+	{
+		ret.type = ITC_MODULE_PROPERTY_TYPE_INT;
+		ret.num = (int64_t)__sync_fetch_and_add(&context->stat_resumed, 0);
+	}
+	else if(strcmp(sym, "stat_full_handshakes") == 0)
+	{
+		ret.type = ITC_MODULE_PROPERTY_TYPE_INT;
+		ret.num = (int64_t)__sync_fetch_and_add(&context->stat_full, 0);
+	}
+	else if(strcmp(sym, "handshake_threads") == 0)
+	{
+		ret.type = ITC_MODULE_PROPERTY_TYPE_INT;
+		ret.num = context->handshake_threads;
+	}
+	else if(strcmp(sym, "handshake_queue_size") == 0)
+	{
+		ret.type = ITC_MODULE_PROPERTY_TYPE_INT;
+		ret.num = context->handshake_queue_size;
+	}
+	else if(strcmp(sym, "stat_handshake_offloaded") == 0)
+	{
+		ret.type = ITC_MODULE_PROPERTY_TYPE_INT;
+		ret.num = (int64_t)__sync_fetch_and_add(&context->stat_hs_offloaded, 0);
+	}
+	else if(strcmp(sym, "stat_handshake_overflow") == 0)
+	{
+		ret.type = ITC_MODULE_PROPERTY_TYPE_INT;
+		ret.num = (int64_t)__sync_fetch_and_add(&context->stat_hs_overflow, 0);
+	}
 	/* Other options should be the write-only options */
 	return ret;
 }
@@ -1385,7 +1869,6 @@ static itc_module_property_value_t _get_prop(void* __restrict ctx, const char* s
  * @param sym the symbol name
  * @param type the type of the property
  * @param data the data pointer
- * @note the only one property currently supported is the async_write flag
  * @return the status code
  **/
 static int _set_prop(void* __restrict ctx, const char* sym, itc_module_property_value_t value)
@@ -1402,6 +1885,68 @@ static int _set_prop(void* __restrict ctx, const char* sym, itc_module_property_
 		long options = 0;
 #endif
 		if(0);
+		_SYMBOL(_IS("session_cache_size"))
+		{
+			if(value.num < 0) ERROR_RETURN_LOG(int, "Invalid session cache size %"PRId64, value.num);
+			/* Because OpenSSL treats size 0 as unlimited, we turn off the cache instead */
+			if(value.num == 0)
+				SSL_CTX_set_session_cache_mode(context->ssl_context, SSL_SESS_CACHE_OFF);
+			else
+			{
+				SSL_CTX_set_session_cache_mode(context->ssl_context, SSL_SESS_CACHE_SERVER);
+				SSL_CTX_sess_set_cache_size(context->ssl_context, (long)value.num);
+			}
+			return 1;
+		}
+		_SYMBOL(_IS("session_timeout"))
+		{
+			if(value.num <= 0) ERROR_RETURN_LOG(int, "Invalid session timeout %"PRId64, value.num);
+			SSL_CTX_set_timeout(context->ssl_context, (long)value.num);
+			return 1;
+		}
+		_SYMBOL(_IS("session_ticket"))
+		{
+			if(value.num == 0)
+				SSL_CTX_set_options(context->ssl_context, SSL_OP_NO_TICKET);
+			else
+				SSL_CTX_clear_options(context->ssl_context, SSL_OP_NO_TICKET);
+			return 1;
+		}
+		_SYMBOL(_IS("ticket_key_rotation"))
+		{
+			if(value.num < 0 || value.num > UINT32_MAX) ERROR_RETURN_LOG(int, "Invalid ticket key rotation interval %"PRId64, value.num);
+
+			if((errno = pthread_mutex_lock(&context->ticket_mutex)) != 0)
+				ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the ticket key mutex");
+
+			context->ticket_key_rotation = (uint32_t)value.num;
+			if(context->ticket_key_from_file && value.num > 0)
+				LOG_WARNING("The session ticket keys are loaded from the key file, which are not rotated by the module");
+			int rc = 0;
+			/* If there's no key loaded from the key file, we need to generate the first key */
+			if(context->ticket_key_count == 0)
+				rc = _ticket_key_rotate(context);
+
+			if((errno = pthread_mutex_unlock(&context->ticket_mutex)) != 0)
+				ERROR_RETURN_LOG_ERRNO(int, "Cannot release the ticket key mutex");
+
+			if(ERROR_CODE(int) == rc || ERROR_CODE(int) == _ticket_key_cb_install(context))
+				ERROR_RETURN_LOG(int, "Cannot enable the ticket key ring");
+
+			return 1;
+		}
+		_SYMBOL(_IS("handshake_threads") || _IS("handshake_queue_size"))
+		{
+			if(NULL != context->handshake_pool)
+				ERROR_RETURN_LOG(int, "Cannot change the handshake pool after it has been started");
+			if(value.num < 0 || value.num > UINT32_MAX || (value.num == 0 && _IS("handshake_queue_size")))
+				ERROR_RETURN_LOG(int, "Invalid value %"PRId64" for %s", value.num, sym);
+			if(_IS("handshake_threads"))
+				context->handshake_threads = (uint32_t)value.num;
+			else
+				context->handshake_queue_size = (uint32_t)value.num;
+			return 1;
+		}
 		_SYMBOL(_IS("async_write"))              context->async_write = (value.num != 0);
 		_SYMBOL(_IS("ssl2") && 0 == value.num)   options |= SSL_OP_NO_SSLv2;
 		_SYMBOL(_IS("ssl3") && 0 == value.num)   options |= SSL_OP_NO_SSLv3;
@@ -1450,6 +1995,12 @@ static int _set_prop(void* __restrict ctx, const char* sym, itc_module_property_
 			}
 			return 1;
 		}
+		_SYMBOL(_IS("ticket_key_file"))
+		{
+			if(ERROR_CODE(int) == _ticket_key_load(context, value.str))
+				ERROR_RETURN_LOG(int, "Cannot load the session ticket keys from %s", value.str);
+			return 1;
+		}
 		_SYMBOL(_IS("dhparam"))
 		{
 			const char* filename = value.str;
@@ -1524,9 +2075,9 @@ DHPARAM_ERR:
 }
 
 
-static int  _cntl(void* __restrict context, void* __restrict pipe, uint32_t opcode, va_list va_args)
+static int  _cntl(void* __restrict ctx, void* __restrict pipe, uint32_t opcode, va_list va_args)
 {
-	(void)context;
+	_module_context_t* context = (_module_context_t*)ctx;
 	_handle_t* handle = (_handle_t*)pipe;
 
 	switch(opcode)
@@ -1575,6 +2126,15 @@ static int  _cntl(void* __restrict context, void* __restrict pipe, uint32_t opco
 			break;
 		}
 #endif
+		case MODULE_TLS_CNTL_REDELIVER:
+		{
+			if(handle->type != _HANDLE_TYPE_IN) ERROR_RETURN_LOG(int, "Cannot request redelivery on an output pipe");
+			if(!context->redeliver) ERROR_RETURN_LOG(int, "The transportation layer doesn't support redelivery");
+
+			if(ERROR_CODE(int) == _invoke_pipe_cntl(handle->t_pipe, (uint32_t)RUNTIME_API_PIPE_CNTL_MOD_OPCODE(context->transport_mod, MODULE_TCP_CNTL_REDELIVER_RAW)))
+				ERROR_RETURN_LOG(int, "Cannot request redelivery from the transportation layer");
+			break;
+		}
 		default:
 			ERROR_RETURN_LOG(int, "Invalid opcode");
 	}
@@ -1596,6 +2156,7 @@ itc_module_t module_tls_module_def = {
 	.context_size = sizeof(_module_context_t),
 	.module_init = _init,
 	.module_cleanup = _cleanup,
+	.on_exit = _on_exit,
 	.accept = _accept,
 	.deallocate = _dealloc,
 	.read = _read,
@@ -168,6 +168,26 @@ static runtime_api_pipe_t _get_module_func(const char* mod_path, const char* fun
 	return (ret | opcode);
 }
 
+static int _bind_module_func(runtime_api_pipe_t pipe, runtime_api_module_func_t* result)
+{
+	if(RUNTIME_API_PIPE_IS_NORMAL(pipe) || NULL == result)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	itc_module_type_t type = (itc_module_type_t)RUNTIME_API_PIPE_VIRTUAL_GET_MODULE(pipe);
+
+	const itc_modtab_instance_t* mi = itc_modtab_get_from_module_type(type);
+	if(NULL == mi) ERROR_RETURN_LOG(int, "Invalid module type 0x%x", type);
+
+	*result = NULL;
+
+	if(NULL != mi->module->get_func)
+		*result = mi->module->get_func(mi->context, RUNTIME_API_PIPE_VIRTUAL_GET_OPCODE(pipe));
+
+	LOG_DEBUG("Service module function 0x%x at module %s %s direct call", pipe, mi->path, NULL == *result ? "doesn't support" : "supports");
+
+	return 0;
+}
+
 static uint8_t _mod_open(const char* path)
 {
 	return itc_modtab_get_module_type_from_path(path);
@@ -244,7 +264,8 @@ runtime_api_address_table_t runtime_api_address_table = {
 	.mod_open = _mod_open,
 	.mod_cntl_prefix = _mod_cntl_prefix,
 	.set_type_hook = _set_type_hook,
-	.async_cntl = _async_cntl
+	.async_cntl = _async_cntl,
+	.bind_module_func = _bind_module_func
 };
 
 
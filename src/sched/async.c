@@ -24,6 +24,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
 #include <pthread.h>
 #include <sys/time.h>
 
@@ -46,6 +47,7 @@
 #include <sched/rscope.h>
 #include <sched/service.h>
 #include <sched/task.h>
+#include <sched/loop.h>
 #include <sched/async.h>
 
 #include <lang/prop.h>
@@ -82,6 +84,8 @@ typedef struct _handle_t {
 	sched_loop_t*       sched_loop;   /*!< The scheduler loop */
 	sched_task_t*       sched_task;   /*!< The scheduler task we are working on */
 	runtime_task_t*     exec_task;    /*!< The async_exec task */
+	uint64_t            post_time;    /*!< The time when the task has been posted to the queue in nanoseconds */
+	sched_loop_async_completion_t completion;  /*!< The completion we deliver to the scheduler loop once the task is done */
 } _handle_t;
 
 /**
@@ -93,12 +97,22 @@ typedef struct {
 } _fake_handle_t;
 STATIC_ASSERTION_TYPE_COMPATIBLE(_handle_t, magic_num, _fake_handle_t, magic_num);
 
+/**
+ * @brief The state of a async thread slot
+ **/
+typedef enum {
+	_THREAD_UNUSED,   /*!< The slot doesn't have a thread */
+	_THREAD_RUNNING,  /*!< The thread is running */
+	_THREAD_EXITED    /*!< The thread has exited because it's idle for a long time, but it haven't been joined yet */
+} _thread_state_t;
+
 /**
  * @brief The data structure for a async thread
  **/
 typedef struct {
-	thread_t*    thread; /*!< The thread object for this async thread */
-	_handle_t*   task;   /*!< The task this thread is current processing */
+	thread_t*        thread; /*!< The thread object for this async thread */
+	_thread_state_t  state;  /*!< The state of this thread slot (protected by the queue mutex) */
+	_handle_t*       task;   /*!< The task this thread is current processing */
 } _thread_data_t;
 
 /**
@@ -144,76 +158,74 @@ static struct {
 	_awaiter_t*          al_list;   /*!< The awaiting list */
 
 	/********* Thread releated data *******************/
-	uint32_t             nthreads;      /*!< The number of threads in the async processing thread pool */
-	_thread_data_t*      thread_data;   /*!< The thread data for each async processing thread */
+	uint32_t             min_threads;   /*!< The minimal number of threads in the async processing thread pool */
+	uint32_t             max_threads;   /*!< The maximum number of threads in the async processing thread pool */
+	uint32_t             idle_timeout;  /*!< How many seconds a thread can be idle before it exits, if we have more than min_threads */
+	uint32_t             nthreads;      /*!< The number of threads currently in the pool (protected by the queue mutex) */
+	uint32_t             nidle;         /*!< The number of threads waiting for the task (protected by the queue mutex) */
+	_thread_data_t*      thread_data;   /*!< The thread data for each async processing thread slot, max_threads slots in total */
+
+	/********* Statistics *****************************/
+	uint64_t             stat_tasks;         /*!< The number of async tasks has been executed */
+	uint64_t             stat_wait_ns;       /*!< The total time the tasks spent in the queue */
+	uint64_t             stat_run_ns;        /*!< The total time the tasks spent in the async_exec */
+	uint64_t             stat_max_wait_ns;   /*!< The maximum time a task spent in the queue */
+	uint64_t             stat_max_run_ns;    /*!< The maximum time a task spent in the async_exec */
 } _ctx;
 
 /**
- * @brief post a task completion event to the event qeueue
- * @param token The event queue token we used to post the task
- * @param handle The handle we want to pose
- * @return status code
+ * @brief Get current monotonic time in nanoseconds
+ * @return The timestamp
  **/
-static inline int _post_task_complete_event(itc_equeue_token_t token, _handle_t* handle)
+static inline uint64_t _now_ns(void)
 {
-	LOG_DEBUG("The task is not in the wait mode, sending the task compelted event to the event queue");
-	itc_equeue_event_t event;
-
-	event.type = ITC_EQUEUE_EVENT_TYPE_TASK;
-	event.task.loop = handle->sched_loop;
-	event.task.task = handle->sched_task;
-	event.task.async_handle = (runtime_api_async_handle_t*)handle;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
 
-	/* Send a event to the event queue, so that the scheduler knows about the event */
-	if(ERROR_CODE(int) == itc_equeue_put(token, event))
-	{
-		/* At this point, we directly dispose the handle */
-		if(handle->await_id != ERROR_CODE(uint32_t))
-		{
-			/* This means we need to remove it from the waiting list, becuase this
-			 * is really rare, so we just go through the linked list */
-			uint32_t prev = handle->state == _STATE_AWAITING ? ERROR_CODE(uint32_t) : _ctx.al_done;
-			/* If this is the first element in the done list, we need to update the al_done pointer*/
-			if(prev == handle->await_id)
-			{
-				_ctx.al_done = _ctx.al_list[prev].next;
-				prev = ERROR_CODE(uint32_t);
-			}
-			/* Search for the prevoius node */
-			for(;prev != ERROR_CODE(uint32_t) && _ctx.al_list[prev].next == handle->await_id; prev = _ctx.al_list[prev].next);
-			if(prev != ERROR_CODE(uint32_t))
-				_ctx.al_list[prev].next = _ctx.al_list[handle->await_id].next;
-			/* Insert the awaiter to the unused list */
-			_ctx.al_list[handle->await_id].next = _ctx.al_unused;
-			_ctx.al_unused = handle->await_id;
-		}
+/**
+ * @brief Update a maximum counter
+ * @param counter The counter to update
+ * @param value The new value
+ * @return nothing
+ **/
+static inline void _stat_update_max(uint64_t* counter, uint64_t value)
+{
+	uint64_t old;
+	do {
+		old = *(volatile uint64_t*)counter;
+		if(old >= value) return;
+	} while(!__sync_bool_compare_and_swap(counter, old, value));
+}
 
-		/*TODO: we could have an issue that the pending task in schedulder never get a chance to dispose the cerepsonding scheduler task,
-		 *      Currently, we just leave it there, because this is not likely to happen, and when this happens, it's more likely the entire
-		 *      system stop working from here.
-		 *      So we don't address this issue here, but we definitely needs to handle that
-		 **/
+/**
+ * @brief deliver the task completion to the scheduler loop which owns the task
+ * @details The completion is pushed to the scheduler loop directly, so it doesn't go through the
+ *          event queue and the dispatcher. Since the completion is a part of the handle, this won't
+ *          fail because of the queue is full
+ * @param handle The handle we want to deliver
+ * @return status code
+ **/
+static inline int _post_task_complete_event(_handle_t* handle)
+{
+	LOG_DEBUG("The task is not in the wait mode, delivering the task compelted event to the scheduler loop");
 
-		/* Finally we need to dispose it */
-		mempool_objpool_dealloc(_ctx.q_pool, handle);
+	handle->completion.task = handle->sched_task;
+	handle->completion.handle = (runtime_api_async_handle_t*)handle;
 
-		/* Of cousrse, we may have memory leak at this point, but it seems
-		 * we can't do anything better than that, because the data flow is
-		 * broken, and all the mechanism is not working here */
-		LOG_ERROR("Cannot send the task event to the event queue");
-		return ERROR_CODE(int);
-	}
+	if(ERROR_CODE(int) == sched_loop_async_completed(handle->sched_loop, &handle->completion))
+		ERROR_RETURN_LOG(int, "Cannot deliver the task completion to the scheduler loop");
 
 	return 0;
 }
 
 /**
- * @brief send the task completion event to the event qeueu
- * @param token The event queue token we want to use
+ * @brief deliver the task completion of the completed awaiters to the scheduler loop
  * @param set_error indicates if we need to set the status to error
  * @return status code
  **/
-static inline int _notify_compeleted_awaiters(itc_equeue_token_t token, int set_error)
+static inline int _notify_compeleted_awaiters(int set_error)
 {
 	int rc = 0;
 	/* the first thing we need to do is to clean the awaiting list */
@@ -221,7 +233,7 @@ static inline int _notify_compeleted_awaiters(itc_equeue_token_t token, int set_
 		ERROR_RETURN_LOG(int, "Cannot acquire the async task awaiting list mutex");
 	else
 	{
-		/* Here we need to send all the compelted awaiting tasks to the event queue */
+		/* Here we need to deliver all the compelted awaiting tasks to the scheduler loops */
 		uint32_t ptr;
 		for(ptr = _ctx.al_done; ptr != ERROR_CODE(uint32_t);)
 		{
@@ -231,17 +243,15 @@ static inline int _notify_compeleted_awaiters(itc_equeue_token_t token, int set_
 
 			if(set_error) this->task->status_code = ERROR_CODE(int);
 
-			if(ERROR_CODE(int) == _post_task_complete_event(token, this->task))
+			if(ERROR_CODE(int) == _post_task_complete_event(this->task))
 			{
-				LOG_ERROR("Cannot post the task compeletion event to the event queue");
+				LOG_ERROR("Cannot deliver the task compeletion to the scheduler loop");
 				rc = ERROR_CODE(int);
 			}
 
-			LOG_DEBUG("Awaiting async task completion event has been posted, await_id: %u, handle: %p", cur, this->task);
+			LOG_DEBUG("Awaiting async task completion has been delivered, await_id: %u, handle: %p", cur, this->task);
 
-			/* Since we have passed the task handle to the event queue, so we should not dispose it
-			 * The worst case of this is the event queue can not accept the handle, but in this case
-			 * the _post_task_complete_event function will be responsible for disposing the handle */
+			/* Since we have passed the task handle to the scheduler loop, so we should not dispose it */
 			this->valid = 0;
 			this->task = NULL;
 
@@ -258,6 +268,8 @@ static inline int _notify_compeleted_awaiters(itc_equeue_token_t token, int set_
 
 /**
  * @brief The main function of the async processor
+ * @details The thread exits if it has been idle for longer than the idle timeout and the pool
+ *          has more threads than the minimal number of threads
  * @param data The thread data
  * @return status code
  **/
@@ -267,26 +279,22 @@ static void* _async_processor_main(void* data)
 
 	_thread_data_t* thread_data = (_thread_data_t*)data;
 
-	itc_equeue_token_t token = itc_equeue_module_token(ITC_MODULE_EVENT_QUEUE_SIZE, ITC_EQUEUE_EVENT_TYPE_TASK);
-
-	if(ERROR_CODE(itc_equeue_token_t) == token)
-		ERROR_PTR_RETURN_LOG("Cannot get the enent queue token for the async processing thread");
-
 	uint32_t old;
 	do {
 		old = _ctx.num_ready;
 	}while(!__sync_bool_compare_and_swap(&_ctx.num_ready, old, old + 1));
 
+	uint64_t idle_since = _now_ns();
+	int idle_exit = 0;
+
 	for(;!_ctx.killed;)
 	{
-		/* We need to reset the previous task at this point, and the task should be able find by the scheudler thread
-		 * with the completion event. However, if the task failed to post to the event queue, then it's the point to
-		 * dispose it  */
+		/* At this point we need to reset the previous task, which has been delivered to the scheduler loop already */
 		thread_data->task = NULL;
 
 		/* Before we actually move ahead, we need to look at the awaiter list and make sure
 		 * all the compeleted awaiters has been notified at this time */
-		if(ERROR_CODE(int) == _notify_compeleted_awaiters(token, 0))
+		if(ERROR_CODE(int) == _notify_compeleted_awaiters(0))
 			LOG_ERROR("Cannot notify the completed awaiters");
 
 		/* Then we need to make sure that we have work to do */
@@ -299,35 +307,69 @@ static void* _async_processor_main(void* data)
 		abstime.tv_sec = now.tv_sec+1;
 		abstime.tv_nsec = 0;
 
+		_ctx.nidle ++;
+
 		while(_ctx.q_front == _ctx.q_rear && !_ctx.killed)
 		{
 			if((errno = pthread_cond_timedwait(&_ctx.q_cond, &_ctx.q_mutex, &abstime)) != 0 && errno != EINTR && errno != ETIMEDOUT)
-				ERROR_LOG_ERRNO_GOTO(UNLOCK, "Cannot wait for the reader cond var");
+			{
+				LOG_ERROR_ERRNO("Cannot wait for the reader cond var");
+				break;
+			}
 
 			/* Because it's possible that all the async processing thread is being blocked here, so we need to have a way
 			 * to make it work */
-			if(ERROR_CODE(int) == _notify_compeleted_awaiters(token, 0))
+			if(ERROR_CODE(int) == _notify_compeleted_awaiters(0))
 				LOG_ERROR("Cannot notify the completed awaiters");
 
-			abstime.tv_sec ++;
+			/* If we have more threads than we need for a long time, this thread should exit */
+			if(_ctx.q_front == _ctx.q_rear && _ctx.nthreads > _ctx.min_threads &&
+			   _now_ns() - idle_since >= (uint64_t)_ctx.idle_timeout * 1000000000ull)
+			{
+				idle_exit = 1;
+				break;
+			}
+
+			/* The awaiter notifications wake us up as well, so we can't just move the deadline by 1 second,
+			 * otherwise the deadline goes far beyond the idle timeout after a burst of notifications */
+			gettimeofday(&now, NULL);
+			abstime.tv_sec = now.tv_sec + 1;
+		}
+
+		_ctx.nidle --;
+
+		if(idle_exit)
+		{
+			_ctx.nthreads --;
+			thread_data->state = _THREAD_EXITED;
+			goto UNLOCK;
 		}
 
-		if(_ctx.killed) goto UNLOCK;
+		if(_ctx.killed || _ctx.q_front == _ctx.q_rear) goto UNLOCK;
 
 		/* At this point we can claim the task */
 		thread_data->task = _ctx.q_data[(_ctx.q_front ++) & (_ctx.q_cap - 1)];
 
 		/* At the same time, we need to check if this operation unblocks the writer */
 		if(_ctx.q_rear - _ctx.q_front == _ctx.q_cap - 1 && (errno = pthread_cond_signal(&_ctx.q_cond)) != 0)
-			ERROR_LOG_ERRNO_GOTO(UNLOCK, "Cannot disp notify the writer");
+			LOG_ERROR_ERRNO("Cannot disp notify the writer");
 
 UNLOCK:
 		if((errno = pthread_mutex_unlock(&_ctx.q_mutex)) != 0)
 			LOG_ERROR("Cannot release the async task queue mutex");
 
+		if(idle_exit)
+		{
+			LOG_DEBUG("Async processing thread %p exits, because it has been idle for %u seconds", thread_data, _ctx.idle_timeout);
+			return thread_data;
+		}
+
 		/* Then we need check if we have picked up a task, if not, we need to wait for another one */
 		if(thread_data->task == NULL) continue;
 
+		uint64_t start_time = _now_ns();
+		uint64_t wait_time = start_time - thread_data->task->post_time;
+
 		LOG_DEBUG("Staring the async exec task");
 		if(ERROR_CODE(int) == runtime_task_start(thread_data->task->exec_task))
 		{
@@ -336,6 +378,18 @@ UNLOCK:
 		}
 		else thread_data->task->status_code = 0;
 
+		idle_since = _now_ns();
+		uint64_t run_time = idle_since - start_time;
+
+		__sync_fetch_and_add(&_ctx.stat_tasks, 1);
+		__sync_fetch_and_add(&_ctx.stat_wait_ns, wait_time);
+		__sync_fetch_and_add(&_ctx.stat_run_ns, run_time);
+		_stat_update_max(&_ctx.stat_max_wait_ns, wait_time);
+		_stat_update_max(&_ctx.stat_max_run_ns, run_time);
+
+		LOG_DEBUG("The async exec task has been waiting in the queue for %lluns and running for %lluns",
+		          (unsigned long long)wait_time, (unsigned long long)run_time);
+
 		if(thread_data->task->await_id == ERROR_CODE(uint32_t))
 			thread_data->task->state = _STATE_DONE;
 
@@ -350,16 +404,16 @@ UNLOCK:
 
 		if(thread_data->task->await_id == ERROR_CODE(uint32_t))
 		{
-			LOG_DEBUG("The task is completed and post the task completion event");
-			if(ERROR_CODE(int) == _post_task_complete_event(token, thread_data->task))
-				LOG_ERROR("Cannot post the task completion event to the event queue");
+			LOG_DEBUG("The task is completed and deliver the task completion to the scheduler loop");
+			if(ERROR_CODE(int) == _post_task_complete_event(thread_data->task))
+				LOG_ERROR("Cannot deliver the task completion to the scheduler loop");
 		}
 		else
 			LOG_DEBUG("The task is not done yet, waiting for the async_cntl call");
 	}
 
 	/* Before we actually stop running, we need to make sure all the pending task has been handled propertly */
-	if(ERROR_CODE(int) == _notify_compeleted_awaiters(token, 1))
+	if(ERROR_CODE(int) == _notify_compeleted_awaiters(1))
 		ERROR_PTR_RETURN_LOG("Cannot notify the completed awaiters");
 
 	LOG_DEBUG("Async processing thread %p has been killed", thread_data);
@@ -367,6 +421,45 @@ UNLOCK:
 	return thread_data;
 }
 
+/**
+ * @brief Start a new async processing thread, because all the threads in the pool are busy
+ * @note This function must be called with the queue mutex held. Starting a thread with the mutex held
+ *       is slow, but this only happens when the pool grows, which should be rare. And this makes sure
+ *       the thread we start won't be missed by sched_async_kill
+ * @return status code
+ **/
+static inline int _grow_pool(void)
+{
+	uint32_t i;
+	for(i = 0; i < _ctx.max_threads && _ctx.thread_data[i].state == _THREAD_RUNNING; i ++);
+
+	if(i == _ctx.max_threads)
+		ERROR_RETURN_LOG(int, "Cannot find an unused async processing thread slot, code bug!");
+
+	_thread_data_t* slot = _ctx.thread_data + i;
+
+	if(slot->state == _THREAD_EXITED)
+	{
+		/* The thread doesn't need the queue mutex after it marks itself exited, so we won't be blocked here */
+		if(ERROR_CODE(int) == thread_free(slot->thread, NULL))
+			LOG_WARNING("Cannot join the exited async processing thread");
+		slot->thread = NULL;
+		slot->state = _THREAD_UNUSED;
+	}
+
+	slot->task = NULL;
+
+	if(NULL == (slot->thread = thread_new(_async_processor_main, slot, THREAD_TYPE_ASYNC)))
+		ERROR_RETURN_LOG(int, "Cannot start the new thread for the Async Task Processor");
+
+	slot->state = _THREAD_RUNNING;
+	_ctx.nthreads ++;
+
+	LOG_DEBUG("All the async processing threads are busy, the pool has grown to %u threads", _ctx.nthreads);
+
+	return 0;
+}
+
 /**
  * @brief setup the async task processor properties
  * @param symbol The symbol of the property
@@ -380,9 +473,29 @@ static inline int _set_prop(const char* symbol, lang_prop_value_t value, const v
 	if(strcmp(symbol, "nthreads") == 0)
 	{
 		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
-		_ctx.nthreads = (uint32_t)value.num;
-		LOG_DEBUG("Setting the number of async processing thread to %u", _ctx.nthreads);
+		_ctx.min_threads = _ctx.max_threads = (uint32_t)value.num;
+		LOG_DEBUG("Setting the number of async processing thread to %u", _ctx.min_threads);
+	}
+	else if(strcmp(symbol, "min_threads") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
+		_ctx.min_threads = (uint32_t)value.num;
+		LOG_DEBUG("Setting the minimal number of async processing thread to %u", _ctx.min_threads);
+	}
+	else if(strcmp(symbol, "max_threads") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
+		_ctx.max_threads = (uint32_t)value.num;
+		LOG_DEBUG("Setting the maximum number of async processing thread to %u", _ctx.max_threads);
+	}
+	else if(strcmp(symbol, "idle_timeout") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
+		_ctx.idle_timeout = (uint32_t)value.num;
+		LOG_DEBUG("Setting the async processing thread idle timeout to %u seconds", _ctx.idle_timeout);
 	}
+	else if(strcmp(symbol, "active_threads") == 0 || strncmp(symbol, "stat_", 5) == 0)
+		ERROR_RETURN_LOG(int, "Property scheduler.async.%s is read-only", symbol);
 	else if(strcmp(symbol, "queue_size") == 0)
 	{
 		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
@@ -421,10 +534,50 @@ static lang_prop_value_t _get_prop(const char* symbol, const void* param)
 	lang_prop_value_t ret = {
 		.type = LANG_PROP_TYPE_NONE
 	};
-	if(strcmp(symbol, "nthreads") == 0)
+	if(strcmp(symbol, "nthreads") == 0 || strcmp(symbol, "min_threads") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = _ctx.min_threads;
+	}
+	else if(strcmp(symbol, "max_threads") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = _ctx.max_threads;
+	}
+	else if(strcmp(symbol, "idle_timeout") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = _ctx.idle_timeout;
+	}
+	else if(strcmp(symbol, "active_threads") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = *(volatile uint32_t*)&_ctx.nthreads;
+	}
+	else if(strcmp(symbol, "stat_tasks") == 0)
 	{
 		ret.type = LANG_PROP_TYPE_INTEGER;
-		ret.num = _ctx.nthreads;
+		ret.num = (int64_t)_ctx.stat_tasks;
+	}
+	else if(strcmp(symbol, "stat_queue_wait_ns") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = (int64_t)_ctx.stat_wait_ns;
+	}
+	else if(strcmp(symbol, "stat_run_ns") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = (int64_t)_ctx.stat_run_ns;
+	}
+	else if(strcmp(symbol, "stat_max_queue_wait_ns") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = (int64_t)_ctx.stat_max_wait_ns;
+	}
+	else if(strcmp(symbol, "stat_max_run_ns") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = (int64_t)_ctx.stat_max_run_ns;
 	}
 	else if(strcmp(symbol, "queue_size") == 0)
 	{
@@ -443,7 +596,8 @@ static lang_prop_value_t _get_prop(const char* symbol, const void* param)
 int sched_async_init()
 {
 	_ctx.q_cap = 65536;
-	_ctx.nthreads = 1;
+	_ctx.min_threads = _ctx.max_threads = 1;
+	_ctx.idle_timeout = SCHED_ASYNC_IDLE_TIMEOUT;
 	_ctx.al_cap = 65536;
 	lang_prop_callback_t cb = {
 		.param         = NULL,
@@ -468,6 +622,21 @@ int sched_async_start()
 
 	_ctx.num_ready = 0;
 
+	if(_ctx.min_threads == 0)
+	{
+		LOG_WARNING("The async processor needs at least 1 thread, adjusted scheduler.async.min_threads to 1");
+		_ctx.min_threads = 1;
+	}
+
+	if(_ctx.max_threads < _ctx.min_threads)
+	{
+		LOG_WARNING("Adjusted scheduler.async.max_threads from %u to %u", _ctx.max_threads, _ctx.min_threads);
+		_ctx.max_threads = _ctx.min_threads;
+	}
+
+	_ctx.nthreads = _ctx.nidle = 0;
+	_ctx.stat_tasks = _ctx.stat_wait_ns = _ctx.stat_run_ns = _ctx.stat_max_wait_ns = _ctx.stat_max_run_ns = 0;
+
 	/* First thing, let's initialze the queue */
 	_ctx.q_front = _ctx.q_rear = 0;
 
@@ -507,16 +676,19 @@ int sched_async_start()
 	_ctx.al_list[_ctx.al_cap - 1].next = ERROR_CODE(uint32_t);
 	_ctx.al_done = ERROR_CODE(uint32_t);
 
-	/* Then, we need to start the async processing threads */
-	if(NULL == (_ctx.thread_data = (_thread_data_t*)calloc(sizeof(_thread_data_t), _ctx.nthreads)))
+	/* Then, we need to start the async processing threads, the pool grows up to max_threads on demand */
+	if(NULL == (_ctx.thread_data = (_thread_data_t*)calloc(sizeof(_thread_data_t), _ctx.max_threads)))
 		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the async task thread pool");
 
-	for(i = 0; i < _ctx.nthreads; i ++)
+	for(i = 0; i < _ctx.min_threads; i ++, _ctx.nthreads ++)
+	{
+		_ctx.thread_data[i].state = _THREAD_RUNNING;
 		if(NULL == (_ctx.thread_data[i].thread = thread_new(_async_processor_main, _ctx.thread_data + i, THREAD_TYPE_ASYNC)))
 			ERROR_LOG_GOTO(ERR, "Cannot start the new thread for the Async Task Processor");
+	}
 
 	/* After that we need wait until everyone gets ready */
-	while(_ctx.num_ready != _ctx.nthreads);
+	while(_ctx.num_ready != _ctx.min_threads);
 
 	/* Finally, we  should set the initialization flag */
 	_ctx.init = 1;
@@ -534,7 +706,7 @@ ERR:
 		/* We need to let everyone know they are killed */
 		pthread_cond_broadcast(&_ctx.q_cond);
 
-		for(i = 0; i < _ctx.nthreads; i ++)
+		for(i = 0; i < _ctx.max_threads; i ++)
 			if(_ctx.thread_data[i].thread != NULL)
 				thread_free(_ctx.thread_data[i].thread, NULL);
 
@@ -559,15 +731,25 @@ int sched_async_kill()
 	if(!_ctx.init) ERROR_RETURN_LOG(int, "The async processor haven't been started yet");
 	int rc = 0;
 
+	/* We need the queue mutex, so that nobody is growing the pool at the same time */
+	if((errno = pthread_mutex_lock(&_ctx.q_mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot acquire the async task queue mutex");
+
 	_ctx.killed = 1;
 
 	/* Let't kill all the async processing thread at this point */
 	pthread_cond_broadcast(&_ctx.q_cond);
+
+	if((errno = pthread_mutex_unlock(&_ctx.q_mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot release the async task queue mutex");
+
 	uint32_t i;
-	for(i = 0; i < _ctx.nthreads; i ++)
-		if(ERROR_CODE(int) == thread_free(_ctx.thread_data[i].thread, NULL))
+	for(i = 0; i < _ctx.max_threads; i ++)
+		if(NULL != _ctx.thread_data[i].thread && ERROR_CODE(int) == thread_free(_ctx.thread_data[i].thread, NULL))
 			rc = ERROR_CODE(int);
 	free(_ctx.thread_data);
+	_ctx.thread_data = NULL;
+	_ctx.nthreads = 0;
 
 	/* We need to dispose the queue */
 	for(i = _ctx.q_front; i < _ctx.q_rear; i ++)
@@ -721,11 +903,17 @@ int sched_async_task_post(sched_loop_t* loop, sched_task_t* task)
 	}
 
 	/* Then we need actually put the handle in the queue */
+	handle->post_time = _now_ns();
 	_ctx.q_data[(_ctx.q_rear ++) & (_ctx.q_cap - 1)] = handle;
 
-	/* If this queue is previously empty, then we need to notify the reader */
-	if(_ctx.q_rear - _ctx.q_front == 1 && (errno = pthread_cond_signal(&_ctx.q_cond)) != 0)
-		ERROR_RETURN_LOG(int, "Cannot notify the reader about the incoming task");
+	/* If there's any idle thread, we need to notify it */
+	if(_ctx.nidle > 0 && (errno = pthread_cond_signal(&_ctx.q_cond)) != 0)
+		LOG_ERROR_ERRNO("Cannot notify the reader about the incoming task");
+
+	/* If the queue is deeper than the number of idle threads, the task has to wait for a busy
+	 * thread, so we need more threads if it's allowed */
+	if(_ctx.q_rear - _ctx.q_front > _ctx.nidle && _ctx.nthreads < _ctx.max_threads && ERROR_CODE(int) == _grow_pool())
+		LOG_WARNING("Cannot grow the async processing thread pool");
 
 RET:
 	if((errno = pthread_mutex_unlock(&_ctx.q_mutex)) != 0)
@@ -18,6 +18,7 @@
 #include <fcntl.h>
 #include <grp.h>
 #include <signal.h>
+#include <pthread.h>
 
 #include <error.h>
 #include <constants.h>
@@ -98,6 +99,11 @@ static int _lock_fd = -1;
  **/
 __thread int _is_dispatcher = 0;
 
+/**
+ * @brief The dispatcher thread, which is the only thread can handle the control socket
+ **/
+static pthread_t _dispatcher_thread;
+
 /**
  * @brief The lock suffix
  **/
@@ -402,7 +408,13 @@ ERR:
 
 static void _sighup_handle(int sigid)
 {
-	(void)sigid;
+	/* The dispatcher thread is blocked until there's any event, so if the signal is delivered to
+	 * other threads, we should forward the signal to the dispatcher thread */
+	if(!_is_dispatcher)
+	{
+		pthread_kill(_dispatcher_thread, sigid);
+		return;
+	}
 	if(ERROR_CODE(int) == sched_daemon_read_control_sock())
 		LOG_WARNING("Could not execute command");
 }
@@ -568,6 +580,7 @@ int sched_daemon_daemonize(int fork_twice)
 	}
 
 	_is_dispatcher = 1;
+	_dispatcher_thread = pthread_self();
 
 	if(signal(SIGHUP, _sighup_handle) == SIG_ERR)
 		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot set SIGHUP handler for daemon communication");
@@ -50,28 +50,6 @@ static uint32_t _queue_size = SCHED_LOOP_EVENT_QUEUE_SIZE;
  **/
 static uint32_t _round_robin_move_threshold = 0;
 
-/**
- * @brief a scheduler loop context
- **/
-struct _sched_loop_t {
-	sched_loop_t* next;              /*!< the next thread in the loop linked list */
-	int       started;               /*!< if the loop has started */
-	thread_t* thread;                /*!< the thread object */
-	uint32_t  thread_id;             /*!< the thread id */
-	uint32_t  front;                 /*!< the front pointer of the queue */
-	uint32_t  rear;                  /*!< the rear pointer of the queue */
-	uint32_t  size;                  /*!< the size of the queue */
-	pthread_mutex_t mutex;           /*!< the mutex used with the cond */
-	pthread_cond_t  cond;            /*!< the cond var that is used for the loop wait for new event */
-	uint32_t   num_running_reqs;     /*!< How many requests are currently running by this worker */
-	uint32_t   pending_reqs_id_begin;/*!< The begining ID of the pending request */
-	uint32_t   pending_reqs_id_end;  /*!< The ending ID of the pending request */
-	uintpad_t __padding__[0];
-	itc_equeue_event_t events[0];    /*!< the actual event queue */
-};
-STATIC_ASSERTION_LAST(sched_loop_t, events);
-STATIC_ASSERTION_SIZE(sched_loop_t, events, 0);
-
 /**
  * @brief The data structure we used to carry the pending event
  * @details A pending event is a event that should be sent to specified
@@ -97,6 +75,49 @@ typedef struct {
 	_pending_event_t* list; /*!< The actual list */
 } _pending_list_t;
 
+/**
+ * @brief The worker mode, which describes how the events are delivered to the worker threads
+ **/
+typedef enum {
+	_MODE_DISPATCHER,    /*!< The dispatcher thread takes all the events and round-robin them to the workers */
+	_MODE_WORK_STEALING  /*!< The workers take events from the equeue directly and steal the IO events from each other */
+} _mode_t;
+
+/**
+ * @brief The current worker mode
+ **/
+static _mode_t _mode = _MODE_DISPATCHER;
+
+/**
+ * @brief a scheduler loop context
+ **/
+struct _sched_loop_t {
+	sched_loop_t* next;              /*!< the next thread in the loop linked list */
+	int       started;               /*!< if the loop has started */
+	thread_t* thread;                /*!< the thread object */
+	uint32_t  thread_id;             /*!< the thread id */
+	uint32_t  front;                 /*!< the front pointer of the queue */
+	uint32_t  rear;                  /*!< the rear pointer of the queue */
+	uint32_t  size;                  /*!< the size of the queue */
+	pthread_mutex_t mutex;           /*!< the mutex used with the cond */
+	pthread_cond_t  cond;            /*!< the cond var that is used for the loop wait for new event */
+	uint32_t   num_running_reqs;     /*!< How many requests are currently running by this worker */
+	uint32_t   pending_reqs_id_begin;/*!< The begining ID of the pending request */
+	uint32_t   pending_reqs_id_end;  /*!< The ending ID of the pending request */
+	uint32_t   idle;                 /*!< If the worker is sleeping on the cond var (only used in work-stealing mode) */
+	_pending_list_t     overflow;    /*!< The task events can not fit into the event queue (only used in work-stealing mode, protected by the mutex) */
+	uint64_t            deque_top;   /*!< The top pointer of the work-stealing deque, thieves take events from here */
+	uint64_t            deque_bottom;/*!< The bottom pointer of the work-stealing deque, only the owner thread can modify this */
+	itc_equeue_event_t* deque;       /*!< The work-stealing deque of the IO events (only used in work-stealing mode) */
+	sched_loop_async_completion_t* async_list;  /*!< The async task completions pushed by the async processor, in LIFO order */
+	sched_loop_async_completion_t* async_ready; /*!< The async task completions taken by the worker, in FIFO order (owner thread only) */
+	int                 wait_abort;  /*!< Indicates the worker should stop waiting for the equeue (only used in work-stealing mode) */
+	uintpad_t __padding__[0];
+	itc_equeue_event_t events[0];    /*!< the actual event queue */
+};
+STATIC_ASSERTION_LAST(sched_loop_t, events);
+STATIC_ASSERTION_SIZE(sched_loop_t, events, 0);
+
 /**
  * @brief the scheduler list
  **/
@@ -137,6 +158,23 @@ static itc_equeue_event_mask_t _last_mask;
  **/
 static itc_module_type_t _mod_mem = ERROR_CODE(itc_module_type_t);
 
+/**
+ * @brief The mutex that makes sure only one worker takes events from the equeue at the same time
+ * @note This is only used in the work-stealing mode, the worker holds this mutex is the one that
+ *       polls the equeue, all other workers either process events or sleep on their own cond var
+ **/
+static pthread_mutex_t _equeue_mutex;
+
+/**
+ * @brief The equeue scheduler token shared by all the workers in the work-stealing mode
+ **/
+static itc_equeue_token_t _equeue_token = ERROR_CODE(itc_equeue_token_t);
+
+/**
+ * @brief Indicates if there's a worker currently polling the equeue
+ **/
+static volatile uint32_t _equeue_polling = 0;
+
 /**
  * @brief decide if the scheduler is saturated
  * @param scheduler The scheduler to check
@@ -166,6 +204,9 @@ static inline sched_loop_t* _context_new(uint32_t tid)
 	ret->size = _queue_size;
 	ret->thread = NULL;
 
+	if(_mode == _MODE_WORK_STEALING && NULL == (ret->deque = (itc_equeue_event_t*)malloc(sizeof(itc_equeue_event_t) * _queue_size)))
+		ERROR_LOG_ERRNO_GOTO(DEQUE_ERR, "Cannot allocate memory for the work-stealing deque");
+
 	if((errno = pthread_mutex_init(&ret->mutex, NULL)) != 0) ERROR_LOG_ERRNO_GOTO(MUTEX_ERR, "Cannot initialize the shceduler local mutex");
 	if((errno = pthread_cond_init(&ret->cond, NULL)) != 0) ERROR_LOG_ERRNO_GOTO(COND_ERR, "Cannot initialize the scheduler local condvar");
 
@@ -177,10 +218,54 @@ COND_ERR:
 	if((errno = pthread_mutex_destroy(&ret->mutex)) != 0)
 		LOG_WARNING_ERRNO("Cannot dispose the pthread mutex");
 MUTEX_ERR:
+	if(NULL != ret->deque) free(ret->deque);
+DEQUE_ERR:
 	free(ret);
 	return NULL;
 }
 
+/**
+ * @brief Dispose an event which haven't been processed
+ * @param event The event to dispose
+ * @return status code
+ **/
+static inline int _event_dispose(itc_equeue_event_t* event)
+{
+	int rc = 0;
+	switch(event->type)
+	{
+		case ITC_EQUEUE_EVENT_TYPE_IO:
+		{
+			if(itc_module_pipe_deallocate(event->io.in) == ERROR_CODE(int))
+			{
+				LOG_ERROR("Cannot deallocate the input pipe");
+				rc = ERROR_CODE(int);
+			}
+			if(itc_module_pipe_deallocate(event->io.out) == ERROR_CODE(int))
+			{
+				LOG_ERROR("Cannot deallocate the output pipe");
+				rc = ERROR_CODE(int);
+			}
+			break;
+		}
+		case ITC_EQUEUE_EVENT_TYPE_TASK:
+		{
+			/* We don't call the cleanup task at this point for now.
+			 * TODO: do we need a way to make it properly cleaned up */
+			if(NULL != event->task.async_handle && ERROR_CODE(int) == sched_async_handle_dispose(event->task.async_handle))
+			{
+				LOG_ERROR("Cannot dispose the unprocessed async handle");
+				rc = ERROR_CODE(int);
+			}
+			break;
+		}
+		default:
+			LOG_WARNING("Invalid event type in the queue, may indicates code bug");
+	}
+
+	return rc;
+}
+
 /**
  * @brief Dispose the scheduler context
  * @param ctx The context
@@ -203,44 +288,612 @@ static inline int _context_free(sched_loop_t* ctx)
 
 	uint32_t i;
 	for(i = ctx->front; i != ctx->rear; i ++)
+		if(ERROR_CODE(int) == _event_dispose(ctx->events + (i & (ctx->size - 1))))
+			rc = ERROR_CODE(int);
+
+	uint64_t j;
+	for(j = ctx->deque_top; ctx->deque != NULL && j < ctx->deque_bottom; j ++)
+		if(ERROR_CODE(int) == _event_dispose(ctx->deque + (j & (ctx->size - 1))))
+			rc = ERROR_CODE(int);
+
+	for(;ctx->overflow.list != NULL;)
 	{
-		uint32_t p = i & (ctx->size - 1);
+		_pending_event_t* this = ctx->overflow.list;
+		ctx->overflow.list = this->next;
+		if(ERROR_CODE(int) == _event_dispose(&this->event))
+			rc = ERROR_CODE(int);
+		free(this);
+	}
 
-		switch(ctx->events[p].type)
+	sched_loop_async_completion_t* lists[] = {ctx->async_ready, ctx->async_list};
+	for(i = 0; i < sizeof(lists) / sizeof(lists[0]); i ++)
+		for(;lists[i] != NULL;)
 		{
-			case ITC_EQUEUE_EVENT_TYPE_IO:
+			sched_loop_async_completion_t* this = lists[i];
+			/* The completion is a part of the handle, so we must move to the next one before disposing the handle */
+			lists[i] = this->next;
+			if(ERROR_CODE(int) == sched_async_handle_dispose(this->handle))
 			{
-				if(itc_module_pipe_deallocate(ctx->events[p].io.in) == ERROR_CODE(int))
-				{
-					LOG_ERROR("Cannot deallocate the input pipe");
-					rc = ERROR_CODE(int);
-				}
-				if(itc_module_pipe_deallocate(ctx->events[p].io.out) == ERROR_CODE(int))
-				{
-					LOG_ERROR("Cannot deallocate the output pipe");
-					rc = ERROR_CODE(int);
-				}
-				break;
+				LOG_ERROR("Cannot dispose the undelivered async handle");
+				rc = ERROR_CODE(int);
 			}
-			case ITC_EQUEUE_EVENT_TYPE_TASK:
+		}
+
+	if(NULL != ctx->deque) free(ctx->deque);
+
+	free(ctx);
+
+	return rc;
+}
+
+/**
+ * @brief Check if there's a new service graph is being deployed and switch to the new service graph
+ * @param context The scheduler context
+ * @param stc The scheduler task context
+ * @param current_service The service graph that is currently used by this worker
+ * @param old_service_refcnt The number of requests that still using the old service graph
+ * @return nothing
+ **/
+static inline void _deploy_check(sched_loop_t* context, sched_task_context_t* stc, const sched_service_t** current_service, uint32_t* old_service_refcnt)
+{
+	if(_deploying_service == NULL || *current_service == _deploying_service) return;
+
+	LOG_DEBUG("Switching the service graph from %p to %p", _service, *current_service);
+	*current_service = _deploying_service;
+	if(ERROR_CODE(uint32_t) == (*old_service_refcnt = sched_task_num_concurrent_requests(stc)))
+		LOG_ERROR("Cannot get the number of old service refcount");
+	else
+		LOG_DEBUG("Num of request that using old service graph: %u", *old_service_refcnt);
+
+	if(*old_service_refcnt == 0)
+	{
+		LOG_DEBUG("The old service isn't in use, mark the deployment as finished");
+		uint32_t current;
+		do {
+			current = _deployed_count;
+		} while(!__sync_bool_compare_and_swap(&_deployed_count, current, current + 1));
+		LOG_NOTICE("Deployment process compelted for scheduler #%u", context->thread_id);
+	}
+}
+
+/**
+ * @brief Get the next async task completion that has been delivered to this worker
+ * @details The async processor pushes the completions to the lock-free list, which is in LIFO order.
+ *          Once our FIFO list is drained, we take the entire list at once and reverse it, so that the
+ *          completions are handled in the order they arrived
+ * @param ctx The scheduler context
+ * @param buf The buffer used to return the task event
+ * @return 1 if we got a completion, 0 if there's no completion
+ **/
+static inline int _async_get(sched_loop_t* ctx, itc_equeue_event_t* buf)
+{
+	if(NULL == ctx->async_ready && NULL != *(sched_loop_async_completion_t* const volatile*)&ctx->async_list)
+	{
+		sched_loop_async_completion_t* list = __sync_lock_test_and_set(&ctx->async_list, NULL);
+		for(;NULL != list;)
+		{
+			sched_loop_async_completion_t* next = list->next;
+			list->next = ctx->async_ready;
+			ctx->async_ready = list;
+			list = next;
+		}
+	}
+
+	sched_loop_async_completion_t* completion = ctx->async_ready;
+
+	if(NULL == completion) return 0;
+
+	ctx->async_ready = completion->next;
+
+	buf->type = ITC_EQUEUE_EVENT_TYPE_TASK;
+	buf->task.loop = ctx;
+	buf->task.task = completion->task;
+	buf->task.async_handle = completion->handle;
+
+	return 1;
+}
+
+/**
+ * @brief Check if there's async task completions haven't been taken by the worker
+ * @param ctx The scheduler context
+ * @return The check result
+ **/
+static inline int _async_pending(const sched_loop_t* ctx)
+{
+	return NULL != ctx->async_ready || NULL != *(sched_loop_async_completion_t* const volatile*)&ctx->async_list;
+}
+
+/**
+ * @brief Get the number of IO events in the work-stealing deque
+ * @param ctx The owner context
+ * @return The number of events
+ **/
+static inline uint64_t _deque_size(const sched_loop_t* ctx)
+{
+	uint64_t top = *(const volatile uint64_t*)&ctx->deque_top;
+	uint64_t bottom = *(const volatile uint64_t*)&ctx->deque_bottom;
+	return (int64_t)(bottom - top) > 0 ? bottom - top : 0;
+}
+
+/**
+ * @brief Push a new IO event to the bottom of the work-stealing deque
+ * @note Only the owner thread of the deque can call this function
+ * @param ctx The owner context
+ * @param event The event to push
+ * @return 1 if the event has been pushed, 0 if the deque is full
+ **/
+static inline int _deque_push(sched_loop_t* ctx, const itc_equeue_event_t* event)
+{
+	uint64_t bottom = ctx->deque_bottom;
+	uint64_t top = *(volatile uint64_t*)&ctx->deque_top;
+
+	if(bottom - top >= ctx->size) return 0;
+
+	ctx->deque[bottom & (ctx->size - 1)] = *event;
+
+	/* Make sure the event is visible before the thieves can see the new bottom */
+	__sync_synchronize();
+
+	*(volatile uint64_t*)&ctx->deque_bottom = bottom + 1;
+
+	return 1;
+}
+
+/**
+ * @brief Take an IO event from the top of the work-stealing deque
+ * @note This is used by both the thieves and the owner. The owner doesn't pop the bottom as
+ *       the classic Chase-Lev deque does, because we want the requests are served in the order
+ *       they arrived. Since only the owner pushes, the slot at the top won't be overwritten
+ *       until the top pointer moves ahead, thus the event we read is valid once the CAS succeeded
+ * @param ctx The owner of the deque
+ * @param buf The buffer used to return the event
+ * @param was_full If given, indicates if the deque was full right before the event is taken
+ * @return 1 if we got an event, 0 if the deque is empty or we lose the race
+ **/
+static inline int _deque_take(sched_loop_t* ctx, itc_equeue_event_t* buf, int* was_full)
+{
+	uint64_t top = *(volatile uint64_t*)&ctx->deque_top;
+	__sync_synchronize();
+	uint64_t bottom = *(volatile uint64_t*)&ctx->deque_bottom;
+
+	if((int64_t)(bottom - top) <= 0) return 0;
+
+	*buf = ctx->deque[top & (ctx->size - 1)];
+
+	if(!__sync_bool_compare_and_swap(&ctx->deque_top, top, top + 1)) return 0;
+
+	/* The owner may have filled the deque after we read the bottom, so we read it again after the CAS,
+	 * which is a full barrier. Since the top was unchanged until the CAS, any push the owner made
+	 * before it checked the deque space is visible now */
+	if(NULL != was_full)
+		*was_full = (*(volatile uint64_t*)&ctx->deque_bottom - top >= ctx->size);
+
+	return 1;
+}
+
+/**
+ * @brief Try to steal an IO event from other workers
+ * @param ctx The thief context
+ * @param buf The buffer used to return the stolen event
+ * @return 1 if we stole an event, 0 if there's nothing to steal
+ **/
+static inline int _steal(sched_loop_t* ctx, itc_equeue_event_t* buf)
+{
+	sched_loop_t* victim;
+	for(victim = ctx->next == NULL ? _scheds : ctx->next; victim != ctx; victim = victim->next == NULL ? _scheds : victim->next)
+	{
+		int was_full;
+		if(_deque_take(victim, buf, &was_full))
+		{
+			LOG_DEBUG("Scheduler %u: stole an IO event from scheduler %u", ctx->thread_id, victim->thread_id);
+
+			/* If the victim is blocked on the equeue with a full deque, it's only waiting for the task events.
+			 * Since it has space for the IO events now, we need to make it update the event mask */
+			if(was_full && _equeue_polling && ERROR_CODE(int) == itc_equeue_wait_interrupt())
+				LOG_WARNING("Cannot interrupt the equeue wait");
+
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Check if there's any IO events other workers can steal
+ * @param ctx The thief context
+ * @return The check result
+ **/
+static inline int _stealable(const sched_loop_t* ctx)
+{
+	const sched_loop_t* victim;
+	for(victim = _scheds; victim != NULL; victim = victim->next)
+		if(victim != ctx && _deque_size(victim) > 0)
+			return 1;
+	return 0;
+}
+
+/**
+ * @brief Get the event mask the worker should use when it takes events from the equeue
+ * @note The task events are always acceptable, since they need to be delivered to the
+ *       owner worker anyway. The IO events are acceptable as long as we still have space
+ *       in the deque, even though the worker is saturated, since other workers can steal them. <br/>
+ *       This is also used as the equeue wait interrupt callback, which updates the wait abort flag
+ * @param data The scheduler context
+ * @return The event mask
+ **/
+static itc_equeue_event_mask_t _steal_event_mask(void* data)
+{
+	sched_loop_t* ctx = (sched_loop_t*)data;
+	itc_equeue_event_mask_t ret = ITC_EQUEUE_EVENT_MASK_NONE;
+
+	/* The async task completions are not in the equeue, so the worker blocked on the equeue should stop
+	 * waiting once it has been killed or it gets any completion. The barrier pairs with the one in
+	 * sched_loop_async_completed, so either we can see the completion or the async processor can see
+	 * the polling flag and interrupt us */
+	__sync_synchronize();
+	ctx->wait_abort = _killed || _async_pending(ctx);
+
+	ITC_EQUEUE_EVENT_MASK_ADD(ret, ITC_EQUEUE_EVENT_TYPE_TASK);
+
+	if(_deque_size(ctx) < ctx->size)
+		ITC_EQUEUE_EVENT_MASK_ADD(ret, ITC_EQUEUE_EVENT_TYPE_IO);
+
+	return ret;
+}
+
+/**
+ * @brief Put a task event to the event queue of the worker which owns the task
+ * @note In the work-stealing mode, multiple workers can put events to the same queue, so
+ *       we need the queue mutex. When the queue is full, the event goes to the overflow list
+ * @param target The target worker
+ * @param event The event to put
+ * @return status code
+ **/
+static inline int _inbox_put(sched_loop_t* target, const itc_equeue_event_t* event)
+{
+	int rc = 0;
+
+	if((errno = pthread_mutex_lock(&target->mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot acquire the thread local mutex");
+
+	if(target->rear - target->front < target->size)
+	{
+		target->events[target->rear & (target->size - 1)] = *event;
+		BARRIER();
+		arch_atomic_sw_increment_u32(&target->rear);
+	}
+	else
+	{
+		_pending_event_t* pe = (_pending_event_t*)malloc(sizeof(*pe));
+		if(NULL == pe)
+		{
+			LOG_ERROR_ERRNO("Cannot allocate memory for the overflow event");
+			rc = ERROR_CODE(int);
+		}
+		else
+		{
+			LOG_DEBUG("The event queue of scheduler %u is full, add the event to the overflow list", target->thread_id);
+			pe->event = *event;
+			pe->next = target->overflow.list;
+			target->overflow.list = pe;
+			target->overflow.size ++;
+		}
+	}
+
+	if(target->idle && (errno = pthread_cond_signal(&target->cond)) != 0)
+		LOG_WARNING_ERRNO("Cannot notify new incoming event for the scheduler thread %u", target->thread_id);
+
+	if((errno = pthread_mutex_unlock(&target->mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot release the thread local mutex");
+
+	return rc;
+}
+
+/**
+ * @brief Get the next task event from the worker's own event queue
+ * @param ctx The scheduler context
+ * @param buf The buffer used to return the event
+ * @return 1 if we got an event, 0 if the queue is empty
+ **/
+static inline int _inbox_get(sched_loop_t* ctx, itc_equeue_event_t* buf)
+{
+	if(ctx->front != ctx->rear)
+	{
+		*buf = ctx->events[ctx->front & (ctx->size - 1)];
+		BARRIER();
+		arch_atomic_sw_increment_u32(&ctx->front);
+		return 1;
+	}
+
+	if(NULL == ctx->overflow.list) return 0;
+
+	int ret = 0;
+
+	if((errno = pthread_mutex_lock(&ctx->mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot acquire the thread local mutex");
+
+	_pending_event_t* pe = ctx->overflow.list;
+	if(NULL != pe)
+	{
+		ctx->overflow.list = pe->next;
+		ctx->overflow.size --;
+		*buf = pe->event;
+		free(pe);
+		ret = 1;
+	}
+
+	if((errno = pthread_mutex_unlock(&ctx->mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot release the thread local mutex");
+
+	return ret;
+}
+
+/**
+ * @brief Wake up the workers which are sleeping
+ * @param self The caller context, which shouldn't be waken up
+ * @param n How many workers we want to wake up at most
+ * @return nothing
+ **/
+static inline void _wake_idle_workers(const sched_loop_t* self, uint32_t n)
+{
+	sched_loop_t* sched;
+
+	__sync_synchronize();
+
+	for(sched = _scheds; n > 0 && sched != NULL; sched = sched->next)
+	{
+		if(sched == self || !sched->idle) continue;
+
+		if((errno = pthread_mutex_lock(&sched->mutex)) != 0)
+			LOG_WARNING_ERRNO("Cannot acquire the thread local mutex");
+
+		if(sched->idle)
+		{
+			if((errno = pthread_cond_signal(&sched->cond)) != 0)
+				LOG_WARNING_ERRNO("Cannot wake up the idle scheduler thread %u", sched->thread_id);
+			sched->idle = 0;
+			n --;
+		}
+
+		if((errno = pthread_mutex_unlock(&sched->mutex)) != 0)
+			LOG_WARNING_ERRNO("Cannot release the thread local mutex");
+	}
+}
+
+/**
+ * @brief Take a batch of events from the equeue and distribute them
+ * @details Only one worker can poll the equeue at the same time. The task events are sent to the
+ *          worker which owns the task and the IO events are pushed to the caller's deque, so that
+ *          the idle workers can steal them. After that, we wake up the idle workers, one of them
+ *          will take over the equeue polling and the rest of them will steal the IO events
+ * @param ctx The caller context
+ * @param block If we need to block the thread until the equeue have events
+ * @return The number of events has been taken, 0 when nothing taken or another worker is polling
+ **/
+static inline uint32_t _equeue_pull(sched_loop_t* ctx, int block)
+{
+	if(pthread_mutex_trylock(&_equeue_mutex) != 0) return 0;
+
+	_equeue_polling = 1;
+
+	uint32_t ret = 0, n_io = 0, i;
+	itc_equeue_event_t events[32];
+
+	if(ERROR_CODE(itc_equeue_token_t) == _equeue_token) goto RET;
+
+	if(block)
+	{
+		itc_equeue_wait_interrupt_t ir = {
+			.func = _steal_event_mask,
+			.data = ctx
+		};
+
+		ctx->wait_abort = 0;
+
+		if(ERROR_CODE(int) == itc_equeue_wait(_equeue_token, &ctx->wait_abort, &ir))
+			ERROR_LOG_GOTO(RET, "Cannot wait for the event queue gets ready");
+
+		if(_killed) goto RET;
+	}
+
+	itc_equeue_event_mask_t mask = _steal_event_mask(ctx);
+
+	int ready = itc_equeue_ready(_equeue_token, mask);
+	if(ERROR_CODE(int) == ready)
+		ERROR_LOG_GOTO(RET, "Cannot check if the event queue is ready");
+
+	if(!ready) goto RET;
+
+	uint32_t batch_size = sizeof(events) / sizeof(events[0]);
+	if(ITC_EQUEUE_EVENT_MASK_ALLOWS(mask, ITC_EQUEUE_EVENT_TYPE_IO) && ctx->size - _deque_size(ctx) < batch_size)
+		batch_size = (uint32_t)(ctx->size - _deque_size(ctx));
+
+	if(ERROR_CODE(uint32_t) == (ret = itc_equeue_take(_equeue_token, mask, events, batch_size)))
+	{
+		ret = 0;
+		ERROR_LOG_GOTO(RET, "Cannot take next event from the event queue");
+	}
+
+	for(i = 0; i < ret; i ++)
+	{
+		if(events[i].type == ITC_EQUEUE_EVENT_TYPE_TASK)
+		{
+			if(ERROR_CODE(int) == _inbox_put(events[i].task.loop, events + i))
 			{
-				/* We don't call the cleanup task at this point for now.
-				 * TODO: do we need a way to make it properly cleaned up */
-				if(NULL != ctx->events[p].task.async_handle && ERROR_CODE(int) == sched_async_handle_dispose(ctx->events[p].task.async_handle))
-				{
-					LOG_ERROR("Cannot dispose the unprocessed async handle");
-					rc = ERROR_CODE(int);
-				}
-				break;
+				LOG_ERROR("Cannot deliver the task event to the scheduler thread %u", events[i].task.loop->thread_id);
+				_event_dispose(events + i);
 			}
-			default:
-				LOG_WARNING("Invalid event type in the queue, may indicates code bug");
+		}
+		else if(_deque_push(ctx, events + i))
+			n_io ++;
+		else
+		{
+			LOG_ERROR("The work-stealing deque is full, may indicates code bug");
+			_event_dispose(events + i);
 		}
 	}
 
-	free(ctx);
+RET:
+	_equeue_polling = 0;
 
-	return rc;
+	if((errno = pthread_mutex_unlock(&_equeue_mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot release the equeue mutex");
+
+	if(ret > 0) _wake_idle_workers(ctx, n_io + 1);
+
+	return ret;
+}
+
+/**
+ * @brief Make the worker sleep until it gets waken up
+ * @note The worker won't sleep if it has events in its queue, or there's IO events to steal, or
+ *       nobody is polling the equeue, since it should take the polling job in this case. Before
+ *       the supervisor acquires the scheduler token, the worker sleeps until the supervisor wakes it up
+ * @param ctx The scheduler context
+ * @return nothing
+ **/
+static inline void _worker_sleep(sched_loop_t* ctx)
+{
+	struct timespec abstime;
+	struct timeval now;
+	gettimeofday(&now,NULL);
+	abstime.tv_sec = now.tv_sec+1;
+	abstime.tv_nsec = 0;
+
+	if((errno = pthread_mutex_lock(&ctx->mutex)) != 0) LOG_WARNING_ERRNO("Cannot acquire the scheduler event mutex");
+
+	ctx->idle = 1;
+
+	__sync_synchronize();
+
+	if(!_killed && (_equeue_polling || ERROR_CODE(itc_equeue_token_t) == _equeue_token) && ctx->front == ctx->rear && ctx->overflow.list == NULL && !_async_pending(ctx) && !_stealable(ctx) &&
+	   (errno = pthread_cond_timedwait(&ctx->cond, &ctx->mutex, &abstime)) != 0 && errno != ETIMEDOUT && errno != EINTR)
+		LOG_WARNING_ERRNO("Cannot finish pthread_cond_timedwait");
+
+	ctx->idle = 0;
+
+	if((errno = pthread_mutex_unlock(&ctx->mutex)) != 0) LOG_WARNING_ERRNO("Cannot release the scheduler event mutex");
+}
+
+/**
+ * @brief Get the next event for the worker in the work-stealing mode
+ * @details The order we look for the next event is:
+ *          1. The async task completions and the task events in our own queue, because the task
+ *             continuations can only run on the worker which owns the task
+ *          2. The IO events in our own deque, if we are not saturated
+ *          3. The events in the equeue if no one else is polling it
+ *          4. The IO events in other workers' deques, if we are not saturated
+ *          5. If there's nothing to do, either block on the equeue or sleep
+ * @param context The scheduler context
+ * @param stc The scheduler task context
+ * @param current_service The current service graph
+ * @param old_service_refcnt The number of requests still using the old service graph
+ * @param buf The buffer used to return the event
+ * @return 1 if we got the next event, 0 if the worker gets killed
+ **/
+static inline int _steal_next_event(sched_loop_t* context, sched_task_context_t* stc, const sched_service_t** current_service,
+                                    uint32_t* old_service_refcnt, itc_equeue_event_t* buf)
+{
+	for(;!_killed;)
+	{
+		_deploy_check(context, stc, current_service, old_service_refcnt);
+
+		if(_async_get(context, buf)) return 1;
+
+		if(_inbox_get(context, buf)) return 1;
+
+		int saturated = (context->num_running_reqs >= _max_worker_concurrency);
+
+		if(!saturated && _deque_take(context, buf, NULL)) return 1;
+
+		if(_equeue_pull(context, 0) > 0) continue;
+
+		if(!saturated && _steal(context, buf)) return 1;
+
+		if(_equeue_pull(context, 1) > 0) continue;
+
+		_worker_sleep(context);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Get the next event for the worker in the dispatcher mode
+ * @details The dispatcher pushes the events to the worker's queue and the async processor
+ *          pushes the completions to the worker's completion list, so we just wait for either of
+ *          them gets an event
+ * @param context The scheduler context
+ * @param stc The scheduler task context
+ * @param current_service The current service graph
+ * @param old_service_refcnt The number of requests still using the old service graph
+ * @param buf The buffer used to return the event
+ * @return 1 if we got the next event, 0 if the worker gets killed
+ **/
+static inline int _dispatched_next_event(sched_loop_t* context, sched_task_context_t* stc, const sched_service_t** current_service,
+                                         uint32_t* old_service_refcnt, itc_equeue_event_t* buf)
+{
+	for(;;)
+	{
+		if(_async_get(context, buf)) return 1;
+
+		if(context->front != context->rear) break;
+
+		struct timespec abstime;
+		struct timeval now;
+		gettimeofday(&now,NULL);
+		abstime.tv_sec = now.tv_sec+1;
+		abstime.tv_nsec = 0;
+
+		if((errno = pthread_mutex_lock(&context->mutex)) != 0) LOG_WARNING_ERRNO("Cannot acquire the scheduler event mutex");
+		for(;;)
+		{
+			_deploy_check(context, stc, current_service, old_service_refcnt);
+			if(context->rear != context->front || _async_pending(context)) break;
+			if((errno = pthread_cond_timedwait(&context->cond, &context->mutex, &abstime)) != 0 && errno != ETIMEDOUT && errno != EINTR)
+				LOG_WARNING_ERRNO("Cannot finish pthread_cond_timedwait");
+			if(_killed)
+			{
+				if((errno = pthread_mutex_unlock(&context->mutex)) != 0)
+					LOG_WARNING_ERRNO("Cannot release the scheduler event mutex");
+				return 0;
+			}
+			abstime.tv_sec ++;
+		}
+
+		if((errno = pthread_mutex_unlock(&context->mutex)) != 0) LOG_WARNING_ERRNO("Cannot release the scheduler event mutex");
+	}
+
+	uint32_t position = context->front & (context->size - 1);
+	*buf = context->events[position];
+
+	BARRIER();
+
+	arch_atomic_sw_increment_u32(&context->front);
+
+	BARRIER();
+
+	/* At this point, we have at least one empty slot for the next event, so we need to
+	 * check if the dispatcher is waiting for event, then we need to activate the pending
+	 * task resolve callback when the scheduler queue is previously full */
+	if(_dispatcher_waiting_event &&
+	   (context->rear - context->front == context->size - 1) &&
+	   ERROR_CODE(int) == itc_equeue_wait_interrupt())
+		LOG_WARNING("Cannot invoke the wait interrupt callback");
+
+	if(_dispatcher_waiting)
+	{
+		if((errno = pthread_mutex_lock(&_dispatcher_mutex)) != 0)
+			LOG_WARNING_ERRNO("Cannot lock the dispatcher mutex");
+
+		if((errno = pthread_cond_signal(&_dispatcher_cond)) != 0)
+			LOG_WARNING_ERRNO("Cannot notify the dispatcher for the avaliable space");
+
+		if((errno = pthread_mutex_unlock(&_dispatcher_mutex)) != 0)
+			LOG_WARNING_ERRNO("Cannot unlock the dispatcher mutex");
+	}
+
+	return 1;
 }
 
 /**
@@ -271,82 +924,18 @@ static inline void* _sched_main(void* data)
 
 	for(;!_killed;)
 	{
-		if(context->front == context->rear)
-		{
-			struct timespec abstime;
-			struct timeval now;
-			gettimeofday(&now,NULL);
-			abstime.tv_sec = now.tv_sec+1;
-			abstime.tv_nsec = 0;
-
-			if((errno = pthread_mutex_lock(&context->mutex)) != 0) LOG_WARNING_ERRNO("Cannot acquire the scheduler event mutex");
-			for(;;)
-			{
-				if(_deploying_service != NULL && current_service != _deploying_service)
-				{
-					LOG_DEBUG("Switching the service graph from %p to %p", _service, current_service);
-					current_service = _deploying_service;
-					if(ERROR_CODE(uint32_t) == (old_service_refcnt = sched_task_num_concurrent_requests(stc)))
-						LOG_ERROR("Cannot get the number of old service refcount");
-					else
-						LOG_DEBUG("Num of request that using old service graph: %u", old_service_refcnt);
-
-					if(old_service_refcnt == 0)
-					{
-						LOG_DEBUG("The old service isn't in use, mark the deployment as finished");
-						uint32_t current;
-						do {
-							current = _deployed_count;
-						} while(!__sync_bool_compare_and_swap(&_deployed_count, current, current + 1));
-						LOG_NOTICE("Deployment process compelted for scheduler #%u", context->thread_id);
-					}
-				}
-				if(context->rear != context->front) break;
-				if((errno = pthread_cond_timedwait(&context->cond, &context->mutex, &abstime)) != 0 && errno != ETIMEDOUT && errno != EINTR)
-					LOG_WARNING_ERRNO("Cannot finish pthread_cond_timedwait");
-				if(_killed)
-				{
-					if((errno = pthread_mutex_unlock(&context->mutex)) != 0)
-						LOG_WARNING_ERRNO("Cannot release the scheduler event mutex");
-					goto KILLED;
-				}
-				abstime.tv_sec ++;
-			}
+		itc_equeue_event_t current;
 
-			if((errno = pthread_mutex_unlock(&context->mutex)) != 0) LOG_WARNING_ERRNO("Cannot release the scheduler event mutex");
+		if(_mode == _MODE_WORK_STEALING)
+		{
+			if(!_steal_next_event(context, stc, &current_service, &old_service_refcnt, &current))
+				goto KILLED;
 		}
+		else if(!_dispatched_next_event(context, stc, &current_service, &old_service_refcnt, &current))
+			goto KILLED;
 
 		LOG_TRACE("Scheduler Thread %u: new event acquired", context->thread_id);
 
-		uint32_t position = context->front & (context->size - 1);
-		itc_equeue_event_t current = context->events[position];
-
-		BARRIER();
-
-		arch_atomic_sw_increment_u32(&context->front);
-
-		BARRIER();
-
-		/* At this point, we have at least one empty slot for the next event, so we need to
-		 * check if the dispatcher is waiting for event, then we need to activate the pending
-		 * task resolve callback when the scheduler queue is previously full */
-		if(_dispatcher_waiting_event &&
-		   (context->rear - context->front == context->size - 1) &&
-		   ERROR_CODE(int) == itc_equeue_wait_interrupt())
-			LOG_WARNING("Cannot invoke the wait interrupt callback");
-
-		if(_dispatcher_waiting)
-		{
-			if((errno = pthread_mutex_lock(&_dispatcher_mutex)) != 0)
-				LOG_WARNING_ERRNO("Cannot lock the dispatcher mutex");
-
-			if((errno = pthread_cond_signal(&_dispatcher_cond)) != 0)
-				LOG_WARNING_ERRNO("Cannot notify the dispatcher for the avaliable space");
-
-			if((errno = pthread_mutex_unlock(&_dispatcher_mutex)) != 0)
-				LOG_WARNING_ERRNO("Cannot unlock the dispatcher mutex");
-		}
-
 		int old_service = 0;
 
 		switch(current.type)
@@ -361,7 +950,9 @@ static inline void* _sched_main(void* data)
 
 				BARRIER();
 
-				arch_atomic_sw_increment_u32(&context->pending_reqs_id_begin);
+				/* In the work-stealing mode, the pending requests are the IO events in the deque */
+				if(_mode == _MODE_DISPATCHER)
+					arch_atomic_sw_increment_u32(&context->pending_reqs_id_begin);
 
 
 				if(sched_task_new_request(stc, current_service, current.io.in, current.io.out) == ERROR_CODE(sched_task_request_t))
@@ -759,11 +1350,83 @@ NEXT_ITER:
 	return 0;
 }
 
+/**
+ * @brief The supervisor main function, which is used in the work-stealing mode
+ * @details In the work-stealing mode the workers take events from the equeue directly, so the main
+ *          thread only owns the scheduler token, runs the async processor and reads the daemon control
+ *          socket
+ * @return status code
+ **/
+static inline int _supervisor_main(void)
+{
+	thread_set_name("PbSupervisor");
+
+	if(ERROR_CODE(int) == sched_async_start())
+		ERROR_RETURN_LOG(int, "Cannot start the async task processor");
+
+	itc_equeue_token_t sched_token = itc_equeue_scheduler_token();
+
+	if(ERROR_CODE(itc_equeue_token_t) == sched_token) ERROR_RETURN_LOG(int, "Cannot acquire the scheduler token");
+
+	if((errno = pthread_mutex_lock(&_equeue_mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot acquire the equeue mutex");
+
+	_equeue_token = sched_token;
+
+	if((errno = pthread_mutex_unlock(&_equeue_mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot release the equeue mutex");
+
+	/* Let the workers know the equeue is ready to poll */
+	_wake_idle_workers(NULL, _nthreads);
+
+	LOG_DEBUG("Supervisor: loop started");
+
+	if((errno = pthread_mutex_lock(&_dispatcher_mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot acquire the dispatcher mutex");
+
+	while(!_killed)
+	{
+		struct timespec abstime;
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		abstime.tv_sec = now.tv_sec+1;
+		abstime.tv_nsec = 0;
+
+		if((errno = pthread_cond_timedwait(&_dispatcher_cond, &_dispatcher_mutex, &abstime)) != 0 && errno != ETIMEDOUT && errno != EINTR)
+			LOG_WARNING_ERRNO("Cannot complete pthread_cond_timewait");
+
+		if(ERROR_CODE(int) == sched_daemon_read_control_sock())
+			LOG_ERROR("Cannot read the control socket");
+	}
+
+	if((errno = pthread_mutex_unlock(&_dispatcher_mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot release the dispatcher mutex");
+
+	if(ERROR_CODE(int) == sched_async_kill())
+		ERROR_RETURN_LOG(int, "Cannot kill the async processor");
+
+	/* The worker which is polling the equeue will exit once it sees the killed flag */
+	if((errno = pthread_mutex_lock(&_equeue_mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot acquire the equeue mutex");
+
+	_equeue_token = ERROR_CODE(itc_equeue_token_t);
+
+	if((errno = pthread_mutex_unlock(&_equeue_mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot release the equeue mutex");
+
+	if(ERROR_CODE(int) == itc_equeue_release_scheduler_token(sched_token))
+		ERROR_RETURN_LOG(int, "Cannot release the scheduler token");
+
+	LOG_INFO("Supervisor gets killed");
+
+	return 0;
+}
+
 int sched_loop_start(sched_service_t** service, int fork_twice)
 {
 
 	int rc = 0;
-	LOG_INFO("Staring the scheduler loop with %d threads", _nthreads);
+	LOG_INFO("Staring the scheduler loop with %d threads in %s mode", _nthreads, _mode == _MODE_WORK_STEALING ? "work-stealing" : "dispatcher");
 
 	if(_mod_mem == ERROR_CODE(itc_module_type_t))
 	{
@@ -800,6 +1463,9 @@ int sched_loop_start(sched_service_t** service, int fork_twice)
 	if((errno = pthread_cond_init(&_dispatcher_cond, NULL)) != 0)
 		ERROR_RETURN_LOG_ERRNO(int, "Cannot init the dispatcher condvar");
 
+	if((errno = pthread_mutex_init(&_equeue_mutex, NULL)) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot init the equeue mutex");
+
 
 	for(ptr = _scheds; ptr != NULL; ptr = ptr->next)
 	{
@@ -831,7 +1497,10 @@ int sched_loop_start(sched_service_t** service, int fork_twice)
 		ERROR_RETURN_LOG(int, "Cannot set the accept param");
 
 
-	_dispatcher_main();
+	if(_mode == _MODE_WORK_STEALING)
+		_supervisor_main();
+	else
+		_dispatcher_main();
 
 CLEANUP_CTX:
 
@@ -883,6 +1552,20 @@ int sched_loop_kill(int no_error)
 
 	LOG_INFO("Service gets killed!");
 
+	/* This function is typically called from the SIGINT handler. In the work-stealing mode, the
+	 * worker threads acquire the scheduler mutexes all the time, so it's very likely the signal
+	 * handler interrupts a thread which is holding one of them, thus we can not lock any of them
+	 * here. Instead, we only set the killed flag and wake up the thread blocked on the equeue, which
+	 * is safe in a signal handler. The idle workers and the supervisor will notice the flag within
+	 * their 1 second wait timeout */
+	if(_mode == _MODE_WORK_STEALING)
+	{
+		_killed = 1;
+		if(ERROR_CODE(int) == itc_equeue_wait_interrupt())
+			LOG_WARNING("Cannot interrupt the equeue wait");
+		return 0;
+	}
+
 	sched_loop_t* sched;
 
 	for(sched = _scheds; sched != NULL; sched = sched->next)
@@ -899,7 +1582,9 @@ int sched_loop_kill(int no_error)
 			LOG_WARNING_ERRNO("Cannot unlock the scheduler mutex");
 	}
 
-
+	/* The dispatcher may be blocked on the equeue, which doesn't wake up until it gets interrupted */
+	if(ERROR_CODE(int) == itc_equeue_wait_interrupt())
+		LOG_WARNING("Cannot interrupt the equeue wait");
 
 	return 0;
 }
@@ -964,6 +1649,17 @@ static inline int _set_prop(const char* symbol, lang_prop_value_t value, const v
 		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
 		_round_robin_move_threshold = (uint32_t)value.num;
 	}
+	else if(strcmp(symbol, "mode") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_STRING) ERROR_RETURN_LOG(int, "Type mismatch");
+		if(NULL != _scheds) ERROR_RETURN_LOG(int, "Cannot change the worker mode after the loop started");
+		if(strcmp(value.str, "dispatcher") == 0)
+			_mode = _MODE_DISPATCHER;
+		else if(strcmp(value.str, "work_stealing") == 0)
+			_mode = _MODE_WORK_STEALING;
+		else
+			ERROR_RETURN_LOG(int, "Invalid worker mode %s, expected: dispatcher or work_stealing", value.str);
+	}
 	else
 	{
 		LOG_WARNING("Unrecognized symbol name %s", symbol);
@@ -1023,6 +1719,16 @@ static lang_prop_value_t _get_prop(const char* symbol, const void* param)
 		ret.type = LANG_PROP_TYPE_INTEGER;
 		ret.num = _round_robin_move_threshold;
 	}
+	else if(strcmp(symbol, "mode") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_STRING;
+		if(NULL == (ret.str = strdup(_mode == _MODE_WORK_STEALING ? "work_stealing" : "dispatcher")))
+		{
+			LOG_WARNING_ERRNO("Cannot allocate memory for the mode string");
+			ret.type = LANG_PROP_TYPE_ERROR;
+			return ret;
+		}
+	}
 
 	return ret;
 }
@@ -1082,3 +1788,34 @@ int sched_loop_deploy_completed()
 
 	return 0;
 }
+
+int sched_loop_async_completed(sched_loop_t* loop, sched_loop_async_completion_t* completion)
+{
+	if(NULL == loop || NULL == completion)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	sched_loop_async_completion_t* head;
+	do {
+		head = *(sched_loop_async_completion_t* const volatile*)&loop->async_list;
+		completion->next = head;
+	} while(!__sync_bool_compare_and_swap(&loop->async_list, head, completion));
+
+	/* If the list was not empty, the worker either hasn't taken the previous completions yet or
+	 * it will be waken up by the one who pushed the first completion, so we are done */
+	if(NULL != head) return 0;
+
+	if((errno = pthread_mutex_lock(&loop->mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot acquire the thread local mutex");
+
+	if((errno = pthread_cond_signal(&loop->cond)) != 0)
+		LOG_WARNING_ERRNO("Cannot notify the async task completion to the scheduler thread %u", loop->thread_id);
+
+	if((errno = pthread_mutex_unlock(&loop->mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot release the thread local mutex");
+
+	/* In the work-stealing mode, the worker might be blocked on the equeue rather than the cond var */
+	if(_mode == _MODE_WORK_STEALING && _equeue_polling && ERROR_CODE(int) == itc_equeue_wait_interrupt())
+		LOG_WARNING("Cannot interrupt the equeue wait");
+
+	return 0;
+}
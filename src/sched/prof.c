@@ -9,6 +9,7 @@
 #include <pthread.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include <constants.h>
 #include <error.h>
@@ -36,16 +37,25 @@
  * @brief the time accumulator
  **/
 typedef struct {
-	uint64_t total_time;   /*!< the total time elapsed on this node in ns */
-	uint64_t exec_count;   /*!< the number of executions during the time */
+	uint64_t exec_count;                           /*!< the number of executions */
+	uint64_t cpu_time;                             /*!< the total thread CPU time in ns */
+	uint64_t wall_time;                            /*!< the total wall clock time in ns */
+	uint64_t cpu_hist[SCHED_PROF_HIST_NBUCKETS];   /*!< the CPU time histogram */
+	uint64_t wall_hist[SCHED_PROF_HIST_NBUCKETS];  /*!< the wall clock time histogram */
 } _accu_t;
 
 /**
  * @brief the profiler array
+ * @note the first serv_size slots are for the nodes, and the remaining slots are for the outgoing pipes
  **/
-typedef struct {
-	sched_service_node_id_t cur_node; /*!< the current node that is being measured */
-	struct timespec start_time;       /*!< the timestamp when the timer started */
+typedef struct _prof_array_t {
+	struct _prof_array_t* next;       /*!< the next thread array in the same profiler */
+	uint32_t tid;                     /*!< the thread id */
+	uint32_t linked:1;                /*!< if this array has been added to the profiler's array list */
+	uint32_t cur_slot;                /*!< the current slot that is being measured */
+	uint32_t unflushed;               /*!< the number of node executions since last flush */
+	struct timespec start_cpu;        /*!< the thread CPU time when the timer started */
+	struct timespec start_wall;       /*!< the wall clock time when the timer started */
 	uintpad_t __padding__[0];
 	_accu_t  data[0];                 /*!< the actual array */
 } _prof_array_t;
@@ -56,8 +66,15 @@ STATIC_ASSERTION_LAST(_prof_array_t, data);
  * @brief the actual data structure for a profiler
  **/
 struct _sched_prof_t {
+	const sched_service_t*  service;     /*!< the service this profiler is measuring */
 	sched_service_node_id_t serv_size;   /*!< the size of the service graph */
+	uint32_t                num_slots;   /*!< the number of slots, which is the number of nodes plus the number of pipes */
+	uint32_t*               pipe_base;   /*!< the slot of the first outgoing pipe for each node */
 	thread_pset_t*          thread_data; /*!< the thread data */
+	pthread_mutex_t         mutex;       /*!< the mutex used to protect the array list */
+	_prof_array_t*          arrays;      /*!< the list of all the thread arrays, used by the dump */
+	sched_prof_t*           prev;        /*!< the previous profiler in the live profiler list */
+	sched_prof_t*           next;        /*!< the next profiler in the live profiler list */
 };
 
 /**
@@ -70,6 +87,16 @@ static uint32_t _prof_enabled = 0;
  **/
 static FILE* _prof_output;
 
+/**
+ * @brief the list of all the live profilers
+ **/
+static sched_prof_t* _profs;
+
+/**
+ * @brief the mutex protects the live profiler list
+ **/
+static pthread_mutex_t _profs_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 /**
  * @brief create a new profiler array with n slots
  * @param tid the thread id
@@ -78,17 +105,17 @@ static FILE* _prof_output;
  **/
 static inline void* _prof_array_new(uint32_t tid, const void* caller)
 {
-	(void)tid;
 	const sched_prof_t* prof = (const sched_prof_t*)caller;
 
-	size_t size = sizeof(_prof_array_t) + sizeof(_accu_t) * prof->serv_size;
+	size_t size = sizeof(_prof_array_t) + sizeof(_accu_t) * prof->num_slots;
 
 	_prof_array_t* ret = (_prof_array_t*)calloc(1, size);
 
-	ret->cur_node = ERROR_CODE(sched_service_node_id_t);
-
 	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allcoate memory for the profiler array");
 
+	ret->cur_slot = ERROR_CODE(uint32_t);
+	ret->tid = tid;
+
 	return ret;
 }
 
@@ -106,6 +133,48 @@ static inline int _prof_array_free(void* arr, const void* caller)
 	return 0;
 }
 
+/**
+ * @brief get the profiler array for current thread
+ * @param prof the profiler
+ * @return the array or NULL on error
+ **/
+static inline _prof_array_t* _prof_array_acquire(sched_prof_t* prof)
+{
+	_prof_array_t* acc = (_prof_array_t*)thread_pset_acquire(prof->thread_data);
+	if(NULL == acc) ERROR_PTR_RETURN_LOG("Cannot get the profiler instance for this thread");
+
+	if(!acc->linked)
+	{
+		if((errno = pthread_mutex_lock(&prof->mutex)) != 0)
+			ERROR_PTR_RETURN_LOG_ERRNO("Cannot acquire the profiler mutex");
+		acc->next = prof->arrays;
+		prof->arrays = acc;
+		acc->linked = 1;
+		if((errno = pthread_mutex_unlock(&prof->mutex)) != 0)
+			LOG_WARNING_ERRNO("Cannot release the profiler mutex");
+	}
+
+	return acc;
+}
+
+/**
+ * @brief compute the time difference between two timestamps in ns
+ * @param begin the begin timestamp
+ * @param end the end timestamp
+ * @return the time difference
+ **/
+static inline uint64_t _time_diff(const struct timespec* begin, const struct timespec* end)
+{
+	uint64_t time = ((uint64_t)(end->tv_sec - begin->tv_sec) * 1000000000ull);
+
+	if(end->tv_nsec > begin->tv_nsec)
+		time += (uint64_t)(end->tv_nsec - begin->tv_nsec);
+	else
+		time -= (uint64_t)(begin->tv_nsec - end->tv_nsec);
+
+	return time;
+}
+
 int sched_prof_new(const sched_service_t* service, sched_prof_t** result)
 {
 	if(NULL == service || NULL == result) ERROR_RETURN_LOG(int, "Invalid arguments");
@@ -119,22 +188,52 @@ int sched_prof_new(const sched_service_t* service, sched_prof_t** result)
 	}
 
 
-	sched_service_node_id_t serv_size = (sched_service_node_id_t)sched_service_get_num_node(service);
+	sched_service_node_id_t serv_size = (sched_service_node_id_t)sched_service_get_num_node(service), i;
 	if(ERROR_CODE(sched_service_node_id_t) == serv_size)
 		ERROR_RETURN_LOG(int, "Cannot get the size of the service");
 
-	sched_prof_t* ret = NULL;
-	ret = (sched_prof_t*)malloc(sizeof(sched_prof_t));
-	ret->thread_data = NULL;
-
+	sched_prof_t* ret = (sched_prof_t*)calloc(1, sizeof(sched_prof_t));
 	if(NULL == ret) ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the profiler");
+
+	ret->service = service;
 	ret->serv_size = serv_size;
+
+	if(NULL == (ret->pipe_base = (uint32_t*)malloc(sizeof(uint32_t) * (serv_size + 1u))))
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the pipe slot table");
+
+	for(ret->pipe_base[0] = 0, i = 0; i < serv_size; i ++)
+	{
+		uint32_t count;
+		if(NULL == sched_service_get_outgoing_pipes(service, i, &count))
+			ERROR_LOG_GOTO(ERR, "Cannot get the outgoing pipes of node %u", i);
+		ret->pipe_base[i + 1] = ret->pipe_base[i] + count;
+	}
+
+	ret->num_slots = serv_size + ret->pipe_base[serv_size];
+
+	if((errno = pthread_mutex_init(&ret->mutex, NULL)) != 0)
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot initialize the profiler mutex");
+
 	if(NULL == (ret->thread_data = thread_pset_new(SCHED_PROF_INIT_THREAD_CAPACITY, _prof_array_new, _prof_array_free, ret)))
-		ERROR_LOG_GOTO(ERR, "Cannot create thread data array");
+		ERROR_LOG_GOTO(MUTEX_ERR, "Cannot create thread data array");
+
+	if((errno = pthread_mutex_lock(&_profs_mutex)) != 0)
+		ERROR_LOG_ERRNO_GOTO(PSET_ERR, "Cannot acquire the live profiler list mutex");
+
+	if(NULL != (ret->next = _profs)) _profs->prev = ret;
+	_profs = ret;
+
+	if((errno = pthread_mutex_unlock(&_profs_mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot release the live profiler list mutex");
+
 	*result = ret;
 	return 0;
+PSET_ERR:
+	thread_pset_free(ret->thread_data);
+MUTEX_ERR:
+	pthread_mutex_destroy(&ret->mutex);
 ERR:
-	if(ret->thread_data != NULL) thread_pset_free(ret->thread_data);
+	if(NULL != ret->pipe_base) free(ret->pipe_base);
 	free(ret);
 	return ERROR_CODE(int);
 }
@@ -144,102 +243,385 @@ int sched_prof_free(sched_prof_t* prof)
 	if(NULL == prof) ERROR_RETURN_LOG(int, "Invalid arguments");
 
 	int rc = 0;
-	rc = thread_pset_free(prof->thread_data);
+
+	if((errno = pthread_mutex_lock(&_profs_mutex)) != 0)
+	{
+		LOG_ERROR_ERRNO("Cannot acquire the live profiler list mutex");
+		rc = ERROR_CODE(int);
+	}
+
+	if(NULL != prof->prev) prof->prev->next = prof->next;
+	else if(_profs == prof) _profs = prof->next;
+	if(NULL != prof->next) prof->next->prev = prof->prev;
+
+	if(rc == 0 && (errno = pthread_mutex_unlock(&_profs_mutex)) != 0)
+	{
+		LOG_ERROR_ERRNO("Cannot release the live profiler list mutex");
+		rc = ERROR_CODE(int);
+	}
+
+	if(ERROR_CODE(int) == thread_pset_free(prof->thread_data))
+		rc = ERROR_CODE(int);
+
+	if((errno = pthread_mutex_destroy(&prof->mutex)) != 0)
+	{
+		LOG_ERROR_ERRNO("Cannot dispose the profiler mutex");
+		rc = ERROR_CODE(int);
+	}
+
+	free(prof->pipe_base);
 	free(prof);
 
 	return rc;
 }
 
-int sched_prof_start_timer(sched_prof_t* prof, sched_service_node_id_t node)
+/**
+ * @brief start the timer for the given slot
+ * @param prof the profiler
+ * @param slot the slot to measure
+ * @return status code
+ **/
+static inline int _start_timer(sched_prof_t* prof, uint32_t slot)
 {
-	if(NULL == prof || ERROR_CODE(sched_service_node_id_t) == node || node >= prof->serv_size)
-		ERROR_RETURN_LOG(int, "Invalid arguments");
-
-	_prof_array_t* acc = (_prof_array_t*)thread_pset_acquire(prof->thread_data);
+	_prof_array_t* acc = _prof_array_acquire(prof);
 	if(NULL == acc)
 		ERROR_RETURN_LOG(int, "Cannot get the profiler instance for this thread");
 
-	if(acc->cur_node != ERROR_CODE(sched_service_node_id_t))
-		ERROR_RETURN_LOG(int, "Previous profiler session is not closed yet");
+	/* If the scheduler failed in the middle of a step, the previous session can be left open */
+	if(acc->cur_slot != ERROR_CODE(uint32_t))
+		LOG_DEBUG("Discarding the previous profiler session which is not closed");
+
+	acc->cur_slot = slot;
 
-	acc->cur_node = node;
-	if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &acc->start_time) < 0)
-		ERROR_RETURN_LOG_ERRNO(int, "Cannot get the start timestamp");
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &acc->start_cpu) < 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot get the start CPU timestamp");
+
+	if(clock_gettime(CLOCK_MONOTONIC, &acc->start_wall) < 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot get the start wall clock timestamp");
 
 	return 0;
 }
 
+int sched_prof_start_timer(sched_prof_t* prof, sched_service_node_id_t node)
+{
+	if(NULL == prof || ERROR_CODE(sched_service_node_id_t) == node || node >= prof->serv_size)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	return _start_timer(prof, node);
+}
+
+int sched_prof_start_pipe_timer(sched_prof_t* prof, sched_service_node_id_t node, uint32_t pipe)
+{
+	if(NULL == prof || ERROR_CODE(sched_service_node_id_t) == node || node >= prof->serv_size ||
+	   pipe >= prof->pipe_base[node + 1] - prof->pipe_base[node])
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	return _start_timer(prof, prof->serv_size + prof->pipe_base[node] + pipe);
+}
+
 int sched_prof_stop_timer(sched_prof_t* prof)
 {
 	if(NULL == prof) ERROR_RETURN_LOG(int, "Invalid arguments");
 
-	_prof_array_t* acc = (_prof_array_t*)thread_pset_acquire(prof->thread_data);
+	struct timespec end_cpu, end_wall;
+	if(clock_gettime(CLOCK_MONOTONIC, &end_wall) < 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot get the end wall clock timestamp");
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end_cpu) < 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot get the end CPU timestamp");
+
+	_prof_array_t* acc = _prof_array_acquire(prof);
 	if(NULL == acc)
 		ERROR_RETURN_LOG(int, "Cannot get the profiler instance for this thread");
-	if(acc->cur_node == ERROR_CODE(sched_service_node_id_t))
+	if(acc->cur_slot == ERROR_CODE(uint32_t))
 		ERROR_RETURN_LOG(int, "Timer is not started yet");
 
-	_accu_t* cell = acc->data + acc->cur_node;
+	uint32_t slot = acc->cur_slot;
+	_accu_t* cell = acc->data + slot;
 
-	acc->cur_node = ERROR_CODE(sched_service_node_id_t);
+	acc->cur_slot = ERROR_CODE(uint32_t);
 
-	struct timespec end_time;
-	if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end_time) < 0)
-		ERROR_RETURN_LOG_ERRNO(int, "Cannot get the end timestamp");
+	uint64_t cpu_time = _time_diff(&acc->start_cpu, &end_cpu);
+	uint64_t wall_time = _time_diff(&acc->start_wall, &end_wall);
 
+	cell->exec_count ++;
+	cell->cpu_time += cpu_time;
+	cell->wall_time += wall_time;
+	cell->cpu_hist[sched_prof_hist_bucket(cpu_time)] ++;
+	cell->wall_hist[sched_prof_hist_bucket(wall_time)] ++;
 
-	uint64_t time = ((uint64_t)(end_time.tv_sec - acc->start_time.tv_sec) * 1000000000ull);
+	if(slot < prof->serv_size && ++ acc->unflushed >= SCHED_PROF_FLUSH_INTERVAL)
+		return sched_prof_flush(prof);
 
-	if(end_time.tv_nsec > acc->start_time.tv_nsec)
-		time += (uint64_t)(end_time.tv_nsec - acc->start_time.tv_nsec);
-	else
-		time -= (uint64_t)(acc->start_time.tv_nsec - end_time.tv_nsec);
+	return 0;
+}
 
-	cell->exec_count ++;
-	cell->total_time += time;
+/**
+ * @brief get the node id and the pipe index of the given slot
+ * @param prof the profiler
+ * @param slot the slot
+ * @param node the buffer for the node id
+ * @param pipe the buffer for the pipe index, error code for a node slot
+ * @return nothing
+ **/
+static inline void _slot_info(const sched_prof_t* prof, uint32_t slot, sched_service_node_id_t* node, uint32_t* pipe)
+{
+	if(slot < prof->serv_size)
+	{
+		*node = slot;
+		*pipe = ERROR_CODE(uint32_t);
+		return;
+	}
 
-	return 0;
+	slot -= prof->serv_size;
+
+	sched_service_node_id_t l = 0, r = prof->serv_size;
+	/* Find the last node whose pipe base is not greater than the slot */
+	while(r - l > 1)
+	{
+		sched_service_node_id_t m = (l + r) / 2;
+		if(prof->pipe_base[m] <= slot) l = m;
+		else r = m;
+	}
+	/* Skip the nodes without any outgoing pipe */
+	while(prof->pipe_base[l + 1] <= slot) l ++;
+
+	*node = l;
+	*pipe = slot - prof->pipe_base[l];
 }
 
 int sched_prof_flush(sched_prof_t* prof)
 {
 	if(NULL == prof) ERROR_RETURN_LOG(int, "Invalid arguments");
 
-	_prof_array_t* acc = (_prof_array_t*)thread_pset_acquire(prof->thread_data);
+	_prof_array_t* acc = _prof_array_acquire(prof);
 	if(NULL == acc)
 		ERROR_RETURN_LOG(int, "Cannot get the profiler instance for this thread");
 
 	sched_service_node_id_t size = prof->serv_size, i;
 
+	acc->unflushed = 0;
+
 	if(_prof_output == NULL)
 	{
 		for(i = 0; i < size; i ++)
-			LOG_NOTICE("Profiler: Thread=%u\tNode=%u\tCount=%"PRIu64"\tTime=%"PRIu64">\tAverage %lf",
-			            thread_get_id(), i, acc->data[i].exec_count, acc->data[i].total_time,
-			            ((double)acc->data[i].total_time) / (double)acc->data[i].exec_count);
+			if(acc->data[i].exec_count > 0)
+				LOG_NOTICE("Profiler: Thread=%u\tNode=%u\tCount=%"PRIu64"\tCPU=%"PRIu64"\tWall=%"PRIu64"\tAverage CPU %lf\tAverage Wall %lf",
+				            acc->tid, i, acc->data[i].exec_count, acc->data[i].cpu_time, acc->data[i].wall_time,
+				            ((double)acc->data[i].cpu_time) / (double)acc->data[i].exec_count,
+				            ((double)acc->data[i].wall_time) / (double)acc->data[i].exec_count);
 	}
 	else
 	{
+		uint32_t slot;
 		flockfile(_prof_output);
-		for(i = 0; i < size; i ++)
+		for(slot = 0; slot < prof->num_slots; slot ++)
 		{
+			const _accu_t* cell = acc->data + slot;
+			if(cell->exec_count == 0) continue;
+
 			sched_prof_record_t item = {
-				.thread = thread_get_id(),
-				.count  = acc->data[i].exec_count,
-				.time   = acc->data[i].total_time,
-				.node   = i
+				.thread    = acc->tid,
+				.count     = cell->exec_count,
+				.cpu_time  = cell->cpu_time,
+				.wall_time = cell->wall_time
 			};
+			_slot_info(prof, slot, &item.node, &item.pipe);
+			memcpy(item.cpu_hist, cell->cpu_hist, sizeof(item.cpu_hist));
+			memcpy(item.wall_hist, cell->wall_hist, sizeof(item.wall_hist));
+
 			fwrite(&item, sizeof(sched_prof_record_t), 1, _prof_output);
 		}
 		fflush(_prof_output);
 		funlockfile(_prof_output);
 	}
 
-	memset(acc->data, 0, sizeof(_accu_t) * size);
+	return 0;
+}
+
+/**
+ * @brief get the approximate percentile from the histogram
+ * @param hist the histogram
+ * @param count the total number of samples
+ * @param percent the percentile, from 0 to 100
+ * @return the lower bound of the bucket which contains the percentile
+ **/
+static inline uint64_t _hist_percentile(const uint64_t* hist, uint64_t count, uint32_t percent)
+{
+	uint64_t rank = (count * percent + 99) / 100, acc = 0;
+	uint32_t i;
+
+	if(rank == 0) rank = 1;
+
+	for(i = 0; i < SCHED_PROF_HIST_NBUCKETS; i ++)
+		if((acc += hist[i]) >= rank)
+			return sched_prof_hist_lower_bound(i);
+
+	return sched_prof_hist_lower_bound(SCHED_PROF_HIST_NBUCKETS - 1);
+}
+
+/**
+ * @brief dump the profiler summary to the file
+ * @param prof the profiler
+ * @param fp the file
+ * @return status code
+ **/
+static inline int _dump(sched_prof_t* prof, FILE* fp)
+{
+	_accu_t* sum = (_accu_t*)malloc(sizeof(_accu_t));
+	uint32_t slot, i, nthreads = 0;
+	const _prof_array_t* arr;
+
+	if(NULL == sum) ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the aggregation buffer");
+
+	/* The mutex only protects the list, the counters may be modified while we are reading */
+	if((errno = pthread_mutex_lock(&prof->mutex)) != 0)
+	{
+		free(sum);
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the profiler mutex");
+	}
+
+	for(arr = prof->arrays; NULL != arr; arr = arr->next)
+		nthreads ++;
+
+	fprintf(fp, "Service profiler: %u nodes, %u pipes, %u threads\n", prof->serv_size, prof->num_slots - prof->serv_size, nthreads);
+
+	for(slot = 0; slot < prof->num_slots; slot ++)
+	{
+		memset(sum, 0, sizeof(_accu_t));
+		for(arr = prof->arrays; NULL != arr; arr = arr->next)
+		{
+			const _accu_t* cell = arr->data + slot;
+			sum->exec_count += cell->exec_count;
+			sum->cpu_time += cell->cpu_time;
+			sum->wall_time += cell->wall_time;
+			for(i = 0; i < SCHED_PROF_HIST_NBUCKETS; i ++)
+			{
+				sum->cpu_hist[i] += cell->cpu_hist[i];
+				sum->wall_hist[i] += cell->wall_hist[i];
+			}
+		}
+
+		if(sum->exec_count == 0) continue;
+
+		sched_service_node_id_t node;
+		uint32_t pipe;
+		_slot_info(prof, slot, &node, &pipe);
+
+		if(pipe == ERROR_CODE(uint32_t))
+			fprintf(fp, "node %u", node);
+		else
+		{
+			uint32_t count;
+			const sched_service_pipe_descriptor_t* pds = sched_service_get_outgoing_pipes(prof->service, node, &count);
+			if(NULL == pds || pipe >= count)
+				fprintf(fp, "pipe %u.%u", node, pipe);
+			else
+				fprintf(fp, "pipe %u:%u->%u:%u", node, pds[pipe].source_pipe_desc, pds[pipe].destination_node_id, pds[pipe].destination_pipe_desc);
+		}
+
+		fprintf(fp, "\tcount=%"PRIu64, sum->exec_count);
+		fprintf(fp, "\tcpu(avg=%.0f p50=%"PRIu64" p90=%"PRIu64" p99=%"PRIu64")",
+		        (double)sum->cpu_time / (double)sum->exec_count,
+		        _hist_percentile(sum->cpu_hist, sum->exec_count, 50),
+		        _hist_percentile(sum->cpu_hist, sum->exec_count, 90),
+		        _hist_percentile(sum->cpu_hist, sum->exec_count, 99));
+		fprintf(fp, "\twall(avg=%.0f p50=%"PRIu64" p90=%"PRIu64" p99=%"PRIu64")\n",
+		        (double)sum->wall_time / (double)sum->exec_count,
+		        _hist_percentile(sum->wall_hist, sum->exec_count, 50),
+		        _hist_percentile(sum->wall_hist, sum->exec_count, 90),
+		        _hist_percentile(sum->wall_hist, sum->exec_count, 99));
+	}
+
+	if((errno = pthread_mutex_unlock(&prof->mutex)) != 0)
+		LOG_WARNING_ERRNO("Cannot release the profiler mutex");
 
+	free(sum);
 	return 0;
 }
 
+int sched_prof_dump_fd(sched_prof_t* prof, int fd)
+{
+	if(NULL == prof || fd < 0) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	int dup_fd = dup(fd);
+	if(dup_fd < 0) ERROR_RETURN_LOG_ERRNO(int, "Cannot duplicate the file descriptor");
+
+	FILE* fp = fdopen(dup_fd, "w");
+	if(NULL == fp)
+	{
+		close(dup_fd);
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot open the file descriptor");
+	}
+
+	int rc = _dump(prof, fp);
+
+	if(fclose(fp) != 0)
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot close the file");
+
+	return rc;
+}
+
+static inline lang_prop_value_t _get_prop(const char* symbol, const void* data)
+{
+	(void)data;
+	lang_prop_value_t ret = {
+		.type = LANG_PROP_TYPE_NONE
+	};
+
+	if(strcmp(symbol, "enabled") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = _prof_enabled;
+	}
+	else if(strcmp(symbol, "dump") == 0)
+	{
+		size_t size;
+		char* buf = NULL;
+		FILE* fp = open_memstream(&buf, &size);
+		ret.type = LANG_PROP_TYPE_ERROR;
+
+		if(NULL == fp)
+		{
+			LOG_ERROR_ERRNO("Cannot open the memory stream");
+			return ret;
+		}
+
+		int rc = 0;
+
+		if((errno = pthread_mutex_lock(&_profs_mutex)) != 0)
+		{
+			LOG_ERROR_ERRNO("Cannot acquire the live profiler list mutex");
+			rc = ERROR_CODE(int);
+		}
+		else
+		{
+			sched_prof_t* prof;
+			for(prof = _profs; rc == 0 && NULL != prof; prof = prof->next)
+				rc = _dump(prof, fp);
+
+			if((errno = pthread_mutex_unlock(&_profs_mutex)) != 0)
+				LOG_WARNING_ERRNO("Cannot release the live profiler list mutex");
+		}
+
+		if(fclose(fp) != 0)
+		{
+			LOG_ERROR_ERRNO("Cannot close the memory stream");
+			rc = ERROR_CODE(int);
+		}
+
+		if(ERROR_CODE(int) == rc)
+		{
+			free(buf);
+			return ret;
+		}
+
+		ret.type = LANG_PROP_TYPE_STRING;
+		ret.str = buf;
+	}
+
+	return ret;
+}
+
 static inline int _set_prop(const char* symbol, lang_prop_value_t value, const void* data)
 {
 	(void) data;
@@ -263,6 +645,7 @@ static inline int _set_prop(const char* symbol, lang_prop_value_t value, const v
 			{
 				LOG_TRACE("Outputing profiler data to log");
 				fclose(_prof_output);
+				_prof_output = NULL;
 			}
 		}
 		else
@@ -285,7 +668,7 @@ int sched_prof_init()
 {
 	lang_prop_callback_t cb = {
 		.param = NULL,
-		.get   = NULL,
+		.get   = _get_prop,
 		.set   = _set_prop,
 		.symbol_prefix = "profiler"
 	};
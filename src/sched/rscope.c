@@ -7,22 +7,48 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <pthread.h>
+#include <unistd.h>
 
 #include <error.h>
 #include <utils/log.h>
 #include <utils/mempool/objpool.h>
+#include <utils/mempool/page.h>
 
 #include <runtime/api.h>
 #include <sched/rscope.h>
 
 #define _NULL_ENTRY ERROR_CODE(runtime_api_scope_token_t)
 
+/**
+ * @brief a chunk of memory owned by the request scope arena
+ **/
+typedef struct _arena_chunk_t {
+	struct _arena_chunk_t*    next;     /*!< the next chunk in the arena */
+	uint32_t                  large:1;  /*!< if this is a dedicated chunk for a large allocation, otherwise it's a pool page */
+	uintpad_t                 __padding__[0];
+	char                      data[0];  /*!< the actual memory */
+} _arena_chunk_t;
+
+/**
+ * @brief the bump pointer arena bound to a request scope
+ * @note the arena header lives in the first page of the arena. It's referenced by the scope and by all the
+ *       entities that have been opened as a byte stream, because the stream may outlive the scope when it's
+ *       taken by the async loop, and the data it reads may live in the arena
+ **/
+typedef struct {
+	uint32_t                  refcnt;   /*!< the reference counter */
+	char*                     begin;    /*!< the beginning of the unused memory in current page */
+	char*                     end;      /*!< the end of current page */
+	_arena_chunk_t*           chunks;   /*!< all the chunks owned by this arena */
+} _arena_t;
+
 /**
  * @brief the actual data type for the request local scope
  **/
 struct _sched_rscope_t {
 	uint64_t                  id;       /*!< the identifier for current scope */
 	runtime_api_scope_token_t head;     /*!< the head of the linked list */
+	_arena_t*                 arena;    /*!< the memory arena of this scope, NULL if nothing has been allocated */
 };
 
 /**
@@ -31,6 +57,7 @@ struct _sched_rscope_t {
 typedef struct {
 	runtime_api_scope_entity_t    entity;   /*!< the scope entity */
 	uint32_t                      refcnt;   /*!< the reference counter, this is needed because when the token is taken by the async loop, we want it alive until the stream dead */
+	_arena_t*                     arena;    /*!< the arena this entity holds a reference to, because it has been opened as a stream */
 } _scope_entity_t;
 
 /**
@@ -39,9 +66,15 @@ typedef struct {
 typedef struct {
 	runtime_api_scope_token_t     next;      /*!< the next entry in the scope linked list */
 	uint64_t                      scope_id;  /*!< the scope id for the owner scope */
+	sched_rscope_t*               scope;     /*!< the owner scope */
 	_scope_entity_t*              data;      /*!< the actual pointer definition */
 } _entry_t;
 
+/**
+ * @brief the alignment of the memory allocated from the arena
+ **/
+#define _ARENA_ALIGN 16u
+
 
 /**
  * @brief the actual data structure for a RSL stream
@@ -83,8 +116,15 @@ static mempool_objpool_t* _entity_pool;
  **/
 static mempool_objpool_t* _stream_pool;
 
+/**
+ * @brief the size of a pool page
+ **/
+static size_t _page_size;
+
 int sched_rscope_init()
 {
+	_page_size = (size_t)getpagesize();
+
 	if(NULL == (_rscope_pool = mempool_objpool_new(sizeof(sched_rscope_t))))
 		ERROR_RETURN_LOG(int, "Cannot allocate object pool for request local scope objects");
 
@@ -121,6 +161,117 @@ int sched_rscope_finalize()
 	return rc;
 }
 
+/**
+ * @brief the size of the arena chunk header, aligned, so that the memory right after it is aligned as well
+ **/
+#define _ARENA_CHUNK_HEADER ((sizeof(_arena_chunk_t) + _ARENA_ALIGN - 1) & ~(size_t)(_ARENA_ALIGN - 1))
+
+/**
+ * @brief the size of the arena header
+ **/
+#define _ARENA_HEADER ((sizeof(_arena_t) + _ARENA_ALIGN - 1) & ~(size_t)(_ARENA_ALIGN - 1))
+
+/**
+ * @brief release a reference to the arena, and dispose all the memory it owns when there's no reference anymore
+ * @note this may be called from the async loop, so the memory goes back to the pools in a thread-safe way
+ * @param arena the arena
+ * @return status code
+ **/
+static inline int _arena_decref(_arena_t* arena)
+{
+	if(__sync_sub_and_fetch(&arena->refcnt, 1) > 0)
+		return 0;
+
+	int rc = 0;
+	_arena_chunk_t* chunk;
+	for(chunk = arena->chunks; NULL != chunk;)
+	{
+		_arena_chunk_t* this = chunk;
+		chunk = chunk->next;
+
+		if(this->large)
+			free(this);
+		else if(ERROR_CODE(int) == mempool_page_dealloc(this))
+		{
+			LOG_ERROR("Cannot return the arena page to the page pool");
+			rc = ERROR_CODE(int);
+		}
+	}
+
+	return rc;
+}
+
+/**
+ * @brief allocate a new pool page for the arena and make it the current page
+ * @param arena the arena, NULL if we need a new arena in the new page
+ * @return the arena, NULL on error
+ **/
+static inline _arena_t* _arena_new_page(_arena_t* arena)
+{
+	_arena_chunk_t* page = (_arena_chunk_t*)mempool_page_alloc();
+	if(NULL == page)
+		ERROR_PTR_RETURN_LOG("Cannot allocate a new page for the request scope arena");
+
+	page->large = 0;
+
+	char* begin = (char*)page + _ARENA_CHUNK_HEADER;
+
+	if(NULL == arena)
+	{
+		arena = (_arena_t*)begin;
+		arena->refcnt = 1;
+		arena->chunks = NULL;
+		begin += _ARENA_HEADER;
+	}
+
+	page->next = arena->chunks;
+	arena->chunks = page;
+	arena->begin = begin;
+	arena->end = (char*)page + _page_size;
+
+	return arena;
+}
+
+void* sched_rscope_arena_alloc(sched_rscope_t* scope, size_t size)
+{
+	if(NULL == scope || 0 == size)
+		ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	size = (size + _ARENA_ALIGN - 1) & ~(size_t)(_ARENA_ALIGN - 1);
+
+	_arena_t* arena = scope->arena;
+
+	if(NULL != arena && (size_t)(arena->end - arena->begin) >= size)
+	{
+		void* ret = arena->begin;
+		arena->begin += size;
+		return ret;
+	}
+
+	if(NULL == arena && NULL == (arena = scope->arena = _arena_new_page(NULL)))
+		ERROR_PTR_RETURN_LOG("Cannot create the arena for request local scope %"PRIu64, scope->id);
+
+	if(size > SCHED_RSCOPE_ARENA_LARGE_SIZE || size > _page_size - _ARENA_CHUNK_HEADER - _ARENA_HEADER)
+	{
+		_arena_chunk_t* chunk = (_arena_chunk_t*)malloc(_ARENA_CHUNK_HEADER + size);
+		if(NULL == chunk)
+			ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate a large chunk of %zu bytes for the request scope arena", size);
+
+		chunk->large = 1;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+
+		return (char*)chunk + _ARENA_CHUNK_HEADER;
+	}
+
+	if((size_t)(arena->end - arena->begin) < size && NULL == _arena_new_page(arena))
+		ERROR_PTR_RETURN_LOG("Cannot grow the arena for request local scope %"PRIu64, scope->id);
+
+	void* ret = arena->begin;
+	arena->begin += size;
+	return ret;
+}
+
 /**
  * @brief try to deallocate the scope entity
  * @param entity the entity to deallocate
@@ -142,6 +293,11 @@ static inline int _dispose_scope_entity(_scope_entity_t* entity)
 			LOG_ERROR("The entity free callback returns an error code");
 			rc = ERROR_CODE(int);
 		}
+		if(NULL != entity->arena && ERROR_CODE(int) == _arena_decref(entity->arena))
+		{
+			LOG_ERROR("Cannot release the request scope arena");
+			rc = ERROR_CODE(int);
+		}
 		if(ERROR_CODE(int) == mempool_objpool_dealloc(_entity_pool, entity))
 		{
 			LOG_ERROR("Cannot dispose the entity object");
@@ -242,8 +398,9 @@ sched_rscope_t* sched_rscope_new()
 	if(NULL == ret)
 		ERROR_PTR_RETURN_LOG("Cannot allocate memory for the request local scope");
 
-	ret->head = _NULL_ENTRY;
-	ret->id   = next_scope_id ++;
+	ret->head  = _NULL_ENTRY;
+	ret->id    = next_scope_id ++;
+	ret->arena = NULL;
 
 	LOG_DEBUG("Request local scope %"PRIu64" has been created", ret->id);
 
@@ -269,6 +426,11 @@ int sched_rscope_free(sched_rscope_t* scope)
 		entry->data = NULL;
 		_entry_table.cached = cur_tok;
 	}
+
+	/* All the entities are disposed at this point, the memory in the arena is
+	 * only kept alive by the entities which are still opened as streams */
+	if(NULL != scope->arena && ERROR_CODE(int) == _arena_decref(scope->arena))
+		rc = ERROR_CODE(int);
 #ifdef LOG_ERROR_ENABLED
 	uint64_t scope_id = scope->id;
 #endif
@@ -300,6 +462,7 @@ runtime_api_scope_token_t sched_rscope_add(sched_rscope_t* scope, const runtime_
 	entry->data->refcnt = 1;
 	entry->next = scope->head;
 	entry->scope_id = scope->id;
+	entry->scope = scope;
 	scope->head = ret;
 
 	LOG_DEBUG("Request local scope entry %u has been used for request local scope %"PRIu64, ret, scope->id);
@@ -378,6 +541,15 @@ sched_rscope_stream_t* sched_rscope_stream_open(runtime_api_scope_token_t token)
 		old_refcnt = ret->entity->refcnt;
 	} while(!__sync_bool_compare_and_swap(&ret->entity->refcnt, old_refcnt, old_refcnt + 1));
 
+	/* The stream may outlive the scope, so the arena the entity data may point to should be kept as well.
+	 * We don't need to care about the arena created after this point, because an opened entity is not
+	 * supposed to be changed anymore */
+	if(NULL == ret->entity->arena && NULL != target->scope->arena)
+	{
+		__sync_fetch_and_add(&target->scope->arena->refcnt, 1);
+		ret->entity->arena = target->scope->arena;
+	}
+
 	return ret;
 ERR:
 	if(NULL != ret) mempool_objpool_dealloc(_stream_pool, ret);
@@ -456,3 +628,21 @@ int sched_rscope_stream_get_event(sched_rscope_stream_t* stream, runtime_api_sco
 	return ent->entity.event_func(stream->handle, buf);
 }
 
+int sched_rscope_stream_get_region(sched_rscope_stream_t* stream, runtime_api_scope_file_region_t* buf)
+{
+	if(NULL == stream || NULL == buf)
+		ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	_scope_entity_t* ent = stream->entity;
+
+	if(ent->entity.region_func == NULL)
+		return 0;
+
+	int rc = ent->entity.region_func(stream->handle, buf);
+
+	if(rc == 1)
+		LOG_DEBUG("RLS stream %u has been taken as a file region of %zu bytes", stream->token, buf->size);
+
+	return rc;
+}
+
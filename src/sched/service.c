@@ -51,6 +51,7 @@ typedef struct {
 	size_t*  pipe_header_size;                  /*!< the size of pipe header */
 	runtime_task_flags_t flags;                 /*!< the additional task flags */
 	sched_service_pipe_descriptor_t* outgoing;  /*!< outgoing list */
+	const sched_service_pipe_plan_t* plan;      /*!< the execution plan of the outgoing pipes, which is a slice of the service plan */
 	uintpad_t __padding__[0];
 	sched_service_pipe_descriptor_t incoming[0];/*!< the incoming list */
 } _node_t;
@@ -74,6 +75,7 @@ struct _sched_service_t {
 	sched_cnode_info_t*   c_nodes;        /*!< the critical node */
 	size_t node_count;                    /*!< how many nodes in this service */
 	sched_prof_t*         profiler;       /*!< the profiler for this service */
+	sched_service_pipe_plan_t* plan;      /*!< the execution plan for all the outgoing pipes, grouped by node */
 	uintpad_t __padding__[0];
 	_node_t*  nodes[0];                   /*!< the node list */
 };
@@ -107,6 +109,7 @@ static inline sched_service_t* _create_service(size_t num_nodes)
 	ret->node_count = num_nodes;
 	memset(ret->nodes, 0, size - sizeof(sched_service_t));
 	ret->c_nodes = NULL;
+	ret->plan = NULL;
 	return ret;
 }
 
@@ -126,6 +129,7 @@ static inline _node_t* _create_node(runtime_stab_entry_t servlet, runtime_task_f
 	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for service node");
 
 	ret->outgoing = ret->incoming + incoming_count;
+	ret->plan = NULL;
 	ret->incoming_count = ret->outgoing_count = 0;
 	ret->servlet_id = servlet;
 	ret->flags = flags;
@@ -477,6 +481,63 @@ static inline int _compare_src_pipe(const void* l, const void* r)
 	return 0;
 }
 
+/**
+ * @brief compile the execution plan for all the outgoing pipes in the service
+ * @note this must be called after the type checker, since we need the header size of the typed pipes
+ * @param service the service to compile
+ * @return status code
+ **/
+static inline int _compile_plan(sched_service_t* service)
+{
+	size_t i, count = 0;
+	uint32_t j;
+
+	for(i = 0; i < service->node_count; i ++)
+		count += service->nodes[i]->outgoing_count;
+
+	/* Even if there's no pipe at all, we still want a valid address for each node */
+	if(NULL == (service->plan = (sched_service_pipe_plan_t*)calloc(count > 0 ? count : 1, sizeof(sched_service_pipe_plan_t))))
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the service execution plan");
+
+	sched_service_pipe_plan_t* plan = service->plan;
+
+	for(i = 0; i < service->node_count; i ++)
+	{
+		_node_t* node = service->nodes[i];
+		node->plan = plan;
+
+		for(j = 0; j < node->outgoing_count; j ++, plan ++)
+		{
+			const sched_service_pipe_descriptor_t* pd = node->outgoing + j;
+			const _node_t* dst = service->nodes[pd->destination_node_id];
+
+			runtime_api_pipe_flags_t out_flags = runtime_stab_get_pipe_flags(node->servlet_id, pd->source_pipe_desc);
+			if(ERROR_CODE(runtime_api_pipe_flags_t) == out_flags)
+				ERROR_RETURN_LOG(int, "Cannot get output pipe flags");
+
+			runtime_api_pipe_flags_t in_flags = runtime_stab_get_pipe_flags(dst->servlet_id, pd->destination_pipe_desc);
+			if(ERROR_CODE(runtime_api_pipe_flags_t) == in_flags)
+				ERROR_RETURN_LOG(int, "Cannot get input pipe flags");
+
+			plan->desc = *pd;
+			plan->param.output_flags = out_flags;
+			plan->param.output_header = node->pipe_header_size[pd->source_pipe_desc];
+			plan->param.input_flags = in_flags;
+			plan->param.input_header = dst->pipe_header_size[pd->destination_pipe_desc];
+			plan->param.args = NULL;
+
+			if(out_flags & RUNTIME_API_PIPE_SHADOW)
+			{
+				plan->shadow = 1;
+				plan->shadow_target = RUNTIME_API_PIPE_GET_TARGET(out_flags);
+				plan->shadow_flags = in_flags | RUNTIME_API_PIPE_SHADOW | plan->shadow_target | (out_flags & RUNTIME_API_PIPE_DISABLED);
+			}
+		}
+	}
+
+	return 0;
+}
+
 sched_service_t* sched_service_from_buffer(const sched_service_buffer_t* buffer)
 {
 	uint32_t i;
@@ -583,6 +644,9 @@ sched_service_t* sched_service_from_buffer(const sched_service_buffer_t* buffer)
 	if(ERROR_CODE(int) == sched_type_check(ret))
 		ERROR_LOG_GOTO(ERR, "Service type checker failed");
 
+	if(ERROR_CODE(int) == _compile_plan(ret))
+		ERROR_LOG_GOTO(ERR, "Cannot compile the service execution plan");
+
 	return ret;
 ERR:
 	if(ret != NULL)
@@ -591,6 +655,7 @@ ERR:
 			if(ret->nodes[i] != NULL)
 				_dispose_node(ret->nodes[i]);
 		if(ret->c_nodes != NULL) sched_cnode_info_free(ret->c_nodes);
+		if(ret->plan != NULL) free(ret->plan);
 		free(ret);
 	}
 	if(incoming_count != NULL) free(incoming_count);
@@ -617,6 +682,8 @@ int sched_service_free(sched_service_t* service)
 		rc = ERROR_CODE(int);
 #endif
 
+	if(NULL != service->plan) free(service->plan);
+
 	free(service);
 	return rc;
 }
@@ -658,6 +725,19 @@ const sched_service_pipe_descriptor_t* sched_service_get_outgoing_pipes(const sc
 	return node->outgoing;
 }
 
+const sched_service_pipe_plan_t* sched_service_get_outgoing_plan(const sched_service_t* service, sched_service_node_id_t nid, uint32_t* nresult)
+{
+	if(NULL == service || nid == ERROR_CODE(sched_service_node_id_t) || nid >= service->node_count || NULL == nresult)
+		ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	const _node_t* node = service->nodes[nid];
+
+	if(NULL == node) ERROR_PTR_RETURN_LOG("Invalid service def, node #%d is NULL", nid);
+	if(NULL == node->plan) ERROR_PTR_RETURN_LOG("The execution plan of node #%d is not compiled", nid);
+	*nresult = node->outgoing_count;
+	return node->plan;
+}
+
 char const* const* sched_service_get_node_args(const sched_service_t* service, sched_service_node_id_t nid, uint32_t* argc)
 {
 	if(NULL == service || nid == ERROR_CODE(sched_service_node_id_t) || nid >= service->node_count || NULL == argc)
@@ -714,6 +794,15 @@ int sched_service_profiler_timer_start(const sched_service_t* service, sched_ser
 	return sched_prof_start_timer(service->profiler, node);
 }
 
+int sched_service_profiler_pipe_timer_start(const sched_service_t* service, sched_service_node_id_t node, uint32_t pipe)
+{
+	if(NULL == service || node == ERROR_CODE(sched_service_node_id_t)) ERROR_RETURN_LOG(int, "Invlaid arguments");
+
+	if(service->profiler == NULL) return 0;
+
+	return sched_prof_start_pipe_timer(service->profiler, node, pipe);
+}
+
 int sched_service_profiler_timer_stop(const sched_service_t* service)
 {
 	if(NULL == service) ERROR_RETURN_LOG(int, "Invalid arguments");
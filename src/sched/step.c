@@ -24,7 +24,7 @@ int sched_step_next(sched_task_context_t* stc, itc_module_type_t type)
 {
 	sched_task_t* task = NULL;
 	uint32_t size, i;
-	const sched_service_pipe_descriptor_t* result;
+	const sched_service_pipe_plan_t* plan;
 	itc_module_pipe_t *pipes[2];
 	int async_post_rc;
 
@@ -38,8 +38,9 @@ START_OVER:
 		return 0;
 	}
 
-	if(NULL == (result = sched_service_get_outgoing_pipes(task->service, task->node, &size)))
-		ERROR_LOG_GOTO(LERR, "Cannot get outgoing pipes");
+	/* All the static information about the outgoing pipes is precompiled in the service execution plan */
+	if(NULL == (plan = sched_service_get_outgoing_plan(task->service, task->node, &size)))
+		ERROR_LOG_GOTO(LERR, "Cannot get the execution plan of the outgoing pipes");
 
 	/* We should initialize the pipes only for the sync request and the async init */
 	int pipe_init = (!runtime_task_is_async(task->exec_task)) || !(task->exec_task->flags & (RUNTIME_TASK_FLAG_ACTION_UNLOAD | RUNTIME_TASK_FLAG_ACTION_EXEC));
@@ -49,58 +50,34 @@ START_OVER:
 	{
 		if(pipe_init)
 		{
-			runtime_api_pipe_flags_t out_flags = 0, in_flags = 0;
-
-			out_flags = sched_service_get_pipe_flags(task->service, result[i].source_node_id, result[i].source_pipe_desc);
-			if(ERROR_CODE(runtime_api_pipe_flags_t) == out_flags)
-				ERROR_LOG_GOTO(LERR, "Cannot get output pipe flags");
-
-			in_flags = sched_service_get_pipe_flags(task->service, result[i].destination_node_id, result[i].destination_pipe_desc);
-			if(ERROR_CODE(runtime_api_pipe_flags_t) == in_flags)
-				ERROR_LOG_GOTO(LERR, "Cannot get input pipe flags");
-
-			size_t input_header_size, output_header_size;
-
-			if(ERROR_CODE(size_t) == (output_header_size = sched_service_get_pipe_type_size(task->service,
-			                                                                                result[i].source_node_id,
-			                                                                                result[i].source_pipe_desc)))
-				ERROR_LOG_GOTO(LERR, "Cannot get the size of output header size");
-
-			if(ERROR_CODE(size_t) == (input_header_size = sched_service_get_pipe_type_size(task->service,
-			                                                                               result[i].destination_node_id,
-			                                                                               result[i].destination_pipe_desc)))
-				ERROR_LOG_GOTO(LERR, "Cannot get the size of output header size");
-
-			itc_module_pipe_param_t param = {
-				.output_flags  = out_flags,
-				.output_header = output_header_size,
-				.input_flags   = in_flags,
-				.input_header  = input_header_size,
-				.args = NULL
-			};
-
-			if(out_flags & RUNTIME_API_PIPE_SHADOW)
+#ifdef ENABLE_PROFILER
+			if(sched_service_profiler_pipe_timer_start(task->service, task->node, i) == ERROR_CODE(int))
+				LOG_WARNING("Cannot start the pipe profiler");
+#endif
+			if(plan[i].shadow)
 			{
-				runtime_api_pipe_id_t target_pid = RUNTIME_API_PIPE_GET_TARGET(out_flags);
-				runtime_api_pipe_flags_t disabled = (out_flags & RUNTIME_API_PIPE_DISABLED);
 				pipes[0] = NULL;
-				pipes[1] = itc_module_pipe_fork(task->exec_task->pipes[target_pid], in_flags | RUNTIME_API_PIPE_SHADOW | target_pid | disabled, input_header_size, NULL);
+				pipes[1] = itc_module_pipe_fork(task->exec_task->pipes[plan[i].shadow_target], plan[i].shadow_flags, plan[i].param.input_header, NULL);
 
-				if(ERROR_CODE(int) == sched_task_output_shadow(task, result[i].source_pipe_desc, pipes[1]))
+				if(ERROR_CODE(int) == sched_task_output_shadow(task, plan[i].desc.source_pipe_desc, pipes[1]))
 					ERROR_LOG_GOTO(LERR, "Cannot add the forked pipe as shadow");
 			}
-			else if(itc_module_pipe_allocate(type, 0, param, pipes + 0, pipes + 1) < 0)
+			else if(itc_module_pipe_allocate(type, 0, plan[i].param, pipes + 0, pipes + 1) < 0)
 				ERROR_LOG_GOTO(LERR, "Cannot allocate pipe from <NID = %d, PID = %d> -> <NID = %d, PID = %d>",
-				                     result[i].source_node_id, result[i].source_pipe_desc,
-				                     result[i].destination_node_id, result[i].destination_pipe_desc);
+				                     plan[i].desc.source_node_id, plan[i].desc.source_pipe_desc,
+				                     plan[i].desc.destination_node_id, plan[i].desc.destination_pipe_desc);
 
-			if(pipes[0] != NULL && sched_task_output_pipe(task, result[i].source_pipe_desc, pipes[0]) == ERROR_CODE(int))
+			if(pipes[0] != NULL && sched_task_output_pipe(task, plan[i].desc.source_pipe_desc, pipes[0]) == ERROR_CODE(int))
 				ERROR_LOG_GOTO(LERR, "Cannot assign output pipe to the task");
 
-			if(sched_task_input_pipe(stc, task->service, task->request, result[i].destination_node_id, result[i].destination_pipe_desc, pipes[1], async_init) == ERROR_CODE(int))
+			if(sched_task_input_pipe(stc, task->service, task->request, plan[i].desc.destination_node_id, plan[i].desc.destination_pipe_desc, pipes[1], async_init) == ERROR_CODE(int))
 				ERROR_LOG_GOTO(LERR, "Cannot assign the input pipe to the downstream task");
+#ifdef ENABLE_PROFILER
+			if(sched_service_profiler_timer_stop(task->service) == ERROR_CODE(int))
+				LOG_WARNING("Cannot stop the pipe profiler");
+#endif
 		}
-		else if(ERROR_CODE(int) == sched_task_input_pipe(stc, task->service, task->request, result[i].destination_node_id, result[i].destination_pipe_desc, NULL, 1))
+		else if(ERROR_CODE(int) == sched_task_input_pipe(stc, task->service, task->request, plan[i].desc.destination_node_id, plan[i].desc.destination_pipe_desc, NULL, 1))
 			ERROR_LOG_GOTO(LERR, "Cannot set the async task pipe to ready state");
 	}
 
@@ -108,11 +85,8 @@ START_OVER:
 	{
 
 #ifdef ENABLE_PROFILER
-		static __thread int counter = 0;
-
 		if(sched_service_profiler_timer_start(task->service, task->node) == ERROR_CODE(int))
 			LOG_WARNING("Cannot start the profiler");
-		counter ++;
 #endif
 		_current_request_scope = task->scope;
 		/* TODO: what should we do for the async task ? */
@@ -131,11 +105,6 @@ START_OVER:
 #ifdef ENABLE_PROFILER
 		if(sched_service_profiler_timer_stop(task->service) == ERROR_CODE(int))
 			LOG_WARNING("Cannot stop the profiler");
-		if(counter > 10000)
-		{
-			sched_service_profiler_flush(task->service);
-			counter = 0;
-		}
 #endif
 		if(pipe_init == 0)
 		{
@@ -156,9 +125,9 @@ START_OVER:
 			for(i = 0; i < size; i ++)
 			{
 				int touched = 0;
-				if(result[i].source_pipe_desc != task->exec_task->servlet->sig_null &&
-				   result[i].source_pipe_desc != task->exec_task->servlet->sig_error &&
-				   ERROR_CODE(int) == (touched = itc_module_pipe_is_touched(task->exec_task->pipes[RUNTIME_API_PIPE_TO_PID(result[i].source_pipe_desc)])))
+				if(plan[i].desc.source_pipe_desc != task->exec_task->servlet->sig_null &&
+				   plan[i].desc.source_pipe_desc != task->exec_task->servlet->sig_error &&
+				   ERROR_CODE(int) == (touched = itc_module_pipe_is_touched(task->exec_task->pipes[RUNTIME_API_PIPE_TO_PID(plan[i].desc.source_pipe_desc)])))
 					ERROR_LOG_GOTO(LERR, "Cannot check if the pipe has been touched");
 				if(touched) break;
 			}
@@ -175,7 +144,7 @@ START_OVER:
 	{
 		/* In this case, we cannot start the async task, so we need notify the downstream right now */
 		for(i = 0; i < size; i ++)
-			sched_task_input_pipe(stc, task->service, task->request, result[i].destination_node_id, result[i].destination_pipe_desc, NULL, 1);
+			sched_task_input_pipe(stc, task->service, task->request, plan[i].desc.destination_node_id, plan[i].desc.destination_pipe_desc, NULL, 1);
 
 		ERROR_LOG_GOTO(TASK_FAILED, "Cannot launch the async task");
 	}
@@ -201,9 +170,9 @@ TASK_FAILED:
 	/* First, the error code means all the output is not reliable */
 	for(i = 0; i < size; i ++)
 	{
-		if(result[i].source_pipe_desc != task->exec_task->servlet->sig_null &&
-		   result[i].source_pipe_desc != task->exec_task->servlet->sig_error &&
-		   ERROR_CODE(int) == itc_module_pipe_set_error(task->exec_task->pipes[RUNTIME_API_PIPE_TO_PID(result[i].source_pipe_desc)]))
+		if(plan[i].desc.source_pipe_desc != task->exec_task->servlet->sig_null &&
+		   plan[i].desc.source_pipe_desc != task->exec_task->servlet->sig_error &&
+		   ERROR_CODE(int) == itc_module_pipe_set_error(task->exec_task->pipes[RUNTIME_API_PIPE_TO_PID(plan[i].desc.source_pipe_desc)]))
 			ERROR_LOG_GOTO(LERR, "Cannot set the error state to all the output pipes");
 	}
 
@@ -13,11 +13,16 @@
 #include <limits.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <signal.h>
 
 #include <error.h>
 #include <barrier.h>
+#include <utils/thread.h>
 
 
 __attribute__((used)) /* make sure clang won't complain about unused variables */
@@ -36,6 +41,907 @@ static pthread_mutex_t _log_mutex;
 static int _log_mutex_active = 0;
 
 
+/**
+ * @brief the header of a log record in the ring buffer
+ * @note the records are padded to 8 bytes, thus the header never wraps around the end of the buffer
+ **/
+typedef struct {
+	uint32_t size;    /*!< the size of the formatted message */
+	uint32_t level;   /*!< the level of the message */
+} _record_t;
+
+/**
+ * @brief the per-thread ring buffer of the formatted log records
+ * @details only the owner thread pushes records to the buffer and only the writer thread consumes them,
+ *          thus both the head and the tail are updated without a lock. When the owner thread exits, the
+ *          buffer is released and can be picked up by another thread
+ **/
+typedef struct _ring_t {
+	uint64_t        head;     /*!< the number of bytes pushed, only changed by the owner thread */
+	uint64_t        tail;     /*!< the number of bytes written, only changed by the writer thread */
+	int             owned;    /*!< if this buffer is currently owned by a thread */
+	struct _ring_t* next;     /*!< the next buffer in the buffer list */
+	uint64_t        size;     /*!< the size of the buffer, must be a power of 2 */
+	char            data[0];  /*!< the actual buffer */
+} _ring_t;
+
+/**
+ * @brief the size of the ring buffer for each thread, 0 if the logs should be written synchronously
+ **/
+static uint64_t _async_ring_size;
+
+/**
+ * @brief the list of all the ring buffers
+ **/
+static _ring_t* volatile _rings;
+
+/**
+ * @brief if the writer thread is running
+ **/
+static int _async_running;
+
+/**
+ * @brief if the writer thread should be started by the next log write, this happens in the child process after fork
+ **/
+static int _async_restart;
+
+/**
+ * @brief if the writer thread should exit once all the buffers are written
+ **/
+static int _async_stopping;
+
+/**
+ * @brief if the writer thread is waiting for the new records
+ **/
+static int _writer_sleeping;
+
+/**
+ * @brief how many threads are waiting for the buffers being written
+ **/
+static uint32_t _drain_waiters;
+
+/**
+ * @brief the number of writing rounds the writer thread has completed
+ **/
+static uint64_t _async_rounds;
+
+/**
+ * @brief the generation of the buffer list, which changes each time the buffers are disposed
+ **/
+static uint32_t _async_gen;
+
+/**
+ * @brief the number of log records dropped because the buffer is full
+ **/
+static uint64_t _dropped;
+
+/**
+ * @brief the number of dropped records which has been reported in the log
+ **/
+static uint64_t _dropped_reported;
+
+/**
+ * @brief if the fork handlers have been installed and the fork is in progress
+ **/
+static int _hooks_installed, _forking;
+
+/**
+ * @brief the writer thread
+ **/
+static pthread_t _writer;
+
+/**
+ * @brief the stack of the writer thread
+ * @note we provide the stack, because the thread local storage of a thread with its own stack is released
+ *       once the thread is joined, instead of being kept in the stack cache of the pthread library
+ **/
+static void* _writer_stack;
+
+/**
+ * @brief the mutex used by the writer thread to wait for the records
+ **/
+static pthread_mutex_t _async_mutex;
+
+/**
+ * @brief signaled when there are new records for the writer thread
+ **/
+static pthread_cond_t _writer_cond;
+
+/**
+ * @brief broadcasted by the writer thread each time a writing round is completed
+ **/
+static pthread_cond_t _drain_cond;
+
+/**
+ * @brief the key used to release the buffer when the owner thread exits
+ **/
+static pthread_key_t _ring_key;
+
+/**
+ * @brief the buffer owned by current thread
+ **/
+static __thread _ring_t* _thread_ring;
+
+/**
+ * @brief the buffer generation of the buffer owned by current thread
+ **/
+static __thread uint32_t _thread_ring_gen;
+
+/**
+ * @brief if current thread is writing a log, which means the log is written by a signal handler
+ *        interrupting the log writing
+ **/
+static __thread int _thread_in_log;
+
+/**
+ * @brief check if the log file has been deleted
+ * @param level the level of the log message
+ * @return status code
+ **/
+static inline int _check_log_file(int level)
+{
+	if(_log_fp[level] == &_fp_off || _log_fp[level] == NULL)
+		return 0;
+
+	int fd = fileno(_log_fp[level]);
+
+	if(-1 == fd) return ERROR_CODE(int);
+
+	if(fd == STDIN_FILENO || fd == STDOUT_FILENO || fd == STDERR_FILENO)
+		return 0;
+
+	struct stat st;
+	if(fstat(fd, &st) != 0) return ERROR_CODE(int);
+
+	int reopen = 0;
+	if(st.st_nlink == 0) reopen = 1;
+	else if(access(_log_path[level], F_OK) != 0) reopen = 1;
+
+	if(reopen)
+	{
+		FILE* prev = _log_fp[level];
+		fclose(_log_fp[level]);
+		if(NULL == (_log_fp[level] = fopen(_log_path[level], _log_mode[level])))
+		{
+			_log_fp[level] = &_fp_off;
+			return ERROR_CODE(int);
+		}
+
+		int i;
+		for(i = 0; i < 8; i ++)
+			if(_log_fp[i] == prev) _log_fp[i] = _log_fp[level];
+	}
+
+	return 0;
+}
+
+/**
+ * @brief check if the filename is in the plumber code base
+ * @param filename the filename to check
+ * @return the result
+ * @note this function do not check for the null pointer
+ **/
+static inline int _is_framework_code(const char* filename)
+{
+	const char* ptr = _src_root;
+	for(;*ptr && *ptr == *filename; ptr ++, filename ++);
+	return !*ptr;
+}
+
+/**
+ * @brief format the prefix of the log message
+ * @param buf the output buffer
+ * @param size the size of the buffer
+ * @param level the log level
+ * @param file the source code file
+ * @param function the function name
+ * @param line the line number
+ * @return the return value of snprintf
+ **/
+static inline int _format_prefix(char* buf, size_t size, int level, const char* file, const char* function, int line)
+{
+	static const char level_char[] = "FEWNITD";
+
+	if(_is_framework_code(file))
+		file += _src_root_length;
+
+	struct timespec time;
+
+	clock_gettime(CLOCK_REALTIME, &time);
+
+	/* Formatting the timestamp as integers is much cheaper than formatting a double */
+	return snprintf(buf, size, "%c[%9ld.%06ld|%s@%s:%d] ", level_char[level], (long)time.tv_sec, time.tv_nsec / 1000, function, file, line);
+}
+
+/**
+ * @brief write the log message to the log file directly
+ * @param level the log level
+ * @param prefix the message prefix
+ * @param fmt the formating string
+ * @param ap the arguments
+ * @return nothing
+ **/
+static void _write_sync(int level, const char* prefix, const char* fmt, va_list ap)
+{
+	int locked = 0;
+	if(_log_mutex_active || _async_running)
+	{
+		if((errno = pthread_mutex_lock(&_log_mutex)) != 0)
+		{
+			perror("mutex error");
+			return;
+		}
+		else locked = 1;
+	}
+
+	if(_log_fp[level] == &_fp_off) goto UNLOCK;
+
+	if(_check_log_file(level) == ERROR_CODE(int))
+	{
+		perror("logging error");
+		goto UNLOCK;
+	}
+
+	FILE* fp = _log_fp[level];
+
+	if(fp != stderr && _log_stderr[level])
+	{
+		va_list ap_copy;
+		va_copy(ap_copy, ap);
+		flockfile(stderr);
+		fputs(prefix, stderr);
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wformat-nonliteral"
+#endif
+		vfprintf(stderr, fmt, ap_copy);
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+		va_end(ap_copy);
+		fprintf(stderr, "\n");
+		fflush(stderr);
+		funlockfile(stderr);
+	}
+
+	flockfile(fp);
+	fputs(prefix, fp);
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wformat-nonliteral"
+#endif
+	vfprintf(fp, fmt, ap);
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+	fprintf(fp, "\n");
+	fflush(fp);
+	funlockfile(fp);
+
+UNLOCK:
+	if(locked && (errno = pthread_mutex_unlock(&_log_mutex)) != 0)
+		perror("mutex error");
+}
+
+/**
+ * @brief get the size of the record in the ring buffer
+ * @param size the size of the message
+ * @return the record size
+ **/
+static inline uint64_t _record_size(uint32_t size)
+{
+	return (sizeof(_record_t) + size + 7) & ~(uint64_t)7;
+}
+
+/**
+ * @brief release the buffer owned by an exiting thread
+ * @param data the buffer
+ * @return nothing
+ **/
+static void _ring_release(void* data)
+{
+	_ring_t* ring = (_ring_t*)data;
+
+	__sync_synchronize();
+
+	ring->owned = 0;
+}
+
+/**
+ * @brief get the buffer for current thread, either pick up a released one or create a new one
+ * @return the buffer or NULL on error
+ **/
+static _ring_t* _ring_acquire(void)
+{
+	_ring_t* ring;
+
+	for(ring = _rings; NULL != ring; ring = ring->next)
+		if(!ring->owned && __sync_bool_compare_and_swap(&ring->owned, 0, 1))
+			goto FOUND;
+
+	if(NULL == (ring = (_ring_t*)malloc(sizeof(_ring_t) + _async_ring_size)))
+		return NULL;
+
+	ring->head = ring->tail = 0;
+	ring->owned = 1;
+	ring->size = _async_ring_size;
+
+	do {
+		ring->next = _rings;
+	} while(!__sync_bool_compare_and_swap(&_rings, ring->next, ring));
+
+FOUND:
+	if((errno = pthread_setspecific(_ring_key, ring)) != 0)
+		perror("cannot set the thread local log buffer");
+
+	_thread_ring = ring;
+	_thread_ring_gen = _async_gen;
+
+	return ring;
+}
+
+/**
+ * @brief push a formatted message to the buffer
+ * @note only the owner thread can call this function
+ * @param ring the buffer
+ * @param level the log level
+ * @param msg the message
+ * @param size the size of the message
+ * @return 1 if the message has been pushed, 0 if the buffer is full
+ **/
+static inline int _ring_push(_ring_t* ring, int level, const char* msg, uint32_t size)
+{
+	uint64_t rec_size = _record_size(size);
+	uint64_t head = ring->head;
+	uint64_t tail = *(volatile uint64_t*)&ring->tail;
+
+	if(head + rec_size - tail > ring->size) return 0;
+
+	_record_t* rec = (_record_t*)(ring->data + (head & (ring->size - 1)));
+	rec->size = size;
+	rec->level = (uint32_t)level;
+
+	uint64_t begin = (head + sizeof(_record_t)) & (ring->size - 1);
+	uint64_t first = ring->size - begin;
+	if(first > size) first = size;
+
+	memcpy(ring->data + begin, msg, first);
+	memcpy(ring->data, msg + first, size - first);
+
+	/* Make sure the record is visible before the writer can see the new head */
+	__sync_synchronize();
+
+	*(volatile uint64_t*)&ring->head = head + rec_size;
+
+	return 1;
+}
+
+/**
+ * @brief check if there's any record haven't been written
+ * @return the check result
+ **/
+static inline int _async_pending(void)
+{
+	const _ring_t* ring;
+	for(ring = _rings; NULL != ring; ring = ring->next)
+		if(*(const volatile uint64_t*)&ring->head != ring->tail)
+			return 1;
+	return 0;
+}
+
+/**
+ * @brief add the file to the list of files should be flushed
+ * @param list the file list
+ * @param count the number of files in the list
+ * @param fp the file to add
+ * @return nothing
+ **/
+static inline void _touch_file(FILE** list, uint32_t* count, FILE* fp)
+{
+	uint32_t i;
+	for(i = 0; i < *count; i ++)
+		if(list[i] == fp) return;
+	list[(*count)++] = fp;
+}
+
+/**
+ * @brief write the message in the buffer to the file
+ * @param fp the target file
+ * @param ring the buffer
+ * @param begin the offset of the message in the buffer
+ * @param size the size of the message
+ * @return nothing
+ **/
+static inline void _write_record(FILE* fp, const _ring_t* ring, uint64_t begin, uint32_t size)
+{
+	uint64_t first = ring->size - begin;
+	if(first > size) first = size;
+
+	if(fwrite(ring->data + begin, 1, first, fp) != first ||
+	   fwrite(ring->data, 1, size - first, fp) != size - first)
+		perror("logging error");
+}
+
+/**
+ * @brief write all the records in the buffers to the log files
+ * @return the number of bytes has been consumed from the buffers
+ **/
+static uint64_t _async_write_round(void)
+{
+	uint64_t ret = 0;
+	uint32_t checked = 0, ntouched = 0, i;
+	FILE* touched[9];
+	_ring_t* ring;
+
+	if((errno = pthread_mutex_lock(&_log_mutex)) != 0)
+	{
+		perror("mutex error");
+		return 0;
+	}
+
+	for(ring = _rings; NULL != ring; ring = ring->next)
+	{
+		uint64_t head = *(volatile uint64_t*)&ring->head;
+		uint64_t tail = ring->tail;
+
+		/* Make sure we read the records after the head */
+		__sync_synchronize();
+
+		while(tail < head)
+		{
+			const _record_t* rec = (const _record_t*)(ring->data + (tail & (ring->size - 1)));
+			int level = (int)rec->level;
+			uint32_t size = rec->size;
+			uint64_t begin = (tail + sizeof(_record_t)) & (ring->size - 1);
+
+			tail += _record_size(size);
+
+			/* We only check if the file is deleted once per round, since it takes two system calls */
+			if(!(checked & (1u << level)))
+			{
+				checked |= (1u << level);
+				if(_check_log_file(level) == ERROR_CODE(int))
+					perror("logging error");
+			}
+
+			FILE* fp = _log_fp[level];
+
+			if(fp == &_fp_off || fp == NULL) continue;
+
+			if(fp != stderr && _log_stderr[level])
+			{
+				_write_record(stderr, ring, begin, size);
+				_touch_file(touched, &ntouched, stderr);
+			}
+
+			_write_record(fp, ring, begin, size);
+			_touch_file(touched, &ntouched, fp);
+		}
+
+		ret += tail - ring->tail;
+
+		/* Make sure we have done with the records before the owner overwrites them */
+		__sync_synchronize();
+
+		*(volatile uint64_t*)&ring->tail = tail;
+	}
+
+	uint64_t dropped = *(volatile uint64_t*)&_dropped;
+	if(dropped != _dropped_reported && _log_fp[WARNING] != &_fp_off && _log_fp[WARNING] != NULL)
+	{
+		char prefix[1024];
+		_format_prefix(prefix, sizeof(prefix), WARNING, __FILE__, __FUNCTION__, __LINE__);
+		fprintf(_log_fp[WARNING], "%s%"PRIu64" log records have been dropped because the log buffer is full\n", prefix, dropped - _dropped_reported);
+		_touch_file(touched, &ntouched, _log_fp[WARNING]);
+		_dropped_reported = dropped;
+	}
+
+	for(i = 0; i < ntouched; i ++)
+		fflush(touched[i]);
+
+	if((errno = pthread_mutex_unlock(&_log_mutex)) != 0)
+		perror("mutex error");
+
+	return ret;
+}
+
+/**
+ * @brief the main function of the writer thread
+ * @param arg the thread argument
+ * @return nothing
+ **/
+static void* _writer_main(void* arg)
+{
+	(void)arg;
+
+	/* The writer should never be interrupted by a signal handler */
+	sigset_t mask;
+	sigfillset(&mask);
+	if((errno = pthread_sigmask(SIG_BLOCK, &mask, NULL)) != 0)
+		perror("cannot block the signals for the log writer");
+
+	thread_set_name("LogWriterThread");
+
+	for(;;)
+	{
+		int stop = *(volatile int*)&_async_stopping;
+
+		uint64_t written = _async_write_round();
+
+		if((errno = pthread_mutex_lock(&_async_mutex)) != 0)
+		{
+			perror("mutex error");
+			continue;
+		}
+
+		_async_rounds ++;
+
+		if((errno = pthread_cond_broadcast(&_drain_cond)) != 0)
+			perror("cannot notify the log writer waiters");
+
+		if(stop && written == 0)
+		{
+			_async_running = 0;
+			pthread_mutex_unlock(&_async_mutex);
+			break;
+		}
+
+		if(written == 0 && !_async_stopping && _drain_waiters == 0)
+		{
+			_writer_sleeping = 1;
+
+			/* Make sure either the writer can see the new records, or the owner can see the writer is sleeping */
+			__sync_synchronize();
+
+			if(!_async_pending())
+			{
+				struct timespec abstime;
+				clock_gettime(CLOCK_REALTIME, &abstime);
+				abstime.tv_nsec += (LOG_ASYNC_FLUSH_INTERVAL % 1000) * 1000000l;
+				abstime.tv_sec += LOG_ASYNC_FLUSH_INTERVAL / 1000 + abstime.tv_nsec / 1000000000l;
+				abstime.tv_nsec %= 1000000000l;
+
+				if((errno = pthread_cond_timedwait(&_writer_cond, &_async_mutex, &abstime)) != 0 && errno != ETIMEDOUT)
+					perror("cannot wait for the log records");
+			}
+
+			_writer_sleeping = 0;
+		}
+
+		if((errno = pthread_mutex_unlock(&_async_mutex)) != 0)
+			perror("mutex error");
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief wake up the writer thread if it's sleeping
+ * @return nothing
+ **/
+static inline void _async_wake(void)
+{
+	__sync_synchronize();
+
+	if(!*(volatile int*)&_writer_sleeping) return;
+
+	if((errno = pthread_mutex_lock(&_async_mutex)) != 0)
+	{
+		perror("mutex error");
+		return;
+	}
+
+	if((errno = pthread_cond_signal(&_writer_cond)) != 0)
+		perror("cannot wake up the log writer");
+
+	if((errno = pthread_mutex_unlock(&_async_mutex)) != 0)
+		perror("mutex error");
+}
+
+/**
+ * @brief wait until all the records pushed before this function is called have been written
+ * @return nothing
+ **/
+static void _async_flush(void)
+{
+	if(!_async_running || pthread_equal(pthread_self(), _writer)) return;
+
+	if((errno = pthread_mutex_lock(&_async_mutex)) != 0)
+	{
+		perror("mutex error");
+		return;
+	}
+
+	/* The current round may have missed the records, but the next one won't */
+	uint64_t target = _async_rounds + 2;
+
+	_drain_waiters ++;
+
+	if((errno = pthread_cond_signal(&_writer_cond)) != 0)
+		perror("cannot wake up the log writer");
+
+	while(_async_running && _async_rounds < target)
+		if((errno = pthread_cond_wait(&_drain_cond, &_async_mutex)) != 0)
+		{
+			perror("cannot wait for the log writer");
+			break;
+		}
+
+	_drain_waiters --;
+
+	if((errno = pthread_mutex_unlock(&_async_mutex)) != 0)
+		perror("mutex error");
+}
+
+/**
+ * @brief start the writer thread
+ * @return status code
+ **/
+static int _async_start(void)
+{
+	pthread_attr_t attr;
+
+	if((errno = pthread_attr_init(&attr)) != 0)
+	{
+		perror("cannot initialize the thread attribute");
+		return ERROR_CODE(int);
+	}
+
+	if((errno = pthread_attr_setstack(&attr, _writer_stack, LOG_ASYNC_WRITER_STACK_SIZE)) != 0)
+	{
+		perror("cannot set the stack for the log writer thread");
+		goto ERR;
+	}
+
+	_async_stopping = 0;
+	_async_running = 1;
+
+	if((errno = pthread_create(&_writer, &attr, _writer_main, NULL)) != 0)
+	{
+		perror("cannot start the log writer thread");
+		_async_running = 0;
+		goto ERR;
+	}
+
+	pthread_attr_destroy(&attr);
+	return 0;
+ERR:
+	pthread_attr_destroy(&attr);
+	return ERROR_CODE(int);
+}
+
+/**
+ * @brief make sure the pending records are written before the process exits
+ * @return nothing
+ **/
+static void _on_exit(void)
+{
+	_async_flush();
+}
+
+/**
+ * @brief write the pending records and hold the locks before the process forks
+ * @return nothing
+ **/
+static void _before_fork(void)
+{
+	if(!_async_running) return;
+
+	_async_flush();
+
+	pthread_mutex_lock(&_log_mutex);
+	pthread_mutex_lock(&_async_mutex);
+
+	_forking = 1;
+}
+
+/**
+ * @brief release the locks in the parent process after fork
+ * @return nothing
+ **/
+static void _after_fork_parent(void)
+{
+	if(!_forking) return;
+
+	_forking = 0;
+
+	pthread_mutex_unlock(&_async_mutex);
+	pthread_mutex_unlock(&_log_mutex);
+}
+
+/**
+ * @brief reset the buffers in the child process, since the writer thread doesn't exist anymore
+ * @note the writer thread will be started when the child process writes the first log
+ * @return nothing
+ **/
+static void _after_fork_child(void)
+{
+	if(!_forking) return;
+
+	_forking = 0;
+
+	_ring_t* ring;
+	for(ring = _rings; NULL != ring; ring = ring->next)
+	{
+		/* The records pushed by other threads belong to the parent process */
+		ring->tail = ring->head;
+		if(ring != _thread_ring || _thread_ring_gen != _async_gen)
+			ring->owned = 0;
+	}
+
+	_async_running = 0;
+	_writer_sleeping = 0;
+	_drain_waiters = 0;
+	_async_restart = 1;
+
+	/* The condition variables may still count the writer thread of the parent process as a waiter,
+	 * which never wakes up in the child process, so we need to reinitialize them instead of reusing */
+	if((errno = pthread_cond_init(&_writer_cond, NULL)) != 0 ||
+	   (errno = pthread_cond_init(&_drain_cond, NULL)) != 0 ||
+	   (errno = pthread_mutex_init(&_async_mutex, NULL)) != 0 ||
+	   (errno = pthread_mutex_init(&_log_mutex, NULL)) != 0)
+	{
+		perror("cannot reinitialize the log writer in the child process");
+		_async_restart = 0;
+	}
+}
+
+/**
+ * @brief initialize the asynchronous log writer
+ * @note if the writer can not be started, the logs are written synchronously
+ * @return nothing
+ **/
+static void _async_init(void)
+{
+	if(_async_ring_size == 0) return;
+
+	/* The buffer size should be a power of 2 and large enough for a few messages */
+	uint64_t size;
+	for(size = 4096; size < _async_ring_size; size *= 2);
+	_async_ring_size = size;
+
+	if(MAP_FAILED == (_writer_stack = mmap(NULL, LOG_ASYNC_WRITER_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)))
+	{
+		perror("cannot allocate the stack for the log writer thread");
+		_async_ring_size = 0;
+		return;
+	}
+
+	if((errno = pthread_mutex_init(&_async_mutex, NULL)) != 0)
+	{
+		perror("mutex error");
+		goto ERR_STACK;
+	}
+
+	if((errno = pthread_cond_init(&_writer_cond, NULL)) != 0)
+	{
+		perror("cannot initialize the condition variable");
+		goto ERR_MUTEX;
+	}
+
+	if((errno = pthread_cond_init(&_drain_cond, NULL)) != 0)
+	{
+		perror("cannot initialize the condition variable");
+		goto ERR_WRITER_COND;
+	}
+
+	if((errno = pthread_key_create(&_ring_key, _ring_release)) != 0)
+	{
+		perror("cannot create the thread local key");
+		goto ERR_DRAIN_COND;
+	}
+
+	if(!_hooks_installed)
+	{
+		if((errno = pthread_atfork(_before_fork, _after_fork_parent, _after_fork_child)) != 0)
+		{
+			perror("cannot install the fork handlers");
+			goto ERR_KEY;
+		}
+
+		if(atexit(_on_exit) != 0)
+		{
+			perror("cannot install the exit handler");
+			goto ERR_KEY;
+		}
+
+		_hooks_installed = 1;
+	}
+
+	_async_gen ++;
+	_async_rounds = 0;
+	_dropped = _dropped_reported = 0;
+
+	if(ERROR_CODE(int) == _async_start())
+		goto ERR_KEY;
+
+	return;
+ERR_KEY:
+	pthread_key_delete(_ring_key);
+ERR_DRAIN_COND:
+	pthread_cond_destroy(&_drain_cond);
+ERR_WRITER_COND:
+	pthread_cond_destroy(&_writer_cond);
+ERR_MUTEX:
+	pthread_mutex_destroy(&_async_mutex);
+ERR_STACK:
+	munmap(_writer_stack, LOG_ASYNC_WRITER_STACK_SIZE);
+	_writer_stack = NULL;
+	_async_ring_size = 0;
+	fprintf(stderr, "warning: cannot start the log writer, the logs will be written synchronously\n");
+}
+
+/**
+ * @brief stop the writer thread and dispose the buffers
+ * @return status code
+ **/
+static int _async_finalize(void)
+{
+	int rc = 0;
+
+	if(_async_ring_size == 0) return 0;
+
+	if(_async_running)
+	{
+		if((errno = pthread_mutex_lock(&_async_mutex)) != 0)
+		{
+			perror("mutex error");
+			return ERROR_CODE(int);
+		}
+
+		_async_stopping = 1;
+
+		if((errno = pthread_cond_signal(&_writer_cond)) != 0)
+			perror("cannot wake up the log writer");
+
+		if((errno = pthread_mutex_unlock(&_async_mutex)) != 0)
+			perror("mutex error");
+
+		if((errno = pthread_join(_writer, NULL)) != 0)
+		{
+			perror("cannot join the log writer thread");
+			rc = ERROR_CODE(int);
+		}
+	}
+
+	_async_running = 0;
+	_async_restart = 0;
+	_async_stopping = 0;
+
+	if((errno = pthread_key_delete(_ring_key)) != 0)
+	{
+		perror("cannot delete the thread local key");
+		rc = ERROR_CODE(int);
+	}
+
+	_ring_t* ring;
+	for(ring = _rings; NULL != ring;)
+	{
+		_ring_t* cur = ring;
+		ring = ring->next;
+		free(cur);
+	}
+	_rings = NULL;
+
+	/* Invalidate the buffer pointers in the thread locals */
+	_async_gen ++;
+
+	pthread_cond_destroy(&_drain_cond);
+	pthread_cond_destroy(&_writer_cond);
+	pthread_mutex_destroy(&_async_mutex);
+
+	if(munmap(_writer_stack, LOG_ASYNC_WRITER_STACK_SIZE) < 0)
+	{
+		perror("cannot release the stack of the log writer thread");
+		rc = ERROR_CODE(int);
+	}
+	_writer_stack = NULL;
+
+	_async_ring_size = 0;
+
+	return rc;
+}
+
 int log_init()
 {
 	FILE* default_fp = stderr;
@@ -55,6 +961,8 @@ int log_init()
 		return ERROR_CODE(int);
 	}
 
+	_async_ring_size = LOG_ASYNC_RING_SIZE;
+
 	if(NULL == conf_path || 0 == strlen(conf_path))
 		conf_path = CONFIG_PATH "/" LOG_DEFAULT_CONFIG_FILE;
 	FILE* fp = fopen(conf_path, "r");
@@ -89,6 +997,21 @@ int log_init()
 			*end = 0;
 			int rc = sscanf(begin, "%s%s%s", type, path, mode);
 			if(rc < 2) continue;
+			if(strcmp(type, "async") == 0)
+			{
+				if(strcmp(path, "off") == 0)
+					_async_ring_size = 0;
+				else
+				{
+					char* size_end;
+					unsigned long long size = strtoull(path, &size_end, 0);
+					if(*size_end != 0)
+						fprintf(stderr, "warning: invalid log buffer size %s\n", path);
+					else
+						_async_ring_size = size;
+				}
+				continue;
+			}
 			if(rc == 2)
 			{
 				mode[0] = 'w';
@@ -172,11 +1095,17 @@ int log_init()
 	}
 	if(NULL != fp && &_fp_off != fp) fclose(fp);
 
+	_async_init();
+
 	return 0;
 }
 int log_finalize()
 {
-	int i, j;
+	int i, j, rc = 0;
+
+	if(ERROR_CODE(int) == _async_finalize())
+		rc = ERROR_CODE(int);
+
 	for(i = 0; i < 8; i ++)
 		if(_log_fp[i] != NULL &&
 		   _log_fp[i] != stdin &&
@@ -190,7 +1119,7 @@ int log_finalize()
 					_log_fp[j] = NULL;
 			fclose(unused);
 		}
-	return 0;
+	return rc;
 }
 void log_write(int level, const char* file, const char* function, int line, const char* fmt, ...)
 {
@@ -247,127 +1176,113 @@ ERR:
 }
 
 /**
- * @brief check if the log file has been deleted
- * @param level the level of the log message
- * @return status code
+ * @brief the actual implementation of the log writing
+ * @param level the log level
+ * @param file the source code file
+ * @param function the function name
+ * @param line the line number
+ * @param fmt the formating string
+ * @param ap the arguments
+ * @return nothing
  **/
-static inline int _check_log_file(int level)
+static inline void _log_write_va_impl(int level, const char* file, const char* function, int line, const char* fmt, va_list ap)
 {
-	if(_log_fp[level] == &_fp_off || _log_fp[level] == NULL)
-		return 0;
+	if(_log_fp[level] == &_fp_off) return;
 
-	int fd = fileno(_log_fp[level]);
+	char buf[1024];
 
-	if(-1 == fd) return ERROR_CODE(int);
+	int prefix_size = _format_prefix(buf, sizeof(buf), level, file, function, line);
 
-	if(fd == STDIN_FILENO || fd == STDOUT_FILENO || fd == STDERR_FILENO)
-		return 0;
+	if(prefix_size < 0 || (size_t)prefix_size >= sizeof(buf))
+	{
+		_write_sync(level, buf, fmt, ap);
+		return;
+	}
 
-	struct stat st;
-	if(fstat(fd, &st) != 0) return ERROR_CODE(int);
+	if(!_async_running && _async_restart && __sync_bool_compare_and_swap(&_async_restart, 1, 0))
+		_async_start();
 
-	int reopen = 0;
-	if(st.st_nlink == 0) reopen = 1;
-	else if(access(_log_path[level], F_OK) != 0) reopen = 1;
+	_ring_t* ring = NULL;
 
-	if(reopen)
+	if(_async_running)
 	{
-		FILE* prev = _log_fp[level];
-		fclose(_log_fp[level]);
-		if(NULL == (_log_fp[level] = fopen(_log_path[level], _log_mode[level])))
-		{
-			_log_fp[level] = &_fp_off;
-			return ERROR_CODE(int);
-		}
-
-		int i;
-		for(i = 0; i < 8; i ++)
-			if(_log_fp[i] == prev) _log_fp[i] = _log_fp[level];
+		ring = _thread_ring;
+		if(NULL == ring || _thread_ring_gen != _async_gen)
+			ring = _ring_acquire();
 	}
 
-	return 0;
-}
-
-/**
- * @brief check if the filename is in the plumber code base
- * @param filename the filename to check
- * @return the result
- * @note this function do not check for the null pointer
- **/
-static inline int _is_framework_code(const char* filename)
-{
-	const char* ptr = _src_root;
-	for(;*ptr && *ptr == *filename; ptr ++, filename ++);
-	return !*ptr;
-}
-
-void log_write_va(int level, const char* file, const char* function, int line, const char* fmt, va_list ap)
-{
-	int locked = 0;
-	if(_log_mutex_active)
+	if(NULL == ring)
 	{
-		if((errno = pthread_mutex_lock(&_log_mutex)) != 0)
-		{
-			perror("mutex error");
-			return;
-		}
-		else locked = 1;
+		_write_sync(level, buf, fmt, ap);
+		return;
 	}
 
-	if(_log_fp[level] == &_fp_off) goto UNLOCK;
+	va_list ap_copy;
+	va_copy(ap_copy, ap);
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wformat-nonliteral"
+#endif
+	int msg_size = vsnprintf(buf + prefix_size, sizeof(buf) - (size_t)prefix_size, fmt, ap_copy);
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+	va_end(ap_copy);
 
-	if(_check_log_file(level) == ERROR_CODE(int))
+	if(msg_size < 0)
 	{
 		perror("logging error");
-		goto UNLOCK;
+		return;
 	}
 
-	static const char level_char[] = "FEWNITD";
-	FILE* fp = _log_fp[level];
+	size_t size = (size_t)prefix_size + (size_t)msg_size + 1;
 
-	if(_is_framework_code(file))
-		file += _src_root_length;
+	/* The message doesn't fit in the buffer, write it directly after the previous messages are written */
+	if(size >= sizeof(buf) || _record_size((uint32_t)size) > ring->size / 2)
+	{
+		buf[prefix_size] = 0;
+		_async_flush();
+		_write_sync(level, buf, fmt, ap);
+		return;
+	}
 
-	struct timespec time;
+	buf[size - 1] = '\n';
 
-	clock_gettime(CLOCK_REALTIME, &time);
+	if(!_ring_push(ring, level, buf, (uint32_t)size))
+	{
+		(void)__sync_fetch_and_add(&_dropped, 1);
+		return;
+	}
 
-	double ts = (double)time.tv_sec + (double)time.tv_nsec / 1e+9;
+	if(level == FATAL)
+		_async_flush();
+	else if(level <= ERROR || ring->head - ring->tail > ring->size / 2)
+		_async_wake();
+}
 
-	if(fp != stderr && _log_stderr[level])
+void log_write_va(int level, const char* file, const char* function, int line, const char* fmt, va_list ap)
+{
+	/* The buffer of this thread is in an inconsistent state when we are interrupted by a signal handler */
+	if(_thread_in_log)
 	{
-		va_list ap_copy;
-		va_copy(ap_copy, ap);
-		flockfile(stderr);
-		fprintf(stderr,"%c[%16.6lf|%s@%s:%d] ", level_char[level], ts, function, file, line);
-#ifdef __clang__
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wformat-nonliteral"
-#endif
-		vfprintf(stderr, fmt, ap_copy);
-#ifdef __clang__
-#pragma clang diagnostic pop
-#endif
-		fprintf(stderr, "\n");
-		fflush(stderr);
-		funlockfile(stderr);
+		(void)__sync_fetch_and_add(&_dropped, 1);
+		return;
 	}
 
-	flockfile(fp);
-	fprintf(fp,"%c[%16.6lf|%s@%s:%d] ", level_char[level], ts, function, file, line);
-#ifdef __clang__
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wformat-nonliteral"
-#endif
-	vfprintf(fp, fmt, ap);
-#ifdef __clang__
-#pragma clang diagnostic pop
-#endif
-	fprintf(fp, "\n");
-	fflush(fp);
-	funlockfile(fp);
+	_thread_in_log = 1;
 
-UNLOCK:
-	if(locked && (errno = pthread_mutex_unlock(&_log_mutex)) != 0)
-		perror("mutex error");
+	_log_write_va_impl(level, file, function, line, fmt, ap);
+
+	_thread_in_log = 0;
+}
+
+int log_flush(void)
+{
+	_async_flush();
+	return 0;
+}
+
+uint64_t log_get_dropped_count(void)
+{
+	return *(volatile uint64_t*)&_dropped;
 }
@@ -0,0 +1,162 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+
+/**
+ * @brief The event queue throughput benchmark, which measures how many events per second
+ *        the scheduler can take with 1 - 64 producer threads
+ **/
+#include <testenv.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#define MAX_PRODUCERS 64
+#define NEVENTS (1 << 18)
+
+typedef struct {
+	itc_equeue_token_t token;
+	uint32_t           count;
+	uint32_t           id;
+	int                rc;
+} producer_t;
+
+static producer_t producers[MAX_PRODUCERS];
+
+static itc_equeue_token_t sched_token;
+
+static void* producer_main(void* data)
+{
+	producer_t* p = (producer_t*)data;
+	uintptr_t i;
+	for(i = 0; i < p->count; i ++)
+	{
+		itc_equeue_event_t e = {
+			.type = ITC_EQUEUE_EVENT_TYPE_IO,
+			.io = {
+				.in  = (itc_module_pipe_t*)(i + 1),
+				.out = (itc_module_pipe_t*)(uintptr_t)(p->id + 1)
+			}
+		};
+		if(ERROR_CODE(int) == itc_equeue_put(p->token, e))
+		{
+			p->rc = ERROR_CODE(int);
+			return NULL;
+		}
+	}
+	return NULL;
+}
+
+static int run_bench(uint32_t n)
+{
+	pthread_t threads[MAX_PRODUCERS];
+	uint32_t next[MAX_PRODUCERS] = {};
+	uint32_t i, taken = 0;
+	struct timespec begin, end;
+
+	for(i = 0; i < n; i ++)
+	{
+		producers[i].count = NEVENTS / n;
+		producers[i].id = i;
+		producers[i].rc = 0;
+		ASSERT_RETOK(itc_equeue_token_t, producers[i].token = itc_equeue_module_token(ITC_MODULE_EVENT_QUEUE_SIZE, ITC_EQUEUE_EVENT_TYPE_IO), CLEANUP_NOP);
+	}
+
+	ASSERT_OK(clock_gettime(CLOCK_MONOTONIC, &begin), CLEANUP_NOP);
+
+	for(i = 0; i < n; i ++)
+		ASSERT_OK(pthread_create(threads + i, NULL, producer_main, producers + i), CLEANUP_NOP);
+
+	itc_equeue_event_mask_t mask = ITC_EQUEUE_EVENT_MASK_NONE;
+	ITC_EQUEUE_EVENT_MASK_ADD(mask, ITC_EQUEUE_EVENT_TYPE_IO);
+
+	while(taken < (NEVENTS / n) * n)
+	{
+		itc_equeue_event_t buf[32];
+		uint32_t j, rc;
+		ASSERT_OK(itc_equeue_wait(sched_token, NULL, NULL), CLEANUP_NOP);
+		ASSERT_RETOK(uint32_t, rc = itc_equeue_take(sched_token, mask, buf, sizeof(buf) / sizeof(buf[0])), CLEANUP_NOP);
+		for(j = 0; j < rc; j ++)
+		{
+			/* The events from the same producer should come in order */
+			uintptr_t id = (uintptr_t)buf[j].io.out - 1;
+			ASSERT(id < n, CLEANUP_NOP);
+			ASSERT((uintptr_t)buf[j].io.in == ++ next[id], CLEANUP_NOP);
+		}
+		taken += rc;
+	}
+
+	ASSERT_OK(clock_gettime(CLOCK_MONOTONIC, &end), CLEANUP_NOP);
+
+	for(i = 0; i < n; i ++)
+	{
+		expected_memory_leakage();
+		ASSERT_OK(pthread_join(threads[i], NULL), CLEANUP_NOP);
+		ASSERT_OK(producers[i].rc, CLEANUP_NOP);
+	}
+
+	ASSERT(itc_equeue_empty(sched_token) == 1, CLEANUP_NOP);
+
+	double sec = (double)(end.tv_sec - begin.tv_sec) + (double)(end.tv_nsec - begin.tv_nsec) / 1e9;
+
+	LOG_NOTICE("Equeue benchmark: %2u producers, %u events in %.3fs, %.0f events/sec", n, taken, sec, (double)taken / sec);
+
+	return 0;
+}
+
+int bench_1(void)
+{
+	return run_bench(1);
+}
+
+int bench_2(void)
+{
+	return run_bench(2);
+}
+
+int bench_4(void)
+{
+	return run_bench(4);
+}
+
+int bench_8(void)
+{
+	return run_bench(8);
+}
+
+int bench_16(void)
+{
+	return run_bench(16);
+}
+
+int bench_32(void)
+{
+	return run_bench(32);
+}
+
+int bench_64(void)
+{
+	return run_bench(64);
+}
+
+int setup(void)
+{
+	ASSERT_RETOK(itc_equeue_token_t, sched_token = itc_equeue_scheduler_token(), CLEANUP_NOP);
+	return 0;
+}
+
+int teardown(void)
+{
+	ASSERT_OK(itc_equeue_release_scheduler_token(sched_token), CLEANUP_NOP);
+	return 0;
+}
+
+TEST_LIST_BEGIN
+    TEST_CASE(bench_1),
+    TEST_CASE(bench_2),
+    TEST_CASE(bench_4),
+    TEST_CASE(bench_8),
+    TEST_CASE(bench_16),
+    TEST_CASE(bench_32),
+    TEST_CASE(bench_64)
+TEST_LIST_END;
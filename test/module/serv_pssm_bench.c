@@ -0,0 +1,103 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+#include <pservlet.h>
+#include <error.h>
+#include <string.h>
+#include <time.h>
+
+#define ASSERT(cond, cleanup) do{\
+	if(!(cond)) \
+	{\
+		LOG_ERROR("Assertion failure `%s'", #cond);\
+		cleanup;\
+		return -1;\
+	}\
+} while(0)
+#define ASSERT_PTR(ptr, cleanup) ASSERT((ptr) != NULL, cleanup)
+#define ASSERT_OK(status, cleanup) ASSERT((status) != ERROR_CODE(int), cleanup)
+#define ASSERT_RETOK(type, ret, cleanup) ASSERT((ret) != ERROR_CODE(type), cleanup)
+#define CLEANUP_NOP
+
+#define N 200000
+
+typedef int (*_alloc_func_t)(uint32_t size, void** result);
+typedef int (*_dealloc_func_t)(void* mem);
+
+typedef struct {
+	pipe_t alloc;
+	pipe_t dealloc;
+	_alloc_func_t alloc_func;
+	_dealloc_func_t dealloc_func;
+} _context_t;
+
+static int _init(uint32_t argc, char const* const* argv, void* data)
+{
+	(void)argc;
+	(void)argv;
+	_context_t* ctx = (_context_t*)data;
+	ASSERT_RETOK(pipe_t, ctx->alloc = module_require_function("plumber.std", "pool_allocate"), CLEANUP_NOP);
+	ASSERT_RETOK(pipe_t, ctx->dealloc = module_require_function("plumber.std", "pool_deallocate"), CLEANUP_NOP);
+	ASSERT_PTR(ctx->alloc_func = (_alloc_func_t)module_bind_function(ctx->alloc), CLEANUP_NOP);
+	ASSERT_PTR(ctx->dealloc_func = (_dealloc_func_t)module_bind_function(ctx->dealloc), CLEANUP_NOP);
+
+	return 0;
+}
+
+static double _now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int _exec(void* data)
+{
+	_context_t* ctx = (_context_t*)data;
+	uint32_t i;
+	void* result;
+	double begin, invoke_ns, direct_ns;
+
+	begin = _now();
+	for(i = 0; i < N; i ++)
+	{
+		ASSERT_OK(pipe_cntl(ctx->alloc, PIPE_CNTL_INVOKE, 32, &result), CLEANUP_NOP);
+		ASSERT_OK(pipe_cntl(ctx->dealloc, PIPE_CNTL_INVOKE, result), CLEANUP_NOP);
+	}
+	invoke_ns = (_now() - begin) / (2.0 * N);
+
+	begin = _now();
+	for(i = 0; i < N; i ++)
+	{
+		ASSERT_OK(ctx->alloc_func(32, &result), CLEANUP_NOP);
+		ASSERT_OK(ctx->dealloc_func(result), CLEANUP_NOP);
+	}
+	direct_ns = (_now() - begin) / (2.0 * N);
+
+	/* The memory should be the same object, regardless how we call the function */
+	void* result1;
+	ASSERT_OK(ctx->alloc_func(32, &result), CLEANUP_NOP);
+	ASSERT_OK(pipe_cntl(ctx->dealloc, PIPE_CNTL_INVOKE, result), CLEANUP_NOP);
+	ASSERT_OK(pipe_cntl(ctx->alloc, PIPE_CNTL_INVOKE, 32, &result1), CLEANUP_NOP);
+	ASSERT(result == result1, CLEANUP_NOP);
+	ASSERT_OK(ctx->dealloc_func(result1), CLEANUP_NOP);
+
+	LOG_NOTICE("PSSM call benchmark: pipe_cntl invoke %.1f ns/call, direct call %.1f ns/call", invoke_ns, direct_ns);
+
+	return 0;
+}
+
+static int _unload(void* data)
+{
+	(void)data;
+	return 0;
+}
+
+SERVLET_DEF = {
+	.size = sizeof(_context_t),
+	.version = 0x0,
+	.desc = "PSSM direct call benchmark",
+	.init = _init,
+	.exec = _exec,
+	.unload = _unload
+};
@@ -0,0 +1,562 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <testenv.h>
+#include <module/http2/hpack.h>
+#include <module/http2/conn.h>
+
+/**
+ * @brief the client connection preface
+ **/
+#define PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+
+static const module_http2_conn_conf_t default_conf = {
+	.max_concurrent_streams = 100,
+	.initial_window_size    = 1048576,
+	.max_frame_size         = 16384,
+	.header_table_size      = 4096,
+	.max_request_size       = 1048576
+};
+
+/**
+ * @brief the bytes the connection has flushed
+ **/
+static uint8_t out[65536];
+
+static size_t out_size;
+
+/**
+ * @brief the bytes we are going to feed to the connection
+ **/
+static uint8_t in[65536];
+
+static size_t in_size;
+
+/**
+ * @brief the decoded header fields as "name: value\n" lines
+ **/
+static char fields[4096];
+
+static size_t fields_size;
+
+static size_t _write(const void* data, size_t size, void* ctx)
+{
+	(void)ctx;
+	if(out_size + size > sizeof(out)) return ERROR_CODE(size_t);
+	memcpy(out + out_size, data, size);
+	out_size += size;
+	return size;
+}
+
+static int _collect(const char* name, size_t name_len, const char* value, size_t value_len, void* data)
+{
+	(void)data;
+	if(fields_size + name_len + value_len + 3 >= sizeof(fields)) return ERROR_CODE(int);
+
+	memcpy(fields + fields_size, name, name_len);
+	fields_size += name_len;
+	fields[fields_size ++] = ':';
+	fields[fields_size ++] = ' ';
+	memcpy(fields + fields_size, value, value_len);
+	fields_size += value_len;
+	fields[fields_size ++] = '\n';
+	fields[fields_size] = 0;
+
+	return 0;
+}
+
+static void _frame(uint8_t type, uint8_t flags, uint32_t stream_id, const void* payload, size_t size)
+{
+	uint8_t* ptr = in + in_size;
+	ptr[0] = (uint8_t)(size >> 16);
+	ptr[1] = (uint8_t)(size >> 8);
+	ptr[2] = (uint8_t)size;
+	ptr[3] = type;
+	ptr[4] = flags;
+	ptr[5] = (uint8_t)(stream_id >> 24);
+	ptr[6] = (uint8_t)(stream_id >> 16);
+	ptr[7] = (uint8_t)(stream_id >> 8);
+	ptr[8] = (uint8_t)stream_id;
+	if(size > 0) memcpy(ptr + 9, payload, size);
+	in_size += 9 + size;
+}
+
+static void _raw(const void* data, size_t size)
+{
+	memcpy(in + in_size, data, size);
+	in_size += size;
+}
+
+static void _u32_frame(uint8_t type, uint32_t stream_id, uint32_t value)
+{
+	uint8_t payload[4] = {(uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value};
+	_frame(type, 0, stream_id, payload, sizeof(payload));
+}
+
+/**
+ * @brief queue a HEADERS frame that carries the given fields, the fields are given as name, value pairs ended with NULL
+ **/
+static int _headers(uint8_t flags, uint32_t stream_id, ...)
+{
+	uint8_t block[4096];
+	size_t size = 0;
+	va_list ap;
+	va_start(ap, stream_id);
+	const char* name;
+	while(NULL != (name = va_arg(ap, const char*)))
+	{
+		const char* value = va_arg(ap, const char*);
+		size_t rc = module_http2_hpack_encode(name, strlen(name), value, strlen(value), block + size, sizeof(block) - size);
+		if(ERROR_CODE(size_t) == rc)
+		{
+			va_end(ap);
+			return ERROR_CODE(int);
+		}
+		size += rc;
+	}
+	va_end(ap);
+
+	_frame(1, flags, stream_id, block, size);
+	return 0;
+}
+
+/**
+ * @brief feed the queued bytes to the connection and flush the output
+ **/
+static int _exchange(module_http2_conn_t* conn)
+{
+	ASSERT_OK(module_http2_conn_feed(conn, in, in_size), CLEANUP_NOP);
+	in_size = 0;
+	out_size = 0;
+	ASSERT(0 == module_http2_conn_flush(conn, _write, NULL), CLEANUP_NOP);
+	return 0;
+}
+
+/**
+ * @brief find the index-th frame of the given type in the output
+ * @return the payload size or error code
+ **/
+static size_t _find_frame(uint8_t type, uint32_t index, uint8_t* flags, uint32_t* stream_id, const uint8_t** payload)
+{
+	size_t offset = 0;
+	while(offset + 9 <= out_size)
+	{
+		size_t size = ((size_t)out[offset] << 16) | ((size_t)out[offset + 1] << 8) | out[offset + 2];
+		if(out[offset + 3] == type && index -- == 0)
+		{
+			if(NULL != flags) *flags = out[offset + 4];
+			if(NULL != stream_id) *stream_id = ((uint32_t)out[offset + 5] << 24) | ((uint32_t)out[offset + 6] << 16) |
+			                                   ((uint32_t)out[offset + 7] << 8) | out[offset + 8];
+			if(NULL != payload) *payload = out + offset + 9;
+			return size;
+		}
+		offset += 9 + size;
+	}
+
+	return ERROR_CODE(size_t);
+}
+
+/**
+ * @brief the error code carried by the index-th frame of the given type, which should be either RST_STREAM or GOAWAY
+ **/
+static uint32_t _error_code(uint8_t type, uint32_t index, uint32_t* stream_id)
+{
+	const uint8_t* payload;
+	size_t size = _find_frame(type, index, NULL, stream_id, &payload);
+	if(ERROR_CODE(size_t) == size) return ERROR_CODE(uint32_t);
+	if(type == 7) payload += 4;
+	return ((uint32_t)payload[0] << 24) | ((uint32_t)payload[1] << 16) | ((uint32_t)payload[2] << 8) | payload[3];
+}
+
+static module_http2_conn_t* _connect(const module_http2_conn_conf_t* conf, const uint8_t* settings, size_t settings_size)
+{
+	module_http2_conn_t* conn = module_http2_conn_new(conf);
+	if(NULL == conn) return NULL;
+
+	in_size = out_size = 0;
+	if(0 != module_http2_conn_flush(conn, _write, NULL)) goto ERR;
+
+	/* Our SETTINGS must be the first frame we send */
+	if(out_size < 9 || out[3] != 4 || out[4] != 0) goto ERR;
+
+	_raw(PREFACE, sizeof(PREFACE) - 1);
+	_frame(4, 0, 0, settings, settings_size);
+
+	if(ERROR_CODE(int) == _exchange(conn)) goto ERR;
+
+	uint8_t flags;
+	if(0 != _find_frame(4, 0, &flags, NULL, NULL) || flags != 1) goto ERR;
+
+	return conn;
+ERR:
+	module_http2_conn_free(conn);
+	return NULL;
+}
+
+static int _read_request(module_http2_stream_t* stream, const char* expected)
+{
+	char buf[4096];
+	size_t size = module_http2_stream_read(stream, buf, sizeof(buf) - 1);
+	ASSERT_RETOK(size_t, size, CLEANUP_NOP);
+	buf[size] = 0;
+	ASSERT_STREQ(buf, expected, CLEANUP_NOP);
+	ASSERT(1 == module_http2_stream_eof(stream), CLEANUP_NOP);
+	return 0;
+}
+
+static int _check_head(uint32_t stream_id, uint8_t expected_flags, const char* expected)
+{
+	uint8_t flags;
+	uint32_t id;
+	const uint8_t* payload;
+	size_t size = _find_frame(1, 0, &flags, &id, &payload);
+	ASSERT_RETOK(size_t, size, CLEANUP_NOP);
+	ASSERT(id == stream_id, CLEANUP_NOP);
+	ASSERT(flags == expected_flags, CLEANUP_NOP);
+
+	module_http2_hpack_decoder_t* decoder = module_http2_hpack_decoder_new(4096);
+	ASSERT_PTR(decoder, CLEANUP_NOP);
+	fields_size = 0;
+	fields[0] = 0;
+	int rc = module_http2_hpack_decode(decoder, payload, size, _collect, NULL);
+	ASSERT_OK(module_http2_hpack_decoder_free(decoder), CLEANUP_NOP);
+	ASSERT_OK(rc, CLEANUP_NOP);
+	ASSERT_STREQ(fields, expected, CLEANUP_NOP);
+
+	return 0;
+}
+
+/**
+ * @brief concatenate the payload of all the DATA frames of the stream
+ * @return the flags of the last DATA frame or error code
+ **/
+static int _collect_data(uint32_t stream_id, char* buf, size_t* size)
+{
+	uint32_t i, id;
+	uint8_t flags = 0;
+	int found = 0;
+	const uint8_t* payload;
+	size_t rc;
+
+	*size = 0;
+	for(i = 0; ERROR_CODE(size_t) != (rc = _find_frame(0, i, &flags, &id, &payload)); i ++)
+	{
+		if(id != stream_id) continue;
+		memcpy(buf + *size, payload, rc);
+		*size += rc;
+		found = 1;
+	}
+	buf[*size] = 0;
+
+	return found ? flags : ERROR_CODE(int);
+}
+
+int get_request(void)
+{
+	int rc = ERROR_CODE(int);
+	char body[1024];
+	size_t size;
+	module_http2_stream_t* stream;
+	module_http2_conn_t* conn = _connect(&default_conf, NULL, 0);
+	ASSERT_PTR(conn, CLEANUP_NOP);
+
+	ASSERT_OK(_headers(0x5, 1, ":method", "GET", ":scheme", "http", ":path", "/index.html", ":authority", "www.example.com",
+	                   "accept", "*/*", "connection", "keep-alive", NULL), goto ERR);
+	ASSERT_OK(_exchange(conn), goto ERR);
+
+	ASSERT(1 == module_http2_conn_has_request(conn), goto ERR);
+	ASSERT_PTR(stream = module_http2_conn_next_request(conn), goto ERR);
+	ASSERT(0 == module_http2_conn_has_request(conn), goto ERR);
+	ASSERT(NULL == module_http2_conn_next_request(conn), goto ERR);
+	ASSERT(1 == module_http2_stream_id(stream), goto ERR);
+	ASSERT_OK(_read_request(stream, "GET /index.html HTTP/1.1\r\nHost: www.example.com\r\naccept: */*\r\n\r\n"), goto ERR);
+
+	/* The response head may be split at any position */
+	static const char response[] = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nConnection: keep-alive\r\nContent-Length: 5\r\n\r\nhello";
+	ASSERT(20 == module_http2_stream_write(conn, stream, response, 20), goto ERR);
+	ASSERT(sizeof(response) - 21 == module_http2_stream_write(conn, stream, response + 20, sizeof(response) - 21), goto ERR);
+	ASSERT_OK(module_http2_stream_done(conn, stream, 0), goto ERR);
+
+	out_size = 0;
+	ASSERT(0 == module_http2_conn_flush(conn, _write, NULL), goto ERR);
+	ASSERT_OK(_check_head(1, 0x4, ":status: 200\ncontent-type: text/plain\ncontent-length: 5\n"), goto ERR);
+	ASSERT(0x1 == _collect_data(1, body, &size), goto ERR);
+	ASSERT_STREQ(body, "hello", goto ERR);
+
+	rc = 0;
+ERR:
+	ASSERT_OK(module_http2_conn_free(conn), rc = ERROR_CODE(int));
+	return rc;
+}
+
+int post_request(void)
+{
+	int rc = ERROR_CODE(int);
+	char buf[1024];
+	size_t size;
+	module_http2_stream_t* stream;
+	module_http2_conn_t* conn = _connect(&default_conf, NULL, 0);
+	ASSERT_PTR(conn, CLEANUP_NOP);
+
+	ASSERT_OK(_headers(0x4, 1, ":method", "POST", ":scheme", "https", ":path", "/submit", ":authority", "localhost",
+	                   "content-length", "11", "cookie", "a=1", "cookie", "b=2", NULL), goto ERR);
+	_frame(0, 0, 1, "hello ", 6);
+	_frame(0, 1, 1, "world", 5);
+	ASSERT_OK(_exchange(conn), goto ERR);
+
+	ASSERT_PTR(stream = module_http2_conn_next_request(conn), goto ERR);
+
+	/* Put back the bytes we don't want */
+	ASSERT(4 == module_http2_stream_read(stream, buf, 4), goto ERR);
+	ASSERT_OK(module_http2_stream_eom(stream, 2), goto ERR);
+	ASSERT_OK(_read_request(stream, "ST /submit HTTP/1.1\r\nHost: localhost\r\nCookie: a=1; b=2\r\nContent-Length: 11\r\n\r\nhello world"), goto ERR);
+
+	static const char response[] = "HTTP/1.1 201 Created\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n6;ext=1\r\n world\r\n0\r\n\r\n";
+	ASSERT(sizeof(response) - 1 == module_http2_stream_write(conn, stream, response, sizeof(response) - 1), goto ERR);
+	ASSERT_OK(module_http2_stream_done(conn, stream, 0), goto ERR);
+
+	out_size = 0;
+	ASSERT(0 == module_http2_conn_flush(conn, _write, NULL), goto ERR);
+	ASSERT_OK(_check_head(1, 0x4, ":status: 201\n"), goto ERR);
+	ASSERT(0x1 == _collect_data(1, buf, &size), goto ERR);
+	ASSERT_STREQ(buf, "hello world", goto ERR);
+
+	rc = 0;
+ERR:
+	ASSERT_OK(module_http2_conn_free(conn), rc = ERROR_CODE(int));
+	return rc;
+}
+
+int flow_control(void)
+{
+	int rc = ERROR_CODE(int);
+	char buf[1024];
+	size_t size;
+	module_http2_stream_t* stream;
+	/* SETTINGS_INITIAL_WINDOW_SIZE = 10 */
+	static const uint8_t settings[] = {0, 4, 0, 0, 0, 10};
+	module_http2_conn_t* conn = _connect(&default_conf, settings, sizeof(settings));
+	ASSERT_PTR(conn, CLEANUP_NOP);
+
+	ASSERT_OK(_headers(0x5, 1, ":method", "GET", ":scheme", "http", ":path", "/", NULL), goto ERR);
+	ASSERT_OK(_exchange(conn), goto ERR);
+
+	ASSERT_PTR(stream = module_http2_conn_next_request(conn), goto ERR);
+	ASSERT_OK(_read_request(stream, "GET / HTTP/1.1\r\n\r\n"), goto ERR);
+
+	static const char response[] = "HTTP/1.1 200 OK\r\nContent-Length: 26\r\n\r\nabcdefghijklmnopqrstuvwxyz";
+	ASSERT(sizeof(response) - 1 == module_http2_stream_write(conn, stream, response, sizeof(response) - 1), goto ERR);
+	ASSERT_OK(module_http2_stream_done(conn, stream, 0), goto ERR);
+
+	out_size = 0;
+	ASSERT(0 == module_http2_conn_flush(conn, _write, NULL), goto ERR);
+	ASSERT_OK(_check_head(1, 0x4, ":status: 200\ncontent-length: 26\n"), goto ERR);
+	ASSERT(0 == _collect_data(1, buf, &size), goto ERR);
+	ASSERT_STREQ(buf, "abcdefghij", goto ERR);
+
+	/* Open the stream window, but the connection window is still large enough */
+	_u32_frame(8, 1, 100);
+	ASSERT_OK(_exchange(conn), goto ERR);
+	ASSERT(0x1 == _collect_data(1, buf, &size), goto ERR);
+	ASSERT_STREQ(buf, "klmnopqrstuvwxyz", goto ERR);
+
+	rc = 0;
+ERR:
+	ASSERT_OK(module_http2_conn_free(conn), rc = ERROR_CODE(int));
+	return rc;
+}
+
+int connection_error(void)
+{
+	/* Not a HTTP/2 connection at all */
+	module_http2_conn_t* conn = module_http2_conn_new(&default_conf);
+	ASSERT_PTR(conn, CLEANUP_NOP);
+	in_size = 0;
+	_raw("GET / HTTP/1.1\r\n\r\n", 18);
+	ASSERT_OK(_exchange(conn), goto ERR);
+	ASSERT(1 == module_http2_conn_closing(conn), goto ERR);
+	ASSERT(1 == _error_code(7, 0, NULL), goto ERR);
+	ASSERT_OK(module_http2_conn_free(conn), CLEANUP_NOP);
+
+	/* The first frame must be SETTINGS */
+	conn = module_http2_conn_new(&default_conf);
+	ASSERT_PTR(conn, CLEANUP_NOP);
+	in_size = 0;
+	_raw(PREFACE, sizeof(PREFACE) - 1);
+	ASSERT_OK(_headers(0x5, 1, ":method", "GET", ":scheme", "http", ":path", "/", NULL), goto ERR);
+	ASSERT_OK(_exchange(conn), goto ERR);
+	ASSERT(1 == module_http2_conn_closing(conn), goto ERR);
+	ASSERT(1 == _error_code(7, 0, NULL), goto ERR);
+	ASSERT(NULL == module_http2_conn_next_request(conn), goto ERR);
+	ASSERT_OK(module_http2_conn_free(conn), CLEANUP_NOP);
+
+	/* The header block can not be decoded */
+	ASSERT_PTR(conn = _connect(&default_conf, NULL, 0), CLEANUP_NOP);
+	ASSERT(0 == module_http2_conn_closing(conn), goto ERR);
+	_frame(1, 0x5, 1, "\x80", 1);
+	ASSERT_OK(_exchange(conn), goto ERR);
+	ASSERT(1 == module_http2_conn_closing(conn), goto ERR);
+	ASSERT(9 == _error_code(7, 0, NULL), goto ERR);
+	ASSERT_OK(module_http2_conn_free(conn), CLEANUP_NOP);
+
+	return 0;
+ERR:
+	module_http2_conn_free(conn);
+	return ERROR_CODE(int);
+}
+
+int stream_reset(void)
+{
+	int rc = ERROR_CODE(int);
+	uint32_t id;
+	module_http2_stream_t* stream;
+	module_http2_conn_t* conn = _connect(&default_conf, NULL, 0);
+	ASSERT_PTR(conn, CLEANUP_NOP);
+
+	ASSERT_OK(_headers(0x5, 1, ":method", "GET", ":scheme", "http", ":path", "/", NULL), goto ERR);
+	ASSERT_OK(_exchange(conn), goto ERR);
+	ASSERT_PTR(stream = module_http2_conn_next_request(conn), goto ERR);
+
+	/* The client cancels the stream which is being served, and the stream which hasn't been popped yet */
+	_u32_frame(3, 1, 8);
+	ASSERT_OK(_headers(0x5, 3, ":method", "GET", ":scheme", "http", ":path", "/", NULL), goto ERR);
+	_u32_frame(3, 3, 8);
+	ASSERT_OK(_exchange(conn), goto ERR);
+	ASSERT(NULL == module_http2_conn_next_request(conn), goto ERR);
+
+	static const char response[] = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello";
+	ASSERT(sizeof(response) - 1 == module_http2_stream_write(conn, stream, response, sizeof(response) - 1), goto ERR);
+	ASSERT_OK(module_http2_stream_done(conn, stream, 0), goto ERR);
+
+	out_size = 0;
+	ASSERT(0 == module_http2_conn_flush(conn, _write, NULL), goto ERR);
+	ASSERT(0 == out_size, goto ERR);
+
+	/* A stream served with error is reset by us */
+	ASSERT_OK(_headers(0x5, 5, ":method", "GET", ":scheme", "http", ":path", "/", NULL), goto ERR);
+	ASSERT_OK(_exchange(conn), goto ERR);
+	ASSERT_PTR(stream = module_http2_conn_next_request(conn), goto ERR);
+	ASSERT(17 == module_http2_stream_write(conn, stream, response, 17), goto ERR);
+	ASSERT_OK(module_http2_stream_done(conn, stream, 0), goto ERR);
+	out_size = 0;
+	ASSERT(0 == module_http2_conn_flush(conn, _write, NULL), goto ERR);
+	ASSERT(2 == _error_code(3, 0, &id), goto ERR);
+	ASSERT(5 == id, goto ERR);
+
+	rc = 0;
+ERR:
+	ASSERT_OK(module_http2_conn_free(conn), rc = ERROR_CODE(int));
+	return rc;
+}
+
+int refused_stream(void)
+{
+	int rc = ERROR_CODE(int);
+	uint32_t id;
+	module_http2_stream_t* stream;
+	module_http2_conn_conf_t conf = default_conf;
+	conf.max_concurrent_streams = 1;
+	module_http2_conn_t* conn = _connect(&conf, NULL, 0);
+	ASSERT_PTR(conn, CLEANUP_NOP);
+
+	ASSERT_OK(_headers(0x5, 1, ":method", "GET", ":scheme", "http", ":path", "/a", NULL), goto ERR);
+	ASSERT_OK(_headers(0x5, 3, ":method", "GET", ":scheme", "http", ":path", "/b", NULL), goto ERR);
+	ASSERT_OK(_exchange(conn), goto ERR);
+	ASSERT(7 == _error_code(3, 0, &id), goto ERR);
+	ASSERT(3 == id, goto ERR);
+
+	ASSERT_PTR(stream = module_http2_conn_next_request(conn), goto ERR);
+	ASSERT(NULL == module_http2_conn_next_request(conn), goto ERR);
+	ASSERT_OK(_read_request(stream, "GET /a HTTP/1.1\r\n\r\n"), goto ERR);
+	ASSERT_OK(module_http2_stream_done(conn, stream, 1), goto ERR);
+
+	/* The slot is released, so the next stream should be accepted */
+	ASSERT_OK(_headers(0x5, 5, ":method", "GET", ":scheme", "http", ":path", "/c", NULL), goto ERR);
+	ASSERT_OK(_exchange(conn), goto ERR);
+	ASSERT_PTR(stream = module_http2_conn_next_request(conn), goto ERR);
+	ASSERT(5 == module_http2_stream_id(stream), goto ERR);
+	ASSERT_OK(_read_request(stream, "GET /c HTTP/1.1\r\n\r\n"), goto ERR);
+	ASSERT_OK(module_http2_stream_done(conn, stream, 1), goto ERR);
+
+	rc = 0;
+ERR:
+	ASSERT_OK(module_http2_conn_free(conn), rc = ERROR_CODE(int));
+	return rc;
+}
+
+int pending_limit(void)
+{
+	int rc = ERROR_CODE(int);
+	char buf[1024];
+	size_t size;
+	uint32_t i;
+	module_http2_stream_t* streams[5] = {NULL};
+	/* SETTINGS_INITIAL_WINDOW_SIZE = 0, so nothing can be sent until the client opens the window */
+	static const uint8_t settings[] = {0, 4, 0, 0, 0, 0};
+	static char body[1048576];
+	module_http2_conn_t* conn = _connect(&default_conf, settings, sizeof(settings));
+	ASSERT_PTR(conn, CLEANUP_NOP);
+	memset(body, 'x', sizeof(body));
+
+	for(i = 0; i < sizeof(streams) / sizeof(streams[0]); i ++)
+	{
+		snprintf(buf, sizeof(buf), "/%u", i);
+		ASSERT_OK(_headers(0x5, 2 * i + 1, ":method", "GET", ":scheme", "http", ":path", buf, NULL), goto ERR);
+	}
+	ASSERT_OK(_exchange(conn), goto ERR);
+
+	static const char head[] = "HTTP/1.1 200 OK\r\nContent-Length: 1048576\r\n\r\n";
+	for(i = 0; i < sizeof(streams) / sizeof(streams[0]); i ++)
+	{
+		ASSERT_PTR(streams[i] = module_http2_conn_next_request(conn), goto ERR);
+		ASSERT(sizeof(head) - 1 == module_http2_stream_write(conn, streams[i], head, sizeof(head) - 1), goto ERR);
+	}
+
+	/* Each stream buffers at most two frames when the window is zero */
+	for(i = 0; i < 4; i ++)
+	{
+		ASSERT(32768 == module_http2_stream_write(conn, streams[i], body, sizeof(body)), goto ERR);
+		ASSERT(0 == module_http2_stream_write(conn, streams[i], body, sizeof(body)), goto ERR);
+	}
+
+	/* And the connection limit is reached, thus the last stream is blocked as well */
+	ASSERT(0 == module_http2_stream_write(conn, streams[4], body, sizeof(body)), goto ERR);
+
+	/* Once the client opens the window, the stream is able to take more bytes */
+	_u32_frame(8, 1, 10);
+	ASSERT_OK(_exchange(conn), goto ERR);
+	ASSERT(0 == _collect_data(1, buf, &size), goto ERR);
+	ASSERT(10 == size, goto ERR);
+	ASSERT(10 == module_http2_stream_write(conn, streams[0], body, sizeof(body)), goto ERR);
+
+	/* The reset stream doesn't hold the buffer anymore */
+	_u32_frame(3, 3, 8);
+	ASSERT_OK(_exchange(conn), goto ERR);
+	ASSERT(32768 == module_http2_stream_write(conn, streams[4], body, sizeof(body)), goto ERR);
+
+	for(i = 0; i < sizeof(streams) / sizeof(streams[0]); i ++)
+		ASSERT_OK(module_http2_stream_done(conn, streams[i], 1), goto ERR);
+
+	rc = 0;
+ERR:
+	ASSERT_OK(module_http2_conn_free(conn), rc = ERROR_CODE(int));
+	return rc;
+}
+
+DEFAULT_SETUP;
+DEFAULT_TEARDOWN;
+
+TEST_LIST_BEGIN
+    TEST_CASE(get_request),
+    TEST_CASE(post_request),
+    TEST_CASE(flow_control),
+    TEST_CASE(connection_error),
+    TEST_CASE(stream_reset),
+    TEST_CASE(refused_stream),
+    TEST_CASE(pending_limit)
+TEST_LIST_END;
@@ -0,0 +1,214 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <testenv.h>
+#include <module/http2/hpack.h>
+
+/**
+ * @brief the buffer that collects the decoded header fields as "name: value\n" lines
+ **/
+static char fields[4096];
+
+static size_t fields_size;
+
+static int _collect(const char* name, size_t name_len, const char* value, size_t value_len, void* data)
+{
+	(void)data;
+	if(fields_size + name_len + value_len + 3 >= sizeof(fields)) return ERROR_CODE(int);
+
+	memcpy(fields + fields_size, name, name_len);
+	fields_size += name_len;
+	fields[fields_size ++] = ':';
+	fields[fields_size ++] = ' ';
+	memcpy(fields + fields_size, value, value_len);
+	fields_size += value_len;
+	fields[fields_size ++] = '\n';
+	fields[fields_size] = 0;
+
+	return 0;
+}
+
+static size_t _unhex(const char* hex, uint8_t* buf)
+{
+	size_t ret = 0;
+	for(; hex[0] && hex[1]; hex += 2)
+	{
+		unsigned int byte;
+		sscanf(hex, "%2x", &byte);
+		buf[ret ++] = (uint8_t)byte;
+	}
+	return ret;
+}
+
+static int _decode(module_http2_hpack_decoder_t* decoder, const char* hex, const char* expected)
+{
+	uint8_t block[1024];
+	size_t size = _unhex(hex, block);
+
+	fields_size = 0;
+	fields[0] = 0;
+
+	ASSERT_OK(module_http2_hpack_decode(decoder, block, size, _collect, NULL), CLEANUP_NOP);
+	ASSERT_STREQ(fields, expected, CLEANUP_NOP);
+
+	return 0;
+}
+
+/**
+ * @brief RFC 7541, Appendix C.3, requests without the Huffman coding
+ **/
+int rfc7541_c3(void)
+{
+	int rc = ERROR_CODE(int);
+	module_http2_hpack_decoder_t* decoder = module_http2_hpack_decoder_new(4096);
+	ASSERT_PTR(decoder, CLEANUP_NOP);
+
+	ASSERT_OK(_decode(decoder, "828684410f7777772e6578616d706c652e636f6d",
+	                  ":method: GET\n:scheme: http\n:path: /\n:authority: www.example.com\n"), goto ERR);
+	ASSERT_OK(_decode(decoder, "828684be58086e6f2d6361636865",
+	                  ":method: GET\n:scheme: http\n:path: /\n:authority: www.example.com\ncache-control: no-cache\n"), goto ERR);
+	ASSERT_OK(_decode(decoder, "828785bf400a637573746f6d2d6b65790c637573746f6d2d76616c7565",
+	                  ":method: GET\n:scheme: https\n:path: /index.html\n:authority: www.example.com\ncustom-key: custom-value\n"), goto ERR);
+
+	rc = 0;
+ERR:
+	ASSERT_OK(module_http2_hpack_decoder_free(decoder), rc = ERROR_CODE(int));
+	return rc;
+}
+
+/**
+ * @brief RFC 7541, Appendix C.4, requests with the Huffman coding
+ **/
+int rfc7541_c4(void)
+{
+	int rc = ERROR_CODE(int);
+	module_http2_hpack_decoder_t* decoder = module_http2_hpack_decoder_new(4096);
+	ASSERT_PTR(decoder, CLEANUP_NOP);
+
+	ASSERT_OK(_decode(decoder, "828684418cf1e3c2e5f23a6ba0ab90f4ff",
+	                  ":method: GET\n:scheme: http\n:path: /\n:authority: www.example.com\n"), goto ERR);
+	ASSERT_OK(_decode(decoder, "828684be5886a8eb10649cbf",
+	                  ":method: GET\n:scheme: http\n:path: /\n:authority: www.example.com\ncache-control: no-cache\n"), goto ERR);
+	ASSERT_OK(_decode(decoder, "828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf",
+	                  ":method: GET\n:scheme: https\n:path: /index.html\n:authority: www.example.com\ncustom-key: custom-value\n"), goto ERR);
+
+	rc = 0;
+ERR:
+	ASSERT_OK(module_http2_hpack_decoder_free(decoder), rc = ERROR_CODE(int));
+	return rc;
+}
+
+/**
+ * @brief RFC 7541, Appendix C.5, responses with a 256 bytes dynamic table, which exercises the eviction
+ **/
+int rfc7541_c5(void)
+{
+	int rc = ERROR_CODE(int);
+	module_http2_hpack_decoder_t* decoder = module_http2_hpack_decoder_new(256);
+	ASSERT_PTR(decoder, CLEANUP_NOP);
+
+	ASSERT_OK(_decode(decoder, "4803333032580770726976617465611d4d6f6e2c203231204f637420323031332032303a31333a323120474d54"
+	                           "6e1768747470733a2f2f7777772e6578616d706c652e636f6d",
+	                  ":status: 302\ncache-control: private\ndate: Mon, 21 Oct 2013 20:13:21 GMT\nlocation: https://www.example.com\n"), goto ERR);
+	ASSERT_OK(_decode(decoder, "4803333037c1c0bf",
+	                  ":status: 307\ncache-control: private\ndate: Mon, 21 Oct 2013 20:13:21 GMT\nlocation: https://www.example.com\n"), goto ERR);
+	ASSERT_OK(_decode(decoder, "88c1611d4d6f6e2c203231204f637420323031332032303a31333a323220474d54c05a04677a6970"
+	                           "7738666f6f3d4153444a4b48514b425a584f5157454f50495541585157454f49553b206d61782d6167653d"
+	                           "333630303b2076657273696f6e3d31",
+	                  ":status: 200\ncache-control: private\ndate: Mon, 21 Oct 2013 20:13:22 GMT\nlocation: https://www.example.com\n"
+	                  "content-encoding: gzip\nset-cookie: foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1\n"), goto ERR);
+
+	rc = 0;
+ERR:
+	ASSERT_OK(module_http2_hpack_decoder_free(decoder), rc = ERROR_CODE(int));
+	return rc;
+}
+
+/**
+ * @brief the malformed header blocks should be rejected
+ **/
+int malformed(void)
+{
+	static const char* blocks[] = {
+		"80",                  /* index 0 is not a valid index */
+		"be",                  /* the dynamic table is empty */
+		"3fe21f",              /* the table size update exceeds the SETTINGS_HEADER_TABLE_SIZE */
+		"8220",                /* the table size update after a field */
+		"410f7777",            /* the string is truncated */
+		"ff",                  /* the integer is truncated */
+		"4184ffffffff",        /* the Huffman code contains EOS */
+		"41820000",            /* the Huffman padding isn't all ones */
+		"ffffffffffffffffff7f" /* the integer overflows */
+	};
+
+	uint32_t i;
+	for(i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i ++)
+	{
+		uint8_t block[64];
+		size_t size = _unhex(blocks[i], block);
+		module_http2_hpack_decoder_t* decoder = module_http2_hpack_decoder_new(4096);
+		ASSERT_PTR(decoder, CLEANUP_NOP);
+		fields_size = 0;
+		int rc = module_http2_hpack_decode(decoder, block, size, _collect, NULL);
+		ASSERT_OK(module_http2_hpack_decoder_free(decoder), CLEANUP_NOP);
+		ASSERT(ERROR_CODE(int) == rc, CLEANUP_NOP);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief the encoded fields should be decoded to the same fields
+ **/
+int encode(void)
+{
+	uint8_t block[1024];
+	size_t size = 0, rc;
+	int ret = ERROR_CODE(int);
+
+#define _ENCODE(name, value) do {\
+	rc = module_http2_hpack_encode(name, strlen(name), value, strlen(value), block + size, sizeof(block) - size);\
+	ASSERT_RETOK(size_t, rc, CLEANUP_NOP);\
+	ASSERT(rc <= MODULE_HTTP2_HPACK_ENCODE_SIZE(strlen(name), strlen(value)), CLEANUP_NOP);\
+	size += rc;\
+} while(0)
+	_ENCODE(":status", "200");
+	ASSERT(size == 1 && block[0] == 0x88, CLEANUP_NOP);
+	_ENCODE(":status", "404");
+	_ENCODE("content-type", "text/html");
+	_ENCODE("x-custom", "a very long value that needs more than one byte to encode the length of the string, which "
+	                    "should be long enough to exceed the 7 bits prefix of the string length");
+	_ENCODE("x-empty", "");
+#undef _ENCODE
+
+	ASSERT(ERROR_CODE(size_t) == module_http2_hpack_encode("name", 4, "value", 5, block, 4), CLEANUP_NOP);
+
+	module_http2_hpack_decoder_t* decoder = module_http2_hpack_decoder_new(4096);
+	ASSERT_PTR(decoder, CLEANUP_NOP);
+
+	fields_size = 0;
+	ASSERT_OK(module_http2_hpack_decode(decoder, block, size, _collect, NULL), goto ERR);
+	ASSERT_STREQ(fields, ":status: 200\n:status: 404\ncontent-type: text/html\n"
+	                     "x-custom: a very long value that needs more than one byte to encode the length of the string, which "
+	                     "should be long enough to exceed the 7 bits prefix of the string length\nx-empty: \n", goto ERR);
+
+	ret = 0;
+ERR:
+	ASSERT_OK(module_http2_hpack_decoder_free(decoder), ret = ERROR_CODE(int));
+	return ret;
+}
+
+DEFAULT_SETUP;
+DEFAULT_TEARDOWN;
+
+TEST_LIST_BEGIN
+    TEST_CASE(rfc7541_c3),
+    TEST_CASE(rfc7541_c4),
+    TEST_CASE(rfc7541_c5),
+    TEST_CASE(malformed),
+    TEST_CASE(encode)
+TEST_LIST_END;
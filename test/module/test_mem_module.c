@@ -0,0 +1,105 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+
+#include <string.h>
+#include <testenv.h>
+#include <lang/prop.h>
+
+static itc_module_type_t mod_mem;
+
+static itc_module_pipe_param_t param = {
+	.input_flags = RUNTIME_API_PIPE_INPUT,
+	.output_flags = RUNTIME_API_PIPE_OUTPUT,
+	.args = NULL
+};
+
+static int64_t _get_counter(const char* name)
+{
+	lang_prop_value_t value = lang_prop_get(name);
+	if(value.type != LANG_PROP_TYPE_INTEGER) return ERROR_CODE(int64_t);
+	return value.num;
+}
+
+static int _write_read(size_t size)
+{
+	static char wbuf[16384], rbuf[16384];
+	itc_module_pipe_t *in = NULL, *out = NULL;
+	size_t i;
+
+	for(i = 0; i < size; i ++)
+		wbuf[i] = (char)(i * 7 + 3);
+
+	ASSERT_OK(itc_module_pipe_allocate(mod_mem, 0, param, &out, &in), CLEANUP_NOP);
+
+	/* Write the data in small pieces, so that the page boundaries are crossed in the middle of a write */
+	for(i = 0; i < size;)
+	{
+		size_t n = size - i > 100 ? 100 : size - i;
+		ASSERT(n == itc_module_pipe_write(wbuf + i, n, out), goto ERR);
+		i += n;
+	}
+
+	ASSERT_OK(itc_module_pipe_deallocate(out), goto ERR);
+	out = NULL;
+
+	ASSERT(size == itc_module_pipe_read(rbuf, sizeof(rbuf), in), goto ERR);
+	ASSERT(0 == memcmp(wbuf, rbuf, size), goto ERR);
+
+	ASSERT_OK(itc_module_pipe_deallocate(in), CLEANUP_NOP);
+
+	return 0;
+ERR:
+	if(NULL != out) itc_module_pipe_deallocate(out);
+	if(NULL != in) itc_module_pipe_deallocate(in);
+	return ERROR_CODE(int);
+}
+
+int inline_pipe(void)
+{
+	int64_t pipes = _get_counter("pipe.mem.num_pipes");
+	int64_t inlined = _get_counter("pipe.mem.num_inline_pipes");
+	int64_t inline_size = _get_counter("pipe.mem.inline_size");
+
+	ASSERT(ERROR_CODE(int64_t) != pipes, CLEANUP_NOP);
+	ASSERT(ERROR_CODE(int64_t) != inlined, CLEANUP_NOP);
+	ASSERT(inline_size > 0, CLEANUP_NOP);
+
+	ASSERT_OK(_write_read(1), CLEANUP_NOP);
+	ASSERT_OK(_write_read((size_t)inline_size - 1), CLEANUP_NOP);
+
+	ASSERT(_get_counter("pipe.mem.num_pipes") == pipes + 2, CLEANUP_NOP);
+	ASSERT(_get_counter("pipe.mem.num_inline_pipes") == inlined + 2, CLEANUP_NOP);
+
+	return 0;
+}
+
+int spilled_pipe(void)
+{
+	int64_t spilled = _get_counter("pipe.mem.num_spilled_pipes");
+	int64_t inline_size = _get_counter("pipe.mem.inline_size");
+
+	ASSERT(ERROR_CODE(int64_t) != spilled, CLEANUP_NOP);
+
+	ASSERT_OK(_write_read((size_t)inline_size), CLEANUP_NOP);
+	ASSERT_OK(_write_read((size_t)inline_size + 1), CLEANUP_NOP);
+	ASSERT_OK(_write_read(16384), CLEANUP_NOP);
+
+	ASSERT(_get_counter("pipe.mem.num_spilled_pipes") == spilled + 3, CLEANUP_NOP);
+
+	return 0;
+}
+
+int setup(void)
+{
+	mod_mem = itc_modtab_get_module_type_from_path("pipe.mem");
+	ASSERT(ERROR_CODE(itc_module_type_t) != mod_mem, CLEANUP_NOP);
+	return 0;
+}
+
+DEFAULT_TEARDOWN;
+
+TEST_LIST_BEGIN
+    TEST_CASE(inline_pipe),
+    TEST_CASE(spilled_pipe)
+TEST_LIST_END;
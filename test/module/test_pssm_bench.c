@@ -0,0 +1,45 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+
+/**
+ * @brief The benchmark for the per-call overhead of the PSSM functions, which compares
+ *        the pipe_cntl invoke path with the direct call through the bound function address
+ **/
+#include <constants.h>
+#include <testenv.h>
+#include <module/builtins.h>
+
+static runtime_stab_entry_t bench_sid;
+
+int bench(void)
+{
+	runtime_task_t* task;
+	ASSERT_PTR(task = runtime_stab_create_exec_task(bench_sid, RUNTIME_TASK_FLAG_ACTION_EXEC), CLEANUP_NOP);
+
+	ASSERT_OK(runtime_task_start(task), CLEANUP_NOP);
+
+	ASSERT_OK(runtime_task_free(task), CLEANUP_NOP);
+
+	return 0;
+}
+
+int setup(void)
+{
+	ASSERT_OK(mempool_objpool_disabled(0), CLEANUP_NOP);
+
+	ASSERT_OK(itc_modtab_insmod(&module_pssm_module_def, 0, NULL), CLEANUP_NOP);
+	ASSERT_OK(runtime_servlet_append_search_path(TESTDIR), CLEANUP_NOP);
+
+	char const* argv[] = {"serv_pssm_bench"};
+	ASSERT_RETOK(runtime_stab_entry_t, bench_sid = runtime_stab_load(1, argv, NULL), CLEANUP_NOP);
+	expected_memory_leakage();
+
+	return 0;
+}
+
+DEFAULT_TEARDOWN;
+
+TEST_LIST_BEGIN
+    TEST_CASE(bench)
+TEST_LIST_END;
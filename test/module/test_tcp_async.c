@@ -264,7 +264,7 @@ int single_async_write(void)
 	uint32_t data;
 	/* Because the initial data state is wait, so nothing should happen here, so we can block every thing at this point */
 	_set_block_bits(0, 0xffffffffu);
-	ASSERT_OK(module_tcp_async_write_register(loop, 0, conn[0].efd, 16, _get_data_1, _handler_empty_1, _dispose_handler_1, _error_handler_1, dh + 0), CLEANUP_NOP);
+	ASSERT_OK(module_tcp_async_write_register(loop, 0, conn[0].efd, 16, _get_data_1, NULL, NULL, NULL, _handler_empty_1, _dispose_handler_1, _error_handler_1, dh + 0), CLEANUP_NOP);
 	/* C:R D:W */
 	ASSERT_OK(module_tcp_async_write_data_ready(loop, 0), CLEANUP_NOP);
 	/* after we send this, the get data function should be called first */
@@ -352,7 +352,7 @@ static inline int _parallel_write(uint32_t n)
 	for(i = 0; i < n; i ++)
 	{
 		_set_block_bits(i, 0xffffffff);
-		ASSERT_OK(module_tcp_async_write_register(loop, i, conn[i].efd, 16, _get_data_1, _handler_empty_1, _dispose_handler_1, _error_handler_1, dh + i), CLEANUP_NOP);
+		ASSERT_OK(module_tcp_async_write_register(loop, i, conn[i].efd, 16, _get_data_1, NULL, NULL, NULL, _handler_empty_1, _dispose_handler_1, _error_handler_1, dh + i), CLEANUP_NOP);
 	}
 
 	usleep(1000); /* make sure we do not have no operations, if this is not true, async thread will blocked */
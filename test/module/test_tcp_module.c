@@ -9,15 +9,20 @@
 #include <time.h>
 #include <errno.h>
 #include <stdio.h>
+#include <inttypes.h>
 #include <itc/module_types.h>
 #include <module/tcp/pool.h>
 #include <module/tcp/module.h>
+#include <lang/prop.h>
 #include <sys/wait.h>
 itc_module_type_t mod_tcp;
 struct {
 	module_tcp_pool_configure_t pool_conf;            /*!< the TCP pool configuration */
+	int                         retry_interval;       /*!< When the TCP pool cannot be configured, how much time we want to sleep before retry */
 	int                         pool_initialized;     /*!< indicates if the pool has been initialized */
 	int                         sync_write_attempt;   /*!< If do a synchronized write attempt before initialize a async operation */
+	int                         slave_mode;           /*!< The slave working mode, which means the module should not start the event loop */
+	int                         fork_id;              /*!< The id used to identify the TCP module instance that listen to the same port */
 	uint32_t                    async_buf_size;       /*!< The size of the async write buffer */
 	module_tcp_pool_t*          conn_pool;            /*!< The TCP connection pool object */
 } *context;
@@ -144,6 +149,122 @@ ERR:
 	return -1;
 }
 
+#define LARGE_RESPONSE_SIZE 65536
+
+static int64_t _get_counter(const char* name)
+{
+	lang_prop_value_t value = lang_prop_get(name);
+	if(value.type != LANG_PROP_TYPE_INTEGER) return ERROR_CODE(int64_t);
+	return value.num;
+}
+
+static int _large_request(void)
+{
+	int sock = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = inet_addr("127.0.0.1")
+	};
+	static char buffer[LARGE_RESPONSE_SIZE];
+	size_t ptr = 0, i;
+
+	if(sock < 0 || connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0 || send(sock, request, sizeof(request) - 1, 0) < 0)
+	{
+		perror("socket");
+		if(sock >= 0) close(sock);
+		return -1;
+	}
+
+	for(;ptr < sizeof(buffer);)
+	{
+		ssize_t rc = recv(sock, buffer + ptr, sizeof(buffer) - ptr, 0);
+		if(rc <= 0) break;
+		ptr += (size_t)rc;
+	}
+
+	close(sock);
+
+	if(ptr != sizeof(buffer)) return -1;
+
+	for(i = 0; i < sizeof(buffer); i ++)
+		if(buffer[i] != (char)(i * 7 + 3))
+			return -1;
+
+	return 0;
+}
+
+int writev_test(void)
+{
+	itc_module_pipe_param_t param = {
+		.input_flags = RUNTIME_API_PIPE_INPUT,
+		.output_flags = RUNTIME_API_PIPE_OUTPUT | RUNTIME_API_PIPE_ASYNC,
+		.args = NULL
+	};
+	static char buffer[LARGE_RESPONSE_SIZE];
+	itc_module_pipe_t *in = NULL, *out = NULL;
+	int status, i;
+	size_t j;
+	pid_t pid;
+
+	/* With the tiny async buffer, the copy path needs one write call for each 4 bytes, so the number of
+	 * system calls tells if the buffered pages are written with the scatter-gather path */
+	context->async_buf_size = 4;
+	context->sync_write_attempt = 0;
+
+	int64_t syscalls = _get_counter("pipe.tcp.port_8888.async_syscalls");
+	int64_t bytes = _get_counter("pipe.tcp.port_8888.async_bytes");
+	int64_t responses = _get_counter("pipe.tcp.port_8888.async_responses");
+	ASSERT(ERROR_CODE(int64_t) != syscalls, CLEANUP_NOP);
+	ASSERT(ERROR_CODE(int64_t) != bytes, CLEANUP_NOP);
+	ASSERT(ERROR_CODE(int64_t) != responses, CLEANUP_NOP);
+
+	for(j = 0; j < sizeof(buffer); j ++)
+		buffer[j] = (char)(j * 7 + 3);
+
+	pid = fork();
+
+	if(pid == 0)
+	{
+		sleep(1);
+		port = context->pool_conf.port;
+		plumber_finalize();
+		exit(_large_request());
+		return 0;
+	}
+
+	ASSERT_OK(itc_module_pipe_accept(mod_tcp, param, &in, &out), goto ERR);
+
+	static char req_buf[4096];
+	ASSERT_RETOK(size_t, itc_module_pipe_read(req_buf, sizeof(req_buf), in), goto ERR);
+
+	ASSERT(sizeof(buffer) == itc_module_pipe_write(buffer, sizeof(buffer), out), goto ERR);
+
+	ASSERT_OK(itc_module_pipe_deallocate(in), goto ERR);
+	in = NULL;
+	ASSERT_OK(itc_module_pipe_deallocate(out), goto ERR);
+	out = NULL;
+
+	ASSERT_OK(waitpid(pid, &status, 0), goto ERR);
+	ASSERT(status == 0, goto ERR);
+
+	for(i = 0; i < 100 && _get_counter("pipe.tcp.port_8888.async_responses") == responses; i ++)
+		usleep(10000);
+
+	int64_t nsyscalls = _get_counter("pipe.tcp.port_8888.async_syscalls") - syscalls;
+	LOG_NOTICE("%d bytes has been written with %"PRId64" system calls", LARGE_RESPONSE_SIZE, nsyscalls);
+
+	ASSERT(_get_counter("pipe.tcp.port_8888.async_responses") == responses + 1, goto ERR);
+	ASSERT(_get_counter("pipe.tcp.port_8888.async_bytes") == bytes + LARGE_RESPONSE_SIZE, goto ERR);
+	ASSERT(nsyscalls > 0 && nsyscalls < LARGE_RESPONSE_SIZE / 4, goto ERR);
+
+	return 0;
+ERR:
+	if(NULL != in) itc_module_pipe_deallocate(in);
+	if(NULL != out) itc_module_pipe_deallocate(out);
+	return -1;
+}
+
 int setup(void)
 {
 	mod_tcp = itc_modtab_get_module_type_from_path("pipe.tcp.port_8888");
@@ -156,5 +277,6 @@ int setup(void)
 DEFAULT_TEARDOWN;
 
 TEST_LIST_BEGIN
-    TEST_CASE(accept_test)
+    TEST_CASE(accept_test),
+    TEST_CASE(writev_test)
 TEST_LIST_END;
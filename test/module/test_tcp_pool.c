@@ -0,0 +1,141 @@
+/**
+ * Copyright (C) 2017-2018, Hao Hou
+ **/
+#include <constants.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <testenv.h>
+#include <module/tcp/pool.h>
+
+#define NCLIENTS 64
+
+static int clients[NCLIENTS];
+
+static module_tcp_pool_configure_t conf = {
+	.port = 0,
+	.ttl = 30,
+	.min_timeout = 1,
+	.tcp_backlog = NCLIENTS,
+	.reuseaddr = 1,
+	.reuseport = MODULE_TCP_POOL_REUSEPORT_NONE,
+	.ipv6 = 0,
+	.size = NCLIENTS * 2,
+	.bind_addr = "127.0.0.1",
+	.event_size = 64,
+	.accept_retry_interval = 1,
+	.dispose_data = NULL
+};
+
+static uint16_t _pick_port(void)
+{
+	return (uint16_t)(20000 + (getpid() * 7 + rand()) % 30000);
+}
+
+static int _connect_clients(void)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port   = htons(conf.port),
+		.sin_addr.s_addr = inet_addr("127.0.0.1")
+	};
+	uint32_t i;
+
+	for(i = 0; i < NCLIENTS; i ++)
+	{
+		ASSERT((clients[i] = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP)) >= 0, CLEANUP_NOP);
+		ASSERT_OK(connect(clients[i], (struct sockaddr*)&addr, sizeof(addr)), CLEANUP_NOP);
+		ASSERT(1 == write(clients[i], "x", 1), CLEANUP_NOP);
+	}
+
+	return 0;
+}
+
+static void _close_clients(void)
+{
+	uint32_t i;
+	for(i = 0; i < NCLIENTS; i ++)
+		if(clients[i] > 0)
+		{
+			close(clients[i]);
+			clients[i] = 0;
+		}
+}
+
+/**
+ * @brief configure a master pool and a forked pool with the given reuseport mode, and make sure
+ *        both of the pools are able to accept the connections
+ * @param mode the reuseport mode
+ * @return status code
+ **/
+static int _run(int mode)
+{
+	module_tcp_pool_t *master = NULL, *fork = NULL;
+	module_tcp_pool_conninfo_t info;
+	int rc = ERROR_CODE(int);
+
+	conf.reuseport = mode;
+	conf.port = _pick_port();
+
+	ASSERT_PTR(master = module_tcp_pool_new(), goto RET);
+	ASSERT_PTR(fork = module_tcp_pool_fork(master), goto RET);
+	ASSERT(1 == module_tcp_pool_num_forks(master), goto RET);
+
+	ASSERT_OK(module_tcp_pool_configure(master, &conf), goto RET);
+	ASSERT_OK(module_tcp_pool_configure(fork, &conf), goto RET);
+
+	ASSERT_OK(_connect_clients(), goto RET);
+
+	/* For the CPU steering mode, all the loopback connections may be handled by the same CPU, thus
+	 * we are not able to predict which pool gets the connections */
+	if(mode == MODULE_TCP_POOL_REUSEPORT_CPU)
+	{
+		rc = 0;
+		goto RET;
+	}
+
+	/* With the reuseport mode, each pool has its own accept queue, so both of them should get a connection.
+	 * Otherwise, the forked pool would be blocked forever, since the master drains the shared accept queue */
+	ASSERT_OK(module_tcp_pool_connection_get(master, &info), goto RET);
+	ASSERT(info.fd >= 0, goto RET);
+	ASSERT_OK(module_tcp_pool_connection_get(fork, &info), goto RET);
+	ASSERT(info.fd >= 0, goto RET);
+
+	rc = 0;
+RET:
+	_close_clients();
+	if(NULL != fork) ASSERT_OK(module_tcp_pool_free(fork), rc = ERROR_CODE(int));
+	if(NULL != master) ASSERT_OK(module_tcp_pool_free(master), rc = ERROR_CODE(int));
+	return rc;
+}
+
+int reuseport_hash(void)
+{
+	return _run(MODULE_TCP_POOL_REUSEPORT_HASH);
+}
+
+int reuseport_cpu(void)
+{
+#ifdef __LINUX__
+	return _run(MODULE_TCP_POOL_REUSEPORT_CPU);
+#else
+	return 0;
+#endif
+}
+
+int setup(void)
+{
+	srand((unsigned)time(NULL));
+	return 0;
+}
+
+DEFAULT_TEARDOWN;
+
+TEST_LIST_BEGIN
+    TEST_CASE(reuseport_hash),
+    TEST_CASE(reuseport_cpu)
+TEST_LIST_END;
@@ -0,0 +1,573 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+
+/**
+ * @brief The handshake storm benchmark for the TLS module over the loopback device, which measures the
+ *        handshake rate and the latency of an established connection while a number of clients are doing
+ *        full handshakes, with and without the handshake thread pool, and checks a saved session can be resumed
+ **/
+#include <constants.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <inttypes.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <testenv.h>
+#include <utils/thread.h>
+#include <lang/prop.h>
+
+#if MODULE_TLS_ENABLED
+#include <stdarg.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <openssl/pem.h>
+#include <openssl/crypto.h>
+
+#include <module/tcp/module.h>
+#include <module/tls/module.h>
+
+#define NSTORM_THREADS 4
+#define NSTORM_CONNS 32
+#define NHANDSHAKE_THREADS 2
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void  __libc_free(void* ptr);
+
+static itc_module_type_t mod_tls;
+
+static uint16_t port;
+
+static char cert_path[128], key_path[128], prop_prefix[64];
+
+static SSL_CTX* client_ctx;
+
+static uint32_t storm_done;
+
+/**
+ * @brief the client side result of a benchmark round
+ **/
+typedef struct {
+	int      error;       /*!< if any client has encountered an error */
+	uint32_t pings;       /*!< the number of pings on the established connection */
+	uint64_t ping_total;  /*!< the total latency of the pings in microseconds */
+	uint64_t ping_max;    /*!< the max latency of the pings in microseconds */
+	uint64_t storm_time;  /*!< the time spent on the handshake storm in microseconds */
+} result_t;
+
+static result_t result;
+
+static uint64_t _now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/* Keep the global states of OpenSSL out of the leak check, since they are only released at exit */
+static void* _ssl_malloc(size_t size, const char* file, int line)
+{
+	(void)file;
+	(void)line;
+	return __libc_malloc(size);
+}
+
+static void* _ssl_realloc(void* ptr, size_t size, const char* file, int line)
+{
+	(void)file;
+	(void)line;
+	return __libc_realloc(ptr, size);
+}
+
+static void _ssl_free(void* ptr, const char* file, int line)
+{
+	(void)file;
+	(void)line;
+	__libc_free(ptr);
+}
+
+static int _cntl(itc_module_pipe_t* pipe, uint32_t opcode, ...)
+{
+	va_list ap;
+	va_start(ap, opcode);
+	int rc = itc_module_pipe_cntl(pipe, opcode, ap);
+	va_end(ap);
+	return rc;
+}
+
+static int64_t _get_prop(const char* name)
+{
+	char buf[128];
+	snprintf(buf, sizeof(buf), "%s.%s", prop_prefix, name);
+	lang_prop_value_t value = lang_prop_get(buf);
+	if(value.type != LANG_PROP_TYPE_INTEGER) return ERROR_CODE(int64_t);
+	return value.num;
+}
+
+static int _set_prop(const char* name, int64_t num)
+{
+	char buf[128];
+	snprintf(buf, sizeof(buf), "%s.%s", prop_prefix, name);
+	lang_prop_value_t value = {
+		.type = LANG_PROP_TYPE_INTEGER,
+		.num = num
+	};
+	return lang_prop_set(buf, value) > 0 ? 0 : ERROR_CODE(int);
+}
+
+/**
+ * @brief connect to the server and finish the TLS handshake
+ * @param fd the buffer used to return the socket
+ * @param session the session we want to resume, NULL for a full handshake
+ * @return the SSL object or NULL on error case
+ **/
+static SSL* _connect(int* fd, SSL_SESSION* session)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = inet_addr("127.0.0.1")
+	};
+	SSL* ssl = NULL;
+	int nodelay = 1;
+
+	if((*fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+		return NULL;
+
+	if(setsockopt(*fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay)) < 0 ||
+	   connect(*fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+	   NULL == (ssl = SSL_new(client_ctx)) ||
+	   !SSL_set_fd(ssl, *fd) ||
+	   (NULL != session && !SSL_set_session(ssl, session)) ||
+	   SSL_connect(ssl) <= 0)
+	{
+		if(NULL != ssl) SSL_free(ssl);
+		close(*fd);
+		return NULL;
+	}
+
+	return ssl;
+}
+
+static void _disconnect(SSL* ssl, int fd)
+{
+	SSL_shutdown(ssl);
+	SSL_free(ssl);
+	close(fd);
+}
+
+/**
+ * @brief send a request and wait for the response
+ * @param ssl the SSL object
+ * @param req the request
+ * @return status code
+ **/
+static int _request(SSL* ssl, const char* req)
+{
+	char buf[5];
+	int sz = 0, rc;
+
+	if(SSL_write(ssl, req, 5) != 5) return ERROR_CODE(int);
+
+	while(sz < 5 && (rc = SSL_read(ssl, buf + sz, 5 - sz)) > 0)
+		sz += rc;
+
+	return (sz == 5 && memcmp(buf, "PONG\n", 5) == 0) ? 0 : ERROR_CODE(int);
+}
+
+static void* _storm_main(void* data)
+{
+	uint32_t i;
+	for(i = 0; i < NSTORM_CONNS; i ++)
+	{
+		int fd;
+		SSL* ssl = _connect(&fd, NULL);
+		if(NULL == ssl || ERROR_CODE(int) == _request(ssl, "PING\n"))
+		{
+			LOG_ERROR("The handshake storm client failed");
+			result.error = 1;
+			if(NULL != ssl) _disconnect(ssl, fd);
+			break;
+		}
+		_disconnect(ssl, fd);
+	}
+
+	__sync_fetch_and_add(&storm_done, 1);
+
+	return data;
+}
+
+/**
+ * @brief the client driver, which starts the handshake storm and keeps pinging the server with an established
+ *        connection until all the storm clients are done
+ * @param data unused
+ * @return data
+ **/
+static void* _client_main(void* data)
+{
+	thread_t* threads[NSTORM_THREADS] = {};
+	uint32_t i;
+	int fd;
+	SSL* ssl = NULL;
+	uint64_t begin;
+
+	/* The transportation layer starts listening on the first accept call, so the server may not be ready yet */
+	for(i = 0; i < 100 && NULL == (ssl = _connect(&fd, NULL)); i ++)
+		usleep(50000);
+
+	if(NULL == ssl)
+	{
+		LOG_ERROR("Cannot connect the ping client");
+		result.error = 1;
+		return data;
+	}
+
+	begin = _now();
+	for(i = 0; i < NSTORM_THREADS; i ++)
+		if(NULL == (threads[i] = thread_new(_storm_main, NULL, THREAD_TYPE_GENERIC)))
+		{
+			LOG_ERROR("Cannot start the storm client");
+			result.error = 1;
+			__sync_fetch_and_add(&storm_done, 1);
+		}
+
+	while(__sync_fetch_and_add(&storm_done, 0) < NSTORM_THREADS && !result.error)
+	{
+		uint64_t ts = _now();
+		if(ERROR_CODE(int) == _request(ssl, "PING\n"))
+		{
+			LOG_ERROR("The ping client failed");
+			result.error = 1;
+			break;
+		}
+		ts = _now() - ts;
+		result.pings ++;
+		result.ping_total += ts;
+		if(result.ping_max < ts) result.ping_max = ts;
+		usleep(1000);
+	}
+
+	for(i = 0; i < NSTORM_THREADS; i ++)
+		if(NULL != threads[i]) thread_free(threads[i], NULL);
+
+	result.storm_time = _now() - begin;
+
+	_disconnect(ssl, fd);
+
+	if(NULL == (ssl = _connect(&fd, NULL)) || ERROR_CODE(int) == _request(ssl, "QUIT\n"))
+	{
+		LOG_ERROR("Cannot stop the server");
+		result.error = 1;
+	}
+	if(NULL != ssl) _disconnect(ssl, fd);
+
+	return data;
+}
+
+/**
+ * @brief the server loop, which answers the pings until the quit request is received and all the connections are closed
+ * @param nconns the number of connections the client will make
+ * @return status code
+ **/
+static int _serve(uint32_t nconns)
+{
+	itc_module_pipe_param_t param = {
+		.input_flags = RUNTIME_API_PIPE_INPUT | RUNTIME_API_PIPE_PERSIST,
+		.output_flags = RUNTIME_API_PIPE_OUTPUT | RUNTIME_API_PIPE_PERSIST,
+		.args = NULL
+	};
+	int quit = 0;
+	uint32_t closed = 0;
+
+	while(!quit || closed < nconns)
+	{
+		itc_module_pipe_t *in = NULL, *out = NULL;
+		char buf[16];
+		size_t sz;
+
+		ASSERT_OK(itc_module_pipe_accept(mod_tls, param, &in, &out), goto ERR);
+
+		ASSERT_RETOK(size_t, sz = itc_module_pipe_read(buf, sizeof(buf), in), goto ERR);
+
+		if(sz == 0)
+		{
+			int eof = itc_module_pipe_eof(in);
+			ASSERT_RETOK(int, eof, goto ERR);
+			if(eof)
+			{
+				ASSERT_OK(_cntl(in, RUNTIME_API_PIPE_CNTL_OPCODE_CLR_FLAG, RUNTIME_API_PIPE_PERSIST), goto ERR);
+				ASSERT_OK(_cntl(out, RUNTIME_API_PIPE_CNTL_OPCODE_CLR_FLAG, RUNTIME_API_PIPE_PERSIST), goto ERR);
+				closed ++;
+			}
+		}
+		else
+		{
+			ASSERT(sz == 5, goto ERR);
+			if(memcmp(buf, "QUIT\n", 5) == 0) quit = 1;
+			else ASSERT(memcmp(buf, "PING\n", 5) == 0, goto ERR);
+			ASSERT(5 == itc_module_pipe_write("PONG\n", 5, out), goto ERR);
+		}
+
+		ASSERT_OK(itc_module_pipe_deallocate(in), goto ERR);
+		in = NULL;
+		ASSERT_OK(itc_module_pipe_deallocate(out), goto ERR);
+		continue;
+ERR:
+		if(NULL != in) itc_module_pipe_deallocate(in);
+		if(NULL != out) itc_module_pipe_deallocate(out);
+		return ERROR_CODE(int);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief run a round of the handshake storm
+ * @param nthreads the number of handshake threads
+ * @return status code
+ **/
+static int _run(uint32_t nthreads)
+{
+	thread_t* client = NULL;
+	uint32_t nconns = NSTORM_THREADS * NSTORM_CONNS + 2;
+	int64_t full, offloaded;
+
+	memset(&result, 0, sizeof(result));
+	storm_done = 0;
+
+	ASSERT_OK(_set_prop("handshake_threads", nthreads), CLEANUP_NOP);
+	ASSERT_RETOK(int64_t, full = _get_prop("stat_full_handshakes"), CLEANUP_NOP);
+	ASSERT_RETOK(int64_t, offloaded = _get_prop("stat_handshake_offloaded"), CLEANUP_NOP);
+
+	ASSERT_PTR(client = thread_new(_client_main, NULL, THREAD_TYPE_GENERIC), CLEANUP_NOP);
+
+	ASSERT_OK(_serve(nconns), goto ERR);
+
+	ASSERT_OK(thread_free(client, NULL), CLEANUP_NOP);
+	client = NULL;
+
+	ASSERT(!result.error, CLEANUP_NOP);
+	ASSERT(result.pings > 0, CLEANUP_NOP);
+
+	LOG_NOTICE("Handshake threads %u: %u handshakes in %"PRIu64"us (%.1f handshakes/sec), "
+	           "ping latency avg %"PRIu64"us, max %"PRIu64"us over %u pings",
+	           nthreads, nconns, result.storm_time, nconns * 1e6 / (double)result.storm_time,
+	           result.ping_total / result.pings, result.ping_max, result.pings);
+
+	ASSERT(_get_prop("stat_full_handshakes") - full == nconns, CLEANUP_NOP);
+	offloaded = _get_prop("stat_handshake_offloaded") - offloaded;
+
+	if(nthreads == 0)
+		ASSERT(offloaded == 0, CLEANUP_NOP);
+	else
+		ASSERT(offloaded + _get_prop("stat_handshake_overflow") >= nconns, CLEANUP_NOP);
+
+	return 0;
+ERR:
+	/* The client can not finish without the server, so we just leave it */
+	return ERROR_CODE(int);
+}
+
+/**
+ * @brief the resumption client, which saves the session of the first connection and resumes it with the second one
+ * @param data unused
+ * @return data
+ **/
+static void* _resume_main(void* data)
+{
+	uint32_t i;
+	int fd;
+	SSL* ssl = NULL;
+	SSL_SESSION* session = NULL;
+
+	for(i = 0; i < 100 && NULL == (ssl = _connect(&fd, NULL)); i ++)
+		usleep(50000);
+
+	if(NULL == ssl || ERROR_CODE(int) == _request(ssl, "PING\n") || NULL == (session = SSL_get1_session(ssl)))
+	{
+		LOG_ERROR("Cannot establish the session to resume");
+		result.error = 1;
+	}
+	if(NULL != ssl) _disconnect(ssl, fd);
+	ssl = NULL;
+
+	if(NULL == session || NULL == (ssl = _connect(&fd, session)) || !SSL_session_reused(ssl) || ERROR_CODE(int) == _request(ssl, "PING\n"))
+	{
+		LOG_ERROR("Cannot resume the saved session");
+		result.error = 1;
+	}
+	if(NULL != ssl) _disconnect(ssl, fd);
+	if(NULL != session) SSL_SESSION_free(session);
+
+	if(NULL == (ssl = _connect(&fd, NULL)) || ERROR_CODE(int) == _request(ssl, "QUIT\n"))
+	{
+		LOG_ERROR("Cannot stop the server");
+		result.error = 1;
+	}
+	if(NULL != ssl) _disconnect(ssl, fd);
+
+	return data;
+}
+
+int session_resume(void)
+{
+	thread_t* client = NULL;
+	int64_t resumed, full;
+
+	memset(&result, 0, sizeof(result));
+
+	ASSERT_RETOK(int64_t, resumed = _get_prop("stat_resumed_handshakes"), CLEANUP_NOP);
+	ASSERT_RETOK(int64_t, full = _get_prop("stat_full_handshakes"), CLEANUP_NOP);
+
+	ASSERT_PTR(client = thread_new(_resume_main, NULL, THREAD_TYPE_GENERIC), CLEANUP_NOP);
+
+	/* The client can not finish without the server, so we just leave it on error */
+	ASSERT_OK(_serve(3), CLEANUP_NOP);
+
+	ASSERT_OK(thread_free(client, NULL), CLEANUP_NOP);
+
+	ASSERT(!result.error, CLEANUP_NOP);
+	ASSERT(_get_prop("stat_resumed_handshakes") - resumed == 1, CLEANUP_NOP);
+	ASSERT(_get_prop("stat_full_handshakes") - full == 2, CLEANUP_NOP);
+
+	return 0;
+}
+
+int storm_inline(void)
+{
+	return _run(0);
+}
+
+int storm_offload(void)
+{
+	return _run(NHANDSHAKE_THREADS);
+}
+
+/**
+ * @brief generate a self-signed certificate for the test
+ * @return status code
+ **/
+static int _gen_cert(void)
+{
+	EVP_PKEY_CTX* pctx = NULL;
+	EVP_PKEY* pkey = NULL;
+	X509* x509 = NULL;
+	FILE* fp = NULL;
+	int rc = ERROR_CODE(int);
+
+	ASSERT_PTR(pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL), goto ERR);
+	ASSERT(EVP_PKEY_keygen_init(pctx) > 0, goto ERR);
+	ASSERT(EVP_PKEY_CTX_set_rsa_keygen_bits(pctx, 2048) > 0, goto ERR);
+	ASSERT(EVP_PKEY_keygen(pctx, &pkey) > 0, goto ERR);
+
+	ASSERT_PTR(x509 = X509_new(), goto ERR);
+	ASSERT(X509_set_version(x509, 2), goto ERR);
+	ASSERT(ASN1_INTEGER_set(X509_get_serialNumber(x509), 1), goto ERR);
+	ASSERT_PTR(X509_gmtime_adj(X509_get_notBefore(x509), 0), goto ERR);
+	ASSERT_PTR(X509_gmtime_adj(X509_get_notAfter(x509), 86400), goto ERR);
+	ASSERT(X509_set_pubkey(x509, pkey), goto ERR);
+	ASSERT(X509_NAME_add_entry_by_txt(X509_get_subject_name(x509), "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1, -1, 0), goto ERR);
+	ASSERT(X509_set_issuer_name(x509, X509_get_subject_name(x509)), goto ERR);
+	ASSERT(X509_sign(x509, pkey, EVP_sha256()), goto ERR);
+
+	ASSERT_PTR(fp = fopen(key_path, "w"), goto ERR);
+	ASSERT(PEM_write_PrivateKey(fp, pkey, NULL, NULL, 0, NULL, NULL), goto ERR);
+	fclose(fp);
+	fp = NULL;
+
+	ASSERT_PTR(fp = fopen(cert_path, "w"), goto ERR);
+	ASSERT(PEM_write_X509(fp, x509), goto ERR);
+	fclose(fp);
+	fp = NULL;
+
+	rc = 0;
+ERR:
+	if(NULL != fp) fclose(fp);
+	if(NULL != x509) X509_free(x509);
+	if(NULL != pkey) EVP_PKEY_free(pkey);
+	if(NULL != pctx) EVP_PKEY_CTX_free(pctx);
+	return rc;
+}
+
+int setup(void)
+{
+	char port_buf[16], tcp_path[32], cert_arg[160], key_arg[160], tls_path[64];
+	uint32_t i;
+
+	ASSERT(CRYPTO_set_mem_functions(_ssl_malloc, _ssl_realloc, _ssl_free), CLEANUP_NOP);
+
+	/* The thread local storage of the pthread stack cache, for the clients, the resumption client and the handshake threads */
+	for(i = 0; i < NSTORM_THREADS + 2 + NHANDSHAKE_THREADS; i ++)
+		expected_memory_leakage();
+
+	/* The C locale OpenSSL creates on initialization, which is allocated with libc directly and released at exit */
+	for(i = 0; i < 3; i ++)
+		expected_memory_leakage();
+
+	snprintf(cert_path, sizeof(cert_path), "/tmp/plumber-test-tls-cert.%d.pem", getpid());
+	snprintf(key_path, sizeof(key_path), "/tmp/plumber-test-tls-key.%d.pem", getpid());
+
+	ASSERT_OK(_gen_cert(), CLEANUP_NOP);
+
+	srand((unsigned)time(NULL));
+	port = (uint16_t)(20000 + (getpid() * 7 + rand()) % 30000);
+
+	snprintf(port_buf, sizeof(port_buf), "%u", port);
+	snprintf(tcp_path, sizeof(tcp_path), "pipe.tcp.port_%u", port);
+	snprintf(cert_arg, sizeof(cert_arg), "cert=%s", cert_path);
+	snprintf(key_arg, sizeof(key_arg), "key=%s", key_path);
+	snprintf(tls_path, sizeof(tls_path), "pipe.tls.%s", tcp_path);
+	snprintf(prop_prefix, sizeof(prop_prefix), "%s", tls_path);
+
+	char const* tcp_args[] = {"--slave", port_buf};
+	ASSERT_OK(itc_modtab_insmod(&module_tcp_module_def, 2, tcp_args), CLEANUP_NOP);
+
+	char const* tls_args[] = {cert_arg, key_arg, tcp_path};
+	ASSERT_OK(itc_modtab_insmod(&module_tls_module_def, 3, tls_args), CLEANUP_NOP);
+
+	ASSERT_RETOK(itc_module_type_t, mod_tls = itc_modtab_get_module_type_from_path(tls_path), CLEANUP_NOP);
+
+	ASSERT_PTR(client_ctx = SSL_CTX_new(SSLv23_client_method()), CLEANUP_NOP);
+	/* Make sure all the connections are doing the full handshake */
+	SSL_CTX_set_session_cache_mode(client_ctx, SSL_SESS_CACHE_OFF);
+	SSL_CTX_set_options(client_ctx, SSL_OP_NO_TICKET);
+	/* The TLS 1.3 server sends the session tickets after the handshake, then the small response following them is
+	 * held by the Nagle's algorithm until the delayed ACK from the client, which hides the cost of the handshake */
+	SSL_CTX_set_max_proto_version(client_ctx, TLS1_2_VERSION);
+
+	return 0;
+}
+
+int teardown(void)
+{
+	if(NULL != client_ctx) SSL_CTX_free(client_ctx);
+	unlink(cert_path);
+	unlink(key_path);
+	return 0;
+}
+
+TEST_LIST_BEGIN
+    TEST_CASE(storm_inline),
+    TEST_CASE(storm_offload),
+    TEST_CASE(session_resume)
+TEST_LIST_END;
+#else
+int disabled(void)
+{
+	LOG_NOTICE("The TLS module is disabled, skip the handshake storm benchmark");
+	return 0;
+}
+
+DEFAULT_SETUP;
+DEFAULT_TEARDOWN;
+
+TEST_LIST_BEGIN
+    TEST_CASE(disabled)
+TEST_LIST_END;
+#endif
@@ -0,0 +1,94 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+
+/**
+ * @brief The async test servlet, which sleeps in the async processing thread and then
+ *        writes "OK" or "ERR" to the output in the async cleanup
+ **/
+#include <pservlet.h>
+#include <error.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+	uint32_t sleep_ms;
+	pipe_t   input;
+	pipe_t   output;
+} context_t;
+
+typedef struct {
+	uint32_t sleep_ms;
+} async_buf_t;
+
+static int init(uint32_t argc, char const* const* argv, void* mem)
+{
+	context_t* ctx = (context_t*)mem;
+
+	if(argc != 2) ERROR_RETURN_LOG(int, "Usage: serv_async <sleep-ms>");
+
+	ctx->sleep_ms = (uint32_t)atoi(argv[1]);
+
+	if(ERROR_CODE(pipe_t) == (ctx->input = pipe_define("in", PIPE_INPUT, NULL)))
+		ERROR_RETURN_LOG(int, "Cannot define the input pipe");
+
+	if(ERROR_CODE(pipe_t) == (ctx->output = pipe_define("out", PIPE_OUTPUT, NULL)))
+		ERROR_RETURN_LOG(int, "Cannot define the output pipe");
+
+	/* This is an async servlet */
+	return 1;
+}
+
+static int async_setup(async_handle_t* handle, void* data, void* mem)
+{
+	(void)handle;
+	context_t* ctx = (context_t*)mem;
+	async_buf_t* buf = (async_buf_t*)data;
+
+	char req[64];
+	if(ERROR_CODE(size_t) == pipe_read(ctx->input, req, sizeof(req)))
+		ERROR_RETURN_LOG(int, "Cannot read the request");
+
+	buf->sleep_ms = ctx->sleep_ms;
+
+	return 0;
+}
+
+static int async_exec(async_handle_t* handle, void* data)
+{
+	(void)handle;
+	const async_buf_t* buf = (const async_buf_t*)data;
+
+	usleep(buf->sleep_ms * 1000);
+
+	return 0;
+}
+
+static int async_cleanup(async_handle_t* handle, void* data, void* mem)
+{
+	(void)data;
+	context_t* ctx = (context_t*)mem;
+
+	int status;
+	if(ERROR_CODE(int) == async_cntl(handle, ASYNC_CNTL_RETCODE, &status))
+		ERROR_RETURN_LOG(int, "Cannot get the status code of the async task");
+
+	const char* result = status == ERROR_CODE(int) ? "ERR\n" : "OK\n";
+
+	if(ERROR_CODE(size_t) == pipe_write(ctx->output, result, strlen(result)))
+		ERROR_RETURN_LOG(int, "Cannot write the result");
+
+	return 0;
+}
+
+SERVLET_DEF = {
+	.desc = "The async task test servlet",
+	.version = 0,
+	.size = sizeof(context_t),
+	.init = init,
+	.async_buf_size = sizeof(async_buf_t),
+	.async_setup = async_setup,
+	.async_exec = async_exec,
+	.async_cleanup = async_cleanup
+};
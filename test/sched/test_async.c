@@ -0,0 +1,252 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+
+/**
+ * @brief The async task processor test, which runs the scheduler loop with an async servlet behind
+ *        the TCP module, and checks the completion delivery, the elastic thread pool and the statistics
+ *        in both dispatcher and work-stealing mode
+ **/
+#include <testenv.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+#include <lang/prop.h>
+
+/**
+ * @brief How long the async_exec sleeps
+ **/
+#define SLEEP_MS 300   /* Should be the same as the servlet argument */
+
+/**
+ * @brief The number of concurrent requests
+ **/
+#define NREQUESTS 8
+
+/**
+ * @brief The size of the async thread pool
+ **/
+#define MIN_THREADS 1
+#define MAX_THREADS 4
+
+static sched_service_buffer_t* buffer;
+static sched_service_t* service;
+static int loop_rc;
+
+static int64_t _get_num(const char* name)
+{
+	lang_prop_value_t value = lang_prop_get(name);
+	if(value.type != LANG_PROP_TYPE_INTEGER) return ERROR_CODE(int64_t);
+	return value.num;
+}
+
+static int _set_num(const char* name, int64_t num)
+{
+	lang_prop_value_t value = {
+		.type = LANG_PROP_TYPE_INTEGER,
+		.num  = num
+	};
+	return lang_prop_set(name, value);
+}
+
+static void* _loop_main(void* data)
+{
+	(void)data;
+	loop_rc = sched_loop_start(&service, 0);
+	return NULL;
+}
+
+/**
+ * @brief Send a request to the TCP module and check the async servlet responds OK
+ * @return NULL on success
+ **/
+static void* _request(void* data)
+{
+	(void)data;
+	int sock = -1;
+	int retry;
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port   = htons(8888)
+	};
+	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+	/* The listening socket is created by the event loop, so it may be not ready yet */
+	for(retry = 0; retry < 50; retry ++)
+	{
+		if((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) return (void*)-1;
+		if(connect(sock, (struct sockaddr*)&addr, sizeof(addr)) == 0) break;
+		close(sock);
+		sock = -1;
+		usleep(100000);
+	}
+
+	if(sock < 0) return (void*)-1;
+
+	struct timeval tv = { .tv_sec = 10 };
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	char buf[16] = {};
+	size_t size = 0;
+	ssize_t rc;
+
+	if(send(sock, "GO\n", 3, 0) != 3) goto ERR;
+
+	while(size < sizeof(buf) - 1 && (rc = recv(sock, buf + size, sizeof(buf) - 1 - size, 0)) > 0)
+	{
+		size += (size_t)rc;
+		if(buf[size - 1] == '\n') break;
+	}
+
+	close(sock);
+
+	if(strcmp(buf, "OK\n") != 0)
+	{
+		LOG_ERROR("Unexpected response `%s'", buf);
+		return (void*)-1;
+	}
+
+	return NULL;
+ERR:
+	close(sock);
+	return (void*)-1;
+}
+
+/**
+ * @brief Run the scheduler loop in the given mode and verify the async task processor
+ * @param mode The worker mode
+ * @return status code
+ **/
+static int _run(const char* mode)
+{
+	pthread_t loop_thread, clients[NREQUESTS];
+	uint32_t i, nclients = 0;
+	int loop_started = 0, rc = ERROR_CODE(int);
+	int64_t max_active = 0, active;
+
+	lang_prop_value_t value = {
+		.type = LANG_PROP_TYPE_STRING,
+		.str  = (char*)mode
+	};
+	ASSERT_OK(lang_prop_set("scheduler.worker.mode", value), CLEANUP_NOP);
+
+	loop_rc = ERROR_CODE(int);
+	ASSERT(0 == pthread_create(&loop_thread, NULL, _loop_main, NULL), CLEANUP_NOP);
+	loop_started = 1;
+
+	/* Wait until the async task processor is started */
+	for(i = 0; i < 100 && _get_num("scheduler.async.active_threads") != MIN_THREADS; i ++)
+		usleep(50000);
+	ASSERT(MIN_THREADS == _get_num("scheduler.async.active_threads"), goto RET);
+
+	for(nclients = 0; nclients < NREQUESTS; nclients ++)
+		ASSERT(0 == pthread_create(clients + nclients, NULL, _request, NULL), goto RET);
+
+	/* All the tasks are posted at the same time, so the pool should grow to the maximum */
+	for(i = 0; i < 100; i ++)
+	{
+		ASSERT_RETOK(int64_t, active = _get_num("scheduler.async.active_threads"), goto RET);
+		if(active > max_active) max_active = active;
+		if(_get_num("scheduler.async.stat_tasks") == NREQUESTS) break;
+		usleep(50000);
+	}
+
+	int failed = 0;
+	for(;nclients > 0; nclients --)
+	{
+		void* result;
+		ASSERT(0 == pthread_join(clients[nclients - 1], &result), goto RET);
+		if(NULL != result) failed ++;
+	}
+
+	/* Every completion should have been delivered to the worker and every request got its response */
+	ASSERT(failed == 0, goto RET);
+	ASSERT(max_active == MAX_THREADS, goto RET);
+
+	/* The statistics, half of the tasks have to wait for a busy thread */
+	ASSERT(NREQUESTS == _get_num("scheduler.async.stat_tasks"), goto RET);
+	ASSERT(_get_num("scheduler.async.stat_max_run_ns") >= SLEEP_MS * 1000000ll, goto RET);
+	ASSERT(_get_num("scheduler.async.stat_run_ns") >= NREQUESTS * SLEEP_MS * 1000000ll, goto RET);
+	ASSERT(_get_num("scheduler.async.stat_run_ns") >= _get_num("scheduler.async.stat_max_run_ns"), goto RET);
+	ASSERT(_get_num("scheduler.async.stat_max_queue_wait_ns") >= SLEEP_MS * 1000000ll / 2, goto RET);
+	ASSERT(_get_num("scheduler.async.stat_queue_wait_ns") >= _get_num("scheduler.async.stat_max_queue_wait_ns"), goto RET);
+
+	/* The statistics are read-only */
+	ASSERT(ERROR_CODE(int) == _set_num("scheduler.async.stat_tasks", 0), goto RET);
+	ASSERT(ERROR_CODE(int) == _set_num("scheduler.async.active_threads", 0), goto RET);
+
+	/* After the idle timeout, the pool should shrink back to its minimal size */
+	for(i = 0; i < 100 && _get_num("scheduler.async.active_threads") != MIN_THREADS; i ++)
+		usleep(100000);
+	ASSERT(MIN_THREADS == _get_num("scheduler.async.active_threads"), goto RET);
+
+	/* And it never goes below the minimal size */
+	usleep(2500000);
+	ASSERT(MIN_THREADS == _get_num("scheduler.async.active_threads"), goto RET);
+
+	rc = 0;
+RET:
+	for(;nclients > 0; nclients --)
+		pthread_join(clients[nclients - 1], NULL);
+	if(loop_started)
+	{
+		if(ERROR_CODE(int) == sched_loop_kill(0)) rc = ERROR_CODE(int);
+		pthread_join(loop_thread, NULL);
+		if(ERROR_CODE(int) == loop_rc) rc = ERROR_CODE(int);
+	}
+	return rc;
+}
+
+int dispatcher_mode(void)
+{
+	return _run("dispatcher");
+}
+
+int work_stealing_mode(void)
+{
+	return _run("work_stealing");
+}
+
+int setup(void)
+{
+	runtime_stab_entry_t servlet;
+	runtime_api_pipe_id_t in, out;
+	const char* argv[] = {"serv_async", "300"};
+
+	expected_memory_leakage();
+
+	ASSERT_OK(runtime_servlet_append_search_path(TESTDIR), CLEANUP_NOP);
+	ASSERT_RETOK(runtime_stab_entry_t, servlet = runtime_stab_load(2, argv, NULL), CLEANUP_NOP);
+	ASSERT_RETOK(runtime_api_pipe_id_t, in = runtime_stab_get_pipe(servlet, "in"), CLEANUP_NOP);
+	ASSERT_RETOK(runtime_api_pipe_id_t, out = runtime_stab_get_pipe(servlet, "out"), CLEANUP_NOP);
+
+	ASSERT_PTR(buffer = sched_service_buffer_new(), CLEANUP_NOP);
+	ASSERT_RETOK(sched_service_node_id_t, sched_service_buffer_add_node(buffer, servlet), CLEANUP_NOP);
+	ASSERT_OK(sched_service_buffer_set_input(buffer, 0, in), CLEANUP_NOP);
+	ASSERT_OK(sched_service_buffer_set_output(buffer, 0, out), CLEANUP_NOP);
+	ASSERT_PTR(service = sched_service_from_buffer(buffer), CLEANUP_NOP);
+
+	ASSERT_OK(_set_num("scheduler.worker.nthreads", 2), CLEANUP_NOP);
+	ASSERT_OK(_set_num("scheduler.async.min_threads", MIN_THREADS), CLEANUP_NOP);
+	ASSERT_OK(_set_num("scheduler.async.max_threads", MAX_THREADS), CLEANUP_NOP);
+	ASSERT_OK(_set_num("scheduler.async.idle_timeout", 1), CLEANUP_NOP);
+	ASSERT_OK(_set_num("pipe.tcp.port_8888.reuseaddr", 1), CLEANUP_NOP);
+
+	return 0;
+}
+
+int teardown(void)
+{
+	int rc = 0;
+	if(NULL != service && ERROR_CODE(int) == sched_service_free(service)) rc = ERROR_CODE(int);
+	if(NULL != buffer && ERROR_CODE(int) == sched_service_buffer_free(buffer)) rc = ERROR_CODE(int);
+	return rc;
+}
+
+TEST_LIST_BEGIN
+    TEST_CASE(dispatcher_mode),
+    TEST_CASE(work_stealing_mode)
+TEST_LIST_END;
@@ -0,0 +1,227 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+
+#include <testenv.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <inttypes.h>
+
+static sched_service_buffer_t* buffer;
+static sched_service_t* service;
+static sched_prof_t* prof;
+
+static void _sleep_ms(long ms)
+{
+	struct timespec ts = {
+		.tv_sec = 0,
+		.tv_nsec = ms * 1000000l
+	};
+	nanosleep(&ts, NULL);
+}
+
+static void _spin_ms(long ms)
+{
+	struct timespec begin, now;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while((now.tv_sec - begin.tv_sec) * 1000 + (now.tv_nsec - begin.tv_nsec) / 1000000 < ms);
+}
+
+static void* _spin_main(void* data)
+{
+	(void)data;
+	_spin_ms(100);
+	return NULL;
+}
+
+int histogram(void)
+{
+	uint32_t i;
+	uint64_t prev = 0;
+
+	for(i = 0; i < SCHED_PROF_HIST_NBUCKETS; i ++)
+	{
+		uint64_t lb = sched_prof_hist_lower_bound(i);
+		ASSERT(i == 0 || lb > prev, CLEANUP_NOP);
+		ASSERT(sched_prof_hist_bucket(lb) == i, CLEANUP_NOP);
+		ASSERT(lb == 0 || sched_prof_hist_bucket(lb - 1) == i - 1, CLEANUP_NOP);
+		prev = lb;
+	}
+
+	ASSERT(sched_prof_hist_bucket(~0ull) == SCHED_PROF_HIST_NBUCKETS - 1, CLEANUP_NOP);
+
+	/* The relative error of the lower bound should be bounded by the sub-bucket resolution */
+	for(i = 0; i < 40; i ++)
+	{
+		uint64_t v = (1ull << i) + (1ull << i) / 3;
+		uint64_t lb = sched_prof_hist_lower_bound(sched_prof_hist_bucket(v));
+		ASSERT(lb <= v, CLEANUP_NOP);
+		ASSERT((v - lb) * (1u << SCHED_PROF_HIST_SUB_BITS) <= v, CLEANUP_NOP);
+	}
+
+	return 0;
+}
+
+int per_thread_clock(void)
+{
+	pthread_t spinner;
+	char path[] = "/tmp/plumber-prof-XXXXXX";
+	int fd;
+	FILE* fp = NULL;
+	int rc = ERROR_CODE(int);
+	sched_prof_record_t rec;
+	int seen_sleep = 0, seen_spin = 0, seen_pipe = 0;
+	lang_prop_value_t value = {
+		.type = LANG_PROP_TYPE_STRING,
+		.str  = path
+	};
+
+	ASSERT((fd = mkstemp(path)) >= 0, CLEANUP_NOP);
+	close(fd);
+	ASSERT(1 == lang_prop_set("profiler.output", value), goto RET);
+
+	/* The other thread keeps burning CPU, which shouldn't be counted as the CPU time of this thread */
+	expected_memory_leakage();
+	ASSERT_OK(pthread_create(&spinner, NULL, _spin_main, NULL), goto RET);
+
+	ASSERT_OK(sched_prof_start_timer(prof, 0), goto JOIN);
+	_sleep_ms(20);
+	ASSERT_OK(sched_prof_stop_timer(prof), goto JOIN);
+
+	ASSERT_OK(sched_prof_start_timer(prof, 1), goto JOIN);
+	_spin_ms(20);
+	ASSERT_OK(sched_prof_stop_timer(prof), goto JOIN);
+
+	ASSERT_OK(sched_prof_start_pipe_timer(prof, 0, 0), goto JOIN);
+	ASSERT_OK(sched_prof_stop_timer(prof), goto JOIN);
+
+	ASSERT(ERROR_CODE(int) == sched_prof_start_pipe_timer(prof, 1, 0), goto JOIN);
+
+	ASSERT_OK(sched_prof_flush(prof), goto JOIN);
+
+	rc = 0;
+JOIN:
+	ASSERT_OK(pthread_join(spinner, NULL), rc = ERROR_CODE(int));
+	if(rc == ERROR_CODE(int)) goto RET;
+	rc = ERROR_CODE(int);
+
+	value.str = "";
+	ASSERT(1 == lang_prop_set("profiler.output", value), goto RET);
+
+	ASSERT_PTR(fp = fopen(path, "rb"), goto RET);
+	while(1 == fread(&rec, sizeof(rec), 1, fp))
+	{
+		uint64_t n = 0;
+		uint32_t i;
+		for(i = 0; i < SCHED_PROF_HIST_NBUCKETS; i ++)
+			n += rec.wall_hist[i];
+		ASSERT(rec.count == 1, goto RET);
+		ASSERT(n == 1, goto RET);
+
+		if(rec.node == 0 && rec.pipe == ERROR_CODE(uint32_t))
+		{
+			LOG_NOTICE("Sleeping node: CPU %"PRIu64"ns, Wall %"PRIu64"ns", rec.cpu_time, rec.wall_time);
+			ASSERT(rec.wall_time >= 20000000ull, goto RET);
+			ASSERT(rec.cpu_time < 10000000ull, goto RET);
+			seen_sleep = 1;
+		}
+		else if(rec.node == 1 && rec.pipe == ERROR_CODE(uint32_t))
+		{
+			LOG_NOTICE("Spinning node: CPU %"PRIu64"ns, Wall %"PRIu64"ns", rec.cpu_time, rec.wall_time);
+			ASSERT(rec.wall_time >= 20000000ull, goto RET);
+			ASSERT(rec.cpu_time > 0, goto RET);
+			seen_spin = 1;
+		}
+		else if(rec.node == 0 && rec.pipe == 0)
+			seen_pipe = 1;
+		else
+			ERROR_LOG_GOTO(RET, "Unexpected record");
+	}
+
+	ASSERT(seen_sleep && seen_spin && seen_pipe, goto RET);
+
+	rc = 0;
+RET:
+	if(NULL != fp) fclose(fp);
+	unlink(path);
+	return rc;
+}
+
+int live_dump(void)
+{
+	lang_prop_value_t value = lang_prop_get("profiler.dump");
+	ASSERT(value.type == LANG_PROP_TYPE_STRING, CLEANUP_NOP);
+
+	LOG_NOTICE("Profiler dump:\n%s", value.str);
+
+	int rc = 0;
+	if(NULL == strstr(value.str, "node 0\tcount=1") ||
+	   NULL == strstr(value.str, "node 1\tcount=1") ||
+	   NULL == strstr(value.str, "pipe 0:"))
+		rc = ERROR_CODE(int);
+
+	free(value.str);
+	return rc;
+}
+
+int setup(void)
+{
+	runtime_stab_entry_t servlet[2];
+	runtime_api_pipe_id_t pipes[3];
+	const char* argv[] = {"serv_tchelper", "0", "1"};
+	lang_prop_value_t enabled = {
+		.type = LANG_PROP_TYPE_INTEGER,
+		.num  = 1
+	};
+
+	expected_memory_leakage();
+
+	ASSERT_OK(runtime_servlet_append_search_path(TESTDIR), CLEANUP_NOP);
+	ASSERT_RETOK(runtime_stab_entry_t, servlet[0] = runtime_stab_load(3, argv, NULL), CLEANUP_NOP);
+	ASSERT_RETOK(runtime_stab_entry_t, servlet[1] = runtime_stab_load(3, argv, NULL), CLEANUP_NOP);
+	ASSERT_RETOK(runtime_api_pipe_id_t, pipes[0] = runtime_stab_get_pipe(servlet[0], "i0"), CLEANUP_NOP);
+	ASSERT_RETOK(runtime_api_pipe_id_t, pipes[1] = runtime_stab_get_pipe(servlet[0], "o0"), CLEANUP_NOP);
+	ASSERT_RETOK(runtime_api_pipe_id_t, pipes[2] = runtime_stab_get_pipe(servlet[1], "i0"), CLEANUP_NOP);
+
+	ASSERT_PTR(buffer = sched_service_buffer_new(), CLEANUP_NOP);
+	ASSERT_OK(sched_service_buffer_allow_reuse_servlet(buffer), CLEANUP_NOP);
+	ASSERT(0 == sched_service_buffer_add_node(buffer, servlet[0]), CLEANUP_NOP);
+	ASSERT(1 == sched_service_buffer_add_node(buffer, servlet[1]), CLEANUP_NOP);
+
+	sched_service_pipe_descriptor_t pd = {
+		.source_node_id = 0,
+		.source_pipe_desc = pipes[1],
+		.destination_node_id = 1,
+		.destination_pipe_desc = pipes[2]
+	};
+	ASSERT_OK(sched_service_buffer_add_pipe(buffer, pd), CLEANUP_NOP);
+	ASSERT_OK(sched_service_buffer_set_input(buffer, 0, pipes[0]), CLEANUP_NOP);
+	ASSERT_OK(sched_service_buffer_set_output(buffer, 1, pipes[1]), CLEANUP_NOP);
+	ASSERT_PTR(service = sched_service_from_buffer(buffer), CLEANUP_NOP);
+
+	ASSERT(1 == lang_prop_set("profiler.enabled", enabled), CLEANUP_NOP);
+	ASSERT_OK(sched_prof_new(service, &prof), CLEANUP_NOP);
+	ASSERT_PTR(prof, CLEANUP_NOP);
+
+	return 0;
+}
+
+int teardown(void)
+{
+	if(NULL != prof) ASSERT_OK(sched_prof_free(prof), CLEANUP_NOP);
+	if(NULL != service) ASSERT_OK(sched_service_free(service), CLEANUP_NOP);
+	if(NULL != buffer) ASSERT_OK(sched_service_buffer_free(buffer), CLEANUP_NOP);
+	return 0;
+}
+
+TEST_LIST_BEGIN
+    TEST_CASE(histogram),
+    TEST_CASE(per_thread_clock),
+    TEST_CASE(live_dump)
+TEST_LIST_END;
@@ -317,6 +317,140 @@ int test_stream_interface(void)
 	return 0;
 }
 
+static inline int _stream_obj_region(void* handle, runtime_api_scope_file_region_t* buf)
+{
+	if(NULL == handle || NULL == buf) return ERROR_CODE(int);
+	stream_handle_t* hand = (stream_handle_t*)handle;
+	buf->fd = 42;
+	buf->offset = (uint64_t)(hand->current - hand->obj->begin);
+	buf->size = (size_t)(hand->obj->end - hand->current);
+	hand->current = hand->obj->end;
+	return 1;
+}
+
+int test_stream_region(void)
+{
+	runtime_api_scope_token_t t1, t2;
+	runtime_api_scope_file_region_t region;
+	char buf[5];
+	sched_rscope_t* scope = sched_rscope_new();
+	ASSERT_PTR(scope, CLEANUP_NOP);
+	stream_object_t* obj1 = (stream_object_t*)malloc(sizeof(stream_object_t));
+	ASSERT_PTR(obj1, CLEANUP_NOP);
+	obj1->begin = 'a';
+	obj1->end = 'z' + 1;
+	runtime_api_scope_entity_t p1 = {
+		.data = obj1,
+		.copy_func = _stream_obj_copy,
+		.free_func = _stream_obj_free,
+		.open_func = _stream_obj_open,
+		.close_func = _stream_obj_close,
+		.eos_func = _stream_obj_eos,
+		.read_func = _stream_obj_read,
+		.region_func = _stream_obj_region
+	};
+	ASSERT_RETOK(runtime_api_scope_token_t, t1 = sched_rscope_add(scope, &p1), CLEANUP_NOP);
+
+	stream_object_t* obj2 = (stream_object_t*)malloc(sizeof(stream_object_t));
+	ASSERT_PTR(obj2, CLEANUP_NOP);
+	obj2->begin = 'A';
+	obj2->end = 'Z' + 1;
+	runtime_api_scope_entity_t p2 = p1;
+	p2.data = obj2;
+	p2.region_func = NULL;
+	ASSERT_RETOK(runtime_api_scope_token_t, t2 = sched_rscope_add(scope, &p2), CLEANUP_NOP);
+
+	sched_rscope_stream_t *s1, *s2;
+	ASSERT_PTR(s1 = sched_rscope_stream_open(t1), CLEANUP_NOP);
+	ASSERT_PTR(s2 = sched_rscope_stream_open(t2), CLEANUP_NOP);
+
+	/* The region should start from the current position of the stream */
+	ASSERT(5 == sched_rscope_stream_read(s1, buf, 5), CLEANUP_NOP);
+	ASSERT(1 == sched_rscope_stream_get_region(s1, &region), CLEANUP_NOP);
+	ASSERT(42 == region.fd, CLEANUP_NOP);
+	ASSERT(5 == region.offset, CLEANUP_NOP);
+	ASSERT(21 == region.size, CLEANUP_NOP);
+	ASSERT(1 == sched_rscope_stream_eos(s1), CLEANUP_NOP);
+
+	/* The entity without region support should fallback to read */
+	ASSERT(0 == sched_rscope_stream_get_region(s2, &region), CLEANUP_NOP);
+	ASSERT(0 == sched_rscope_stream_eos(s2), CLEANUP_NOP);
+	ASSERT(5 == sched_rscope_stream_read(s2, buf, 5), CLEANUP_NOP);
+	ASSERT(0 == memcmp(buf, "ABCDE", 5), CLEANUP_NOP);
+
+	ASSERT_OK(sched_rscope_stream_close(s1), CLEANUP_NOP);
+	ASSERT_OK(sched_rscope_stream_close(s2), CLEANUP_NOP);
+	ASSERT_OK(sched_rscope_free(scope), CLEANUP_NOP);
+	return 0;
+}
+
+static inline int _arena_obj_free(void* ptr)
+{
+	(void)ptr;
+	return 0;
+}
+
+int test_arena(void)
+{
+	uint32_t i;
+	char* ptrs[1000];
+	char* large = NULL;
+	sched_rscope_stream_t* stream = NULL;
+	sched_rscope_t* scope = sched_rscope_new();
+	ASSERT_PTR(scope, CLEANUP_NOP);
+
+	for(i = 0; i < sizeof(ptrs) / sizeof(ptrs[0]); i ++)
+	{
+		size_t size = i % 100 + 1;
+		ASSERT_PTR(ptrs[i] = (char*)sched_rscope_arena_alloc(scope, size), goto ERR);
+		ASSERT(((uintptr_t)ptrs[i]) % 16 == 0, goto ERR);
+		memset(ptrs[i], (int)(i & 0xff), size);
+	}
+
+	ASSERT_PTR(large = (char*)sched_rscope_arena_alloc(scope, 100000), goto ERR);
+	memset(large, 0xff, 100000);
+
+	for(i = 0; i < sizeof(ptrs) / sizeof(ptrs[0]); i ++)
+	{
+		size_t size = i % 100 + 1, j;
+		for(j = 0; j < size; j ++)
+			ASSERT(ptrs[i][j] == (char)(i & 0xff), goto ERR);
+	}
+
+	/* The entity in the arena should be alive as long as the stream is opened */
+	stream_object_t* obj = (stream_object_t*)sched_rscope_arena_alloc(scope, sizeof(stream_object_t));
+	ASSERT_PTR(obj, goto ERR);
+	obj->begin = 'a';
+	obj->end = 'z' + 1;
+	runtime_api_scope_entity_t ent = {
+		.data = obj,
+		.free_func = _arena_obj_free,
+		.open_func = _stream_obj_open,
+		.close_func = _stream_obj_close,
+		.eos_func = _stream_obj_eos,
+		.read_func = _stream_obj_read
+	};
+	runtime_api_scope_token_t token;
+	ASSERT_RETOK(runtime_api_scope_token_t, token = sched_rscope_add(scope, &ent), goto ERR);
+	ASSERT_PTR(stream = sched_rscope_stream_open(token), goto ERR);
+
+	ASSERT_OK(sched_rscope_free(scope), goto ERR);
+	scope = NULL;
+
+	char buf[27] = {};
+	ASSERT(26 == sched_rscope_stream_read(stream, buf, 26), goto ERR);
+	ASSERT(0 == strcmp(buf, "abcdefghijklmnopqrstuvwxyz"), goto ERR);
+	ASSERT(1 == sched_rscope_stream_eos(stream), goto ERR);
+
+	ASSERT_OK(sched_rscope_stream_close(stream), CLEANUP_NOP);
+
+	return 0;
+ERR:
+	if(NULL != stream) sched_rscope_stream_close(stream);
+	if(NULL != scope) sched_rscope_free(scope);
+	return ERROR_CODE(int);
+}
+
 int setup(void)
 {
 	return sched_rscope_init_thread();
@@ -329,5 +463,7 @@ int teardown(void)
 
 TEST_LIST_BEGIN
     TEST_CASE(test_multiple_request),
-    TEST_CASE(test_stream_interface)
+    TEST_CASE(test_stream_interface),
+    TEST_CASE(test_stream_region),
+    TEST_CASE(test_arena)
 TEST_LIST_END;
@@ -0,0 +1,218 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+
+/**
+ * @brief The scheduler step benchmark, which measures the per-step overhead of sched_step_next
+ *        on a 50-node linear graph and a 50-node fan-out graph
+ **/
+#include <testenv.h>
+#include <stdio.h>
+#include <time.h>
+#include <inttypes.h>
+#include <itc/module_types.h>
+#include <module/test/module.h>
+
+#define NNODES 50
+#define NREQUESTS 2000
+
+static itc_module_type_t mod_test, mod_mem;
+
+static sched_task_context_t* stc = NULL;
+
+static int executed[NNODES];
+
+static void _trap(int n)
+{
+	if(n >= 0 && n < NNODES) executed[n] ++;
+}
+
+/**
+ * @brief the graph under test
+ **/
+typedef struct {
+	sched_service_buffer_t* buffer;
+	sched_service_t*        service;
+	runtime_stab_entry_t    servlet[NNODES];
+} graph_t;
+
+static int _load(graph_t* g, uint32_t k, const char* name, int id, int arg)
+{
+	char ids[16], args[16];
+	snprintf(ids, sizeof(ids), "%d", id);
+	snprintf(args, sizeof(args), "%d", arg);
+	const char* argv[] = {name, ids, args};
+	ASSERT_RETOK(runtime_stab_entry_t, g->servlet[k] = runtime_stab_load(3, argv, NULL), CLEANUP_NOP);
+	ASSERT(k == sched_service_buffer_add_node(g->buffer, g->servlet[k]), CLEANUP_NOP);
+	return 0;
+}
+
+static int _pipe(graph_t* g, uint32_t from, const char* from_pipe, uint32_t to, const char* to_pipe)
+{
+	sched_service_pipe_descriptor_t pd = {
+		.source_node_id = from,
+		.destination_node_id = to
+	};
+	ASSERT_RETOK(runtime_api_pipe_id_t, pd.source_pipe_desc = runtime_stab_get_pipe(g->servlet[from], from_pipe), CLEANUP_NOP);
+	ASSERT_RETOK(runtime_api_pipe_id_t, pd.destination_pipe_desc = runtime_stab_get_pipe(g->servlet[to], to_pipe), CLEANUP_NOP);
+	return sched_service_buffer_add_pipe(g->buffer, pd);
+}
+
+static int _finish(graph_t* g, uint32_t output, const char* output_pipe)
+{
+	runtime_api_pipe_id_t in, out;
+	ASSERT_RETOK(runtime_api_pipe_id_t, in = runtime_stab_get_pipe(g->servlet[0], "i0"), CLEANUP_NOP);
+	ASSERT_RETOK(runtime_api_pipe_id_t, out = runtime_stab_get_pipe(g->servlet[output], output_pipe), CLEANUP_NOP);
+	ASSERT_OK(sched_service_buffer_set_input(g->buffer, 0, in), CLEANUP_NOP);
+	ASSERT_OK(sched_service_buffer_set_output(g->buffer, output, out), CLEANUP_NOP);
+	ASSERT_PTR(g->service = sched_service_from_buffer(g->buffer), CLEANUP_NOP);
+	return 0;
+}
+
+static int _graph_free(graph_t* g)
+{
+	int rc = 0;
+	if(NULL != g->buffer) rc |= sched_service_buffer_free(g->buffer);
+	if(NULL != g->service) rc |= sched_service_free(g->service);
+	return rc;
+}
+
+/**
+ * @brief run the requests against the graph and report the average cost of each step
+ * @param g the graph
+ * @param name the name of the graph
+ * @param expected the expected result for each request
+ * @return status code
+ **/
+static int _run(graph_t* g, const char* name, uint32_t expected)
+{
+	itc_module_pipe_param_t param = {
+		.input_flags = RUNTIME_API_PIPE_INPUT,
+		.output_flags = RUNTIME_API_PIPE_OUTPUT,
+		.args = NULL
+	};
+	struct timespec begin, end;
+	uint64_t steps = 0;
+	uint32_t i, one = 1;
+
+	ASSERT_OK(runtime_servlet_set_trap(_trap), CLEANUP_NOP);
+	memset(executed, 0, sizeof(executed));
+
+	ASSERT_OK(clock_gettime(CLOCK_MONOTONIC, &begin), CLEANUP_NOP);
+
+	for(i = 0; i < NREQUESTS; i ++)
+	{
+		itc_module_pipe_t *in, *out;
+		int rc;
+		ASSERT_OK(module_test_set_request(&one, sizeof(one)), CLEANUP_NOP);
+		ASSERT_OK(itc_module_pipe_accept(mod_test, param, &in, &out), CLEANUP_NOP);
+		ASSERT_RETOK(sched_task_request_t, sched_task_new_request(stc, g->service, in, out), CLEANUP_NOP);
+		while((rc = sched_step_next(stc, mod_mem)) > 0)
+			steps ++;
+		ASSERT_OK(rc, CLEANUP_NOP);
+		ASSERT(expected == *(const uint32_t*)module_test_get_response(), CLEANUP_NOP);
+	}
+
+	ASSERT_OK(clock_gettime(CLOCK_MONOTONIC, &end), CLEANUP_NOP);
+
+	for(i = 0; i < NNODES; i ++)
+		ASSERT(executed[i] == NREQUESTS, CLEANUP_NOP);
+
+	double ns = (double)(end.tv_sec - begin.tv_sec) * 1e9 + (double)(end.tv_nsec - begin.tv_nsec);
+
+	LOG_NOTICE("Step benchmark (%s): %u requests, %"PRIu64" steps, %.1f ns/step", name, NREQUESTS, steps, ns / (double)steps);
+
+	return 0;
+}
+
+int linear(void)
+{
+	graph_t g = {};
+	uint32_t i;
+	int rc = ERROR_CODE(int);
+
+	/* The servlet binary loaded by this case */
+	expected_memory_leakage();
+
+	ASSERT_PTR(g.buffer = sched_service_buffer_new(), CLEANUP_NOP);
+	ASSERT_OK(sched_service_buffer_allow_reuse_servlet(g.buffer), goto RET);
+
+	for(i = 0; i < NNODES; i ++)
+		ASSERT_OK(_load(&g, i, "serv_tchelper", (int)i, 1), goto RET);
+
+	for(i = 0; i + 1 < NNODES; i ++)
+		ASSERT_OK(_pipe(&g, i, "o0", i + 1, "i0"), goto RET);
+
+	ASSERT_OK(_finish(&g, NNODES - 1, "o0"), goto RET);
+
+	rc = _run(&g, "linear", 1);
+RET:
+	if(ERROR_CODE(int) == _graph_free(&g)) rc = ERROR_CODE(int);
+	return rc;
+}
+
+int fanout(void)
+{
+	/* A binary fan-out tree with NNODES - 1 nodes, and all the leaves are collected by the last node */
+	graph_t g = {};
+	uint32_t i, nleaves = 0;
+	int rc = ERROR_CODE(int);
+	const uint32_t ntree = NNODES - 1;
+
+	expected_memory_leakage();
+
+	ASSERT_PTR(g.buffer = sched_service_buffer_new(), CLEANUP_NOP);
+	ASSERT_OK(sched_service_buffer_allow_reuse_servlet(g.buffer), goto RET);
+
+	for(i = 0; i < ntree; i ++)
+		ASSERT_OK(_load(&g, i, "serv_tchelper", (int)i, (2 * i + 1 < ntree) ? 3 : 1), goto RET);
+
+	for(i = 0; i < ntree; i ++)
+		if(2 * i + 1 >= ntree) nleaves ++;
+	ASSERT_OK(_load(&g, ntree, "serv_cat", (int)ntree, (int)nleaves), goto RET);
+
+	for(i = 0, nleaves = 0; i < ntree; i ++)
+	{
+		if(2 * i + 1 < ntree)
+		{
+			ASSERT_OK(_pipe(&g, i, "o0", 2 * i + 1, "i0"), goto RET);
+			if(2 * i + 2 < ntree)
+				ASSERT_OK(_pipe(&g, i, "o1", 2 * i + 2, "i0"), goto RET);
+		}
+		else
+		{
+			char name[16];
+			snprintf(name, sizeof(name), "in%u", nleaves ++);
+			ASSERT_OK(_pipe(&g, i, "o0", ntree, name), goto RET);
+		}
+	}
+
+	ASSERT_OK(_finish(&g, ntree, "out"), goto RET);
+
+	rc = _run(&g, "fan-out", nleaves);
+RET:
+	if(ERROR_CODE(int) == _graph_free(&g)) rc = ERROR_CODE(int);
+	return rc;
+}
+
+int setup(void)
+{
+	mod_test = itc_modtab_get_module_type_from_path("pipe.test.test");
+	ASSERT(ERROR_CODE(itc_module_type_t) != mod_test, CLEANUP_NOP);
+	mod_mem = itc_modtab_get_module_type_from_path("pipe.mem");
+	ASSERT(ERROR_CODE(itc_module_type_t) != mod_mem, CLEANUP_NOP);
+	ASSERT_OK(runtime_servlet_append_search_path(TESTDIR), CLEANUP_NOP);
+	ASSERT_PTR(stc = sched_task_context_new(NULL), CLEANUP_NOP);
+	return 0;
+}
+
+int teardown(void)
+{
+	ASSERT_OK(sched_task_context_free(stc), CLEANUP_NOP);
+	return 0;
+}
+
+TEST_LIST_BEGIN
+    TEST_CASE(linear),
+    TEST_CASE(fanout)
+TEST_LIST_END;
@@ -0,0 +1,176 @@
+/**
+ * Copyright (C) 2018, Hao Hou
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <testenv.h>
+#include <utils/thread.h>
+
+#define NT 4
+#define NMSG 2000
+
+static char log_path[128];
+
+static uint64_t dropped_before;
+
+static void* thread_main(void* data)
+{
+	uintptr_t tid = (uintptr_t)data;
+	uint32_t i;
+	for(i = 0; i < NMSG; i ++)
+		LOG_NOTICE("log-test thread %u message %u", (uint32_t)tid, i);
+	return data;
+}
+
+/**
+ * @brief read the log file and check the messages from each thread are in order
+ * @param counts the buffer for the number of messages from each thread
+ * @param child if we have the message from the child process
+ * @param long_msg if we have the long message
+ * @return status code
+ **/
+static int check_log(uint32_t* counts, int* child, int* long_msg)
+{
+	static char line[262144];
+	int64_t last[NT];
+	uint32_t i;
+	FILE* fp = fopen(log_path, "r");
+	ASSERT_PTR(fp, CLEANUP_NOP);
+
+	for(i = 0; i < NT; i ++)
+		last[i] = -1, counts[i] = 0;
+	*child = *long_msg = 0;
+
+	while(NULL != fgets(line, sizeof(line), fp))
+	{
+		unsigned tid, msg;
+		const char* p = strstr(line, "] log-test ");
+		if(NULL == p) continue;
+		p += 2;
+		if(sscanf(p, "log-test thread %u message %u", &tid, &msg) == 2)
+		{
+			ASSERT(tid < NT, goto ERR);
+			ASSERT(last[tid] < (int64_t)msg, goto ERR);
+			last[tid] = msg;
+			counts[tid] ++;
+		}
+		else if(strcmp(p, "log-test child\n") == 0)
+			*child = 1;
+		else if(strncmp(p, "log-test long ", 14) == 0)
+		{
+			ASSERT(strlen(p) == 14 + 200000 + 1, goto ERR);
+			*long_msg = 1;
+		}
+	}
+
+	fclose(fp);
+	return 0;
+ERR:
+	fclose(fp);
+	return ERROR_CODE(int);
+}
+
+int concurrent(void)
+{
+	thread_t* threads[NT];
+	uintptr_t i;
+	uint32_t counts[NT], total = 0;
+	int child, long_msg;
+
+	for(i = 0; i < NT; i ++)
+		ASSERT_PTR(threads[i] = thread_new(thread_main, (void*)i, THREAD_TYPE_GENERIC), CLEANUP_NOP);
+
+	for(i = 0; i < NT; i ++)
+		ASSERT_OK(thread_free(threads[i], NULL), CLEANUP_NOP);
+
+	ASSERT_OK(log_flush(), CLEANUP_NOP);
+
+	ASSERT_OK(check_log(counts, &child, &long_msg), CLEANUP_NOP);
+
+	for(i = 0; i < NT; i ++)
+		total += counts[i];
+
+	/* Each message is either written or dropped */
+	ASSERT(total + log_get_dropped_count() - dropped_before == NT * NMSG, CLEANUP_NOP);
+	ASSERT(total > 0, CLEANUP_NOP);
+
+	return 0;
+}
+
+int long_message(void)
+{
+	static char buf[200001];
+	uint32_t counts[NT];
+	int child, long_msg;
+
+	memset(buf, 'x', sizeof(buf) - 1);
+
+	LOG_NOTICE("log-test long %s", buf);
+
+	ASSERT_OK(log_flush(), CLEANUP_NOP);
+
+	ASSERT_OK(check_log(counts, &child, &long_msg), CLEANUP_NOP);
+
+	ASSERT(long_msg, CLEANUP_NOP);
+
+	return 0;
+}
+
+int fork_child(void)
+{
+	uint32_t counts[NT];
+	int child, long_msg, status;
+
+	ASSERT_OK(log_flush(), CLEANUP_NOP);
+
+	pid_t pid = fork();
+	ASSERT(pid >= 0, CLEANUP_NOP);
+
+	if(pid == 0)
+	{
+		LOG_NOTICE("log-test child");
+		/* The buffered messages are written when the process exits */
+		exit(0);
+	}
+
+	ASSERT(waitpid(pid, &status, 0) == pid, CLEANUP_NOP);
+	ASSERT(status == 0, CLEANUP_NOP);
+
+	ASSERT_OK(check_log(counts, &child, &long_msg), CLEANUP_NOP);
+
+	ASSERT(child, CLEANUP_NOP);
+
+	return 0;
+}
+
+int setup(void)
+{
+	uint32_t i;
+
+	/* The thread local storage of the pthread stack cache */
+	for(i = 0; i < NT; i ++)
+		expected_memory_leakage();
+
+	snprintf(log_path, sizeof(log_path), "/tmp/plumber-test-log.%d", getpid());
+
+	dropped_before = log_get_dropped_count();
+
+	ASSERT_OK(log_redirect(NOTICE, log_path, "w"), CLEANUP_NOP);
+
+	return 0;
+}
+
+int teardown(void)
+{
+	unlink(log_path);
+	return 0;
+}
+
+TEST_LIST_BEGIN
+    TEST_CASE(concurrent),
+    TEST_CASE(long_message),
+    TEST_CASE(fork_child)
+TEST_LIST_END;